@@ -272,12 +272,19 @@ DIFF_EXT::InvokeCommand(LPCMINVOKECOMMANDINFO ici)
       if(id == m_id_Diff)
       {
          LOG();
-         diff( TEXT("\"") + _file_name1 + TEXT("\" \"") + _file_name2 + TEXT("\"") );
+         std::vector<tstring> args;
+         args.push_back(_file_name1);
+         args.push_back(_file_name2);
+         diff( args );
       }
       else if(id == m_id_Diff3)
       {
          LOG();
-         diff( TEXT("\"") + _file_name1 + TEXT("\" \"") + _file_name2 + TEXT("\" \"") + _file_name3 + TEXT("\"") );
+         std::vector<tstring> args;
+         args.push_back(_file_name1);
+         args.push_back(_file_name2);
+         args.push_back(_file_name3);
+         diff( args );
       }
       else if(id == m_id_Merge3)
       {
@@ -285,7 +292,12 @@ DIFF_EXT::InvokeCommand(LPCMINVOKECOMMANDINFO ici)
          std::list< tstring >::iterator iFrom = m_recentFiles.begin();
          std::list< tstring >::iterator iBase = iFrom;
          ++iBase;
-         diff( TEXT("-m \"") + *iBase + TEXT("\" \"") + *iFrom + TEXT("\" \"") + _file_name1 + TEXT("\"") );
+         std::vector<tstring> args;
+         args.push_back(TEXT("-m"));
+         args.push_back(*iBase);
+         args.push_back(*iFrom);
+         args.push_back(_file_name1);
+         diff( args );
       }
       else if(id == m_id_DiffWith)
       {
@@ -391,15 +403,87 @@ DIFF_EXT::GetCommandString(UINT_PTR idCmd, UINT uFlags, UINT*, LPSTR pszName, UI
    return ret;
 }
 
+// The UTF-8 form of s followed by a zero byte, as diff_in_server() sends each argument.
+static std::string
+utf8_with_zero(const tstring& s)
+{
+#ifdef UNICODE
+   const std::wstring& wide = s;
+#else
+   std::wstring wide( MultiByteToWideChar(CP_ACP, 0, s.c_str(), -1, 0, 0), L'\0' );
+   if ( wide.empty() )
+      return std::string();
+   MultiByteToWideChar(CP_ACP, 0, s.c_str(), -1, &wide[0], (int)wide.size());
+   wide.resize(wide.size() - 1);
+#endif
+   int size = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, 0, 0, 0, 0);
+   if ( size <= 0 )
+      return std::string();
+   std::string utf8( size, '\0' );
+   WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, &utf8[0], size, 0, 0);
+   return utf8;
+}
+
+/*
+   Hands the arguments to a running "kdiff3 --server" through its named pipe, see InstanceServer
+   in the kdiff3 sources for the protocol. Returns false if no server takes them.
+*/
+bool
+DIFF_EXT::diff_in_server( const std::vector<tstring>& args )
+{
+   LOG();
+   tstring pipeName = TEXT("\\\\.\\pipe\\kdiff3");
+   TCHAR userName[256];
+   DWORD length = GetEnvironmentVariable( TEXT("USERNAME"), userName, 256 );
+   if ( length > 0 && length < 256 )
+      pipeName += TEXT("-") + tstring(userName);
+
+   HANDLE pipe = CreateFile( pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, 0, 0 );
+   if ( pipe == INVALID_HANDLE_VALUE )
+   {
+      if ( GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipe( pipeName.c_str(), 200 ) )
+         return false;
+      pipe = CreateFile( pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, 0, 0 );
+      if ( pipe == INVALID_HANDLE_VALUE )
+         return false;
+   }
+
+   std::string request;
+   for ( size_t i = 0; i < args.size(); ++i )
+   {
+      if ( !args[i].empty() )
+         request += utf8_with_zero( args[i] );
+   }
+   request += '\0';
+
+   DWORD written = 0;
+   DWORD read = 0;
+   char answer = '0';
+   bool bOpened = WriteFile( pipe, request.data(), (DWORD)request.size(), &written, 0 ) && written == request.size() &&
+                  ReadFile( pipe, &answer, 1, &read, 0 ) && read == 1 && answer == '1';
+   CloseHandle( pipe );
+   return bOpened;
+}
+
 void
-DIFF_EXT::diff( const tstring& arguments )
+DIFF_EXT::diff( const std::vector<tstring>& args )
 {
    LOG();
+   if ( diff_in_server( args ) )
+      return;
+
    STARTUPINFO si;
    PROCESS_INFORMATION pi;
    bool bError = true;
    tstring command = SERVER::instance()->getRegistryKeyString( TEXT(""), TEXT("diffcommand") );
-   tstring commandLine = TEXT("\"") + command + TEXT("\" ") + arguments;
+   tstring commandLine = TEXT("\"") + command + TEXT("\"");
+   for ( size_t i = 0; i < args.size(); ++i )
+   {
+      if ( !args[i].empty() && args[i][0] == TEXT('-') )
+         commandLine += TEXT(" ") + args[i];
+      else
+         commandLine += TEXT(" \"") + args[i] + TEXT("\"");
+   }
    if ( ! command.empty() )
    {
       ZeroMemory(&si, sizeof(si));
@@ -437,7 +521,12 @@ DIFF_EXT::diff_with(unsigned int num, bool bMerge)
    if ( i!=m_recentFiles.end() )
       _file_name2 = *i;
 
-   diff( (bMerge ? TEXT("-m \"") : TEXT("\"") ) + _file_name2 + TEXT("\" \"") + _file_name1 + TEXT("\"") );
+   std::vector<tstring> args;
+   if (bMerge)
+      args.push_back(TEXT("-m"));
+   args.push_back(_file_name2);
+   args.push_back(_file_name1);
+   diff( args );
 }
 
 
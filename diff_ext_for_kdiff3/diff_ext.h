@@ -14,6 +14,8 @@
 
 #include "server.h"
 
+#include <vector>
+
 
 // this is the actual OLE Shell context menu handler
 class DIFF_EXT : public IContextMenu, IShellExtInit {
@@ -35,7 +37,8 @@ class DIFF_EXT : public IContextMenu, IShellExtInit {
     STDMETHODIMP Initialize(LPCITEMIDLIST folder, IDataObject* subj, HKEY key);
 
   private:
-    void diff( const tstring& arguments );
+    void diff( const std::vector<tstring>& args );
+    bool diff_in_server( const std::vector<tstring>& args );
     void diff_with(unsigned int num, bool bMerge);
     tstring cut_to_length(const tstring&, size_t length = 64);
 
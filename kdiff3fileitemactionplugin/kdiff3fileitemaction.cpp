@@ -9,6 +9,7 @@
 #include "kdiff3fileitemaction.h"
 
 #include <QAction>
+#include <QLocalSocket>
 #include <QMenu>
 #include <QUrl>
 
@@ -59,6 +60,32 @@ public:
 
 KDiff3PluginHistory s_history;
 
+/*
+   Hands the arguments to a running "kdiff3 --server", see InstanceServer in the kdiff3 sources
+   for the protocol. Starts kdiff3 if no server takes them.
+*/
+static void startKDiff3(const QStringList& args)
+{
+   const QString userName = QString::fromLocal8Bit(qgetenv("USER"));
+   QLocalSocket socket;
+   socket.connectToServer(userName.isEmpty() ? QStringLiteral("kdiff3") : QStringLiteral("kdiff3-") + userName);
+   if (socket.waitForConnected(200))
+   {
+      QByteArray request;
+      for (const QString& arg: args)
+      {
+         if (!arg.isEmpty())
+            request += arg.toUtf8() + '\0';
+      }
+      request += '\0';
+      socket.write(request);
+      if (socket.waitForReadyRead(2000) && socket.read(1) == "1")
+         return;
+   }
+
+   KProcess::startDetached("kdiff3", args);
+}
+
 K_PLUGIN_FACTORY_WITH_JSON(KDiff3FileItemActionFactory, "kdiff3fileitemaction.json", registerPlugin<KDiff3FileItemAction>();)
 #include "kdiff3fileitemaction.moc"
 
@@ -181,7 +208,7 @@ void KDiff3FileItemAction::slotCompareWith()
       QStringList args;
       args << s_pHistory->first();
       args << m_list.first().toDisplayString(QUrl::PreferLocalFile);
-      KProcess::startDetached("kdiff3", args);
+      startKDiff3(args);
    }
 }
 
@@ -193,7 +220,7 @@ void KDiff3FileItemAction::slotCompareWithHistoryItem()
       QStringList args;
       args << pAction->data().toString();
       args << m_list.first().toDisplayString(QUrl::PreferLocalFile);
-      KProcess::startDetached ("kdiff3", args);
+      startKDiff3(args);
    }
 }
 
@@ -204,7 +231,7 @@ void KDiff3FileItemAction::slotCompareTwoFiles()
       QStringList args;
       args << m_list.first().toDisplayString(QUrl::PreferLocalFile);
       args << m_list.last().toDisplayString(QUrl::PreferLocalFile);
-      KProcess::startDetached ("kdiff3", args);
+      startKDiff3(args);
    }
 }
 
@@ -216,7 +243,7 @@ void KDiff3FileItemAction::slotCompareThreeFiles()
       args << m_list.at(0).toDisplayString(QUrl::PreferLocalFile);
       args << m_list.at(1).toDisplayString(QUrl::PreferLocalFile);
       args << m_list.at(2).toDisplayString(QUrl::PreferLocalFile);
-      KProcess::startDetached ("kdiff3", args);
+      startKDiff3(args);
    }
 }
 
@@ -228,7 +255,7 @@ void KDiff3FileItemAction::slotMergeWith()
       args << s_pHistory->first();
       args << m_list.first().toDisplayString(QUrl::PreferLocalFile);
       args << ( "-o" + m_list.first().toDisplayString(QUrl::PreferLocalFile) );
-      KProcess::startDetached ("kdiff3", args);
+      startKDiff3(args);
    }
 }
 
@@ -241,7 +268,7 @@ void KDiff3FileItemAction::slotMergeThreeWay()
       args << s_pHistory->at(0);
       args << m_list.first().toDisplayString(QUrl::PreferLocalFile);
       args << ("-o" + m_list.first().toDisplayString(QUrl::PreferLocalFile));
-      KProcess::startDetached ("kdiff3", args);
+      startKDiff3(args);
    }
 }
 
@@ -0,0 +1,178 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "BatchMerge.h"
+
+#include "fileaccess.h"
+#include "FullAnalysis.h"
+#include "options.h"
+#include "TaskGroup.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <KLocalizedString>
+
+class BatchMerge::Task : public TaskGroup::Task
+{
+  public:
+    Task(TaskGroup& group, Entry& entry, const QSharedPointer<Options>& pOptions)
+        : TaskGroup::Task(group), m_entry(entry), m_pOptions(pOptions)
+    {
+    }
+
+  protected:
+    void execute() override { BatchMerge::process(m_entry, m_pOptions); }
+
+  private:
+    Entry& m_entry;
+    QSharedPointer<Options> m_pOptions;
+};
+
+int BatchMerge::run(const QString& manifestFile, const QSharedPointer<Options>& pOptions, QTextStream& summary)
+{
+    QVector<Entry> entries;
+    if(!readManifest(manifestFile, entries))
+    {
+        QTextStream(stderr) << i18n("Reading the manifest %1 failed.", manifestFile) << "\n";
+        return 2;
+    }
+
+    // The entries don't move while the tasks run.
+    TaskGroup taskGroup;
+    for(Entry& entry: entries)
+    {
+        taskGroup.add(new Task(taskGroup, entry, pOptions));
+    }
+    taskGroup.startPending();
+    taskGroup.wait();
+
+    int exitCode = 0;
+    for(const Entry& entry: entries)
+    {
+        summary << summaryLine(entry) << "\n";
+        if(entry.result != e_Result::Compared && entry.result != e_Result::Saved)
+            exitCode = 1;
+    }
+    summary.flush();
+    return exitCode;
+}
+
+bool BatchMerge::readManifest(const QString& manifestFile, QVector<Entry>& entries)
+{
+    QFile file(manifestFile);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    int lineNr = 0;
+    while(!stream.atEnd())
+    {
+        const QString line = stream.readLine();
+        ++lineNr;
+        if(line.trimmed().isEmpty() || line.startsWith('#'))
+            continue;
+
+        const QStringList fields = line.split('\t');
+        Entry entry;
+        entry.lineNr = lineNr;
+        entry.fileA = fields.value(0);
+        entry.fileB = fields.value(1);
+        entry.fileC = fields.value(2);
+        entry.outputFile = fields.value(3);
+        if(fields.count() > 4)
+            entry.errors.append(i18n("Too many fields."));
+        else if(entry.fileA.isEmpty() || entry.fileB.isEmpty())
+            entry.errors.append(i18n("Two files at least are needed."));
+
+        entries.append(entry);
+    }
+    return stream.status() == QTextStream::Ok;
+}
+
+void BatchMerge::process(Entry& entry, const QSharedPointer<Options>& pOptions)
+{
+    if(!entry.errors.isEmpty())
+        return;
+
+    const QStringList inputFiles = {entry.fileA, entry.fileB, entry.fileC};
+    for(const QString& file: inputFiles)
+    {
+        if(!file.isEmpty() && !FileAccess(file).isLocal())
+        {
+            entry.errors.append(i18n("%1 is not a local file.", file));
+            return;
+        }
+    }
+
+    if(entry.outputFile.isEmpty())
+    {
+        entry.errors = FullAnalysis::run(entry.fileA, entry.fileB, entry.fileC, pOptions, entry.status);
+        entry.result = entry.errors.isEmpty() ? e_Result::Compared : e_Result::Failed;
+        return;
+    }
+
+    if(!FullAnalysis::isMergeAvailable(pOptions))
+    {
+        entry.errors.append(i18n("The current settings need the merge result window to merge."));
+        return;
+    }
+
+    const FileAccess output(entry.outputFile, true /*bWantToWrite*/);
+    if(!output.isLocal())
+    {
+        entry.errors.append(i18n("%1 is not a local file.", entry.outputFile));
+        return;
+    }
+
+    switch(FullAnalysis::merge(entry.fileA, entry.fileB, entry.fileC, output.absoluteFilePath(), pOptions, entry.status, entry.errors))
+    {
+        case FullAnalysis::e_MergeResult::Saved:
+            entry.result = e_Result::Saved;
+            break;
+        case FullAnalysis::e_MergeResult::Unsolved:
+            entry.result = e_Result::Unsolved;
+            break;
+        case FullAnalysis::e_MergeResult::Failed:
+            entry.result = e_Result::Failed;
+            break;
+    }
+}
+
+QByteArray BatchMerge::summaryLine(const Entry& entry)
+{
+    // No i18n()-Translations here, the summary is read by programs.
+    static const char* const resultNames[] = {"compared", "saved", "unsolved", "failed"};
+
+    QJsonObject object;
+    object["line"] = entry.lineNr;
+    object["fileA"] = entry.fileA;
+    object["fileB"] = entry.fileB;
+    object["fileC"] = entry.fileC;
+    object["output"] = entry.outputFile;
+    object["result"] = resultNames[(int)entry.result];
+
+    const TotalDiffStatus& status = entry.status;
+    object["unsolvedConflicts"] = status.getUnsolvedConflicts();
+    object["solvedConflicts"] = status.getSolvedConflicts();
+    object["whitespaceDeltas"] = status.getWhitespaceConflicts();
+    object["nonWhitespaceDeltas"] = status.getNonWhitespaceConflicts();
+    object["binaryEqualAB"] = status.isBinaryEqualAB();
+    object["binaryEqualAC"] = status.isBinaryEqualAC();
+    object["binaryEqualBC"] = status.isBinaryEqualBC();
+    object["textEqualAB"] = status.isTextEqualAB();
+    object["textEqualAC"] = status.isTextEqualAC();
+    object["textEqualBC"] = status.isTextEqualBC();
+    object["diffDegraded"] = status.isDiffDegraded();
+    object["errors"] = QJsonArray::fromStringList(entry.errors);
+
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,65 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef BATCHMERGE_H
+#define BATCHMERGE_H
+
+#include "diff.h"
+
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class Options;
+class QTextStream;
+
+/*
+    The --batch mode: merges or compares the files listed in a manifest in one process, several
+    at once on pool threads, with FullAnalysis. So options and libraries are loaded only once for
+    all of them.
+
+    Each line of the manifest holds the names of A, B, C and the output separated by tabs, like
+    "kdiff3 A B C -o output" with A as the base. Without C two files are merged, without output
+    the files are only compared. Empty lines and lines starting with '#' are skipped. The summary gets
+    one line of JSON per file in the order of the manifest.
+*/
+class BatchMerge
+{
+  public:
+    // Returns the exit code: 0 if all files were compared or merged, 1 if not, 2 if the manifest can't be read.
+    static int run(const QString& manifestFile, const QSharedPointer<Options>& pOptions, QTextStream& summary);
+
+  private:
+    enum class e_Result
+    {
+        Compared,
+        Saved,
+        Unsolved,
+        Failed
+    };
+
+    struct Entry
+    {
+        int lineNr = 0;
+        QString fileA;
+        QString fileB;
+        QString fileC;
+        QString outputFile;
+
+        e_Result result = e_Result::Failed;
+        TotalDiffStatus status;
+        QStringList errors;
+    };
+
+    class Task;
+
+    static bool readManifest(const QString& manifestFile, QVector<Entry>& entries);
+    static void process(Entry& entry, const QSharedPointer<Options>& pOptions);
+    static QByteArray summaryLine(const Entry& entry);
+};
+
+#endif // !BATCHMERGE_H
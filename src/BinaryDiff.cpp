@@ -0,0 +1,222 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "BinaryDiff.h"
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+// Multiplier of the polynomial rolling hash, all arithmetic is modulo 2^32.
+static const quint32 hashFactor = 0x01000193;
+
+BinaryDiff::BinaryDiff(const uchar* pData1, qint64 size1, const uchar* pData2, qint64 size2):
+    m_pData1(pData1), m_size1(size1), m_pData2(pData2), m_size2(size2)
+{
+}
+
+QVector<BinaryDiff::Range> BinaryDiff::run()
+{
+    m_ranges.clear();
+    indexBlocks();
+
+    qint64 pos1 = 0;
+    qint64 pos2 = 0;
+    for(;;)
+    {
+        const qint64 nofEquals = commonPrefix(pos1, pos2, std::numeric_limits<qint64>::max());
+        pos1 += nofEquals;
+        pos2 += nofEquals;
+        if(pos1 == m_size1 || pos2 == m_size2)
+            break;
+
+        qint64 match1, match2;
+        if(!findMatch(pos1, pos2, match1, match2))
+            break;
+
+        // The block match may start in the middle of equal bytes.
+        while(match1 > pos1 && match2 > pos2 && m_pData1[match1 - 1] == m_pData2[match2 - 1])
+        {
+            --match1;
+            --match2;
+        }
+
+        addRange(pos1, match1 - pos1, pos2, match2 - pos2);
+        pos1 = match1;
+        pos2 = match2;
+    }
+    addRange(pos1, m_size1 - pos1, pos2, m_size2 - pos2);
+
+    m_blocks.clear();
+    m_hashFilter.clear();
+    return m_ranges;
+}
+
+bool BinaryDiff::lessBlock(const Block& a, const Block& b)
+{
+    return a.hash < b.hash || (a.hash == b.hash && a.index < b.index);
+}
+
+void BinaryDiff::indexBlocks()
+{
+    m_blockSize = (m_size1 + maxNofBlocks - 1) / maxNofBlocks;
+    if(m_blockSize < minBlockSize)
+        m_blockSize = minBlockSize;
+
+    m_removeFactor = 1;
+    for(qint64 i = 1; i < m_blockSize; ++i)
+        m_removeFactor *= hashFactor;
+
+    const qint64 nofBlocks = m_size1 / m_blockSize;
+    m_blocks.clear();
+    m_blocks.reserve((int)nofBlocks);
+    for(qint64 i = 0; i < nofBlocks; ++i)
+        m_blocks.push_back(Block{blockHash(m_pData1 + i * m_blockSize), (quint32)i});
+    std::sort(m_blocks.begin(), m_blocks.end(), lessBlock);
+
+    // About 16 filter bits per block keep false hits rare.
+    m_nofFilterBits = 6;
+    while(m_nofFilterBits < 32 && (qint64(1) << m_nofFilterBits) < nofBlocks * 16)
+        ++m_nofFilterBits;
+
+    m_hashFilter.fill(0, (int)((qint64(1) << m_nofFilterBits) / 64));
+    for(const Block& block: m_blocks)
+    {
+        const quint32 slot = filterSlot(block.hash, m_nofFilterBits);
+        m_hashFilter[slot / 64] |= quint64(1) << (slot % 64);
+    }
+}
+
+quint32 BinaryDiff::blockHash(const uchar* p) const
+{
+    quint32 hash = 0;
+    for(qint64 i = 0; i < m_blockSize; ++i)
+        hash = hash * hashFactor + p[i];
+    return hash;
+}
+
+quint32 BinaryDiff::rollHash(quint32 hash, const uchar* p) const
+{
+    return (hash - p[0] * m_removeFactor) * hashFactor + p[m_blockSize];
+}
+
+/*
+    Slides a window over the second input starting at from2 and looks for bytes that equal the first
+    input at or after from1. Checked are the bytes on the same diagonal as (from1, from2), so a
+    replaced range resynchronizes at once, and the indexed blocks nearest to that diagonal, which find
+    inserted and removed bytes.
+    Repeated content like runs of zeros matches in many places. A match is only taken right away
+    when at least strongMatchBlocks blocks are equal from there, otherwise the longest one found is
+    taken once the window has moved that far past it without finding a better one.
+*/
+bool BinaryDiff::findMatch(qint64 from1, qint64 from2, qint64& match1, qint64& match2) const
+{
+    if(from2 + m_blockSize > m_size2)
+        return false;
+
+    const qint64 diagonal = from1 - from2;
+    const qint64 strongLength = strongMatchBlocks * m_blockSize;
+    const qint64 firstIndex = (from1 + m_blockSize - 1) / m_blockSize;
+    qint64 bestLength = 0;
+
+    quint32 hash = blockHash(m_pData2 + from2);
+    bool bHasDiagonal = from1 + m_blockSize <= m_size1;
+    quint32 diagonalHash = bHasDiagonal ? blockHash(m_pData1 + from1) : 0;
+
+    for(qint64 pos2 = from2;; ++pos2)
+    {
+        const qint64 diagonalPos1 = pos2 + diagonal;
+        if(bHasDiagonal && diagonalHash == hash && memcmp(m_pData1 + diagonalPos1, m_pData2 + pos2, m_blockSize) == 0)
+        {
+            if(tryMatch(diagonalPos1, pos2, strongLength, bestLength, match1, match2))
+                return true;
+        }
+
+        const quint32 slot = filterSlot(hash, m_nofFilterBits);
+        if(!m_blocks.isEmpty() && ((m_hashFilter[slot / 64] >> (slot % 64)) & 1) != 0)
+        {
+            const qint64 diagonalIndex = std::max(firstIndex, diagonalPos1 / m_blockSize);
+            const Block key{hash, (quint32)std::min(diagonalIndex, (qint64)std::numeric_limits<quint32>::max())};
+            const QVector<Block>::const_iterator nearest = std::lower_bound(m_blocks.constBegin(), m_blocks.constEnd(), key, lessBlock);
+
+            // The blocks at and after the diagonal, then those before it.
+            qint32 nofTries = 0;
+            for(QVector<Block>::const_iterator it = nearest; it != m_blocks.constEnd() && it->hash == hash && nofTries < maxCollisions; ++it, ++nofTries)
+            {
+                const qint64 pos1 = it->index * m_blockSize;
+                if(memcmp(m_pData1 + pos1, m_pData2 + pos2, m_blockSize) == 0 && tryMatch(pos1, pos2, strongLength, bestLength, match1, match2))
+                    return true;
+            }
+
+            nofTries = 0;
+            for(QVector<Block>::const_iterator it = nearest; it != m_blocks.constBegin() && nofTries < maxCollisions; ++nofTries)
+            {
+                --it;
+                if(it->hash != hash || it->index < firstIndex)
+                    break;
+
+                const qint64 pos1 = it->index * m_blockSize;
+                if(memcmp(m_pData1 + pos1, m_pData2 + pos2, m_blockSize) == 0 && tryMatch(pos1, pos2, strongLength, bestLength, match1, match2))
+                    return true;
+            }
+        }
+
+        if(bestLength > 0 && pos2 >= match2 + strongLength)
+            return true;
+
+        if(pos2 + m_blockSize >= m_size2)
+            return bestLength > 0;
+
+        hash = rollHash(hash, m_pData2 + pos2);
+        // The diagonal may run out of the first input.
+        bHasDiagonal = bHasDiagonal && diagonalPos1 + m_blockSize < m_size1;
+        if(bHasDiagonal)
+            diagonalHash = rollHash(diagonalHash, m_pData1 + diagonalPos1);
+    }
+}
+
+// Records a match of at least one block, returns true if it is long enough to be taken right away.
+bool BinaryDiff::tryMatch(qint64 pos1, qint64 pos2, qint64 strongLength, qint64& bestLength, qint64& match1, qint64& match2) const
+{
+    const qint64 length = commonPrefix(pos1, pos2, strongLength);
+    if(length > bestLength)
+    {
+        bestLength = length;
+        match1 = pos1;
+        match2 = pos2;
+    }
+
+    return length >= strongLength || pos1 + length == m_size1 || pos2 + length == m_size2;
+}
+
+qint64 BinaryDiff::commonPrefix(qint64 pos1, qint64 pos2, qint64 maxLength) const
+{
+    maxLength = std::min(maxLength, std::min(m_size1 - pos1, m_size2 - pos2));
+    qint64 length = 0;
+
+    // Eight bytes at a time until they differ.
+    for(; length + 8 <= maxLength; length += 8)
+    {
+        quint64 word1, word2;
+        memcpy(&word1, m_pData1 + pos1 + length, sizeof(word1));
+        memcpy(&word2, m_pData2 + pos2 + length, sizeof(word2));
+        if(word1 != word2)
+            break;
+    }
+
+    while(length < maxLength && m_pData1[pos1 + length] == m_pData2[pos2 + length])
+        ++length;
+    return length;
+}
+
+void BinaryDiff::addRange(qint64 offset1, qint64 size1, qint64 offset2, qint64 size2)
+{
+    if(size1 == 0 && size2 == 0)
+        return;
+
+    m_ranges.push_back(Range{offset1, size1, offset2, size2});
+}
@@ -0,0 +1,80 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef BINARYDIFF_H
+#define BINARYDIFF_H
+
+#include <QtGlobal>
+#include <QVector>
+
+/*
+    Byte level comparison of binary data in the style of rsync: the first input is cut into blocks
+    whose rolling hashes are looked up while a window slides over the second input. So inserted or
+    removed bytes only cost the range around them instead of shifting every following byte.
+    The data is only read, it is meant to be used on memory mapped files.
+*/
+class BinaryDiff
+{
+  public:
+    // Bytes that differ, everything between two ranges is equal in both inputs.
+    struct Range
+    {
+        qint64 offset1;
+        qint64 size1;
+        qint64 offset2;
+        qint64 size2;
+    };
+
+    BinaryDiff(const uchar* pData1, qint64 size1, const uchar* pData2, qint64 size2);
+
+    // Returns the differing ranges in order, empty if the inputs are equal.
+    QVector<Range> run();
+
+  private:
+    struct Block
+    {
+        quint32 hash;
+        quint32 index;
+    };
+
+    static bool lessBlock(const Block& a, const Block& b);
+
+    static quint32 filterSlot(quint32 hash, qint32 nofFilterBits) { return (hash * 0x9E3779B1u) >> (32 - nofFilterBits); }
+
+    quint32 blockHash(const uchar* p) const;
+    // Moves the window starting at p one byte further.
+    quint32 rollHash(quint32 hash, const uchar* p) const;
+
+    void indexBlocks();
+    bool findMatch(qint64 from1, qint64 from2, qint64& match1, qint64& match2) const;
+    bool tryMatch(qint64 pos1, qint64 pos2, qint64 strongLength, qint64& bestLength, qint64& match1, qint64& match2) const;
+    qint64 commonPrefix(qint64 pos1, qint64 pos2, qint64 maxLength) const;
+    void addRange(qint64 offset1, qint64 size1, qint64 offset2, qint64 size2);
+
+    // Blocks get larger for big inputs so the index stays small.
+    static constexpr qint64 minBlockSize = 64;
+    static constexpr qint64 maxNofBlocks = 1 << 20;
+    // Candidates with the same hash but other bytes, tried before giving up at a position.
+    static constexpr qint32 maxCollisions = 8;
+    // Equal blocks in a row that make a match good enough to stop searching.
+    static constexpr qint64 strongMatchBlocks = 4;
+
+    const uchar* m_pData1;
+    const qint64 m_size1;
+    const uchar* m_pData2;
+    const qint64 m_size2;
+    qint64 m_blockSize = minBlockSize;
+    quint32 m_removeFactor = 1; // hashFactor^(m_blockSize-1), to drop the oldest byte from the window.
+
+    // Blocks of the first input sorted by hash and then by position.
+    QVector<Block> m_blocks;
+    // One bit per filter slot used by a block, most positions in the second input need no search.
+    QVector<quint64> m_hashFilter;
+    qint32 m_nofFilterBits = 6;
+    QVector<Range> m_ranges;
+};
+
+#endif // !BINARYDIFF_H
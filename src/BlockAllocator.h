@@ -0,0 +1,164 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef BLOCKALLOCATOR_H
+#define BLOCKALLOCATOR_H
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+#include <QSharedPointer>
+#include <QtGlobal>
+
+/*
+    Hands out items of one size from blocks of itemsPerBlock items, so items allocated one after
+    another lie next to each other in memory. Freed items are reused, and once every item is freed
+    all blocks are released in one go.
+    Requests of another size than the first one are passed on to operator new.
+    Not thread safe.
+*/
+class BlockPool
+{
+  public:
+    explicit BlockPool(size_t itemsPerBlock = 4096): m_itemsPerBlock(itemsPerBlock) {}
+    ~BlockPool() { releaseBlocks(); }
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    void* allocate(size_t size)
+    {
+        if(m_requestedSize == 0)
+        {
+            m_requestedSize = size;
+            // Keep every item aligned like malloc() does.
+            const size_t alignment = alignof(max_align_t);
+            m_itemSize = (std::max(size, sizeof(FreeItem)) + alignment - 1) / alignment * alignment;
+        }
+        else if(size != m_requestedSize)
+        {
+            return ::operator new(size);
+        }
+
+        ++m_nofUsedItems;
+        if(m_pFreeItems != nullptr)
+        {
+            FreeItem* pItem = m_pFreeItems;
+            m_pFreeItems = pItem->pNext;
+            return pItem;
+        }
+
+        if(m_pNextItem == m_pBlockEnd)
+        {
+            char* pBlock = static_cast<char*>(malloc(m_itemSize * m_itemsPerBlock));
+            if(pBlock == nullptr)
+            {
+                --m_nofUsedItems;
+                throw std::bad_alloc();
+            }
+
+            m_blocks.push_back(pBlock);
+            m_pNextItem = pBlock;
+            m_pBlockEnd = pBlock + m_itemSize * m_itemsPerBlock;
+        }
+
+        void* pItem = m_pNextItem;
+        m_pNextItem += m_itemSize;
+        return pItem;
+    }
+
+    void deallocate(void* p, size_t size)
+    {
+        if(size != m_requestedSize)
+        {
+            ::operator delete(p);
+            return;
+        }
+
+        FreeItem* pItem = static_cast<FreeItem*>(p);
+        pItem->pNext = m_pFreeItems;
+        m_pFreeItems = pItem;
+
+        Q_ASSERT(m_nofUsedItems > 0);
+        if(--m_nofUsedItems == 0)
+            releaseBlocks();
+    }
+
+  private:
+    struct FreeItem
+    {
+        FreeItem* pNext;
+    };
+
+    void releaseBlocks()
+    {
+        for(char* pBlock : m_blocks)
+            free(pBlock);
+
+        m_blocks.clear();
+        m_pFreeItems = nullptr;
+        m_pNextItem = nullptr;
+        m_pBlockEnd = nullptr;
+    }
+
+    const size_t m_itemsPerBlock;
+    size_t m_requestedSize = 0;
+    size_t m_itemSize = 0;
+    size_t m_nofUsedItems = 0;
+
+    std::vector<char*> m_blocks;
+    FreeItem* m_pFreeItems = nullptr;
+    char* m_pNextItem = nullptr;
+    char* m_pBlockEnd = nullptr;
+};
+
+/*
+    Allocator for node based containers like std::list. Each container gets a pool of its own,
+    copies of the allocator share it. Containers that splice nodes between each other must be
+    given one pool to share.
+*/
+template <class T>
+class BlockAllocator
+{
+  public:
+    typedef T value_type;
+
+    BlockAllocator(): m_pool(QSharedPointer<BlockPool>::create()) {}
+    explicit BlockAllocator(const QSharedPointer<BlockPool>& pool): m_pool(pool) {}
+    template <class U>
+    BlockAllocator(const BlockAllocator<U>& other): m_pool(other.pool()) {}
+
+    T* allocate(size_t n)
+    {
+        if(n == 1)
+            return static_cast<T*>(m_pool->allocate(sizeof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if(n == 1)
+            m_pool->deallocate(p, sizeof(T));
+        else
+            ::operator delete(p);
+    }
+
+    const QSharedPointer<BlockPool>& pool() const { return m_pool; }
+
+  private:
+    QSharedPointer<BlockPool> m_pool;
+};
+
+template <class T, class U>
+inline bool operator==(const BlockAllocator<T>& a, const BlockAllocator<U>& b) { return a.pool() == b.pool(); }
+
+template <class T, class U>
+inline bool operator!=(const BlockAllocator<T>& a, const BlockAllocator<U>& b) { return a.pool() != b.pool(); }
+
+#endif // !BLOCKALLOCATOR_H
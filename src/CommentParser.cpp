@@ -7,8 +7,9 @@
 
 #include "CommentParser.h"
 
+#include <algorithm>
+
 #include <QChar>
-#include <QRegularExpression>
 #include <QSharedPointer>
 #include <QString>
 
@@ -112,24 +113,95 @@ void DefaultCommentParser::processChar(const QString &line, const QChar &inChar)
     ++offset;
 };
 
+/*
+    Characters that may change the parser state outside of a comment. Everything else only clears the
+    pure comment flag, so runs of such characters are handled in one step.
+*/
+static bool isSpecialChar(const QChar &c)
+{
+    static const bool specialChars[128] = {
+        /* 0x00 */ false, false, false, false, false, false, false, false, false, false, false, false, false, false, false, false,
+        /* 0x10 */ false, false, false, false, false, false, false, false, false, false, false, false, false, false, false, false,
+        /* 0x20 */ false, false, true,  false, false, false, false, true,  false, false, true,  false, false, false, false, true,
+        /* 0x30 */ false, false, false, false, false, false, false, false, false, false, false, false, false, false, false, false,
+        /* 0x40 */ false, false, false, false, false, false, false, false, false, false, false, false, false, false, false, false,
+        /* 0x50 */ false, false, false, false, false, false, false, false, false, false, false, false, true,  false, false, false,
+        /* 0x60 */ false, false, false, false, false, false, false, false, false, false, false, false, false, false, false, false,
+        /* 0x70 */ false, false, false, false, false, false, false, false, false, false, false, false, false, false, false, false,
+    };
+
+    return c.unicode() < 128 && specialChars[c.unicode()];
+}
+
+/*
+    Consumes count characters that processChar() would not act on. Valid outside of strings escapes
+    and single line comments and for any run that does not contain '/' inside a multi-line comment.
+*/
+void DefaultCommentParser::skipChars(const QChar *pChars, qint32 count)
+{
+    if(count <= 0)
+        return;
+
+    if(!inComment())
+        mIsPureComment = false;
+
+    mLastChar = pChars[count - 1];
+    offset += count;
+}
+
 /*
     Find comments if any and set is pure comment flag it it has nothing but whitespace and comments.
 */
 void DefaultCommentParser::processLine(const QString &line)
 {
-    offset = line.indexOf(QRegularExpression("[\\S]", QRegularExpression::UseUnicodePropertiesOption));
+    offset = -1;
+    for(qint32 i = 0; i < line.length(); ++i)
+    {
+        if(!line[i].isSpace())
+        {
+            offset = i;
+            break;
+        }
+    }
     lastComment.startOffset = lastComment.endOffset = 0; //reset these for each line
     comments.clear();
 
     //remove trailing and ending spaces.
     const QString trimmedLine = line.trimmed();
+    const QChar *pBegin = trimmedLine.constData();
+    const QChar *pEnd = pBegin + trimmedLine.length();
+    const QChar *p = pBegin;
 
-    for(const QChar &c : trimmedLine)
+    while(p < pEnd)
     {
-        processChar(trimmedLine, c);
+        const QChar *pNext;
+        if(bIsEscaped)
+        {
+            pNext = p;
+        }
+        else if(mCommentType == singleLine)
+        {
+            // Nothing but the end of line can end this.
+            pNext = pEnd;
+        }
+        else if(mCommentType == multiLine)
+        {
+            pNext = std::find(p, pEnd, QChar('/'));
+        }
+        else
+        {
+            pNext = std::find_if(p, pEnd, isSpecialChar);
+        }
+
+        skipChars(p, (qint32)(pNext - p));
+        if(pNext == pEnd)
+            break;
+
+        DefaultCommentParser::processChar(trimmedLine, *pNext);
+        p = pNext + 1;
     }
 
-    processChar(trimmedLine, '\n');
+    DefaultCommentParser::processChar(trimmedLine, '\n');
 }
 
 /*
@@ -40,6 +40,8 @@ class DefaultCommentParser : public CommentParser
     inline bool isEscaped() const{ return bIsEscaped; }
     inline bool inString() const{ return bInString; }
   private:
+    void skipChars(const QChar *pChars, qint32 count);
+
     QChar mLastChar, mStartChar;
 
     struct CommentRange
@@ -0,0 +1,150 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "ContentHashCache.h"
+
+#include "fileaccess.h"
+#include "Logging.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// Written at the start of the cache file, a file with another value is ignored.
+static const quint32 cacheFileMagic = 0x4B444843; // "KDHC"
+static const quint32 cacheFileVersion = 1;
+
+ContentHashCache& ContentHashCache::instance()
+{
+    static ContentHashCache cache;
+    return cache;
+}
+
+QString ContentHashCache::cacheFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/contenthashes";
+}
+
+// Returns 0 where there are no inodes, the size and time still have to match then.
+quint64 ContentHashCache::inode(const QString& path)
+{
+#ifndef Q_OS_WIN
+    struct stat buf;
+    if(::stat(QFile::encodeName(path).constData(), &buf) == 0)
+        return (quint64)buf.st_ino;
+#else
+    Q_UNUSED(path);
+#endif
+    return 0;
+}
+
+bool ContentHashCache::lookup(const FileAccess& file, QByteArray& hash)
+{
+    const QString path = file.absoluteFilePath();
+    const quint64 fileInode = inode(path);
+
+    QMutexLocker locker(&m_mutex);
+    load();
+
+    QHash<QString, Entry>::iterator it = m_entries.find(path);
+    if(it == m_entries.end() || it->size != file.size() || it->lastModified != file.lastModified().toMSecsSinceEpoch() || it->inode != fileInode)
+        return false;
+
+    it->bUsed = true;
+    hash = it->hash;
+    return true;
+}
+
+void ContentHashCache::insert(const FileAccess& file, const QByteArray& hash)
+{
+    const QString path = file.absoluteFilePath();
+    const Entry entry{file.size(), file.lastModified().toMSecsSinceEpoch(), inode(path), hash, true};
+
+    QMutexLocker locker(&m_mutex);
+    load();
+    m_entries.insert(path, entry);
+    m_bModified = true;
+}
+
+void ContentHashCache::load()
+{
+    if(m_bLoaded)
+        return;
+    m_bLoaded = true;
+
+    QFile file(cacheFileName());
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    quint32 magic = 0, version = 0;
+    qint32 nofEntries = 0;
+    stream >> magic >> version >> nofEntries;
+    if(magic != cacheFileMagic || version != cacheFileVersion || nofEntries < 0)
+        return;
+
+    m_entries.reserve(nofEntries);
+    for(qint32 i = 0; i < nofEntries && stream.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        Entry entry{0, 0, 0, QByteArray(), false};
+        stream >> path >> entry.size >> entry.lastModified >> entry.inode >> entry.hash;
+        if(stream.status() == QDataStream::Ok)
+            m_entries.insert(path, entry);
+    }
+
+    if(stream.status() != QDataStream::Ok)
+    {
+        qCInfo(kdiffFileAccess) << "Ignoring damaged content hash cache" << cacheFileName();
+        m_entries.clear();
+    }
+}
+
+void ContentHashCache::save()
+{
+    QMutexLocker locker(&m_mutex);
+    if(!m_bModified)
+        return;
+
+    const bool bOnlyUsed = m_entries.size() > maxNofEntries;
+    qint32 nofEntries = 0;
+    for(QHash<QString, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+    {
+        if(!bOnlyUsed || it->bUsed)
+            ++nofEntries;
+    }
+
+    const QString fileName = cacheFileName();
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qCInfo(kdiffFileAccess) << "Writing the content hash cache failed:" << file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << cacheFileMagic << cacheFileVersion << nofEntries;
+    for(QHash<QString, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+    {
+        if(!bOnlyUsed || it->bUsed)
+            stream << it.key() << it->size << it->lastModified << it->inode << it->hash;
+    }
+
+    if(file.commit())
+        m_bModified = false;
+    else
+        qCInfo(kdiffFileAccess) << "Writing the content hash cache failed:" << file.errorString();
+}
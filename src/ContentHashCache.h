@@ -0,0 +1,62 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef CONTENTHASHCACHE_H
+#define CONTENTHASHCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+class FileAccess;
+
+/*
+    Content hashes of local files kept on disk between runs, so a folder comparison need not read
+    files again that did not change since. An entry is only valid while the size, modification time
+    and inode of the file are the same as when it was hashed.
+    Safe to use from several threads at once.
+*/
+class ContentHashCache
+{
+  public:
+    static ContentHashCache& instance();
+
+    // Returns false if there is no valid hash for the file.
+    bool lookup(const FileAccess& file, QByteArray& hash);
+    void insert(const FileAccess& file, const QByteArray& hash);
+
+    // Writes the cache back if anything was inserted.
+    void save();
+
+  private:
+    struct Entry
+    {
+        qint64 size;
+        qint64 lastModified;
+        quint64 inode;
+        QByteArray hash;
+        bool bUsed; // Looked up or inserted during this run, only those are kept once the cache is full.
+    };
+
+    ContentHashCache() = default;
+
+    static QString cacheFileName();
+    static quint64 inode(const QString& path);
+
+    void load();
+
+    // Larger caches are reduced to the files used by the current run on saving.
+    static const int maxNofEntries = 1000000;
+
+    QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    bool m_bLoaded = false;
+    bool m_bModified = false;
+};
+
+#endif // !CONTENTHASHCACHE_H
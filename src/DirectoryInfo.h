@@ -37,6 +37,9 @@ class DirectoryInfo
               return m_dirC.isValid() ? m_dirC : m_dirB;
       }
 
+      // False if the destination is the default one of destDir().
+      inline bool hasDestDir() const { return m_dirDest.isValid(); }
+
       inline bool allowSyncMode() { return !m_dirC.isValid() && !m_dirDest.isValid(); }
 
       inline bool listDirA(const Options& options)
@@ -45,7 +48,7 @@ class DirectoryInfo
                                         options.m_bDmRecursiveDirs, options.m_bDmFindHidden,
                                         options.m_DmFilePattern, options.m_DmFileAntiPattern,
                                         options.m_DmDirAntiPattern, options.m_bDmFollowDirLinks,
-                                        options.m_bDmUseCvsIgnore);
+                                        options.m_bDmUseCvsIgnore, options.m_maxNofParallelRemoteListings);
       }
 
       inline bool listDirB(const Options& options)
@@ -54,7 +57,7 @@ class DirectoryInfo
                                         options.m_bDmRecursiveDirs, options.m_bDmFindHidden,
                                         options.m_DmFilePattern, options.m_DmFileAntiPattern,
                                         options.m_DmDirAntiPattern, options.m_bDmFollowDirLinks,
-                                        options.m_bDmUseCvsIgnore);
+                                        options.m_bDmUseCvsIgnore, options.m_maxNofParallelRemoteListings);
       }
 
       inline bool listDirC(const Options& options)
@@ -63,13 +66,15 @@ class DirectoryInfo
                                         options.m_bDmRecursiveDirs, options.m_bDmFindHidden,
                                         options.m_DmFilePattern, options.m_DmFileAntiPattern,
                                         options.m_DmDirAntiPattern, options.m_bDmFollowDirLinks,
-                                        options.m_bDmUseCvsIgnore);
+                                        options.m_bDmUseCvsIgnore, options.m_maxNofParallelRemoteListings);
       }
 
       t_DirectoryList& getDirListA() { return m_dirListA; }
       t_DirectoryList& getDirListB() { return m_dirListB; }
       t_DirectoryList& getDirListC() { return m_dirListC; }
 
+      qint64 memoryUsage() const { return m_dirListA.memoryUsage() + m_dirListB.memoryUsage() + m_dirListC.memoryUsage(); }
+
     private:
       FileAccess m_dirA, m_dirB, m_dirC;
 
@@ -0,0 +1,205 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "DirectoryReport.h"
+
+#include "DirectoryInfo.h"
+#include "fileaccess.h"
+#include "MergeFileInfos.h"
+#include "options.h"
+#include "TaskGroup.h"
+
+#include <QHash>
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QVector>
+
+#include <KLocalizedString>
+
+#include <stdio.h> // for stderr
+
+void DirectoryReport::ResultQueue::push(const Result& result)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_results.push_back(result);
+    }
+    m_available.release();
+}
+
+DirectoryReport::Result DirectoryReport::ResultQueue::take()
+{
+    m_available.acquire();
+    QMutexLocker locker(&m_mutex);
+    return m_results.takeFirst();
+}
+
+// Compares the files of one item on a pool thread, as the folder window does for local files.
+class DirectoryReport::Task : public TaskGroup::Task
+{
+  public:
+    Task(TaskGroup& group, MergeFileInfos& mfi, const QSharedPointer<Options>& pOptions, ResultQueue& results)
+        : TaskGroup::Task(group), m_mfi(mfi), m_pOptions(pOptions), m_results(results)
+    {
+    }
+
+  protected:
+    void execute() override
+    {
+        Result result{&m_mfi, true, QStringList()};
+        // Only a full analysis of remote files needs a window, those are never compared here.
+        result.bSuccess = m_mfi.compareFilesAndCalcAges(result.errors, m_pOptions, nullptr);
+        m_results.push(result);
+    }
+
+  private:
+    MergeFileInfos& m_mfi;
+    QSharedPointer<Options> m_pOptions;
+    ResultQueue& m_results;
+};
+
+static bool isLocal(const MergeFileInfos& mfi)
+{
+    return (!mfi.existsInA() || mfi.getFileInfoA()->isLocal()) && (!mfi.existsInB() || mfi.getFileInfoB()->isLocal()) &&
+           (!mfi.existsInC() || mfi.getFileInfoC()->isLocal());
+}
+
+int DirectoryReport::run(const QString& dirA, const QString& dirB, const QString& dirC, const QSharedPointer<Options>& pOptions, QIODevice& output)
+{
+    FileAccess dirs[3] = {FileAccess(dirA), FileAccess(dirB), dirC.isEmpty() ? FileAccess() : FileAccess(dirC)};
+    for(const FileAccess& dir: dirs)
+    {
+        if(dir.isValid() && !dir.isDir())
+        {
+            QTextStream(stderr) << i18n("%1 is no folder.", dir.prettyAbsPath()) << "\n";
+            return 2;
+        }
+    }
+
+    FileAccess destDir;
+    const QSharedPointer<DirectoryInfo> dirInfo = QSharedPointer<DirectoryInfo>::create(dirs[0], dirs[1], dirs[2], destDir);
+    int exitCode = 0;
+    bool (DirectoryInfo::*const listDirs[3])(const Options&) = {&DirectoryInfo::listDirA, &DirectoryInfo::listDirB, &DirectoryInfo::listDirC};
+    for(int i = 0; i < 3; ++i)
+    {
+        if(dirs[i].isValid() && !((*dirInfo).*listDirs[i])(*pOptions))
+        {
+            // The readable subfolders are still compared.
+            QTextStream(stderr) << i18n("Some subfolders were not readable in %1.", dirs[i].prettyAbsPath()) << "\n";
+            exitCode = 2;
+        }
+    }
+
+    QHash<QString, MergeFileInfos> mergeMap;
+    MergeFileInfos::buildMergeMap(dirInfo, pOptions->m_bDmCaseSensitiveFilenameComparison ? Qt::CaseSensitive : Qt::CaseInsensitive, mergeMap);
+
+    // The items don't move while the tasks run.
+    TaskGroup taskGroup;
+    ResultQueue results;
+    QVector<MergeFileInfos*> mainThreadItems;
+    for(MergeFileInfos& mfi: mergeMap)
+    {
+        if(mfi.hasDir() || !isLocal(mfi))
+        {
+            mainThreadItems.push_back(&mfi);
+            continue;
+        }
+
+        mfi.prepareForWorkerThread();
+        taskGroup.add(new Task(taskGroup, mfi, pOptions, results));
+    }
+    const int nofTasks = taskGroup.startPending();
+
+    bool bAllEqual = true;
+    // Folders and remote files are compared here while the pool threads compare the others.
+    for(MergeFileInfos* pMFI: mainThreadItems)
+    {
+        Result result{pMFI, true, QStringList()};
+        if(pOptions->m_bDmFullAnalysis && !pMFI->hasDir() && !pMFI->canRunFullAnalysis(pOptions))
+        {
+            result.bSuccess = false;
+            result.errors.append(i18n("A full analysis of remote files needs the folder window."));
+        }
+        else
+        {
+            result.bSuccess = pMFI->compareFilesAndCalcAges(result.errors, pOptions, nullptr);
+            // Folders get their ages from their existence, as in the folder window.
+            pMFI->updateAge();
+        }
+
+        bool bEqual = false;
+        output.write(reportLine(*pMFI, result, pOptions, bEqual) + '\n');
+        output.flush();
+        bAllEqual = bAllEqual && bEqual;
+        if(!result.bSuccess)
+            exitCode = 2;
+    }
+
+    for(int i = 0; i < nofTasks; ++i)
+    {
+        const Result result = results.take();
+        bool bEqual = false;
+        output.write(reportLine(*result.pMFI, result, pOptions, bEqual) + '\n');
+        output.flush();
+        bAllEqual = bAllEqual && bEqual;
+        if(!result.bSuccess)
+            exitCode = 2;
+    }
+    taskGroup.wait();
+
+    if(exitCode == 0 && !bAllEqual)
+        exitCode = 1;
+    return exitCode;
+}
+
+QByteArray DirectoryReport::reportLine(MergeFileInfos& mfi, const Result& result, const QSharedPointer<Options>& pOptions, bool& bEqual)
+{
+    // No i18n()-Translations here, the report is read by programs. In the order of e_Age.
+    static const char* const ageNames[] = {"new", "middle", "old", "missing"};
+
+    const bool bThreeWay = mfi.isThreeWay();
+    bEqual = false;
+    QString kind;
+    if(!result.bSuccess)
+        kind = QStringLiteral("error");
+    else if(mfi.onlyInA())
+        kind = QStringLiteral("onlyInA");
+    else if(mfi.onlyInB())
+        kind = QStringLiteral("onlyInB");
+    else if(mfi.onlyInC())
+        kind = QStringLiteral("onlyInC");
+    else if(!mfi.existsEveryWhere())
+        kind = !mfi.existsInA() ? QStringLiteral("missingInA") : !mfi.existsInB() ? QStringLiteral("missingInB") : QStringLiteral("missingInC");
+    else
+    {
+        // Folders in every folder count as equal, their contents have lines of their own.
+        bEqual = !mfi.conflictingFileTypes() && mfi.isEqualAB() && (!bThreeWay || (mfi.isEqualAC() && mfi.isEqualBC()));
+        kind = bEqual ? QStringLiteral("equal") : QStringLiteral("different");
+    }
+
+    QJsonObject object;
+    object["path"] = mfi.subPath();
+    object["type"] = mfi.hasDir() ? "folder" : mfi.hasLink() ? "link" : "file";
+    object["result"] = kind;
+    object["ageA"] = ageNames[mfi.getAgeA()];
+    object["ageB"] = ageNames[mfi.getAgeB()];
+    if(bThreeWay)
+        object["ageC"] = ageNames[mfi.getAgeC()];
+    if(pOptions->m_bDmFullAnalysis && !mfi.hasDir() && result.bSuccess)
+    {
+        object["whitespaceDeltas"] = mfi.diffStatus().getWhitespaceConflicts();
+        object["nonWhitespaceDeltas"] = mfi.diffStatus().getNonWhitespaceConflicts();
+    }
+    if(!result.errors.isEmpty())
+        object["errors"] = QJsonArray::fromStringList(result.errors);
+
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,62 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef DIRECTORYREPORT_H
+#define DIRECTORYREPORT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+class MergeFileInfos;
+class Options;
+class QIODevice;
+
+/*
+    The --dir-report mode: compares two or three folders as the folder window does, but without
+    any window, and writes one line of JSON for each item once it is compared. The folders are
+    listed with the file and folder patterns and the cvsignore setting of the options. Files are
+    compared on pool threads, so the lines come in the order the comparisons end and not by path.
+*/
+class DirectoryReport
+{
+  public:
+    // Returns the exit code of diff: 0 if all items are equal, 1 if not, 2 on errors.
+    static int run(const QString& dirA, const QString& dirB, const QString& dirC, const QSharedPointer<Options>& pOptions, QIODevice& output);
+
+  private:
+    struct Result
+    {
+        MergeFileInfos* pMFI;
+        bool bSuccess;
+        QStringList errors;
+    };
+
+    // The items the pool threads compared, until the thread writing the report takes them.
+    class ResultQueue
+    {
+      public:
+        void push(const Result& result);
+        // Blocks until a result is there.
+        Result take();
+
+      private:
+        QMutex m_mutex;
+        QList<Result> m_results;
+        QSemaphore m_available;
+    };
+
+    class Task;
+
+    // The item is equal if it is in every folder and the same there.
+    static QByteArray reportLine(MergeFileInfos& mfi, const Result& result, const QSharedPointer<Options>& pOptions, bool& bEqual);
+};
+
+#endif // !DIRECTORYREPORT_H
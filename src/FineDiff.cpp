@@ -0,0 +1,347 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "FineDiff.h"
+
+#include "diff.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+#include <QtGlobal>
+
+namespace {
+/*
+    Collects an edit script given from the start of the lines and turns it into Diff entries.
+*/
+class DiffListBuilder
+{
+  public:
+    explicit DiffListBuilder(DiffList &diffList): m_diffList(diffList) {}
+
+    void equal(qint32 count)
+    {
+        if(count == 0)
+            return;
+
+        if(m_diff1 != 0 || m_diff2 != 0)
+        {
+            m_diffList.push_back(Diff(m_nofEquals, m_diff1, m_diff2));
+            m_nofEquals = 0;
+            m_diff1 = m_diff2 = 0;
+        }
+        m_nofEquals += count;
+    }
+
+    void deleted(qint32 count) { m_diff1 += count; }
+    void inserted(qint32 count) { m_diff2 += count; }
+
+    void finish()
+    {
+        if(m_nofEquals != 0 || m_diff1 != 0 || m_diff2 != 0)
+            m_diffList.push_back(Diff(m_nofEquals, m_diff1, m_diff2));
+    }
+
+  private:
+    DiffList &m_diffList;
+    LineCount m_nofEquals = 0;
+    qint64 m_diff1 = 0;
+    qint64 m_diff2 = 0;
+};
+
+enum class EditOp
+{
+    Equal,
+    Delete,
+    Insert
+};
+
+typedef std::vector<std::pair<EditOp, qint32>> EditScript;
+
+// Edit scripts are built from the end of the lines, so they are replayed backwards.
+void replayReversed(const EditScript &script, DiffListBuilder &builder)
+{
+    for(EditScript::const_reverse_iterator i = script.crbegin(); i != script.crend(); ++i)
+    {
+        if(i->first == EditOp::Equal)
+            builder.equal(i->second);
+        else if(i->first == EditOp::Delete)
+            builder.deleted(i->second);
+        else
+            builder.inserted(i->second);
+    }
+}
+
+constexpr qint32 invalidX = -1;
+
+/*
+    Start of the diagonal k of the d-path in Myers' algorithm, coming either from diagonal k + 1
+    (a character of line2 is inserted) or from diagonal k - 1 (a character of line1 is deleted).
+    prevRow holds the furthest x reached by the (d-1)-paths, indexed by k + d - 1.
+*/
+qint32 myersStartX(const std::vector<qint32> &prevRow, qint32 d, qint32 k, qint32 n, qint32 m, bool &bFromInsert)
+{
+    qint32 xInsert = invalidX;
+    qint32 xDelete = invalidX;
+
+    if(k + 1 <= d - 1 && prevRow[k + 1 + d - 1] != invalidX && prevRow[k + 1 + d - 1] - k <= m)
+        xInsert = prevRow[k + 1 + d - 1];
+    if(k - 1 >= -(d - 1) && prevRow[k - 1 + d - 1] != invalidX && prevRow[k - 1 + d - 1] < n)
+        xDelete = prevRow[k - 1 + d - 1] + 1;
+
+    bFromInsert = xInsert >= xDelete;
+    return std::max(xInsert, xDelete);
+}
+} // namespace
+
+const FineDiffEngine &FineDiffEngine::forLines(const QString &line1, const QString &line2)
+{
+    static const SearchFineDiff searchFineDiff(2, 500);
+    static const BitParallelFineDiff bitParallelFineDiff;
+    static const MyersFineDiff myersFineDiff(1000);
+
+    const int maxLength = std::max(line1.length(), line2.length());
+    // Ordinary lines keep the results of the original algorithm.
+    if(maxLength <= 500)
+        return searchFineDiff;
+    if(maxLength <= 4096)
+        return bitParallelFineDiff;
+
+    return myersFineDiff;
+}
+
+void SearchFineDiff::calcDiff(const QString &line1, const QString &line2, DiffList &diffList) const
+{
+    ::calcDiff(line1, line2, diffList, m_match, m_maxSearchRange);
+}
+
+void MyersFineDiff::calcDiff(const QString &line1, const QString &line2, DiffList &diffList) const
+{
+    diffList.clear();
+    DiffListBuilder builder(diffList);
+
+    const QChar *a = line1.constData();
+    const QChar *b = line2.constData();
+    qint32 n = line1.length();
+    qint32 m = line2.length();
+
+    std::vector<std::vector<qint32>> trace;
+    EditScript script;
+    for(;;)
+    {
+        qint32 nofEquals = 0;
+        while(nofEquals < n && nofEquals < m && a[nofEquals] == b[nofEquals])
+            ++nofEquals;
+
+        builder.equal(nofEquals);
+        a += nofEquals;
+        b += nofEquals;
+        n -= nofEquals;
+        m -= nofEquals;
+        if(n == 0 || m == 0)
+        {
+            builder.deleted(n);
+            builder.inserted(m);
+            break;
+        }
+
+        // Forward search, trace[d][k + d] is the furthest x on diagonal k = x - y using d differences.
+        trace.clear();
+        qint32 endD = -1;
+        qint32 endK = 0;
+        for(qint32 d = 0; d <= m_maxCost && endD < 0; ++d)
+        {
+            std::vector<qint32> row(2 * d + 1, invalidX);
+            for(qint32 k = -d; k <= d; k += 2)
+            {
+                bool bFromInsert;
+                qint32 x = d == 0 ? 0 : myersStartX(trace.back(), d, k, n, m, bFromInsert);
+                if(x == invalidX)
+                    continue;
+
+                qint32 y = x - k;
+                while(x < n && y < m && a[x] == b[y])
+                {
+                    ++x;
+                    ++y;
+                }
+
+                row[k + d] = x;
+                if(x == n && y == m)
+                {
+                    endD = d;
+                    endK = k;
+                }
+            }
+            trace.push_back(std::move(row));
+        }
+
+        if(endD < 0)
+        {
+            // Too expensive, continue from the point that got furthest.
+            endD = m_maxCost;
+            qint32 bestProgress = -1;
+            const std::vector<qint32> &row = trace.back();
+            for(qint32 k = -endD; k <= endD; k += 2)
+            {
+                if(row[k + endD] != invalidX && 2 * row[k + endD] - k > bestProgress)
+                {
+                    bestProgress = 2 * row[k + endD] - k;
+                    endK = k;
+                }
+            }
+        }
+
+        const qint32 endX = trace[endD][endK + endD];
+        const qint32 endY = endX - endK;
+
+        script.clear();
+        qint32 x = endX;
+        qint32 k = endK;
+        for(qint32 d = endD; d > 0; --d)
+        {
+            bool bFromInsert;
+            const qint32 startX = myersStartX(trace[d - 1], d, k, n, m, bFromInsert);
+            script.push_back(std::make_pair(EditOp::Equal, x - startX));
+            script.push_back(std::make_pair(bFromInsert ? EditOp::Insert : EditOp::Delete, 1));
+
+            k = bFromInsert ? k + 1 : k - 1;
+            x = trace[d - 1][k + d - 1];
+        }
+        script.push_back(std::make_pair(EditOp::Equal, x));
+        replayReversed(script, builder);
+
+        if(endX == n && endY == m)
+            break;
+
+        a += endX;
+        b += endY;
+        n -= endX;
+        m -= endY;
+    }
+
+    builder.finish();
+}
+
+void BitParallelFineDiff::calcDiff(const QString &line1, const QString &line2, DiffList &diffList) const
+{
+    diffList.clear();
+    DiffListBuilder builder(diffList);
+
+    const QChar *a = line1.constData();
+    const QChar *b = line2.constData();
+    qint32 n = line1.length();
+    qint32 m = line2.length();
+
+    // Common start and end need no matrix.
+    qint32 nofEqualsAtStart = 0;
+    while(nofEqualsAtStart < n && nofEqualsAtStart < m && a[nofEqualsAtStart] == b[nofEqualsAtStart])
+        ++nofEqualsAtStart;
+    qint32 nofEqualsAtEnd = 0;
+    while(nofEqualsAtStart + nofEqualsAtEnd < n && nofEqualsAtStart + nofEqualsAtEnd < m &&
+          a[n - nofEqualsAtEnd - 1] == b[m - nofEqualsAtEnd - 1])
+        ++nofEqualsAtEnd;
+
+    builder.equal(nofEqualsAtStart);
+    a += nofEqualsAtStart;
+    b += nofEqualsAtStart;
+    n -= nofEqualsAtStart + nofEqualsAtEnd;
+    m -= nofEqualsAtStart + nofEqualsAtEnd;
+
+    if(n > 0 && m > 0)
+    {
+        const qint32 nofWords = (n + 63) / 64;
+
+        // Bit j of the mask of a character is set if line1 has that character at position j.
+        QHash<ushort, qint32> maskIndex;
+        std::vector<quint64> masks;
+        for(qint32 j = 0; j < n; ++j)
+        {
+            QHash<ushort, qint32>::const_iterator it = maskIndex.constFind(a[j].unicode());
+            qint32 idx;
+            if(it == maskIndex.constEnd())
+            {
+                idx = maskIndex.size();
+                maskIndex.insert(a[j].unicode(), idx);
+                masks.resize(masks.size() + nofWords, 0);
+            }
+            else
+            {
+                idx = it.value();
+            }
+            masks[idx * nofWords + j / 64] |= quint64(1) << (j % 64);
+        }
+
+        /*
+            Row i holds the bit vector V of the LCS table for the first i characters of line2:
+            bit j is 0 exactly when L[i][j + 1] = L[i][j] + 1. Each row is derived from the previous
+            one by V' = (V + (V & M)) | (V & ~M) with M the mask of the i-th character.
+        */
+        std::vector<quint64> rows((size_t)(m + 1) * nofWords, ~quint64(0));
+        for(qint32 i = 1; i <= m; ++i)
+        {
+            const quint64 *pPrev = &rows[(size_t)(i - 1) * nofWords];
+            quint64 *pRow = &rows[(size_t)i * nofWords];
+            QHash<ushort, qint32>::const_iterator it = maskIndex.constFind(b[i - 1].unicode());
+            if(it == maskIndex.constEnd())
+            {
+                std::copy(pPrev, pPrev + nofWords, pRow);
+                continue;
+            }
+
+            const quint64 *pMask = &masks[it.value() * nofWords];
+            quint64 carry = 0;
+            for(qint32 w = 0; w < nofWords; ++w)
+            {
+                const quint64 v = pPrev[w];
+                const quint64 u = v & pMask[w];
+                const quint64 t = v + carry;
+                const quint64 sum = t + u;
+                carry = (t < carry || sum < u) ? 1 : 0;
+                pRow[w] = sum | (v & ~pMask[w]);
+            }
+        }
+
+        EditScript script;
+        qint32 i = m;
+        qint32 j = n;
+        while(i > 0 && j > 0)
+        {
+            EditOp op;
+            if(a[j - 1] == b[i - 1])
+                op = EditOp::Equal;
+            else if((rows[(size_t)i * nofWords + (j - 1) / 64] >> ((j - 1) % 64)) & 1)
+                op = EditOp::Delete; // L[i][j] == L[i][j - 1]
+            else
+                op = EditOp::Insert; // L[i][j] == L[i - 1][j]
+
+            if(!script.empty() && script.back().first == op)
+                ++script.back().second;
+            else
+                script.push_back(std::make_pair(op, 1));
+
+            if(op != EditOp::Insert)
+                --j;
+            if(op != EditOp::Delete)
+                --i;
+        }
+        script.push_back(std::make_pair(EditOp::Delete, j));
+        script.push_back(std::make_pair(EditOp::Insert, i));
+        replayReversed(script, builder);
+    }
+    else
+    {
+        builder.deleted(n);
+        builder.inserted(m);
+    }
+
+    builder.equal(nofEqualsAtEnd);
+    builder.finish();
+}
@@ -0,0 +1,70 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef FINEDIFF_H
+#define FINEDIFF_H
+
+#include <QString>
+
+class DiffList;
+
+/*
+    Character level diff of two lines. The result uses the same DiffList format as the line diff,
+    a list of equal ranges each followed by the differing ranges.
+    Engines have no state, so one engine may be used by several threads at once.
+*/
+class FineDiffEngine
+{
+  public:
+    virtual ~FineDiffEngine() = default;
+    virtual void calcDiff(const QString &line1, const QString &line2, DiffList &diffList) const = 0;
+
+    // Returns the engine that is suited best for lines of this length.
+    static const FineDiffEngine &forLines(const QString &line1, const QString &line2);
+};
+
+/*
+    The original search based algorithm, see ::calcDiff(). Gives nice results for ordinary lines
+    but gets slow on long lines.
+*/
+class SearchFineDiff : public FineDiffEngine
+{
+  public:
+    SearchFineDiff(int match, int maxSearchRange): m_match(match), m_maxSearchRange(maxSearchRange) {}
+    void calcDiff(const QString &line1, const QString &line2, DiffList &diffList) const override;
+
+  private:
+    int m_match;
+    int m_maxSearchRange;
+};
+
+/*
+    Myers' O(ND) algorithm. When more than maxCost differences are needed it continues from the
+    point furthest along, so the run time stays in O((N+M) * maxCost) at the price of a
+    possibly not minimal result.
+*/
+class MyersFineDiff : public FineDiffEngine
+{
+  public:
+    explicit MyersFineDiff(int maxCost): m_maxCost(maxCost) {}
+    void calcDiff(const QString &line1, const QString &line2, DiffList &diffList) const override;
+
+  private:
+    int m_maxCost;
+};
+
+/*
+    Longest common subsequence computed 64 characters at a time with bit vectors (Hyyrö).
+    Needs (length of line1 / 64) * length of line2 words of memory, so it is meant for lines of
+    up to a few thousand characters.
+*/
+class BitParallelFineDiff : public FineDiffEngine
+{
+  public:
+    void calcDiff(const QString &line1, const QString &line2, DiffList &diffList) const override;
+};
+
+#endif // !FINEDIFF_H
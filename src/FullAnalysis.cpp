@@ -0,0 +1,681 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "FullAnalysis.h"
+
+#include "fileaccess.h"
+#include "Logging.h"
+#include "MergeEditLine.h"
+#include "progress.h"
+#include "SourceData.h"
+
+#include <QIODevice>
+#include <QTextCodec>
+#include <QVector>
+
+#include <KLocalizedString>
+
+#include <algorithm>
+#include <iterator>
+
+// The inputs and their Diff3Lines, kept for the merge after the comparison.
+struct FullAnalysis::Comparison
+{
+    QSharedPointer<SourceData> sdA = QSharedPointer<SourceData>::create();
+    QSharedPointer<SourceData> sdB = QSharedPointer<SourceData>::create();
+    QSharedPointer<SourceData> sdC = QSharedPointer<SourceData>::create();
+    bool bTwoInputs = true;
+    Diff3LineList diff3LineList;
+};
+
+static void runDiff(ManualDiffHelpList& manualDiffHelpList, const QSharedPointer<Options>& pOptions,
+                    const QSharedPointer<SourceData>& sd1, const QSharedPointer<SourceData>& sd2, DiffList& diffList,
+                    e_SrcSelector winIdx1, e_SrcSelector winIdx2)
+{
+    // Shared data are equal line by line, see SourceData::shareDataOf().
+    if(sd1->sharesDataWith(sd2))
+    {
+        diffList.clear();
+        diffList.setDegraded(false);
+        diffList.push_back(Diff(sd1->getSizeLines(), 0, 0));
+        return;
+    }
+    manualDiffHelpList.runDiff(sd1->getNormalizedLineDataForDiff(pOptions->m_bIgnoreNumbers), sd1->getSizeLines(),
+                               sd2->getNormalizedLineDataForDiff(pOptions->m_bIgnoreNumbers), sd2->getSizeLines(), diffList, winIdx1, winIdx2,
+                               pOptions, sd1->getLineHashesForDiff(pOptions->m_bIgnoreNumbers), sd2->getLineHashesForDiff(pOptions->m_bIgnoreNumbers));
+}
+
+bool FullAnalysis::isAvailable(const QSharedPointer<Options>& pOptions)
+{
+    return !pOptions->m_bRunHistoryAutoMergeOnMergeStart && !pOptions->m_bRunRegExpAutoMergeOnMergeStart;
+}
+
+bool FullAnalysis::isMergeAvailable(const QSharedPointer<Options>& pOptions)
+{
+    // The preprocessor commands are left out too, so their failures are reported as in the GUI.
+    return isAvailable(pOptions) && pOptions->m_IrrelevantMergeCmd.isEmpty() && pOptions->m_PreProcessorCmd.isEmpty() &&
+           pOptions->m_LineMatchingPreProcessorCmd.isEmpty();
+}
+
+QStringList FullAnalysis::run(const QString& fileA, const QString& fileB, const QString& fileC,
+                              const QSharedPointer<Options>& pOptions, TotalDiffStatus& status)
+{
+    Comparison comparison;
+    return compare(fileA, fileB, fileC, pOptions, status, comparison);
+}
+
+QStringList FullAnalysis::compare(const QString& fileA, const QString& fileB, const QString& fileC,
+                                  const QSharedPointer<Options>& pOptions, TotalDiffStatus& status, Comparison& comparison,
+                                  bool bLinesOnly)
+{
+    const QSharedPointer<SourceData>& sdA = comparison.sdA;
+    const QSharedPointer<SourceData>& sdB = comparison.sdB;
+    const QSharedPointer<SourceData>& sdC = comparison.sdC;
+    sdA->setOptions(pOptions);
+    sdB->setOptions(pOptions);
+    sdC->setOptions(pOptions);
+    sdA->setFilename(fileA);
+    sdB->setFilename(fileB);
+    sdC->setFilename(fileC);
+
+    status.reset();
+
+    const bool bTwoInputs = sdC->isEmpty();
+    comparison.bTwoInputs = bTwoInputs;
+    // Inputs with the same bytes and options share the decoded data, as in KDiff3App::mainInit().
+    QStringList errors = sdA->readAndPreprocess(pOptions->m_pEncodingA, pOptions->m_bAutoDetectUnicodeA);
+    const bool bSameOptionsAB = pOptions->m_pEncodingA == pOptions->m_pEncodingB && pOptions->m_bAutoDetectUnicodeA == pOptions->m_bAutoDetectUnicodeB;
+    if(errors.isEmpty() && bSameOptionsAB && sdB->hasEqualFileAs(sdA))
+        sdB->shareDataOf(sdA);
+    else
+        errors += sdB->readAndPreprocess(pOptions->m_pEncodingB, pOptions->m_bAutoDetectUnicodeB);
+    if(!bTwoInputs)
+    {
+        const bool bSameOptionsAC = pOptions->m_pEncodingA == pOptions->m_pEncodingC && pOptions->m_bAutoDetectUnicodeA == pOptions->m_bAutoDetectUnicodeC;
+        const bool bSameOptionsBC = pOptions->m_pEncodingB == pOptions->m_pEncodingC && pOptions->m_bAutoDetectUnicodeB == pOptions->m_bAutoDetectUnicodeC;
+        if(errors.isEmpty() && bSameOptionsAC && sdC->hasEqualFileAs(sdA))
+            sdC->shareDataOf(sdA);
+        else if(errors.isEmpty() && bSameOptionsBC && !sdB->sharesDataWith(sdA) && sdC->hasEqualFileAs(sdB))
+            sdC->shareDataOf(sdB);
+        else
+            errors += sdC->readAndPreprocess(pOptions->m_pEncodingC, pOptions->m_bAutoDetectUnicodeC);
+    }
+    if(!errors.isEmpty())
+        return errors;
+
+    // The same steps as in KDiff3App::mainInit(), without manual alignments.
+    ManualDiffHelpList manualDiffHelpList;
+    DiffList diffList12, diffList13, diffList23;
+    Diff3LineList& diff3LineList = comparison.diff3LineList;
+    if(bTwoInputs)
+    {
+        status.setBinaryEqualAB(sdA->isBinaryEqualWith(sdB));
+        if(sdA->isText() && sdB->isText())
+            runDiff(manualDiffHelpList, pOptions, sdA, sdB, diffList12, e_SrcSelector::A, e_SrcSelector::B);
+    }
+    else
+    {
+        status.setBinaryEqualAB(sdA->isBinaryEqualWith(sdB));
+        status.setBinaryEqualAC(sdA->isBinaryEqualWith(sdC));
+        status.setBinaryEqualBC(sdC->isBinaryEqualWith(sdB));
+
+        if(sdA->isText() && sdB->isText())
+            runDiff(manualDiffHelpList, pOptions, sdA, sdB, diffList12, e_SrcSelector::A, e_SrcSelector::B);
+        if(sdA->isText() && sdC->isText())
+            runDiff(manualDiffHelpList, pOptions, sdA, sdC, diffList13, e_SrcSelector::A, e_SrcSelector::C);
+        if(sdB->isText() && sdC->isText())
+            runDiff(manualDiffHelpList, pOptions, sdB, sdC, diffList23, e_SrcSelector::B, e_SrcSelector::C);
+    }
+    calcDiff3LineList(pOptions, sdA, sdB, sdC, diffList12, diffList13, diffList23, manualDiffHelpList, diff3LineList, status, nullptr, bLinesOnly);
+
+    status.setDiffDegraded(diffList12.isDegraded() || diffList13.isDegraded() || diffList23.isDegraded());
+
+    // Only the merge and the counts of the folder comparison need the white lines and the conflicts.
+    if(!bLinesOnly && sdA->isText() && sdB->isText())
+    {
+        diff3LineList.calcWhiteDiff3Lines(sdA->getLineDataForDiff(), sdB->getLineDataForDiff(), sdC->getLineDataForDiff());
+        countConflicts(diff3LineList, bTwoInputs, status);
+    }
+
+    return errors;
+}
+
+// Sets the information of pp, if given, for the next step.
+static void setStepInformation(ProgressProxy* pp, const QString& info)
+{
+    if(pp == nullptr)
+        return;
+    pp->setInformation(info);
+    qCInfo(kdiffMain) << info;
+}
+
+void FullAnalysis::calcDiff3LineList(const QSharedPointer<Options>& pOptions, const QSharedPointer<SourceData>& sdA,
+                                     const QSharedPointer<SourceData>& sdB, const QSharedPointer<SourceData>& sdC,
+                                     const DiffList& diffList12, const DiffList& diffList13, const DiffList& diffList23,
+                                     ManualDiffHelpList& manualDiffHelpList, Diff3LineList& diff3LineList, TotalDiffStatus& status,
+                                     ProgressProxy* pp, bool bLinesOnly)
+{
+    if(sdC->isEmpty())
+    {
+        setStepInformation(pp, i18n("Linediff: A <-> B"));
+        if(sdA->isText() && sdB->isText())
+        {
+            diff3LineList.calcDiff3LineListUsingAB(&diffList12);
+            status.setTextEqualAB(diff3LineList.fineDiff(e_SrcSelector::A, sdA->getLineDataForDisplay(), sdB->getLineDataForDisplay(), bLinesOnly));
+            if(sdA->getSizeBytes() == 0)
+                status.setTextEqualAB(false);
+        }
+        if(pp != nullptr)
+            pp->step();
+        return;
+    }
+
+    if(sdA->isText() && sdB->isText())
+        diff3LineList.calcDiff3LineListUsingAB(&diffList12);
+
+    if(sdA->isText() && sdC->isText())
+    {
+        diff3LineList.calcDiff3LineListUsingAC(&diffList13);
+        diff3LineList.correctManualDiffAlignment(&manualDiffHelpList);
+        diff3LineList.calcDiff3LineListTrim(sdA->getLineDataForDiff(), sdB->getLineDataForDiff(), sdC->getLineDataForDiff(), &manualDiffHelpList);
+    }
+
+    if(sdB->isText() && sdC->isText() && pOptions->m_bDiff3AlignBC)
+    {
+        diff3LineList.calcDiff3LineListUsingBC(&diffList23);
+        diff3LineList.correctManualDiffAlignment(&manualDiffHelpList);
+        diff3LineList.calcDiff3LineListTrim(sdA->getLineDataForDiff(), sdB->getLineDataForDiff(), sdC->getLineDataForDiff(), &manualDiffHelpList);
+    }
+
+    diff3LineList.debugLineCheck(sdA->getSizeLines(), e_SrcSelector::A);
+    diff3LineList.debugLineCheck(sdB->getSizeLines(), e_SrcSelector::B);
+    diff3LineList.debugLineCheck(sdC->getSizeLines(), e_SrcSelector::C);
+
+    setStepInformation(pp, i18n("Linediff: A <-> B"));
+    if(sdA->hasData() && sdB->hasData() && sdA->isText() && sdB->isText())
+        status.setTextEqualAB(diff3LineList.fineDiff(e_SrcSelector::A, sdA->getLineDataForDisplay(), sdB->getLineDataForDisplay(), bLinesOnly));
+    if(pp != nullptr)
+        pp->step();
+
+    setStepInformation(pp, i18n("Linediff: B <-> C"));
+    if(sdB->hasData() && sdC->hasData() && sdB->isText() && sdC->isText())
+        status.setTextEqualBC(diff3LineList.fineDiff(e_SrcSelector::B, sdB->getLineDataForDisplay(), sdC->getLineDataForDisplay(), bLinesOnly));
+    if(pp != nullptr)
+        pp->step();
+
+    setStepInformation(pp, i18n("Linediff: A <-> C"));
+    if(sdA->hasData() && sdC->hasData() && sdA->isText() && sdC->isText())
+        status.setTextEqualAC(diff3LineList.fineDiff(e_SrcSelector::C, sdC->getLineDataForDisplay(), sdA->getLineDataForDisplay(), bLinesOnly));
+    if(pp != nullptr)
+        pp->step();
+
+    if(sdA->getSizeBytes() == 0)
+    {
+        status.setTextEqualAB(false);
+        status.setTextEqualAC(false);
+    }
+    if(sdB->getSizeBytes() == 0)
+    {
+        status.setTextEqualAB(false);
+        status.setTextEqualBC(false);
+    }
+}
+
+FullAnalysis::e_MergeResult FullAnalysis::merge(const QString& fileA, const QString& fileB, const QString& fileC, const QString& outputFile,
+                                                const QSharedPointer<Options>& pOptions, TotalDiffStatus& status, QStringList& errors)
+{
+    Comparison comparison;
+    errors = compare(fileA, fileB, fileC, pOptions, status, comparison);
+    if(!errors.isEmpty())
+        return e_MergeResult::Failed;
+
+    const bool bTwoInputs = comparison.bTwoInputs;
+    FileAccess output(outputFile, true /*bWantToWrite*/);
+
+    const e_SrcSelector wholeFile = wholeFileResult(status, bTwoInputs);
+    if(wholeFile != e_SrcSelector::None)
+    {
+        const QSharedPointer<SourceData>& pSD = wholeFile == e_SrcSelector::A ? comparison.sdA :
+                                                wholeFile == e_SrcSelector::B ? comparison.sdB : comparison.sdC;
+        if(pOptions->m_bDmCreateBakFiles && output.exists())
+            output.createBackup(".orig");
+
+        if(!pSD->saveNormalDataAs(outputFile))
+        {
+            errors.append(i18n("Saving failed."));
+            return e_MergeResult::Failed;
+        }
+        return e_MergeResult::Saved;
+    }
+
+    const QSharedPointer<SourceData>& sdA = comparison.sdA;
+    const QSharedPointer<SourceData>& sdB = comparison.sdB;
+    const QSharedPointer<SourceData>& sdC = comparison.sdC;
+    // Binary files are compared, but not merged.
+    if(!sdA->isText() || !sdB->isText() || (!bTwoInputs && !sdC->isText()))
+        return e_MergeResult::Unsolved;
+
+    // The same steps as MergeResultWindow::merge() on init.
+    MergeLineList mergeLineList;
+    mergeLineList.build(comparison.diff3LineList, bTwoInputs);
+    const e_SrcSelector whiteSpaceMergeDefault = MergeLineList::whiteSpaceMergeDefault(pOptions, bTwoInputs);
+    if(whiteSpaceMergeDefault != e_SrcSelector::None)
+        mergeLineList.chooseDeltas(whiteSpaceMergeDefault, false, true);
+    mergeLineList.removeEmptyEditLines();
+
+    if(mergeLineList.nofUnsolvedConflicts() > 0)
+        return e_MergeResult::Unsolved;
+
+    const e_LineEndStyle eLineEndStyle = outputLineEndStyle(pOptions, sdA->getLineEndStyle(), sdB->getLineEndStyle(), sdC->getLineEndStyle());
+    if(eLineEndStyle == eLineEndStyleConflict || eLineEndStyle == eLineEndStyleUndefined)
+        return e_MergeResult::Unsolved;
+
+    if(pOptions->m_bDmCreateBakFiles && output.exists() && !output.createBackup(".orig"))
+    {
+        errors.append(output.getStatusText() + i18n("\n\nCreating backup failed. File not saved."));
+        return e_MergeResult::Failed;
+    }
+
+    QTextCodec* pEncoding = outputEncoding(pOptions, sdA->getEncoding(), sdB->getEncoding(), bTwoInputs ? nullptr : sdC->getEncoding());
+    if(!mergeLineList.writeFile(output, pEncoding, eLineEndStyle, sdA->getLineDataForDisplay(), sdB->getLineDataForDisplay(),
+                                bTwoInputs ? nullptr : sdC->getLineDataForDisplay()))
+    {
+        errors.append(i18n("Error while writing."));
+        return e_MergeResult::Failed;
+    }
+    return e_MergeResult::Saved;
+}
+
+// The lines of an input as the diff output writes them, with the line end of that input.
+struct DiffOutputText
+{
+    const QVector<LineData>* pLineData = nullptr;
+    LineRef nofLines = 0;
+    QString lineEnd;
+    bool bFinalLineEnd = true;
+};
+
+static DiffOutputText diffOutputText(const QSharedPointer<SourceData>& sd)
+{
+    DiffOutputText text;
+    text.pLineData = sd->getLineDataForDisplay();
+    text.nofLines = sd->getSizeLines();
+    text.lineEnd = sd->getLineEndStyle() == eLineEndStyleDos ? QStringLiteral("\r\n") : QStringLiteral("\n");
+    text.bFinalLineEnd = sd->hasFinalLineEnd();
+    return text;
+}
+
+static bool isWithoutLineEnd(const DiffOutputText& text, LineRef line)
+{
+    return line + 1 == text.nofLines && !text.bFinalLineEnd;
+}
+
+/*
+    Lines missing in both inputs are equal too, the flags of the Diff3Line don't tell that. As for
+    diff a last line without line end differs from the same text with one.
+*/
+static bool linesEqual(const Diff3Line& d3l, e_SrcSelector src1, e_SrcSelector src2, const DiffOutputText texts[3])
+{
+    const LineRef line1 = d3l.getLineInFile(src1);
+    const LineRef line2 = d3l.getLineInFile(src2);
+    if(!line1.isValid() || !line2.isValid())
+        return !line1.isValid() && !line2.isValid();
+    if(isWithoutLineEnd(texts[(int)src1 - 1], line1) != isWithoutLineEnd(texts[(int)src2 - 1], line2))
+        return false;
+
+    if(src1 == e_SrcSelector::A && src2 == e_SrcSelector::B)
+        return d3l.isEqualAB();
+    if(src1 == e_SrcSelector::A && src2 == e_SrcSelector::C)
+        return d3l.isEqualAC();
+    return d3l.isEqualBC();
+}
+
+// A last line without line end gets the marker diff writes after it.
+static void appendLine(QString& hunk, const QString& prefix, const DiffOutputText& text, LineRef line)
+{
+    hunk += prefix;
+    hunk += (*text.pLineData)[line].getLine();
+    if(isWithoutLineEnd(text, line))
+        hunk += QStringLiteral("\n\\ No newline at end of file\n");
+    else
+        hunk += text.lineEnd;
+}
+
+static bool writeHunk(const QString& hunk, QTextEncoder& encoder, QIODevice& device)
+{
+    const QByteArray encoded = encoder.fromUnicode(hunk);
+    return device.write(encoded) == encoded.size();
+}
+
+// The line numbers of a hunk as diff writes them, the first line counts from 1 unless the range is empty.
+static QString unifiedRange(int nofLinesBefore, int nofLines)
+{
+    return QString::number(nofLines > 0 ? nofLinesBefore + 1 : nofLinesBefore) + QLatin1Char(',') + QString::number(nofLines);
+}
+
+static bool writeUnifiedDiff(const Diff3LineList& diff3LineList, const DiffOutputText texts[3], const QStringList& names, QTextEncoder& encoder, QIODevice& device, bool& bDifferent)
+{
+    static const int nofContextLines = 3;
+    int nofLinesA = 0, nofLinesB = 0; // Before i
+    int nofEqualBefore = 0;           // Lines equal in both inputs since the last hunk
+    Diff3LineList::const_iterator i = diff3LineList.begin();
+    while(i != diff3LineList.end())
+    {
+        if(linesEqual(*i, e_SrcSelector::A, e_SrcSelector::B, texts))
+        {
+            ++nofLinesA;
+            ++nofLinesB;
+            ++nofEqualBefore;
+            ++i;
+            continue;
+        }
+
+        // Hunks closer than twice the context are joined.
+        const int nofContextBefore = std::min(nofEqualBefore, nofContextLines);
+        const Diff3LineList::const_iterator begin = std::prev(i, nofContextBefore);
+        Diff3LineList::const_iterator end = i;
+        while(end != diff3LineList.end())
+        {
+            if(!linesEqual(*end, e_SrcSelector::A, e_SrcSelector::B, texts))
+            {
+                ++end;
+                continue;
+            }
+            int nofEqual = 0;
+            Diff3LineList::const_iterator afterEqual = end;
+            while(afterEqual != diff3LineList.end() && linesEqual(*afterEqual, e_SrcSelector::A, e_SrcSelector::B, texts))
+            {
+                ++nofEqual;
+                ++afterEqual;
+            }
+            if(afterEqual == diff3LineList.end() || nofEqual > 2 * nofContextLines)
+            {
+                std::advance(end, std::min(nofEqual, nofContextLines));
+                break;
+            }
+            end = afterEqual;
+        }
+
+        // The context lines before lie in both inputs.
+        const int hunkLinesBeforeA = nofLinesA - nofContextBefore;
+        const int hunkLinesBeforeB = nofLinesB - nofContextBefore;
+        int hunkLinesA = 0, hunkLinesB = 0;
+        for(Diff3LineList::const_iterator j = begin; j != end; ++j)
+        {
+            if(j->getLineA().isValid())
+                ++hunkLinesA;
+            if(j->getLineB().isValid())
+                ++hunkLinesB;
+        }
+
+        QString hunk;
+        if(!bDifferent)
+            hunk += QStringLiteral("--- ") + names.value(0) + QStringLiteral("\n+++ ") + names.value(1) + QLatin1Char('\n');
+        hunk += QStringLiteral("@@ -") + unifiedRange(hunkLinesBeforeA, hunkLinesA) + QStringLiteral(" +") + unifiedRange(hunkLinesBeforeB, hunkLinesB) +
+                QStringLiteral(" @@\n");
+        for(Diff3LineList::const_iterator j = begin; j != end;)
+        {
+            if(linesEqual(*j, e_SrcSelector::A, e_SrcSelector::B, texts))
+            {
+                appendLine(hunk, QStringLiteral(" "), texts[0], j->getLineA());
+                ++j;
+                continue;
+            }
+            // The removed lines of a change come before the added ones.
+            Diff3LineList::const_iterator changeEnd = j;
+            while(changeEnd != end && !linesEqual(*changeEnd, e_SrcSelector::A, e_SrcSelector::B, texts))
+                ++changeEnd;
+            for(Diff3LineList::const_iterator k = j; k != changeEnd; ++k)
+            {
+                if(k->getLineA().isValid())
+                    appendLine(hunk, QStringLiteral("-"), texts[0], k->getLineA());
+            }
+            for(Diff3LineList::const_iterator k = j; k != changeEnd; ++k)
+            {
+                if(k->getLineB().isValid())
+                    appendLine(hunk, QStringLiteral("+"), texts[1], k->getLineB());
+            }
+            j = changeEnd;
+        }
+
+        bDifferent = true;
+        if(!writeHunk(hunk, encoder, device))
+            return false;
+
+        nofLinesA = hunkLinesBeforeA + hunkLinesA;
+        nofLinesB = hunkLinesBeforeB + hunkLinesB;
+        nofEqualBefore = 0;
+        i = end;
+    }
+    return true;
+}
+
+static bool writeDiff3(const Diff3LineList& diff3LineList, const DiffOutputText texts[3], QTextEncoder& encoder, QIODevice& device, bool& bDifferent)
+{
+    static const e_SrcSelector sources[3] = {e_SrcSelector::A, e_SrcSelector::B, e_SrcSelector::C};
+    int nofLinesBefore[3] = {0, 0, 0};
+    Diff3LineList::const_iterator i = diff3LineList.begin();
+    while(i != diff3LineList.end())
+    {
+        const Diff3LineList::const_iterator begin = i;
+        bool bEqualAB = true, bEqualAC = true, bEqualBC = true;
+        for(; i != diff3LineList.end(); ++i)
+        {
+            const bool bLineEqualAB = linesEqual(*i, e_SrcSelector::A, e_SrcSelector::B, texts);
+            const bool bLineEqualAC = linesEqual(*i, e_SrcSelector::A, e_SrcSelector::C, texts);
+            if(bLineEqualAB && bLineEqualAC)
+                break;
+            bEqualAB = bEqualAB && bLineEqualAB;
+            bEqualAC = bEqualAC && bLineEqualAC;
+            bEqualBC = bEqualBC && linesEqual(*i, e_SrcSelector::B, e_SrcSelector::C, texts);
+        }
+
+        if(i == begin)
+        {
+            for(int f = 0; f < 3; ++f)
+            {
+                if(i->getLineInFile(sources[f]).isValid())
+                    ++nofLinesBefore[f];
+            }
+            ++i;
+            continue;
+        }
+
+        // The number of the input that differs, the text of two equal inputs is only written after the second.
+        QString hunk = bEqualBC ? QStringLiteral("====1\n") : bEqualAC ? QStringLiteral("====2\n") : bEqualAB ? QStringLiteral("====3\n") : QStringLiteral("====\n");
+        const int textlessInput = bEqualBC ? 1 : bEqualAC || bEqualAB ? 0 : -1;
+        for(int f = 0; f < 3; ++f)
+        {
+            int nofLines = 0;
+            for(Diff3LineList::const_iterator j = begin; j != i; ++j)
+            {
+                if(j->getLineInFile(sources[f]).isValid())
+                    ++nofLines;
+            }
+
+            hunk += QString::number(f + 1) + QLatin1Char(':');
+            if(nofLines == 0)
+                hunk += QString::number(nofLinesBefore[f]) + QStringLiteral("a\n");
+            else if(nofLines == 1)
+                hunk += QString::number(nofLinesBefore[f] + 1) + QStringLiteral("c\n");
+            else
+                hunk += QString::number(nofLinesBefore[f] + 1) + QLatin1Char(',') + QString::number(nofLinesBefore[f] + nofLines) + QStringLiteral("c\n");
+
+            if(f != textlessInput)
+            {
+                for(Diff3LineList::const_iterator j = begin; j != i; ++j)
+                {
+                    const LineRef line = j->getLineInFile(sources[f]);
+                    if(line.isValid())
+                        appendLine(hunk, QStringLiteral("  "), texts[f], line);
+                }
+            }
+            nofLinesBefore[f] += nofLines;
+        }
+
+        bDifferent = true;
+        if(!writeHunk(hunk, encoder, device))
+            return false;
+    }
+    return true;
+}
+
+int FullAnalysis::writeDiff(const QString& fileA, const QString& fileB, const QString& fileC, const QStringList& names,
+                            const QSharedPointer<Options>& pOptions, QIODevice& device, QStringList& errors)
+{
+    Comparison comparison;
+    TotalDiffStatus status;
+    // The equality of the lines is all the output needs, the fine diffs are left pending.
+    errors = compare(fileA, fileB, fileC, pOptions, status, comparison, true);
+    if(!errors.isEmpty())
+        return 2;
+
+    const bool bTwoInputs = comparison.bTwoInputs;
+    const QSharedPointer<SourceData>& sdA = comparison.sdA;
+    const QSharedPointer<SourceData>& sdB = comparison.sdB;
+    const QSharedPointer<SourceData>& sdC = comparison.sdC;
+    if(!sdA->isText() || !sdB->isText() || (!bTwoInputs && !sdC->isText()))
+    {
+        const bool bEqual = status.isBinaryEqualAB() && (bTwoInputs || status.isBinaryEqualAC());
+        const QByteArray message = (bTwoInputs ? i18n("Binary files %1 and %2 differ", names.value(0), names.value(1)) :
+                                                 i18n("Binary files %1, %2 and %3 differ", names.value(0), names.value(1), names.value(2))).toUtf8() + '\n';
+        if(!bEqual && device.write(message) != message.size())
+        {
+            errors.append(i18n("Error while writing."));
+            return 2;
+        }
+        return bEqual ? 0 : 1;
+    }
+
+    // The encoding a merge result would get, a byte order mark only for UTF-16 and the like as in MergeLineList::write().
+    QTextCodec* pEncoding = outputEncoding(pOptions, sdA->getEncoding(), sdB->getEncoding(), bTwoInputs ? nullptr : sdC->getEncoding());
+    QTextEncoder encoder(pEncoding, pEncoding->name() == "UTF-8" ? QTextCodec::IgnoreHeader : QTextCodec::DefaultConversion);
+
+    bool bDifferent = false;
+    const DiffOutputText texts[3] = {diffOutputText(sdA), diffOutputText(sdB), diffOutputText(sdC)};
+    const bool bWritten = bTwoInputs ? writeUnifiedDiff(comparison.diff3LineList, texts, names, encoder, device, bDifferent) :
+                                       writeDiff3(comparison.diff3LineList, texts, encoder, device, bDifferent);
+    if(!bWritten)
+    {
+        errors.append(i18n("Error while writing."));
+        return 2;
+    }
+    if(status.isDiffDegraded())
+        errors.append(i18n("The diff time limit was reached, differences may be larger than necessary."));
+    return bDifferent ? 1 : 0;
+}
+
+e_SrcSelector FullAnalysis::wholeFileResult(const TotalDiffStatus& status, bool bTwoInputs)
+{
+    if(bTwoInputs)
+        return status.isBinaryEqualAB() ? e_SrcSelector::A : e_SrcSelector::None;
+
+    if(status.isBinaryEqualBC() || status.isBinaryEqualAB())
+        return e_SrcSelector::C; // if B==C (assume A is old), if A==B then C has changed
+    if(status.isBinaryEqualAC())
+        return e_SrcSelector::B; // assuming B has changed
+    return e_SrcSelector::None;
+}
+
+e_LineEndStyle FullAnalysis::outputLineEndStyle(const QSharedPointer<Options>& pOptions, e_LineEndStyle eLineEndStyleA,
+                                                e_LineEndStyle eLineEndStyleB, e_LineEndStyle eLineEndStyleC)
+{
+    if(pOptions->m_lineEndStyle != eLineEndStyleAutoDetect)
+        return (e_LineEndStyle)pOptions->m_lineEndStyle;
+
+    if(eLineEndStyleA != eLineEndStyleUndefined && eLineEndStyleB != eLineEndStyleUndefined && eLineEndStyleC != eLineEndStyleUndefined)
+    {
+        if(eLineEndStyleA == eLineEndStyleB)
+            return eLineEndStyleC;
+        else if(eLineEndStyleA == eLineEndStyleC)
+            return eLineEndStyleB;
+        else
+            return eLineEndStyleConflict; //conflict (not likely while only two values exist)
+    }
+
+    e_LineEndStyle c1, c2;
+    if(eLineEndStyleA == eLineEndStyleUndefined)
+    {
+        c1 = eLineEndStyleB;
+        c2 = eLineEndStyleC;
+    }
+    else if(eLineEndStyleB == eLineEndStyleUndefined)
+    {
+        c1 = eLineEndStyleA;
+        c2 = eLineEndStyleC;
+    }
+    else /*if( eLineEndStyleC == eLineEndStyleUndefined )*/
+    {
+        c1 = eLineEndStyleA;
+        c2 = eLineEndStyleB;
+    }
+    return c1 == c2 && c1 != eLineEndStyleUndefined ? c1 : eLineEndStyleConflict;
+}
+
+// Mirrors the choice of WindowTitleWidget::setEncodings().
+QTextCodec* FullAnalysis::outputEncoding(const QSharedPointer<Options>& pOptions, QTextCodec* pCodecA, QTextCodec* pCodecB, QTextCodec* pCodecC)
+{
+    if(!pOptions->m_bAutoSelectOutEncoding && pOptions->m_pEncodingOut != nullptr)
+        return pOptions->m_pEncodingOut;
+
+    if(pCodecA != nullptr && pCodecB != nullptr && pCodecC != nullptr)
+        return pCodecA == pCodecC ? pCodecB : pCodecC;
+    if(pCodecA != nullptr && pCodecB != nullptr)
+        return pCodecB;
+    if(pCodecA != nullptr)
+        return pCodecA;
+    return pCodecB != nullptr ? pCodecB : pCodecC;
+}
+
+static void countMergeLine(const MergeLine& ml, int& nrOfSolvedConflicts, int& nrOfUnsolvedConflicts, int& nrOfWhiteSpaceConflicts)
+{
+    if(ml.bConflict)
+        ++nrOfUnsolvedConflicts;
+    else if(ml.bDelta)
+        ++nrOfSolvedConflicts;
+
+    if(ml.bWhiteSpaceConflict)
+        ++nrOfWhiteSpaceConflicts;
+}
+
+// Counts the merge lines MergeResultWindow::merge() makes of the Diff3Lines, without building them.
+void FullAnalysis::countConflicts(const Diff3LineList& diff3LineList, bool bTwoInputs, TotalDiffStatus& status)
+{
+    int nrOfSolvedConflicts = 0;
+    int nrOfUnsolvedConflicts = 0;
+    int nrOfWhiteSpaceConflicts = 0;
+
+    MergeLine back;
+    bool bHasBack = false;
+    int lineIdx = 0;
+    for(Diff3LineList::const_iterator it = diff3LineList.begin(); it != diff3LineList.end(); ++it, ++lineIdx)
+    {
+        MergeLine ml;
+        bool bLineRemoved;
+        ml.init(it, lineIdx, bTwoInputs, bLineRemoved);
+
+        if(bHasBack && ml.isSameKind(back))
+        {
+            if(back.bWhiteSpaceConflict && !ml.bWhiteSpaceConflict)
+                back.bWhiteSpaceConflict = false;
+        }
+        else
+        {
+            if(bHasBack)
+                countMergeLine(back, nrOfSolvedConflicts, nrOfUnsolvedConflicts, nrOfWhiteSpaceConflicts);
+            back = ml;
+            bHasBack = true;
+        }
+    }
+
+    if(bHasBack)
+        countMergeLine(back, nrOfSolvedConflicts, nrOfUnsolvedConflicts, nrOfWhiteSpaceConflicts);
+
+    status.setUnsolvedConflicts(nrOfUnsolvedConflicts);
+    status.setSolvedConflicts(nrOfSolvedConflicts);
+    status.setWhitespaceConflicts(nrOfWhiteSpaceConflicts);
+}
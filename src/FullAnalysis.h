@@ -0,0 +1,98 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef FULLANALYSIS_H
+#define FULLANALYSIS_H
+
+#include "diff.h"
+#include "options.h"
+
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+class ProgressProxy;
+class QIODevice;
+class QTextCodec;
+class SourceData;
+
+/*
+    The full analysis of the folder comparison and the automatic merge of --auto: loads, compares
+    and merges the files like KDiff3App::mainInit() does, but keeps all data to itself. So several
+    files can be analyzed at once on pool threads while the GUI stays responsive, and files that
+    need no decision of the user are merged without building the GUI at all.
+*/
+class FullAnalysis
+{
+  public:
+    enum class e_MergeResult
+    {
+        Saved,    // The output file was written.
+        Unsolved, // Conflicts or the line end style are left for the user, nothing was written.
+        Failed    // See the error messages.
+    };
+
+    // False if the options need the merge result window, like the automatic merges run on merge start.
+    static bool isAvailable(const QSharedPointer<Options>& pOptions);
+    // Also false if the merge needs the commands run from the GUI.
+    static bool isMergeAvailable(const QSharedPointer<Options>& pOptions);
+
+    /*
+        Analyzes local files, an empty name stands for a missing one and without fileC two files are
+        compared. Returns the error messages, the result is stored in status.
+    */
+    static QStringList run(const QString& fileA, const QString& fileB, const QString& fileC,
+                           const QSharedPointer<Options>& pOptions, TotalDiffStatus& status);
+
+    /*
+        Merges local files into outputFile as --auto does: an unchanged input is copied as it is,
+        otherwise the merge result is saved if no conflict is left. The result of the comparison
+        is stored in status.
+    */
+    static e_MergeResult merge(const QString& fileA, const QString& fileB, const QString& fileC, const QString& outputFile,
+                               const QSharedPointer<Options>& pOptions, TotalDiffStatus& status, QStringList& errors);
+
+    /*
+        Writes the differences of the inputs to device as --diff-output does: a unified diff of two
+        inputs with names in its header, or the hunks of three inputs in the layout of diff3. The
+        inputs are read and diffed as a whole first, without the fine diffs within the lines. Then
+        each hunk is written while walking the Diff3Lines. The lines keep the line ends of their
+        input and the output gets the encoding a merge result would. Returns 0 without differences,
+        1 with and 2 on errors, as diff does.
+    */
+    static int writeDiff(const QString& fileA, const QString& fileB, const QString& fileC, const QStringList& names,
+                         const QSharedPointer<Options>& pOptions, QIODevice& device, QStringList& errors);
+
+    /*
+        Combines the diffs of the inputs to diff3LineList and compares the lines within, the steps
+        after the diffs that KDiff3App::mainInit() shares with the comparisons here. Only inputs
+        that are text are used, the text equalities are stored in status. If pp is given it gets a
+        step for each fine diff. With bLinesOnly the fine diffs are left pending.
+    */
+    static void calcDiff3LineList(const QSharedPointer<Options>& pOptions, const QSharedPointer<SourceData>& sdA,
+                                  const QSharedPointer<SourceData>& sdB, const QSharedPointer<SourceData>& sdC,
+                                  const DiffList& diffList12, const DiffList& diffList13, const DiffList& diffList23,
+                                  ManualDiffHelpList& manualDiffHelpList, Diff3LineList& diff3LineList, TotalDiffStatus& status,
+                                  ProgressProxy* pp, bool bLinesOnly = false);
+
+    // The input that is the merge result as a whole, or e_SrcSelector::None if it must be merged.
+    static e_SrcSelector wholeFileResult(const TotalDiffStatus& status, bool bTwoInputs);
+    // The line end style the merge result gets if the user doesn't choose one.
+    static e_LineEndStyle outputLineEndStyle(const QSharedPointer<Options>& pOptions, e_LineEndStyle eLineEndStyleA,
+                                             e_LineEndStyle eLineEndStyleB, e_LineEndStyle eLineEndStyleC);
+    // The encoding the merge result gets if the user doesn't choose one, a null codec stands for a missing input.
+    static QTextCodec* outputEncoding(const QSharedPointer<Options>& pOptions, QTextCodec* pCodecA, QTextCodec* pCodecB, QTextCodec* pCodecC);
+
+  private:
+    struct Comparison;
+
+    static QStringList compare(const QString& fileA, const QString& fileB, const QString& fileC,
+                               const QSharedPointer<Options>& pOptions, TotalDiffStatus& status, Comparison& comparison,
+                               bool bLinesOnly = false);
+    static void countConflicts(const Diff3LineList& diff3LineList, bool bTwoInputs, TotalDiffStatus& status);
+};
+
+#endif // !FULLANALYSIS_H
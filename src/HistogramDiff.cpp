@@ -0,0 +1,153 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "HistogramDiff.h"
+
+#include <algorithm>
+
+HistogramDiff::HistogramDiff(const QVector<qint32>& lines1, const QVector<qint32>& lines2, qint32 nofClasses):
+    m_lines1(lines1), m_lines2(lines2), m_count(nofClasses, 0), m_first(nofClasses, -1), m_next(lines1.size(), -1)
+{
+}
+
+QVector<HistogramDiff::Segment> HistogramDiff::run()
+{
+    m_segments.clear();
+
+    // Ranges still to do, the next one is at the back.
+    QVector<Range> todo;
+    todo.push_back(Range{false, 0, m_lines1.size(), 0, m_lines2.size()});
+
+    while(!todo.isEmpty())
+    {
+        Range range = todo.back();
+        todo.pop_back();
+
+        if(range.bEqual)
+        {
+            addSegment(SegmentType::Equal, range.begin1, range.end1 - range.begin1, range.begin2, range.end2 - range.begin2);
+            continue;
+        }
+
+        qint32 nofEquals = 0;
+        while(range.begin1 + nofEquals < range.end1 && range.begin2 + nofEquals < range.end2 &&
+              m_lines1[range.begin1 + nofEquals] == m_lines2[range.begin2 + nofEquals])
+            ++nofEquals;
+        addSegment(SegmentType::Equal, range.begin1, nofEquals, range.begin2, nofEquals);
+        range.begin1 += nofEquals;
+        range.begin2 += nofEquals;
+
+        nofEquals = 0;
+        while(range.begin1 < range.end1 - nofEquals && range.begin2 < range.end2 - nofEquals &&
+              m_lines1[range.end1 - nofEquals - 1] == m_lines2[range.end2 - nofEquals - 1])
+            ++nofEquals;
+        if(nofEquals > 0)
+        {
+            todo.push_back(Range{true, range.end1 - nofEquals, range.end1, range.end2 - nofEquals, range.end2});
+            range.end1 -= nofEquals;
+            range.end2 -= nofEquals;
+        }
+
+        Range anchor;
+        bool bHasCommonLines = false;
+        if(range.begin1 == range.end1 || range.begin2 == range.end2 || !findAnchor(range, anchor, bHasCommonLines))
+        {
+            addSegment(bHasCommonLines ? SegmentType::Unresolved : SegmentType::Changed,
+                       range.begin1, range.end1 - range.begin1, range.begin2, range.end2 - range.begin2);
+            continue;
+        }
+
+        todo.push_back(Range{false, anchor.end1, range.end1, anchor.end2, range.end2});
+        todo.push_back(anchor);
+        todo.push_back(Range{false, range.begin1, anchor.begin1, range.begin2, anchor.begin2});
+    }
+
+    return m_segments;
+}
+
+void HistogramDiff::addSegment(SegmentType type, qint32 begin1, qint32 size1, qint32 begin2, qint32 size2)
+{
+    if(size1 == 0 && size2 == 0)
+        return;
+
+    if(type != SegmentType::Unresolved && !m_segments.isEmpty() && m_segments.back().type == type)
+    {
+        m_segments.back().size1 += size1;
+        m_segments.back().size2 += size2;
+        return;
+    }
+
+    m_segments.push_back(Segment{type, begin1, size1, begin2, size2});
+}
+
+bool HistogramDiff::findAnchor(const Range& range, Range& anchor, bool& bHasCommonLines)
+{
+    // Backwards, so each chain starts with the first occurrence.
+    for(qint32 i = range.end1 - 1; i >= range.begin1; --i)
+    {
+        const qint32 c = m_lines1[i];
+        if(m_count[c] == 0)
+            m_first[c] = -1;
+        m_next[i] = m_first[c];
+        m_first[c] = i;
+        ++m_count[c];
+    }
+
+    qint32 bestCount = maxChainLength;
+    qint32 bestLength = 0;
+    bHasCommonLines = false;
+    for(qint32 j = range.begin2; j < range.end2;)
+    {
+        const qint32 c = m_lines2[j];
+        qint32 nextJ = j + 1;
+        if(m_count[c] > 0)
+        {
+            bHasCommonLines = true;
+            if(m_count[c] <= bestCount)
+            {
+                for(qint32 i = m_first[c]; i != -1; i = m_next[i])
+                {
+                    // Grow the run of equal lines in both directions.
+                    qint32 minCount = m_count[c];
+                    qint32 begin1 = i;
+                    qint32 begin2 = j;
+                    while(begin1 > range.begin1 && begin2 > range.begin2 && m_lines1[begin1 - 1] == m_lines2[begin2 - 1])
+                    {
+                        --begin1;
+                        --begin2;
+                        minCount = std::min(minCount, m_count[m_lines1[begin1]]);
+                    }
+
+                    qint32 end1 = i + 1;
+                    qint32 end2 = j + 1;
+                    while(end1 < range.end1 && end2 < range.end2 && m_lines1[end1] == m_lines2[end2])
+                    {
+                        minCount = std::min(minCount, m_count[m_lines1[end1]]);
+                        ++end1;
+                        ++end2;
+                    }
+
+                    // All lines of this run in lines2 lead to the same result.
+                    nextJ = std::max(nextJ, end2);
+
+                    if(end1 - begin1 > bestLength || minCount < bestCount)
+                    {
+                        anchor = Range{true, begin1, end1, begin2, end2};
+                        bestLength = end1 - begin1;
+                        bestCount = minCount;
+                    }
+                }
+            }
+        }
+        j = nextJ;
+    }
+
+    for(qint32 i = range.begin1; i < range.end1; ++i)
+        m_count[m_lines1[i]] = 0;
+
+    return bestLength > 0;
+}
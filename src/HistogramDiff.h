@@ -0,0 +1,70 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef HISTOGRAMDIFF_H
+#define HISTOGRAMDIFF_H
+
+#include <QtGlobal>
+#include <QVector>
+
+/*
+    Line diff in the style of git's histogram diff. Lines are given as equivalence class numbers
+    in the range [0, nofClasses), equal numbers stand for equal lines.
+    A range is split at the longest run of common lines that contains the line occurring least often
+    in the first range, the parts before and after that run are handled the same way.
+*/
+class HistogramDiff
+{
+  public:
+    enum class SegmentType
+    {
+        Equal,
+        Changed,
+        Unresolved // Only lines occurring too often to anchor on, needs another algorithm.
+    };
+
+    struct Segment
+    {
+        SegmentType type;
+        qint32 begin1;
+        qint32 size1;
+        qint32 begin2;
+        qint32 size2;
+    };
+
+    HistogramDiff(const QVector<qint32>& lines1, const QVector<qint32>& lines2, qint32 nofClasses);
+
+    // Returns the segments covering both inputs in order.
+    QVector<Segment> run();
+
+  private:
+    struct Range
+    {
+        bool bEqual; // Already known to be equal, just append it.
+        qint32 begin1;
+        qint32 end1;
+        qint32 begin2;
+        qint32 end2;
+    };
+
+    void addSegment(SegmentType type, qint32 begin1, qint32 size1, qint32 begin2, qint32 size2);
+    bool findAnchor(const Range& range, Range& anchor, bool& bHasCommonLines);
+
+    // Lines occurring more often in a range are not used as anchor.
+    static constexpr qint32 maxChainLength = 64;
+
+    const QVector<qint32>& m_lines1;
+    const QVector<qint32>& m_lines2;
+
+    // Occurrences of each class in the first range, linked from the first to the last one.
+    QVector<qint32> m_count;
+    QVector<qint32> m_first;
+    QVector<qint32> m_next;
+
+    QVector<Segment> m_segments;
+};
+
+#endif // !HISTOGRAMDIFF_H
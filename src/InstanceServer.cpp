@@ -0,0 +1,165 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "InstanceServer.h"
+
+#include "defmac.h"
+#include "kdiff3_shell.h"
+#include "StreamInput.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QStringList>
+#include <QUrl>
+
+#include <KAboutData>
+
+InstanceServer* InstanceServer::s_pInstance = nullptr;
+
+QString InstanceServer::serverName()
+{
+#ifdef Q_OS_WIN
+    const QString userName = QString::fromLocal8Bit(qgetenv("USERNAME"));
+#else
+    const QString userName = QString::fromLocal8Bit(qgetenv("USER"));
+#endif
+    return userName.isEmpty() ? QStringLiteral("kdiff3") : QStringLiteral("kdiff3-") + userName;
+}
+
+InstanceServer::InstanceServer(QObject* pParent)
+    : QObject(pParent), m_pServer(new QLocalServer(this))
+{
+    chk_connect_a(m_pServer, &QLocalServer::newConnection, this, &InstanceServer::slotNewConnection);
+}
+
+InstanceServer::~InstanceServer()
+{
+    if(s_pInstance == this)
+        s_pInstance = nullptr;
+}
+
+bool InstanceServer::listen()
+{
+    // A server that answers runs already, a socket without one is left over from a crash.
+    QLocalSocket probe;
+    probe.connectToServer(serverName());
+    if(probe.waitForConnected(500))
+        return false;
+
+    QLocalServer::removeServer(serverName());
+    m_pServer->setSocketOptions(QLocalServer::UserAccessOption);
+    if(!m_pServer->listen(serverName()))
+        return false;
+
+    s_pInstance = this;
+    return true;
+}
+
+void InstanceServer::slotNewConnection()
+{
+    while(m_pServer->hasPendingConnections())
+    {
+        QLocalSocket* pSocket = m_pServer->nextPendingConnection();
+        m_requests.insert(pSocket, QByteArray());
+        chk_connect_a(pSocket, &QLocalSocket::readyRead, this, &InstanceServer::slotReadyRead);
+        chk_connect_a(pSocket, &QLocalSocket::disconnected, this, &InstanceServer::slotDisconnected);
+    }
+}
+
+void InstanceServer::slotReadyRead()
+{
+    // Longer requests are no file names.
+    static const int maxRequestSize = 1 << 16;
+
+    QLocalSocket* pSocket = qobject_cast<QLocalSocket*>(sender());
+    if(pSocket == nullptr || !m_requests.contains(pSocket))
+        return;
+
+    QByteArray& request = m_requests[pSocket];
+    request += pSocket->readAll();
+    if(request.size() > maxRequestSize)
+    {
+        pSocket->abort();
+        return;
+    }
+
+    const QByteArray end(2, '\0');
+    if(request != end.left(1) && !request.endsWith(end))
+        return;
+
+    QCommandLineParser parser;
+    const bool bAccepted = parseRequest(request, parser);
+    // The client must not wait for the files to be loaded.
+    pSocket->write(bAccepted ? "1" : "0");
+    pSocket->flush();
+    pSocket->disconnectFromServer();
+
+    if(bAccepted)
+    {
+        // The window reads its arguments while it is made.
+        KDiff3Shell* pShell = new KDiff3Shell(true, &parser);
+        pShell->setAttribute(Qt::WA_DeleteOnClose);
+        pShell->show();
+    }
+}
+
+void InstanceServer::slotDisconnected()
+{
+    QLocalSocket* pSocket = qobject_cast<QLocalSocket*>(sender());
+    if(pSocket == nullptr)
+        return;
+
+    m_requests.remove(pSocket);
+    pSocket->deleteLater();
+}
+
+// Parses the arguments into parser, which knows the same options as the one of the command line.
+bool InstanceServer::parseRequest(const QByteArray& request, QCommandLineParser& parser)
+{
+    QStringList args(QCoreApplication::applicationFilePath());
+    for(const QByteArray& arg: request.split('\0'))
+    {
+        if(!arg.isEmpty())
+            args.append(QString::fromUtf8(arg));
+    }
+
+    KAboutData::applicationData().setupCommandLine(&parser);
+    KDiff3Shell::addCommandLineOptions(&parser);
+    return parser.parse(args) && canOpen(&parser);
+}
+
+bool InstanceServer::canOpen(const QCommandLineParser* pParser)
+{
+    // These may end the process, read other settings or print to the console of the client.
+    static const char* const ownProcessOptions[] = {"auto", "batch", "diff-output", "dir-report", "server", "stats", "confighelp", "cs", "config",
+                                                    "help", "version", "author", "license"};
+    for(const char* option: ownProcessOptions)
+    {
+        if(pParser->isSet(QLatin1String(option)))
+            return false;
+    }
+
+    // Standard input, pipes, the git repository of the current directory and relative names are those of the client.
+    QStringList files = pParser->positionalArguments();
+    files.append(pParser->value(QStringLiteral("base")));
+    files.append(pParser->value(QStringLiteral("output")));
+    files.append(pParser->value(QStringLiteral("out")));
+    files.append(pParser->value(QStringLiteral("alignment-ab")));
+    files.append(pParser->value(QStringLiteral("alignment-ac")));
+    files.append(pParser->value(QStringLiteral("alignment-bc")));
+    for(const QString& file: files)
+    {
+        if(file.isEmpty())
+            continue;
+        if(StreamInput::isStreamInput(file) || (QDir::isRelativePath(file) && QUrl(file).isRelative()))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef INSTANCESERVER_H
+#define INSTANCESERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+class QCommandLineParser;
+class QLocalServer;
+class QLocalSocket;
+
+/*
+    The resident process of "kdiff3 --server". It runs without a window of its own and opens a
+    window for each comparison the shell integrations hand over, instead of them starting a new
+    process each time. So options, fonts and codecs are loaded only once.
+
+    On the local socket serverName() the client writes the arguments without the program name as
+    UTF-8, each followed by a zero byte, and one more zero byte after the last. Empty arguments are
+    left out. The server answers with one byte: '1' if it opens a window for them, '0' if the
+    client must start kdiff3 itself.
+    Arguments that may end the process, like --auto, are always left to a process of their own. So
+    are relative file names: the server doesn't know the working directory of the client, its own
+    one is not that. Each request is parsed on its own and handed to its window.
+*/
+class InstanceServer : public QObject
+{
+    Q_OBJECT
+  public:
+    // Unique per user. Clients outside of src build the same name, keep them in sync.
+    static QString serverName();
+    // True in the process of the server, its windows don't end the process when closed.
+    static bool isRunning() { return s_pInstance != nullptr; }
+
+    explicit InstanceServer(QObject* pParent = nullptr);
+    ~InstanceServer() override;
+
+    // Returns false if a server runs already or the socket can't be made.
+    bool listen();
+
+  private Q_SLOTS:
+    void slotNewConnection();
+    void slotReadyRead();
+    void slotDisconnected();
+
+  private:
+    static bool parseRequest(const QByteArray& request, QCommandLineParser& parser);
+    static bool canOpen(const QCommandLineParser* pParser);
+
+    static InstanceServer* s_pInstance;
+
+    QLocalServer* m_pServer;
+    QHash<QLocalSocket*, QByteArray> m_requests; // Received so far
+};
+
+#endif // !INSTANCESERVER_H
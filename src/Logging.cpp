@@ -11,3 +11,4 @@ Q_LOGGING_CATEGORY(kdiffMain, "org.kde.kdiff3")
 Q_LOGGING_CATEGORY(kdiffFileAccess, "org.kde.kdiff3.fileAccess")
 //The following is very noisey if debug is turned on and not really useful unless your making changes in the core data processing.
 Q_LOGGING_CATEGORY(kdiffCore, "org.kde.kdiff3.core", QtWarningMsg)
+Q_LOGGING_CATEGORY(kdiffTrace, "org.kde.kdiff3.trace", QtWarningMsg)
@@ -13,5 +13,6 @@ Q_DECLARE_LOGGING_CATEGORY(kdiffMain)
 
 Q_DECLARE_LOGGING_CATEGORY(kdiffFileAccess);
 Q_DECLARE_LOGGING_CATEGORY(kdiffCore) //very noisey shows internal state information for kdiffs core.
+Q_DECLARE_LOGGING_CATEGORY(kdiffTrace) //the durations of the phases, see TraceSpan.
 
 #endif // !LOGGING_H
@@ -0,0 +1,62 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+/*
+    Estimates of the heap memory the large structures of a comparison hold, for "--stats" and the log.
+    Only the payload the structures allocate is counted: the overhead of the allocator is left out and
+    data shared with another counted structure is counted once.
+*/
+class MemoryUsage
+{
+  public:
+    template <class T>
+    static qint64 ofVector(const QVector<T>& v) { return (qint64)v.capacity() * (qint64)sizeof(T); }
+    static qint64 ofString(const QString& s) { return (qint64)s.capacity() * (qint64)sizeof(QChar); }
+    // A node of a std::list holds the links to its neighbours besides the value.
+    template <class T>
+    static qint64 ofListNodes(size_t nofNodes) { return (qint64)nofNodes * (qint64)(sizeof(T) + 2 * sizeof(void*)); }
+
+    void add(const QString& name, qint64 bytes) { m_entries.append(qMakePair(name, bytes)); }
+
+    qint64 total() const
+    {
+        qint64 sum = 0;
+        for(const QPair<QString, qint64>& entry: m_entries)
+            sum += entry.second;
+        return sum;
+    }
+
+    // One line for each structure and one for the total, not translated.
+    QString toString() const
+    {
+        QString s;
+        for(const QPair<QString, qint64>& entry: m_entries)
+            s += entry.first + QLatin1String(": ") + formatted(entry.second) + '\n';
+        s += QLatin1String("Total: ") + formatted(total()) + '\n';
+        return s;
+    }
+
+    static QString formatted(qint64 bytes)
+    {
+        if(bytes < 1024)
+            return QString::number(bytes) + QLatin1String(" B");
+        if(bytes < 1024 * 1024)
+            return QString::number(bytes / 1024.0, 'f', 1) + QLatin1String(" KiB");
+        return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + QLatin1String(" MiB");
+    }
+
+  private:
+    QVector<QPair<QString, qint64>> m_entries;
+};
+
+#endif // !MEMORYUSAGE_H
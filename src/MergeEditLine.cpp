@@ -8,41 +8,375 @@
 
 #include "MergeEditLine.h"
 
+#include "MemoryUsage.h"
+#include "options.h"
+#include "progress.h"
+
+#include <QBuffer>
+#include <QSaveFile>
+#include <QTextCodec>
+#include <QTextEncoder>
+
+thread_local int MergeEditLine::s_changeCount = 0;
+thread_local int MergeEditLineList::s_sizeChangeCount = 0;
+
+BlockAllocator<MergeEditLine> MergeEditLineList::sharedAllocator()
+{
+    static thread_local const QSharedPointer<BlockPool> s_pool = QSharedPointer<BlockPool>::create();
+    return BlockAllocator<MergeEditLine>(s_pool);
+}
+
+// The line of the source it shows, nullptr if it is removed, modified or the source has no line here.
+const LineData* MergeEditLine::getLineData(const QVector<LineData>* pLineDataA, const QVector<LineData>* pLineDataB, const QVector<LineData>* pLineDataC) const
+{
+    if(isRemoved() || mChanged)
+        return nullptr;
+
+    e_SrcSelector src = m_src;
+    if(src == e_SrcSelector::None)
+        return nullptr;
+
+    const Diff3Line& d3l = *m_id3l;
+    Q_ASSERT(src == e_SrcSelector::A || src == e_SrcSelector::B || src == e_SrcSelector::C);
+    if(src == e_SrcSelector::A && d3l.getLineA().isValid())
+        return &(*pLineDataA)[d3l.getLineA()];
+    else if(src == e_SrcSelector::B && d3l.getLineB().isValid())
+        return &(*pLineDataB)[d3l.getLineB()];
+    else if(src == e_SrcSelector::C && d3l.getLineC().isValid())
+        return &(*pLineDataC)[d3l.getLineC()];
+
+    //Not an error.
+    return nullptr;
+}
+
 QString MergeEditLine::getString(const QVector<LineData>* pLineDataA, const QVector<LineData>* pLineDataB, const QVector<LineData>* pLineDataC)
 {
     if(isRemoved())
-    {
         return QString();
+
+    if(isModified())
+        return m_str;
+
+    const LineData* pld = getLineData(pLineDataA, pLineDataB, pLineDataC);
+    return pld != nullptr ? pld->getLine() : QString();
+}
+
+void MergeEditLine::appendString(QString& s, const QVector<LineData>* pLineDataA, const QVector<LineData>* pLineDataB, const QVector<LineData>* pLineDataC)
+{
+    if(isRemoved())
+        return;
+
+    if(isModified())
+    {
+        s += m_str;
+        return;
     }
 
-    if(!isModified())
+    const LineData* pld = getLineData(pLineDataA, pLineDataB, pLineDataC);
+    if(pld != nullptr)
+        pld->appendTo(s);
+}
+
+void MergeLine::init(Diff3LineList::const_iterator it, LineIndex lineIdx, bool bTwoInputs, bool& bLineRemoved)
+{
+    const Diff3Line& d = *it;
+    d.mergeOneLine(mergeDetails, bConflict, bLineRemoved, srcSelect, bTwoInputs);
+
+    // Automatic solving for only whitespace changes.
+    bWhiteSpaceConflict = bConflict &&
+                          ((bTwoInputs && (d.isEqualAB() || (d.isWhiteLine(e_SrcSelector::A) && d.isWhiteLine(e_SrcSelector::B)))) ||
+                           (!bTwoInputs && ((d.isEqualAB() && d.isEqualAC()) || (d.isWhiteLine(e_SrcSelector::A) && d.isWhiteLine(e_SrcSelector::B) && d.isWhiteLine(e_SrcSelector::C)))));
+
+    d3lLineIdx = lineIdx;
+    bDelta = srcSelect != e_SrcSelector::A;
+    id3l = it;
+    srcRangeLength = 1;
+}
+
+bool MergeLine::isSameKind(const MergeLine& ml2) const
+{
+    if(bConflict && ml2.bConflict)
     {
-        e_SrcSelector src = m_src;
-        if(src == e_SrcSelector::None)
+        // Both lines have conflicts: If one is only a white space conflict and
+        // the other one is a real conflict, then this line returns false.
+        return id3l->isEqualAC() == ml2.id3l->isEqualAC() && id3l->isEqualAB() == ml2.id3l->isEqualAB();
+    }
+    else
+        return (
+            (!bConflict && !ml2.bConflict && bDelta && ml2.bDelta && srcSelect == ml2.srcSelect && (mergeDetails == ml2.mergeDetails || (mergeDetails != e_MergeDetails::eBCAddedAndEqual && ml2.mergeDetails != e_MergeDetails::eBCAddedAndEqual))) ||
+            (!bDelta && !ml2.bDelta));
+}
+
+void MergeLine::chooseSource(e_SrcSelector src)
+{
+    mergeEditLineList.clear();
+
+    Diff3LineList::const_iterator d3llit = id3l;
+    for(LineCount j = 0; j < srcRangeLength; ++j, ++d3llit)
+    {
+        if(d3llit->getLineInFile(src).isValid())
         {
-            return QString();
+            MergeEditLine mel(d3llit);
+            mel.setSource(src, false);
+            mergeEditLineList.push_back(mel);
         }
-        const Diff3Line& d3l = *m_id3l;
-        const LineData* pld = nullptr;
-        Q_ASSERT(src == e_SrcSelector::A || src == e_SrcSelector::B || src == e_SrcSelector::C);
-        if(src == e_SrcSelector::A && d3l.getLineA().isValid())
-            pld = &(*pLineDataA)[d3l.getLineA()];
-        else if(src == e_SrcSelector::B && d3l.getLineB().isValid())
-            pld = &(*pLineDataB)[d3l.getLineB()];
-        else if(src == e_SrcSelector::C && d3l.getLineC().isValid())
-            pld = &(*pLineDataC)[d3l.getLineC()];
+    }
 
-        //Not an error.
-        if(pld == nullptr)
+    if(mergeEditLineList.empty()) // Make a line nevertheless
+    {
+        MergeEditLine mel(id3l);
+        mel.setRemoved(src);
+        mergeEditLineList.push_back(mel);
+    }
+}
+
+e_SrcSelector MergeLineList::whiteSpaceMergeDefault(const QSharedPointer<Options>& pOptions, bool bTwoInputs)
+{
+    const int whiteSpaceMergeDefault = bTwoInputs ? pOptions->m_whiteSpace2FileMergeDefault : pOptions->m_whiteSpace3FileMergeDefault;
+    Q_ASSERT(whiteSpaceMergeDefault <= (int)e_SrcSelector::Max && whiteSpaceMergeDefault >= (int)e_SrcSelector::Min);
+    return (e_SrcSelector)whiteSpaceMergeDefault;
+}
+
+void MergeLineList::build(const Diff3LineList& diff3LineList, bool bTwoInputs, bool bDeltaEditLines)
+{
+    clear();
+
+    int lineIdx = 0;
+    Diff3LineList::const_iterator it;
+    for(it = diff3LineList.begin(); it != diff3LineList.end(); ++it, ++lineIdx)
+    {
+        MergeLine ml;
+        bool bLineRemoved;
+        ml.init(it, lineIdx, bTwoInputs, bLineRemoved);
+
+        MergeLine* pBack = empty() ? nullptr : &back();
+
+        bool bSame = pBack != nullptr && ml.isSameKind(*pBack);
+        if(bSame)
         {
-            return QString();
+            ++pBack->srcRangeLength;
+            if(pBack->bWhiteSpaceConflict && !ml.bWhiteSpaceConflict)
+                pBack->bWhiteSpaceConflict = false;
         }
+        else
+        {
+            push_back(ml);
+        }
+
+        if(!bDeltaEditLines && ml.bDelta)
+            continue;
 
-        return pld->getLine();
+        if(!ml.bConflict)
+        {
+            MergeEditLine mel(ml.id3l);
+            mel.setSource(ml.srcSelect, bLineRemoved);
+            back().mergeEditLineList.push_back(mel);
+        }
+        else if(pBack == nullptr || !pBack->bConflict || !bSame)
+        {
+            MergeEditLine mel(ml.id3l);
+            mel.setConflict();
+            back().mergeEditLineList.push_back(mel);
+        }
     }
-    else
+}
+
+void MergeLineList::chooseDeltas(e_SrcSelector src, bool bConflictsOnly, bool bWhiteSpaceOnly)
+{
+    for(MergeLine& ml: *this)
     {
-        return m_str;
+        bool bConflict = ml.mergeEditLineList.empty() || ml.mergeEditLineList.begin()->isConflict();
+        if(ml.bDelta && (!bConflictsOnly || bConflict) && (!bWhiteSpaceOnly || ml.bWhiteSpaceConflict))
+        {
+            if(src == e_SrcSelector::Invalid)
+            {
+                MergeEditLine mel(ml.id3l);
+
+                mel.setConflict();
+                ml.bConflict = true;
+                ml.mergeEditLineList.clear();
+                ml.mergeEditLineList.push_back(mel);
+            }
+            else
+            {
+                ml.chooseSource(src);
+            }
+        }
+    }
+}
+
+void MergeLineList::removeEmptyEditLines()
+{
+    for(MergeLine& ml: *this)
+    {
+        LineRef oldSrcLine;
+        e_SrcSelector oldSrc = e_SrcSelector::Invalid;
+        MergeEditLineList::iterator melIt;
+        for(melIt = ml.mergeEditLineList.begin(); melIt != ml.mergeEditLineList.end();)
+        {
+            MergeEditLine& mel = *melIt;
+            e_SrcSelector melsrc = mel.src();
+
+            LineRef srcLine = mel.isRemoved() ? LineRef() : mel.id3l()->getLineInFile(melsrc);
+
+            // At least one line remains because oldSrc != melsrc for first line in list
+            // Other empty lines will be removed
+            if(!srcLine.isValid() && !oldSrcLine.isValid() && oldSrc == melsrc)
+                melIt = ml.mergeEditLineList.erase(melIt);
+            else
+                ++melIt;
+
+            oldSrcLine = srcLine;
+            oldSrc = melsrc;
+        }
+    }
+}
+
+// Irrelevant changes are those where all contributions from B are already contained in C.
+// Also irrelevant are conflicts automatically solved (automerge regexp and history automerge)
+bool MergeLineList::hasRelevantChanges() const
+{
+    if(size() <= 1)
+        return true;
+
+    for(const MergeLine& ml: *this)
+    {
+        if((ml.bConflict && ml.mergeEditLineList.begin()->src() != e_SrcSelector::C) || ml.srcSelect == e_SrcSelector::B)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+qint64 MergeLineList::memoryUsage() const
+{
+    qint64 bytes = MemoryUsage::ofListNodes<MergeLine>(size());
+    for(const MergeLine& ml: *this)
+    {
+        bytes += MemoryUsage::ofListNodes<MergeEditLine>(ml.mergeEditLineList.size());
+        for(const MergeEditLine& mel: ml.mergeEditLineList)
+            bytes += mel.memoryUsage();
+    }
+    return bytes;
+}
+
+int MergeLineList::nofUnsolvedConflicts() const
+{
+    int nofUnsolvedConflicts = 0;
+    for(const MergeLine& ml: *this)
+    {
+        if(!ml.mergeEditLineList.empty() && ml.mergeEditLineList.begin()->isConflict())
+            ++nofUnsolvedConflicts;
+    }
+    return nofUnsolvedConflicts;
+}
+
+bool MergeLineList::writeFile(FileAccess& file, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle,
+                        const QVector<LineData>* pldA, const QVector<LineData>* pldB, const QVector<LineData>* pldC)
+{
+    if(file.isLocal())
+    {
+        QSaveFile saveFile(file.absoluteFilePath());
+        saveFile.setDirectWriteFallback(true);
+        if(saveFile.open(QIODevice::WriteOnly) && write(saveFile, pEncoding, eLineEndStyle, pldA, pldB, pldC))
+        {
+            if(file.isExecutable()) // Preserve attributes
+                saveFile.setPermissions(saveFile.permissions() | QFile::ExeUser);
+            return saveFile.commit();
+        }
+
+        saveFile.cancelWriting();
+        return false;
+    }
+
+    // The KIO put job needs the whole data at once.
+    QBuffer buffer;
+    if(!buffer.open(QIODevice::WriteOnly) || !write(buffer, pEncoding, eLineEndStyle, pldA, pldB, pldC))
+        return false;
+
+    buffer.close();
+    return file.writeFile(buffer.data().constData(), buffer.data().size());
+}
+
+/*
+    Encodes the merge result in chunks of about writeChunkSize characters, so only one chunk is
+    held in memory besides the lines themselves.
+*/
+bool MergeLineList::write(QIODevice& device, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle,
+                          const QVector<LineData>* pldA, const QVector<LineData>* pldB, const QVector<LineData>* pldC)
+{
+    static const int writeChunkSize = 1 << 16;
+
+    // A byte order mark only for UTF-16 and the like, the same as QTextStream writes.
+    QTextEncoder encoder(pEncoding, pEncoding->name() == "UTF-8" ? QTextCodec::IgnoreHeader : QTextCodec::DefaultConversion);
+    const QString lineEnd = eLineEndStyle == eLineEndStyleDos ? QStringLiteral("\r\n") : QStringLiteral("\n");
+
+    int nofLines = 0;
+    for(MergeLine& ml: *this)
+        nofLines += ml.mergeEditLineList.size();
+
+    ProgressProxy pp;
+    pp.setMaxNofSteps(nofLines);
+
+    QString chunk;
+    chunk.reserve(writeChunkSize + 1024);
+    int line = 0;
+    for(MergeLine& ml: *this)
+    {
+        for(MergeEditLine& mel: ml.mergeEditLineList)
+        {
+            if(!mel.isEditableText())
+                continue;
+
+            if(line > 0) // No line end after the last line
+                chunk += lineEnd;
+            mel.appendString(chunk, pldA, pldB, pldC);
+            ++line;
+
+            if(chunk.length() >= writeChunkSize)
+            {
+                const QByteArray encoded = encoder.fromUnicode(chunk.constData(), chunk.length());
+                if(device.write(encoded) != encoded.size())
+                    return false;
+                chunk.resize(0);
+
+                pp.setCurrent(line);
+                if(pp.wasCancelled())
+                    return false;
+            }
+        }
+    }
+
+    const QByteArray encoded = encoder.fromUnicode(chunk.constData(), chunk.length());
+    return device.write(encoded) == encoded.size();
+}
+
+bool MergeLineIndex::find(MergeLineList& mergeLineList, int line, MergeLineList::iterator& mlIt, MergeEditLineList::iterator& melIt)
+{
+    if(m_pMergeLineList != &mergeLineList || m_sizeChangeCount != MergeEditLineList::sizeChangeCount())
+        build(mergeLineList);
+
+    if(line < 0 || line >= m_lines.size())
+        return false;
+
+    mlIt = m_lines[line].mlIt;
+    melIt = m_lines[line].melIt;
+    return true;
+}
+
+void MergeLineIndex::build(MergeLineList& mergeLineList)
+{
+    m_pMergeLineList = &mergeLineList;
+    m_sizeChangeCount = MergeEditLineList::sizeChangeCount();
+    m_lines.clear();
+
+    for(MergeLineList::iterator mlIt = mergeLineList.begin(); mlIt != mergeLineList.end(); ++mlIt)
+    {
+        for(MergeEditLineList::iterator melIt = mlIt->mergeEditLineList.begin(); melIt != mlIt->mergeEditLineList.end(); ++melIt)
+        {
+            m_lines.push_back(Entry{mlIt, melIt});
+        }
     }
-    return QString();
 }
@@ -7,11 +7,15 @@
 */
 
 #ifndef MERGEEDITLINE_H
+#include "BlockAllocator.h"
 #include "diff.h"
 
 #include <QString>
 #include <QVector>
 
+class QIODevice;
+class QTextCodec;
+
 class MergeEditLine
 {
   public:
@@ -22,16 +26,21 @@ class MergeEditLine
         m_bLineRemoved = false;
         mChanged = false;
     }
+    // Counts the changes of all merge edit lines of this thread, so what is derived from them knows it is stale.
+    static int changeCount() { return s_changeCount; }
+
     void setConflict()
     {
+        ++s_changeCount;
         m_src = e_SrcSelector::None;
         m_bLineRemoved = false;
         mChanged = false;
         m_str = QString();
     }
-    bool isConflict() { return m_src == e_SrcSelector::None && !m_bLineRemoved && !mChanged; }
+    bool isConflict() const { return m_src == e_SrcSelector::None && !m_bLineRemoved && !mChanged; }
     void setRemoved(e_SrcSelector src = e_SrcSelector::None)
     {
+        ++s_changeCount;
         m_src = src;
         m_bLineRemoved = true;
         m_str = QString();
@@ -41,16 +50,22 @@ class MergeEditLine
     bool isEditableText() { return !isConflict(); }
     void setString(const QString& s)
     {
+        ++s_changeCount;
         m_str = s;
         m_bLineRemoved = false;
         m_src = e_SrcSelector::None;
         mChanged = true;
     }
     QString getString(const QVector<LineData>* pLineDataA, const QVector<LineData>* pLineDataB, const QVector<LineData>* pLineDataC);
+    // The same text as getString() added to s, a line of a source isn't copied on the way.
+    void appendString(QString& s, const QVector<LineData>* pLineDataA, const QVector<LineData>* pLineDataB, const QVector<LineData>* pLineDataC);
     bool isModified() { return mChanged; }
+    // Only the text the user typed, the other lines refer to the line data.
+    qint64 memoryUsage() const { return (qint64)m_str.capacity() * (qint64)sizeof(QChar); }
 
     void setSource(e_SrcSelector src, bool bLineRemoved)
     {
+        ++s_changeCount;
         m_src = src;
         m_bLineRemoved = bLineRemoved;
         if(bLineRemoved && m_src == e_SrcSelector::None)
@@ -61,9 +76,13 @@ class MergeEditLine
             m_str=QLatin1String("");
         }
     }
-    e_SrcSelector src() { return m_src; }
+    e_SrcSelector src() const { return m_src; }
     Diff3LineList::const_iterator id3l() { return m_id3l; }
   private:
+    const LineData* getLineData(const QVector<LineData>* pLineDataA, const QVector<LineData>* pLineDataB, const QVector<LineData>* pLineDataC) const;
+
+    static thread_local int s_changeCount;
+
     Diff3LineList::const_iterator m_id3l;
     e_SrcSelector m_src; // 1, 2 or 3 for A, B or C respectively, or 0 when line is from neither source.
     QString m_str;       // String when modified by user or null-string when orig data is used.
@@ -71,21 +90,74 @@ class MergeEditLine
     bool mChanged;
 };
 
-class MergeEditLineList :public std::list<MergeEditLine>
+/*
+    All lists of a thread take their nodes from one pool, so lines of huge merges lie next to each
+    other in memory and lines can still be spliced from one list into another. A list must stay on
+    the thread that made it, so several merges can run on pool threads at once.
+*/
+class MergeEditLineList :public std::list<MergeEditLine, BlockAllocator<MergeEditLine>>
 {
   private:
-    typedef std::list<MergeEditLine> BASE;
+    typedef std::list<MergeEditLine, BlockAllocator<MergeEditLine>> BASE;
 
   public:
-    typedef std::list<MergeEditLine>::iterator iterator;
-    typedef std::list<MergeEditLine>::reverse_iterator reverse_iterator;
-    typedef std::list<MergeEditLine>::const_iterator const_iterator;
+    typedef BASE::iterator iterator;
+    typedef BASE::reverse_iterator reverse_iterator;
+    typedef BASE::const_iterator const_iterator;
 
 
-    int size()
+    int size() const
     {
         return (int)BASE::size();
     }
+
+    // The changes that add or remove lines are counted for all lists of this thread, see MergeLineIndex.
+    static int sizeChangeCount() { return s_sizeChangeCount; }
+
+    MergeEditLineList(): BASE(sharedAllocator()) {}
+    MergeEditLineList(const MergeEditLineList&) = default;
+    MergeEditLineList& operator=(const MergeEditLineList& other)
+    {
+        ++s_sizeChangeCount;
+        BASE::operator=(other);
+        return *this;
+    }
+
+    void push_back(const MergeEditLine& mel)
+    {
+        ++s_sizeChangeCount;
+        BASE::push_back(mel);
+    }
+    void pop_back()
+    {
+        ++s_sizeChangeCount;
+        BASE::pop_back();
+    }
+    iterator insert(iterator pos, const MergeEditLine& mel)
+    {
+        ++s_sizeChangeCount;
+        return BASE::insert(pos, mel);
+    }
+    iterator erase(iterator pos)
+    {
+        ++s_sizeChangeCount;
+        return BASE::erase(pos);
+    }
+    void clear()
+    {
+        ++s_sizeChangeCount;
+        BASE::clear();
+    }
+    void splice(iterator pos, MergeEditLineList& other, iterator first, iterator last)
+    {
+        ++s_sizeChangeCount;
+        BASE::splice(pos, other, first, last);
+    }
+
+  private:
+    static BlockAllocator<MergeEditLine> sharedAllocator();
+
+    static thread_local int s_sizeChangeCount;
 };
 
 class MergeLine
@@ -100,6 +172,14 @@ class MergeLine
     bool bDelta = false;
     e_SrcSelector srcSelect = e_SrcSelector::None;
     MergeEditLineList mergeEditLineList;
+
+    // Sets up a merge line for the single Diff3Line at it, without any merge edit lines.
+    void init(Diff3LineList::const_iterator it, LineIndex lineIdx, bool bTwoInputs, bool& bLineRemoved);
+    // True if ml2 goes into the same merge line when it follows this one.
+    bool isSameKind(const MergeLine& ml2) const;
+    // Replaces the merge edit lines by the lines src has in the range, or one removed line if it has none.
+    void chooseSource(e_SrcSelector src);
+
     void split(MergeLine& ml2, int d3lLineIdx2) // The caller must insert the ml2 after this ml in the m_mergeLineList
     {
         if(d3lLineIdx2 < d3lLineIdx || d3lLineIdx2 >= d3lLineIdx + srcRangeLength)
@@ -141,6 +221,69 @@ class MergeLine
     }
 };
 
-typedef std::list<MergeLine> MergeLineList;
+/*
+    The merge lines of a whole merge result. The steps of the automatic merge that need no merge
+    result window are done here, so that files can also be merged without the GUI.
+*/
+class MergeLineList : public std::list<MergeLine, BlockAllocator<MergeLine>>
+{
+  public:
+    // The source option m_whiteSpace2FileMergeDefault or m_whiteSpace3FileMergeDefault gives.
+    static e_SrcSelector whiteSpaceMergeDefault(const QSharedPointer<Options>& pOptions, bool bTwoInputs);
+
+    /*
+        Makes a merge line of each run of Diff3Lines of the same kind, with its lines chosen
+        automatically. Without bDeltaEditLines the deltas get no edit lines, as when they are all
+        chosen right after.
+    */
+    void build(const Diff3LineList& diff3LineList, bool bTwoInputs, bool bDeltaEditLines = true);
+    // Chooses src for the deltas, e_SrcSelector::Invalid makes them conflicts.
+    void chooseDeltas(e_SrcSelector src, bool bConflictsOnly, bool bWhiteSpaceOnly);
+    // Removes the edit lines without a source line, one of each run of them stays.
+    void removeEmptyEditLines();
+
+    // False if all changes of B are contained in C already. Only for three inputs.
+    bool hasRelevantChanges() const;
+    int nofUnsolvedConflicts() const;
+
+    // The merge lines with their edit lines, see MemoryUsage.
+    qint64 memoryUsage() const;
+
+    /*
+        Writes the lines of the merge result to the file. Local files are written next to the file
+        and renamed over it, so a failed save leaves the old file intact. The executable bit of
+        the file as it was when file was made is kept.
+    */
+    bool writeFile(FileAccess& file, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle,
+                   const QVector<LineData>* pldA, const QVector<LineData>* pldB, const QVector<LineData>* pldC);
+    bool write(QIODevice& device, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle,
+               const QVector<LineData>* pldA, const QVector<LineData>* pldB, const QVector<LineData>* pldC);
+};
+
+/*
+    Finds the merge edit line for a line number of the merge result without walking the lists.
+    The index is made again on the first lookup after any MergeEditLineList added or removed lines.
+*/
+class MergeLineIndex
+{
+  public:
+    // Needed after merge lines were removed without changing any merge edit line list.
+    void invalidate() { m_pMergeLineList = nullptr; }
+    // Returns false if there is no such line.
+    bool find(MergeLineList& mergeLineList, int line, MergeLineList::iterator& mlIt, MergeEditLineList::iterator& melIt);
+
+  private:
+    void build(MergeLineList& mergeLineList);
+
+    struct Entry
+    {
+        MergeLineList::iterator mlIt;
+        MergeEditLineList::iterator melIt;
+    };
+
+    QVector<Entry> m_lines;
+    const MergeLineList* m_pMergeLineList = nullptr;
+    int m_sizeChangeCount = 0;
+};
 
 #endif
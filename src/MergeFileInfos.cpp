@@ -7,17 +7,28 @@
 */
 #include "MergeFileInfos.h"
 
+#include "ContentHashCache.h"
 #include "DirectoryInfo.h"
 #include "directorymergewindow.h"
 #include "fileaccess.h"
+#include "FullAnalysis.h"
 #include "progress.h"
+#include "Tracing.h"
 
+#include <algorithm>
+#include <string.h>
+
+#ifndef Q_OS_WIN
+#include <sys/mman.h>
+#endif
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
 #include <QString>
 
 #include <KLocalizedString>
 
-QSharedPointer<DirectoryInfo> MergeFileInfos::m_dirInfo;
-
 MergeFileInfos::MergeFileInfos()
 {
     m_bEqualAB = false;
@@ -121,6 +132,62 @@ QString MergeFileInfos::fileName() const
     return QString("");
 }
 
+QString MergeFileInfos::mergeKey(const FileAccess* pFA, Qt::CaseSensitivity eCaseSensitivity, QHash<const FileAccess*, QString>& dirKeys)
+{
+    const QString name = eCaseSensitivity == Qt::CaseSensitive ? pFA->fileName() : pFA->fileName().toCaseFolded();
+    const FileAccess* pParent = pFA->parent();
+    if(pParent == nullptr || pParent->parent() == nullptr)
+        return name;
+
+    QHash<const FileAccess*, QString>::const_iterator it = dirKeys.constFind(pParent);
+    if(it == dirKeys.constEnd())
+        it = dirKeys.insert(pParent, mergeKey(pParent, eCaseSensitivity, dirKeys));
+
+    return *it + '/' + name;
+}
+
+void MergeFileInfos::buildMergeMap(const QSharedPointer<DirectoryInfo>& dirInfo, Qt::CaseSensitivity eCaseSensitivity,
+                                   QHash<QString, MergeFileInfos>& mergeMap)
+{
+    t_DirectoryList::iterator dirIterator;
+    QHash<const FileAccess*, QString> dirKeys;
+
+    mergeMap.reserve((int)(dirInfo->getDirListA().size() + dirInfo->getDirListB().size()));
+
+    if(dirInfo->dirA().isValid())
+    {
+        for(dirIterator = dirInfo->getDirListA().begin(); dirIterator != dirInfo->getDirListA().end(); ++dirIterator)
+        {
+            MergeFileInfos& mfi = mergeMap[mergeKey(&(*dirIterator), eCaseSensitivity, dirKeys)];
+
+            mfi.setFileInfoA(&(*dirIterator));
+            mfi.setDirectoryInfo(dirInfo);
+        }
+    }
+
+    if(dirInfo->dirB().isValid())
+    {
+        for(dirIterator = dirInfo->getDirListB().begin(); dirIterator != dirInfo->getDirListB().end(); ++dirIterator)
+        {
+            MergeFileInfos& mfi = mergeMap[mergeKey(&(*dirIterator), eCaseSensitivity, dirKeys)];
+
+            mfi.setFileInfoB(&(*dirIterator));
+            mfi.setDirectoryInfo(dirInfo);
+        }
+    }
+
+    if(dirInfo->dirC().isValid())
+    {
+        for(dirIterator = dirInfo->getDirListC().begin(); dirIterator != dirInfo->getDirListC().end(); ++dirIterator)
+        {
+            MergeFileInfos& mfi = mergeMap[mergeKey(&(*dirIterator), eCaseSensitivity, dirKeys)];
+
+            mfi.setFileInfoC(&(*dirIterator));
+            mfi.setDirectoryInfo(dirInfo);
+        }
+    }
+}
+
 bool MergeFileInfos::conflictingFileTypes()
 {
     if((m_pFileInfoA != nullptr && !m_pFileInfoA->isNormal()) || (m_pFileInfoB != nullptr && !m_pFileInfoB->isNormal()) || (m_pFileInfoC != nullptr && !m_pFileInfoC->isNormal()))
@@ -190,8 +257,38 @@ QString MergeFileInfos::fullNameDest() const
         return m_dirInfo->destDir().absoluteFilePath() + '/' + subPath();
 }
 
+bool MergeFileInfos::canRunFullAnalysis(const QSharedPointer<Options>& pOptions) const
+{
+    return FullAnalysis::isAvailable(pOptions) && (!existsInA() || getFileInfoA()->isLocal()) &&
+           (!existsInB() || getFileInfoB()->isLocal()) && (!existsInC() || getFileInfoC()->isLocal());
+}
+
+// QFileInfo keeps the paths once made, which must not happen on two threads at once.
+void MergeFileInfos::prepareForWorkerThread()
+{
+    FileAccess* const fileInfos[3] = {getFileInfoA(), getFileInfoB(), getFileInfoC()};
+    for(FileAccess* pFA: fileInfos)
+    {
+        if(pFA != nullptr)
+            pFA->absoluteFilePath();
+    }
+}
+
+void MergeFileInfos::resetComparison()
+{
+    m_bEqualAB = false;
+    m_bEqualAC = false;
+    m_bEqualBC = false;
+    m_bConflictingAges = false;
+    m_ageA = eNotThere;
+    m_ageB = eNotThere;
+    m_ageC = eNotThere;
+    m_totalDiffStatus.reset();
+}
+
 bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, QSharedPointer<Options> const pOptions, DirectoryMergeWindow* pDMW)
 {
+    TraceSpan span("compareFiles");
     std::map<QDateTime, int> dateMap;
 
     if(existsInA())
@@ -218,12 +315,27 @@ bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, QSharedPointer
         }
         else
         {
-            Q_EMIT pDMW->startDiffMerge(
-                existsInA() ? getFileInfoA()->absoluteFilePath() : QString(""),
-                existsInB() ? getFileInfoB()->absoluteFilePath() : QString(""),
-                existsInC() ? getFileInfoC()->absoluteFilePath() : QString(""),
-                "",
-                "", "", "", &diffStatus());
+            const QString fileA = existsInA() ? getFileInfoA()->absoluteFilePath() : QString("");
+            const QString fileB = existsInB() ? getFileInfoB()->absoluteFilePath() : QString("");
+            const QString fileC = existsInC() ? getFileInfoC()->absoluteFilePath() : QString("");
+            if(canRunFullAnalysis(pOptions))
+            {
+                const QStringList analysisErrors = FullAnalysis::run(fileA, fileB, fileC, pOptions, diffStatus());
+                if(!analysisErrors.isEmpty())
+                {
+                    //Limit size of error list in memmory.
+                    for(const QString& error: analysisErrors)
+                    {
+                        if(errors.size() < 30)
+                            errors.append(error);
+                    }
+                    return false;
+                }
+            }
+            else
+            {
+                Q_EMIT pDMW->startDiffMerge(fileA, fileB, fileC, "", "", "", "", &diffStatus());
+            }
             int nofNonwhiteConflicts = diffStatus().getNonWhitespaceConflicts();
 
             if(pOptions->m_bDmWhiteSpaceEqual && nofNonwhiteConflicts == 0)
@@ -242,39 +354,44 @@ bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, QSharedPointer
     }
     else
     {
-        bool bError = false;
-        QString eqStatus;
-        if(existsInA() && existsInB())
+        // A pair that failed says nothing about the others.
+        bool bErrorAB = false, bErrorAC = false, bErrorBC = false;
+        QString statusAB, statusAC, statusBC;
+        const bool bComparedAtOnce = existsInA() && existsInB() && existsInC() && !isDirA() && !isDirB() && !isDirC() && fastFileComparison3(pOptions);
+        if(existsInA() && existsInB() && !bComparedAtOnce)
         {
             if(isDirA())
                 m_bEqualAB = true;
             else
-                m_bEqualAB = fastFileComparison(*getFileInfoA(), *getFileInfoB(), bError, eqStatus, pOptions);
+                m_bEqualAB = fastFileComparison(*getFileInfoA(), *getFileInfoB(), bErrorAB, statusAB, pOptions);
         }
-        if(existsInA() && existsInC())
+        if(existsInA() && existsInC() && !bComparedAtOnce)
         {
             if(isDirA())
                 m_bEqualAC = true;
             else
-                m_bEqualAC = fastFileComparison(*getFileInfoA(), *getFileInfoC(), bError, eqStatus, pOptions);
+                m_bEqualAC = fastFileComparison(*getFileInfoA(), *getFileInfoC(), bErrorAC, statusAC, pOptions);
         }
-        if(existsInB() && existsInC())
+        if(existsInB() && existsInC() && !bComparedAtOnce)
         {
             if(m_bEqualAB && m_bEqualAC)
                 m_bEqualBC = true;
+            // Equal to one and not to the other, so these two differ as well.
+            else if((m_bEqualAB && !bErrorAC) || (m_bEqualAC && !bErrorAB))
+                m_bEqualBC = false;
             else
             {
                 if(isDirB())
                     m_bEqualBC = true;
                 else
-                    m_bEqualBC = fastFileComparison(*getFileInfoB(), *getFileInfoC(), bError, eqStatus, pOptions);
+                    m_bEqualBC = fastFileComparison(*getFileInfoB(), *getFileInfoC(), bErrorBC, statusBC, pOptions);
             }
         }
-        if(bError)
+        if(bErrorAB || bErrorAC || bErrorBC)
         {
             //Limit size of error list in memmory.
             if(errors.size() < 30)
-                errors.append(eqStatus);
+                errors.append(bErrorAB ? statusAB : (bErrorAC ? statusAC : statusBC));
             return false;
         }
     }
@@ -373,6 +490,229 @@ bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, QSharedPointer
     return true;
 }
 
+// Bytes compared between two progress updates, also the size of the blocks checked up front.
+static const qint64 comparisonChunkSize = 1 << 20;
+
+/*
+    Completes the hashes of two mapped files that are equal up to offset, hash1 holds that part
+    already. Returns false if cancelled.
+*/
+static bool hashDifferingData(const uchar* p1, const uchar* p2, qint64 offset, qint64 size, ProgressProxy& pp, QCryptographicHash& hash1,
+                              QCryptographicHash& hash2)
+{
+    // offset is at the start of a chunk.
+    for(qint64 pos = 0; pos < size; pos += comparisonChunkSize)
+    {
+        if(pp.wasCancelled())
+            return false;
+
+        const int len = (int)std::min(size - pos, comparisonChunkSize);
+        if(pos >= offset)
+            hash1.addData(reinterpret_cast<const char*>(p1 + pos), len);
+        hash2.addData(reinterpret_cast<const char*>((pos < offset ? p1 : p2) + pos), len);
+    }
+    return true;
+}
+
+/*
+    Adds the next size bytes of the open file to the hash. Returns false if they can't be read
+    or if cancelled.
+*/
+static bool hashFileData(FileAccess& file, qint64 size, std::vector<char>& buf, ProgressProxy& pp, QCryptographicHash& hash)
+{
+    while(size > 0)
+    {
+        if(pp.wasCancelled())
+            return false;
+
+        const qint64 len = std::min(size, (qint64)buf.size());
+        if(len != file.read(&buf[0], len))
+            return false;
+        hash.addData(&buf[0], (int)len);
+        size -= len;
+    }
+    return true;
+}
+
+/*
+    Compares two local files of equal size through read-only mappings. A few blocks at the start,
+    in the middle and at the end are compared first, so most differing files are found without
+    touching the rest. Returns false if the files can't be mapped, then they have to be read.
+    That is also the case if a file no longer has the listed size: a mapping beyond its end would
+    raise SIGBUS. bComplete is false if the comparison was cancelled, the files don't count
+    as equal then.
+    With pHash1 the hash of equal files is computed on the way. Only with pHash2 too differing
+    files are read to the end, each for its own hash, bComplete is false if they weren't finished.
+*/
+static bool compareMappedFiles(const QString& fileName1, const QString& fileName2, qint64 size, ProgressProxy& pp, QCryptographicHash* pHash1,
+                               QCryptographicHash* pHash2, bool& bEqual, bool& bComplete)
+{
+    bComplete = true;
+    bEqual = true;
+    if(size == 0)
+        return true;
+
+    QFile file1(fileName1);
+    QFile file2(fileName2);
+    if(!file1.open(QIODevice::ReadOnly) || !file2.open(QIODevice::ReadOnly) || file1.size() != size || file2.size() != size)
+        return false;
+
+    const uchar* p1 = file1.map(0, size);
+    const uchar* p2 = p1 != nullptr ? file2.map(0, size) : nullptr;
+    if(p2 == nullptr)
+        return false;
+
+#ifndef Q_OS_WIN
+    posix_madvise(const_cast<uchar*>(p1), (size_t)size, POSIX_MADV_SEQUENTIAL);
+    posix_madvise(const_cast<uchar*>(p2), (size_t)size, POSIX_MADV_SEQUENTIAL);
+#endif
+
+    const qint64 sampleSize = std::min(size, (qint64)4096);
+    const qint64 sampleOffsets[] = {0, (size - sampleSize) / 2, size - sampleSize};
+    for(qint64 offset: sampleOffsets)
+    {
+        if(memcmp(p1 + offset, p2 + offset, (size_t)sampleSize) != 0)
+        {
+            bEqual = false;
+            if(pHash2 != nullptr)
+                bComplete = hashDifferingData(p1, p2, 0, size, pp, *pHash1, *pHash2);
+            return true;
+        }
+    }
+
+    pp.setInformation(i18n("Comparing file..."), 0, false);
+    pp.setMaxNofSteps(size / comparisonChunkSize);
+
+    qint64 offset = 0;
+    while(offset < size && !pp.wasCancelled())
+    {
+        const qint64 len = std::min(size - offset, comparisonChunkSize);
+        if(memcmp(p1 + offset, p2 + offset, (size_t)len) != 0)
+        {
+            bEqual = false;
+            if(pHash2 != nullptr)
+                bComplete = hashDifferingData(p1, p2, offset, size, pp, *pHash1, *pHash2);
+            return true;
+        }
+
+        // Both have the same content, so one hash serves for both.
+        if(pHash1 != nullptr)
+            pHash1->addData(reinterpret_cast<const char*>(p1 + offset), (int)len);
+        offset += len;
+        pp.step();
+    }
+
+    bComplete = offset == size;
+    bEqual = bComplete;
+    return true;
+}
+
+/*
+    Compares a block of three files, as far as the flags say they are still equal. A file equal to
+    one of the others but not to the third differs from the third as well, so B and C are only
+    compared when both differ from A.
+*/
+static void compareBlocks(const uchar* pA, const uchar* pB, const uchar* pC, size_t len, bool& bEqualAB, bool& bEqualAC, bool& bEqualBC)
+{
+    if(bEqualAB)
+        bEqualAB = memcmp(pA, pB, len) == 0;
+    if(bEqualAC)
+        bEqualAC = memcmp(pA, pC, len) == 0;
+    if(!bEqualBC || (bEqualAB && bEqualAC))
+        return;
+
+    if(bEqualAB || bEqualAC)
+        bEqualBC = false;
+    else
+        bEqualBC = memcmp(pB, pC, len) == 0;
+}
+
+/*
+    The three way version of compareMappedFiles(), it reads each file once for all three pairs and
+    stops as soon as no pair is equal anymore. The flags come in as true.
+*/
+static bool compareMappedFiles(const QString fileNames[3], qint64 size, ProgressProxy& pp, bool& bEqualAB, bool& bEqualAC, bool& bEqualBC)
+{
+    if(size == 0)
+        return true;
+
+    QFile files[3];
+    const uchar* p[3];
+    for(int i = 0; i < 3; ++i)
+    {
+        files[i].setFileName(fileNames[i]);
+        if(!files[i].open(QIODevice::ReadOnly) || files[i].size() != size)
+            return false;
+        p[i] = files[i].map(0, size);
+        if(p[i] == nullptr)
+            return false;
+#ifndef Q_OS_WIN
+        posix_madvise(const_cast<uchar*>(p[i]), (size_t)size, POSIX_MADV_SEQUENTIAL);
+#endif
+    }
+
+    const qint64 sampleSize = std::min(size, (qint64)4096);
+    const qint64 sampleOffsets[] = {0, (size - sampleSize) / 2, size - sampleSize};
+    for(qint64 offset: sampleOffsets)
+    {
+        compareBlocks(p[0] + offset, p[1] + offset, p[2] + offset, (size_t)sampleSize, bEqualAB, bEqualAC, bEqualBC);
+        if(!bEqualAB && !bEqualAC && !bEqualBC)
+            return true;
+    }
+
+    pp.setInformation(i18n("Comparing file..."), 0, false);
+    pp.setMaxNofSteps(size / comparisonChunkSize);
+
+    qint64 offset = 0;
+    while(offset < size && (bEqualAB || bEqualAC || bEqualBC) && !pp.wasCancelled())
+    {
+        const qint64 len = std::min(size - offset, comparisonChunkSize);
+        compareBlocks(p[0] + offset, p[1] + offset, p[2] + offset, (size_t)len, bEqualAB, bEqualAC, bEqualBC);
+        offset += len;
+        pp.step();
+    }
+
+    // Cancelled, the pairs not read to the end are unknown.
+    if(offset < size)
+        bEqualAB = bEqualAC = bEqualBC = false;
+    return true;
+}
+
+/*
+    Compares all three files in one pass if each of them would have to be read by
+    fastFileComparison() anyway: local normal files of the same size whose contents decide.
+    Returns false if that isn't the case, then the pairs are compared one by one.
+*/
+bool MergeFileInfos::fastFileComparison3(QSharedPointer<Options> const pOptions)
+{
+    if(pOptions->m_bDmTrustSize || pOptions->m_bDmTrustDate || pOptions->m_bDmUseHashCache)
+        return false;
+
+    FileAccess* const fileInfos[] = {getFileInfoA(), getFileInfoB(), getFileInfoC()};
+    for(const FileAccess* pFileInfo: fileInfos)
+    {
+        if(!pFileInfo->isNormal() || !pFileInfo->isLocal() || (!pOptions->m_bDmFollowFileLinks && pFileInfo->isSymLink()) ||
+           pFileInfo->size() != fileInfos[0]->size())
+            return false;
+    }
+
+    if(pOptions->m_bDmTrustDateFallbackToBinary &&
+       (fileInfos[0]->lastModified() == fileInfos[1]->lastModified() || fileInfos[0]->lastModified() == fileInfos[2]->lastModified() ||
+        fileInfos[1]->lastModified() == fileInfos[2]->lastModified()))
+        return false;
+
+    const QString fileNames[3] = {fileInfos[0]->absoluteFilePath(), fileInfos[1]->absoluteFilePath(), fileInfos[2]->absoluteFilePath()};
+    ProgressProxy pp;
+    bool bEqualAB = true, bEqualAC = true, bEqualBC = true;
+    if(!compareMappedFiles(fileNames, fileInfos[0]->size(), pp, bEqualAB, bEqualAC, bEqualBC))
+        return false;
+
+    m_bEqualAB = bEqualAB;
+    m_bEqualAC = bEqualAC;
+    m_bEqualBC = bEqualBC;
+    return true;
+}
+
 bool MergeFileInfos::fastFileComparison(
     FileAccess& fi1, FileAccess& fi2,
     bool& bError, QString& status, QSharedPointer<Options> const pOptions)
@@ -444,7 +784,42 @@ bool MergeFileInfos::fastFileComparison(
         }
     }
 
-    std::vector<char> buf1(100000);
+    // Cached hashes that differ settle it, equal ones only when they are trusted.
+    const bool bUseHashCache = pOptions->m_bDmUseHashCache && fi1.isLocal() && fi2.isLocal();
+    if(bUseHashCache)
+    {
+        QByteArray hash1, hash2;
+        if(ContentHashCache::instance().lookup(fi1, hash1) && ContentHashCache::instance().lookup(fi2, hash2) &&
+           (hash1 != hash2 || pOptions->m_bDmTrustHashCache))
+        {
+            bError = false;
+            bEqual = hash1 == hash2;
+            status = i18n("Cached hash: ");
+            return bEqual;
+        }
+    }
+    // The hashes of equal files come with the comparison. Differing ones are read to the end for theirs only on request.
+    const bool bHashDifferingFiles = bUseHashCache && pOptions->m_bDmHashDifferingFiles;
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QCryptographicHash hash2(QCryptographicHash::Sha256);
+
+    if(fi1.isLocal() && fi2.isLocal())
+    {
+        bool bComplete;
+        if(compareMappedFiles(fi1.absoluteFilePath(), fi2.absoluteFilePath(), fi1.size(), pp, bUseHashCache ? &hash : nullptr,
+                              bHashDifferingFiles ? &hash2 : nullptr, bEqual, bComplete))
+        {
+            bError = false;
+            if(bUseHashCache && bComplete && (bEqual || bHashDifferingFiles))
+            {
+                ContentHashCache::instance().insert(fi1, hash.result());
+                ContentHashCache::instance().insert(fi2, bEqual ? hash.result() : hash2.result());
+            }
+            return bEqual;
+        }
+    }
+
+    std::vector<char> buf1(comparisonChunkSize);
     std::vector<char> buf2(buf1.size());
 
     if(!fi1.open(QIODevice::ReadOnly))
@@ -489,10 +864,24 @@ bool MergeFileInfos::fastFileComparison(
         if(memcmp(&buf1[0], &buf2[0], len) != 0)
         {
             bError = false;
+            if(bHashDifferingFiles)
+            {
+                // The start of the second file went into the common hash, so it is read again.
+                hash.addData(&buf1[0], (int)len);
+                fi2.close();
+                if(hashFileData(fi1, sizeLeft - len, buf1, pp, hash) && fi2.open(QIODevice::ReadOnly) && hashFileData(fi2, fullSize, buf2, pp, hash2))
+                {
+                    ContentHashCache::instance().insert(fi1, hash.result());
+                    ContentHashCache::instance().insert(fi2, hash2.result());
+                }
+            }
             fi1.close();
             fi2.close();
             return bEqual;
         }
+        // Both have the same content, so one hash serves for both.
+        if(bUseHashCache)
+            hash.addData(&buf1[0], (int)len);
         sizeLeft -= len;
         //pp.setCurrent(double(fullSize-sizeLeft)/fullSize, false );
         pp.step();
@@ -500,6 +889,19 @@ bool MergeFileInfos::fastFileComparison(
     fi1.close();
     fi2.close();
 
+    // Cancelled, the rest is unknown.
+    if(sizeLeft > 0)
+    {
+        bError = false;
+        return false;
+    }
+
+    if(bUseHashCache)
+    {
+        ContentHashCache::instance().insert(fi1, hash.result());
+        ContentHashCache::instance().insert(fi2, hash.result());
+    }
+
     // If the program really arrives here, then the files are really equal.
     bError = false;
     bEqual = true;
@@ -540,35 +942,45 @@ void MergeFileInfos::updateAge()
     }
 }
 
-QTextStream& operator<<(QTextStream& ts, MergeFileInfos& mfi)
+// Also read back by readComparison(), a new field needs a new snapshot version.
+void MergeFileInfos::writeComparison(QDataStream& stream) const
 {
-    ts << "{\n";
-    ValueMap vm;
-    vm.writeEntry("SubPath", mfi.subPath());
-    vm.writeEntry("ExistsInA", mfi.existsInA());
-    vm.writeEntry("ExistsInB", mfi.existsInB());
-    vm.writeEntry("ExistsInC", mfi.existsInC());
-    vm.writeEntry("EqualAB", mfi.isEqualAB());
-    vm.writeEntry("EqualAC", mfi.isEqualAC());
-    vm.writeEntry("EqualBC", mfi.isEqualBC());
-
-    vm.writeEntry("MergeOperation", (int)mfi.getOperation());
-    vm.writeEntry("DirA", mfi.isDirA());
-    vm.writeEntry("DirB", mfi.isDirB());
-    vm.writeEntry("DirC", mfi.isDirC());
-    vm.writeEntry("LinkA", mfi.isLinkA());
-    vm.writeEntry("LinkB", mfi.isLinkB());
-    vm.writeEntry("LinkC", mfi.isLinkC());
-    vm.writeEntry("OperationComplete", !mfi.isOperationRunning());
-
-    vm.writeEntry("AgeA", (int)mfi.getAgeA());
-    vm.writeEntry("AgeB", (int)mfi.getAgeB());
-    vm.writeEntry("AgeC", (int)mfi.getAgeC());
-    vm.writeEntry("ConflictingAges", mfi.conflictingAges()); // Equal age but files are not!
-
-    vm.save(ts);
-
-    ts << "}\n";
-
-    return ts;
+    const quint8 flags = (m_bEqualAB ? 1 : 0) | (m_bEqualAC ? 2 : 0) | (m_bEqualBC ? 4 : 0) | (m_bConflictingAges ? 8 : 0);
+    const quint8 diffFlags = (m_totalDiffStatus.isBinaryEqualAB() ? 1 : 0) | (m_totalDiffStatus.isBinaryEqualAC() ? 2 : 0) |
+                             (m_totalDiffStatus.isBinaryEqualBC() ? 4 : 0) | (m_totalDiffStatus.isTextEqualAB() ? 8 : 0) |
+                             (m_totalDiffStatus.isTextEqualAC() ? 16 : 0) | (m_totalDiffStatus.isTextEqualBC() ? 32 : 0) |
+                             (m_totalDiffStatus.isDiffDegraded() ? 64 : 0);
+
+    stream << flags << (qint8)m_ageA << (qint8)m_ageB << (qint8)m_ageC << diffFlags << (qint32)m_totalDiffStatus.getUnsolvedConflicts()
+           << (qint32)m_totalDiffStatus.getSolvedConflicts() << (qint32)m_totalDiffStatus.getWhitespaceConflicts();
+}
+
+bool MergeFileInfos::readComparison(QDataStream& stream)
+{
+    quint8 flags = 0, diffFlags = 0;
+    qint8 ageA = eNotThere, ageB = eNotThere, ageC = eNotThere;
+    qint32 nofUnsolved = 0, nofSolved = 0, nofWhitespace = 0;
+    stream >> flags >> ageA >> ageB >> ageC >> diffFlags >> nofUnsolved >> nofSolved >> nofWhitespace;
+    if(stream.status() != QDataStream::Ok || ageA < eNew || ageA >= eAgeEnd || ageB < eNew || ageB >= eAgeEnd || ageC < eNew || ageC >= eAgeEnd)
+        return false;
+
+    m_bEqualAB = (flags & 1) != 0;
+    m_bEqualAC = (flags & 2) != 0;
+    m_bEqualBC = (flags & 4) != 0;
+    m_bConflictingAges = (flags & 8) != 0;
+    m_ageA = (e_Age)ageA;
+    m_ageB = (e_Age)ageB;
+    m_ageC = (e_Age)ageC;
+
+    m_totalDiffStatus.setBinaryEqualAB((diffFlags & 1) != 0);
+    m_totalDiffStatus.setBinaryEqualAC((diffFlags & 2) != 0);
+    m_totalDiffStatus.setBinaryEqualBC((diffFlags & 4) != 0);
+    m_totalDiffStatus.setTextEqualAB((diffFlags & 8) != 0);
+    m_totalDiffStatus.setTextEqualAC((diffFlags & 16) != 0);
+    m_totalDiffStatus.setTextEqualBC((diffFlags & 32) != 0);
+    m_totalDiffStatus.setDiffDegraded((diffFlags & 64) != 0);
+    m_totalDiffStatus.setUnsolvedConflicts(nofUnsolved);
+    m_totalDiffStatus.setSolvedConflicts(nofSolved);
+    m_totalDiffStatus.setWhitespaceConflicts(nofWhitespace);
+    return true;
 }
@@ -12,6 +12,8 @@
 #include "diff.h"
 #include "fileaccess.h"
 
+#include <QDataStream>
+#include <QHash>
 #include <QString>
 
 //class DirectoryInfo;
@@ -133,6 +135,15 @@ class MergeFileInfos
     inline bool isEqualAC() const { return m_bEqualAC; }
     inline bool isEqualBC() const { return m_bEqualBC; }
     bool compareFilesAndCalcAges(QStringList& errors, QSharedPointer<Options> const pOptions, DirectoryMergeWindow* pDMW);
+    // Forgets the results of compareFilesAndCalcAges(), before the files are compared again.
+    void resetComparison();
+    // The results of compareFilesAndCalcAges() in a folder comparison snapshot.
+    void writeComparison(QDataStream& stream) const;
+    bool readComparison(QDataStream& stream);
+    // Local files are analyzed by FullAnalysis, which needs no window and runs on any thread.
+    bool canRunFullAnalysis(const QSharedPointer<Options>& pOptions) const;
+    // To be called before the item is compared on another thread.
+    void prepareForWorkerThread();
 
     void updateAge();
 
@@ -162,8 +173,19 @@ class MergeFileInfos
 
     bool conflictingAges() const { return m_bConflictingAges; }
 
+    /*
+        Adds the entries of the folders listed in dirInfo to mergeMap. The items are found by their
+        path relative to the compared folders, case folded when the comparison ignores case.
+    */
+    static void buildMergeMap(const QSharedPointer<DirectoryInfo>& dirInfo, Qt::CaseSensitivity eCaseSensitivity,
+                              QHash<QString, MergeFileInfos>& mergeMap);
+
   private:
+    // The key of every folder is kept while building the map, so each FileAccess only adds its own name.
+    static QString mergeKey(const FileAccess* pFA, Qt::CaseSensitivity eCaseSensitivity, QHash<const FileAccess*, QString>& dirKeys);
+
     bool fastFileComparison(FileAccess& fi1, FileAccess& fi2, bool& bError, QString& status, QSharedPointer<Options> const pOptions);
+    bool fastFileComparison3(QSharedPointer<Options> const pOptions);
     inline void setAgeA(const e_Age inAge) { m_ageA = inAge; }
     inline void setAgeB(const e_Age inAge) { m_ageB = inAge; }
     inline void setAgeC(const e_Age inAge) { m_ageC = inAge; }
@@ -175,7 +197,7 @@ class MergeFileInfos
     FileAccess* m_pFileInfoB;
     FileAccess* m_pFileInfoC;
 
-    static QSharedPointer<DirectoryInfo> m_dirInfo;
+    QSharedPointer<DirectoryInfo> m_dirInfo; // Of the comparison this item belongs to
 
     TotalDiffStatus m_totalDiffStatus;
 
@@ -194,8 +216,6 @@ class MergeFileInfos
     bool m_bConflictingAges; // Equal age but files are not!
 };
 
-QTextStream& operator<<(QTextStream& ts, MergeFileInfos& mfi);
-
 class MfiCompare
 {
     Qt::SortOrder mOrder;
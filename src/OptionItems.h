@@ -16,6 +16,7 @@
 #include <QLineEdit>
 #include <QPushButton>
 #include <QString>
+#include <QStringList>
 #include <QTextCodec>
 
 #include <KLocalizedString>
@@ -29,11 +30,7 @@ class OptionItemBase
         m_bPreserved = false;
     }
     virtual ~OptionItemBase(){};
-    virtual void setToDefault() = 0;
-    virtual void setToCurrent() = 0;
 
-    virtual void apply() = 0;
-    
     virtual void write(ValueMap*) const = 0;
     virtual void read(ValueMap*) = 0;
     void doPreserve()
@@ -87,14 +84,11 @@ class Option : public OptionItemBase
         m_defaultVal = defaultValue;
     }
 
-    void setToDefault() override {};
-    void setToCurrent() override {};
     const T& getDefault() const { return m_defaultVal; };
     const T getCurrent() const { return *m_pVar; };
 
     virtual void setCurrent(const T inValue) { *m_pVar = inValue; }
 
-    void apply() override {};
     virtual void apply(const T& inValue) { *m_pVar = inValue; }
 
     void write(ValueMap* config) const override { config->writeEntry(m_saveName, *m_pVar); }
@@ -157,22 +151,79 @@ typedef Option<QFont> OptionFont;
 typedef Option<QColor> OptionColor;
 typedef Option<QString> OptionString;
 
-class OptionCodec : public OptionString
+/*
+    A string setting that also keeps the values entered before, the option dialog offers them in
+    its drop down list. All are saved as one list with the current value first.
+*/
+class OptionStringHistory : public OptionString
 {
   public:
-    using OptionString::Option;
+    OptionStringHistory(const QString& defaultVal, const QString& saveName, QString* pVar)
+        : OptionString(pVar, defaultVal, saveName)
+    {
+        m_history.append(defaultVal);
+    }
 
-    void setCurrent(const QString name) override { OptionString::setCurrent(name); };
-    void setCurrent(const QByteArray& name) { OptionString::setCurrent(QString::fromLatin1(name)); }
-    const QString& defaultName() const { return mDefaultName; }
+    const QStringList& getHistory() const { return m_history; }
+
+    void apply(const QString& inValue) override
+    {
+        OptionString::apply(inValue);
+        m_history.removeAll(inValue);
+        m_history.prepend(inValue);
+        while(m_history.size() > maxHistorySize)
+            m_history.removeLast();
+    }
 
-    void saveDefaultIndex(const int i) { defaultIndex = i; };
-    int getDefaultIndex() const { return defaultIndex; }
+    void write(ValueMap* config) const override { config->writeEntry(m_saveName, m_history); }
+    void read(ValueMap* config) override
+    {
+        m_history = config->readEntry(m_saveName, QStringList(m_defaultVal));
+        if(!m_history.empty())
+            setCurrent(m_history.front());
+    }
 
   private:
-    const QString mDefaultName = QLatin1String(QTextCodec::codecForLocale()->name());
-    int defaultIndex = 0;
-    Q_DISABLE_COPY(OptionCodec)
+    static const int maxHistorySize = 10;
+    QStringList m_history;
+
+    Q_DISABLE_COPY(OptionStringHistory)
+};
+
+/*
+    An encoding setting, the default is the codec of the locale. An unknown codec name leaves the
+    encoding unchanged.
+*/
+class OptionCodecPointer : public OptionItemBase
+{
+  public:
+    OptionCodecPointer(const QString& saveName, QTextCodec** ppVarCodec)
+        : OptionItemBase(saveName), m_ppVarCodec(ppVarCodec)
+    {
+        *m_ppVarCodec = QTextCodec::codecForLocale();
+    }
+
+    QTextCodec* getDefault() const { return QTextCodec::codecForLocale(); }
+    QTextCodec* getCurrent() const { return *m_ppVarCodec; }
+    void apply(QTextCodec* pCodec) { *m_ppVarCodec = pCodec; }
+
+    void write(ValueMap* config) const override { config->writeEntry(m_saveName, (const char*)(*m_ppVarCodec)->name()); }
+    void read(ValueMap* config) override
+    {
+        QTextCodec* pCodec = QTextCodec::codecForName(config->readEntry(m_saveName, (const char*)(*m_ppVarCodec)->name()).toLatin1());
+        if(pCodec != nullptr)
+            *m_ppVarCodec = pCodec;
+    }
+
+  protected:
+    void preserve() override { m_pPreservedCodec = *m_ppVarCodec; }
+    void unpreserve() override { *m_ppVarCodec = m_pPreservedCodec; }
+
+  private:
+    QTextCodec** m_ppVarCodec;
+    QTextCodec* m_pPreservedCodec = nullptr;
+
+    Q_DISABLE_COPY(OptionCodecPointer)
 };
 
 #endif // !OPTIONITEMS_H
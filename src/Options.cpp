@@ -13,6 +13,10 @@
 
 #include <KSharedConfig>
 
+#include <QApplication>
+#include <QFontDatabase>
+#include <QPixmap>
+
 #define KDIFF3_CONFIG_GROUP "KDiff3 Options"
 
 void Options::init()
@@ -27,30 +31,146 @@ void Options::init()
 
     addOptionItem(new OptionToggleAction(true, "Show Toolbar", &m_bShowToolBar));
     addOptionItem(new OptionToggleAction(true, "Show Statusbar", &m_bShowStatusBar));
-}
 
-void Options::apply()
-{
-    for(OptionItemBase* item : mOptionItemList)
-    {
-        item->apply();
-    }
-}
+    initWithoutGui();
 
-void Options::resetToDefaults()
-{
-    for(OptionItemBase* item : mOptionItemList)
-    {
-        item->setToDefault();
-    }
+    // Font page
+    //requires QT 5.2 or later.
+    addOptionItem(new OptionFont(QApplication::font(), "ApplicationFont", &m_appFont));
+    addOptionItem(new OptionFont(QFontDatabase::systemFont(QFontDatabase::FixedFont), "Font", &m_font));
+
+    // Color page
+    bool bLowColor = QPixmap::defaultDepth() <= 8;
+
+    addOptionItem(new OptionColor(Qt::black, "FgColor", &m_fgColor));
+    addOptionItem(new OptionColor(Qt::white, "BgColor", &m_bgColor));
+    addOptionItem(new OptionColor(bLowColor ? QColor(Qt::lightGray) : qRgb(224, 224, 224), "DiffBgColor", &m_diffBgColor));
+    addOptionItem(new OptionColor(bLowColor ? qRgb(0, 0, 255) : qRgb(0, 0, 200) /*blue*/, "ColorA", &m_colorA));
+    addOptionItem(new OptionColor(bLowColor ? qRgb(0, 128, 0) : qRgb(0, 150, 0) /*green*/, "ColorB", &m_colorB));
+    addOptionItem(new OptionColor(bLowColor ? qRgb(128, 0, 128) : qRgb(150, 0, 150) /*magenta*/, "ColorC", &m_colorC));
+    addOptionItem(new OptionColor(Qt::red, "ColorForConflict", &m_colorForConflict));
+    addOptionItem(new OptionColor(bLowColor ? qRgb(192, 192, 192) : qRgb(220, 220, 100), "CurrentRangeBgColor", &m_currentRangeBgColor));
+    addOptionItem(new OptionColor(bLowColor ? qRgb(255, 255, 0) : qRgb(255, 255, 150), "CurrentRangeDiffBgColor", &m_currentRangeDiffBgColor));
+    addOptionItem(new OptionColor(qRgb(0xff, 0xd0, 0x80), "ManualAlignmentRangeColor", &m_manualHelpRangeColor));
+    addOptionItem(new OptionColor(qRgb(0, 0xd0, 0), "NewestFileColor", &m_newestFileColor));
+    addOptionItem(new OptionColor(qRgb(0xf0, 0, 0), "OldestFileColor", &m_oldestFileColor));
+    addOptionItem(new OptionColor(qRgb(0xc0, 0xc0, 0), "MidAgeFileColor", &m_midAgeFileColor));
+    addOptionItem(new OptionColor(qRgb(0, 0, 0), "MissingFileColor", &m_missingFileColor));
+
+    // Editor page
+    addOptionItem(new OptionToggleAction(false, "ReplaceTabs", &m_bReplaceTabs));
+    addOptionItem(new OptionNum<int>(8, "TabSize", &m_tabSize));
+    addOptionItem(new OptionToggleAction(true, "AutoIndentation", &m_bAutoIndentation));
+    addOptionItem(new OptionToggleAction(false, "AutoCopySelection", &m_bAutoCopySelection));
+
+    // Merge page
+    addOptionItem(new OptionNum<int>(500, "AutoAdvanceDelay", &m_autoAdvanceDelay));
+    addOptionItem(new OptionToggleAction(true, "ShowInfoDialogs", &m_bShowInfoDialogs));
+    addOptionItem(new OptionStringHistory(".*\\$(Version|Header|Date|Author).*\\$.*", "AutoMergeRegExp", &m_autoMergeRegExp));
+    addOptionItem(new OptionStringHistory(".*\\$Log.*\\$.*", "HistoryStartRegExp", &m_historyStartRegExp));
+    // Example line:  "** \main\rolle_fsp_dev_008\1   17 Aug 2001 10:45:44   rolle"
+    QString historyEntryStartDefault =
+        "\\s*\\\\main\\\\(\\S+)\\s+"                         // Start with  "\main\"
+        "([0-9]+) "                                          // day
+        "(Jan|Feb|Mar|Apr|May|Jun|Jul|Aug|Sep|Oct|Nov|Dec) " //month
+        "([0-9][0-9][0-9][0-9]) "                            // year
+        "([0-9][0-9]:[0-9][0-9]:[0-9][0-9])\\s+(.*)";        // time, name
+    addOptionItem(new OptionStringHistory(historyEntryStartDefault, "HistoryEntryStartRegExp", &m_historyEntryStartRegExp));
+    addOptionItem(new OptionToggleAction(false, "HistoryMergeSorting", &m_bHistoryMergeSorting));
+    //QDate(year,month,day).toString(Qt::ISODate) +" "+ time + " " + branch + " " + name;
+    addOptionItem(new OptionStringHistory("4,3,2,5,1,6", "HistoryEntryStartSortKeyOrder", &m_historyEntryStartSortKeyOrder));
+    addOptionItem(new OptionNum<int>(-1, "MaxNofHistoryEntries", &m_maxNofHistoryEntries));
+
+    // Directory merge page
+    addOptionItem(new OptionToggleAction(true, "RecursiveDirs", &m_bDmRecursiveDirs));
+    addOptionItem(new OptionStringHistory("*", "FilePattern", &m_DmFilePattern));
+    addOptionItem(new OptionStringHistory("*.orig;*.o;*.obj;*.rej;*.bak", "FileAntiPattern", &m_DmFileAntiPattern));
+    addOptionItem(new OptionStringHistory("CVS;.deps;.svn;.hg;.git", "DirAntiPattern", &m_DmDirAntiPattern));
+    addOptionItem(new OptionToggleAction(false, "UseCvsIgnore", &m_bDmUseCvsIgnore));
+    addOptionItem(new OptionToggleAction(true, "FindHidden", &m_bDmFindHidden));
+    addOptionItem(new OptionToggleAction(false, "FollowFileLinks", &m_bDmFollowFileLinks));
+    addOptionItem(new OptionToggleAction(false, "FollowDirLinks", &m_bDmFollowDirLinks));
+#if defined(Q_OS_WIN)
+    bool bCaseSensitiveFilenameComparison = false;
+#else
+    bool bCaseSensitiveFilenameComparison = true;
+#endif
+    addOptionItem(new OptionToggleAction(bCaseSensitiveFilenameComparison, "CaseSensitiveFilenameComparison", &m_bDmCaseSensitiveFilenameComparison));
+    addOptionItem(new OptionToggleAction(false, "UnfoldSubdirs", &m_bDmUnfoldSubdirs));
+    addOptionItem(new OptionToggleAction(false, "SkipDirStatus", &m_bDmSkipDirStatus));
+    addOptionItem(new OptionToggleAction(true, "BinaryComparison", &m_bDmBinaryComparison));
+    addOptionItem(new OptionToggleAction(false, "FullAnalysis", &m_bDmFullAnalysis));
+    addOptionItem(new OptionToggleAction(false, "TrustDate", &m_bDmTrustDate));
+    addOptionItem(new OptionToggleAction(false, "TrustDateFallbackToBinary", &m_bDmTrustDateFallbackToBinary));
+    addOptionItem(new OptionToggleAction(false, "TrustSize", &m_bDmTrustSize));
+    addOptionItem(new OptionToggleAction(false, "UseHashCache", &m_bDmUseHashCache));
+    addOptionItem(new OptionToggleAction(false, "TrustHashCache", &m_bDmTrustHashCache));
+    addOptionItem(new OptionToggleAction(false, "HashDifferingFiles", &m_bDmHashDifferingFiles));
+    addOptionItem(new OptionToggleAction(false, "SyncMode", &m_bDmSyncMode));
+    addOptionItem(new OptionToggleAction(true, "WhiteSpaceEqual", &m_bDmWhiteSpaceEqual));
+    addOptionItem(new OptionToggleAction(false, "CopyNewer", &m_bDmCopyNewer));
+    addOptionItem(new OptionNum<int>(4, "MaxNofParallelDmOperations", &m_maxNofParallelDmOperations));
+    addOptionItem(new OptionNum<int>(4, "MaxNofParallelRemoteListings", &m_maxNofParallelRemoteListings));
+
+    // Regional page
+    addOptionItem(new OptionToggleAction(true, "SameEncoding", &m_bSameEncoding));
+    addOptionItem(new OptionToggleAction(false, "RightToLeftLanguage", &m_bRightToLeftLanguage));
+
+    // Integration page
+    addOptionItem(new OptionStringHistory("-u;-query;-html;-abort", "IgnorableCmdLineOptions", &m_ignorableCmdLineOptions));
+    addOptionItem(new OptionToggleAction(false, "EscapeKeyQuits", &m_bEscapeKeyQuits));
+
+    // Settings that are not shown in the option dialog
+    addOptionItem(new OptionToggleAction(false, "AutoAdvance", &m_bAutoAdvance));
+    addOptionItem(new OptionToggleAction(true, "ShowWhiteSpaceCharacters", &m_bShowWhiteSpaceCharacters));
+    addOptionItem(new OptionToggleAction(true, "ShowWhiteSpace", &m_bShowWhiteSpace));
+    addOptionItem(new OptionToggleAction(false, "ShowLineNumbers", &m_bShowLineNumbers));
+    addOptionItem(new OptionToggleAction(true, "HorizDiffWindowSplitting", &m_bHorizDiffWindowSplitting));
+    addOptionItem(new OptionToggleAction(false, "WordWrap", &m_bWordWrap));
+
+    addOptionItem(new OptionToggleAction(true, "ShowIdenticalFiles", &m_bDmShowIdenticalFiles));
+    addOptionItem(new OptionToggleAction(false, "WatchFolders", &m_bDmWatchFolders));
+
+    addOptionItem(new OptionStringList(&m_recentAFiles, "RecentAFiles"));
+    addOptionItem(new OptionStringList(&m_recentBFiles, "RecentBFiles"));
+    addOptionItem(new OptionStringList(&m_recentCFiles, "RecentCFiles"));
+    addOptionItem(new OptionStringList(&m_recentOutputFiles, "RecentOutputFiles"));
+    addOptionItem(new OptionStringList(&m_recentEncodings, "RecentEncodings"));
 }
 
-void Options::setToCurrent()
+void Options::initWithoutGui()
 {
-    for(OptionItemBase* item : mOptionItemList)
-    {
-        item->setToCurrent();
-    }
+    // readOptions() sets the defaults.
+    addOptionItem(new OptionNum<int>(eLineEndStyleAutoDetect, "LineEndStyle", (int*)&m_lineEndStyle));
+
+    addOptionItem(new OptionToggleAction(false, "IgnoreNumbers", &m_bIgnoreNumbers));
+    addOptionItem(new OptionToggleAction(false, "IgnoreComments", &m_bIgnoreComments));
+    addOptionItem(new OptionToggleAction(false, "IgnoreCase", &m_bIgnoreCase));
+    addOptionItem(new OptionStringHistory(QString(), "PreProcessorCmd", &m_PreProcessorCmd));
+    addOptionItem(new OptionStringHistory(QString(), "LineMatchingPreProcessorCmd", &m_LineMatchingPreProcessorCmd));
+    addOptionItem(new OptionToggleAction(false, "CachePreProcessorOutput", &m_bCachePreProcessorOutput));
+    addOptionItem(new OptionToggleAction(true, "TryHard", &m_bTryHard));
+    addOptionItem(new OptionNum<int>(eDiffAlgorithmGnuDiff, "DiffAlgorithm", (int*)&m_diffAlgorithm));
+    addOptionItem(new OptionNum<int>(0, "DiffTimeLimit", &m_diffTimeLimit));
+    addOptionItem(new OptionToggleAction(false, "Diff3AlignBC", &m_bDiff3AlignBC));
+
+    addOptionItem(new OptionNum<int>(0, "WhiteSpace2FileMergeDefault", &m_whiteSpace2FileMergeDefault));
+    addOptionItem(new OptionNum<int>(0, "WhiteSpace3FileMergeDefault", &m_whiteSpace3FileMergeDefault));
+    addOptionItem(new OptionToggleAction(false, "RunRegExpAutoMergeOnMergeStart", &m_bRunRegExpAutoMergeOnMergeStart));
+    addOptionItem(new OptionToggleAction(false, "RunHistoryAutoMergeOnMergeStart", &m_bRunHistoryAutoMergeOnMergeStart));
+    addOptionItem(new OptionStringHistory(QString(), "IrrelevantMergeCmd", &m_IrrelevantMergeCmd));
+    addOptionItem(new OptionToggleAction(false, "AutoSaveAndQuitOnMergeWithoutConflicts", &m_bAutoSaveAndQuitOnMergeWithoutConflicts));
+    addOptionItem(new OptionToggleAction(true, "CreateBakFiles", &m_bDmCreateBakFiles));
+
+    addOptionItem(new OptionCodecPointer("EncodingForA", &m_pEncodingA));
+    addOptionItem(new OptionToggleAction(true, "AutoDetectUnicodeA", &m_bAutoDetectUnicodeA));
+    addOptionItem(new OptionCodecPointer("EncodingForB", &m_pEncodingB));
+    addOptionItem(new OptionToggleAction(true, "AutoDetectUnicodeB", &m_bAutoDetectUnicodeB));
+    addOptionItem(new OptionCodecPointer("EncodingForC", &m_pEncodingC));
+    addOptionItem(new OptionToggleAction(true, "AutoDetectUnicodeC", &m_bAutoDetectUnicodeC));
+    addOptionItem(new OptionCodecPointer("EncodingForOutput", &m_pEncodingOut));
+    addOptionItem(new OptionToggleAction(true, "AutoSelectOutEncoding", &m_bAutoSelectOutEncoding));
+    addOptionItem(new OptionCodecPointer("EncodingForPP", &m_pEncodingPP));
 }
 
 void Options::saveOptions(const KSharedConfigPtr config)
@@ -97,20 +217,15 @@ const QString Options::parseOptions(const QStringList& optionList)
             const QString key = optionString.left(pos);
             const QString val = optionString.mid(pos + 1);
 
-            bool bFound = false;
-            for(OptionItemBase* item : mOptionItemList)
+            OptionItemBase* item = findItem(key);
+            if(item != nullptr)
             {
-                if(item->getSaveName() == key)
-                {
-                    item->doPreserve();
-                    ValueMap config;
-                    config.writeEntry(key, val); // Write the value as a string and
-                    item->read(&config);         // use the internal conversion from string to the needed value.
-                    bFound = true;
-                    break;
-                }
+                item->doPreserve();
+                ValueMap config;
+                config.writeEntry(key, val); // Write the value as a string and
+                item->read(&config);         // use the internal conversion from string to the needed value.
             }
-            if(!bFound)
+            else
             {
                 result += "No config item named \"" + key + "\"\n";
             }
@@ -139,3 +254,12 @@ void Options::addOptionItem(OptionItemBase* inItem)
     mOptionItemList.push_back(inItem);
 }
 
+OptionItemBase* Options::findItem(const QString& saveName) const
+{
+    for(OptionItemBase* item : mOptionItemList)
+    {
+        if(item->getSaveName() == saveName)
+            return item;
+    }
+    return nullptr;
+}
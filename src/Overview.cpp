@@ -8,8 +8,8 @@
 #include "Overview.h"
 
 #include "diff.h"
-#include "kdiff3.h"
 #include "options.h"
+#include "Tracing.h"
 
 #include <algorithm>    // for max
 
@@ -34,9 +34,11 @@ Overview::Overview(const QSharedPointer<Options> &pOptions)
     setFixedWidth(20);
 }
 
-void Overview::init(Diff3LineList* pDiff3LineList)
+void Overview::init(Diff3LineList* pDiff3LineList, bool bTripleDiff)
 {
     m_pDiff3LineList = pDiff3LineList;
+    m_bTripleDiff = bTripleDiff;
+    m_colorRuns.clear();
     m_pixmap = QPixmap(QSize(0, 0)); // make sure that a redraw happens
     update();
 }
@@ -44,10 +46,12 @@ void Overview::init(Diff3LineList* pDiff3LineList)
 void Overview::reset()
 {
     m_pDiff3LineList = nullptr;
+    m_colorRuns.clear();
 }
 
 void Overview::slotRedraw()
 {
+    m_colorRuns.clear();
     m_pixmap = QPixmap(QSize(0, 0)); // make sure that a redraw happens
     update();
 }
@@ -74,7 +78,8 @@ void Overview::setFirstLine(QtNumberType firstLine)
 void Overview::setOverviewMode(e_OverviewMode eOverviewMode)
 {
     mOverviewMode = eOverviewMode;
-    slotRedraw();
+    m_pixmap = QPixmap(QSize(0, 0)); // make sure that a redraw happens
+    update();
 }
 
 e_OverviewMode Overview::getOverviewMode()
@@ -108,166 +113,221 @@ void Overview::setPaintingAllowed(bool bAllowPainting)
     }
 }
 
-void Overview::drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int w, int h, int nofLines)
+Overview::ColorRun Overview::lineColorRun(const Diff3Line& d3l, e_OverviewMode eOverviewMode, bool bTripleDiff)
 {
-    p.setPen(Qt::black);
-    p.drawLine(x, 0, x, h);
-
-    if(nofLines == 0) return;
-
-    int line = 0;
-    int oldY = 0;
-    int oldConflictY = -1;
-    int wrapLineIdx = 0;
-    Diff3LineList::const_iterator i;
-    for(i = m_pDiff3LineList->begin(); i != m_pDiff3LineList->end();)
+    e_MergeDetails md;
+    bool bConflict;
+    bool bLineRemoved;
+    e_SrcSelector src;
+    d3l.mergeOneLine(md, bConflict, bLineRemoved, src, !bTripleDiff);
+
+    ColorRun run{e_RunColor::Background, false, 0, 0};
+    //if( bConflict )  c=m_pOptions->m_colorForConflict;
+    //else
+    if(eOverviewMode == e_OverviewMode::eOMNormal)
     {
-        const Diff3Line& d3l = *i;
-        int y = h * (line + 1) / nofLines;
-        e_MergeDetails md;
-        bool bConflict;
-        bool bLineRemoved;
-        e_SrcSelector src;
-        d3l.mergeOneLine(md, bConflict, bLineRemoved, src, !KDiff3App::isTripleDiff());
-
-        QColor c = m_pOptions->m_bgColor;
-        bool bWhiteSpaceChange = false;
-        //if( bConflict )  c=m_pOptions->m_colorForConflict;
-        //else
-        if(eOverviewMode == e_OverviewMode::eOMNormal)
+        switch(md)
         {
-            switch(md)
-            {
-            case e_MergeDetails::eDefault:
-            case e_MergeDetails::eNoChange:
-                c = m_pOptions->m_bgColor;
-                break;
-
-            case e_MergeDetails::eBAdded:
-            case e_MergeDetails::eBDeleted:
-            case e_MergeDetails::eBChanged:
-                c = bConflict ? m_pOptions->m_colorForConflict : m_pOptions->m_colorB;
-                bWhiteSpaceChange = d3l.isEqualAB() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::B));
-                break;
-
-            case e_MergeDetails::eCAdded:
-            case e_MergeDetails::eCDeleted:
-            case e_MergeDetails::eCChanged:
-                bWhiteSpaceChange = d3l.isEqualAC() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::C));
-                c = bConflict ? m_pOptions->m_colorForConflict : m_pOptions->m_colorC;
-                break;
-
-            case e_MergeDetails::eBCChanged:         // conflict
-            case e_MergeDetails::eBCChangedAndEqual: // possible conflict
-            case e_MergeDetails::eBCDeleted:         // possible conflict
-            case e_MergeDetails::eBChanged_CDeleted: // conflict
-            case e_MergeDetails::eCChanged_BDeleted: // conflict
-            case e_MergeDetails::eBCAdded:           // conflict
-            case e_MergeDetails::eBCAddedAndEqual:   // possible conflict
-                c = m_pOptions->m_colorForConflict;
-                break;
-            default:
-                Q_ASSERT(true);
-                break;
-            }
+        case e_MergeDetails::eDefault:
+        case e_MergeDetails::eNoChange:
+            run.color = e_RunColor::Background;
+            break;
+
+        case e_MergeDetails::eBAdded:
+        case e_MergeDetails::eBDeleted:
+        case e_MergeDetails::eBChanged:
+            run.color = bConflict ? e_RunColor::Conflict : e_RunColor::B;
+            run.bWhiteSpaceChange = d3l.isEqualAB() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::B));
+            break;
+
+        case e_MergeDetails::eCAdded:
+        case e_MergeDetails::eCDeleted:
+        case e_MergeDetails::eCChanged:
+            run.bWhiteSpaceChange = d3l.isEqualAC() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::C));
+            run.color = bConflict ? e_RunColor::Conflict : e_RunColor::C;
+            break;
+
+        case e_MergeDetails::eBCChanged:         // conflict
+        case e_MergeDetails::eBCChangedAndEqual: // possible conflict
+        case e_MergeDetails::eBCDeleted:         // possible conflict
+        case e_MergeDetails::eBChanged_CDeleted: // conflict
+        case e_MergeDetails::eCChanged_BDeleted: // conflict
+        case e_MergeDetails::eBCAdded:           // conflict
+        case e_MergeDetails::eBCAddedAndEqual:   // possible conflict
+            run.color = e_RunColor::Conflict;
+            break;
+        default:
+            Q_ASSERT(true);
+            break;
         }
-        else if(eOverviewMode == e_OverviewMode::eOMAvsB)
+    }
+    else if(eOverviewMode == e_OverviewMode::eOMAvsB)
+    {
+        switch(md)
         {
-            switch(md)
-            {
-            case e_MergeDetails::eDefault:
-            case e_MergeDetails::eNoChange:
-            case e_MergeDetails::eCAdded:
-            case e_MergeDetails::eCDeleted:
-            case e_MergeDetails::eCChanged:
-                break;
-            default:
-                c = m_pOptions->m_colorForConflict;
-                bWhiteSpaceChange = d3l.isEqualAB() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::B));
-                break;
-            }
+        case e_MergeDetails::eDefault:
+        case e_MergeDetails::eNoChange:
+        case e_MergeDetails::eCAdded:
+        case e_MergeDetails::eCDeleted:
+        case e_MergeDetails::eCChanged:
+            break;
+        default:
+            run.color = e_RunColor::Conflict;
+            run.bWhiteSpaceChange = d3l.isEqualAB() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::B));
+            break;
         }
-        else if(eOverviewMode == e_OverviewMode::eOMAvsC)
+    }
+    else if(eOverviewMode == e_OverviewMode::eOMAvsC)
+    {
+        switch(md)
         {
-            switch(md)
-            {
-            case e_MergeDetails::eDefault:
-            case e_MergeDetails::eNoChange:
-            case e_MergeDetails::eBAdded:
-            case e_MergeDetails::eBDeleted:
-            case e_MergeDetails::eBChanged:
-                break;
-            default:
-                c = m_pOptions->m_colorForConflict;
-                bWhiteSpaceChange = d3l.isEqualAC() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::C));
-                break;
-            }
+        case e_MergeDetails::eDefault:
+        case e_MergeDetails::eNoChange:
+        case e_MergeDetails::eBAdded:
+        case e_MergeDetails::eBDeleted:
+        case e_MergeDetails::eBChanged:
+            break;
+        default:
+            run.color = e_RunColor::Conflict;
+            run.bWhiteSpaceChange = d3l.isEqualAC() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::C));
+            break;
         }
-        else if(eOverviewMode == e_OverviewMode::eOMBvsC)
+    }
+    else if(eOverviewMode == e_OverviewMode::eOMBvsC)
+    {
+        switch(md)
         {
-            switch(md)
-            {
-            case e_MergeDetails::eDefault:
-            case e_MergeDetails::eNoChange:
-            case e_MergeDetails::eBCChangedAndEqual:
-            case e_MergeDetails::eBCDeleted:
-            case e_MergeDetails::eBCAddedAndEqual:
-                break;
-            default:
-                c = m_pOptions->m_colorForConflict;
-                bWhiteSpaceChange = d3l.isEqualBC() || (d3l.isWhiteLine(e_SrcSelector::B) && d3l.isWhiteLine(e_SrcSelector::C));
-                break;
-            }
+        case e_MergeDetails::eDefault:
+        case e_MergeDetails::eNoChange:
+        case e_MergeDetails::eBCChangedAndEqual:
+        case e_MergeDetails::eBCDeleted:
+        case e_MergeDetails::eBCAddedAndEqual:
+            break;
+        default:
+            run.color = e_RunColor::Conflict;
+            run.bWhiteSpaceChange = d3l.isEqualBC() || (d3l.isWhiteLine(e_SrcSelector::B) && d3l.isWhiteLine(e_SrcSelector::C));
+            break;
         }
+    }
 
-        int x2 = x;
-        int w2 = w;
-
-        if(!KDiff3App::isTripleDiff())
+    if(!bTripleDiff)
+    {
+        if(!d3l.getLineA().isValid() && d3l.getLineB().isValid())
         {
-            if(!d3l.getLineA().isValid() && d3l.getLineB().isValid())
-            {
-                c = m_pOptions->m_colorA;
-                x2 = w / 2;
-                w2 = x2;
-            }
-            if(d3l.getLineA().isValid() && !d3l.getLineB().isValid())
-            {
-                c = m_pOptions->m_colorB;
-                w2 = w / 2;
-            }
+            run.color = e_RunColor::A;
+            run.part = 2;
         }
-
-        if(!bWhiteSpaceChange || m_pOptions->m_bShowWhiteSpace)
+        if(d3l.getLineA().isValid() && !d3l.getLineB().isValid())
         {
-            // Make sure that lines with conflict are not overwritten.
-            if(c == m_pOptions->m_colorForConflict)
-            {
-                p.fillRect(x2 + 1, oldY, w2, std::max(1, y - oldY), bWhiteSpaceChange ? QBrush(c, Qt::Dense4Pattern) : QBrush(c));
-                oldConflictY = oldY;
-            }
-            else if(c != m_pOptions->m_bgColor && oldY > oldConflictY)
-            {
-                p.fillRect(x2 + 1, oldY, w2, std::max(1, y - oldY), bWhiteSpaceChange ? QBrush(c, Qt::Dense4Pattern) : QBrush(c));
-            }
+            run.color = e_RunColor::B;
+            run.part = 1;
         }
+    }
+
+    return run;
+}
 
-        oldY = y;
+// Walks the whole diff once per mode, m_colorRuns is cleared when the diff or the word wrap changes.
+const QVector<Overview::ColorRun>& Overview::colorRuns(e_OverviewMode eOverviewMode)
+{
+    std::map<e_OverviewMode, QVector<ColorRun>>::const_iterator it = m_colorRuns.find(eOverviewMode);
+    if(it != m_colorRuns.end())
+        return it->second;
+
+    QVector<ColorRun>& runs = m_colorRuns[eOverviewMode];
+    const bool bWordWrap = m_pOptions->wordWrapOn();
+    for(const Diff3Line& d3l: *m_pDiff3LineList)
+    {
+        ColorRun run = lineColorRun(d3l, eOverviewMode, m_bTripleDiff);
+        run.nofLines = bWordWrap ? std::max(1, d3l.linesNeededForDisplay()) : 1;
+        if(!runs.isEmpty() && runs.back().looksLike(run))
+            runs.back().nofLines += run.nofLines;
+        else
+            runs.push_back(run);
+    }
+    return runs;
+}
 
-        ++line;
-        if(m_pOptions->wordWrapOn())
+QColor Overview::runColor(e_RunColor color) const
+{
+    switch(color)
+    {
+    case e_RunColor::A:
+        return m_pOptions->m_colorA;
+    case e_RunColor::B:
+        return m_pOptions->m_colorB;
+    case e_RunColor::C:
+        return m_pOptions->m_colorC;
+    case e_RunColor::Conflict:
+        return m_pOptions->m_colorForConflict;
+    case e_RunColor::Background:
+        break;
+    }
+    return m_pOptions->m_bgColor;
+}
+
+// The row the line starts on.
+static qint64 lineY(qint64 line, int h, qint64 nofLines)
+{
+    return h * line / nofLines;
+}
+
+/*
+    Each run is filled with one rectangle, so this takes as long as there are runs and pixels no
+    matter how many lines there are. The result is the same as filling the rows of each line:
+    lines with conflict are not overwritten by other lines starting on the same row.
+*/
+void Overview::drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int w, int h)
+{
+    p.setPen(Qt::black);
+    p.drawLine(x, 0, x, h);
+
+    if(m_nofLines == 0 || h <= 0) return;
+
+    const qint64 nofLines = m_nofLines;
+    qint64 line = 0;
+    qint64 conflictY = -1;
+    for(const ColorRun& run: colorRuns(eOverviewMode))
+    {
+        const qint64 firstLine = line;
+        line += run.nofLines;
+
+        if(run.bWhiteSpaceChange && !m_pOptions->m_bShowWhiteSpace)
+            continue;
+
+        const QColor c = runColor(run.color);
+        qint64 top = lineY(firstLine, h, nofLines);
+        // Each line fills at least one row.
+        const qint64 bottom = std::max(lineY(line, h, nofLines), lineY(line - 1, h, nofLines) + 1);
+        if(c == m_pOptions->m_colorForConflict)
         {
-            ++wrapLineIdx;
-            if(wrapLineIdx >= d3l.linesNeededForDisplay())
-            {
-                wrapLineIdx = 0;
-                ++i;
-            }
+            conflictY = lineY(line - 1, h, nofLines);
         }
         else
         {
-            ++i;
+            if(c == m_pOptions->m_bgColor)
+                continue;
+
+            // Skip the lines that start on the row of the last conflict.
+            const qint64 firstFreeLine = std::max(firstLine, ((conflictY + 1) * nofLines + h - 1) / h);
+            if(firstFreeLine >= line)
+                continue;
+            top = lineY(firstFreeLine, h, nofLines);
         }
+
+        int x2 = x;
+        int w2 = w;
+        if(run.part == 1)
+        {
+            w2 = w / 2;
+        }
+        else if(run.part == 2)
+        {
+            x2 = x + w / 2;
+            w2 = w / 2;
+        }
+
+        p.fillRect(x2 + 1, (int)top, w2, (int)(bottom - top), run.bWhiteSpaceChange ? QBrush(c, Qt::Dense4Pattern) : QBrush(c));
     }
 }
 
@@ -280,7 +340,10 @@ void Overview::paintEvent(QPaintEvent*)
     const auto dpr = devicePixelRatioF();
     if(m_pixmap.size() != size() * dpr)
     {
-        m_nofLines = m_pDiff3LineList->numberOfLines(m_pOptions->wordWrapOn());
+        TraceSpan span("buildOverview");
+        m_nofLines = 0;
+        for(const ColorRun& run: colorRuns(e_OverviewMode::eOMNormal))
+            m_nofLines += run.nofLines;
 
         m_pixmap = QPixmap(size() * dpr);
         m_pixmap.setDevicePixelRatio(dpr);
@@ -288,15 +351,16 @@ void Overview::paintEvent(QPaintEvent*)
         QPainter p(&m_pixmap);
         p.fillRect(rect(), m_pOptions->m_bgColor);
 
-        if(!KDiff3App::isTripleDiff() || mOverviewMode == e_OverviewMode::eOMNormal)
+        if(!m_bTripleDiff || mOverviewMode == e_OverviewMode::eOMNormal)
         {
-            drawColumn(p, e_OverviewMode::eOMNormal, 0, w, h, m_nofLines);
+            drawColumn(p, e_OverviewMode::eOMNormal, 0, w, h);
         }
         else
         {
-            drawColumn(p, e_OverviewMode::eOMNormal, 0, w / 2, h, m_nofLines);
-            drawColumn(p, mOverviewMode, w / 2, w / 2, h, m_nofLines);
+            drawColumn(p, e_OverviewMode::eOMNormal, 0, w / 2, h);
+            drawColumn(p, mOverviewMode, w / 2, w / 2, h);
         }
+        span.setItemCount(m_nofLines);
     }
 
     QPainter painter(this);
@@ -13,8 +13,12 @@
 
 #include <QString>         // for QString
 #include <QPixmap>
+#include <QVector>
 #include <QWidget>
 
+#include <map>
+
+class Diff3Line;
 class Diff3LineList;
 class Options;
 
@@ -32,7 +36,7 @@ class Overview : public QWidget
   public:
     explicit Overview(const QSharedPointer<Options> &pOptions);
 
-    void init(Diff3LineList* pDiff3LineList);
+    void init(Diff3LineList* pDiff3LineList, bool bTripleDiff);
     void reset();
     void setRange(QtNumberType firstLine, QtNumberType pageHeight);
     void setPaintingAllowed(bool bAllowPainting);
@@ -47,18 +51,47 @@ class Overview : public QWidget
     void setLine(LineRef);
 
   private:
+    enum class e_RunColor : quint8
+    {
+        Background,
+        A,
+        B,
+        C,
+        Conflict
+    };
+
+    // Lines in a row that look the same in the overview.
+    struct ColorRun
+    {
+        e_RunColor color;
+        bool bWhiteSpaceChange;
+        quint8 part; // 0 for the full width, 1 for the left and 2 for the right half.
+        qint32 nofLines;
+
+        bool looksLike(const ColorRun& other) const { return color == other.color && bWhiteSpaceChange == other.bWhiteSpaceChange && part == other.part; }
+    };
+
     const Diff3LineList* m_pDiff3LineList;
+    bool m_bTripleDiff = false;
     QSharedPointer<Options> m_pOptions;
     LineRef m_firstLine;
     int m_pageHeight;
     QPixmap m_pixmap;
     e_OverviewMode mOverviewMode;
     int m_nofLines;
+    /*
+        The runs for each overview mode made so far. They only depend on the diff and the word wrap,
+        so resizing or switching the mode again just draws them.
+    */
+    std::map<e_OverviewMode, QVector<ColorRun>> m_colorRuns;
 
     void paintEvent(QPaintEvent* e) override;
     void mousePressEvent(QMouseEvent* e) override;
     void mouseMoveEvent(QMouseEvent* e) override;
-    void drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int w, int h, int nofLines);
+    static ColorRun lineColorRun(const Diff3Line& d3l, e_OverviewMode eOverviewMode, bool bTripleDiff);
+    const QVector<ColorRun>& colorRuns(e_OverviewMode eOverviewMode);
+    QColor runColor(e_RunColor color) const;
+    void drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int w, int h);
 };
 
 #endif // !OVERVIEW_H
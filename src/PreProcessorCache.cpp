@@ -0,0 +1,218 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "PreProcessorCache.h"
+
+#include "Logging.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextCodec>
+
+// Written at the start of the index file, an index with another value is ignored.
+static const quint32 indexFileMagic = 0x4B445050; // "KDPP"
+static const quint32 indexFileVersion = 1;
+
+PreProcessorCache& PreProcessorCache::instance()
+{
+    static PreProcessorCache cache;
+    return cache;
+}
+
+// Called while the application object still exists, QStandardPaths needs its name.
+static void saveAtExit()
+{
+    PreProcessorCache::instance().save();
+}
+
+QString PreProcessorCache::cacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/preprocessed";
+}
+
+QString PreProcessorCache::outputFileName(const QByteArray& key)
+{
+    return cacheDir() + '/' + QString::fromLatin1(key);
+}
+
+QByteArray PreProcessorCache::key(const QString& ppCmd, const QTextCodec* pEncoding, const QByteArray& input)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(ppCmd.toUtf8());
+    hash.addData("\0", 1);
+    if(pEncoding != nullptr)
+        hash.addData(pEncoding->name());
+    hash.addData("\0", 1);
+    hash.addData(input);
+    return hash.result().toHex();
+}
+
+bool PreProcessorCache::lookup(const QByteArray& key, QByteArray& output)
+{
+    QMutexLocker locker(&m_mutex);
+    load();
+
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+    if(it == m_entries.end())
+        return false;
+
+    QFile file(outputFileName(key));
+    if(!file.open(QIODevice::ReadOnly) || file.size() != it->size)
+    {
+        m_totalSize -= it->size;
+        m_entries.erase(it);
+        m_bModified = true;
+        return false;
+    }
+
+    // The new use is written with the next output or at the end.
+    output = file.readAll();
+    it->lastUsed = ++m_useCounter;
+    m_bModified = true;
+    return true;
+}
+
+void PreProcessorCache::insert(const QByteArray& key, const QByteArray& output)
+{
+    // An output that alone fills the cache would only remove all others.
+    if(output.size() > maxTotalSize / 4)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    load();
+
+    QDir().mkpath(cacheDir());
+    QSaveFile file(outputFileName(key));
+    if(!file.open(QIODevice::WriteOnly) || file.write(output) != output.size() || !file.commit())
+    {
+        qCInfo(kdiffFileAccess) << "Writing the preprocessor cache failed:" << file.errorString();
+        return;
+    }
+
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+    if(it != m_entries.end())
+        m_totalSize -= it->size;
+    m_entries.insert(key, Entry{output.size(), ++m_useCounter});
+    m_totalSize += output.size();
+
+    evict();
+    writeIndex();
+}
+
+// Removes the least recently used outputs until the others fit.
+void PreProcessorCache::evict()
+{
+    while(m_totalSize > maxTotalSize && !m_entries.isEmpty())
+    {
+        QHash<QByteArray, Entry>::iterator oldest = m_entries.begin();
+        for(QHash<QByteArray, Entry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+        {
+            if(it->lastUsed < oldest->lastUsed)
+                oldest = it;
+        }
+        QFile::remove(outputFileName(oldest.key()));
+        m_totalSize -= oldest->size;
+        m_entries.erase(oldest);
+    }
+}
+
+void PreProcessorCache::load()
+{
+    if(m_bLoaded)
+        return;
+    m_bLoaded = true;
+    qAddPostRoutine(saveAtExit);
+
+    QFile file(cacheDir() + "/index");
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    quint32 magic = 0, version = 0;
+    qint32 nofEntries = 0;
+    stream >> magic >> version >> nofEntries >> m_useCounter;
+    if(magic != indexFileMagic || version != indexFileVersion || nofEntries < 0)
+    {
+        m_useCounter = 0;
+        return;
+    }
+
+    m_entries.reserve(nofEntries);
+    for(qint32 i = 0; i < nofEntries && stream.status() == QDataStream::Ok; ++i)
+    {
+        QByteArray key;
+        Entry entry{0, 0};
+        stream >> key >> entry.size >> entry.lastUsed;
+        if(stream.status() == QDataStream::Ok)
+        {
+            m_entries.insert(key, entry);
+            m_totalSize += entry.size;
+        }
+    }
+
+    if(stream.status() != QDataStream::Ok)
+    {
+        qCInfo(kdiffFileAccess) << "Ignoring damaged preprocessor cache" << cacheDir();
+        m_entries.clear();
+        m_totalSize = 0;
+        m_useCounter = 0;
+    }
+
+    /*
+        Outputs the index doesn't know, e.g. of another instance that didn't write its index yet or
+        of a crashed run. They are kept and count for the size, as the least recently used.
+        Only names of keys, a hex SHA-256, so unfinished files of QSaveFile are left alone.
+    */
+    const QFileInfoList fileInfos = QDir(cacheDir()).entryInfoList(QDir::Files);
+    for(const QFileInfo& fileInfo: fileInfos)
+    {
+        const QByteArray key = fileInfo.fileName().toLatin1();
+        if(key.size() == 64 && !m_entries.contains(key))
+        {
+            m_entries.insert(key, Entry{fileInfo.size(), 0});
+            m_totalSize += fileInfo.size();
+        }
+    }
+}
+
+void PreProcessorCache::save()
+{
+    QMutexLocker locker(&m_mutex);
+    if(m_bModified)
+        writeIndex();
+}
+
+void PreProcessorCache::writeIndex()
+{
+    QDir().mkpath(cacheDir());
+    QSaveFile file(cacheDir() + "/index");
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qCInfo(kdiffFileAccess) << "Writing the preprocessor cache failed:" << file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << indexFileMagic << indexFileVersion << (qint32)m_entries.size() << m_useCounter;
+    for(QHash<QByteArray, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+        stream << it.key() << it->size << it->lastUsed;
+
+    if(!file.commit())
+    {
+        qCInfo(kdiffFileAccess) << "Writing the preprocessor cache failed:" << file.errorString();
+        return;
+    }
+    m_bModified = false;
+}
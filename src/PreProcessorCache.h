@@ -0,0 +1,66 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef PREPROCESSORCACHE_H
+#define PREPROCESSORCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+class QTextCodec;
+
+/*
+    The outputs of the preprocessor commands kept on disk between runs, so reopening or reloading
+    an unchanged file doesn't start the command again. An output is found by the hash of the input
+    together with the command line and the encoding the command gets, so a command that reads other
+    files than its input (e.g. a formatter with a configuration file) must not change its result.
+    The least recently used outputs are removed once all of them take more than maxTotalSize.
+    Only used with Options::m_bCachePreProcessorOutput. Safe to use from several threads at once.
+*/
+class PreProcessorCache
+{
+  public:
+    static PreProcessorCache& instance();
+
+    static QByteArray key(const QString& ppCmd, const QTextCodec* pEncoding, const QByteArray& input);
+
+    // Returns false if there is no output for the key.
+    bool lookup(const QByteArray& key, QByteArray& output);
+    void insert(const QByteArray& key, const QByteArray& output);
+
+    // Writes the index back if it changed, this is done at the end of the program anyway.
+    void save();
+
+  private:
+    struct Entry
+    {
+        qint64 size;
+        qint64 lastUsed; // Counts up with every use, a clock could go backwards.
+    };
+
+    PreProcessorCache() = default;
+
+    static QString cacheDir();
+    static QString outputFileName(const QByteArray& key);
+
+    void load();
+    void writeIndex();
+    void evict();
+
+    static const qint64 maxTotalSize = 256 * 1024 * 1024;
+
+    QMutex m_mutex;
+    QHash<QByteArray, Entry> m_entries;
+    qint64 m_totalSize = 0;
+    qint64 m_useCounter = 0;
+    bool m_bLoaded = false;
+    bool m_bModified = false; // Uses or removals the index file doesn't have yet
+};
+
+#endif // !PREPROCESSORCACHE_H
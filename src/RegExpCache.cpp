@@ -0,0 +1,34 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "RegExpCache.h"
+
+QRegularExpression RegExpCache::compileExactMatch(const QString& pattern)
+{
+    QRegularExpression regExp("\\A(?:" + pattern + ")\\z");
+    // Otherwise Qt warns on every match with an invalid expression.
+    if(!regExp.isValid())
+        regExp.setPattern("(?!)");
+
+    // JIT compiled now instead of after a number of matches.
+    regExp.optimize();
+    return regExp;
+}
+
+QRegularExpression RegExpCache::exactMatch(const QString& pattern)
+{
+    QHash<QString, QRegularExpression>::const_iterator it = m_regExps.constFind(pattern);
+    if(it != m_regExps.constEnd())
+        return *it;
+
+    if(m_regExps.size() >= maxNofRegExps)
+        m_regExps.clear();
+
+    const QRegularExpression regExp = compileExactMatch(pattern);
+    m_regExps.insert(pattern, regExp);
+    return regExp;
+}
@@ -0,0 +1,34 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef REGEXPCACHE_H
+#define REGEXPCACHE_H
+
+#include <QHash>
+#include <QRegularExpression>
+#include <QString>
+
+/*
+    The regular expressions of the merge options, compiled and optimized on first use and kept
+    for the following merges. The patterns match whole lines, as QRegExp::exactMatch() did.
+*/
+class RegExpCache
+{
+  public:
+    // Matches the strings the pattern matches as a whole. An invalid pattern matches nothing.
+    static QRegularExpression compileExactMatch(const QString& pattern);
+
+    // Compiles the pattern only if it wasn't used before. Safe to match with from several threads.
+    QRegularExpression exactMatch(const QString& pattern);
+
+  private:
+    // Edited options leave stale patterns behind.
+    static const int maxNofRegExps = 16;
+
+    QHash<QString, QRegularExpression> m_regExps;
+};
+
+#endif // !REGEXPCACHE_H
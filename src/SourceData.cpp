@@ -17,14 +17,14 @@
 Order of operation:
  1. If data was given via a string then save it to a temp file. (see setData())
  2. If the specified file is nonlocal (URL) copy it to a temp file.
- 3. If a preprocessor was specified, run the input file through it.
- 4. Read the output of the preprocessor.
+ 3. Read the input file (local files are memory mapped).
+ 4. If a preprocessor was specified, pipe the data through it and keep its output.
  5. If Uppercase was specified: Turn the read data to uppercase.
- 6. Write the result to a temp file.
- 7. If a line-matching preprocessor was specified, run the temp file through it.
- 8. Read the output of the line-matching preprocessor.
- 9. If ignore numbers was specified, strip the LMPP-output of all numbers.
-10. If ignore comments was specified, strip the LMPP-output of comments.
+ 6. If a line-matching preprocessor was specified, pipe the result through it.
+    This runs in parallel to decoding the normal data.
+ 7. Read the output of the line-matching preprocessor.
+ 8. If ignore numbers was specified, strip the LMPP-output of all numbers.
+ 9. If ignore comments was specified, strip the LMPP-output of comments.
 
 Optimizations: Skip unneeded steps.
 */
@@ -33,22 +33,45 @@ Optimizations: Skip unneeded steps.
 #include "CommentParser.h"
 #include "Utils.h"
 #include "diff.h"
+#include "gnudiff_diff.h"
 #include "Logging.h"
-
+#include "MemoryUsage.h"
+#include "PreProcessorCache.h"
+#include "StreamInput.h"
+#include "TaskGroup.h"
+#include "Tracing.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
 #include <QScopedPointer>
+#include <QSemaphore>
 #include <QProcess>
 #include <QString>
 #include <QTemporaryFile>
 #include <QTextCodec>
-#include <QTextStream>
 #include <QVector>
 
+#include <algorithm>
+
 #include <KLocalizedString>
 
+/*
+    The bytes decoded at a time, see FileData::m_textChunks, and the characters of the chunks built
+    from lines. A chunk of preprocess() also holds the start of a line carried over from the piece
+    before, that makes up to twice as much or, for a single long line, up to TYPE_MAX(QtNumberType).
+*/
+static const qint64 maxChunkLength = 1 << 28;
+
 void SourceData::reset()
 {
     m_pEncoding = nullptr;
     m_fileAccess = FileAccess();
+    m_streamName = QString();
+    m_streamData = QByteArray();
+    m_fetchedData = QByteArray();
+    m_fetchError = QString();
+    m_bFetched = false;
     m_normalData.reset();
     m_lmppData.reset();
     if(!m_tempInputFileName.isEmpty())
@@ -64,6 +87,15 @@ void SourceData::setFilename(const QString& filename)
     {
         reset();
     }
+    else if(StreamInput::isStreamInput(filename))
+    {
+        // Setting the same input again must not drop the data, standard input can't be read twice.
+        if(filename != m_streamName)
+        {
+            setFileAccess(FileAccess());
+            m_streamName = filename;
+        }
+    }
     else
     {
         FileAccess fa(filename);
@@ -78,7 +110,7 @@ bool SourceData::isEmpty() const
 
 bool SourceData::hasData() const
 {
-    return m_normalData.m_pBuf != nullptr;
+    return m_normalData.hasData();
 }
 
 bool SourceData::isValid() const
@@ -93,12 +125,14 @@ void SourceData::setOptions(const QSharedPointer<Options> &pOptions)
 
 QString SourceData::getFilename() const
 {
-    return m_fileAccess.absoluteFilePath();
+    return isStreamInput() ? m_streamName : m_fileAccess.absoluteFilePath();
 }
 
 QString SourceData::getAliasName() const
 {
-    return m_aliasName.isEmpty() ? m_fileAccess.prettyAbsPath() : m_aliasName;
+    if(!m_aliasName.isEmpty())
+        return m_aliasName;
+    return isStreamInput() ? m_streamName : m_fileAccess.prettyAbsPath();
 }
 
 void SourceData::setAliasName(const QString& name)
@@ -109,6 +143,11 @@ void SourceData::setAliasName(const QString& name)
 void SourceData::setFileAccess(const FileAccess& fileAccess)
 {
     m_fileAccess = fileAccess;
+    m_streamName = QString();
+    m_streamData = QByteArray();
+    m_fetchedData = QByteArray();
+    m_fetchError = QString();
+    m_bFetched = false;
     m_aliasName = QString();
     if(!m_tempInputFileName.isEmpty())
     {
@@ -141,6 +180,8 @@ const QString SourceData::setData(const QString& data)
     {
         m_aliasName = i18n("From Clipboard");
         m_fileAccess = FileAccess(); // Insure m_fileAccess is not valid
+        m_streamName = QString();
+        m_streamData = QByteArray();
     }
 
     return QLatin1String("");
@@ -148,12 +189,28 @@ const QString SourceData::setData(const QString& data)
 
 const QVector<LineData>* SourceData::getLineDataForDiff() const
 {
-    if(m_lmppData.m_pBuf == nullptr)
+    if(m_lmppData.m_v.isEmpty())
         return m_normalData.m_v.size() > 0 ? &m_normalData.m_v : nullptr;
     else
         return m_lmppData.m_v.size() > 0 ? &m_lmppData.m_v : nullptr;
 }
 
+const QVector<size_t>* SourceData::getLineHashesForDiff(bool bIgnoreNumbers)
+{
+    if(m_lmppData.m_v.isEmpty())
+        return m_normalData.m_v.size() > 0 ? &m_normalData.lineHashes(bIgnoreNumbers) : nullptr;
+    else
+        return m_lmppData.m_v.size() > 0 ? &m_lmppData.lineHashes(bIgnoreNumbers) : nullptr;
+}
+
+const QVector<LineData>* SourceData::getNormalizedLineDataForDiff(bool bIgnoreNumbers)
+{
+    if(m_lmppData.m_v.isEmpty())
+        return m_normalData.m_v.size() > 0 ? &m_normalData.normalizedLines(bIgnoreNumbers) : nullptr;
+    else
+        return m_lmppData.m_v.size() > 0 ? &m_lmppData.normalizedLines(bIgnoreNumbers) : nullptr;
+}
+
 const QVector<LineData>* SourceData::getLineDataForDisplay() const
 {
     return m_normalData.m_v.size() > 0 ? &m_normalData.m_v : nullptr;
@@ -169,51 +226,192 @@ qint64 SourceData::getSizeBytes() const
     return m_normalData.m_size;
 }
 
-const char* SourceData::getBuf() const
+bool SourceData::isText() const
 {
-    return m_normalData.m_pBuf;
+    return m_normalData.isText() || m_normalData.isEmpty();
 }
 
-const QString& SourceData::getText() const
+bool SourceData::isIncompleteConversion() const
 {
-    return *m_normalData.m_unicodeBuf;
+    return m_normalData.m_bIncompleteConversion;
 }
 
-bool SourceData::isText() const
+bool SourceData::isFromBuffer() const
 {
-    return m_normalData.isText() || m_normalData.isEmpty();
+    return !m_fileAccess.isValid() && !isStreamInput();
 }
 
-bool SourceData::isIncompleteConversion() const
+void SourceData::setFetchedData(const QByteArray& data, const QString& errorReason)
 {
-    return m_normalData.m_bIncompleteConversion;
+    m_fetchedData = data;
+    m_fetchError = errorReason;
+    m_bFetched = true;
 }
 
-bool SourceData::isFromBuffer() const
+bool SourceData::inputExists() const
 {
-    return !m_fileAccess.isValid();
+    return m_fileAccess.exists() || !m_streamData.isNull();
 }
 
-bool SourceData::isBinaryEqualWith(const QSharedPointer<SourceData>& other) const
+bool SourceData::isBinaryEqualWith(const QSharedPointer<SourceData>& other)
 {
-    return m_fileAccess.exists() && other->m_fileAccess.exists() &&
-           getSizeBytes() == other->getSizeBytes() &&
-           (getSizeBytes() == 0 || memcmp(getBuf(), other->getBuf(), getSizeBytes()) == 0);
+    if(!inputExists() || !other->inputExists() || getSizeBytes() != other->getSizeBytes())
+        return false;
+
+    if(getSizeBytes() == 0)
+        return true;
+
+    const char* pBuf1 = m_normalData.rawData();
+    const char* pBuf2 = other->m_normalData.rawData();
+    bool bEqual = pBuf1 != nullptr && pBuf2 != nullptr && memcmp(pBuf1, pBuf2, getSizeBytes()) == 0;
+
+    m_normalData.unmapFile();
+    other->m_normalData.unmapFile();
+    return bEqual;
+}
+
+// Reads a block at offset from both files. A file that got shorter meanwhile counts as different.
+static bool equalFileBlocks(QFile& file1, QFile& file2, qint64 offset, qint64 len, QByteArray& buf1, QByteArray& buf2)
+{
+    buf1.resize((int)len);
+    buf2.resize((int)len);
+    return file1.seek(offset) && file2.seek(offset) && file1.read(buf1.data(), len) == len && file2.read(buf2.data(), len) == len &&
+           memcmp(buf1.constData(), buf2.constData(), (size_t)len) == 0;
+}
+
+/*
+    An input often equals another one, e.g. the base and the local version of a merge. Comparing the
+    files costs less than decoding one of them. Other than isBinaryEqualWith() only local files are
+    compared, before either is read. Blocks at the start, in the middle and at the end are compared
+    first, so most differing files are found without reading the rest. The files are read rather
+    than mapped, a mapping of a file that is truncated meanwhile would raise SIGBUS.
+*/
+bool SourceData::hasEqualFileAs(const QSharedPointer<SourceData>& other) const
+{
+    static const qint64 sampleSize = 4096;
+    static const qint64 chunkSize = 1024 * 1024;
+
+    const FileAccess& file1 = m_fileAccess;
+    const FileAccess& file2 = other->m_fileAccess;
+    if(!file1.isValid() || !file2.isValid() || !file1.isLocal() || !file2.isLocal() || !file1.isNormal() || !file2.isNormal() ||
+       !file1.exists() || !file2.exists() || file1.size() != file2.size())
+        return false;
+
+    if(file1.absoluteFilePath() == file2.absoluteFilePath() || file1.size() == 0)
+        return true;
+
+    TraceSpan span("compareInputFiles", file1.size());
+    QFile qFile1(file1.absoluteFilePath());
+    QFile qFile2(file2.absoluteFilePath());
+    if(!qFile1.open(QIODevice::ReadOnly) || !qFile2.open(QIODevice::ReadOnly) || qFile1.size() != qFile2.size())
+        return false;
+
+    const qint64 size = qFile1.size();
+    const qint64 sampleLen = std::min(size, sampleSize);
+    const qint64 sampleOffsets[] = {0, (size - sampleLen) / 2, size - sampleLen};
+    QByteArray buf1;
+    QByteArray buf2;
+    for(qint64 offset: sampleOffsets)
+    {
+        if(!equalFileBlocks(qFile1, qFile2, offset, sampleLen, buf1, buf2))
+            return false;
+    }
+
+    for(qint64 offset = sampleLen; offset < size; offset += chunkSize)
+    {
+        if(!equalFileBlocks(qFile1, qFile2, offset, std::min(size - offset, chunkSize), buf1, buf2))
+            return false;
+    }
+    return true;
+}
+
+void SourceData::shareDataOf(const QSharedPointer<SourceData>& other)
+{
+    m_pEncoding = other->m_pEncoding;
+    m_bPreProcessorFailed = false;
+    m_bLineMatchingPreProcessorFailed = false;
+    m_normalData.shareDecodedData(other->m_normalData);
+    m_lmppData.shareDecodedData(other->m_lmppData);
+}
+
+bool SourceData::sharesDataWith(const QSharedPointer<SourceData>& other) const
+{
+    return hasData() && m_normalData.m_v.isSharedWith(other->m_normalData.m_v) && m_lmppData.m_v.isSharedWith(other->m_lmppData.m_v);
+}
+
+/*
+    Returns the byte ranges in which the raw data of both files differs. The data is only mapped
+    while comparing, it is neither copied nor decoded.
+*/
+QVector<BinaryDiff::Range> SourceData::binaryDiffWith(const QSharedPointer<SourceData>& other)
+{
+    QVector<BinaryDiff::Range> ranges;
+    if(!inputExists() || !other->inputExists())
+        return ranges;
+
+    const uchar* pBuf1 = reinterpret_cast<const uchar*>(m_normalData.rawData());
+    const uchar* pBuf2 = reinterpret_cast<const uchar*>(other->m_normalData.rawData());
+    if((pBuf1 != nullptr || getSizeBytes() == 0) && (pBuf2 != nullptr || other->getSizeBytes() == 0))
+        ranges = BinaryDiff(pBuf1, getSizeBytes(), pBuf2, other->getSizeBytes()).run();
+
+    m_normalData.unmapFile();
+    other->m_normalData.unmapFile();
+    return ranges;
+}
+
+qint64 SourceData::memoryUsage() const
+{
+    // The lmpp data reuses the text and lines of the normal data when only comments are removed.
+    return m_normalData.memoryUsage() + m_lmppData.memoryUsage(&m_normalData);
+}
+
+qint64 SourceData::FileData::memoryUsage(const FileData* pShared) const
+{
+    qint64 bytes = MemoryUsage::ofVector(m_lineHashes) + MemoryUsage::ofVector(m_normalizedLines);
+    for(const QSharedPointer<TextChunk>& pChunk : m_normalizedChunks)
+        bytes += pChunk->memoryUsage();
+    // A mapped file is no heap memory, the system can drop its pages any time.
+    if(m_pMappedFile == nullptr)
+        bytes += m_byteBuf.isNull() ? (m_pBuf != nullptr ? m_size : 0) : m_byteBuf.capacity();
+
+    for(const QSharedPointer<TextChunk>& pChunk : m_textChunks)
+    {
+        if(pShared == nullptr || !pShared->m_textChunks.contains(pChunk))
+            bytes += pChunk->memoryUsage();
+    }
+    if(pShared == nullptr || !m_v.isSharedWith(pShared->m_v))
+        bytes += MemoryUsage::ofVector(m_v);
+    return bytes;
 }
 
 void SourceData::FileData::reset()
 {
-    if(m_pBuf != nullptr)
+    if(m_pMappedFile != nullptr)
+    {
+        unmapFile();
+        m_pMappedFile.reset();
+    }
+    else if(!m_byteBuf.isNull())
+    {
+        m_byteBuf.clear();
+    }
+    else if(m_pBuf != nullptr)
     {
         delete[](char*) m_pBuf;
-        m_pBuf = nullptr;
     }
+    m_pBuf = nullptr;
+    // The old text may still be shared with other line data, e.g. the lmpp data or a copy kept during a reload.
+    m_textChunks.clear();
     m_v.clear();
+    m_lineHashes.clear();
+    m_normalizedChunks.clear();
+    m_normalizedLines.clear();
     m_size = 0;
     m_vSize = 0;
     m_bIsText = false;
     m_bIncompleteConversion = false;
     m_eLineEndStyle = eLineEndStyleUndefined;
+    m_bFinalLineEnd = true;
 }
 
 bool SourceData::FileData::readFile(FileAccess& file)
@@ -229,6 +427,10 @@ bool SourceData::FileData::readFile(FileAccess& file)
     if(!file.isNormal())
         return true;
 
+    // Local files are mapped rather than copied. Empty files can't be mapped, the heap path handles those.
+    if(file.isLocal() && mapFile(file.absoluteFilePath()))
+        return true;
+
     m_size = file.sizeForReading();
     char* pBuf;
     m_pBuf = pBuf = new char[m_size + 100]; // Alloc 100 byte extra: Safety hack, not nice but does no harm.
@@ -252,32 +454,86 @@ bool SourceData::FileData::readFile(FileAccess& file)
     return bSuccess;
 }
 
-bool SourceData::FileData::readFile(const QString& filename)
+bool SourceData::FileData::mapFile(const QString& filename)
 {
-    reset();
-    if(filename.isEmpty())
+    QSharedPointer<QFile> pFile = QSharedPointer<QFile>::create(filename);
+    if(!pFile->open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = pFile->size();
+    if(size <= 0)
+        return false;
+
+    // The mapping stays valid after close() until unmap() is called or pFile is destroyed.
+    uchar* pMap = pFile->map(0, size);
+    pFile->close();
+    if(pMap == nullptr)
     {
-        return true;
+        qCInfo(kdiffFileAccess) << "Mapping" << filename << "failed, reading into memory instead:" << pFile->errorString();
+        return false;
     }
 
-    FileAccess fa(filename);
+    m_pMappedFile = pFile;
+    m_mappedFileTime = QFileInfo(filename).lastModified();
+    m_pBuf = reinterpret_cast<const char*>(pMap);
+    m_size = size;
+    return true;
+}
 
-    if(!fa.isNormal())
-        return true;
+void SourceData::FileData::setData(const QByteArray& data)
+{
+    reset();
+    // Empty output still counts as data, so never keep a null array here.
+    m_byteBuf = data.isNull() ? QByteArray("") : data;
+    m_pBuf = m_byteBuf.constData();
+    m_size = m_byteBuf.size();
+}
 
-    m_size = fa.sizeForReading();
-    char* pBuf;
-    m_pBuf = pBuf = new char[m_size + 100]; // Alloc 100 byte extra: Safety hack, not nice but does no harm.
-                                            // Some extra bytes at the end of the buffer are needed by
-                                            // the diff algorithm. See also GnuDiff::diff_2_files().
-    bool bSuccess = fa.readFile(pBuf, m_size);
-    if(!bSuccess)
+// Returns an independent copy of the raw data, this is free if it already is a QByteArray.
+QByteArray SourceData::FileData::toByteArray()
+{
+    if(!m_byteBuf.isNull())
+        return m_byteBuf;
+
+    const char* pBuf = rawData();
+    return pBuf != nullptr ? QByteArray(pBuf, (int)m_size) : QByteArray();
+}
+
+void SourceData::FileData::unmapFile()
+{
+    if(m_pMappedFile == nullptr || m_pBuf == nullptr)
+        return;
+
+    if(!m_rereadData.empty())
+        std::vector<char>().swap(m_rereadData);
+    else
+        m_pMappedFile->unmap(reinterpret_cast<uchar*>(const_cast<char*>(m_pBuf)));
+    m_pBuf = nullptr;
+}
+
+/*
+    Returns the raw file content. After decoding a mapped file is no longer resident, so it is read
+    again. A mapping can't be used for that: a file truncated meanwhile would raise SIGBUS.
+    Returns nullptr if the file was changed in the meantime since the bytes would no longer match m_v.
+*/
+const char* SourceData::FileData::rawData()
+{
+    if(m_pBuf != nullptr || m_pMappedFile == nullptr)
+        return m_pBuf;
+
+    if(QFileInfo(m_pMappedFile->fileName()).lastModified() != m_mappedFileTime || !m_pMappedFile->open(QIODevice::ReadOnly))
+        return nullptr;
+
+    if(m_pMappedFile->size() == m_size)
     {
-        delete[] pBuf;
-        m_pBuf = nullptr;
-        m_size = 0;
+        m_rereadData.resize((size_t)m_size);
+        if(m_pMappedFile->read(m_rereadData.data(), m_size) == m_size)
+            m_pBuf = m_rereadData.data();
+        else
+            std::vector<char>().swap(m_rereadData);
     }
-    return bSuccess;
+    m_pMappedFile->close();
+    return m_pBuf;
 }
 
 bool SourceData::saveNormalDataAs(const QString& fileName)
@@ -292,45 +548,212 @@ bool SourceData::FileData::writeFile(const QString& filename)
         return true;
     }
 
+    const char* pBuf = rawData();
+    if(pBuf == nullptr && m_size > 0)
+        return false;
+
     FileAccess fa(filename);
-    bool bSuccess = fa.writeFile(m_pBuf, m_size);
+    bool bSuccess = fa.writeFile(pBuf, m_size);
+    unmapFile();
     return bSuccess;
 }
 
-//Depriated
-void SourceData::FileData::copyBufFrom(const FileData& src) //TODO: Remove me.
+/*
+    Takes over the text and lines of other, which was decoded from the same bytes. The raw data is
+    shared as well: a mapped file is mapped again on demand, see rawData().
+*/
+void SourceData::FileData::shareDecodedData(const FileData& other)
 {
     reset();
-    char* pBuf;
-    m_size = src.m_size;
-    m_pBuf = pBuf = new char[m_size + 100];
-    Q_ASSERT(src.m_pBuf != nullptr);
-    memcpy(pBuf, src.m_pBuf, m_size);
+    if(other.m_pMappedFile != nullptr)
+    {
+        m_pMappedFile = other.m_pMappedFile;
+        m_mappedFileTime = other.m_mappedFileTime;
+    }
+    else if(!other.m_byteBuf.isNull())
+        m_byteBuf = other.m_byteBuf;
+    else if(other.m_pBuf != nullptr)
+        m_byteBuf = QByteArray(other.m_pBuf, (int)other.m_size);
+    m_pBuf = m_byteBuf.isNull() ? nullptr : m_byteBuf.constData();
+    m_size = other.m_size;
+
+    m_textChunks = other.m_textChunks;
+    m_v = other.m_v;
+    m_vSize = other.m_vSize;
+    m_bIsText = other.m_bIsText;
+    m_bIncompleteConversion = other.m_bIncompleteConversion;
+    m_eLineEndStyle = other.m_eLineEndStyle;
+    m_bFinalLineEnd = other.m_bFinalLineEnd;
 }
 
-QTextCodec* SourceData::detectEncoding(const QString& fileName, QTextCodec* pFallbackCodec)
+/*
+    Makes this the line data of src with comments removed. As long as no line actually contains a
+    removable comment the text and line vector stay shared with src, only then a copy is made.
+*/
+void SourceData::FileData::copyWithoutComments(const FileData& src)
+{
+    reset();
+    m_textChunks = src.m_textChunks;
+    m_v = src.m_v;
+    m_vSize = src.m_vSize;
+    m_bIsText = true;
+    m_bIncompleteConversion = src.m_bIncompleteConversion;
+    m_eLineEndStyle = src.m_eLineEndStyle;
+
+    DefaultCommentParser parser;
+    bool bShared = true;
+    for(qint64 i = 0; i < m_vSize; ++i)
+    {
+        const LineData& srcLine = src.m_v[i];
+        QString line = srcLine.getLine();
+        // Shares the data with line until removeComment() changes it, line is a copy for Latin-1 text.
+        const QString unchanged = line;
+
+        parser.processLine(line);
+        parser.removeComment(line);
+        if(bShared && line.constData() == unchanged.constData())
+        {
+            if(parser.isPureComment())
+                m_v[i].setPureComment(true);
+            continue;
+        }
+
+        if(bShared)
+        {
+            // First line that differs: copy its chunk up to it and point the line data to the copy.
+            // The chunks before stay shared.
+            bShared = false;
+            const TextChunk* pSrcChunk = srcLine.getBuffer();
+            int nofSharedChunks = 0;
+            while(src.m_textChunks[nofSharedChunks].data() != pSrcChunk)
+                ++nofSharedChunks;
+            m_textChunks.resize(nofSharedChunks);
+            m_textChunks.push_back(QSharedPointer<TextChunk>::create(pSrcChunk->left(srcLine.getOffset())));
+            for(qint64 j = i - 1; j >= 0 && src.m_v[j].getBuffer() == pSrcChunk; --j)
+            {
+                const LineData& ld = src.m_v[j];
+                m_v[j] = LineData(m_textChunks.last().data(), ld.getOffset(), ld.size(), ld.getFirstNonWhiteChar(), m_v[j].isPureComment());
+            }
+        }
+
+        const QSharedPointer<TextChunk>& pChunk = chunkFor(line.length() + 1);
+        m_v[i] = LineData(pChunk.data(), pChunk->length(), line.length(), srcLine.getFirstNonWhiteChar(), parser.isPureComment());
+        pChunk->append(line + '\n');
+    }
+
+    if(!bShared)
+    {
+        m_v[m_vSize] = LineData(chunkFor(0).data(), m_textChunks.last()->length());
+        for(const QSharedPointer<TextChunk>& pChunk : m_textChunks)
+        {
+            if(!src.m_textChunks.contains(pChunk))
+                pChunk->compact();
+        }
+    }
+}
+
+const QSharedPointer<TextChunk>& SourceData::FileData::chunkFor(qint64 length)
+{
+    if(m_textChunks.isEmpty() || m_textChunks.last()->length() + length > maxChunkLength)
+        m_textChunks.push_back(QSharedPointer<TextChunk>::create());
+    return m_textChunks.last();
+}
+
+void SourceData::createLocalCopy()
 {
-    QFile f(fileName);
-    if(f.open(QIODevice::ReadOnly))
+    if(m_fileAccess.isValid() && !m_fileAccess.isLocal() && m_tempInputFileName.isEmpty())
     {
-        char buf[200];
-        qint64 size = f.read(buf, sizeof(buf));
-        qint64 skipBytes = 0;
-        QTextCodec* pCodec = detectEncoding(buf, size, skipBytes);
-        if(pCodec)
-            return pCodec;
+        m_fileAccess.createLocalCopy();
+        m_tempInputFileName = m_fileAccess.getTempName();
     }
-    return pFallbackCodec;
 }
 
+void SourceData::disableFailedPreProcessors()
+{
+    if(m_bPreProcessorFailed)
+        m_pOptions->m_PreProcessorCmd = "";
+    if(m_bLineMatchingPreProcessorFailed)
+        m_pOptions->m_LineMatchingPreProcessorCmd = "";
+
+    m_bPreProcessorFailed = false;
+    m_bLineMatchingPreProcessorFailed = false;
+}
+
+/*
+    Feeds input to the preprocessor command through its stdin and collects its stdout in output.
+    Doesn't need an event loop so this can run on any thread. With bUseCache an output of the same
+    command for the same input is taken from PreProcessorCache instead, only successful runs are kept there.
+*/
+static void runPreProcessor(const QString& ppCmd, const QTextCodec* pEncoding, bool bUseCache, const QByteArray& input, QByteArray& output, QString& errorReason)
+{
+    TraceSpan span("runPreProcessor", input.size());
+    QByteArray cacheKey;
+    if(bUseCache)
+    {
+        cacheKey = PreProcessorCache::key(ppCmd, pEncoding, input);
+        if(PreProcessorCache::instance().lookup(cacheKey, output))
+            return;
+    }
+
+    QString program;
+    QStringList args;
+    errorReason = Utils::getArguments(ppCmd, program, args);
+    if(!errorReason.isEmpty())
+    {
+        errorReason = "\n(" + errorReason + ')';
+        return;
+    }
+
+    QProcess ppProcess;
+    ppProcess.start(program, args);
+    if(!ppProcess.waitForStarted(-1))
+        return;
+
+    // waitForFinished() keeps writing stdin and reading stdout so large data can't deadlock on full pipes.
+    ppProcess.write(input);
+    ppProcess.closeWriteChannel();
+    ppProcess.waitForFinished(-1);
+    output = ppProcess.readAllStandardOutput();
+
+    // An empty output counts as failed for non-empty input, see readAndPreprocess().
+    if(bUseCache && ppProcess.exitStatus() == QProcess::NormalExit && (!output.isEmpty() || input.isEmpty()))
+        PreProcessorCache::instance().insert(cacheKey, output);
+}
+
+// Runs the line matching preprocessor while readAndPreprocess() decodes the normal data.
+class LineMatchingPreProcessorRunnable : public QRunnable
+{
+  private:
+    const QString& m_ppCmd;
+    const QTextCodec* m_pEncoding;
+    bool m_bUseCache;
+    const QByteArray& m_input;
+    QByteArray& m_output;
+    QString& m_errorReason;
+    QSemaphore& m_finished;
+
+  public:
+    LineMatchingPreProcessorRunnable(const QString& ppCmd, const QTextCodec* pEncoding, bool bUseCache, const QByteArray& input, QByteArray& output,
+                                     QString& errorReason, QSemaphore& finished)
+        : m_ppCmd(ppCmd), m_pEncoding(pEncoding), m_bUseCache(bUseCache), m_input(input), m_output(output), m_errorReason(errorReason), m_finished(finished)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        runPreProcessor(m_ppCmd, m_pEncoding, m_bUseCache, m_input, m_output, m_errorReason);
+        m_finished.release();
+    }
+};
+
 QStringList SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicode)
 {
+    TraceSpan span("readAndPreprocess");
     m_pEncoding = pEncoding;
-    QTemporaryFile fileIn1, fileOut1;
+    m_bPreProcessorFailed = false;
+    m_bLineMatchingPreProcessorFailed = false;
     QString fileNameIn1;
-    QString fileNameOut1;
-    QString fileNameIn2;
-    QString fileNameOut2;
     QStringList errors;
 
     if(m_fileAccess.isValid() && !m_fileAccess.isNormal())
@@ -339,28 +762,32 @@ QStringList SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetec
         return errors;
     }
 
-    bool bTempFileFromClipboard = !m_fileAccess.isValid();
+    const bool bStreamInput = isStreamInput();
+    // The data of a remote file from setFetchedData() is used once, a reload fetches it again.
+    const bool bFetched = m_bFetched && isRemote();
+    m_bFetched = false;
+    const bool bInMemory = bStreamInput || bFetched;
+    bool bTempFileFromClipboard = !m_fileAccess.isValid() && !bStreamInput;
 
     // Detect the input for the preprocessing operations
-    if(!bTempFileFromClipboard)
+    if(bStreamInput)
+    {
+        fileNameIn1 = m_streamName;
+    }
+    else if(!bTempFileFromClipboard)
     {
         if(m_fileAccess.isLocal())
         {
             fileNameIn1 = m_fileAccess.absoluteFilePath();
         }
-        else // File is not local: create a temporary local copy:
+        else if(bFetched)
         {
-            if(m_tempInputFileName.isEmpty())
-            {
-                m_fileAccess.createLocalCopy();
-                m_tempInputFileName = m_fileAccess.getTempName();
-            }
-
-            fileNameIn1 = m_tempInputFileName;
+            fileNameIn1 = m_fileAccess.prettyAbsPath();
         }
-        if(bAutoDetectUnicode)
+        else // File is not local: create a temporary local copy:
         {
-            m_pEncoding = detectEncoding(fileNameIn1, pEncoding);
+            createLocalCopy();
+            fileNameIn1 = m_tempInputFileName;
         }
     }
     else // The input was set via setData(), probably from clipboard.
@@ -374,74 +801,125 @@ QStringList SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetec
     m_normalData.reset();
     m_lmppData.reset();
 
-    FileAccess faIn(fileNameIn1);
-    qint64 fileInSize = faIn.size();
+    // FileAccess would take a git: input for a URL, and must not run KIO jobs on this thread.
+    FileAccess faIn(bInMemory ? QString() : fileNameIn1);
+    if(bFetched && !m_fetchError.isEmpty())
+    {
+        errors.append(m_fetchError);
+        m_fetchError = QString();
+        return errors;
+    }
+    if(bStreamInput && m_streamData.isNull())
+    {
+        QString errorReason;
+        if(!StreamInput::read(m_streamName, m_streamData, errorReason))
+        {
+            errors.append(errorReason);
+            return errors;
+        }
+    }
+    qint64 fileInSize = bStreamInput ? m_streamData.size() : bFetched ? m_fetchedData.size() : faIn.size();
 
-    if(faIn.exists())
+    if(bInMemory || faIn.exists())
     {
-        // Run the first preprocessor
-        if(m_pOptions->m_PreProcessorCmd.isEmpty())
+        if(bStreamInput)
         {
-            // No preprocessing: Read the file directly:
-            if(!m_normalData.readFile(faIn))
-            {
-                errors.append(faIn.getStatusText());
-                return errors;
-            }
+            // Shared, not copied.
+            m_normalData.setData(m_streamData);
         }
-        else
+        else if(bFetched)
         {
-            QTemporaryFile tmpInPPFile;
-            QString fileNameInPP = fileNameIn1;
+            m_normalData.setData(m_fetchedData);
+            m_fetchedData = QByteArray();
+        }
+        else if(!m_normalData.readFile(faIn))
+        {
+            errors.append(faIn.getStatusText());
+            return errors;
+        }
+
+        // The preprocessors get the data as a QByteArray, which holds less than 2 GiB.
+        const bool bFitsForPreProcessors = m_normalData.m_size <= TYPE_MAX(QtNumberType);
+        if(!bFitsForPreProcessors && (!m_pOptions->m_PreProcessorCmd.isEmpty() || !m_pOptions->m_LineMatchingPreProcessorCmd.isEmpty()))
+            errors.append(i18n("File %1 is too large for the preprocessors, it is compared without them.", fileNameIn1));
+
+        if(bAutoDetectUnicode && !bTempFileFromClipboard)
+        {
+            // Look at the data we already have instead of opening the file a second time.
+            TraceSpan detectSpan("detectEncoding", m_normalData.m_size);
+            qint64 skipBytes = 0;
+            QTextCodec* pCodec = detectEncoding(m_normalData.m_pBuf, m_normalData.m_size, skipBytes);
+            if(pCodec != nullptr)
+                m_pEncoding = pCodec;
+
+            pEncoding1 = m_pEncoding;
+            pEncoding2 = m_pEncoding;
+        }
+
+        // Run the first preprocessor
+        if(!m_pOptions->m_PreProcessorCmd.isEmpty() && bFitsForPreProcessors)
+        {
+            const QString ppCmd = m_pOptions->m_PreProcessorCmd;
+            QByteArray ppInput = QByteArray::fromRawData(m_normalData.m_pBuf, (int)m_normalData.m_size);
 
             if(pEncoding1 != m_pOptions->m_pEncodingPP)
             {
                 // Before running the preprocessor convert to the format that the preprocessor expects.
-                FileAccess::createTempFile(tmpInPPFile);
-                fileNameInPP = tmpInPPFile.fileName();
-                pEncoding1 = m_pOptions->m_pEncodingPP;
-                convertFileEncoding(fileNameIn1, pEncoding, fileNameInPP, pEncoding1);
+                ppInput = convertEncoding(ppInput, pEncoding1, m_pOptions->m_pEncodingPP);
             }
 
-            QString ppCmd = m_pOptions->m_PreProcessorCmd;
-            FileAccess::createTempFile(fileOut1);
-            fileNameOut1 = fileOut1.fileName();
-
-            QProcess ppProcess;
-            ppProcess.setStandardInputFile(fileNameInPP);
-            ppProcess.setStandardOutputFile(fileNameOut1);
-            QString program;
-            QStringList args;
-            QString errorReason = Utils::getArguments(ppCmd, program, args);
-            if(errorReason.isEmpty())
-            {
-                ppProcess.start(program, args);
-                ppProcess.waitForFinished(-1);
-            }
-            else
-                errorReason = "\n(" + errorReason + ')';
+            QByteArray ppOutput;
+            QString errorReason;
+            runPreProcessor(ppCmd, m_pOptions->m_pEncodingPP, m_pOptions->m_bCachePreProcessorOutput, ppInput, ppOutput, errorReason);
 
-            bool bSuccess = errorReason.isEmpty() && m_normalData.readFile(fileNameOut1);
-            if(fileInSize > 0 && (!bSuccess || m_normalData.m_size == 0))
+            if(fileInSize > 0 && (!errorReason.isEmpty() || ppOutput.isEmpty()))
             {
-                //Don't fail the preprocessor command if the file cann't be read.
-                if(!m_normalData.readFile(faIn))
-                {
-                    errors.append(faIn.getStatusText());
-                    errors.append(i18n("    Temp file is: %1", fileNameIn1));
-                    return errors;
-                }
+                //Don't fail the preprocessor command, keep using the unprocessed data instead.
                 errors.append(
                     i18n("Preprocessing possibly failed. Check this command:\n\n  %1"
                          "\n\nThe preprocessing command will be disabled now.", ppCmd) +
                     errorReason);
-                m_pOptions->m_PreProcessorCmd = "";
+                m_bPreProcessorFailed = true;
+            }
+            else
+            {
+                ppInput.clear();
+                m_normalData.setData(ppOutput);
+                pEncoding1 = m_pOptions->m_pEncodingPP;
+            }
+        }
 
-                pEncoding1 = m_pEncoding;
+        // LineMatching Preprocessor, runs while the normal data is being decoded.
+        const QString lmppCmd = bFitsForPreProcessors ? m_pOptions->m_LineMatchingPreProcessorCmd : QString();
+        QByteArray lmppInput;
+        QByteArray lmppOutput;
+        QString lmppErrorReason;
+        QSemaphore lmppFinished;
+        pEncoding2 = pEncoding1;
+        if(!lmppCmd.isEmpty())
+        {
+            if(pEncoding2 != m_pOptions->m_pEncodingPP)
+            {
+                // Before running the preprocessor convert to the format that the preprocessor expects.
+                lmppInput = convertEncoding(QByteArray::fromRawData(m_normalData.m_pBuf, (int)m_normalData.m_size), pEncoding2, m_pOptions->m_pEncodingPP);
+                pEncoding2 = m_pOptions->m_pEncodingPP;
+            }
+            else
+            {
+                // preprocess() unmaps the normal data while the preprocessor may still be using its input.
+                lmppInput = m_normalData.toByteArray();
             }
+
+            startOrRunHere(new LineMatchingPreProcessorRunnable(lmppCmd, m_pOptions->m_pEncodingPP, m_pOptions->m_bCachePreProcessorOutput, lmppInput,
+                                                                lmppOutput, lmppErrorReason, lmppFinished));
         }
 
-        if(!m_normalData.preprocess(pEncoding1, false))
+        // With "Ignore C/C++ comments" the pure comment flags of the normal data are taken from the lmpp data below.
+        const bool bPreprocessed = m_normalData.preprocess(pEncoding1, false, !m_pOptions->m_bIgnoreComments);
+        if(!lmppCmd.isEmpty())
+            lmppFinished.acquire();
+
+        if(!bPreprocessed)
         {
             errors.append(i18n("File %1 too large to process. Skipping.", fileNameIn1));
             return errors;
@@ -450,58 +928,25 @@ QStringList SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetec
         if(!m_normalData.isText())
             return errors;
 
-        // LineMatching Preprocessor
-        if(!m_pOptions->m_LineMatchingPreProcessorCmd.isEmpty())
+        if(!lmppCmd.isEmpty())
         {
-            QTemporaryFile tempOut2, fileInPP;
-            fileNameIn2 = fileNameOut1.isEmpty() ? fileNameIn1 : fileNameOut1;
-            QString fileNameInPP = fileNameIn2;
-            pEncoding2 = pEncoding1;
-            if(pEncoding2 != m_pOptions->m_pEncodingPP)
-            {
-                // Before running the preprocessor convert to the format that the preprocessor expects.
-                FileAccess::createTempFile(fileInPP);
-                fileNameInPP = fileInPP.fileName();
-                pEncoding2 = m_pOptions->m_pEncodingPP;
-                convertFileEncoding(fileNameIn2, pEncoding1, fileNameInPP, pEncoding2);
-            }
-
-            QString ppCmd = m_pOptions->m_LineMatchingPreProcessorCmd;
-            FileAccess::createTempFile(tempOut2);
-            fileNameOut2 = tempOut2.fileName();
-            QProcess ppProcess;
-            ppProcess.setStandardInputFile(fileNameInPP);
-            ppProcess.setStandardOutputFile(fileNameOut2);
-            QString program;
-            QStringList args;
-            QString errorReason = Utils::getArguments(ppCmd, program, args);
-            if(errorReason.isEmpty())
+            if(lmppInput.size() > 0 && (!lmppErrorReason.isEmpty() || lmppOutput.isEmpty()))
             {
-                ppProcess.start(program, args);
-                ppProcess.waitForFinished(-1);
+                errors.append(
+                    i18n("The line-matching-preprocessing possibly failed. Check this command:\n\n  %1"
+                         "\n\nThe line-matching-preprocessing command will be disabled now.", lmppCmd) +
+                    lmppErrorReason);
+                m_bLineMatchingPreProcessorFailed = true;
+                m_lmppData.setData(lmppInput);
             }
             else
-                errorReason = "\n(" + errorReason + ')';
-
-            bool bSuccess = errorReason.isEmpty() && m_lmppData.readFile(fileNameOut2);
-            if(FileAccess(fileNameIn2).size() > 0 && (!bSuccess || m_lmppData.m_size == 0))
             {
-                errors.append(
-                    i18n("The line-matching-preprocessing possibly failed. Check this command:\n\n  %1"
-                         "\n\nThe line-matching-preprocessing command will be disabled now.", ppCmd) +
-                    errorReason);
-                m_pOptions->m_LineMatchingPreProcessorCmd = "";
-                if(!m_lmppData.readFile(fileNameIn2))
-                {
-                    errors.append(i18n("Failed to read file: %1", fileNameIn2));
-                    return errors;
-                }
+                m_lmppData.setData(lmppOutput);
             }
         }
         else if(m_pOptions->m_bIgnoreComments || m_pOptions->m_bIgnoreCase)
         {
-            // We need a copy of the normal data.
-            m_lmppData.copyBufFrom(m_normalData);
+            m_lmppData.copyWithoutComments(m_normalData);
         }
     }
     else
@@ -510,7 +955,7 @@ QStringList SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetec
         return errors;
     }
 
-    if(!m_lmppData.preprocess(pEncoding2, true))
+    if(!m_lmppData.preprocess(pEncoding2, true, true))
     {
         errors.append(i18n("File %1 too large to process. Skipping.", fileNameIn1));
         return errors;
@@ -518,19 +963,19 @@ QStringList SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetec
 
     Q_ASSERT(m_lmppData.isText());
     //TODO: Needed?
-    if(m_lmppData.m_vSize < m_normalData.m_vSize)
+    if(m_lmppData.hasData() && m_lmppData.m_vSize < m_normalData.m_vSize)
     {
         // Preprocessing command may result in smaller data buffer so adjust size
         for(qint64 i = m_lmppData.m_vSize; i < m_normalData.m_vSize; ++i)
         { // Set all empty lines to point to the end of the buffer.
-            m_lmppData.m_v.push_back(LineData(m_lmppData.m_unicodeBuf, m_lmppData.m_unicodeBuf->length()));
+            m_lmppData.m_v.push_back(LineData(m_lmppData.chunkFor(0).data(), m_lmppData.m_textChunks.last()->length()));
         }
 
         m_lmppData.m_vSize = m_normalData.m_vSize;
     }
 
-    // Ignore comments
-    if(m_pOptions->m_bIgnoreComments && hasData())
+    // Ignore comments, the normal data wasn't parsed for comments so take the flags from the lmpp data.
+    if(m_pOptions->m_bIgnoreComments && hasData() && !m_lmppData.m_v.isEmpty())
     {
         qint64 vSize = std::min(m_normalData.m_vSize, m_lmppData.m_vSize);
         Q_ASSERT(vSize < TYPE_MAX(qint32));
@@ -541,11 +986,52 @@ QStringList SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetec
         }
     }
 
+    span.setItemCount(m_normalData.m_vSize);
     return errors;
 }
 
-/** Prepare the linedata vector for every input line.*/
-bool SourceData::FileData::preprocess(QTextCodec* pEncoding, bool removeComments)
+/*
+    Returns the position of the first character at or after pos that preprocess() has to look at:
+    a line end, a null or a possible noncharacter/replacement character (all of those are >= 0xFDD0).
+    Ordinary characters are skipped four at a time by testing all 16 bit lanes of a 64 bit word at once.
+*/
+static qint64 findSpecialChar(const QChar* pText, qint64 pos, const qint64 end)
+{
+    constexpr quint64 lanes = 0x0001000100010001ULL;
+    constexpr quint64 highBits = 0x8000800080008000ULL;
+
+    for(; pos + 4 <= end; pos += 4)
+    {
+        quint64 word;
+        memcpy(&word, pText + pos, sizeof(word));
+        // (x - n) & ~x has the high bit set in some lane iff a lane is below n (n <= 0x8000).
+        const quint64 below = (word - lanes * 0x000E) & ~word & highBits;
+        const quint64 above = (~word - lanes * 0x0230) & word & highBits;
+        if((below | above) != 0)
+            break;
+    }
+
+    for(; pos < end; ++pos)
+    {
+        const ushort c = pText[pos].unicode();
+        if(c < 0x000E || c >= 0xFDD0)
+            return pos;
+    }
+    return end;
+}
+
+// In UTF-16 and UTF-32 null bytes are part of ordinary characters.
+static bool hasWideCodeUnits(QTextCodec* pEncoding)
+{
+    const int mib = pEncoding->mibEnum();
+    return (mib >= 1013 && mib <= 1015) || (mib >= 1017 && mib <= 1019);
+}
+
+/*
+    Prepare the linedata vector for every input line. Lines are only parsed for comments if
+    removeComments or bFindPureComments is set, otherwise none is marked as pure comment.
+*/
+bool SourceData::FileData::preprocess(QTextCodec* pEncoding, bool removeComments, bool bFindPureComments)
 {
     if(m_pBuf == nullptr)
         return true;
@@ -553,137 +1039,294 @@ bool SourceData::FileData::preprocess(QTextCodec* pEncoding, bool removeComments
     if(pEncoding == nullptr)
         return false;
 
-    QString line;
-    QChar   curChar;
+    TraceSpan span(removeComments ? "preprocessLineMatchingData" : "preprocessData", m_size);
     LineCount lineCount = 0;
-    qint64 lastOffset = 0;
     qint64 skipBytes = 0;
     QScopedPointer<CommentParser> parser(new DefaultCommentParser());
 
     // detect line end style
-    QVector<e_LineEndStyle> vOrigDataLineEndStyle;
     m_eLineEndStyle = eLineEndStyleUndefined;
+    m_bFinalLineEnd = true;
+    bool bLineEndStyleKnown = false;
 
     QTextCodec* pCodec = detectEncoding(m_pBuf, m_size, skipBytes);
     if(pCodec != pEncoding)
         skipBytes = 0;
 
-    if(m_size - skipBytes > TYPE_MAX(QtNumberType))
-        return false;
-
-    const QByteArray ba = QByteArray::fromRawData(m_pBuf + skipBytes, (int)(m_size - skipBytes));
-    QTextStream ts(ba, QIODevice::ReadOnly); //Don't use text mode we need to see the actual line ending.
-    ts.setCodec(pEncoding);
-    ts.setAutoDetectUnicode(false);
-
     m_bIncompleteConversion = false;
-    m_unicodeBuf->clear();
-    Q_ASSERT(m_unicodeBuf->length() == 0);
+    // A null byte makes it binary data, find it without decoding the whole file first.
+    if(!hasWideCodeUnits(pEncoding) && memchr(m_pBuf + skipBytes, 0, (size_t)(m_size - skipBytes)) != nullptr)
+        return true;
 
-    while(!ts.atEnd())
+    /*
+        Decode maxChunkLength bytes at a time into a chunk of its own, the start of a line at the end
+        of a piece is moved to the next chunk. A line that doesn't end in a piece is carried on, it
+        may be as long as a whole file could be before. The lines of a chunk are then compacted in
+        place: dropping '\r' and removed comments only ever shortens the text so the output never
+        overtakes the input.
+    */
+    QScopedPointer<QTextDecoder> pDecoder(pEncoding->makeDecoder());
+    QString carry;
+    qint64 bytePos = skipBytes;
+    bool bNeedFinalNewline = false;
+    while(bytePos < m_size)
     {
-        line.clear();
-        if(lineCount >= TYPE_MAX(LineCount) - 5)
-            return false;
+        const qint64 pieceSize = std::min(m_size - bytePos, maxChunkLength);
+        QString text = pDecoder->toUnicode(m_pBuf + bytePos, (int)pieceSize);
+        bytePos += pieceSize;
+        if(!carry.isEmpty())
+            text.prepend(carry);
+        carry.clear();
+
+        if(bytePos < m_size)
+        {
+            const int lastLineEnd = text.lastIndexOf('\n');
+            if(lastLineEnd < 0)
+            {
+                // The next piece would make a single line too long for a QString.
+                if(text.length() > TYPE_MAX(QtNumberType) - maxChunkLength)
+                    return false;
+                carry = text;
+                continue;
+            }
+            carry = text.mid(lastLineEnd + 1);
+            text.truncate(lastLineEnd + 1);
+        }
+        if(text.isEmpty() && !m_textChunks.isEmpty())
+            continue;
 
-        ts >> curChar;
+        // The lines are compacted in text, the chunk gets it when they are done.
+        m_textChunks.push_back(QSharedPointer<TextChunk>::create());
+        const QSharedPointer<TextChunk>& pChunk = m_textChunks.last();
 
-        quint32 firstNonwhite=0;
-        //QTextStream::readLine doesn't tell us abount line endings.
-        while(curChar != '\n' && curChar != '\r')
+        const qint64 textLength = text.length();
+        QChar* pText = text.data();
+        qint64 readPos = 0;
+        qint64 writePos = 0;
+
+        while(readPos < textLength)
         {
-            if(curChar.isNull() || curChar.isNonCharacter())
-                return true;
+            if(lineCount >= TYPE_MAX(LineCount) - 5)
+                return false;
+
+            const qint64 lineStart = readPos;
+            quint32 firstNonwhite = 0;
+            bool bFirstNonwhiteFound = false;
+            while(readPos < textLength)
+            {
+                // Once the first non white character is known only the special characters are of interest.
+                if(bFirstNonwhiteFound)
+                {
+                    readPos = findSpecialChar(pText, readPos, textLength);
+                    if(readPos == textLength)
+                        break;
+                }
 
-            if(curChar == QChar::ReplacementCharacter)
-                m_bIncompleteConversion = true;
+                const QChar curChar = pText[readPos];
+                if(curChar == '\n' || curChar == '\r')
+                    break;
 
-            if(!curChar.isSpace() && firstNonwhite == 0)
-                firstNonwhite = line.length();
+                if(curChar.isNull() || curChar.isNonCharacter())
+                {
+                    text.truncate(writePos);
+                    *pChunk = TextChunk(text);
+                    return true;
+                }
 
-            line.append(curChar);
+                if(curChar == QChar::ReplacementCharacter)
+                    m_bIncompleteConversion = true;
 
-            if(ts.atEnd())
-                break;
+                if(!bFirstNonwhiteFound && !curChar.isSpace())
+                {
+                    firstNonwhite = readPos - lineStart;
+                    bFirstNonwhiteFound = true;
+                }
 
-            ts >> curChar;
-        }
+                ++readPos;
+            }
 
-        ++lineCount;
+            ++lineCount;
 
-        switch(curChar.unicode())
-        {
-            case '\n':
-                vOrigDataLineEndStyle.push_back(eLineEndStyleUnix);
-                break;
-            case '\r':
-                if(lastOffset < m_size)
+            e_LineEndStyle lineEndStyle = eLineEndStyleUndefined;
+            if(readPos < textLength)
+            {
+                if(pText[readPos] == '\n')
                 {
-                    //workaround for lack of peak API in QTextStream.
-                    qint64  j;
-                    for(j = 0; j < 4 && lastOffset + j < m_size; ++j)
-                    {
-                        if(m_pBuf[lastOffset + j] != '\0')
-                            break;
-                    }
-
-                    if(m_pBuf[lastOffset + j] == '\n')
-                    {
-                        ts >> curChar;
-                        vOrigDataLineEndStyle.push_back(eLineEndStyleDos);
-                        lastOffset = ts.pos();
-                        break;
-                    }
+                    lineEndStyle = eLineEndStyleUnix;
+                }
+                else if(readPos + 1 < textLength && pText[readPos + 1] == '\n')
+                {
+                    lineEndStyle = eLineEndStyleDos;
+                    ++readPos;
                 }
+                //else old mac style ending.
 
-                //old mac style ending.
-                vOrigDataLineEndStyle.push_back(eLineEndStyleUndefined);
-                break;
-        }
-        parser->processLine(line);
-        if(removeComments)
-            parser->removeComment(line);
+                if(!bLineEndStyleKnown)
+                {
+                    m_eLineEndStyle = lineEndStyle;
+                    bLineEndStyleKnown = true;
+                }
+            }
+
+            // A raw view of the line, removeComment() detaches it only if it actually changes the line.
+            QString line = QString::fromRawData(pText + lineStart, (int)(readPos - lineStart));
+            bool bPureComment = false;
+            if(removeComments || bFindPureComments)
+            {
+                parser->processLine(line);
+                if(removeComments)
+                    parser->removeComment(line);
+                bPureComment = parser->isPureComment();
+            }
+
+            //kdiff3 internally uses only unix style endings for simplicity.
+            m_v.push_back(LineData(pChunk.data(), writePos, line.length(), firstNonwhite, bPureComment));
+            if(line.constData() != pText + writePos)
+                memmove(pText + writePos, line.constData(), line.length() * sizeof(QChar));
+            writePos += line.length();
+
+            // Only the last chunk may end without a line end.
+            if(writePos < textLength)
+                pText[writePos++] = '\n';
+            else
+                bNeedFinalNewline = true;
 
-        //kdiff3 internally uses only unix style endings for simplicity.
-        m_v.push_back(LineData(m_unicodeBuf, lastOffset, line.length(), firstNonwhite, parser->isPureComment()));
-        m_unicodeBuf->append(line).append('\n');
+            // Set for every line, the last one decides.
+            m_bFinalLineEnd = readPos < textLength;
+            if(readPos < textLength)
+                ++readPos;
+        }
 
-        lastOffset = m_unicodeBuf->length();
+        text.truncate(writePos);
+        *pChunk = TextChunk(text);
+        text.clear();
+        pChunk->compact();
     }
 
-    m_v.push_back(LineData(m_unicodeBuf, lastOffset));
+    const QSharedPointer<TextChunk>& pLastChunk = chunkFor(0);
+    if(bNeedFinalNewline)
+        pLastChunk->append(QStringLiteral("\n"));
+
+    m_v.push_back(LineData(pLastChunk.data(), pLastChunk->length()));
     Q_ASSERT(m_v.size() < 2 || m_v[m_v.size() - 1].getOffset() != m_v[m_v.size() - 2].getOffset());
 
     m_bIsText = true;
 
-    if(!vOrigDataLineEndStyle.isEmpty())
-        m_eLineEndStyle = vOrigDataLineEndStyle[0];
-
     m_vSize = lineCount;
+    // All further processing uses m_textChunks.
+    unmapFile();
     return true;
 }
 
-// Convert the input file from input encoding to output encoding and write it to the output file.
-bool SourceData::convertFileEncoding(const QString& fileNameIn, QTextCodec* pCodecIn,
-                                     const QString& fileNameOut, QTextCodec* pCodecOut)
+/*
+    Converts data from the input encoding to the output encoding a chunk of fixed size at a time, so
+    only the output grows with the data. The decoder state and the encoder keep what is left of a
+    character cut at the end of a chunk for the next one. A character the data ends within becomes
+    U+FFFD, as when all of it is decoded at once. No byte order mark is added, as by the QTextStream
+    this replaced.
+*/
+QByteArray SourceData::convertEncoding(const QByteArray& data, QTextCodec* pCodecIn, QTextCodec* pCodecOut)
 {
-    QFile in(fileNameIn);
-    if(!in.open(QIODevice::ReadOnly))
-        return false;
-    QTextStream inStream(&in);
-    inStream.setCodec(pCodecIn);
-    inStream.setAutoDetectUnicode(false);
+    static const int chunkSize = 64 * 1024;
+    TraceSpan span("convertEncoding", data.size());
+
+    QTextCodec::ConverterState decoderState;
+    QScopedPointer<QTextEncoder> pEncoder(pCodecOut->makeEncoder(QTextCodec::IgnoreHeader));
+    QByteArray output;
+    output.reserve(data.size());
+    for(int pos = 0; pos < data.size(); pos += chunkSize)
+    {
+        const QString text = pCodecIn->toUnicode(data.constData() + pos, std::min(chunkSize, data.size() - pos), &decoderState);
+        output += pEncoder->fromUnicode(text.constData(), text.length());
+    }
+    if(decoderState.remainingChars > 0)
+    {
+        const QChar replacement = QChar::ReplacementCharacter;
+        output += pEncoder->fromUnicode(&replacement, 1);
+    }
+    return output;
+}
 
-    QFile out(fileNameOut);
-    if(!out.open(QIODevice::WriteOnly))
-        return false;
-    QTextStream outStream(&out);
-    outStream.setCodec(pCodecOut);
+/*
+    Appends what GnuDiff::lines_differ() doesn't skip of a line: all but white space, and digits, '-' and
+    '.' if numbers are ignored. Normalized lines that are equal byte for byte are equal for GnuDiff.
+*/
+template <typename Char>
+static void appendNormalized(const Char* pLine, int size, bool bIgnoreNumbers, QString& text)
+{
+    const int start = text.length();
+    for(const Char* p = pLine, *pEnd = pLine + size; p != pEnd; ++p)
+    {
+        const QChar c = Utils::toQChar(*p);
+        if(!(isWhite(c) || (bIgnoreNumbers && (c.isDigit() || c == '-' || c == '.'))))
+            text += c;
+    }
+    // So a normalized line is empty only if its original is, DiffList::runDiff() checks for that.
+    // The kept character is one GnuDiff skips, it changes neither the hash nor the comparison.
+    if(text.length() == start && size > 0)
+        text += Utils::toQChar(pLine[0]);
+}
 
-    QString data = inStream.readAll();
-    outStream << data;
+/*
+    The hashes gnudiff would compute for every line. They only depend on the text and on whether numbers are
+    ignored, so they are kept until either changes. The normalized lines are made in the same pass, the
+    hashes are taken from them as they are shorter.
+*/
+const QVector<size_t>& SourceData::FileData::lineHashes(bool bIgnoreNumbers)
+{
+    if(m_lineHashes.size() != m_vSize || m_normalizedLines.size() != m_v.size() || m_bHashesIgnoreNumbers != bIgnoreNumbers)
+    {
+        TraceSpan span("normalizeLines", m_vSize);
+        m_normalizedChunks.clear();
+        m_normalizedLines.clear();
+        m_normalizedLines.reserve(m_v.size());
+
+        // Built like the chunks in preprocess(), the chunk gets the text when it is full.
+        QString text;
+        for(qint64 i = 0; i < m_v.size(); ++i)
+        {
+            const LineData& ld = m_v.at(i); // Doesn't detach m_v, see sharesDataWith()
+            if(m_normalizedChunks.isEmpty() || text.length() + ld.size() + 1 > maxChunkLength)
+            {
+                if(!m_normalizedChunks.isEmpty())
+                {
+                    *m_normalizedChunks.last() = TextChunk(text);
+                    m_normalizedChunks.last()->compact();
+                }
+                m_normalizedChunks.push_back(QSharedPointer<TextChunk>::create());
+                text = QString();
+            }
 
-    return true;
+            const int offset = text.length();
+            if(ld.isLatin1())
+                appendNormalized(ld.latin1(), ld.size(), bIgnoreNumbers, text);
+            else
+                appendNormalized(ld.utf16(), ld.size(), bIgnoreNumbers, text);
+            m_normalizedLines.push_back(LineData(m_normalizedChunks.last().data(), offset, text.length() - offset, 0, ld.isPureComment()));
+
+            // The last entry only marks the end of the text.
+            if(i + 1 < m_v.size())
+                text += '\n';
+        }
+        *m_normalizedChunks.last() = TextChunk(text);
+        m_normalizedChunks.last()->compact();
+
+        m_lineHashes.resize(m_vSize);
+        for(qint64 i = 0; i < m_vSize; ++i)
+            m_lineHashes[i] = m_normalizedLines[i].hash(bIgnoreNumbers);
+        m_bHashesIgnoreNumbers = bIgnoreNumbers;
+    }
+    return m_lineHashes;
+}
+
+/*
+    The lines of m_v, each followed by '\n', with what GnuDiff ignores left out. The line diff compares
+    them by memcmp where it had to skip white space and numbers while comparing before.
+*/
+const QVector<LineData>& SourceData::FileData::normalizedLines(bool bIgnoreNumbers)
+{
+    lineHashes(bIgnoreNumbers);
+    return m_normalizedLines;
 }
 
 QTextCodec* SourceData::getEncodingFromTag(const QByteArray& s, const QByteArray& encodingTag)
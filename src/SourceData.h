@@ -9,15 +9,22 @@
 #ifndef SOURCEDATA_H
 #define SOURCEDATA_H
 
+#include "BinaryDiff.h"
 #include "options.h"
 #include "fileaccess.h"
 #include "LineRef.h"
+#include "TextChunk.h"
 
+#include <QDateTime>
+#include <QFile>
+#include <QSharedPointer>
 #include <QTextCodec>
 #include <QTemporaryFile>
 #include <QString>
 #include <QVector>
 
+#include <vector>
+
 class LineData;
 class SourceData: public QObject
 {
@@ -28,10 +35,15 @@ class SourceData: public QObject
 
     LineRef getSizeLines() const;
     qint64 getSizeBytes() const;
-    const char* getBuf() const;
-    const QString& getText() const;
     const QVector<LineData>* getLineDataForDisplay() const;
     const QVector<LineData>* getLineDataForDiff() const;
+    // Hashes of the lines in getLineDataForDiff(), computed on first use and again when bIgnoreNumbers changes.
+    const QVector<size_t>* getLineHashesForDiff(bool bIgnoreNumbers);
+    /*
+        The lines of getLineDataForDiff() without what the line diff ignores, see FileData::normalizedLines().
+        Computed together with the hashes, the line diff compares these instead.
+    */
+    const QVector<LineData>* getNormalizedLineDataForDiff(bool bIgnoreNumbers);
 
     void setFilename(const QString& filename);
     void setFileAccess(const FileAccess& fileAccess);
@@ -43,66 +55,127 @@ class SourceData: public QObject
     bool isText() const;                 // is it pure text (vs. binary data)
     bool isIncompleteConversion() const; // true if some replacement characters were found
     bool isFromBuffer() const;           // was it set via setData() (vs. setFileAccess() or setFilename())
+    bool isStreamInput() const { return !m_streamName.isEmpty(); } // set by setFilename(), see StreamInput
     const QString setData(const QString& data);
     bool isValid() const; // Either no file is specified or reading was successful
 
-    // Returns a list of error messages if anything went wrong
+    // Copies remote input to a local temp file. Uses KIO, so call this on the GUI thread before readAndPreprocess().
+    void createLocalCopy();
+    bool isRemote() const { return m_fileAccess.isValid() && !m_fileAccess.isLocal(); }
+    const FileAccess& getFileAccess() const { return m_fileAccess; }
+    // Remote data read by RemoteFetch, the next readAndPreprocess() takes it instead of a local copy.
+    void setFetchedData(const QByteArray& data, const QString& errorReason);
+    // Returns a list of error messages if anything went wrong. Safe to run for several SourceData objects in parallel.
     QStringList readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicode);
+    // readAndPreprocess() only records failing preprocessors, this turns them off in the shared options.
+    void disableFailedPreProcessors();
     bool saveNormalDataAs(const QString& fileName);
 
-    bool isBinaryEqualWith(const QSharedPointer<SourceData>& other) const;
+    bool isBinaryEqualWith(const QSharedPointer<SourceData>& other);
+    // Compares the files before either is read, see shareDataOf().
+    bool hasEqualFileAs(const QSharedPointer<SourceData>& other) const;
+    // Instead of readAndPreprocess() when other was read from an equal file with the same settings.
+    void shareDataOf(const QSharedPointer<SourceData>& other);
+    // The line diff of inputs that share their data has nothing to find.
+    bool sharesDataWith(const QSharedPointer<SourceData>& other) const;
+    QVector<BinaryDiff::Range> binaryDiffWith(const QSharedPointer<SourceData>& other);
 
     void reset();
 
     bool isDir() { return m_fileAccess.isDir(); }
 
+    // The bytes the buffers and line data hold, see MemoryUsage.
+    qint64 memoryUsage() const;
+
     QTextCodec* getEncoding() const { return m_pEncoding; }
     e_LineEndStyle getLineEndStyle() const { return m_normalData.m_eLineEndStyle; }
+    // False if the last line of the file has no line end, the line data doesn't tell that.
+    bool hasFinalLineEnd() const { return m_normalData.m_bFinalLineEnd; }
 public Q_SLOTS:
     void setEncoding(QTextCodec* pEncoding);
 
 
   private:
-    bool convertFileEncoding(const QString& fileNameIn, QTextCodec* pCodecIn,
-                                const QString& fileNameOut, QTextCodec* pCodecOut);
-    
+    bool inputExists() const;
+
+    static QByteArray convertEncoding(const QByteArray& data, QTextCodec* pCodecIn, QTextCodec* pCodecOut);
+
     static QTextCodec* detectEncoding(const char* buf, qint64 size, qint64& skipBytes);
     static QTextCodec* getEncodingFromTag(const QByteArray& s, const QByteArray& encodingTag);
 
-    QTextCodec* detectEncoding(const QString& fileName, QTextCodec* pFallbackCodec);
     QString m_aliasName;
     FileAccess m_fileAccess;
     QSharedPointer<Options> m_pOptions;
     QString m_tempInputFileName;
     QTemporaryFile m_tempFile; //Created from clipboard content.
+    QString m_streamName;
+    QByteArray m_streamData; // Read on first use and kept for reloading
+    QByteArray m_fetchedData;
+    QString m_fetchError;
+    bool m_bFetched = false;
+    bool m_bPreProcessorFailed = false;
+    bool m_bLineMatchingPreProcessorFailed = false;
 
     class FileData
     {
       private:
         friend SourceData;
         const char* m_pBuf = nullptr; //TODO: Phase out needlessly wastes memmory and time by keeping second copy of file data.
+        /*
+            Set when m_pBuf is a read-only mapping of a local file instead of a heap copy.
+            The mapping is dropped once decoding is done, rawData() reads the file again on demand.
+        */
+        QSharedPointer<QFile> m_pMappedFile;
+        QDateTime m_mappedFileTime; // Modification time of m_pMappedFile when it was decoded
+        std::vector<char> m_rereadData; // The bytes rawData() read again from m_pMappedFile
+        QByteArray m_byteBuf; // Owns m_pBuf when the data came from a preprocessor instead of a file.
         qint64 m_size = 0;
         qint64 m_vSize = 0; // Nr of lines in m_pBuf1 and size of m_v1, m_dv12 and m_dv13
-        QSharedPointer<QString> m_unicodeBuf=QSharedPointer<QString>::create();
+        /*
+            The decoded text. One QString holds less than 2^31 characters, so the text of large files is
+            split into chunks that each end after a line. No line spans two chunks. Finished chunks are
+            compacted, see TextChunk.
+        */
+        QVector<QSharedPointer<TextChunk>> m_textChunks;
         QVector<LineData> m_v;
+        QVector<size_t> m_lineHashes; // Parallel to m_v, see lineHashes()
+        bool m_bHashesIgnoreNumbers = false;
+        QVector<QSharedPointer<TextChunk>> m_normalizedChunks;
+        QVector<LineData> m_normalizedLines; // Same size as m_v, see normalizedLines()
         bool m_bIsText = false;
         bool m_bIncompleteConversion = false;
         e_LineEndStyle m_eLineEndStyle = eLineEndStyleUndefined;
+        bool m_bFinalLineEnd = true;
 
       public:
         ~FileData();
 
         bool readFile(FileAccess& file);
-        bool readFile(const QString& filename);
         bool writeFile(const QString& filename);
 
-        bool preprocess(QTextCodec* pEncoding, bool removeComments);
-        void reset();
-        void copyBufFrom(const FileData& src);
+        void setData(const QByteArray& data);
+        QByteArray toByteArray();
+
+        bool mapFile(const QString& filename);
+        void unmapFile();
+        const char* rawData();
 
+        bool preprocess(QTextCodec* pEncoding, bool removeComments, bool bFindPureComments);
+        void reset();
+        void copyWithoutComments(const FileData& src);
+        void shareDecodedData(const FileData& other);
+        // The chunk to append length characters to, a new one if the last chunk is full.
+        const QSharedPointer<TextChunk>& chunkFor(qint64 length);
+        const QVector<size_t>& lineHashes(bool bIgnoreNumbers);
+        const QVector<LineData>& normalizedLines(bool bIgnoreNumbers);
+
+        bool hasData() const { return m_pBuf != nullptr || m_pMappedFile != nullptr; }
         bool isEmpty() const { return m_size == 0; }
 
         bool isText() const { return m_bIsText || isEmpty(); }
+
+        // Without the text and line data shared with pShared.
+        qint64 memoryUsage(const FileData* pShared = nullptr) const;
     };
     FileData m_normalData;
     FileData m_lmppData;
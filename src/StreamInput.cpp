@@ -0,0 +1,120 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "StreamInput.h"
+
+#include "Tracing.h"
+#include "TypeUtils.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QProcess>
+#include <QStringList>
+
+#include <KLocalizedString>
+
+#include <limits>
+#include <stdio.h>
+
+static const QLatin1String gitPrefix("git:");
+
+bool StreamInput::isStreamInput(const QString& name)
+{
+    if(name == QLatin1String("-"))
+        return true;
+    // "git://" is a URL for KIO.
+    if(name.startsWith(gitPrefix) && !name.startsWith(QLatin1String("git://")))
+        return true;
+
+    // Neither a file nor a directory is a pipe or a device, those can't be mapped or read twice.
+    const QFileInfo fileInfo(name);
+    return fileInfo.exists() && !fileInfo.isFile() && !fileInfo.isDir();
+}
+
+bool StreamInput::read(const QString& name, QByteArray& data, QString& errorReason)
+{
+    TraceSpan span("readStreamInput");
+    if(name.startsWith(gitPrefix))
+        return readGitBlob(name.mid(gitPrefix.size()), data, errorReason);
+
+    QFile file;
+    bool bOpened;
+    if(name == QLatin1String("-"))
+    {
+        bOpened = file.open(stdin, QIODevice::ReadOnly);
+    }
+    else
+    {
+        file.setFileName(name);
+        bOpened = file.open(QIODevice::ReadOnly);
+    }
+    if(!bOpened)
+    {
+        errorReason = i18n("Reading %1 failed: %2", name, file.errorString());
+        return false;
+    }
+
+    data = file.readAll();
+    span.setItemCount(data.size());
+    return true;
+}
+
+/*
+    "git cat-file --batch" answers each object name with "<sha1> <type> <size>\n<content>\n",
+    or with "<object> missing\n" if there is none.
+*/
+bool StreamInput::readGitBlob(const QString& object, QByteArray& data, QString& errorReason)
+{
+    QProcess git;
+    git.start(QStringLiteral("git"), QStringList() << QStringLiteral("cat-file") << QStringLiteral("--batch"));
+    if(!git.waitForStarted(-1))
+    {
+        errorReason = i18n("Running git failed: %1", git.errorString());
+        return false;
+    }
+
+    // waitForFinished() keeps reading stdout so a large blob can't deadlock on a full pipe.
+    git.write(object.toUtf8() + '\n');
+    git.closeWriteChannel();
+    git.waitForFinished(-1);
+    QByteArray output = git.readAllStandardOutput();
+
+    const int headerEnd = output.indexOf('\n');
+    const QList<QByteArray> header = output.left(headerEnd < 0 ? 0 : headerEnd).split(' ');
+    if(git.exitStatus() != QProcess::NormalExit || git.exitCode() != 0 || header.size() != 3)
+    {
+        const QString gitError = QString::fromLocal8Bit(git.readAllStandardError()).trimmed();
+        errorReason = gitError.isEmpty() ? i18n("%1 was not found in the git repository.", object) : gitError;
+        return false;
+    }
+    if(header[1] != "blob")
+    {
+        errorReason = i18n("%1 is a git %2, not a file.", object, QString::fromLatin1(header[1]));
+        return false;
+    }
+
+    bool bValidSize = false;
+    const qint64 size = header[2].toLongLong(&bValidSize);
+    // A QByteArray holds less than 2 GiB.
+    if(bValidSize && size > TYPE_MAX(int))
+    {
+        errorReason = i18n("%1 is too large to be read from git.", object);
+        return false;
+    }
+    if(!bValidSize || size < 0 || headerEnd + 1 + size > output.size())
+    {
+        errorReason = i18n("Reading %1 from git failed.", object);
+        return false;
+    }
+
+    // In place, the blob may be large.
+    output.remove(0, headerEnd + 1);
+    output.truncate((int)size);
+    data = output;
+    return true;
+}
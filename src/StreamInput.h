@@ -0,0 +1,31 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef STREAMINPUT_H
+#define STREAMINPUT_H
+
+#include <QByteArray>
+#include <QString>
+
+/*
+    Inputs that are read into memory at once instead of being opened as a file:
+      "-"                 standard input
+      a named pipe        e.g. from the process substitution of a shell, <(git show HEAD:file)
+      "git:<rev>:<path>"  a blob of the git repository in the current directory, read by "git cat-file --batch"
+    SourceData reads them once and keeps the bytes, so neither a temporary file is written nor mapped.
+*/
+class StreamInput
+{
+  public:
+    static bool isStreamInput(const QString& name);
+    // Standard input and pipes can be read only once, the caller keeps the data.
+    static bool read(const QString& name, QByteArray& data, QString& errorReason);
+
+  private:
+    static bool readGitBlob(const QString& object, QByteArray& data, QString& errorReason);
+};
+
+#endif // !STREAMINPUT_H
@@ -0,0 +1,111 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "TaskGroup.h"
+
+#include <QMutexLocker>
+#include <QThreadPool>
+
+TaskGroup::Task::Task(TaskGroup& group)
+    : m_group(group)
+{
+    setAutoDelete(true);
+}
+
+void TaskGroup::Task::run()
+{
+    if(!isCancelled())
+        execute();
+
+    bool bLast = false;
+    if(m_group.taskFinished(m_generation, bLast))
+        finished(bLast);
+
+    // The owner of the group may go away once this returned.
+    m_group.taskEnded();
+}
+
+void TaskGroup::add(Task* pTask, e_Priority priority)
+{
+    pTask->m_generation = generation();
+    m_pendingTasks.push_back(PendingTask{pTask, priority});
+}
+
+int TaskGroup::startPending()
+{
+    const int nofTasks = m_pendingTasks.count();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_nofRunningTasks += nofTasks;
+        m_nofStartedTasks += nofTasks;
+        m_nofUnfinishedTasks += nofTasks;
+    }
+
+    for(const PendingTask& pending: m_pendingTasks)
+    {
+        QThreadPool::globalInstance()->start(pending.pTask, (int)pending.priority);
+    }
+    m_pendingTasks.clear();
+    return nofTasks;
+}
+
+void TaskGroup::cancel()
+{
+    for(const PendingTask& pending: m_pendingTasks)
+    {
+        delete pending.pTask;
+    }
+    m_pendingTasks.clear();
+
+    QMutexLocker locker(&m_mutex);
+    m_generation.fetchAndAddOrdered(1);
+    m_nofStartedTasks = 0;
+    m_nofUnfinishedTasks = 0;
+}
+
+void TaskGroup::wait()
+{
+    QMutexLocker locker(&m_mutex);
+    while(m_nofRunningTasks > 0)
+        m_allEnded.wait(&m_mutex);
+}
+
+int TaskGroup::nofFinishedTasks()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_nofStartedTasks - m_nofUnfinishedTasks;
+}
+
+// Returns false if the generation was cancelled meanwhile.
+bool TaskGroup::taskFinished(int generation, bool& bLast)
+{
+    QMutexLocker locker(&m_mutex);
+    if(!isCurrent(generation))
+        return false;
+
+    --m_nofUnfinishedTasks;
+    bLast = m_nofUnfinishedTasks == 0;
+    return true;
+}
+
+void TaskGroup::taskEnded()
+{
+    QMutexLocker locker(&m_mutex);
+    --m_nofRunningTasks;
+    if(m_nofRunningTasks == 0)
+        m_allEnded.wakeAll();
+}
+
+void startOrRunHere(QRunnable* pRunnable, bool bRunHere)
+{
+    Q_ASSERT(pRunnable->autoDelete());
+    if(bRunHere || !QThreadPool::globalInstance()->tryStart(pRunnable))
+    {
+        pRunnable->run();
+        delete pRunnable;
+    }
+}
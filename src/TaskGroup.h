@@ -0,0 +1,100 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef TASKGROUP_H
+#define TASKGROUP_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QRunnable>
+#include <QWaitCondition>
+
+/*
+    Tasks of one kind run on the global thread pool. Cancelling the group starts a new generation:
+    the tasks made before see isCancelled() and stop early, their results are dropped and no finish
+    is reported for them. So new work can be started right away instead of waiting for stale work.
+*/
+class TaskGroup
+{
+  public:
+    // Queued tasks of a higher priority are started first.
+    enum class e_Priority
+    {
+        Background = 0, // Nothing waits for the result yet.
+        Visible = 1     // Needed for what is shown.
+    };
+
+    class Task : public QRunnable
+    {
+        friend class TaskGroup;
+
+      public:
+        explicit Task(TaskGroup& group);
+
+        int generation() const { return m_generation; }
+        bool isCancelled() const { return !m_group.isCurrent(m_generation); }
+
+      protected:
+        TaskGroup& group() const { return m_group; }
+
+        virtual void execute() = 0;
+        // Called after execute() unless the task was cancelled, bLast for the last task of its generation.
+        virtual void finished(bool bLast) { Q_UNUSED(bLast); }
+
+      private:
+        void run() final;
+
+        TaskGroup& m_group;
+        int m_generation = 0;
+    };
+
+    // The task is started by startPending(), the group deletes it after it ran.
+    void add(Task* pTask, e_Priority priority = e_Priority::Background);
+    int nofPendingTasks() const { return m_pendingTasks.count(); }
+    // Returns the number of tasks started.
+    int startPending();
+
+    // Starts a new generation, pending tasks are deleted.
+    void cancel();
+    // Blocks until the tasks of all generations ended.
+    void wait();
+
+    int generation() const { return m_generation.loadAcquire(); }
+    bool isCurrent(int generation) const { return generation == m_generation.loadAcquire(); }
+    // Tasks of the current generation that were started and ended.
+    int nofFinishedTasks();
+
+  private:
+    bool taskFinished(int generation, bool& bLast);
+    void taskEnded();
+
+    struct PendingTask
+    {
+        Task* pTask;
+        e_Priority priority;
+    };
+
+    QAtomicInt m_generation = 0;
+    QList<PendingTask> m_pendingTasks;
+
+    QMutex m_mutex;
+    QWaitCondition m_allEnded;
+    int m_nofRunningTasks = 0; // All generations, queued or running.
+    int m_nofStartedTasks = 0; // Current generation
+    int m_nofUnfinishedTasks = 0; // Current generation
+};
+
+/*
+    Starts work that the caller waits for on the global thread pool. The caller may run on a pool
+    thread itself, so without a free thread pRunnable runs right here instead of being queued:
+    waiting for queued work could then block the pool. With bRunHere it runs here in any case, e.g.
+    the last of several parts instead of just waiting. pRunnable is deleted after it ran, so it must
+    keep autoDelete() set.
+*/
+void startOrRunHere(QRunnable* pRunnable, bool bRunHere = false);
+
+#endif // !TASKGROUP_H
@@ -0,0 +1,105 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef TEXTCHUNK_H
+#define TEXTCHUNK_H
+
+#include "MemoryUsage.h"
+
+#include <QByteArray>
+#include <QChar>
+#include <QEnableSharedFromThis>
+#include <QString>
+
+/*
+    A part of the decoded text of a file, the lines of LineData point into it by offset. The text is
+    built as UTF-16, compact() then keeps it with one byte per character if it is all Latin-1, which
+    most source code is. The offsets count characters either way. Chunks are always made by
+    QSharedPointer, LineDataSnapshot takes over ownership through sharedFromThis().
+
+    UTF-16 text is read in place, Latin-1 text only by the kernels that have an 8-bit version.
+    Everything else gets a converted copy from mid(), as the display does.
+*/
+class TextChunk : public QEnableSharedFromThis<TextChunk>
+{
+  public:
+    TextChunk() = default;
+    explicit TextChunk(const QString& text): m_text(text) {}
+
+    inline bool isLatin1() const { return m_bLatin1; }
+    inline qint64 length() const { return m_bLatin1 ? m_latin1.size() : m_text.size(); }
+
+    // The characters from offset on, for UTF-16 and Latin-1 chunks respectively.
+    inline const QChar* utf16(qint64 offset) const
+    {
+        Q_ASSERT(!m_bLatin1);
+        return m_text.constData() + offset;
+    }
+    inline const char* latin1(qint64 offset) const
+    {
+        Q_ASSERT(m_bLatin1);
+        return m_latin1.constData() + offset;
+    }
+
+    // A view of the text for UTF-16, a copy for Latin-1. The view is only valid while this chunk doesn't grow.
+    inline QString mid(qint64 offset, int length) const
+    {
+        if(m_bLatin1)
+            return QString::fromLatin1(m_latin1.constData() + offset, length);
+        return QString::fromRawData(m_text.constData() + offset, length);
+    }
+    // Copies, other than mid().
+    inline QString left(qint64 length) const { return m_bLatin1 ? QString::fromLatin1(m_latin1.constData(), (int)length) : m_text.left((int)length); }
+    inline QString toString() const { return m_bLatin1 ? QString::fromLatin1(m_latin1) : m_text; }
+
+    // Text that isn't all Latin-1 makes a compacted chunk UTF-16 again.
+    void append(const QString& s)
+    {
+        if(m_bLatin1)
+        {
+            if(isLatin1(s))
+            {
+                m_latin1 += s.toLatin1();
+                return;
+            }
+            m_text = QString::fromLatin1(m_latin1);
+            m_latin1 = QByteArray();
+            m_bLatin1 = false;
+        }
+        m_text += s;
+    }
+
+    // Returns true if the chunk is kept as Latin-1 now.
+    bool compact()
+    {
+        if(!m_bLatin1 && isLatin1(m_text))
+        {
+            m_latin1 = m_text.toLatin1();
+            m_text = QString();
+            m_bLatin1 = true;
+        }
+        return m_bLatin1;
+    }
+
+    qint64 memoryUsage() const { return m_bLatin1 ? (qint64)m_latin1.capacity() : MemoryUsage::ofString(m_text); }
+
+  private:
+    static bool isLatin1(const QString& s)
+    {
+        for(const QChar c: s)
+        {
+            if(c.unicode() > 0xff)
+                return false;
+        }
+        return true;
+    }
+
+    QString m_text;
+    QByteArray m_latin1;
+    bool m_bLatin1 = false;
+};
+
+#endif // !TEXTCHUNK_H
@@ -0,0 +1,35 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "TextLayoutCache.h"
+
+TextLayoutCache::TextLayoutCache(int maxNofLayouts):
+    m_layouts(maxNofLayouts)
+{
+}
+
+void TextLayoutCache::setSettings(const Settings& settings)
+{
+    if(settings == m_settings)
+        return;
+
+    m_layouts.clear();
+    m_settings = settings;
+}
+
+QTextLayout* TextLayoutCache::find(int line, int offset, const QString& text) const
+{
+    QTextLayout* pTextLayout = m_layouts.object(key(line, offset));
+    return pTextLayout != nullptr && pTextLayout->text() == text ? pTextLayout : nullptr;
+}
+
+QTextLayout* TextLayoutCache::insert(int line, int offset, QTextLayout* pTextLayout)
+{
+    const quint64 k = key(line, offset);
+    m_layouts.insert(k, pTextLayout);
+    return m_layouts.object(k);
+}
@@ -0,0 +1,58 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef TEXTLAYOUTCACHE_H
+#define TEXTLAYOUTCACHE_H
+
+#include <QCache>
+#include <QFont>
+#include <QString>
+#include <QTextLayout>
+
+/*
+    Text layouts of the most recently painted lines, so scrolling only lays out the lines that
+    became visible. A layout is found by the line and the offset of the wrapped part in it and
+    only used while the text is the same, so edited lines are laid out again.
+    The settings the layouts were made with are remembered, changing any of them drops all
+    layouts. The position of a layout is not part of it, set it before drawing.
+*/
+class TextLayoutCache
+{
+  public:
+    struct Settings
+    {
+        QFont font;
+        int tabSize;
+        bool bShowWhiteSpaceCharacters;
+        bool bRightToLeftLanguage;
+
+        bool operator==(const Settings& other) const
+        {
+            return font == other.font && tabSize == other.tabSize &&
+                   bShowWhiteSpaceCharacters == other.bShowWhiteSpaceCharacters && bRightToLeftLanguage == other.bRightToLeftLanguage;
+        }
+        bool operator!=(const Settings& other) const { return !(*this == other); }
+    };
+
+    explicit TextLayoutCache(int maxNofLayouts = 1000);
+
+    // Clears the cache if the settings differ from the previous ones.
+    void setSettings(const Settings& settings);
+    void clear() { m_layouts.clear(); }
+    void setMaxNofLayouts(int maxNofLayouts) { m_layouts.setMaxCost(maxNofLayouts); }
+
+    // The returned layouts belong to the cache and are only valid until the next insert().
+    QTextLayout* find(int line, int offset, const QString& text) const;
+    QTextLayout* insert(int line, int offset, QTextLayout* pTextLayout);
+
+  private:
+    static quint64 key(int line, int offset) { return ((quint64)(quint32)line << 32) | (quint32)offset; }
+
+    QCache<quint64, QTextLayout> m_layouts;
+    Settings m_settings{QFont(), 0, false, false};
+};
+
+#endif // !TEXTLAYOUTCACHE_H
@@ -0,0 +1,103 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "TextWidthCache.h"
+
+#include <QFontInfo>
+#include <QFontMetricsF>
+#include <QTextLayout>
+#include <QTextOption>
+#include <QtMath>
+
+bool TextWidthCache::setSettings(const Settings& settings)
+{
+    if(settings == m_settings)
+        return false;
+
+    m_settings = settings;
+    m_widths.clear();
+
+    // With kerning the advance of a character depends on its neighbours.
+    m_bUseAdvances = QFontInfo(settings.font).fixedPitch() || !settings.font.kerning();
+    const QFontMetricsF metrics(settings.font);
+    for(int c = 0; c < nofAdvances; ++c)
+    {
+#if QT_VERSION < QT_VERSION_CHECK(5, 11, 0)
+        m_advances[c] = metrics.width(QChar(c));
+#else
+        m_advances[c] = metrics.horizontalAdvance(QChar(c));
+#endif
+    }
+    return true;
+}
+
+static inline ushort unicodeOf(const QChar c) { return c.unicode(); }
+static inline ushort unicodeOf(const char c) { return (uchar)c; }
+
+template <class Char>
+bool TextWidthCache::sumAdvances(const Char* pText, int length, int& width) const
+{
+    if(!m_bUseAdvances)
+        return false;
+
+    qreal x = 0;
+    for(const Char* p = pText; p != pText + length; ++p)
+    {
+        const ushort u = unicodeOf(*p);
+        if(u == '\t' && m_settings.tabStopDistance > 0)
+            x = (qFloor(x / m_settings.tabStopDistance) + 1) * m_settings.tabStopDistance;
+        else if(u >= ' ' && u < nofAdvances - 1) // Not DEL
+            x += m_advances[u];
+        else
+            return false;
+    }
+
+    width = qCeil(x);
+    return true;
+}
+
+bool TextWidthCache::advanceWidth(const QChar* pText, int length, int& width) const
+{
+    return sumAdvances(pText, length, width);
+}
+
+bool TextWidthCache::advanceWidth(const char* pLatin1, int length, int& width) const
+{
+    return sumAdvances(pLatin1, length, width);
+}
+
+int TextWidthCache::width(const QString& s, QPaintDevice* pDevice)
+{
+    int width = 0;
+    if(advanceWidth(s, width))
+        return width;
+
+    QHash<QString, int>::const_iterator it = m_widths.constFind(s);
+    if(it != m_widths.constEnd())
+        return *it;
+
+    QTextLayout textLayout(s, m_settings.font, pDevice);
+    if(m_settings.tabStopDistance > 0)
+    {
+        QTextOption textOption;
+#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
+        textOption.setTabStop(m_settings.tabStopDistance);
+#else
+        textOption.setTabStopDistance(m_settings.tabStopDistance);
+#endif
+        textLayout.setTextOption(textOption);
+    }
+    textLayout.beginLayout();
+    textLayout.createLine();
+    textLayout.endLayout();
+
+    width = qCeil(textLayout.maximumWidth());
+    if(m_widths.size() >= maxNofWidths)
+        m_widths.clear();
+    m_widths.insert(s, width);
+    return width;
+}
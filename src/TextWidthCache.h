@@ -0,0 +1,59 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef TEXTWIDTHCACHE_H
+#define TEXTWIDTHCACHE_H
+
+#include <QFont>
+#include <QHash>
+#include <QString>
+
+class QPaintDevice;
+
+/*
+    Widths of unwrapped lines as QTextLayout::maximumWidth() gives them, rounded up.
+    Lines of printable ASCII characters and tabs are summed up from a table of advances if the font
+    has a fixed pitch or no kerning, only other lines need a text layout. The widths of laid out
+    lines are kept, so each distinct line is laid out once. Changing the settings drops them.
+*/
+class TextWidthCache
+{
+  public:
+    struct Settings
+    {
+        QFont font;
+        qreal tabStopDistance;
+
+        bool operator==(const Settings& other) const { return font == other.font && tabStopDistance == other.tabStopDistance; }
+        bool operator!=(const Settings& other) const { return !(*this == other); }
+    };
+
+    // Returns true if the settings differ from the previous ones.
+    bool setSettings(const Settings& settings);
+
+    // Returns false if the line needs a text layout. Safe to call from several threads.
+    bool advanceWidth(const QString& s, int& width) const { return advanceWidth(s.constData(), s.length(), width); }
+    bool advanceWidth(const QChar* pText, int length, int& width) const;
+    // For the Latin-1 text of a TextChunk, which needs no QString then.
+    bool advanceWidth(const char* pLatin1, int length, int& width) const;
+    // Lays out the line with the font on pDevice if needed.
+    int width(const QString& s, QPaintDevice* pDevice);
+
+  private:
+    template <class Char>
+    bool sumAdvances(const Char* pText, int length, int& width) const;
+
+    static const int nofAdvances = 128;
+    // Beyond that the widths of lines laid out are forgotten, edited lines leave stale ones behind.
+    static const int maxNofWidths = 100000;
+
+    Settings m_settings{QFont(), -1};
+    bool m_bUseAdvances = false;
+    qreal m_advances[nofAdvances] = {};
+    QHash<QString, int> m_widths;
+};
+
+#endif // !TEXTWIDTHCACHE_H
@@ -0,0 +1,164 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "Tracing.h"
+
+#include "Logging.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+
+namespace {
+
+struct TraceEvent
+{
+    const char* name;
+    qint64 start;
+    qint64 duration;
+    qint64 nofItems;
+    int threadIdx;
+};
+
+// The state of the Chrome trace, only made if KDIFF3_TRACE is set.
+class TraceRecorder
+{
+  public:
+    static TraceRecorder* instance()
+    {
+        static TraceRecorder* s_pRecorder = create();
+        return s_pRecorder;
+    }
+
+    static qint64 now() { return clock().nsecsElapsed() / 1000; }
+
+    void add(const char* name, qint64 start, qint64 duration, qint64 nofItems)
+    {
+        QMutexLocker locker(&m_mutex);
+        // Small numbers instead of the thread handles keep the trace readable.
+        const Qt::HANDLE threadId = QThread::currentThreadId();
+        QHash<Qt::HANDLE, int>::const_iterator it = m_threadIndices.constFind(threadId);
+        if(it == m_threadIndices.constEnd())
+            it = m_threadIndices.insert(threadId, m_threadIndices.size());
+
+        const TraceEvent event = {name, start, duration, nofItems, it.value()};
+        m_events.append(event);
+    }
+
+  private:
+    explicit TraceRecorder(const QString& fileName): m_fileName(fileName) {}
+
+    static QElapsedTimer startedClock()
+    {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }
+
+    // All spans are measured from the first one on.
+    static const QElapsedTimer& clock()
+    {
+        static const QElapsedTimer s_clock = startedClock();
+        return s_clock;
+    }
+
+    static TraceRecorder* create()
+    {
+        const QString fileName = QString::fromLocal8Bit(qgetenv("KDIFF3_TRACE"));
+        if(fileName.isEmpty())
+            return nullptr;
+
+        clock();
+        qAddPostRoutine(writeAtExit);
+        return new TraceRecorder(fileName);
+    }
+
+    static void writeAtExit()
+    {
+        TraceRecorder* pRecorder = instance();
+        if(pRecorder != nullptr)
+            pRecorder->write();
+    }
+
+    void write()
+    {
+        QJsonArray events;
+        {
+            QMutexLocker locker(&m_mutex);
+            const qint64 pid = QCoreApplication::applicationPid();
+            for(const TraceEvent& event: m_events)
+            {
+                QJsonObject object;
+                object["name"] = QLatin1String(event.name);
+                object["ph"] = QLatin1String("X");
+                object["ts"] = event.start;
+                object["dur"] = event.duration;
+                object["pid"] = pid;
+                object["tid"] = event.threadIdx;
+                if(event.nofItems >= 0)
+                {
+                    QJsonObject args;
+                    args["items"] = event.nofItems;
+                    object["args"] = args;
+                }
+                events.append(object);
+            }
+            m_events.clear();
+        }
+
+        QJsonObject trace;
+        trace["traceEvents"] = events;
+        trace["displayTimeUnit"] = QLatin1String("ms");
+
+        QFile file(m_fileName);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) < 0)
+            qCWarning(kdiffTrace) << "Writing the trace to" << m_fileName << "failed:" << file.errorString();
+    }
+
+    const QString m_fileName;
+    QMutex m_mutex;
+    QVector<TraceEvent> m_events;
+    QHash<Qt::HANDLE, int> m_threadIndices;
+};
+
+} // namespace
+
+bool TraceSpan::isEnabled()
+{
+    return TraceRecorder::instance() != nullptr || kdiffTrace().isDebugEnabled();
+}
+
+TraceSpan::TraceSpan(const char* name, qint64 nofItems)
+    : m_name(name), m_nofItems(nofItems)
+{
+    if(isEnabled())
+        m_start = TraceRecorder::now();
+}
+
+TraceSpan::~TraceSpan()
+{
+    if(m_start < 0)
+        return;
+
+    const qint64 duration = TraceRecorder::now() - m_start;
+    TraceRecorder* pRecorder = TraceRecorder::instance();
+    if(pRecorder != nullptr)
+        pRecorder->add(m_name, m_start, duration, m_nofItems);
+
+    if(m_nofItems >= 0)
+        qCDebug(kdiffTrace).nospace() << m_name << ": " << duration / 1000.0 << " ms, " << m_nofItems << " items";
+    else
+        qCDebug(kdiffTrace).nospace() << m_name << ": " << duration / 1000.0 << " ms";
+}
@@ -0,0 +1,39 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <QtGlobal>
+
+/*
+    Measures one phase of the work from its construction to the end of its scope, on any thread.
+    Nothing is recorded unless tracing is enabled:
+    - "QT_LOGGING_RULES=org.kde.kdiff3.trace.debug=true" logs each span when it ends.
+    - "KDIFF3_TRACE=<file>" writes all spans as a Chrome trace to the file when the process ends,
+      it can be opened in chrome://tracing or https://ui.perfetto.dev.
+    The name must be a string literal, it is kept until the trace is written.
+*/
+class TraceSpan
+{
+  public:
+    explicit TraceSpan(const char* name, qint64 nofItems = -1);
+    ~TraceSpan();
+
+    // The lines, files or other items the phase handled, if not known at the start.
+    void setItemCount(qint64 nofItems) { m_nofItems = nofItems; }
+
+    static bool isEnabled();
+
+  private:
+    Q_DISABLE_COPY(TraceSpan)
+
+    const char* m_name;
+    qint64 m_nofItems;
+    qint64 m_start = -1; // In microseconds, -1 if tracing is off
+};
+
+#endif // !TRACING_H
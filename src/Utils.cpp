@@ -93,7 +93,8 @@ QString Utils::getArguments(QString cmd, QString& program, QStringList& args)
 
 bool Utils::wildcardMultiMatch(const QString& wildcard, const QString& testString, bool bCaseSensitive)
 {
-    static QHash<QString, QRegExp> s_patternMap;
+    // Folders are listed on several threads and QRegExp keeps state while matching, so each thread has its own.
+    static thread_local QHash<QString, QRegExp> s_patternMap;
 
     const QStringList regExpList = wildcard.split(QChar(';'));
 
@@ -8,6 +8,8 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <string.h>
+
 #include <QChar>
 #include <QFontMetrics>
 #include <QString>
@@ -19,6 +21,62 @@ class Utils{
       static QString getArguments(QString cmd, QString& program, QStringList& args);
       inline static bool isEndOfLine( QChar c ) { return c=='\n' || c=='\r' || c=='\x0b'; }
 
+      /*
+        Returns the number of equal characters at the start of p1 and p2, looking at no more than maxLength.
+        Compares 16 bytes at a time, equal lines or long equal runs are the common case in the diff loops.
+      */
+      inline static qint64 commonPrefixLength(const QChar* p1, const QChar* p2, qint64 maxLength)
+      {
+        qint64 i = 0;
+        for(; i + 8 <= maxLength; i += 8)
+        {
+          quint64 block1[2], block2[2];
+          memcpy(block1, p1 + i, sizeof(block1));
+          memcpy(block2, p2 + i, sizeof(block2));
+          if(block1[0] != block2[0] || block1[1] != block2[1])
+            break;
+        }
+
+        while(i < maxLength && p1[i] == p2[i])
+          ++i;
+
+        return i;
+      }
+
+      // For Latin-1 text, as TextChunk keeps it.
+      inline static qint64 commonPrefixLength(const char* p1, const char* p2, qint64 maxLength)
+      {
+        qint64 i = 0;
+        for(; i + 16 <= maxLength; i += 16)
+        {
+          quint64 block1[2], block2[2];
+          memcpy(block1, p1 + i, sizeof(block1));
+          memcpy(block2, p2 + i, sizeof(block2));
+          if(block1[0] != block2[0] || block1[1] != block2[1])
+            break;
+        }
+
+        while(i < maxLength && p1[i] == p2[i])
+          ++i;
+
+        return i;
+      }
+
+      // Latin-1 text against UTF-16 text, character by character.
+      template <typename Char1, typename Char2>
+      inline static qint64 commonPrefixLength(const Char1* p1, const Char2* p2, qint64 maxLength)
+      {
+        qint64 i = 0;
+        while(i < maxLength && toQChar(p1[i]) == toQChar(p2[i]))
+          ++i;
+
+        return i;
+      }
+
+      // The character of UTF-16 or of Latin-1 text, so kernels can be templates over both.
+      inline static QChar toQChar(QChar c) { return c; }
+      inline static QChar toQChar(char c) { return QChar::fromLatin1(c); }
+
       //Where posiable use QTextLayout in place of these functions especially when dealing with non-latin scripts.
       inline static int getHorizontalAdvance(const QFontMetrics &metrics, const QString& s, int len = -1)
       {
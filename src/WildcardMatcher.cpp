@@ -0,0 +1,161 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "WildcardMatcher.h"
+
+#include <algorithm>
+
+static void addLength(QVector<int>& lengths, int length)
+{
+    QVector<int>::iterator it = std::lower_bound(lengths.begin(), lengths.end(), length);
+    if(it == lengths.end() || *it != length)
+        lengths.insert(it, length);
+}
+
+WildcardMatcher::WildcardMatcher(const QString& patterns, bool bCaseSensitive):
+    WildcardMatcher(patterns.split(QChar(';')), bCaseSensitive)
+{
+}
+
+WildcardMatcher::WildcardMatcher(const QStringList& patterns, bool bCaseSensitive):
+    m_bCaseSensitive(bCaseSensitive)
+{
+    QStringList wildcards;
+    for(const QString& pattern: patterns)
+    {
+        int nofMetaCharacters = 0;
+        for(const QChar c: pattern)
+        {
+            if(c == '*' || c == '?' || c == '[')
+                ++nofMetaCharacters;
+        }
+
+        if(nofMetaCharacters == 0)
+            addExactName(pattern);
+        else if(nofMetaCharacters == 1 && pattern.startsWith('*'))
+            addSuffix(pattern.mid(1));
+        else if(nofMetaCharacters == 1 && pattern.endsWith('*'))
+            addPrefix(pattern.left(pattern.length() - 1));
+        else
+            wildcards.append(pattern);
+    }
+    addWildcards(wildcards);
+}
+
+WildcardMatcher::WildcardMatcher(const QStringList& exactNames, const QStringList& prefixes, const QStringList& suffixes,
+                                 const QStringList& wildcards, bool bCaseSensitive):
+    m_bCaseSensitive(bCaseSensitive)
+{
+    for(const QString& name: exactNames)
+        addExactName(name);
+    for(const QString& prefix: prefixes)
+        addPrefix(prefix);
+    for(const QString& suffix: suffixes)
+        addSuffix(suffix);
+    addWildcards(wildcards);
+}
+
+void WildcardMatcher::addExactName(const QString& name)
+{
+    m_exactNames.insert(key(name));
+}
+
+void WildcardMatcher::addPrefix(const QString& prefix)
+{
+    const QString prefixKey = key(prefix);
+    m_prefixes.insert(prefixKey);
+    addLength(m_prefixLengths, prefixKey.length());
+}
+
+void WildcardMatcher::addSuffix(const QString& suffix)
+{
+    const QString suffixKey = key(suffix);
+    m_suffixes.insert(suffixKey);
+    addLength(m_suffixLengths, suffixKey.length());
+}
+
+void WildcardMatcher::addWildcards(const QStringList& wildcards)
+{
+    const QRegularExpression::PatternOptions options = QRegularExpression::DotMatchesEverythingOption |
+                                                       (m_bCaseSensitive ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption);
+
+    // Like QRegExp an invalid pattern matches nothing, it must not spoil the others.
+    QStringList regExps;
+    for(const QString& wildcard: wildcards)
+    {
+        const QString regExp = wildcardToRegExp(wildcard);
+        if(QRegularExpression(regExp, options).isValid())
+            regExps.append(regExp);
+    }
+
+    m_bHasWildcards = !regExps.isEmpty();
+    if(m_bHasWildcards)
+    {
+        m_wildcards = QRegularExpression("\\A(?:" + regExps.join('|') + ")\\z", options);
+        m_wildcards.optimize();
+    }
+}
+
+// The same translation QRegExp::Wildcard does, '\' is no escape character.
+QString WildcardMatcher::wildcardToRegExp(const QString& wildcard)
+{
+    QString regExp;
+    const int length = wildcard.length();
+    for(int i = 0; i < length;)
+    {
+        const QChar c = wildcard[i++];
+        if(c == '*')
+            regExp += QLatin1String(".*");
+        else if(c == '?')
+            regExp += '.';
+        else if(c == '[')
+        {
+            regExp += c;
+            if(i < length && wildcard[i] == '^')
+                regExp += wildcard[i++];
+            if(i < length && wildcard[i] == ']')
+                regExp += wildcard[i++];
+            while(i < length && wildcard[i] != ']')
+            {
+                if(wildcard[i] == '\\')
+                    regExp += '\\';
+                regExp += wildcard[i++];
+            }
+            if(i < length)
+                regExp += wildcard[i++];
+        }
+        else
+            regExp += QRegularExpression::escape(QString(c));
+    }
+
+    return "(?:" + regExp + ')';
+}
+
+bool WildcardMatcher::matches(const QString& text) const
+{
+    const QString textKey = key(text);
+    if(m_exactNames.contains(textKey))
+        return true;
+
+    for(const int length: m_prefixLengths)
+    {
+        if(length > textKey.length())
+            break;
+        if(m_prefixes.contains(textKey.left(length)))
+            return true;
+    }
+
+    for(const int length: m_suffixLengths)
+    {
+        if(length > textKey.length())
+            break;
+        if(m_suffixes.contains(textKey.right(length)))
+            return true;
+    }
+
+    return m_bHasWildcards && m_wildcards.match(text).hasMatch();
+}
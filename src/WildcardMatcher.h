@@ -0,0 +1,56 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef WILDCARDMATCHER_H
+#define WILDCARDMATCHER_H
+
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/*
+    A set of file name wildcards in the syntax of QRegExp::Wildcard, compiled once so a name is
+    checked against all of them at once: names without wildcards are looked up in a hash set, as
+    are patterns with a single '*' at the start or end for each length in use. All other patterns
+    are joined into one regular expression.
+    Matching does not change the object, so it may be shared by threads once constructed.
+*/
+class WildcardMatcher
+{
+  public:
+    WildcardMatcher() = default;
+    // Patterns separated by ';' like the file and folder patterns of the options.
+    WildcardMatcher(const QString& patterns, bool bCaseSensitive);
+    WildcardMatcher(const QStringList& patterns, bool bCaseSensitive);
+    // For patterns sorted in advance, prefixes and suffixes are given without the '*'.
+    WildcardMatcher(const QStringList& exactNames, const QStringList& prefixes, const QStringList& suffixes,
+                    const QStringList& wildcards, bool bCaseSensitive);
+
+    bool matches(const QString& text) const;
+
+  private:
+    static QString wildcardToRegExp(const QString& wildcard);
+
+    void addExactName(const QString& name);
+    void addPrefix(const QString& prefix);
+    void addSuffix(const QString& suffix);
+    void addWildcards(const QStringList& wildcards);
+
+    QString key(const QString& text) const { return m_bCaseSensitive ? text : text.toCaseFolded(); }
+
+    bool m_bCaseSensitive = true;
+    QSet<QString> m_exactNames;
+    QSet<QString> m_prefixes;
+    QVector<int> m_prefixLengths;
+    QSet<QString> m_suffixes;
+    QVector<int> m_suffixLengths;
+    bool m_bHasWildcards = false;
+    QRegularExpression m_wildcards;
+};
+
+#endif // !WILDCARDMATCHER_H
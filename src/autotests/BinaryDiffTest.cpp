@@ -0,0 +1,138 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QByteArray>
+#include <QTest>
+
+#include <random>
+
+#include "../BinaryDiff.h"
+
+// Checks that the ranges are in order and that all bytes between them are equal.
+static bool rangesFit(const QVector<BinaryDiff::Range>& ranges, const QByteArray& data1, const QByteArray& data2)
+{
+    qint64 pos1 = 0;
+    qint64 pos2 = 0;
+    for(const BinaryDiff::Range& range : ranges)
+    {
+        if(range.offset1 - pos1 != range.offset2 - pos2 || range.offset1 < pos1 || range.size1 + range.size2 == 0 ||
+           data1.mid((int)pos1, (int)(range.offset1 - pos1)) != data2.mid((int)pos2, (int)(range.offset2 - pos2)))
+            return false;
+        pos1 = range.offset1 + range.size1;
+        pos2 = range.offset2 + range.size2;
+    }
+    return data1.size() - pos1 == data2.size() - pos2 && data1.mid((int)pos1) == data2.mid((int)pos2);
+}
+
+static QVector<BinaryDiff::Range> binaryDiff(const QByteArray& data1, const QByteArray& data2)
+{
+    BinaryDiff diff((const uchar*)data1.constData(), data1.size(), (const uchar*)data2.constData(), data2.size());
+    return diff.run();
+}
+
+static QByteArray randomBytes(std::mt19937& random, qint32 size)
+{
+    QByteArray data;
+    for(qint32 i = 0; i < size; ++i)
+        data += (char)(random() % 256);
+    return data;
+}
+
+class BinaryDiffTest : public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void binaryDiffSmallInputs()
+    {
+        QVERIFY(binaryDiff(QByteArray(), QByteArray()).isEmpty());
+        QVERIFY(binaryDiff(QByteArray("abc"), QByteArray("abc")).isEmpty());
+
+        QVector<BinaryDiff::Range> ranges = binaryDiff(QByteArray("abc"), QByteArray("abd"));
+        QCOMPARE(ranges.size(), 1);
+        QCOMPARE(ranges[0].offset1, qint64(2));
+        QCOMPARE(ranges[0].size1, qint64(1));
+        QCOMPARE(ranges[0].size2, qint64(1));
+
+        ranges = binaryDiff(QByteArray(), QByteArray("abc"));
+        QCOMPARE(ranges.size(), 1);
+        QCOMPARE(ranges[0].size1, qint64(0));
+        QCOMPARE(ranges[0].size2, qint64(3));
+    }
+
+    // Inserted bytes cost only their own range instead of shifting everything after them.
+    void binaryDiffInsertedBytes()
+    {
+        std::mt19937 random(4);
+        const QByteArray data1 = randomBytes(random, 10000);
+        const QByteArray data2 = data1.left(5000) + QByteArray("0123456789") + data1.mid(5000);
+
+        const QVector<BinaryDiff::Range> ranges = binaryDiff(data1, data2);
+        QCOMPARE(ranges.size(), 1);
+        QCOMPARE(ranges[0].size1, qint64(0));
+        QCOMPARE(ranges[0].size2, qint64(10));
+        QVERIFY(rangesFit(ranges, data1, data2));
+    }
+
+    void binaryDiffReplacedBytes()
+    {
+        std::mt19937 random(5);
+        const QByteArray data1 = randomBytes(random, 10000);
+        QByteArray data2 = data1;
+        for(qint32 i = 3000; i < 3020; ++i)
+            data2[i] = (char)~data1[i];
+
+        const QVector<BinaryDiff::Range> ranges = binaryDiff(data1, data2);
+        QCOMPARE(ranges.size(), 1);
+        QCOMPARE(ranges[0].offset1, qint64(3000));
+        QCOMPARE(ranges[0].size1, qint64(20));
+        QCOMPARE(ranges[0].offset2, qint64(3000));
+        QCOMPARE(ranges[0].size2, qint64(20));
+    }
+
+    void binaryDiffRandomChanges()
+    {
+        std::mt19937 random(6);
+
+        for(qint32 k = 0; k < 200; ++k)
+        {
+            // Few distinct bytes give repeated content that matches in many places.
+            const bool bRepeated = random() % 3 == 0;
+            QByteArray data1 = randomBytes(random, random() % 20000);
+            if(bRepeated)
+            {
+                for(qint32 i = 0; i < data1.size(); ++i)
+                    data1[i] = (char)(data1[i] & 1);
+            }
+
+            QByteArray data2 = data1;
+            const qint32 nofChanges = random() % 10;
+            for(qint32 c = 0; c < nofChanges; ++c)
+            {
+                const qint32 pos = data2.isEmpty() ? 0 : random() % data2.size();
+                const qint32 size = random() % 300;
+                switch(random() % 3)
+                {
+                    case 0:
+                        data2.insert(pos, randomBytes(random, size));
+                        break;
+                    case 1:
+                        data2.remove(pos, size);
+                        break;
+                    default:
+                        data2.replace(pos, size, randomBytes(random, size));
+                        break;
+                }
+            }
+
+            QVERIFY(rangesFit(binaryDiff(data1, data2), data1, data2));
+        }
+    }
+};
+
+QTEST_MAIN(BinaryDiffTest);
+
+#include "BinaryDiffTest.moc"
@@ -10,6 +10,7 @@
 #include <qglobal.h>
 
 #include "../cvsignorelist.h"
+#include "../WildcardMatcher.h"
 
 class CvsIgnoreListTest : public QObject
 {
@@ -80,6 +81,60 @@ class CvsIgnoreListTest : public QObject
         QVERIFY(test.matches("k.k ", false));
     }
 
+    void wildcardMatcher()
+    {
+        WildcardMatcher test(";core", true);
+        //An empty pattern only matches empty names
+        QVERIFY(test.matches(""));
+        QVERIFY(!test.matches("a"));
+
+        test = WildcardMatcher("*", true);
+        QVERIFY(test.matches(""));
+        QVERIFY(test.matches("a"));
+
+        test = WildcardMatcher("*.orig;*.o;core;lib*;a?c;*.[ch];x*y*z", true);
+        QVERIFY(test.matches("test.orig"));
+        QVERIFY(test.matches("test.o"));
+        QVERIFY(!test.matches("test.obj"));
+        QVERIFY(test.matches("core"));
+        QVERIFY(!test.matches("cores"));
+        QVERIFY(test.matches("libkdiff3.so"));
+        QVERIFY(test.matches("lib"));
+        QVERIFY(!test.matches("xlib"));
+        QVERIFY(test.matches("abc"));
+        QVERIFY(!test.matches("abbc"));
+        QVERIFY(test.matches("diff.c"));
+        QVERIFY(test.matches("diff.h"));
+        QVERIFY(!test.matches("diff.cpp"));
+        QVERIFY(test.matches("xyz"));
+        QVERIFY(test.matches("x12y34z"));
+        QVERIFY(!test.matches("x12y34"));
+        QVERIFY(!test.matches("Core"));
+        QVERIFY(!test.matches("LIBX"));
+
+        test = WildcardMatcher("*.orig;core;lib*;a?c", false);
+        QVERIFY(test.matches("Test.ORIG"));
+        QVERIFY(test.matches("CORE"));
+        QVERIFY(test.matches("LibX"));
+        QVERIFY(test.matches("ABC"));
+        QVERIFY(!test.matches("ABBC"));
+
+        //No escape characters and regular expression syntax is just text
+        test = WildcardMatcher("a\\b;(x)*;a.c*;[abc", true);
+        QVERIFY(test.matches("a\\b"));
+        QVERIFY(test.matches("(x)"));
+        QVERIFY(test.matches("(x)y"));
+        QVERIFY(!test.matches("x"));
+        QVERIFY(test.matches("a.c"));
+        QVERIFY(!test.matches("abc"));
+        //An invalid pattern matches nothing but leaves the others working
+        QVERIFY(!test.matches("[abc"));
+        QVERIFY(!test.matches("a"));
+
+        test = WildcardMatcher();
+        QVERIFY(!test.matches("a"));
+    }
+
     void testDefaults()
     {
         CvsIgnoreList test;
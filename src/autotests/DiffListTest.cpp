@@ -0,0 +1,293 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QStringList>
+#include <QTest>
+
+#include "../diff.h"
+#include "../options.h"
+#include "../progress.h"
+#include "TestInputFiles.h"
+
+// For each line of the first input the line of the second one it is equal to, or -1.
+static QVector<qint32> equalLines(const DiffList& diffList, LineRef size1)
+{
+    QVector<qint32> lines(size1, -1);
+    qint32 pos1 = 0;
+    qint32 pos2 = 0;
+    for(const Diff& d : diffList)
+    {
+        for(qint32 i = 0; i < d.numberOfEquals() && pos1 + i < size1; ++i)
+            lines[pos1 + i] = pos2 + i;
+        pos1 += d.numberOfEquals() + d.diff1();
+        pos2 += d.numberOfEquals() + d.diff2();
+    }
+    return lines;
+}
+
+static bool diffListFits(const DiffList& diffList, LineRef size1, LineRef size2)
+{
+    qint64 l1 = 0;
+    qint64 l2 = 0;
+    for(const Diff& d : diffList)
+    {
+        l1 += d.numberOfEquals() + d.diff1();
+        l2 += d.numberOfEquals() + d.diff2();
+    }
+    return l1 == size1 && l2 == size2;
+}
+
+// Unique lines apart from the ones at the positions in changes, which get other unique text.
+static QString numberedLines(qint32 nofLines, const QVector<qint32>& changes, const QString& changedText)
+{
+    QString text;
+    for(qint32 i = 0; i < nofLines; ++i)
+    {
+        if(changes.contains(i))
+            text += changedText + QStringLiteral(" %1\n").arg(i);
+        else
+            text += QStringLiteral("line %1\n").arg(i);
+    }
+    return text;
+}
+
+static bool hasDiffs(const DiffList& diffList, const QVector<Diff>& diffs)
+{
+    if((qint32)diffList.size() != diffs.size())
+        return false;
+
+    for(qint32 i = 0; i < diffs.size(); ++i)
+    {
+        if(diffList[i].numberOfEquals() != diffs[i].numberOfEquals() || diffList[i].diff1() != diffs[i].diff1() ||
+           diffList[i].diff2() != diffs[i].diff2())
+            return false;
+    }
+    return true;
+}
+
+class DiffListTest : public QObject
+{
+    Q_OBJECT
+  private:
+    HiddenProgressDialog m_progressDialog;
+    TestInputFiles m_inputFiles;
+    QSharedPointer<Options> m_pOptions = QSharedPointer<Options>::create();
+
+    bool readSourceData(SourceData& sourceData, const QString& text) { return m_inputFiles.read(sourceData, text, m_pOptions); }
+
+  private Q_SLOTS:
+    /*
+        Inputs with more lines than minLinesForAnchoredDiff are cut at lines occurring once in both
+        and compared in parts. With unique lines and few changes the minimal diff is unique, so the
+        parts must give the same alignment as comparing everything at once.
+    */
+    void anchoredDiffOfLargeInputs()
+    {
+        QString text1;
+        QString text2;
+        for(qint32 i = 0; i < 150000; ++i)
+        {
+            const QString line = QStringLiteral("line %1\n").arg(i);
+            text1 += line;
+            if(i % 5000 == 1)
+                text2 += QStringLiteral("changed %1\n").arg(i);
+            else if(i % 7000 == 2)
+                continue;
+            else
+                text2 += line;
+
+            if(i % 9000 == 3)
+                text2 += QStringLiteral("inserted %1\n").arg(i);
+        }
+
+        SourceData sd1, sd2;
+        QVERIFY(readSourceData(sd1, text1));
+        QVERIFY(readSourceData(sd2, text2));
+
+        ManualDiffHelpList manualDiffHelpList;
+        DiffList anchoredDiffList;
+        DiffList diffList;
+        manualDiffHelpList.runDiff(sd1.getLineDataForDiff(), sd1.getSizeLines(), sd2.getLineDataForDiff(), sd2.getSizeLines(), anchoredDiffList,
+                                   e_SrcSelector::A, e_SrcSelector::B, m_pOptions, sd1.getLineHashesForDiff(false), sd2.getLineHashesForDiff(false));
+        manualDiffHelpList.runDiff(sd1.getLineDataForDiff(), sd1.getSizeLines(), sd2.getLineDataForDiff(), sd2.getSizeLines(), diffList,
+                                   e_SrcSelector::A, e_SrcSelector::B, m_pOptions);
+
+        QVERIFY(diffListFits(anchoredDiffList, sd1.getSizeLines(), sd2.getSizeLines()));
+        QVERIFY(!anchoredDiffList.isDegraded());
+        QVERIFY(equalLines(anchoredDiffList, sd1.getSizeLines()) == equalLines(diffList, sd1.getSizeLines()));
+    }
+
+    /*
+        After both inputs were reloaded rerunDiff() keeps the diffs of the unchanged lines at the start and
+        end. The result must align the same lines as comparing the new inputs again.
+    */
+    void rerunDiffAfterChanges()
+    {
+        const QVector<QVector<qint32>> oldChanges1 = {{}, {50}, {3, 190}, {}};
+        const QVector<QVector<qint32>> oldChanges2 = {{}, {60}, {100}, {0, 199}};
+        const QVector<QVector<qint32>> newChanges1 = {{120}, {50, 70}, {3}, {}};
+        const QVector<QVector<qint32>> newChanges2 = {{}, {60, 80}, {100, 150}, {0}};
+
+        for(qint32 k = 0; k < oldChanges1.size(); ++k)
+        {
+            SourceData oldSd1, oldSd2, sd1, sd2;
+            QVERIFY(readSourceData(oldSd1, numberedLines(200, oldChanges1[k], QStringLiteral("old"))));
+            QVERIFY(readSourceData(oldSd2, numberedLines(200, oldChanges2[k], QStringLiteral("old"))));
+            QVERIFY(readSourceData(sd1, numberedLines(200 + k, newChanges1[k], QStringLiteral("new"))));
+            QVERIFY(readSourceData(sd2, numberedLines(200, newChanges2[k], QStringLiteral("new"))));
+
+            DiffList oldDiffList;
+            oldDiffList.runDiff(oldSd1.getLineDataForDiff(), 0, oldSd1.getSizeLines(), oldSd2.getLineDataForDiff(), 0, oldSd2.getSizeLines(), m_pOptions);
+
+            DiffList diffList;
+            QVERIFY(diffList.rerunDiff(oldDiffList, oldSd1.getLineDataForDiff(), oldSd2.getLineDataForDiff(),
+                                       sd1.getLineDataForDiff(), sd1.getSizeLines(), sd2.getLineDataForDiff(), sd2.getSizeLines(), m_pOptions));
+
+            DiffList newDiffList;
+            newDiffList.runDiff(sd1.getLineDataForDiff(), 0, sd1.getSizeLines(), sd2.getLineDataForDiff(), 0, sd2.getSizeLines(), m_pOptions);
+
+            QVERIFY(diffListFits(diffList, sd1.getSizeLines(), sd2.getSizeLines()));
+            QVERIFY(equalLines(diffList, sd1.getSizeLines()) == equalLines(newDiffList, sd1.getSizeLines()));
+        }
+    }
+
+    // Without changes the old diffs are taken over as they are.
+    void rerunDiffWithoutChanges()
+    {
+        SourceData oldSd1, oldSd2, sd1, sd2;
+        QVERIFY(readSourceData(oldSd1, numberedLines(100, {10, 20}, QStringLiteral("first"))));
+        QVERIFY(readSourceData(oldSd2, numberedLines(100, {20, 30}, QStringLiteral("second"))));
+        QVERIFY(readSourceData(sd1, numberedLines(100, {10, 20}, QStringLiteral("first"))));
+        QVERIFY(readSourceData(sd2, numberedLines(100, {20, 30}, QStringLiteral("second"))));
+
+        DiffList oldDiffList;
+        oldDiffList.runDiff(oldSd1.getLineDataForDiff(), 0, oldSd1.getSizeLines(), oldSd2.getLineDataForDiff(), 0, oldSd2.getSizeLines(), m_pOptions);
+
+        DiffList diffList;
+        QVERIFY(diffList.rerunDiff(oldDiffList, oldSd1.getLineDataForDiff(), oldSd2.getLineDataForDiff(),
+                                   sd1.getLineDataForDiff(), sd1.getSizeLines(), sd2.getLineDataForDiff(), sd2.getSizeLines(), m_pOptions));
+        QCOMPARE(diffList.size(), oldDiffList.size());
+        QVERIFY(equalLines(diffList, sd1.getSizeLines()) == equalLines(oldDiffList, oldSd1.getSizeLines()));
+    }
+
+    // An old diff list that doesn't belong to the old line data is not used.
+    void rerunDiffWithMismatchedOldDiffs()
+    {
+        SourceData oldSd1, oldSd2, sd1, sd2;
+        QVERIFY(readSourceData(oldSd1, numberedLines(50, {}, QString())));
+        QVERIFY(readSourceData(oldSd2, numberedLines(50, {5}, QStringLiteral("old"))));
+        QVERIFY(readSourceData(sd1, numberedLines(60, {}, QString())));
+        QVERIFY(readSourceData(sd2, numberedLines(60, {5, 55}, QStringLiteral("new"))));
+
+        DiffList oldDiffList;
+        oldDiffList.push_back(Diff(10, 0, 0));
+
+        DiffList diffList;
+        QVERIFY(diffList.rerunDiff(oldDiffList, oldSd1.getLineDataForDiff(), oldSd2.getLineDataForDiff(),
+                                   sd1.getLineDataForDiff(), sd1.getSizeLines(), sd2.getLineDataForDiff(), sd2.getSizeLines(), m_pOptions));
+
+        DiffList newDiffList;
+        newDiffList.runDiff(sd1.getLineDataForDiff(), 0, sd1.getSizeLines(), sd2.getLineDataForDiff(), 0, sd2.getSizeLines(), m_pOptions);
+        QVERIFY(equalLines(diffList, sd1.getSizeLines()) == equalLines(newDiffList, sd1.getSizeLines()));
+    }
+
+    // GnuDiff reads Latin-1 text with one byte per character, against Latin-1 and against UTF-16 text.
+    void diffOfLatin1AndUtf16Text()
+    {
+        const QString latin1Text = numberedLines(100, {}, QString());
+        const QStringList changedTexts = {QStringLiteral("changed"), QStringLiteral("\u20ac changed")};
+        for(const QString& changedText: changedTexts)
+        {
+            SourceData sd1, sd2;
+            QVERIFY(readSourceData(sd1, latin1Text));
+            QVERIFY(readSourceData(sd2, numberedLines(100, {50}, changedText)));
+
+            DiffList diffList;
+            diffList.runDiff(sd1.getLineDataForDiff(), 0, sd1.getSizeLines(), sd2.getLineDataForDiff(), 0, sd2.getSizeLines(), m_pOptions);
+            QVERIFY(hasDiffs(diffList, {Diff(50, 1, 1), Diff(49, 0, 0)}));
+
+            DiffList reverseDiffList;
+            reverseDiffList.runDiff(sd2.getLineDataForDiff(), 0, sd2.getSizeLines(), sd1.getLineDataForDiff(), 0, sd1.getSizeLines(), m_pOptions);
+            QVERIFY(hasDiffs(reverseDiffList, {Diff(50, 1, 1), Diff(49, 0, 0)}));
+        }
+    }
+
+    void readUnifiedDiff()
+    {
+        DiffList diffList;
+        QString errorReason;
+
+        QVERIFY(diffList.readUnifiedDiff("--- a\n+++ b\n@@ -1,3 +1,3 @@\n a\n-b\n+B\n c\n", 3, 3, errorReason));
+        QVERIFY(hasDiffs(diffList, {Diff(1, 1, 1), Diff(1, 0, 0)}));
+
+        // Line 2 replaced by two lines and one line added after line 8.
+        QVERIFY(diffList.readUnifiedDiff("@@ -2,1 +2,2 @@\n-b\n+B\n+X\n@@ -8,0 +10,1 @@\n+Y\n", 10, 12, errorReason));
+        QVERIFY(hasDiffs(diffList, {Diff(1, 1, 2), Diff(6, 0, 1), Diff(2, 0, 0)}));
+
+        // Empty context lines without their space and the marker of a missing line end at the end.
+        QVERIFY(diffList.readUnifiedDiff("@@ -1,3 +1,3 @@\n-a\n+A\n\n c\n", 3, 3, errorReason));
+        QVERIFY(hasDiffs(diffList, {Diff(0, 1, 1), Diff(2, 0, 0)}));
+        QVERIFY(diffList.readUnifiedDiff("@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+B\n\\ No newline at end of file\n", 2, 2, errorReason));
+        QVERIFY(hasDiffs(diffList, {Diff(1, 1, 1)}));
+
+        QVERIFY(diffList.readUnifiedDiff("", 4, 4, errorReason));
+        QVERIFY(hasDiffs(diffList, {Diff(4, 0, 0)}));
+    }
+
+    // A hunk without content lines counts as changed as a whole.
+    void readUnifiedDiffHunkHeaders()
+    {
+        DiffList diffList;
+        QString errorReason;
+
+        QVERIFY(diffList.readUnifiedDiff("@@ -3 +3 @@\n", 3, 3, errorReason));
+        QVERIFY(hasDiffs(diffList, {Diff(2, 1, 1)}));
+
+        QVERIFY(diffList.readUnifiedDiff("@@ -2 +2 @@\n@@ -5,2 +4,0 @@\n", 6, 4, errorReason));
+        QVERIFY(hasDiffs(diffList, {Diff(1, 1, 1), Diff(2, 2, 0)}));
+    }
+
+    void readUnifiedDiffMisfits()
+    {
+        DiffList diffList;
+        QString errorReason;
+
+        // Another number of unchanged lines before the hunk in both inputs.
+        QVERIFY(!diffList.readUnifiedDiff("@@ -2,1 +3,1 @@\n", 3, 3, errorReason));
+        QVERIFY(!errorReason.isEmpty());
+        QVERIFY(diffList.empty());
+
+        // Behind the end of the inputs.
+        errorReason.clear();
+        QVERIFY(!diffList.readUnifiedDiff("@@ -3,2 +3,2 @@\n", 3, 3, errorReason));
+        QVERIFY(!errorReason.isEmpty());
+
+        // Overlapping hunks.
+        errorReason.clear();
+        QVERIFY(!diffList.readUnifiedDiff("@@ -1,2 +1,2 @@\n-a\n-b\n+A\n+B\n@@ -2,1 +2,1 @@\n", 3, 3, errorReason));
+        QVERIFY(!errorReason.isEmpty());
+
+        // Fewer content lines than the header says.
+        errorReason.clear();
+        QVERIFY(!diffList.readUnifiedDiff("@@ -1,3 +1,3 @@\n a\n-b\n", 3, 3, errorReason));
+        QVERIFY(!errorReason.isEmpty());
+
+        // Another number of unchanged lines after the last hunk.
+        errorReason.clear();
+        QVERIFY(!diffList.readUnifiedDiff("@@ -1 +1,2 @@\n-a\n+A\n+B\n", 3, 3, errorReason));
+        QVERIFY(!errorReason.isEmpty());
+        QVERIFY(diffList.empty());
+
+        errorReason.clear();
+        QVERIFY(!diffList.readUnifiedDiff("", 4, 5, errorReason));
+        QVERIFY(!errorReason.isEmpty());
+    }
+};
+
+QTEST_MAIN(DiffListTest);
+
+#include "DiffListTest.moc"
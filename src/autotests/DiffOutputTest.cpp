@@ -0,0 +1,94 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QStringList>
+#include <QTest>
+#include <QTextCodec>
+
+#include "../FullAnalysis.h"
+#include "../options.h"
+#include "../progress.h"
+#include "TestInputFiles.h"
+
+class DiffOutputTest : public QObject
+{
+    Q_OBJECT
+  private:
+    HiddenProgressDialog m_progressDialog;
+    TestInputFiles m_inputFiles;
+    QSharedPointer<Options> m_pOptions = QSharedPointer<Options>::create();
+
+    // What --diff-output writes for two files with these contents.
+    QByteArray diffOutput(const QByteArray& data1, const QByteArray& data2, int& exitCode)
+    {
+        QTextCodec* pUtf8 = QTextCodec::codecForName("UTF-8");
+        m_pOptions->m_pEncodingA = m_pOptions->m_pEncodingB = m_pOptions->m_pEncodingC = pUtf8;
+
+        QBuffer output;
+        output.open(QIODevice::WriteOnly);
+        QStringList errors;
+        exitCode = FullAnalysis::writeDiff(m_inputFiles.write(data1), m_inputFiles.write(data2), QString(), {QStringLiteral("a"), QStringLiteral("b")},
+                                           m_pOptions, output, errors);
+        return output.data();
+    }
+
+  private Q_SLOTS:
+    void diffOutputOfEqualFiles()
+    {
+        int exitCode = -1;
+        QCOMPARE(diffOutput("a\nb\n", "a\nb\n", exitCode), QByteArray());
+        QCOMPARE(exitCode, 0);
+    }
+
+    void diffOutputOfChangedLines()
+    {
+        int exitCode = -1;
+        QCOMPARE(diffOutput("a\nb\nc\n", "a\nB\nc\n", exitCode), QByteArray("--- a\n+++ b\n@@ -1,3 +1,3 @@\n a\n-b\n+B\n c\n"));
+        QCOMPARE(exitCode, 1);
+    }
+
+    // The lines keep the line ends of their input.
+    void diffOutputLineEnds()
+    {
+        int exitCode = -1;
+        QCOMPARE(diffOutput("a\r\nb\r\n", "a\nc\n", exitCode), QByteArray("--- a\n+++ b\n@@ -1,2 +1,2 @@\n a\r\n-b\r\n+c\n"));
+        QCOMPARE(exitCode, 1);
+    }
+
+    void diffOutputWithoutFinalLineEnd()
+    {
+        int exitCode = -1;
+        QCOMPARE(diffOutput("a\nb\n", "a\nc", exitCode), QByteArray("--- a\n+++ b\n@@ -1,2 +1,2 @@\n a\n-b\n+c\n\\ No newline at end of file\n"));
+        QCOMPARE(diffOutput("a\nb", "a\nc", exitCode),
+                 QByteArray("--- a\n+++ b\n@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+c\n\\ No newline at end of file\n"));
+
+        // Only the line end of the last line differs.
+        QCOMPARE(diffOutput("a\nb\n", "a\nb", exitCode), QByteArray("--- a\n+++ b\n@@ -1,2 +1,2 @@\n a\n-b\n+b\n\\ No newline at end of file\n"));
+        QCOMPARE(exitCode, 1);
+    }
+
+    // Written in the encoding of the inputs, not always in UTF-8.
+    void diffOutputEncoding()
+    {
+        // With a byte order mark, so they are read as UTF-16.
+        QTextCodec* pUtf16 = QTextCodec::codecForName("UTF-16LE");
+        int exitCode = -1;
+        const QByteArray output = diffOutput(pUtf16->fromUnicode(QStringLiteral("a\n\u00fc\n")), pUtf16->fromUnicode(QStringLiteral("a\n\u20ac\n")), exitCode);
+        QCOMPARE(exitCode, 1);
+
+        QString text = pUtf16->toUnicode(output);
+        if(text.startsWith(QChar(0xfeff)))
+            text.remove(0, 1);
+        QCOMPARE(text, QStringLiteral("--- a\n+++ b\n@@ -1,2 +1,2 @@\n a\n-\u00fc\n+\u20ac\n"));
+    }
+};
+
+QTEST_MAIN(DiffOutputTest);
+
+#include "DiffOutputTest.moc"
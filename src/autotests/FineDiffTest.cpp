@@ -0,0 +1,184 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../diff.h"
+#include "../FineDiff.h"
+
+// Checks that diffList covers both inputs and, if bCheckEquals, that the ranges it calls equal are.
+static bool fitsLines(const DiffList& diffList, const QString& line1, const QString& line2, bool bCheckEquals)
+{
+    qint64 pos1 = 0;
+    qint64 pos2 = 0;
+    for(const Diff& d : diffList)
+    {
+        if(bCheckEquals && line1.mid((int)pos1, d.numberOfEquals()) != line2.mid((int)pos2, d.numberOfEquals()))
+            return false;
+        pos1 += d.numberOfEquals() + d.diff1();
+        pos2 += d.numberOfEquals() + d.diff2();
+    }
+    return pos1 == line1.length() && pos2 == line2.length();
+}
+
+static qint32 nofEquals(const DiffList& diffList)
+{
+    qint32 count = 0;
+    for(const Diff& d : diffList)
+        count += d.numberOfEquals();
+    return count;
+}
+
+// Length of the longest common subsequence, the number of equal characters of a minimal diff.
+static qint32 lcsLength(const QString& line1, const QString& line2)
+{
+    std::vector<qint32> row(line2.length() + 1, 0);
+    for(qint32 i = 1; i <= line1.length(); ++i)
+    {
+        qint32 diagonal = 0;
+        for(qint32 j = 1; j <= line2.length(); ++j)
+        {
+            const qint32 above = row[j];
+            row[j] = line1[i - 1] == line2[j - 1] ? diagonal + 1 : std::max(row[j], row[j - 1]);
+            diagonal = above;
+        }
+    }
+    return row[line2.length()];
+}
+
+static QString randomLine(std::mt19937& random, qint32 length, qint32 nofChars)
+{
+    QString line;
+    for(qint32 i = 0; i < length; ++i)
+        line += QChar('a' + (int)(random() % nofChars));
+    return line;
+}
+
+// A copy of line with some characters removed, replaced and inserted.
+static QString changedLine(std::mt19937& random, const QString& line, qint32 nofChars)
+{
+    QString changed;
+    for(const QChar c : line)
+    {
+        switch(random() % 8)
+        {
+            case 0:
+                break;
+            case 1:
+                changed += QChar('a' + (int)(random() % nofChars));
+                break;
+            case 2:
+                changed += c;
+                changed += QChar('a' + (int)(random() % nofChars));
+                break;
+            default:
+                changed += c;
+                break;
+        }
+    }
+    return changed;
+}
+
+class FineDiffTest : public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void fineDiffEmptyLines()
+    {
+        const SearchFineDiff searchFineDiff(2, 500);
+        const MyersFineDiff myersFineDiff(1000);
+        const BitParallelFineDiff bitParallelFineDiff;
+        const FineDiffEngine* engines[] = {&searchFineDiff, &myersFineDiff, &bitParallelFineDiff};
+
+        for(const FineDiffEngine* pEngine : engines)
+        {
+            DiffList diffList;
+            pEngine->calcDiff(QString(), QString(), diffList);
+            QVERIFY(fitsLines(diffList, QString(), QString(), true));
+
+            pEngine->calcDiff(QStringLiteral("abc"), QString(), diffList);
+            QVERIFY(fitsLines(diffList, QStringLiteral("abc"), QString(), true));
+            QCOMPARE(nofEquals(diffList), 0);
+
+            pEngine->calcDiff(QString(), QStringLiteral("abc"), diffList);
+            QVERIFY(fitsLines(diffList, QString(), QStringLiteral("abc"), true));
+            QCOMPARE(nofEquals(diffList), 0);
+
+            pEngine->calcDiff(QStringLiteral("abc"), QStringLiteral("abc"), diffList);
+            QVERIFY(fitsLines(diffList, QStringLiteral("abc"), QStringLiteral("abc"), true));
+            QCOMPARE(nofEquals(diffList), 3);
+        }
+    }
+
+    /*
+        Myers' algorithm without reaching its cost limit and the bit vector LCS both give a minimal
+        diff. The search based one only promises to cover both lines.
+    */
+    void fineDiffRandomLines()
+    {
+        const SearchFineDiff searchFineDiff(2, 500);
+        const MyersFineDiff myersFineDiff(100000);
+        const BitParallelFineDiff bitParallelFineDiff;
+        std::mt19937 random(1);
+
+        for(qint32 k = 0; k < 500; ++k)
+        {
+            const qint32 nofChars = 2 + random() % 20;
+            const QString line1 = randomLine(random, random() % 300, nofChars);
+            const QString line2 = random() % 4 == 0 ? randomLine(random, random() % 300, nofChars) : changedLine(random, line1, nofChars);
+            const qint32 minimalEquals = lcsLength(line1, line2);
+
+            DiffList diffList;
+            searchFineDiff.calcDiff(line1, line2, diffList);
+            QVERIFY(fitsLines(diffList, line1, line2, false));
+
+            myersFineDiff.calcDiff(line1, line2, diffList);
+            QVERIFY(fitsLines(diffList, line1, line2, true));
+            QCOMPARE(nofEquals(diffList), minimalEquals);
+
+            bitParallelFineDiff.calcDiff(line1, line2, diffList);
+            QVERIFY(fitsLines(diffList, line1, line2, true));
+            QCOMPARE(nofEquals(diffList), minimalEquals);
+        }
+    }
+
+    // Beyond the cost limit the result is no longer minimal but must still be a valid diff.
+    void myersFineDiffCostLimit()
+    {
+        const MyersFineDiff myersFineDiff(3);
+        std::mt19937 random(2);
+
+        for(qint32 k = 0; k < 100; ++k)
+        {
+            const QString line1 = randomLine(random, 200, 4);
+            const QString line2 = randomLine(random, 200, 4);
+
+            DiffList diffList;
+            myersFineDiff.calcDiff(line1, line2, diffList);
+            QVERIFY(fitsLines(diffList, line1, line2, true));
+        }
+    }
+
+    void fineDiffEngineForLines()
+    {
+        const QString shortLine(100, QChar('a'));
+        const QString longLine(1000, QChar('a'));
+        const QString veryLongLine(5000, QChar('a'));
+
+        QVERIFY(dynamic_cast<const SearchFineDiff*>(&FineDiffEngine::forLines(shortLine, shortLine)) != nullptr);
+        QVERIFY(dynamic_cast<const BitParallelFineDiff*>(&FineDiffEngine::forLines(shortLine, longLine)) != nullptr);
+        QVERIFY(dynamic_cast<const MyersFineDiff*>(&FineDiffEngine::forLines(veryLongLine, shortLine)) != nullptr);
+    }
+};
+
+QTEST_MAIN(FineDiffTest);
+
+#include "FineDiffTest.moc"
@@ -0,0 +1,144 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <random>
+
+#include "../HistogramDiff.h"
+
+/*
+    Checks that the segments cover both inputs in order, that equal segments are equal and that
+    changed segments have no line in common.
+*/
+static bool segmentsFit(const QVector<HistogramDiff::Segment>& segments, const QVector<qint32>& lines1, const QVector<qint32>& lines2)
+{
+    qint32 pos1 = 0;
+    qint32 pos2 = 0;
+    for(const HistogramDiff::Segment& segment : segments)
+    {
+        if(segment.begin1 != pos1 || segment.begin2 != pos2)
+            return false;
+
+        if(segment.type == HistogramDiff::SegmentType::Equal)
+        {
+            if(segment.size1 != segment.size2)
+                return false;
+            for(qint32 i = 0; i < segment.size1; ++i)
+            {
+                if(lines1[pos1 + i] != lines2[pos2 + i])
+                    return false;
+            }
+        }
+        else if(segment.type == HistogramDiff::SegmentType::Changed)
+        {
+            for(qint32 i = pos1; i < pos1 + segment.size1; ++i)
+            {
+                for(qint32 j = pos2; j < pos2 + segment.size2; ++j)
+                {
+                    if(lines1[i] == lines2[j])
+                        return false;
+                }
+            }
+        }
+
+        pos1 += segment.size1;
+        pos2 += segment.size2;
+    }
+    return pos1 == lines1.size() && pos2 == lines2.size();
+}
+
+static QVector<qint32> randomLines(std::mt19937& random, qint32 nofLines, qint32 nofClasses)
+{
+    QVector<qint32> lines;
+    for(qint32 i = 0; i < nofLines; ++i)
+        lines.push_back(random() % nofClasses);
+    return lines;
+}
+
+class HistogramDiffTest : public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void histogramDiffSegments()
+    {
+        const QVector<qint32> lines1 = {0, 1, 2, 3};
+        const QVector<qint32> lines2 = {0, 2, 3, 4};
+        HistogramDiff histogramDiff(lines1, lines2, 5);
+        const QVector<HistogramDiff::Segment> segments = histogramDiff.run();
+
+        QCOMPARE(segments.size(), 4);
+        QVERIFY(segments[0].type == HistogramDiff::SegmentType::Equal);
+        QCOMPARE(segments[0].size1, 1);
+        QVERIFY(segments[1].type == HistogramDiff::SegmentType::Changed);
+        QCOMPARE(segments[1].size1, 1);
+        QCOMPARE(segments[1].size2, 0);
+        QVERIFY(segments[2].type == HistogramDiff::SegmentType::Equal);
+        QCOMPARE(segments[2].begin1, 2);
+        QCOMPARE(segments[2].begin2, 1);
+        QCOMPARE(segments[2].size1, 2);
+        QVERIFY(segments[3].type == HistogramDiff::SegmentType::Changed);
+        QCOMPARE(segments[3].size1, 0);
+        QCOMPARE(segments[3].size2, 1);
+        QVERIFY(segmentsFit(segments, lines1, lines2));
+    }
+
+    // Lines occurring too often to anchor on are left to another algorithm.
+    void histogramDiffUnresolved()
+    {
+        QVector<qint32> lines1 = {1};
+        QVector<qint32> lines2 = {3};
+        for(qint32 i = 0; i < 100; ++i)
+        {
+            lines1.push_back(0);
+            lines2.push_back(0);
+        }
+        lines1.push_back(2);
+        lines2.push_back(4);
+
+        HistogramDiff histogramDiff(lines1, lines2, 5);
+        const QVector<HistogramDiff::Segment> segments = histogramDiff.run();
+
+        QCOMPARE(segments.size(), 1);
+        QVERIFY(segments[0].type == HistogramDiff::SegmentType::Unresolved);
+        QVERIFY(segmentsFit(segments, lines1, lines2));
+    }
+
+    void histogramDiffRandomLines()
+    {
+        std::mt19937 random(3);
+
+        for(qint32 k = 0; k < 500; ++k)
+        {
+            const qint32 nofClasses = 1 + random() % 50;
+            const QVector<qint32> lines1 = randomLines(random, random() % 200, nofClasses);
+            QVector<qint32> lines2;
+            if(random() % 4 == 0)
+            {
+                lines2 = randomLines(random, random() % 200, nofClasses);
+            }
+            else
+            {
+                // Mostly the same lines with a few changes.
+                for(const qint32 line : lines1)
+                {
+                    if(random() % 8 != 0)
+                        lines2.push_back(line);
+                    if(random() % 8 == 0)
+                        lines2.push_back(random() % nofClasses);
+                }
+            }
+
+            HistogramDiff histogramDiff(lines1, lines2, nofClasses);
+            QVERIFY(segmentsFit(histogramDiff.run(), lines1, lines2));
+        }
+    }
+};
+
+QTEST_MAIN(HistogramDiffTest);
+
+#include "HistogramDiffTest.moc"
@@ -0,0 +1,67 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QTest>
+#include <QTextCodec>
+
+#include "../diff.h"
+#include "../options.h"
+#include "../progress.h"
+#include "TestInputFiles.h"
+
+class SourceDataTest : public QObject
+{
+    Q_OBJECT
+  private:
+    HiddenProgressDialog m_progressDialog;
+    TestInputFiles m_inputFiles;
+    QSharedPointer<Options> m_pOptions = QSharedPointer<Options>::create();
+
+    // The lines of data as the preprocessor gets them back in its own encoding.
+    QStringList preprocessedLines(const QByteArray& data)
+    {
+        SourceData sourceData;
+        if(!m_inputFiles.read(sourceData, data, m_pOptions))
+            return QStringList();
+
+        QStringList lines;
+        const QVector<LineData>* pLineData = sourceData.getLineDataForDisplay();
+        for(qint32 i = 0; i < sourceData.getSizeLines(); ++i)
+            lines.append((*pLineData)[i].getLine());
+        return lines;
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+#ifdef Q_OS_WIN
+        QSKIP("The preprocessor of these tests is cat.");
+#endif
+        // The input is converted from UTF-8 to the encoding of the preprocessor, which passes it on unchanged.
+        m_pOptions->m_PreProcessorCmd = QStringLiteral("cat");
+        m_pOptions->m_pEncodingPP = QTextCodec::codecForName("UTF-16LE");
+    }
+
+    // Characters the conversion for the preprocessor cuts at the end of a chunk are put together again.
+    void preprocessCharactersAtChunkEnd()
+    {
+        const QString umlaut = QStringLiteral("\u00e4");
+        const QString line = QString(64 * 1024 - 1, QLatin1Char('a')) + umlaut + umlaut;
+        QCOMPARE(preprocessedLines(line.toUtf8()), QStringList(line));
+    }
+
+    // A character the file ends within is replaced.
+    void preprocessCutCharacterAtEnd()
+    {
+        const QByteArray data = QByteArray("abc") + QStringLiteral("\u00e4").toUtf8().left(1);
+        QCOMPARE(preprocessedLines(data), QStringList(QStringLiteral("abc\ufffd")));
+    }
+};
+
+QTEST_MAIN(SourceDataTest);
+
+#include "SourceDataTest.moc"
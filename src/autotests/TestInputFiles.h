@@ -0,0 +1,56 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef TESTINPUTFILES_H
+#define TESTINPUTFILES_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QSharedPointer>
+#include <QString>
+#include <QTemporaryDir>
+#include <QTextCodec>
+
+#include "../options.h"
+#include "../SourceData.h"
+
+// Input files of the autotests in a temporary folder, read like files given on the command line.
+class TestInputFiles
+{
+  public:
+    // Returns the name of a new file with data, or an empty name if it couldn't be written.
+    QString write(const QByteArray& data)
+    {
+        QFile file(m_tempDir.path() + QStringLiteral("/input%1.txt").arg(++m_nofFiles));
+        if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+            return QString();
+        return file.fileName();
+    }
+
+    // Reads text into sourceData as UTF-8.
+    bool read(SourceData& sourceData, const QString& text, const QSharedPointer<Options>& pOptions)
+    {
+        return read(sourceData, text.toUtf8(), pOptions);
+    }
+
+    // Reads data into sourceData as UTF-8, also when it isn't valid UTF-8.
+    bool read(SourceData& sourceData, const QByteArray& data, const QSharedPointer<Options>& pOptions)
+    {
+        const QString fileName = write(data);
+        if(fileName.isEmpty())
+            return false;
+
+        sourceData.setOptions(pOptions);
+        sourceData.setFilename(fileName);
+        return sourceData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), false).isEmpty();
+    }
+
+  private:
+    QTemporaryDir m_tempDir;
+    qint32 m_nofFiles = 0;
+};
+
+#endif // !TESTINPUTFILES_H
@@ -169,6 +169,13 @@ class CommentParserTest : public QObject
         QVERIFY(!test.inComment());
         QVERIFY(!test.isPureComment());
 
+        test = DefaultCommentParser();
+        test.processLine("\"escaped quote \\\" // \" + x");
+        QVERIFY(!test.isEscaped());
+        QVERIFY(!test.inString());
+        QVERIFY(!test.inComment());
+        QVERIFY(!test.isPureComment());
+
         test = DefaultCommentParser();
         test.processChar("\"", '"');
         QVERIFY(!test.isEscaped());
@@ -0,0 +1,43 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#ifndef BENCHMARKDATA_H
+#define BENCHMARKDATA_H
+
+#include <QLatin1String>
+#include <QString>
+
+#include <random>
+
+/*
+    Generated input of the benchmarks. Only the raw output of std::mt19937 is used, which the
+    standard defines exactly, so a seed gives the same data on all platforms and the results can
+    be compared between releases.
+*/
+class BenchmarkData
+{
+  public:
+    static quint32 randomNumber(std::mt19937& random, quint32 range) { return random() % range; }
+
+    // Lines that look like code, so the fine diff has words to compare.
+    static QString generatedLine(std::mt19937& random, int minNofWords = 2, int maxNofWords = 11)
+    {
+        static const char* const words[] = {"int", "return", "value", "if", "for", "index", "m_pData", "size()",
+                                            "QString", "nullptr", "const", "++i", "=", "(", ")", ";", "//", "{", "}"};
+        const int nofWords = minNofWords + int(randomNumber(random, quint32(maxNofWords - minNofWords + 1)));
+
+        QString line = QString(4 * int(randomNumber(random, 4)), ' ');
+        for(int i = 0; i < nofWords; ++i)
+        {
+            if(i > 0)
+                line += ' ';
+            line += QLatin1String(words[randomNumber(random, quint32(sizeof(words) / sizeof(words[0])))]);
+        }
+        return line;
+    }
+};
+
+#endif // !BENCHMARKDATA_H
@@ -0,0 +1,310 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+/*
+    Measures the functions called for each line or character, which dominate the profiles. An
+    optimization of one of them should come with the numbers of this benchmark before and after.
+    Every row runs over many generated inputs of one kind, so not a single input is measured.
+*/
+
+#include <QPair>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QTest>
+#include <QVector>
+
+#include "BenchmarkData.h"
+
+#include "../CommentParser.h"
+#include "../cvsignorelist.h"
+#include "../diff.h"
+#include "../FineDiff.h"
+#include "../gnudiff_diff.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const int nofPairs = 1000;
+
+class KernelBenchmark : public QObject
+{
+    Q_OBJECT
+  private:
+    enum e_PairKind
+    {
+        eEqual,
+        eWhiteSpace, // Differ only in white space
+        eChanged
+    };
+
+    // Changes about one in twenty characters, but one at least.
+    static QString editedLine(const QString& line, std::mt19937& random)
+    {
+        QString edited = line;
+        for(QChar& c: edited)
+        {
+            if(BenchmarkData::randomNumber(random, 20) == 0)
+                c = '#';
+        }
+        if(edited == line)
+            edited[edited.size() / 2] = '#';
+        return edited;
+    }
+
+    static QVector<QPair<QString, QString>> linePairs(int kind, int nofWords, int count, quint32 seed)
+    {
+        std::mt19937 random(seed);
+        QVector<QPair<QString, QString>> pairs;
+        pairs.reserve(count);
+        for(int i = 0; i < count; ++i)
+        {
+            const QString line = BenchmarkData::generatedLine(random, nofWords, nofWords);
+            // A copy of its own, as the lines of two files have.
+            QString other(line.constData(), line.size());
+            if(kind == eWhiteSpace)
+                other.replace(' ', QLatin1String(" \t "));
+            else if(kind == eChanged)
+                other = editedLine(line, random);
+            pairs.append(qMakePair(line, other));
+        }
+        return pairs;
+    }
+
+    // Line data don't keep their text alive, it is added to chunks.
+    static LineData lineDataOf(const QString& line, QVector<QSharedPointer<TextChunk>>& chunks)
+    {
+        int firstNonWhiteChar = 0;
+        while(firstNonWhiteChar < line.size() && line[firstNonWhiteChar].isSpace())
+            ++firstNonWhiteChar;
+        // Compacted as SourceData keeps the generated ASCII lines, so the 8-bit kernels are measured.
+        const QSharedPointer<TextChunk> pChunk = QSharedPointer<TextChunk>::create(line);
+        pChunk->compact();
+        chunks.append(pChunk);
+        return LineData(pChunk.data(), 0, line.size(), firstNonWhiteChar);
+    }
+
+    static void addLinePairRows()
+    {
+        QTest::addColumn<int>("kind");
+        QTest::addColumn<int>("nofWords");
+        QTest::newRow("short equal") << (int)eEqual << 8;
+        QTest::newRow("short white space") << (int)eWhiteSpace << 8;
+        QTest::newRow("short changed") << (int)eChanged << 8;
+        QTest::newRow("long equal") << (int)eEqual << 300;
+        QTest::newRow("long white space") << (int)eWhiteSpace << 300;
+        QTest::newRow("long changed") << (int)eChanged << 300;
+    }
+
+    static QString generatedText(int nofLines, quint32 seed)
+    {
+        std::mt19937 random(seed);
+        QString text;
+        for(int i = 0; i < nofLines; ++i)
+        {
+            text += BenchmarkData::generatedLine(random);
+            text += '\n';
+        }
+        return text;
+    }
+
+  private Q_SLOTS:
+    // Only the white space ignoring comparison is built, see g_bIgnoreWhiteSpace.
+    void lineDataEqual_data() { addLinePairRows(); }
+    void lineDataEqual()
+    {
+        QFETCH(int, kind);
+        QFETCH(int, nofWords);
+        QVector<QSharedPointer<TextChunk>> chunks;
+        QVector<LineData> lines1, lines2;
+        for(const QPair<QString, QString>& pair: linePairs(kind, nofWords, nofPairs, quint32(kind * 1000 + nofWords)))
+        {
+            lines1.append(lineDataOf(pair.first, chunks));
+            lines2.append(lineDataOf(pair.second, chunks));
+        }
+
+        int nofEqual = 0;
+        QBENCHMARK
+        {
+            nofEqual = 0;
+            for(int i = 0; i < nofPairs; ++i)
+                nofEqual += LineData::equal(lines1[i], lines2[i]) ? 1 : 0;
+        }
+        QCOMPARE(nofEqual, kind == eChanged ? 0 : nofPairs);
+    }
+
+    // With the settings of kdiff3, see gnuDiffForThread().
+    void linesDiffer_data() { addLinePairRows(); }
+    void linesDiffer()
+    {
+        QFETCH(int, kind);
+        QFETCH(int, nofWords);
+        const QVector<QPair<QString, QString>> pairs = linePairs(kind, nofWords, nofPairs, quint32(kind * 1000 + nofWords));
+        GnuDiff gnuDiff;
+        gnuDiff.ignore_white_space = GnuDiff::IGNORE_ALL_SPACE;
+        gnuDiff.bIgnoreWhiteSpace = true;
+
+        int nofDiffering = 0;
+        QBENCHMARK
+        {
+            nofDiffering = 0;
+            for(const QPair<QString, QString>& pair: pairs)
+            {
+                if(gnuDiff.lines_differ(pair.first.constData(), pair.first.size(), pair.second.constData(), pair.second.size()))
+                    ++nofDiffering;
+            }
+        }
+        QCOMPARE(nofDiffering, kind == eChanged ? nofPairs : 0);
+    }
+
+    // find_and_hash_each_line() is private, read_files() calls it for both files after find_identical_ends().
+    void findAndHashEachLine_data()
+    {
+        QTest::addColumn<int>("nofLines");
+        QTest::newRow("1000 lines") << 1000;
+        QTest::newRow("100000 lines") << 100000;
+    }
+    void findAndHashEachLine()
+    {
+        QFETCH(int, nofLines);
+        const QString text1 = generatedText(nofLines, quint32(nofLines));
+        // Different first and last lines, so that no identical ends are left out.
+        const QString text2 = QLatin1String("first\n") + text1.mid(text1.indexOf('\n') + 1) + QLatin1String("last\n");
+        GnuDiff gnuDiff;
+        gnuDiff.ignore_white_space = GnuDiff::IGNORE_ALL_SPACE;
+        gnuDiff.bIgnoreWhiteSpace = true;
+
+        QBENCHMARK
+        {
+            GnuDiff::file_data files[2];
+            memset(files, 0, sizeof(files));
+            // Without the last newline as in DiffList::runGnuDiff().
+            files[0].buffer = text1.constData();
+            files[0].buffered = text1.size() - 1;
+            files[1].buffer = text2.constData();
+            files[1].buffered = text2.size() - 1;
+            gnuDiff.read_files(files, false);
+
+            // As diff_2_files() does.
+            for(int f = 0; f < 2; ++f)
+            {
+                free(files[f].equivs);
+                free(files[f].linbuf + files[f].linbuf_base);
+            }
+        }
+    }
+
+    // The engine FineDiffEngine::forLines() chooses.
+    void calcDiff_data()
+    {
+        QTest::addColumn<int>("nofWords");
+        QTest::addColumn<int>("count");
+        QTest::newRow("short lines") << 8 << nofPairs;
+        QTest::newRow("long lines") << 80 << 100;
+        QTest::newRow("minified line") << 3000 << 1;
+    }
+    void calcDiff()
+    {
+        QFETCH(int, nofWords);
+        QFETCH(int, count);
+        const QVector<QPair<QString, QString>> pairs = linePairs(eChanged, nofWords, count, quint32(nofWords));
+
+        QBENCHMARK
+        {
+            for(const QPair<QString, QString>& pair: pairs)
+            {
+                DiffList diffList;
+                FineDiffEngine::forLines(pair.first, pair.second).calcDiff(pair.first, pair.second, diffList);
+            }
+        }
+    }
+
+    void commentParserProcessLine()
+    {
+        static const char* const codeLines[] = {"int value = 0; // counts the lines", "/* a comment", "   that goes on */ return value;",
+                                                "QString s = \"// not a comment\";", "    ++i;", "// only a comment", "char c = '\\'';",
+                                                "    if(value > 0) { /* short */ value--; }"};
+        std::mt19937 random(1);
+        QStringList lines;
+        for(int i = 0; i < 10000; ++i)
+            lines.append(QLatin1String(codeLines[BenchmarkData::randomNumber(random, quint32(sizeof(codeLines) / sizeof(codeLines[0])))]));
+
+        int nofPureComments = 0;
+        QBENCHMARK
+        {
+            // One parser for all lines of a file, as in SourceData.
+            DefaultCommentParser parser;
+            nofPureComments = 0;
+            for(const QString& line: lines)
+            {
+                parser.processLine(line);
+                nofPureComments += parser.isPureComment() ? 1 : 0;
+            }
+        }
+        QVERIFY(nofPureComments > 0);
+    }
+
+    void cvsIgnoreListMatches_data()
+    {
+        QTest::addColumn<bool>("bCaseSensitive");
+        QTest::newRow("case sensitive") << true;
+        QTest::newRow("case insensitive") << false;
+    }
+    void cvsIgnoreListMatches()
+    {
+        QFETCH(bool, bCaseSensitive);
+        static const char* const suffixes[] = {".cpp", ".h", ".o", ".orig", "~", ".txt", ".bak", ""};
+        std::mt19937 random(2);
+        QStringList names;
+        for(int i = 0; i < 10000; ++i)
+            names.append(QStringLiteral("file%1").arg(i) + QLatin1String(suffixes[BenchmarkData::randomNumber(random, quint32(sizeof(suffixes) / sizeof(suffixes[0])))]));
+        names.append(QStringLiteral("CVS"));
+
+        // The default patterns of init(), without the ones of the user.
+        CvsIgnoreList ignoreList;
+        ignoreList.addEntriesFromString(QString::fromLatin1(". .. core RCSLOG tags TAGS RCS SCCS .make.state "
+                                                            ".nse_depinfo #* .#* cvslog.* ,* CVS CVS.adm .del-* *.a *.olb *.o *.obj "
+                                                            "*.so *.Z *~ *.old *.elc *.ln *.bak *.BAK *.orig *.rej *.exe _$* *$"));
+
+        int nofMatches = 0;
+        QBENCHMARK
+        {
+            nofMatches = 0;
+            for(const QString& name: names)
+                nofMatches += ignoreList.matches(name, bCaseSensitive) ? 1 : 0;
+        }
+        QVERIFY(nofMatches > 0);
+    }
+
+    void lineDataWidth_data()
+    {
+        QTest::addColumn<QString>("indentation");
+        QTest::newRow("spaces") << QString();
+        QTest::newRow("tabs") << QStringLiteral("\t\t");
+    }
+    void lineDataWidth()
+    {
+        QFETCH(QString, indentation);
+        std::mt19937 random(3);
+        QVector<QSharedPointer<TextChunk>> chunks;
+        QVector<LineData> lines;
+        for(int i = 0; i < nofPairs; ++i)
+            lines.append(lineDataOf(indentation + BenchmarkData::generatedLine(random), chunks));
+
+        int width = 0;
+        QBENCHMARK
+        {
+            width = 0;
+            for(const LineData& line: lines)
+                width += line.width(8);
+        }
+        QVERIFY(width > 0);
+    }
+};
+
+QTEST_MAIN(KernelBenchmark);
+
+#include "KernelBenchmark.moc"
@@ -0,0 +1,333 @@
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+/*
+    Measures the phases of a three way merge one by one, headless, on generated files of several
+    sizes and edit densities. Every phase gets the results of the previous ones prepared outside
+    of the measurement.
+
+    The files are made with fixed seeds by BenchmarkData, so the same rows hold the same files on
+    all platforms. For a machine readable log run "kdiff3_bench -o results.xml,xml" or
+    "kdiff3_bench -csv".
+*/
+
+#include <QFile>
+#include <QMap>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTextCodec>
+#include <QTextStream>
+
+#include "BenchmarkData.h"
+
+#include "../diff.h"
+#include "../fileaccess.h"
+#include "../MergeEditLine.h"
+#include "../options.h"
+#include "../progress.h"
+#include "../SourceData.h"
+
+namespace {
+
+struct Corpus
+{
+    QString fileA;
+    QString fileB;
+    QString fileC;
+};
+
+// The results of the phases, each phase prepares the ones before it.
+struct Comparison
+{
+    QSharedPointer<SourceData> sdA = QSharedPointer<SourceData>::create();
+    QSharedPointer<SourceData> sdB = QSharedPointer<SourceData>::create();
+    QSharedPointer<SourceData> sdC = QSharedPointer<SourceData>::create();
+    ManualDiffHelpList manualDiffHelpList;
+    DiffList diffList12;
+    DiffList diffList13;
+    DiffList diffList23;
+    Diff3LineList diff3LineList;
+};
+
+} // namespace
+
+class PhaseBenchmark : public QObject
+{
+    Q_OBJECT
+  private:
+    QTemporaryDir m_dir;
+    QSharedPointer<Options> m_pOptions;
+    QMap<QString, Corpus> m_corpora;
+    QStringList m_corpusNames; // In the order they were made
+
+    // Changes, removes or inserts a line at about editDensity of the lines of base.
+    static QStringList editedLines(const QStringList& base, double editDensity, quint32 seed)
+    {
+        std::mt19937 random(seed);
+        const quint32 editLimit = quint32(editDensity * 1000);
+
+        QStringList lines;
+        lines.reserve(base.size());
+        for(const QString& line: base)
+        {
+            if(BenchmarkData::randomNumber(random, 1000) >= editLimit)
+            {
+                lines.append(line);
+                continue;
+            }
+
+            switch(BenchmarkData::randomNumber(random, 3))
+            {
+                case 0:
+                    lines.append(line + QLatin1String(" + 1"));
+                    break;
+                case 1:
+                    break;
+                default:
+                    lines.append(BenchmarkData::generatedLine(random));
+                    lines.append(line);
+                    break;
+            }
+        }
+        return lines;
+    }
+
+    static bool writeLines(const QString& fileName, const QStringList& lines)
+    {
+        QFile file(fileName);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+
+        QTextStream stream(&file);
+        stream.setCodec("UTF-8");
+        for(const QString& line: lines)
+            stream << line << '\n';
+        stream.flush();
+        return stream.status() == QTextStream::Ok;
+    }
+
+    void addCorpus(int nofLines, double editDensity)
+    {
+        std::mt19937 random(quint32(nofLines));
+        QStringList base;
+        base.reserve(nofLines);
+        for(int i = 0; i < nofLines; ++i)
+            base.append(BenchmarkData::generatedLine(random));
+
+        const QString name = QStringLiteral("%1 lines, %2% edited").arg(nofLines).arg(editDensity * 100);
+        const QString prefix = m_dir.filePath(QStringLiteral("%1_%2_").arg(nofLines).arg(int(editDensity * 1000)));
+        Corpus corpus;
+        corpus.fileA = prefix + QLatin1String("A.txt");
+        corpus.fileB = prefix + QLatin1String("B.txt");
+        corpus.fileC = prefix + QLatin1String("C.txt");
+        QVERIFY(writeLines(corpus.fileA, base));
+        QVERIFY(writeLines(corpus.fileB, editedLines(base, editDensity, 2 * quint32(nofLines) + 1)));
+        QVERIFY(writeLines(corpus.fileC, editedLines(base, editDensity, 2 * quint32(nofLines) + 2)));
+        m_corpora.insert(name, corpus);
+        m_corpusNames.append(name);
+    }
+
+    void addCorpusRows()
+    {
+        QTest::addColumn<QString>("corpus");
+        for(const QString& name: m_corpusNames)
+            QTest::newRow(name.toLatin1().constData()) << name;
+    }
+
+    void load(const Corpus& corpus, Comparison& comparison)
+    {
+        const QSharedPointer<SourceData> sources[] = {comparison.sdA, comparison.sdB, comparison.sdC};
+        const QString files[] = {corpus.fileA, corpus.fileB, corpus.fileC};
+        QTextCodec* const encodings[] = {m_pOptions->m_pEncodingA, m_pOptions->m_pEncodingB, m_pOptions->m_pEncodingC};
+        for(int i = 0; i < 3; ++i)
+        {
+            sources[i]->setOptions(m_pOptions);
+            sources[i]->setFilename(files[i]);
+            QVERIFY(sources[i]->readAndPreprocess(encodings[i], false).isEmpty());
+        }
+    }
+
+    void runDiffFor(const QSharedPointer<SourceData>& sd1, const QSharedPointer<SourceData>& sd2, e_SrcSelector winIdx1, e_SrcSelector winIdx2,
+                    ManualDiffHelpList& manualDiffHelpList, DiffList& diffList)
+    {
+        manualDiffHelpList.runDiff(sd1->getNormalizedLineDataForDiff(false), sd1->getSizeLines(), sd2->getNormalizedLineDataForDiff(false), sd2->getSizeLines(), diffList,
+                                   winIdx1, winIdx2, m_pOptions, sd1->getLineHashesForDiff(false), sd2->getLineHashesForDiff(false));
+    }
+
+    void runDiffs(Comparison& c)
+    {
+        runDiffFor(c.sdA, c.sdB, e_SrcSelector::A, e_SrcSelector::B, c.manualDiffHelpList, c.diffList12);
+        runDiffFor(c.sdA, c.sdC, e_SrcSelector::A, e_SrcSelector::C, c.manualDiffHelpList, c.diffList13);
+        runDiffFor(c.sdB, c.sdC, e_SrcSelector::B, e_SrcSelector::C, c.manualDiffHelpList, c.diffList23);
+    }
+
+    static void buildDiff3LineList(Comparison& c, Diff3LineList& diff3LineList)
+    {
+        diff3LineList.calcDiff3LineListUsingAB(&c.diffList12);
+        diff3LineList.calcDiff3LineListUsingAC(&c.diffList13);
+        diff3LineList.calcDiff3LineListTrim(c.sdA->getLineDataForDiff(), c.sdB->getLineDataForDiff(), c.sdC->getLineDataForDiff(), &c.manualDiffHelpList);
+    }
+
+    static void fineDiffs(Comparison& c)
+    {
+        c.diff3LineList.fineDiff(e_SrcSelector::A, c.sdA->getLineDataForDisplay(), c.sdB->getLineDataForDisplay());
+        c.diff3LineList.fineDiff(e_SrcSelector::B, c.sdB->getLineDataForDisplay(), c.sdC->getLineDataForDisplay());
+        c.diff3LineList.fineDiff(e_SrcSelector::C, c.sdC->getLineDataForDisplay(), c.sdA->getLineDataForDisplay());
+    }
+
+    // All phases up to the merge.
+    void compare(const Corpus& corpus, Comparison& c)
+    {
+        load(corpus, c);
+        runDiffs(c);
+        buildDiff3LineList(c, c.diff3LineList);
+        fineDiffs(c);
+        c.diff3LineList.calcWhiteDiff3Lines(c.sdA->getLineDataForDiff(), c.sdB->getLineDataForDiff(), c.sdC->getLineDataForDiff());
+    }
+
+    void buildMergeLines(MergeLineList& mergeLineList, const Comparison& c)
+    {
+        mergeLineList.build(c.diff3LineList, false);
+        const e_SrcSelector whiteSpaceMergeDefault = MergeLineList::whiteSpaceMergeDefault(m_pOptions, false);
+        if(whiteSpaceMergeDefault != e_SrcSelector::None)
+            mergeLineList.chooseDeltas(whiteSpaceMergeDefault, false, true);
+        mergeLineList.removeEmptyEditLines();
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+
+        // Needed before any file operations via FileAccess happen.
+        g_pProgressDialog = new ProgressDialog(nullptr, nullptr);
+        g_pProgressDialog->setStayHidden(true);
+
+        // The defaults of the option dialog, the settings of the user don't matter.
+        m_pOptions = QSharedPointer<Options>::create();
+        QTextCodec* pUtf8 = QTextCodec::codecForName("UTF-8");
+        m_pOptions->m_pEncodingA = pUtf8;
+        m_pOptions->m_pEncodingB = pUtf8;
+        m_pOptions->m_pEncodingC = pUtf8;
+        m_pOptions->m_pEncodingOut = pUtf8;
+        m_pOptions->m_pEncodingPP = pUtf8;
+        m_pOptions->m_bDmCreateBakFiles = false;
+
+        const int sizes[] = {1000, 10000, 100000};
+        const double editDensities[] = {0.01, 0.1};
+        for(const int nofLines: sizes)
+        {
+            for(const double editDensity: editDensities)
+                addCorpus(nofLines, editDensity);
+        }
+    }
+
+    void cleanupTestCase()
+    {
+        delete g_pProgressDialog;
+        g_pProgressDialog = nullptr;
+    }
+
+    void readAndPreprocess_data() { addCorpusRows(); }
+    void readAndPreprocess()
+    {
+        QFETCH(QString, corpus);
+        const Corpus& files = m_corpora[corpus];
+
+        QBENCHMARK
+        {
+            Comparison c;
+            load(files, c);
+        }
+    }
+
+    void runDiff_data() { addCorpusRows(); }
+    void runDiff()
+    {
+        QFETCH(QString, corpus);
+        Comparison c;
+        load(m_corpora[corpus], c);
+
+        QBENCHMARK
+        {
+            ManualDiffHelpList manualDiffHelpList;
+            DiffList diffList12, diffList13, diffList23;
+            runDiffFor(c.sdA, c.sdB, e_SrcSelector::A, e_SrcSelector::B, manualDiffHelpList, diffList12);
+            runDiffFor(c.sdA, c.sdC, e_SrcSelector::A, e_SrcSelector::C, manualDiffHelpList, diffList13);
+            runDiffFor(c.sdB, c.sdC, e_SrcSelector::B, e_SrcSelector::C, manualDiffHelpList, diffList23);
+        }
+    }
+
+    void calcDiff3LineList_data() { addCorpusRows(); }
+    void calcDiff3LineList()
+    {
+        QFETCH(QString, corpus);
+        Comparison c;
+        load(m_corpora[corpus], c);
+        runDiffs(c);
+
+        QBENCHMARK
+        {
+            Diff3LineList diff3LineList;
+            buildDiff3LineList(c, diff3LineList);
+        }
+    }
+
+    // From 100000 lines on only the lines are compared, the fine diffs are computed when shown.
+    void fineDiff_data() { addCorpusRows(); }
+    void fineDiff()
+    {
+        QFETCH(QString, corpus);
+        Comparison c;
+        load(m_corpora[corpus], c);
+        runDiffs(c);
+        buildDiff3LineList(c, c.diff3LineList);
+
+        // The fine diffs of the last run are replaced.
+        QBENCHMARK
+        {
+            fineDiffs(c);
+        }
+    }
+
+    void merge_data() { addCorpusRows(); }
+    void merge()
+    {
+        QFETCH(QString, corpus);
+        Comparison c;
+        compare(m_corpora[corpus], c);
+
+        QBENCHMARK
+        {
+            MergeLineList mergeLineList;
+            buildMergeLines(mergeLineList, c);
+        }
+    }
+
+    void saveDocument_data() { addCorpusRows(); }
+    void saveDocument()
+    {
+        QFETCH(QString, corpus);
+        Comparison c;
+        compare(m_corpora[corpus], c);
+        MergeLineList mergeLineList;
+        buildMergeLines(mergeLineList, c);
+
+        FileAccess output(m_dir.filePath(QStringLiteral("output.txt")), true /*bWantToWrite*/);
+        QBENCHMARK
+        {
+            QVERIFY(mergeLineList.writeFile(output, m_pOptions->m_pEncodingOut, eLineEndStyleUnix, c.sdA->getLineDataForDisplay(),
+                                            c.sdB->getLineDataForDisplay(), c.sdC->getLineDataForDisplay()));
+        }
+    }
+};
+
+QTEST_MAIN(PhaseBenchmark);
+
+#include "PhaseBenchmark.moc"
@@ -77,6 +77,7 @@ void CvsIgnoreList::addEntriesFromFile(const QString& name)
 
 void CvsIgnoreList::addEntry(const QString& pattern)
 {
+    m_bMatcherValid = false;
     if(pattern != QString("!"))
     {
         if(pattern.isEmpty()) return;
@@ -133,37 +134,14 @@ void CvsIgnoreList::addEntry(const QString& pattern)
 
 bool CvsIgnoreList::matches(const QString& text, bool bCaseSensitive) const
 {
-    QRegExp regexp(text, bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-    if(m_exactPatterns.indexOf(regexp) >= 0)
+    if(!m_bMatcherValid || m_bMatcherCaseSensitive != bCaseSensitive)
     {
-        return true;
+        m_matcher = WildcardMatcher(m_exactPatterns, m_startPatterns, m_endPatterns, m_generalPatterns, bCaseSensitive);
+        m_bMatcherValid = true;
+        m_bMatcherCaseSensitive = bCaseSensitive;
     }
 
-
-    for(const QString& startPattern: m_startPatterns)
-    {
-        if(text.startsWith(startPattern, bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive))
-        {
-            return true;
-        }
-    }
-
-    for(const QString& endPattern: m_endPatterns)
-    {
-        if(text.endsWith(endPattern, bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive))
-        {
-            return true;
-        }
-    }
-
-    for(const QString& globStr : m_generalPatterns)
-    {
-        QRegExp pattern(globStr, bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive, QRegExp::Wildcard);
-        if(pattern.exactMatch(text))
-            return true;
-    }
-
-    return false;
+    return m_matcher.matches(text);
 }
 
 bool CvsIgnoreList::cvsIgnoreExists(const t_DirectoryList* pDirList)
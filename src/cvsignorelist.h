@@ -17,6 +17,7 @@
 #else
 #include "MocIgnoreFile.h"
 #endif
+#include "WildcardMatcher.h"
 
 #include <QString>
 #include <QStringList>
@@ -30,6 +31,7 @@ class CvsIgnoreList
 
   private:
     friend class CvsIgnoreListTest;
+    friend class KernelBenchmark;
     bool cvsIgnoreExists(const t_DirectoryList* pDirList);
 
     void addEntriesFromString(const QString& str);
@@ -40,6 +42,11 @@ class CvsIgnoreList
     QStringList m_startPatterns;
     QStringList m_endPatterns;
     QStringList m_generalPatterns;
+
+    // Compiled from the lists above on the first match after a change.
+    mutable WildcardMatcher m_matcher;
+    mutable bool m_bMatcherValid = false;
+    mutable bool m_bMatcherCaseSensitive = true;
 };
 
 #endif
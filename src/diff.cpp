@@ -8,30 +8,59 @@
 
 #include "diff.h"
 
+#include "FineDiff.h"
 #include "gnudiff_diff.h"
+#include "HistogramDiff.h"
+#include "MemoryUsage.h"
 #include "merger.h"
 #include "options.h"
 #include "progress.h"
+#include "Tracing.h"
+#include "Utils.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <ctype.h>
+#include <vector>
 
 #include <KLocalizedString>
 #include <KMessageBox>
 
 #include <QtGlobal>
+#include <QHash>
+#include <QMultiHash>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QSemaphore>
 #include <QSharedPointer>
+#include <QThreadPool>
 
 constexpr bool g_bIgnoreWhiteSpace = true;
 
-QSharedPointer<DiffBufferInfo> Diff3Line::m_pDiffBufferInfo = nullptr;
+LineDataSnapshot::LineDataSnapshot(const QVector<LineData>& lines): m_lines(lines)
+{
+    // Lines of one chunk follow each other, there are only a few chunks.
+    const TextChunk* pLastChunk = nullptr;
+    for(const LineData& line: lines)
+    {
+        if(line.getBuffer() == pLastChunk || line.getBuffer() == nullptr)
+            continue;
 
-int LineData::width(int tabSize) const
+        pLastChunk = line.getBuffer();
+        const QSharedPointer<const TextChunk> pChunk = pLastChunk->sharedFromThis();
+        if(!m_chunks.contains(pChunk))
+            m_chunks.append(pChunk);
+    }
+}
+
+template <typename Char>
+static int widthOf(const Char* pLine, int size, int tabSize)
 {
-    QString pLine = getLine();
     int w = 0;
     int j = 0;
-    for(int i = 0; i < size(); ++i)
+    for(int i = 0; i < size; ++i)
     {
         if(pLine[i] == '\t')
         {
@@ -48,41 +77,82 @@ int LineData::width(int tabSize) const
     return w;
 }
 
-/*
-    Implement support for g_bIgnoreWhiteSpace
-*/
-bool LineData::equal(const LineData& l1, const LineData& l2)
+int LineData::width(int tabSize) const
 {
-    if(l1.getLine() == nullptr || l2.getLine() == nullptr) return false;
+    return isLatin1() ? widthOf(latin1(), size(), tabSize) : widthOf(utf16(), size(), tabSize);
+}
 
-    if(g_bIgnoreWhiteSpace)
+template <typename Char1, typename Char2>
+static bool equalIgnoringWhiteSpace(const Char1* p1, const Char1* p1End, const Char2* p2, const Char2* p2End)
+{
+    for(;;)
     {
-        // Ignore white space diff
-        QString::const_iterator p1 = l1.getLine().begin();
-        QString::const_iterator p1End = l1.getLine().end();
-        QString::const_iterator p2 = l2.getLine().begin();
-        QString::const_iterator p2End = l2.getLine().end();
+        const qint64 nofEquals = Utils::commonPrefixLength(p1, p2, std::min<qint64>(p1End - p1, p2End - p2));
+        p1 += nofEquals;
+        p2 += nofEquals;
 
-        for(; p1 != p1End && p2 != p2End; p1++, p2++)
-        {
-            while(isWhite(*p1) && p1 != p1End) ++p1;
-            while(isWhite(*p2) && p2 != p2End) ++p2;
+        while(p1 != p1End && isWhite(Utils::toQChar(*p1))) ++p1;
+        while(p2 != p2End && isWhite(Utils::toQChar(*p2))) ++p2;
 
-            if(*p1 != *p2)
-                return false;
-        }
+        if(p1 == p1End || p2 == p2End)
+            return (p1 == p1End && p2 == p2End);
 
-        return (p1 == p1End && p2 == p2End);
+        if(Utils::toQChar(*p1) != Utils::toQChar(*p2))
+            return false;
+
+        ++p1;
+        ++p2;
     }
-    else
+}
+
+/*
+    Implement support for g_bIgnoreWhiteSpace
+*/
+bool LineData::equal(const LineData& l1, const LineData& l2)
+{
+    // getLine() copies Latin-1 text, only empty lines can compare equal to nullptr.
+    if((l1.size() == 0 && l1.getLine() == nullptr) || (l2.size() == 0 && l2.getLine() == nullptr)) return false;
+
+    if(!g_bIgnoreWhiteSpace)
+        return sameText(l1, l2);
+
+    // Ignore white space diff
+    if(l1.isLatin1())
     {
-        return (l1.size() == l2.size() && QString::compare(l1.getLine(), l2.getLine()) == 0);
+        if(l2.isLatin1())
+            return equalIgnoringWhiteSpace(l1.latin1(), l1.latin1() + l1.size(), l2.latin1(), l2.latin1() + l2.size());
+        return equalIgnoringWhiteSpace(l1.latin1(), l1.latin1() + l1.size(), l2.utf16(), l2.utf16() + l2.size());
     }
+    if(l2.isLatin1())
+        return equalIgnoringWhiteSpace(l1.utf16(), l1.utf16() + l1.size(), l2.latin1(), l2.latin1() + l2.size());
+    return equalIgnoringWhiteSpace(l1.utf16(), l1.utf16() + l1.size(), l2.utf16(), l2.utf16() + l2.size());
+}
+
+bool LineData::sameText(const LineData& l1, const LineData& l2)
+{
+    if(l1.size() != l2.size())
+        return false;
+    // The same text, e.g. of inputs that share their data.
+    if(l1.getBuffer() == l2.getBuffer() && l1.getOffset() == l2.getOffset())
+        return true;
+
+    qint64 nofEquals;
+    if(l1.isLatin1())
+        nofEquals = l2.isLatin1() ? Utils::commonPrefixLength(l1.latin1(), l2.latin1(), l1.size()) : Utils::commonPrefixLength(l1.latin1(), l2.utf16(), l1.size());
+    else
+        nofEquals = l2.isLatin1() ? Utils::commonPrefixLength(l1.utf16(), l2.latin1(), l1.size()) : Utils::commonPrefixLength(l1.utf16(), l2.utf16(), l1.size());
+    return nofEquals == l1.size();
+}
+
+size_t LineData::hash(bool bIgnoreNumbers) const
+{
+    return isLatin1() ? GnuDiff::line_hash(latin1(), size(), bIgnoreNumbers) : GnuDiff::line_hash(utf16(), size(), bIgnoreNumbers);
 }
 
 // First step
 void Diff3LineList::calcDiff3LineListUsingAB(const DiffList* pDiffListAB)
 {
+    TraceSpan span("calcDiff3LineListUsingAB", pDiffListAB->size());
     // First make d3ll for AB (from pDiffListAB)
 
     DiffList::const_iterator i = pDiffListAB->begin();
@@ -147,6 +217,7 @@ void Diff3LineList::calcDiff3LineListUsingAB(const DiffList* pDiffListAB)
 // Second step
 void Diff3LineList::calcDiff3LineListUsingAC(const DiffList* pDiffListAC)
 {
+    TraceSpan span("calcDiff3LineListUsingAC", pDiffListAC->size());
     ////////////////
     // Now insert data from C using pDiffListAC
 
@@ -209,9 +280,109 @@ void Diff3LineList::calcDiff3LineListUsingAC(const DiffList* pDiffListAC)
     }
 }
 
+namespace {
+// A Diff3Line that holds a line, with its place in the list. See LineLocations.
+struct LineItem
+{
+    qint64 key;
+    Diff3LineList::iterator it;
+};
+
+static bool lessKey(const LineItem& item1, const LineItem& item2)
+{
+    return item1.key < item2.key;
+}
+
+/*
+    Where the lines of one input are while calcDiff3LineListUsingBC() runs. The key of a Diff3Line
+    is twice its index in the list before anything was inserted, an odd key stands for a Diff3Line
+    inserted before the one with the next higher key. Lines are only moved before the positions
+    the step works on, so the lines not handled yet keep their keys and a window of the list is a
+    range of keys.
+    A taken line was moved out of sight, before the windows still to come.
+*/
+class LineLocations
+{
+  public:
+    LineLocations(const std::vector<Diff3LineList::iterator>& d3lines, LineRef (Diff3Line::*pGetLine)() const)
+    {
+        for(size_t i = 0; i < d3lines.size(); ++i)
+        {
+            if(((*d3lines[i]).*pGetLine)().isValid())
+            {
+                Q_ASSERT(((*d3lines[i]).*pGetLine)() == (LineRef::LineType)m_items.size());
+                m_items.push_back(LineItem{2 * (qint64)i, d3lines[i]});
+            }
+        }
+    }
+
+    inline qint64 key(const LineRef::LineType line) const { return m_items[line].key; }
+    inline Diff3LineList::iterator item(const LineRef::LineType line) const { return m_items[line].it; }
+    inline void setItem(const LineRef::LineType line, const Diff3LineList::iterator it, const qint64 key) { m_items[line] = LineItem{key, it}; }
+
+    // Called for the lines in order, once a line is handled.
+    void handled(const LineRef::LineType line, const bool bTaken)
+    {
+        if(bTaken)
+            m_items[line].key = -1;
+        else
+            m_lastUntaken = line;
+    }
+
+    // If a line handled and not taken is in a Diff3Line at key or after it.
+    bool hasUntakenFrom(const qint64 key) { return m_lastUntaken >= firstLineFrom(key); }
+
+    // Takes the lines not taken yet in the Diff3Lines from key up to before endKey.
+    void take(const qint64 key, const qint64 endKey, std::vector<LineItem>& items)
+    {
+        for(LineRef::LineType line = firstLineFrom(key); line < (LineRef::LineType)m_items.size() && m_items[line].key < endKey; ++line)
+        {
+            items.push_back(m_items[line]);
+            m_items[line].key = -1;
+        }
+        m_lastUntaken = -1;
+    }
+
+  private:
+    /*
+        The first line not taken whose key isn't lower. The keys asked for never decrease, the lower
+        lines not taken stay behind the windows still to come.
+    */
+    LineRef::LineType firstLineFrom(const qint64 key)
+    {
+        while(m_firstLine < (LineRef::LineType)m_items.size() && m_items[m_firstLine].key < key)
+            ++m_firstLine;
+        return m_firstLine;
+    }
+
+    std::vector<LineItem> m_items;
+    LineRef::LineType m_firstLine = 0;
+    LineRef::LineType m_lastUntaken = -1;
+};
+
+/*
+    Takes the lines of A to move along with the disturbing lines between key and lastEqualKey, the
+    last Diff3Line where A equals the other input. The result is in the order of the list.
+*/
+static void movedLines(const std::vector<LineItem>& disturbing, LineLocations& linesA, const qint64 key, const qint64 lastEqualKey, std::vector<LineItem>& items)
+{
+    std::vector<LineItem> itemsA;
+    linesA.take(key, lastEqualKey + 1, itemsA);
+
+    std::vector<LineItem> merged(disturbing.size() + itemsA.size());
+    std::merge(disturbing.begin(), disturbing.end(), itemsA.begin(), itemsA.end(), merged.begin(), lessKey);
+    for(const LineItem& item: merged)
+    {
+        if(items.empty() || items.back().key != item.key)
+            items.push_back(item);
+    }
+}
+} // namespace
+
 // Third step
 void Diff3LineList::calcDiff3LineListUsingBC(const DiffList* pDiffListBC)
 {
+    TraceSpan span("calcDiff3LineListUsingBC", pDiffListBC->size());
     ////////////////
     // Now improve the position of data from C using pDiffListBC
     // If a line from C equals a line from A then it is in the
@@ -219,9 +390,18 @@ void Diff3LineList::calcDiff3LineListUsingBC(const DiffList* pDiffListBC)
     // If a line from C equals a line from B but not A, this
     // information will be used here.
 
+    // Index arrays instead of walking the list, so every step takes constant time on average.
+    std::vector<Diff3LineList::iterator> d3lines;
+    d3lines.reserve(std::list<Diff3Line, BlockAllocator<Diff3Line>>::size());
+    for(Diff3LineList::iterator i3 = begin(); i3 != end(); ++i3)
+        d3lines.push_back(i3);
+
+    LineLocations linesA(d3lines, &Diff3Line::getLineA);
+    LineLocations linesB(d3lines, &Diff3Line::getLineB);
+    LineLocations linesC(d3lines, &Diff3Line::getLineC);
+
     DiffList::const_iterator i = pDiffListBC->begin();
-    Diff3LineList::iterator i3b = begin();
-    Diff3LineList::iterator i3c = begin();
+    size_t insertIndexB = 0; // Lines from B without a line from C are moved up before this Diff3Line
     LineRef::LineType lineB = 0;
     LineRef::LineType lineC = 0;
     Diff d;
@@ -243,237 +423,168 @@ void Diff3LineList::calcDiff3LineListUsingBC(const DiffList* pDiffListBC)
         if(d.numberOfEquals() > 0)
         {
             // Find the corresponding lineB and lineC
-            while(i3b != end() && i3b->getLineB() != lineB)
-                ++i3b;
-
-            while(i3c != end() && i3c->getLineC() != lineC)
-                ++i3c;
-
-            Q_ASSERT(i3b != end());
-            Q_ASSERT(i3c != end());
+            const Diff3LineList::iterator i3b = linesB.item(lineB);
+            const Diff3LineList::iterator i3c = linesC.item(lineC);
+            const qint64 keyB = linesB.key(lineB);
+            const qint64 keyC = linesC.key(lineC);
+            bool bTakenB = false;
+            bool bTakenC = false;
 
             if(i3b == i3c)
             {
                 Q_ASSERT(i3b->getLineC() == lineC);
                 i3b->bBEqC = true;
             }
-            else
+            else if(keyC < keyB)
             {
                 // Is it possible to move this line up?
                 // Test if no other B's are used between i3c and i3b
-
-                // First test which is before: i3c or i3b ?
-                Diff3LineList::iterator i3c1 = i3c;
-                Diff3LineList::iterator i3b1 = i3b;
-                while(i3c1 != i3b && i3b1 != i3c)
+                if(!i3b->isEqualAB())
                 {
-                    Q_ASSERT(i3b1 != end() || i3c1 != end());
-                    if(i3c1 != end()) ++i3c1;
-                    if(i3b1 != end()) ++i3b1;
-                }
-
-                if(i3c1 == i3b && !i3b->isEqualAB()) // i3c before i3b
-                {
-                    Diff3LineList::iterator i3 = i3c;
-                    int nofDisturbingLines = 0;
-                    while(i3 != i3b && i3 != end())
-                    {
-                        if(i3->getLineB().isValid())
-                            ++nofDisturbingLines;
-                        ++i3;
-                    }
-
-                    if(nofDisturbingLines > 0) //&& nofDisturbingLines < d.nofEquals*d.nofEquals+4 )
+                    if(linesB.hasUntakenFrom(keyC))
                     {
-                        Diff3LineList::iterator i3_last_equal_A = end();
-
-                        i3 = i3c;
-                        while(i3 != i3b)
+                        std::vector<LineItem> disturbing;
+                        linesB.take(keyC, keyB, disturbing);
+
+                        /* If lastEqualKey isn't still -1, then we've found
+                         * a line in A that is equal to one in B somewhere
+                         * between i3c and i3b
+                         */
+                        qint64 lastEqualKey = -1;
+                        for(const LineItem& item: disturbing)
                         {
-                            if(i3->isEqualAB())
-                            {
-                                i3_last_equal_A = i3;
-                            }
-                            ++i3;
+                            if(item.it->isEqualAB())
+                                lastEqualKey = item.key;
                         }
 
-                        /* If i3_last_equal_A isn't still set to d3ll.end(), then
-                   * we've found a line in A that is equal to one in B
-                   * somewhere between i3c and i3b
-                   */
-                        bool before_or_on_equal_line_in_A = (i3_last_equal_A != end());
-
                         // Move the disturbing lines up, out of sight.
-                        i3 = i3c;
-                        while(i3 != i3b)
+                        std::vector<LineItem> items;
+                        movedLines(disturbing, linesA, keyC, lastEqualKey, items);
+                        for(const LineItem& item: items)
                         {
-                            if(i3->getLineB().isValid() ||
-                               (before_or_on_equal_line_in_A && i3->getLineA().isValid()))
-                            {
-                                d3l.setLineB(i3->getLineB());
-                                i3->getLineB().invalidate();
-
-                                // Move A along if it matched B
-                                if(before_or_on_equal_line_in_A)
-                                {
-                                    d3l.setLineA(i3->getLineA());
-                                    d3l.bAEqB = i3->isEqualAB();
-                                    i3->getLineA().invalidate();
-                                    i3->bAEqC = false;
-                                }
-
-                                i3->bAEqB = false;
-                                i3->bBEqC = false;
-                                insert(i3c, d3l);
-                            }
+                            const Diff3LineList::iterator i3 = item.it;
+                            d3l.setLineB(i3->getLineB());
+                            i3->lineB.invalidate();
 
-                            if(i3 == i3_last_equal_A)
+                            // Move A along if it matched B
+                            if(item.key <= lastEqualKey)
                             {
-                                before_or_on_equal_line_in_A = false;
+                                d3l.setLineA(i3->getLineA());
+                                d3l.bAEqB = i3->isEqualAB();
+                                i3->lineA.invalidate();
+                                i3->bAEqC = false;
                             }
 
-                            ++i3;
+                            i3->bAEqB = false;
+                            i3->bBEqC = false;
+                            insert(i3c, d3l);
                         }
-                        nofDisturbingLines = 0;
                     }
 
-                    if(nofDisturbingLines == 0)
-                    {
-                        // Yes, the line from B can be moved.
-                        i3b->getLineB().invalidate(); // This might leave an empty line: removed later.
-                        i3b->bAEqB = false;
-                        i3b->bBEqC = false;
-                        i3c->setLineB(lineB);
-                        i3c->bBEqC = true;
-                        i3c->bAEqB = i3c->isEqualAC();
-                    }
+                    // Yes, the line from B can be moved.
+                    i3b->lineB.invalidate(); // This might leave an empty line: removed later.
+                    i3b->bAEqB = false;
+                    i3b->bBEqC = false;
+                    i3c->setLineB(lineB);
+                    i3c->bBEqC = true;
+                    i3c->bAEqB = i3c->isEqualAC();
+                    bTakenB = true;
                 }
-                else if(i3b1 == i3c && !i3c->isEqualAC())
+            }
+            else if(!i3c->isEqualAC())
+            {
+                if(linesC.hasUntakenFrom(keyB))
                 {
-                    Diff3LineList::iterator i3 = i3b;
-                    int nofDisturbingLines = 0;
-                    while(i3 != i3c && i3 != end())
+                    std::vector<LineItem> disturbing;
+                    linesC.take(keyB, keyC, disturbing);
+
+                    /* If lastEqualKey isn't still -1, then we've found
+                     * a line in A that is equal to one in C somewhere
+                     * between i3b and i3c
+                     */
+                    qint64 lastEqualKey = -1;
+                    for(const LineItem& item: disturbing)
                     {
-                        if(i3->getLineC().isValid())
-                            ++nofDisturbingLines;
-                        ++i3;
+                        if(item.it->isEqualAC())
+                            lastEqualKey = item.key;
                     }
 
-                    if(nofDisturbingLines > 0) //&& nofDisturbingLines < d.nofEquals*d.nofEquals+4 )
+                    // Move the disturbing lines up.
+                    std::vector<LineItem> items;
+                    movedLines(disturbing, linesA, keyB, lastEqualKey, items);
+                    for(const LineItem& item: items)
                     {
-                        Diff3LineList::iterator i3_last_equal_A = end();
+                        const Diff3LineList::iterator i3 = item.it;
+                        d3l.setLineC(i3->getLineC());
+                        i3->lineC.invalidate();
 
-                        i3 = i3b;
-                        while(i3 != i3c)
+                        // Move A along if it matched C
+                        if(item.key <= lastEqualKey)
                         {
-                            if(i3->isEqualAC())
-                            {
-                                i3_last_equal_A = i3;
-                            }
-                            ++i3;
+                            d3l.setLineA(i3->getLineA());
+                            d3l.bAEqC = i3->isEqualAC();
+                            i3->lineA.invalidate();
+                            i3->bAEqB = false;
                         }
 
-                        /* If i3_last_equal_A isn't still set to d3ll.end(), then
-                   * we've found a line in A that is equal to one in C
-                   * somewhere between i3b and i3c
-                   */
-                        bool before_or_on_equal_line_in_A = (i3_last_equal_A != end());
-
-                        // Move the disturbing lines up.
-                        i3 = i3b;
-                        while(i3 != i3c)
-                        {
-                            if(i3->getLineC().isValid() ||
-                               (before_or_on_equal_line_in_A && i3->getLineA().isValid()))
-                            {
-                                d3l.setLineC(i3->getLineC());
-                                i3->getLineC().invalidate();
-
-                                // Move A along if it matched C
-                                if(before_or_on_equal_line_in_A)
-                                {
-                                    d3l.setLineA(i3->getLineA());
-                                    d3l.bAEqC = i3->isEqualAC();
-                                    i3->getLineA().invalidate();
-                                    i3->bAEqB = false;
-                                }
-
-                                i3->bAEqC = false;
-                                i3->bBEqC = false;
-                                insert(i3b, d3l);
-                            }
-
-                            if(i3 == i3_last_equal_A)
-                            {
-                                before_or_on_equal_line_in_A = false;
-                            }
-
-                            ++i3;
-                        }
-                        nofDisturbingLines = 0;
-                    }
-
-                    if(nofDisturbingLines == 0)
-                    {
-                        // Yes, the line from C can be moved.
-                        i3c->getLineC().invalidate(); // This might leave an empty line: removed later.
-                        i3c->bAEqC = false;
-                        i3c->bBEqC = false;
-                        i3b->setLineC(lineC);
-                        i3b->bBEqC = true;
-                        i3b->bAEqC = i3b->isEqualAB();
+                        i3->bAEqC = false;
+                        i3->bBEqC = false;
+                        insert(i3b, d3l);
                     }
                 }
+
+                // Yes, the line from C can be moved.
+                i3c->lineC.invalidate(); // This might leave an empty line: removed later.
+                i3c->bAEqC = false;
+                i3c->bBEqC = false;
+                i3b->setLineC(lineC);
+                i3b->bBEqC = true;
+                i3b->bAEqC = i3b->isEqualAB();
+                bTakenC = true;
             }
 
+            linesB.handled(lineB, bTakenB);
+            linesC.handled(lineC, bTakenC);
+            insertIndexB = (size_t)(keyB / 2) + 1;
+
             d.adjustNumberOfEquals(-1);
             ++lineB;
             ++lineC;
-            ++i3b;
-            ++i3c;
         }
         else if(d.diff1() > 0)
         {
-            Diff3LineList::iterator i3 = i3b;
-            while(i3->getLineB() != lineB)
-                ++i3;
+            const Diff3LineList::iterator i3b = insertIndexB < d3lines.size() ? d3lines[insertIndexB] : end();
+            const Diff3LineList::iterator i3 = linesB.item(lineB);
             if(i3 != i3b && !i3->isEqualAB())
             {
                 // Take B from this line and move it up as far as possible
                 d3l.setLineB(lineB);
-                insert(i3b, d3l);
-                i3->getLineB().invalidate();
+                linesB.setItem(lineB, insert(i3b, d3l), 2 * (qint64)insertIndexB - 1);
+                i3->lineB.invalidate();
+                ++insertIndexB;
             }
             else
             {
-                i3b = i3;
+                insertIndexB = (size_t)(linesB.key(lineB) / 2) + 1;
             }
+            linesB.handled(lineB, false);
             d.adjustDiff1(-1);
             ++lineB;
-            ++i3b;
 
             if(d.diff2() > 0)
             {
+                linesC.handled(lineC, false);
                 d.adjustDiff2(-1);
                 ++lineC;
             }
         }
         else if(d.diff2() > 0)
         {
+            linesC.handled(lineC, false);
             d.adjustDiff2(-1);
             ++lineC;
         }
     }
-    /*
-   Diff3LineList::iterator it = d3ll.begin();
-   int li=0;
-   for( ; it!=d3ll.end(); ++it, ++li )
-   {
-      printf( "%4d %4d %4d %4d  A%c=B A%c=C B%c=C\n",
-         li, it->getLineA(), it->getLineB(), it->getLineC(),
-         it->isEqualAB() ? '=' : '!', it->isEqualAC() ? '=' : '!', it->isEqualBC() ? '=' : '!' );
-   }
-   printf("\n");*/
 }
 
 // Test if the move would pass a barrier. Return true if not.
@@ -569,132 +680,732 @@ bool ManualDiffHelpEntry::isValidMove(int line1, int line2, e_SrcSelector winIdx
             return false;
     }
 
-    return true;
+    return true;
+}
+
+int ManualDiffHelpEntry::calcManualDiffFirstDiff3LineIdx(const Diff3LineVector& d3lv)
+{
+    int i;
+    for(i = 0; i < d3lv.size(); ++i)
+    {
+        const Diff3Line& d3l = *d3lv[i];
+        if((lineA1.isValid() && lineA1 == d3l.getLineA()) ||
+           (lineB1.isValid() && lineB1 == d3l.getLineB()) ||
+           (lineC1.isValid() && lineC1 == d3l.getLineC()))
+            return i;
+    }
+    return -1;
+}
+
+/*
+    Each thread has its own GnuDiff, so it keeps its work space for the next comparison on the same thread.
+*/
+static GnuDiff& gnuDiffForThread(const QSharedPointer<Options>& pOptions)
+{
+    thread_local GnuDiff gnuDiff;
+
+    gnuDiff.ignore_white_space = GnuDiff::IGNORE_ALL_SPACE; // I think nobody needs anything else ...
+    gnuDiff.bIgnoreWhiteSpace = true;
+    gnuDiff.bIgnoreNumbers = pOptions->m_bIgnoreNumbers;
+    gnuDiff.minimal = pOptions->m_bTryHard;
+    gnuDiff.time_limit = (qint64)pOptions->m_diffTimeLimit * 1000;
+    gnuDiff.ignore_case = false;
+    return gnuDiff;
+}
+
+// Appends d, merging it into the last diff where possible.
+static void appendDiff(DiffList& diffList, const Diff& d)
+{
+    if(!diffList.empty() && (d.numberOfEquals() == 0 || (diffList.back().diff1() == 0 && diffList.back().diff2() == 0)))
+    {
+        diffList.back().adjustNumberOfEquals(d.numberOfEquals());
+        diffList.back().adjustDiff1(d.diff1());
+        diffList.back().adjustDiff2(d.diff2());
+    }
+    else
+    {
+        diffList.push_back(d);
+    }
+}
+
+/*
+    Counts the lines at the start and at the end of both ranges that have the same text. Both counts
+    together never exceed the size of either range.
+*/
+static void countEqualEnds(const QVector<LineData>* p1, const qint32 index1, LineRef size1, const QVector<LineData>* p2, const qint32 index2, LineRef size2,
+                           LineCount& equalAtStart, LineCount& equalAtEnd)
+{
+    const LineCount maxEqual = std::min<LineCount>(size1, size2);
+
+    equalAtStart = 0;
+    while(equalAtStart < maxEqual && LineData::sameText((*p1)[index1 + equalAtStart], (*p2)[index2 + equalAtStart]))
+        ++equalAtStart;
+
+    equalAtEnd = 0;
+    while(equalAtStart + equalAtEnd < maxEqual &&
+          LineData::sameText((*p1)[index1 + size1 - equalAtEnd - 1], (*p2)[index2 + size2 - equalAtEnd - 1]))
+        ++equalAtEnd;
+}
+
+bool DiffList::runDiff(const QVector<LineData>* p1, const qint32 index1, LineRef size1, const QVector<LineData>* p2, const qint32 index2, LineRef size2,
+                    const QSharedPointer<Options> &pOptions, const QVector<size_t>* pHashes1, const QVector<size_t>* pHashes2)
+{
+    ProgressProxy pp;
+
+    pp.setCurrent(0);
+
+    clear();
+    m_bDegraded = false;
+    if(p1 == nullptr || (*p1)[index1].getLine() == nullptr || p2 == nullptr || (*p2)[index2].getLine() == nullptr || size1 == 0 || size2 == 0)
+    {
+        if(p1 != nullptr && p2 != nullptr && (*p1)[index1].getLine() == nullptr && (*p2)[index2].getLine() == nullptr && size1 == size2)
+            push_back(Diff(size1, 0, 0));
+        else
+        {
+            push_back(Diff(0, size1, size2));
+        }
+    }
+    else
+    {
+        /*
+            Identical inputs or a small change in a large file are common. The lines with the same text at
+            both ends are taken over as they are, so only the differing middle is numbered or copied
+            into a buffer for GnuDiff.
+        */
+        LineCount equalAtStart, equalAtEnd;
+        countEqualEnds(p1, index1, size1, p2, index2, size2, equalAtStart, equalAtEnd);
+        const LineCount changed1 = size1 - equalAtStart - equalAtEnd;
+        const LineCount changed2 = size2 - equalAtStart - equalAtEnd;
+
+        DiffList changedDiffs;
+        if(changed1 == 0 || changed2 == 0)
+            changedDiffs.push_back(Diff(0, changed1, changed2));
+        else if(pOptions->m_diffAlgorithm == eDiffAlgorithmHistogram)
+            changedDiffs.runHistogramDiff(p1, index1 + equalAtStart, changed1, p2, index2 + equalAtStart, changed2, pOptions, pHashes1, pHashes2);
+        else
+            changedDiffs.runGnuDiff(p1, index1 + equalAtStart, changed1, p2, index2 + equalAtStart, changed2, pOptions, pHashes1, pHashes2);
+        m_bDegraded = changedDiffs.isDegraded();
+
+        push_back(Diff(equalAtStart, 0, 0));
+        for(const Diff& d : changedDiffs)
+            appendDiff(*this, d);
+        if(equalAtEnd > 0)
+            appendDiff(*this, Diff(equalAtEnd, 0, 0));
+    }
+
+    // Verify difflist
+    {
+        LineRef::LineType l1 = 0;
+        LineRef::LineType l2 = 0;
+        DiffList::iterator i;
+        for(i = begin(); i != end(); ++i)
+        {
+            l1 += i->numberOfEquals() + i->diff1();
+            l2 += i->numberOfEquals() + i->diff2();
+        }
+
+        Q_ASSERT(l1 == size1 && l2 == size2);
+    }
+
+    pp.setCurrent(1);
+
+    return true;
+}
+
+/*
+    GnuDiff reads the lines of a range from one buffer, UTF-16 or Latin-1. The text of a very large
+    file is split into chunks though, such a range is copied into joined first. Only a range over
+    UTF-16 and Latin-1 chunks at once is widened to UTF-16 for that.
+*/
+static void setGnuDiffBuffer(GnuDiff::file_data& file, const QVector<LineData>* p, const qint32 index, LineRef size, std::vector<char>& joinedLatin1,
+                             std::vector<QChar>& joined)
+{
+    const LineData& first = (*p)[index];
+    const LineData& end = (*p)[index + size];
+    if(first.getBuffer() == end.getBuffer())
+    {
+        file.latin1 = first.isLatin1();
+        if(file.latin1)
+            file.buffer = first.latin1();
+        else
+            file.buffer = first.utf16();
+        file.buffered = end.getOffset() - first.getOffset() - 1;
+        return;
+    }
+
+    file.latin1 = true;
+    size_t length = 0;
+    for(qint32 i = index; i < index + size; ++i)
+    {
+        file.latin1 = file.latin1 && (*p)[i].isLatin1();
+        length += (*p)[i].size() + 1;
+    }
+
+    if(file.latin1)
+    {
+        joinedLatin1.reserve(length);
+        for(qint32 i = index; i < index + size; ++i)
+        {
+            const LineData& line = (*p)[i];
+            joinedLatin1.insert(joinedLatin1.end(), line.latin1(), line.latin1() + line.size());
+            joinedLatin1.push_back('\n');
+        }
+        file.buffer = joinedLatin1.data();
+        file.buffered = joinedLatin1.size() - 1;
+        return;
+    }
+
+    joined.reserve(length);
+    for(qint32 i = index; i < index + size; ++i)
+    {
+        const LineData& line = (*p)[i];
+        if(line.isLatin1())
+        {
+            for(const char* pLine = line.latin1(), *pEnd = pLine + line.size(); pLine != pEnd; ++pLine)
+                joined.push_back(QChar::fromLatin1(*pLine));
+        }
+        else
+        {
+            joined.insert(joined.end(), line.utf16(), line.utf16() + line.size());
+        }
+        joined.push_back('\n');
+    }
+    file.buffer = joined.data();
+    file.buffered = joined.size() - 1;
+}
+
+void DiffList::runGnuDiff(const QVector<LineData>* p1, const qint32 index1, LineRef size1, const QVector<LineData>* p2, const qint32 index2, LineRef size2,
+                          const QSharedPointer<Options>& pOptions, const QVector<size_t>* pHashes1, const QVector<size_t>* pHashes2)
+{
+    GnuDiff::comparison comparisonInput;
+    memset(&comparisonInput, 0, sizeof(comparisonInput));
+    comparisonInput.parent = nullptr;
+    std::vector<char> joinedLatin1[2];
+    std::vector<QChar> joined[2];
+    setGnuDiffBuffer(comparisonInput.file[0], p1, index1, size1, joinedLatin1[0], joined[0]);
+    setGnuDiffBuffer(comparisonInput.file[1], p2, index2, size2, joinedLatin1[1], joined[1]);
+    // Precomputed hashes spare gnudiff from hashing every line again for each comparison.
+    Q_ASSERT(pHashes1 == nullptr || pHashes1->size() >= index1 + size1);
+    Q_ASSERT(pHashes2 == nullptr || pHashes2->size() >= index2 + size2);
+    comparisonInput.file[0].line_hashes = pHashes1 != nullptr ? pHashes1->constData() + index1 : nullptr;
+    comparisonInput.file[1].line_hashes = pHashes2 != nullptr ? pHashes2->constData() + index2 : nullptr;
+
+    GnuDiff& gnuDiff = gnuDiffForThread(pOptions);
+    GnuDiff::change* script = gnuDiff.diff_2_files(&comparisonInput);
+    if(gnuDiff.budget_exceeded)
+    {
+        qCInfo(kdiffCore) << "Diff time limit reached, the result may not be minimal";
+        m_bDegraded = true;
+    }
+
+    LineRef equalLinesAtStart = (LineRef)comparisonInput.file[0].prefix_lines;
+    LineRef currentLine1 = 0;
+    LineRef currentLine2 = 0;
+    GnuDiff::change* p = nullptr;
+    for(GnuDiff::change* e = script; e; e = p)
+    {
+        Diff d((LineCount)(e->line0 - currentLine1), e->deleted, e->inserted);
+        Q_ASSERT(d.numberOfEquals() == e->line1 - currentLine2);
+
+        currentLine1 += (LineRef)(d.numberOfEquals() + d.diff1());
+        currentLine2 += (LineRef)(d.numberOfEquals() + d.diff2());
+        push_back(d);
+
+        p = e->link;
+        free(e);
+    }
+
+    if(empty())
+    {
+        qint32 numofEquals = std::min(size1, size2);
+        Diff d(numofEquals, size1 - numofEquals, size2 - numofEquals);
+
+        push_back(d);
+    }
+    else
+    {
+        front().adjustNumberOfEquals(equalLinesAtStart);
+        currentLine1 += equalLinesAtStart;
+        currentLine2 += equalLinesAtStart;
+
+        LineCount nofEquals = std::min(size1 - currentLine1, size2 - currentLine2);
+        if(nofEquals == 0)
+        {
+            back().adjustDiff1(size1 - currentLine1);
+            back().adjustDiff2(size2 - currentLine2);
+        }
+        else
+        {
+            Diff d(nofEquals, size1 - currentLine1 - nofEquals, size2 - currentLine2 - nofEquals);
+            push_back(d);
+        }
+    }
+}
+
+static bool linesDiffer(GnuDiff& gnuDiff, const LineData& l1, const LineData& l2)
+{
+    if(l1.isLatin1())
+        return l2.isLatin1() ? gnuDiff.lines_differ(l1.latin1(), l1.size(), l2.latin1(), l2.size()) : gnuDiff.lines_differ(l1.latin1(), l1.size(), l2.utf16(), l2.size());
+    return l2.isLatin1() ? gnuDiff.lines_differ(l1.utf16(), l1.size(), l2.latin1(), l2.size()) : gnuDiff.lines_differ(l1.utf16(), l1.size(), l2.utf16(), l2.size());
+}
+
+/*
+    Numbers the lines so that lines GnuDiff considers equal get the same number.
+    The hash only preselects the candidates, classLines holds the first line of each number.
+*/
+static void numberLines(const QVector<LineData>* p, const qint32 index, LineRef size, const QVector<size_t>* pHashes, bool bIgnoreNumbers, GnuDiff& gnuDiff,
+                        QMultiHash<size_t, qint32>& classesByHash, QVector<const LineData*>& classLines, QVector<qint32>& lines)
+{
+    lines.resize(size);
+    for(qint32 i = 0; i < size; ++i)
+    {
+        const LineData& line = (*p)[index + i];
+        const size_t hash = pHashes != nullptr ? (*pHashes)[index + i] : line.hash(bIgnoreNumbers);
+
+        qint32 lineClass = -1;
+        QMultiHash<size_t, qint32>::const_iterator it;
+        for(it = classesByHash.constFind(hash); it != classesByHash.constEnd() && it.key() == hash; ++it)
+        {
+            const LineData* pClassLine = classLines[it.value()];
+            if(!linesDiffer(gnuDiff, *pClassLine, line))
+            {
+                lineClass = it.value();
+                break;
+            }
+        }
+
+        if(lineClass < 0)
+        {
+            lineClass = classLines.size();
+            classLines.push_back(&line);
+            classesByHash.insert(hash, lineClass);
+        }
+        lines[i] = lineClass;
+    }
+}
+
+void DiffList::runHistogramDiff(const QVector<LineData>* p1, const qint32 index1, LineRef size1, const QVector<LineData>* p2, const qint32 index2, LineRef size2,
+                                const QSharedPointer<Options>& pOptions, const QVector<size_t>* pHashes1, const QVector<size_t>* pHashes2)
+{
+    GnuDiff& gnuDiff = gnuDiffForThread(pOptions);
+
+    QMultiHash<size_t, qint32> classesByHash;
+    QVector<const LineData*> classLines;
+    QVector<qint32> lines1;
+    QVector<qint32> lines2;
+    numberLines(p1, index1, size1, pHashes1, pOptions->m_bIgnoreNumbers, gnuDiff, classesByHash, classLines, lines1);
+    numberLines(p2, index2, size2, pHashes2, pOptions->m_bIgnoreNumbers, gnuDiff, classesByHash, classLines, lines2);
+
+    HistogramDiff histogramDiff(lines1, lines2, classLines.size());
+    const QVector<HistogramDiff::Segment> segments = histogramDiff.run();
+    for(const HistogramDiff::Segment& segment : segments)
+    {
+        if(segment.type == HistogramDiff::SegmentType::Equal)
+        {
+            appendDiff(*this, Diff(segment.size1, 0, 0));
+        }
+        else if(segment.type == HistogramDiff::SegmentType::Changed)
+        {
+            appendDiff(*this, Diff(0, segment.size1, segment.size2));
+        }
+        else
+        {
+            // Nothing to anchor on, GnuDiff does better for lines that repeat this often.
+            DiffList unresolvedDiffs;
+            unresolvedDiffs.runGnuDiff(p1, index1 + segment.begin1, segment.size1, p2, index2 + segment.begin2, segment.size2, pOptions, pHashes1, pHashes2);
+            for(const Diff& d : unresolvedDiffs)
+                appendDiff(*this, d);
+            m_bDegraded = m_bDegraded || unresolvedDiffs.isDegraded();
+        }
+    }
+}
+
+/*
+    Counts the lines at the start and at the end that are the same in the old and the new line data.
+    Both counts together never exceed the size of either version.
+*/
+static void countUnchangedLines(const QVector<LineData>* pOld, LineCount oldSize, const QVector<LineData>* pNew, LineCount newSize,
+                                LineCount& unchangedAtStart, LineCount& unchangedAtEnd)
+{
+    const LineCount maxUnchanged = std::min(oldSize, newSize);
+
+    unchangedAtStart = 0;
+    while(unchangedAtStart < maxUnchanged && LineData::sameText((*pOld)[unchangedAtStart], (*pNew)[unchangedAtStart]))
+        ++unchangedAtStart;
+
+    unchangedAtEnd = 0;
+    while(unchangedAtStart + unchangedAtEnd < maxUnchanged &&
+          LineData::sameText((*pOld)[oldSize - unchangedAtEnd - 1], (*pNew)[newSize - unchangedAtEnd - 1]))
+        ++unchangedAtEnd;
+}
+
+bool DiffList::readUnifiedDiff(const QByteArray& patch, LineRef size1, LineRef size2, QString& errorReason)
+{
+    TraceSpan span("readUnifiedDiff", patch.size());
+    static const QRegularExpression hunkHeader(QStringLiteral("^@@ -(\\d+)(?:,(\\d+))? \\+(\\d+)(?:,(\\d+))? @@"));
+    clear();
+    m_bDegraded = false;
+
+    QList<QByteArray> lines = patch.split('\n');
+    // What follows the last line end is no line, it would pass for an empty context line.
+    if(!lines.isEmpty() && lines.last().isEmpty())
+        lines.removeLast();
+    LineCount pos1 = 0, pos2 = 0; // The lines of both inputs taken so far
+    for(int i = 0; i < lines.size(); ++i)
+    {
+        const QRegularExpressionMatch match = hunkHeader.match(QString::fromLatin1(lines[i]));
+        if(!match.hasMatch())
+            continue; // File headers and the like
+        const int headerLine = i + 1;
+
+        const LineCount count1 = match.capturedRef(2).isNull() ? 1 : match.capturedRef(2).toInt();
+        const LineCount count2 = match.capturedRef(4).isNull() ? 1 : match.capturedRef(4).toInt();
+        // An empty range gives the line before it.
+        const LineCount start1 = match.capturedRef(1).toInt() - (count1 > 0 ? 1 : 0);
+        const LineCount start2 = match.capturedRef(3).toInt() - (count2 > 0 ? 1 : 0);
+        if(start1 - pos1 != start2 - pos2 || start1 < pos1 || start1 + count1 > size1 || start2 + count2 > size2)
+        {
+            errorReason = i18n("The hunk in line %1 of the alignment doesn't fit the files.", headerLine);
+            clear();
+            return false;
+        }
+        appendDiff(*this, Diff(start1 - pos1, 0, 0));
+        pos1 = start1;
+        pos2 = start2;
+
+        const LineCount end1 = start1 + count1;
+        const LineCount end2 = start2 + count2;
+        bool bHasContent = false;
+        for(; i + 1 < lines.size() && (pos1 < end1 || pos2 < end2); ++i)
+        {
+            const QByteArray& line = lines[i + 1];
+            const char c = line.isEmpty() ? ' ' : line[0]; // Some tools drop the space of empty context lines.
+            if(c == '\\')
+                continue; // No newline at end of file
+            if(c == ' ' && pos1 < end1 && pos2 < end2)
+            {
+                appendDiff(*this, Diff(1, 0, 0));
+                ++pos1;
+                ++pos2;
+            }
+            else if(c == '-' && pos1 < end1)
+            {
+                appendDiff(*this, Diff(0, 1, 0));
+                ++pos1;
+            }
+            else if(c == '+' && pos2 < end2)
+            {
+                appendDiff(*this, Diff(0, 0, 1));
+                ++pos2;
+            }
+            else
+            {
+                break;
+            }
+            bHasContent = true;
+        }
+
+        if(!bHasContent)
+        {
+            appendDiff(*this, Diff(0, count1, count2));
+            pos1 = end1;
+            pos2 = end2;
+        }
+        else if(pos1 != end1 || pos2 != end2)
+        {
+            errorReason = i18n("The hunk in line %1 of the alignment has too few lines.", headerLine);
+            clear();
+            return false;
+        }
+    }
+
+    if(size1 - pos1 != size2 - pos2)
+    {
+        errorReason = i18n("The alignment doesn't fit the files.");
+        clear();
+        return false;
+    }
+    appendDiff(*this, Diff(size1 - pos1, 0, 0));
+    return true;
+}
+
+LineDiffOptions LineDiffOptions::of(const Options& options)
+{
+    LineDiffOptions diffOptions;
+    diffOptions.bIgnoreNumbers = options.m_bIgnoreNumbers;
+    diffOptions.bIgnoreCase = options.m_bIgnoreCase;
+    diffOptions.bIgnoreComments = options.m_bIgnoreComments;
+    diffOptions.bTryHard = options.m_bTryHard;
+    diffOptions.bDiff3AlignBC = options.m_bDiff3AlignBC;
+    diffOptions.diffAlgorithm = options.m_diffAlgorithm;
+    diffOptions.diffTimeLimit = options.m_diffTimeLimit;
+    diffOptions.preProcessorCmd = options.m_PreProcessorCmd;
+    diffOptions.lineMatchingPreProcessorCmd = options.m_LineMatchingPreProcessorCmd;
+    return diffOptions;
 }
 
-int ManualDiffHelpEntry::calcManualDiffFirstDiff3LineIdx(const Diff3LineVector& d3lv)
+bool LineDiffOptions::operator==(const LineDiffOptions& other) const
 {
-    int i;
-    for(i = 0; i < d3lv.size(); ++i)
-    {
-        const Diff3Line& d3l = *d3lv[i];
-        if((lineA1.isValid() && lineA1 == d3l.getLineA()) ||
-           (lineB1.isValid() && lineB1 == d3l.getLineB()) ||
-           (lineC1.isValid() && lineC1 == d3l.getLineC()))
-            return i;
-    }
-    return -1;
+    return bIgnoreNumbers == other.bIgnoreNumbers && bIgnoreCase == other.bIgnoreCase && bIgnoreComments == other.bIgnoreComments &&
+           bTryHard == other.bTryHard && bDiff3AlignBC == other.bDiff3AlignBC && diffAlgorithm == other.diffAlgorithm &&
+           diffTimeLimit == other.diffTimeLimit && preProcessorCmd == other.preProcessorCmd &&
+           lineMatchingPreProcessorCmd == other.lineMatchingPreProcessorCmd;
 }
 
-bool DiffList::runDiff(const QVector<LineData>* p1, const qint32 index1, LineRef size1, const QVector<LineData>* p2, const qint32 index2, LineRef size2,
-                    const QSharedPointer<Options> &pOptions)
+bool DiffList::rerunDiff(const DiffList& oldDiffList, const QVector<LineData>* pOld1, const QVector<LineData>* pOld2,
+                         const QVector<LineData>* p1, LineRef size1, const QVector<LineData>* p2, LineRef size2, const QSharedPointer<Options>& pOptions,
+                         const QVector<size_t>* pHashes1, const QVector<size_t>* pHashes2)
 {
-    ProgressProxy pp;
-    static GnuDiff gnuDiff; // All values are initialized with zeros.
+    TraceSpan span("rerunDiff", (qint64)size1 + size2);
+    // The line data vectors have one extra entry behind the last line.
+    const LineCount oldSize1 = pOld1 == nullptr ? -1 : pOld1->size() - 1;
+    const LineCount oldSize2 = pOld2 == nullptr ? -1 : pOld2->size() - 1;
+
+    LineCount diffSize1 = 0;
+    LineCount diffSize2 = 0;
+    for(const Diff& d : oldDiffList)
+    {
+        diffSize1 += d.numberOfEquals() + d.diff1();
+        diffSize2 += d.numberOfEquals() + d.diff2();
+    }
 
-    pp.setCurrent(0);
+    // Without matching old data there is nothing to reuse.
+    if(p1 == nullptr || p2 == nullptr || oldSize1 <= 0 || oldSize2 <= 0 || size1 == 0 || size2 == 0 ||
+       diffSize1 != oldSize1 || diffSize2 != oldSize2)
+        return runDiff(p1, 0, size1, p2, 0, size2, pOptions, pHashes1, pHashes2);
+
+    LineCount unchangedAtStart1, unchangedAtEnd1, unchangedAtStart2, unchangedAtEnd2;
+    countUnchangedLines(pOld1, oldSize1, p1, size1, unchangedAtStart1, unchangedAtEnd1);
+    countUnchangedLines(pOld2, oldSize2, p2, size2, unchangedAtStart2, unchangedAtEnd2);
 
     clear();
-    if(p1 == nullptr || (*p1)[index1].getLine() == nullptr || p2 == nullptr || (*p2)[index2].getLine() == nullptr || size1 == 0 || size2 == 0)
+    m_bDegraded = false;
+
+    /*
+        Take over the old diffs up to the last line where both inputs are still in sync and unchanged.
+        An equal range may be split, a range of differences is only taken over as a whole.
+    */
+    LineCount start1 = 0;
+    LineCount start2 = 0;
+    DiffList::const_iterator i;
+    for(i = oldDiffList.cbegin(); i != oldDiffList.cend(); ++i)
     {
-        if(p1 != nullptr && p2 != nullptr && (*p1)[index1].getLine() == nullptr && (*p2)[index2].getLine() == nullptr && size1 == size2)
-            push_back(Diff(size1, 0, 0));
-        else
+        const LineCount nofEquals = std::min<LineCount>(i->numberOfEquals(), std::min(unchangedAtStart1 - start1, unchangedAtStart2 - start2));
+        if(nofEquals < i->numberOfEquals() || start1 + nofEquals + i->diff1() > unchangedAtStart1 || start2 + nofEquals + i->diff2() > unchangedAtStart2)
         {
-            push_back(Diff(0, size1, size2));
+            if(nofEquals > 0)
+                push_back(Diff(nofEquals, 0, 0));
+            start1 += nofEquals;
+            start2 += nofEquals;
+            break;
         }
+
+        push_back(*i);
+        start1 += i->numberOfEquals() + i->diff1();
+        start2 += i->numberOfEquals() + i->diff2();
     }
-    else
+
+    // The same from the end, without crossing the part taken over at the start.
+    DiffList diffsAtEnd;
+    LineCount end1 = 0;
+    LineCount end2 = 0;
+    DiffList::const_reverse_iterator ri;
+    for(ri = oldDiffList.crbegin(); ri != oldDiffList.crend(); ++ri)
     {
-        GnuDiff::comparison comparisonInput;
-        memset(&comparisonInput, 0, sizeof(comparisonInput));
-        comparisonInput.parent = nullptr;
-        comparisonInput.file[0].buffer = (*p1)[index1].getBuffer()->unicode() + (*p1)[index1].getOffset();                                                      //ptr to buffer
-        comparisonInput.file[0].buffered = ((*p1)[size1].getOffset() - 1); // size of buffer
-        comparisonInput.file[1].buffer = (*p2)[index2].getBuffer()->unicode() + (*p2)[index2].getOffset();                                                      //ptr to buffer
-        comparisonInput.file[1].buffered = ((*p2)[size2].getOffset() - 1); // size of buffer
-
-        gnuDiff.ignore_white_space = GnuDiff::IGNORE_ALL_SPACE; // I think nobody needs anything else ...
-        gnuDiff.bIgnoreWhiteSpace = true;
-        gnuDiff.bIgnoreNumbers = pOptions->m_bIgnoreNumbers;
-        gnuDiff.minimal = pOptions->m_bTryHard;
-        gnuDiff.ignore_case = false;
-        GnuDiff::change* script = gnuDiff.diff_2_files(&comparisonInput);
-
-        LineRef equalLinesAtStart = (LineRef)comparisonInput.file[0].prefix_lines;
-        LineRef currentLine1 = 0;
-        LineRef currentLine2 = 0;
-        GnuDiff::change* p = nullptr;
-        for(GnuDiff::change* e = script; e; e = p)
-        {
-            Diff d((LineCount)(e->line0 - currentLine1), e->deleted, e->inserted);
-            Q_ASSERT(d.numberOfEquals() == e->line1 - currentLine2);
-
-            currentLine1 += (LineRef)(d.numberOfEquals() + d.diff1());
-            currentLine2 += (LineRef)(d.numberOfEquals() + d.diff2());
-            push_back(d);
+        if(end1 + ri->diff1() > unchangedAtEnd1 || end2 + ri->diff2() > unchangedAtEnd2 ||
+           oldSize1 - end1 - ri->diff1() < start1 || oldSize2 - end2 - ri->diff2() < start2)
+            break;
 
-            p = e->link;
-            free(e);
-        }
+        end1 += ri->diff1();
+        end2 += ri->diff2();
 
-        if(empty())
-        {
-            qint32 numofEquals = std::min(size1, size2);
-            Diff d(numofEquals, size1 - numofEquals, size2 - numofEquals);
+        const LineCount nofEquals = std::min<LineCount>(ri->numberOfEquals(),
+                                                        std::min(std::min(unchangedAtEnd1 - end1, unchangedAtEnd2 - end2),
+                                                                 std::min(oldSize1 - end1 - start1, oldSize2 - end2 - start2)));
+        if(nofEquals > 0 || ri->diff1() > 0 || ri->diff2() > 0)
+            diffsAtEnd.push_back(Diff(nofEquals, ri->diff1(), ri->diff2()));
+        end1 += nofEquals;
+        end2 += nofEquals;
 
-            push_back(d);
-        }
-        else
-        {
-            front().adjustNumberOfEquals(equalLinesAtStart);
-            currentLine1 += equalLinesAtStart;
-            currentLine2 += equalLinesAtStart;
+        if(nofEquals < ri->numberOfEquals())
+            break;
+    }
 
-            LineCount nofEquals = std::min(size1 - currentLine1, size2 - currentLine2);
-            if(nofEquals == 0)
-            {
-                back().adjustDiff1(size1 - currentLine1);
-                back().adjustDiff2(size2 - currentLine2);
-            }
-            else
-            {
-                Diff d(nofEquals, size1 - currentLine1 - nofEquals, size2 - currentLine2 - nofEquals);
-                push_back(d);
-            }
-        }
+    const LineCount changed1 = size1 - end1 - start1;
+    const LineCount changed2 = size2 - end2 - start2;
+    if(changed1 > 0 || changed2 > 0)
+    {
+        DiffList changedDiffs;
+        changedDiffs.runDiff(p1, start1, changed1, p2, start2, changed2, pOptions, pHashes1, pHashes2);
+        insert(end(), changedDiffs.begin(), changedDiffs.end());
+        m_bDegraded = changedDiffs.isDegraded();
     }
+    m_bDegraded = m_bDegraded || oldDiffList.isDegraded();
+    // diffsAtEnd was collected from the end.
+    insert(end(), diffsAtEnd.rbegin(), diffsAtEnd.rend());
 
     // Verify difflist
     {
         LineRef::LineType l1 = 0;
         LineRef::LineType l2 = 0;
-        DiffList::iterator i;
-        for(i = begin(); i != end(); ++i)
+        for(const Diff& d : *this)
         {
-            l1 += i->numberOfEquals() + i->diff1();
-            l2 += i->numberOfEquals() + i->diff2();
+            l1 += d.numberOfEquals() + d.diff1();
+            l2 += d.numberOfEquals() + d.diff2();
         }
 
         Q_ASSERT(l1 == size1 && l2 == size2);
     }
 
-    pp.setCurrent(1);
-
     return true;
 }
 
-bool ManualDiffHelpList::runDiff(const QVector<LineData>* p1, LineRef size1, const QVector<LineData>* p2, LineRef size2, DiffList& diffList,
-                                 e_SrcSelector winIdx1, e_SrcSelector winIdx2,
-                                 const QSharedPointer<Options> &pOptions)
+namespace {
+// Corresponding ranges of lines that are compared independently of other ranges.
+struct DiffRange
 {
-    diffList.clear();
-    DiffList diffList2;
+    qint32 begin1;
+    LineCount size1;
+    qint32 begin2;
+    LineCount size2;
+};
+
+class RangeDiffRunnable : public QRunnable
+{
+  private:
+    const QVector<LineData>* m_p1;
+    const QVector<LineData>* m_p2;
+    const DiffRange m_range;
+    const QSharedPointer<Options> m_pOptions;
+    const QVector<size_t>* m_pHashes1;
+    const QVector<size_t>* m_pHashes2;
+    DiffList& m_diffList;
+    QSemaphore& m_finished;
+
+  public:
+    RangeDiffRunnable(const QVector<LineData>* p1, const QVector<LineData>* p2, const DiffRange& range, const QSharedPointer<Options>& pOptions,
+                      const QVector<size_t>* pHashes1, const QVector<size_t>* pHashes2, DiffList& diffList, QSemaphore& finished)
+        : m_p1(p1), m_p2(p2), m_range(range), m_pOptions(pOptions), m_pHashes1(pHashes1), m_pHashes2(pHashes2), m_diffList(diffList), m_finished(finished)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        m_diffList.runDiff(m_p1, m_range.begin1, m_range.size1, m_p2, m_range.begin2, m_range.size2, m_pOptions, m_pHashes1, m_pHashes2);
+        m_finished.release();
+    }
+};
+
+struct AnchorCandidate
+{
+    qint32 count1 = 0;
+    qint32 line1 = -1;
+    qint32 count2 = 0;
+    qint32 line2 = -1;
+};
+} // namespace
+
+// Ranges with more lines in both inputs together are cut into parts of about linesPerAnchoredPart lines that are compared in parallel.
+static const LineCount minLinesForAnchoredDiff = 200000;
+static const LineCount linesPerAnchoredPart = 50000;
+
+/*
+    Cuts range at lines that occur exactly once in both inputs. Of these the longest chain that is in the same
+    order in both inputs is used, like patience diff does. Equal hashes are good enough here: a mismatched
+    anchor only makes the result less than ideal, each part is still compared completely.
+*/
+static void splitAtAnchors(const DiffRange& range, const QVector<size_t>& hashes1, const QVector<size_t>& hashes2, QVector<DiffRange>& parts)
+{
+    QHash<size_t, AnchorCandidate> candidates;
+    candidates.reserve(range.size1);
+    for(qint32 i = range.begin1; i < range.begin1 + range.size1; ++i)
+    {
+        AnchorCandidate& candidate = candidates[hashes1[i]];
+        ++candidate.count1;
+        candidate.line1 = i;
+    }
+    for(qint32 j = range.begin2; j < range.begin2 + range.size2; ++j)
+    {
+        QHash<size_t, AnchorCandidate>::iterator it = candidates.find(hashes2[j]);
+        if(it != candidates.end())
+        {
+            ++it->count2;
+            it->line2 = j;
+        }
+    }
+
+    QVector<std::pair<qint32, qint32>> uniqueLines;
+    for(const AnchorCandidate& candidate : candidates)
+    {
+        if(candidate.count1 == 1 && candidate.count2 == 1)
+            uniqueLines.push_back(std::make_pair(candidate.line1, candidate.line2));
+    }
+    std::sort(uniqueLines.begin(), uniqueLines.end());
+
+    // Longest chain ascending in line2 by patience sorting, tails[k] ends the best chain of length k + 1.
+    QVector<qint32> tails;
+    QVector<qint32> predecessor(uniqueLines.size(), -1);
+    for(qint32 k = 0; k < uniqueLines.size(); ++k)
+    {
+        const qint32 line2 = uniqueLines[k].second;
+        qint32 low = 0;
+        qint32 high = tails.size();
+        while(low < high)
+        {
+            const qint32 mid = (low + high) / 2;
+            if(uniqueLines[tails[mid]].second < line2)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        if(low > 0)
+            predecessor[k] = tails[low - 1];
+        if(low == tails.size())
+            tails.push_back(k);
+        else
+            tails[low] = k;
+    }
+
+    QVector<std::pair<qint32, qint32>> anchors;
+    for(qint32 k = tails.isEmpty() ? -1 : tails.back(); k != -1; k = predecessor[k])
+        anchors.push_back(uniqueLines[k]);
+    std::reverse(anchors.begin(), anchors.end());
+
+    qint32 partBegin1 = range.begin1;
+    qint32 partBegin2 = range.begin2;
+    for(const std::pair<qint32, qint32>& anchor : anchors)
+    {
+        if(anchor.first - partBegin1 + anchor.second - partBegin2 >= linesPerAnchoredPart)
+        {
+            parts.push_back(DiffRange{partBegin1, anchor.first - partBegin1, partBegin2, anchor.second - partBegin2});
+            partBegin1 = anchor.first;
+            partBegin2 = anchor.second;
+        }
+    }
+    parts.push_back(DiffRange{partBegin1, range.begin1 + range.size1 - partBegin1, partBegin2, range.begin2 + range.size2 - partBegin2});
+}
+
+static bool lessRange(const DiffRange& r1, const DiffRange& r2)
+{
+    if(r1.begin1 != r2.begin1)
+        return r1.begin1 < r2.begin1;
+    if(r1.begin2 != r2.begin2)
+        return r1.begin2 < r2.begin2;
+    if(r1.size1 != r2.size1)
+        return r1.size1 < r2.size1;
+    return r1.size2 < r2.size2;
+}
 
+// The ranges between and inside the manual alignments, they are compared independently.
+static void getManualDiffRanges(const ManualDiffHelpList& manualDiffHelpList, LineRef size1, LineRef size2,
+                                e_SrcSelector winIdx1, e_SrcSelector winIdx2, QVector<DiffRange>& ranges)
+{
     int l1begin = 0;
     int l2begin = 0;
     ManualDiffHelpList::const_iterator i;
-    for(i = begin(); i != end(); ++i)
+    for(i = manualDiffHelpList.begin(); i != manualDiffHelpList.end(); ++i)
     {
         const ManualDiffHelpEntry& mdhe = *i;
 
@@ -703,8 +1414,7 @@ bool ManualDiffHelpList::runDiff(const QVector<LineData>* p1, LineRef size1, con
 
         if(l1end.isValid() && l2end.isValid())
         {
-            diffList2.runDiff(p1, l1begin, l1end - l1begin, p2, l2begin, l2end - l2begin, pOptions);
-            diffList.splice(diffList.end(), diffList2);
+            ranges.push_back(DiffRange{l1begin, l1end - l1begin, l2begin, l2end - l2begin});
             l1begin = l1end;
             l2begin = l2end;
 
@@ -715,15 +1425,130 @@ bool ManualDiffHelpList::runDiff(const QVector<LineData>* p1, LineRef size1, con
             {
                 ++l1end; // point to line after last selected line
                 ++l2end;
-                diffList2.runDiff(p1, l1begin, l1end - l1begin, p2, l2begin, l2end - l2begin, pOptions);
-                diffList.splice(diffList.end(), diffList2);
+                ranges.push_back(DiffRange{l1begin, l1end - l1begin, l2begin, l2end - l2begin});
                 l1begin = l1end;
                 l2begin = l2end;
             }
         }
     }
-    diffList2.runDiff(p1, l1begin, size1 - l1begin, p2, l2begin, size2 - l2begin, pOptions);
-    diffList.splice(diffList.end(), diffList2);
+    ranges.push_back(DiffRange{l1begin, size1 - l1begin, l2begin, size2 - l2begin});
+}
+
+/*
+    Cuts a diff list computed for the given ranges back into one list per range.
+    Returns false if the list doesn't fit the ranges.
+*/
+static bool splitDiffList(const DiffList& diffList, const QVector<DiffRange>& ranges, QVector<DiffList>& rangeDiffs)
+{
+    rangeDiffs.resize(ranges.size());
+    DiffList::const_iterator it = diffList.begin();
+    for(qint32 k = 0; k < ranges.size(); ++k)
+    {
+        LineCount l1 = 0;
+        LineCount l2 = 0;
+        while((l1 < ranges[k].size1 || l2 < ranges[k].size2) && it != diffList.end())
+        {
+            l1 += it->numberOfEquals() + it->diff1();
+            l2 += it->numberOfEquals() + it->diff2();
+            rangeDiffs[k].push_back(*it);
+            ++it;
+        }
+
+        if(l1 != ranges[k].size1 || l2 != ranges[k].size2)
+            return false;
+    }
+
+    return it == diffList.end();
+}
+
+bool ManualDiffHelpList::runDiff(const QVector<LineData>* p1, LineRef size1, const QVector<LineData>* p2, LineRef size2, DiffList& diffList,
+                                 e_SrcSelector winIdx1, e_SrcSelector winIdx2,
+                                 const QSharedPointer<Options> &pOptions,
+                                 const QVector<size_t>* pHashes1, const QVector<size_t>* pHashes2,
+                                 const ManualDiffHelpList* pOldManualDiffHelpList, const DiffList* pOldDiffList)
+{
+    TraceSpan span("runDiff", (qint64)size1 + size2);
+    QVector<DiffRange> ranges;
+    getManualDiffRanges(*this, size1, size2, winIdx1, winIdx2, ranges);
+
+    // Ranges that are the same as before keep their diffs, usually only the ones next to a changed alignment differ.
+    QVector<DiffRange> oldRanges;
+    QVector<DiffList> oldRangeDiffs;
+    if(pOldManualDiffHelpList != nullptr && pOldDiffList != nullptr)
+    {
+        getManualDiffRanges(*pOldManualDiffHelpList, size1, size2, winIdx1, winIdx2, oldRanges);
+        if(!splitDiffList(*pOldDiffList, oldRanges, oldRangeDiffs))
+        {
+            oldRanges.clear();
+            oldRangeDiffs.clear();
+        }
+    }
+    diffList.clear();
+    diffList.setDegraded(false);
+
+    QVector<DiffList> rangeDiffs(ranges.size());
+    QVector<DiffRange> parts;
+    QVector<qint32> partRanges; // The range each part belongs to.
+    qint32 nofRangesToCompare = 0;
+    qint32 oldIdx = 0;
+    for(qint32 k = 0; k < ranges.size(); ++k)
+    {
+        const DiffRange& range = ranges[k];
+
+        // Both lists of ranges are ordered.
+        while(oldIdx < oldRanges.size() && lessRange(oldRanges[oldIdx], range))
+            ++oldIdx;
+        if(oldIdx < oldRanges.size() && !lessRange(range, oldRanges[oldIdx]))
+        {
+            rangeDiffs[k].swap(oldRangeDiffs[oldIdx]);
+            // Which range was degraded is not known, so keep the old state.
+            diffList.setDegraded(diffList.isDegraded() || pOldDiffList->isDegraded());
+            continue;
+        }
+
+        ++nofRangesToCompare;
+        if(pHashes1 != nullptr && pHashes2 != nullptr && range.size1 + range.size2 >= minLinesForAnchoredDiff)
+            splitAtAnchors(range, *pHashes1, *pHashes2, parts);
+        else
+            parts.push_back(range);
+
+        while(partRanges.size() < parts.size())
+            partRanges.push_back(k);
+    }
+
+    if(!oldRanges.isEmpty())
+        qCInfo(kdiffMain) << "Comparing" << nofRangesToCompare << "of" << ranges.size() << "ranges again";
+
+    QVector<DiffList> partDiffs(parts.size());
+    if(parts.size() == nofRangesToCompare)
+    {
+        for(qint32 k = 0; k < parts.size(); ++k)
+            partDiffs[k].runDiff(p1, parts[k].begin1, parts[k].size1, p2, parts[k].begin2, parts[k].size2, pOptions, pHashes1, pHashes2);
+    }
+    else
+    {
+        qCInfo(kdiffMain) << "Comparing" << parts.size() << "parts in parallel";
+        ProgressProxy pp;
+        QSemaphore finishedParts;
+        for(qint32 k = 0; k < parts.size(); ++k)
+        {
+            RangeDiffRunnable* pRunnable = new RangeDiffRunnable(p1, p2, parts[k], pOptions, pHashes1, pHashes2, partDiffs[k], finishedParts);
+            startOrRunHere(pRunnable);
+        }
+
+        // wasCancelled() keeps processing events while the parts are compared.
+        while(!finishedParts.tryAcquire(parts.size(), 100))
+            pp.wasCancelled();
+    }
+
+    for(qint32 k = 0; k < parts.size(); ++k)
+    {
+        rangeDiffs[partRanges[k]].insert(rangeDiffs[partRanges[k]].end(), partDiffs[k].begin(), partDiffs[k].end());
+        diffList.setDegraded(diffList.isDegraded() || partDiffs[k].isDegraded());
+    }
+
+    for(const DiffList& rangeDiff : rangeDiffs)
+        diffList.insert(diffList.end(), rangeDiff.begin(), rangeDiff.end());
     return true;
 }
 
@@ -893,6 +1718,7 @@ void Diff3LineList::correctManualDiffAlignment(ManualDiffHelpList* pManualDiffHe
 void Diff3LineList::calcDiff3LineListTrim(
     const QVector<LineData>* pldA, const QVector<LineData>* pldB, const QVector<LineData>* pldC, ManualDiffHelpList* pManualDiffHelpList)
 {
+    TraceSpan span("calcDiff3LineListTrim", size());
     const Diff3Line d3l_empty = Diff3Line();//gcc 6.3 is over zealous about insisisting on explict initialization of a const.
     remove(d3l_empty);
 
@@ -1360,13 +2186,36 @@ void calcDiff(const QString& line1, const QString& line2, DiffList& diffList, in
     }
 }
 
-bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector, const QVector<LineData>* v1, const QVector<LineData>* v2)
+// Character level diff of two lines that are not equal.
+static void calcFineDiffList(const QString& line1, const QString& line2, DiffList& diffList)
 {
-    LineRef k1 = 0;
-    LineRef k2 = 0;
-    int maxSearchLength = 500;
-    bool bTextsTotalEqual = inBTextsTotalEqual;
+    FineDiffEngine::forLines(line1, line2).calcDiff(line1, line2, diffList);
+
+    // Optimize the diff list.
+    DiffList::iterator dli;
+    bool bUsefulFineDiff = false;
+    for(dli = diffList.begin(); dli != diffList.end(); ++dli)
+    {
+        if(dli->numberOfEquals() >= 4)
+        {
+            bUsefulFineDiff = true;
+            break;
+        }
+    }
 
+    for(dli = diffList.begin(); dli != diffList.end(); ++dli)
+    {
+        if(dli->numberOfEquals() < 4 && (dli->diff1() > 0 || dli->diff2() > 0) && !(bUsefulFineDiff && dli == diffList.begin()))
+        {
+            dli->adjustDiff1(dli->numberOfEquals());
+            dli->adjustDiff2(dli->numberOfEquals());
+            dli->setNumberOfEquals(0);
+        }
+    }
+}
+
+void Diff3Line::getLinesForFineDiff(const e_SrcSelector selector, LineRef& k1, LineRef& k2) const
+{
     Q_ASSERT(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
 
     if(selector == e_SrcSelector::A)
@@ -1384,40 +2233,34 @@ bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector,
         k1 = getLineC();
         k2 = getLineA();
     }
+}
+
+bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector, const QVector<LineData>* v1, const QVector<LineData>* v2,
+                         FineDiffStore* pLazyStore)
+{
+    LineRef k1 = 0;
+    LineRef k2 = 0;
+    bool bTextsTotalEqual = inBTextsTotalEqual;
+
+    getLinesForFineDiff(selector, k1, k2);
 
     qDebug(kdiffCore) << "k1 = " << k1 << ", k2 = " << k2;
     if((!k1.isValid() && k2.isValid()) || (k1.isValid() && !k2.isValid())) bTextsTotalEqual = false;
     if(k1.isValid() && k2.isValid())
     {
-        if((*v1)[k1].size() != (*v2)[k2].size() || QString::compare((*v1)[k1].getLine(), (*v2)[k2].getLine()) != 0)
+        if(!LineData::sameText((*v1)[k1], (*v2)[k2]))
         {
             bTextsTotalEqual = false;
-            DiffList* pDiffList = new DiffList;
-            calcDiff((*v1)[k1].getLine(), (*v2)[k2].getLine(), *pDiffList, 2, maxSearchLength);
-
-            // Optimize the diff list.
-            DiffList::iterator dli;
-            bool bUsefulFineDiff = false;
-            for(dli = pDiffList->begin(); dli != pDiffList->end(); ++dli)
+            if(pLazyStore != nullptr)
             {
-                if(dli->numberOfEquals() >= 4)
-                {
-                    bUsefulFineDiff = true;
-                    break;
-                }
+                setPendingFineDiff(selector, pLazyStore);
             }
-
-            for(dli = pDiffList->begin(); dli != pDiffList->end(); ++dli)
+            else
             {
-                if(dli->numberOfEquals() < 4 && (dli->diff1() > 0 || dli->diff2() > 0) && !(bUsefulFineDiff && dli == pDiffList->begin()))
-                {
-                    dli->adjustDiff1(dli->numberOfEquals());
-                    dli->adjustDiff2(dli->numberOfEquals());
-                    dli->setNumberOfEquals(0);
-                }
+                DiffList diffList;
+                calcFineDiffList((*v1)[k1].getLine(), (*v2)[k2].getLine(), diffList);
+                setFineDiff(selector, diffList);
             }
-
-            setFineDiff(selector, pDiffList);
         }
 
         if(((*v1)[k1].isPureComment() || (*v1)[k1].whiteLine()) && ((*v2)[k2].isPureComment() || (*v2)[k2].whiteLine()))
@@ -1440,6 +2283,51 @@ bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector,
     return bTextsTotalEqual;
 }
 
+DiffList* Diff3Line::getFineDiff(const e_SrcSelector selector) const
+{
+    Q_ASSERT(m_pFineDiffs != nullptr);
+    if(m_pFineDiffs->pStore != nullptr)
+    {
+        QMutexLocker locker(&m_pFineDiffs->pStore->mutex());
+        computePendingFineDiff(selector);
+    }
+
+    if(selector == e_SrcSelector::A)
+        return &m_pFineDiffs->fineAB;
+    else if(selector == e_SrcSelector::B)
+        return &m_pFineDiffs->fineBC;
+    else
+        return &m_pFineDiffs->fineCA;
+}
+
+// The caller holds the mutex of the store.
+void Diff3Line::computePendingFineDiff(const e_SrcSelector selector) const
+{
+    bool& bPending = selector == e_SrcSelector::A ? m_pFineDiffs->bPendingAB : selector == e_SrcSelector::B ? m_pFineDiffs->bPendingBC : m_pFineDiffs->bPendingCA;
+    if(!bPending)
+        return;
+
+    LineRef k1;
+    LineRef k2;
+    getLinesForFineDiff(selector, k1, k2);
+
+    const FineDiffStore* pStore = m_pFineDiffs->pStore;
+    DiffList& diffList = selector == e_SrcSelector::A ? m_pFineDiffs->fineAB : selector == e_SrcSelector::B ? m_pFineDiffs->fineBC : m_pFineDiffs->fineCA;
+    calcFineDiffList(pStore->lineData1(selector)[k1].getLine(), pStore->lineData2(selector)[k2].getLine(), diffList);
+    bPending = false;
+}
+
+void Diff3Line::computePendingFineDiffs()
+{
+    if(m_pFineDiffs == nullptr || m_pFineDiffs->pStore == nullptr)
+        return;
+
+    QMutexLocker locker(&m_pFineDiffs->pStore->mutex());
+    computePendingFineDiff(e_SrcSelector::A);
+    computePendingFineDiff(e_SrcSelector::B);
+    computePendingFineDiff(e_SrcSelector::C);
+}
+
 void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, LineRef& lineIdx,
                             DiffList*& pFineDiff1, DiffList*& pFineDiff2, // return values
                             ChangeFlags& changed, ChangeFlags& changed2) const
@@ -1454,8 +2342,8 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
     if(winIdx == e_SrcSelector::A)
     {
         lineIdx = getLineA();
-        pFineDiff1 = pFineAB;
-        pFineDiff2 = pFineCA;
+        pFineDiff1 = fineAB();
+        pFineDiff2 = fineCA();
 
         changed = ((!getLineB().isValid()) != (!lineIdx.isValid()) ? AChanged : NoChange) |
                    ((!getLineC().isValid()) != (!lineIdx.isValid()) && isTriple ? BChanged : NoChange);
@@ -1464,8 +2352,8 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
     else if(winIdx == e_SrcSelector::B)
     {
         lineIdx = getLineB();
-        pFineDiff1 = pFineBC;
-        pFineDiff2 = pFineAB;
+        pFineDiff1 = fineBC();
+        pFineDiff2 = fineAB();
         changed = ((!getLineC().isValid()) != (!lineIdx.isValid()) && isTriple ? AChanged : NoChange) |
                    ((!getLineA().isValid()) != (!lineIdx.isValid()) ? BChanged : NoChange);
         changed2 = (bBEqualC || !isTriple ? NoChange : AChanged) | (bAEqualB ? NoChange : BChanged);
@@ -1473,32 +2361,164 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
     else if(winIdx == e_SrcSelector::C)
     {
         lineIdx = getLineC();
-        pFineDiff1 = pFineCA;
-        pFineDiff2 = pFineBC;
+        pFineDiff1 = fineCA();
+        pFineDiff2 = fineBC();
         changed = ((!getLineA().isValid()) != (!lineIdx.isValid()) ? AChanged : NoChange) |
                    ((!getLineB().isValid()) != (!lineIdx.isValid()) ? BChanged : NoChange);
         changed2 = (bAEqualC ? NoChange : AChanged) | (bBEqualC ? NoChange : BChanged);
     }
 }
 
-bool Diff3LineList::fineDiff(const e_SrcSelector selector, const QVector<LineData>* v1, const QVector<LineData>* v2)
+/*
+    Fine diff of a contiguous range of a Diff3LineList. Each line only touches its own Diff3Line.
+*/
+class FineDiffRunnable : public QRunnable
+{
+  private:
+    Diff3LineList::iterator m_begin;
+    Diff3LineList::iterator m_end;
+    e_SrcSelector m_selector;
+    const QVector<LineData>* m_v1;
+    const QVector<LineData>* m_v2;
+    FineDiffStore* m_pLazyStore;
+    bool& m_bTextsTotalEqual;
+    QSemaphore& m_finished;
+
+  public:
+    FineDiffRunnable(const Diff3LineList::iterator& begin, const Diff3LineList::iterator& end, e_SrcSelector selector,
+                     const QVector<LineData>* v1, const QVector<LineData>* v2, FineDiffStore* pLazyStore, bool& bTextsTotalEqual, QSemaphore& finished)
+        : m_begin(begin), m_end(end), m_selector(selector), m_v1(v1), m_v2(v2), m_pLazyStore(pLazyStore), m_bTextsTotalEqual(bTextsTotalEqual), m_finished(finished)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        bool bTextsTotalEqual = true;
+        for(Diff3LineList::iterator i = m_begin; i != m_end; ++i)
+        {
+            bTextsTotalEqual = i->fineDiff(bTextsTotalEqual, m_selector, m_v1, m_v2, m_pLazyStore);
+        }
+        m_bTextsTotalEqual = bTextsTotalEqual;
+        m_finished.release();
+    }
+};
+
+static const qint32 minLinesForLazyFineDiff = 100000;
+
+bool Diff3LineList::fineDiff(const e_SrcSelector selector, const QVector<LineData>* v1, const QVector<LineData>* v2, bool bLinesOnly)
 {
     // Finetuning: Diff each line with deltas
+    TraceSpan span("fineDiff", size());
     ProgressProxy pp;
     Diff3LineList::iterator i;
     bool bTextsTotalEqual = true;
-    int listSize = size();
-    pp.setMaxNofSteps(listSize);
-    int listIdx = 0;
-    for(i = begin(); i != end(); ++i)
+    const int listSize = size();
+    const int minChunkSize = 256;
+    // A few chunks per thread so that chunks with many changed lines don't hold up the others.
+    const int nofChunks = std::max(1, std::min(listSize / minChunkSize, 4 * QThreadPool::globalInstance()->maxThreadCount()));
+
+    // For large comparisons only the lines are compared here, the fine diffs are computed when needed.
+    FineDiffStore* pLazyStore = nullptr;
+    if((bLinesOnly || listSize >= minLinesForLazyFineDiff) && v1 != nullptr && v2 != nullptr)
     {
-        bTextsTotalEqual = i->fineDiff(bTextsTotalEqual, selector, v1, v2);
-        ++listIdx;
+        if(m_pFineDiffStore == nullptr)
+            m_pFineDiffStore = QSharedPointer<FineDiffStore>::create();
+        m_pFineDiffStore->setLineData(selector, *v1, *v2);
+        pLazyStore = m_pFineDiffStore.data();
+    }
+
+    pp.setMaxNofSteps(nofChunks);
+    if(nofChunks == 1)
+    {
+        for(i = begin(); i != end(); ++i)
+        {
+            bTextsTotalEqual = i->fineDiff(bTextsTotalEqual, selector, v1, v2, pLazyStore);
+        }
+        pp.step();
+        return bTextsTotalEqual;
+    }
+
+    // Each chunk reports its own result, they are combined below.
+    QVector<bool> chunkTextsTotalEqual(nofChunks, true);
+    QSemaphore finishedChunks;
+    i = begin();
+    for(int chunk = 0; chunk < nofChunks; ++chunk)
+    {
+        Diff3LineList::iterator chunkBegin = i;
+        if(chunk == nofChunks - 1)
+            i = end();
+        else
+            std::advance(i, listSize / nofChunks);
+
+        FineDiffRunnable* pRunnable = new FineDiffRunnable(chunkBegin, i, selector, v1, v2, pLazyStore, chunkTextsTotalEqual[chunk], finishedChunks);
+        startOrRunHere(pRunnable);
+    }
+
+    for(int chunk = 0; chunk < nofChunks; ++chunk)
+    {
+        // wasCancelled() keeps processing events while the chunks are compared.
+        while(!finishedChunks.tryAcquire(1, 100))
+            pp.wasCancelled();
         pp.step();
     }
+
+    for(const bool bChunkTextsTotalEqual : chunkTextsTotalEqual)
+    {
+        bTextsTotalEqual = bTextsTotalEqual && bChunkTextsTotalEqual;
+    }
     return bTextsTotalEqual;
 }
 
+/*
+    Computes the pending fine diffs of a whole Diff3LineList, so they are ready before the lines are shown.
+*/
+class BackgroundFineDiffRunnable : public TaskGroup::Task
+{
+  private:
+    Diff3LineList* m_pDiff3LineList;
+
+  public:
+    BackgroundFineDiffRunnable(TaskGroup& group, Diff3LineList* pDiff3LineList)
+        : Task(group), m_pDiff3LineList(pDiff3LineList)
+    {
+    }
+
+  protected:
+    void execute() override
+    {
+        for(Diff3LineList::iterator i = m_pDiff3LineList->begin(); i != m_pDiff3LineList->end() && !isCancelled(); ++i)
+        {
+            i->computePendingFineDiffs();
+        }
+    }
+};
+
+void Diff3LineList::startBackgroundFineDiff()
+{
+    if(m_pFineDiffStore == nullptr || m_pFineDiffStore->m_bBackgroundStarted)
+        return;
+
+    m_pFineDiffStore->m_bBackgroundStarted = true;
+    // Lines being shown compute their fine diff themselves, so this waits behind other work.
+    TaskGroup& tasks = m_pFineDiffStore->m_backgroundTasks;
+    tasks.add(new BackgroundFineDiffRunnable(tasks, this), TaskGroup::e_Priority::Background);
+    tasks.startPending();
+}
+
+void Diff3LineList::stopBackgroundFineDiff()
+{
+    if(m_pFineDiffStore == nullptr)
+        return;
+
+    if(m_pFineDiffStore->m_bBackgroundStarted)
+    {
+        m_pFineDiffStore->m_backgroundTasks.cancel();
+        m_pFineDiffStore->m_backgroundTasks.wait();
+    }
+    m_pFineDiffStore.reset();
+}
+
 // Convert the list to a vector of pointers
 void Diff3LineList::calcDiff3LineVector(Diff3LineVector& d3lv)
 {
@@ -1512,6 +2532,23 @@ void Diff3LineList::calcDiff3LineVector(Diff3LineVector& d3lv)
     Q_ASSERT(j == d3lv.size());
 }
 
+qint64 Diff3LineList::memoryUsage() const
+{
+    qint64 bytes = MemoryUsage::ofListNodes<Diff3Line>(std::list<Diff3Line, BlockAllocator<Diff3Line>>::size());
+    // Pending fine diffs are not computed here, the background may be setting them meanwhile.
+    QScopedPointer<QMutexLocker> pLocker;
+    if(m_pFineDiffStore != nullptr)
+        pLocker.reset(new QMutexLocker(&m_pFineDiffStore->mutex()));
+
+    for(const Diff3Line& d3l: *this)
+    {
+        const Diff3Line::FineDiffs* pFineDiffs = d3l.m_pFineDiffs;
+        if(pFineDiffs != nullptr)
+            bytes += (qint64)sizeof(Diff3Line::FineDiffs) + pFineDiffs->fineAB.memoryUsage() + pFineDiffs->fineBC.memoryUsage() + pFineDiffs->fineCA.memoryUsage();
+    }
+    return bytes;
+}
+
 // Just make sure that all input lines are in the output too, exactly once.
 void Diff3LineList::debugLineCheck(const LineCount size, const e_SrcSelector srcSelector) const
 {
@@ -1558,27 +2595,27 @@ void Diff3LineList::debugLineCheck(const LineCount size, const e_SrcSelector src
     }
 }
 
-void Diff3LineList::findHistoryRange(const QRegExp& historyStart, bool bThreeFiles,
+void Diff3LineList::findHistoryRange(const QRegularExpression& historyStart, bool bThreeFiles, const DiffBufferInfo& bufferInfo,
                              Diff3LineList::const_iterator& iBegin, Diff3LineList::const_iterator& iEnd, int& idxBegin, int& idxEnd) const
 {
     QString historyLead;
     // Search for start of history
     for(iBegin = begin(), idxBegin = 0; iBegin != end(); ++iBegin, ++idxBegin)
     {
-        if(historyStart.exactMatch(iBegin->getString(e_SrcSelector::A)) &&
-           historyStart.exactMatch(iBegin->getString(e_SrcSelector::B)) &&
-           (!bThreeFiles || historyStart.exactMatch(iBegin->getString(e_SrcSelector::C))))
+        if(historyStart.match(iBegin->getString(e_SrcSelector::A, bufferInfo)).hasMatch() &&
+           historyStart.match(iBegin->getString(e_SrcSelector::B, bufferInfo)).hasMatch() &&
+           (!bThreeFiles || historyStart.match(iBegin->getString(e_SrcSelector::C, bufferInfo)).hasMatch()))
         {
-            historyLead = Utils::calcHistoryLead(iBegin->getString(e_SrcSelector::A));
+            historyLead = Utils::calcHistoryLead(iBegin->getString(e_SrcSelector::A, bufferInfo));
             break;
         }
     }
     // Search for end of history
     for(iEnd = iBegin, idxEnd = idxBegin; iEnd != end(); ++iEnd, ++idxEnd)
     {
-        QString sA = iEnd->getString(e_SrcSelector::A);
-        QString sB = iEnd->getString(e_SrcSelector::B);
-        QString sC = iEnd->getString(e_SrcSelector::C);
+        QString sA = iEnd->getString(e_SrcSelector::A, bufferInfo);
+        QString sB = iEnd->getString(e_SrcSelector::B, bufferInfo);
+        QString sC = iEnd->getString(e_SrcSelector::C, bufferInfo);
         if(!((sA.isEmpty() || historyLead == Utils::calcHistoryLead(sA)) &&
              (sB.isEmpty() || historyLead == Utils::calcHistoryLead(sB)) &&
              (!bThreeFiles || sC.isEmpty() || historyLead == Utils::calcHistoryLead(sC))))
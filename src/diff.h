@@ -9,16 +9,25 @@
 #ifndef DIFF_H
 #define DIFF_H
 
+#include "BlockAllocator.h"
 #include "common.h"
 #include "fileaccess.h"
 #include "LineRef.h"
 #include "SourceData.h"
+#include "TextChunk.h"
 #include "Logging.h"
+#include "TaskGroup.h"
 
 #include <QList>
+#include <QMutex>
 #include <QVector>
 
+#include <utility>
+#include <vector>
+
 class Options;
+class QRegularExpression;
+class QRegularExpressionMatch;
 
 //e_SrcSelector must be sequential with no gaps between Min and Max.
 enum class e_SrcSelector
@@ -109,28 +118,93 @@ class Diff
     inline void adjustDiff2(const qint64 delta) { mDiff2 += delta; }
 };
 
-class DiffList : public std::list<Diff>
+/*
+    All options the line diffs of a comparison depend on besides the lines themselves. Diff lists are
+    only reused for a new comparison while these are unchanged, see DiffList::rerunDiff().
+*/
+struct LineDiffOptions
+{
+    bool bIgnoreNumbers = false;
+    bool bIgnoreCase = false;
+    bool bIgnoreComments = false;
+    bool bTryHard = false;
+    bool bDiff3AlignBC = false;
+    e_DiffAlgorithm diffAlgorithm = eDiffAlgorithmGnuDiff;
+    int diffTimeLimit = 0;
+    QString preProcessorCmd;
+    QString lineMatchingPreProcessorCmd;
+
+    static LineDiffOptions of(const Options& options);
+    bool operator==(const LineDiffOptions& other) const;
+    bool operator!=(const LineDiffOptions& other) const { return !(*this == other); }
+};
+
+// The entries are kept in one block of memory, most fine diffs need only a single allocation.
+class DiffList : public std::vector<Diff>
 {
   public:
-    bool runDiff(const QVector<LineData>* p1, const qint32 index1, LineRef size1, const QVector<LineData>* p2, const qint32 index2, LineRef size2, const QSharedPointer<Options>& pOptions);
+    // pHashes1/2 optionally provide the per line hashes from SourceData::getLineHashesForDiff().
+    bool runDiff(const QVector<LineData>* p1, const qint32 index1, LineRef size1, const QVector<LineData>* p2, const qint32 index2, LineRef size2, const QSharedPointer<Options>& pOptions,
+                 const QVector<size_t>* pHashes1 = nullptr, const QVector<size_t>* pHashes2 = nullptr);
+    /*
+        Recomputes oldDiffList after both inputs were reloaded. The diffs between lines at the start and end that
+        are unchanged in both inputs are reused, only the lines in between are compared again.
+        pOld1/2 is the line data oldDiffList was computed with.
+    */
+    bool rerunDiff(const DiffList& oldDiffList, const QVector<LineData>* pOld1, const QVector<LineData>* pOld2,
+                   const QVector<LineData>* p1, LineRef size1, const QVector<LineData>* p2, LineRef size2, const QSharedPointer<Options>& pOptions,
+                   const QVector<size_t>* pHashes1 = nullptr, const QVector<size_t>* pHashes2 = nullptr);
+
+    /*
+        Takes the alignment of two inputs from a unified diff computed elsewhere, instead of runDiff().
+        A hunk without content lines counts as changed as a whole, so a list of hunk headers will do.
+        Returns false with the reason if the diff doesn't fit inputs of these sizes.
+    */
+    bool readUnifiedDiff(const QByteArray& patch, LineRef size1, LineRef size2, QString& errorReason);
+
+    // True if the time limit of the comparison was hit, the result is valid but not as good as possible.
+    inline bool isDegraded() const { return m_bDegraded; }
+    inline void setDegraded(const bool bDegraded) { m_bDegraded = bDegraded; }
+
+    qint64 memoryUsage() const { return (qint64)capacity() * (qint64)sizeof(Diff); }
+
+    void swap(DiffList& other)
+    {
+        std::vector<Diff>::swap(other);
+        std::swap(m_bDegraded, other.m_bDegraded);
+    }
+
+  private:
+    bool m_bDegraded = false;
+
+    void runGnuDiff(const QVector<LineData>* p1, const qint32 index1, LineRef size1, const QVector<LineData>* p2, const qint32 index2, LineRef size2, const QSharedPointer<Options>& pOptions,
+                    const QVector<size_t>* pHashes1, const QVector<size_t>* pHashes2);
+    void runHistogramDiff(const QVector<LineData>* p1, const qint32 index1, LineRef size1, const QVector<LineData>* p2, const qint32 index2, LineRef size2, const QSharedPointer<Options>& pOptions,
+                          const QVector<size_t>* pHashes1, const QVector<size_t>* pHashes2);
 };
 
+/*
+    A line of the text of a SourceData. The text chunk is not kept alive by the line, the FileData
+    owns it, so a line is 24 bytes and copying one touches no reference count. Copies that may
+    outlive their SourceData go into a LineDataSnapshot.
+*/
 class LineData
 {
   private:
-    QSharedPointer<QString> mBuffer;
+    const TextChunk* mBuffer = nullptr;
     //QString pLine;
-    QtNumberType mFirstNonWhiteChar = 0;
-    qint64 mOffset = 0;
+    QtNumberType mOffset = 0; // A text chunk holds less than 2^31 characters
     QtNumberType mSize = 0;
+    QtNumberType mFirstNonWhiteChar = 0;
     bool bContainsPureComment = false;//TODO: Move me
 
   public:
     explicit LineData() = default; // needed for Qt internal reasons should not be used.
-    inline LineData(const QSharedPointer<QString> &buffer, const qint64 inOffset, QtNumberType inSize = 0, QtNumberType inFirstNonWhiteChar=0, bool inIsPureComment=false)
+    inline LineData(const TextChunk* buffer, const qint64 inOffset, QtNumberType inSize = 0, QtNumberType inFirstNonWhiteChar=0, bool inIsPureComment=false)
     {
+        Q_ASSERT(inOffset <= TYPE_MAX(QtNumberType));
         mBuffer = buffer;
-        mOffset = inOffset;
+        mOffset = (QtNumberType)inOffset;
         mSize = inSize;
         bContainsPureComment = inIsPureComment;
         mFirstNonWhiteChar = inFirstNonWhiteChar;
@@ -140,9 +214,23 @@ class LineData
 
     /*
         QString::fromRawData allows us to create a light weight QString backed by the buffer memmory.
+        A Latin-1 buffer can only give a copy, the kernels read it through latin1() instead.
     */
-    Q_REQUIRED_RESULT inline const QString getLine() const { return QString::fromRawData(mBuffer->data() + mOffset, mSize); }
-    Q_REQUIRED_RESULT inline const QSharedPointer<QString>& getBuffer() const { return mBuffer; }
+    Q_REQUIRED_RESULT inline const QString getLine() const { return mBuffer->mid(mOffset, mSize); }
+    // Without the copy getLine() makes of Latin-1 text.
+    inline void appendTo(QString& s) const
+    {
+        if(isLatin1())
+            s.append(QLatin1String(latin1(), mSize));
+        else
+            s.append(utf16(), mSize);
+    }
+    Q_REQUIRED_RESULT inline const TextChunk* getBuffer() const { return mBuffer; }
+
+    Q_REQUIRED_RESULT inline bool isLatin1() const { return mBuffer->isLatin1(); }
+    // The characters of the line, depending on isLatin1().
+    Q_REQUIRED_RESULT inline const QChar* utf16() const { return mBuffer->utf16(mOffset); }
+    Q_REQUIRED_RESULT inline const char* latin1() const { return mBuffer->latin1(mOffset); }
 
     Q_REQUIRED_RESULT inline qint64 getOffset() const { return mOffset; }
     Q_REQUIRED_RESULT int width(int tabSize) const; // Calcs width considering tabs.
@@ -153,6 +241,29 @@ class LineData
     inline void setPureComment(const bool bPureComment) { bContainsPureComment = bPureComment; }
 
     static bool equal(const LineData& l1, const LineData& l2);
+    // Unlike equal() white space counts.
+    static bool sameText(const LineData& l1, const LineData& l2);
+    // GnuDiff::line_hash() of the line.
+    Q_REQUIRED_RESULT size_t hash(bool bIgnoreNumbers) const;
+};
+
+Q_DECLARE_TYPEINFO(LineData, Q_MOVABLE_TYPE);
+
+/*
+    A copy of line data that stays valid after its SourceData is reset or loaded again. The lines
+    don't keep their text chunks alive, the snapshot holds them as well.
+*/
+class LineDataSnapshot
+{
+  public:
+    LineDataSnapshot() = default;
+    explicit LineDataSnapshot(const QVector<LineData>& lines);
+
+    inline const QVector<LineData>& lines() const { return m_lines; }
+
+  private:
+    QVector<LineData> m_lines;
+    QVector<QSharedPointer<const TextChunk>> m_chunks;
 };
 
 class ManualDiffHelpList; // A list of corresponding ranges
@@ -160,18 +271,54 @@ class ManualDiffHelpList; // A list of corresponding ranges
 class Diff3LineList;
 class Diff3LineVector;
 
+/*
+    Line data of a comparison whose fine diffs are computed on first use instead of all at once.
+    A pool thread computes the ones nobody asked for yet in the background. The mutex guards the
+    pending fine diffs of all lines.
+*/
+class FineDiffStore
+{
+  public:
+    // For the fine diff between v1 and v2 of Diff3Line::fineDiff(). The store keeps snapshots,
+    // so the lines stay valid for the background thread even if the source data is reset meanwhile.
+    void setLineData(const e_SrcSelector selector, const QVector<LineData>& v1, const QVector<LineData>& v2)
+    {
+        m_lineData1[(int)selector - 1] = LineDataSnapshot(v1);
+        m_lineData2[(int)selector - 1] = LineDataSnapshot(v2);
+    }
+
+    inline const QVector<LineData>& lineData1(const e_SrcSelector selector) const { return m_lineData1[(int)selector - 1].lines(); }
+    inline const QVector<LineData>& lineData2(const e_SrcSelector selector) const { return m_lineData2[(int)selector - 1].lines(); }
+
+    inline QMutex& mutex() { return m_mutex; }
+
+  private:
+    friend class Diff3LineList;
+
+    LineDataSnapshot m_lineData1[3];
+    LineDataSnapshot m_lineData2[3];
+    QMutex m_mutex;
+
+    bool m_bBackgroundStarted = false;
+    TaskGroup m_backgroundTasks;
+};
+
+/*
+    The line data one comparison was made with. Each comparison has its own, the Diff3Lines
+    of the comparison are read through it, so several comparisons can exist at the same time.
+*/
 class DiffBufferInfo
 {
   private:
-    const QVector<LineData>* mLineDataA;
-    const QVector<LineData>* mLineDataB;
-    const QVector<LineData>* mLineDataC;
-
-    LineCount m_sizeA;
-    LineCount m_sizeB;
-    LineCount m_sizeC;
-    const Diff3LineList* m_pDiff3LineList;
-    const Diff3LineVector* m_pDiff3LineVector;
+    const QVector<LineData>* mLineDataA = nullptr;
+    const QVector<LineData>* mLineDataB = nullptr;
+    const QVector<LineData>* mLineDataC = nullptr;
+
+    LineCount m_sizeA = 0;
+    LineCount m_sizeB = 0;
+    LineCount m_sizeC = 0;
+    const Diff3LineList* m_pDiff3LineList = nullptr;
+    const Diff3LineVector* m_pDiff3LineVector = nullptr;
 public:
     void init(Diff3LineList* d3ll, const Diff3LineVector* d3lv,
               const QVector<LineData>* pldA, LineCount sizeA, const QVector<LineData>* pldB, LineCount sizeB, const QVector<LineData>* pldC, LineCount sizeC);
@@ -200,33 +347,46 @@ class Diff3Line
     LineRef lineB;
     LineRef lineC;
 
-    bool bAEqC = false; // These are true if equal or only white-space changes exist.
-    bool bBEqC = false;
-    bool bAEqB = false;
-
-    bool bWhiteLineA = false;
-    bool bWhiteLineB = false;
-    bool bWhiteLineC  = false;
-
-    DiffList* pFineAB = nullptr; // These are NULL only if completely equal or if either source doesn't exist.
-    DiffList* pFineBC = nullptr;
-    DiffList* pFineCA = nullptr;
+    // There is a Diff3Line for every line of the comparison, so keep it small.
+    bool bAEqC : 1; // These are true if equal or only white-space changes exist.
+    bool bBEqC : 1;
+    bool bAEqB : 1;
 
+    bool bWhiteLineA : 1;
+    bool bWhiteLineB : 1;
+    bool bWhiteLineC : 1;
 
     qint32 mLinesNeededForDisplay = 1;    // Due to wordwrap
     qint32 mSumLinesNeededForDisplay = 0; // For fast conversion to m_diff3WrapLineVector
 
+    // Most lines have no fine diffs, so these are only allocated for lines that have one, all three in one block.
+    struct FineDiffs
+    {
+        // A list is not set if the lines are completely equal or if either source doesn't exist.
+        bool bHasFineAB = false;
+        bool bHasFineBC = false;
+        bool bHasFineCA = false;
+        // A list that is set but not computed yet, pStore->mutex() guards these and the lists.
+        bool bPendingAB = false;
+        bool bPendingBC = false;
+        bool bPendingCA = false;
+        FineDiffStore* pStore = nullptr;
+        DiffList fineAB;
+        DiffList fineBC;
+        DiffList fineCA;
+    };
+    FineDiffs* m_pFineDiffs = nullptr;
+
   public:
-    static QSharedPointer<DiffBufferInfo> m_pDiffBufferInfo; // For convenience
+    Diff3Line():
+        bAEqC(false), bBEqC(false), bAEqB(false), bWhiteLineA(false), bWhiteLineB(false), bWhiteLineC(false)
+    {
+    }
 
     ~Diff3Line()
     {
-        if(pFineAB != nullptr) delete pFineAB;
-        if(pFineBC != nullptr) delete pFineBC;
-        if(pFineCA != nullptr) delete pFineCA;
-        pFineAB = nullptr;
-        pFineBC = nullptr;
-        pFineCA = nullptr;
+        delete m_pFineDiffs;
+        m_pFineDiffs = nullptr;
     }
     LineRef getLineA() const { return lineA; }
     LineRef getLineB() const { return lineB; }
@@ -264,19 +424,22 @@ class Diff3Line
         return lineA == d3l.lineA && lineB == d3l.lineB && lineC == d3l.lineC && bAEqB == d3l.bAEqB && bAEqC == d3l.bAEqC && bBEqC == d3l.bBEqC;
     }
 
-    const LineData* getLineData(e_SrcSelector src) const
+    // The line of src in the comparison bufferInfo belongs to.
+    const LineData* getLineData(e_SrcSelector src, const DiffBufferInfo& bufferInfo) const
     {
-        Q_ASSERT(m_pDiffBufferInfo != nullptr);
+        const QVector<LineData>* pLineData = bufferInfo.getLineData(src);
+        if(pLineData == nullptr)
+            return nullptr;
         //Use at() here not [] to avoid using really weird syntax
-        if(src == e_SrcSelector::A && lineA.isValid()) return &m_pDiffBufferInfo->getLineData(src)->at(lineA);
-        if(src == e_SrcSelector::B && lineB.isValid()) return &m_pDiffBufferInfo->getLineData(src)->at(lineB);
-        if(src == e_SrcSelector::C && lineC.isValid()) return &m_pDiffBufferInfo->getLineData(src)->at(lineC);
+        if(src == e_SrcSelector::A && lineA.isValid()) return &pLineData->at(lineA);
+        if(src == e_SrcSelector::B && lineB.isValid()) return &pLineData->at(lineB);
+        if(src == e_SrcSelector::C && lineC.isValid()) return &pLineData->at(lineC);
 
         return nullptr;
     }
-    const QString getString(const e_SrcSelector src) const
+    const QString getString(const e_SrcSelector src, const DiffBufferInfo& bufferInfo) const
     {
-        const LineData* pld = getLineData(src);
+        const LineData* pld = getLineData(src, bufferInfo);
         if(pld)
             return pld->getLine();
         else
@@ -295,43 +458,107 @@ class Diff3Line
     inline qint32 linesNeededForDisplay() const { return mLinesNeededForDisplay; }
 
     void setLinesNeeded(const qint32 lines) { mLinesNeededForDisplay = lines; }
-    bool fineDiff(bool bTextsTotalEqual, const e_SrcSelector selector, const QVector<LineData>* v1, const QVector<LineData>* v2);
+    // With pLazyStore the fine diff itself is only computed on first use.
+    bool fineDiff(bool bTextsTotalEqual, const e_SrcSelector selector, const QVector<LineData>* v1, const QVector<LineData>* v2,
+                  FineDiffStore* pLazyStore = nullptr);
+    void computePendingFineDiffs();
     void mergeOneLine(e_MergeDetails& mergeDetails, bool& bConflict, bool& bLineRemoved, e_SrcSelector& src, bool bTwoInputs) const;
 
     void getLineInfo(const e_SrcSelector winIdx, const bool isTriple, LineRef& lineIdx,
         DiffList*& pFineDiff1, DiffList*& pFineDiff2, // return values
         ChangeFlags& changed, ChangeFlags& changed2) const;
   private:
-    void setFineDiff(const e_SrcSelector selector, DiffList* pDiffList)
+    void getLinesForFineDiff(const e_SrcSelector selector, LineRef& k1, LineRef& k2) const;
+
+    // These only tell if there is a fine diff, without computing a pending one.
+    inline bool hasFineAB() const { return m_pFineDiffs != nullptr && m_pFineDiffs->bHasFineAB; }
+    inline bool hasFineBC() const { return m_pFineDiffs != nullptr && m_pFineDiffs->bHasFineBC; }
+    inline bool hasFineCA() const { return m_pFineDiffs != nullptr && m_pFineDiffs->bHasFineCA; }
+
+    inline DiffList* fineAB() const { return hasFineAB() ? getFineDiff(e_SrcSelector::A) : nullptr; }
+    inline DiffList* fineBC() const { return hasFineBC() ? getFineDiff(e_SrcSelector::B) : nullptr; }
+    inline DiffList* fineCA() const { return hasFineCA() ? getFineDiff(e_SrcSelector::C) : nullptr; }
+
+    // Computes the fine diff first if it is still pending.
+    DiffList* getFineDiff(const e_SrcSelector selector) const;
+    void computePendingFineDiff(const e_SrcSelector selector) const;
+
+    // Takes over the entries of diffList, leaving it empty.
+    void setFineDiff(const e_SrcSelector selector, DiffList& diffList)
     {
         Q_ASSERT(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
+        if(m_pFineDiffs == nullptr)
+            m_pFineDiffs = new FineDiffs;
+
         if(selector == e_SrcSelector::A)
         {
-            if(pFineAB != nullptr)
-                delete pFineAB;
-            pFineAB = pDiffList;
+            m_pFineDiffs->fineAB.swap(diffList);
+            m_pFineDiffs->bHasFineAB = true;
         }
         else if(selector == e_SrcSelector::B)
         {
-            if(pFineBC != nullptr)
-                delete pFineBC;
-            pFineBC = pDiffList;
+            m_pFineDiffs->fineBC.swap(diffList);
+            m_pFineDiffs->bHasFineBC = true;
         }
         else if(selector == e_SrcSelector::C)
         {
-            if(pFineCA)
-                delete pFineCA;
-            pFineCA = pDiffList;
+            m_pFineDiffs->fineCA.swap(diffList);
+            m_pFineDiffs->bHasFineCA = true;
+        }
+        diffList.clear();
+    }
+
+    // Only marks the fine diff as there, it is computed by getFineDiff() or computePendingFineDiffs().
+    void setPendingFineDiff(const e_SrcSelector selector, FineDiffStore* pStore)
+    {
+        Q_ASSERT(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
+        if(m_pFineDiffs == nullptr)
+            m_pFineDiffs = new FineDiffs;
+
+        m_pFineDiffs->pStore = pStore;
+        if(selector == e_SrcSelector::A)
+        {
+            m_pFineDiffs->fineAB.clear();
+            m_pFineDiffs->bHasFineAB = true;
+            m_pFineDiffs->bPendingAB = true;
+        }
+        else if(selector == e_SrcSelector::B)
+        {
+            m_pFineDiffs->fineBC.clear();
+            m_pFineDiffs->bHasFineBC = true;
+            m_pFineDiffs->bPendingBC = true;
+        }
+        else if(selector == e_SrcSelector::C)
+        {
+            m_pFineDiffs->fineCA.clear();
+            m_pFineDiffs->bHasFineCA = true;
+            m_pFineDiffs->bPendingCA = true;
         }
     }
 };
 
-class Diff3LineList : public std::list<Diff3Line>
+/*
+    The lines are allocated in blocks, so walking the list mostly reads memory in order and clearing it
+    releases the memory in one go.
+*/
+class Diff3LineList : public std::list<Diff3Line, BlockAllocator<Diff3Line>>
 {
   public:
-    void findHistoryRange(const QRegExp& historyStart, bool bThreeFiles,
+    ~Diff3LineList() { stopBackgroundFineDiff(); }
+
+    // Stops computing the fine diffs in the background first, the lines must not change while that runs.
+    void clear()
+    {
+        stopBackgroundFineDiff();
+        std::list<Diff3Line, BlockAllocator<Diff3Line>>::clear();
+    }
+
+    void findHistoryRange(const QRegularExpression& historyStart, bool bThreeFiles, const DiffBufferInfo& bufferInfo,
                              Diff3LineList::const_iterator& iBegin, Diff3LineList::const_iterator& iEnd, int& idxBegin, int& idxEnd) const;
-    bool fineDiff(const e_SrcSelector selector, const QVector<LineData>* v1, const QVector<LineData>* v2);
+    // With bLinesOnly just the lines are compared, the fine diffs are left pending as for large lists.
+    bool fineDiff(const e_SrcSelector selector, const QVector<LineData>* v1, const QVector<LineData>* v2, bool bLinesOnly = false);
+    // Computes the fine diffs fineDiff() left pending in a pool thread.
+    void startBackgroundFineDiff();
     void calcDiff3LineVector(Diff3LineVector& d3lv);
     void calcWhiteDiff3Lines(const QVector<LineData>* pldA, const QVector<LineData>* pldB, const QVector<LineData>* pldC);
 
@@ -363,17 +590,20 @@ class Diff3LineList : public std::list<Diff3Line>
     //TODO: Add safety guards to prevent list from getting too large. Same problem as with QLinkedList.
     qint32 size() const
     {
-        if(std::list<Diff3Line>::size() > (size_t)TYPE_MAX(qint32))//explicit cast to silence gcc
+        if(std::list<Diff3Line, BlockAllocator<Diff3Line>>::size() > (size_t)TYPE_MAX(qint32))//explicit cast to silence gcc
         {
-            qCDebug(kdiffMain) << "Diff3Line: List too large. size=" << std::list<Diff3Line>::size();
+            qCDebug(kdiffMain) << "Diff3Line: List too large. size=" << std::list<Diff3Line, BlockAllocator<Diff3Line>>::size();
             Q_ASSERT(false); //Unsupported size
             return 0;
         }
-        return (qint32)std::list<Diff3Line>::size();
+        return (qint32)std::list<Diff3Line, BlockAllocator<Diff3Line>>::size();
     } //safe for small files same limit as exited with QLinkedList. This should ultimatly be removed.
 
     void debugLineCheck(const LineCount size, const e_SrcSelector srcSelector) const;
 
+    // The lines and their fine diffs. The line data of the fine diff store is shared with the SourceData.
+    qint64 memoryUsage() const;
+
     qint32 numberOfLines(bool bWordWrap) const 
     {
         if(bWordWrap)
@@ -394,6 +624,12 @@ class Diff3LineList : public std::list<Diff3Line>
             return size();
         }
     }
+
+  private:
+    void stopBackgroundFineDiff();
+
+    // Only set while fine diffs are computed on first use.
+    QSharedPointer<FineDiffStore> m_pFineDiffStore;
 };
 
 class Diff3LineVector : public QVector<Diff3Line*>
@@ -424,6 +660,7 @@ class TotalDiffStatus
         nofUnsolvedConflicts = 0;
         nofSolvedConflicts = 0;
         nofWhitespaceConflicts = 0;
+        bDiffDegraded = false;
     }
 
     inline int getUnsolvedConflicts() const { return nofUnsolvedConflicts; }
@@ -455,6 +692,10 @@ class TotalDiffStatus
     void setTextEqualBC(const bool equal) { bTextBEqC = equal; }
     void setTextEqualAB(const bool equal) { bTextAEqB = equal; }
 
+    // The diff time limit was hit, the differences may be larger than necessary.
+    bool isDiffDegraded() const { return bDiffDegraded; }
+    void setDiffDegraded(const bool degraded) { bDiffDegraded = degraded; }
+
   private:
     bool bBinaryAEqC = false;
     bool bBinaryBEqC = false;
@@ -463,6 +704,7 @@ class TotalDiffStatus
     bool bTextAEqC = false;
     bool bTextBEqC = false;
     bool bTextAEqB = false;
+    bool bDiffDegraded = false;
     int nofUnsolvedConflicts = 0;
     int nofSolvedConflicts = 0;
     int nofWhitespaceConflicts = 0;
@@ -527,9 +769,15 @@ class ManualDiffHelpList: public std::list<ManualDiffHelpEntry>
         bool isValidMove(int line1, int line2, e_SrcSelector winIdx1, e_SrcSelector winIdx2) const;
         void insertEntry(e_SrcSelector winIdx, LineRef firstLine, LineRef lastLine);
 
+        /*
+            Compares the ranges between the alignments. pOldDiffList is the result for the alignments in
+            pOldManualDiffHelpList, the diffs of ranges found in both are taken over.
+        */
         bool runDiff(const QVector<LineData>* p1, LineRef size1, const QVector<LineData>* p2, LineRef size2, DiffList& diffList,
                      e_SrcSelector winIdx1, e_SrcSelector winIdx2,
-                     const QSharedPointer<Options> &pOptions);
+                     const QSharedPointer<Options> &pOptions,
+                     const QVector<size_t>* pHashes1 = nullptr, const QVector<size_t>* pHashes2 = nullptr,
+                     const ManualDiffHelpList* pOldManualDiffHelpList = nullptr, const DiffList* pOldDiffList = nullptr);
 };
 
 void calcDiff(const QString &line1, const QString &line2, DiffList& diffList, int match, int maxSearchRange);
@@ -552,7 +800,6 @@ inline int tabber(int outPos, int tabSize)
 */
 int getBestFirstLine(int line, int nofLines, int firstLine, int visibleLines);
 
-extern bool g_bAutoSolve;
 
 enum e_CoordType
 {
@@ -561,6 +808,6 @@ enum e_CoordType
     eWrapCoords
 };
 
-QString calcHistorySortKey(const QString& keyOrder, QRegExp& matchedRegExpr, const QStringList& parenthesesGroupList);
+QString calcHistorySortKey(const QString& keyOrder, const QRegularExpressionMatch& match, const QStringList& parenthesesGroupList);
 bool findParenthesesGroups(const QString& s, QStringList& sl);
 #endif
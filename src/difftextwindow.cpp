@@ -9,8 +9,11 @@
 #include "difftextwindow.h"
 
 #include "FileNameLineEdit.h"
+#include "MemoryUsage.h"
 #include "RLPainter.h"
 #include "SourceData.h" // for SourceData
+#include "TextLayoutCache.h"
+#include "TextWidthCache.h"
 #include "Utils.h"      // for Utils
 #include "common.h"     // for getAtomic, max3, min3
 #include "kdiff3.h"
@@ -18,6 +21,7 @@
 #include "options.h"
 #include "progress.h"
 #include "selection.h"
+#include "Tracing.h"
 
 #include <algorithm>
 #include <cmath>
@@ -40,45 +44,45 @@
 #include <QStatusBar>
 #include <QTextCodec>
 #include <QTextLayout>
-#include <QThreadPool>
 #include <QToolTip>
 #include <QUrl>
 #include <QtMath>
 
 QScrollBar* DiffTextWindow::mVScrollBar = nullptr;
-QList<RecalcWordWrapRunnable*> DiffTextWindow::s_runnables; //Used in startRunables and recalWordWrap
+TaskGroup DiffTextWindow::s_wordWrapTasks;
 
-class RecalcWordWrapRunnable : public QRunnable
+class RecalcWordWrapRunnable : public TaskGroup::Task
 {
   private:
-    static QAtomicInt s_runnableCount;
     DiffTextWindow* m_pDTW;
     int m_visibleTextWidth;
     int m_cacheIdx;
 
   public:
-    static QAtomicInt s_maxNofRunnables;
-    RecalcWordWrapRunnable(DiffTextWindow* p, int visibleTextWidth, int cacheIdx)
-        : m_pDTW(p), m_visibleTextWidth(visibleTextWidth), m_cacheIdx(cacheIdx)
+    RecalcWordWrapRunnable(TaskGroup& group, DiffTextWindow* p, int visibleTextWidth, int cacheIdx)
+        : Task(group), m_pDTW(p), m_visibleTextWidth(visibleTextWidth), m_cacheIdx(cacheIdx)
     {
-        setAutoDelete(true);
-        s_runnableCount.fetchAndAddOrdered(1);
     }
-    void run() override
+
+  protected:
+    void execute() override
+    {
+        m_pDTW->recalcWordWrapHelper(0, m_visibleTextWidth, m_cacheIdx, this);
+        // A cancelled chunk may be incomplete.
+        if(!isCancelled() && !g_pProgressDialog->isCancelled())
+            Q_EMIT m_pDTW->wrapChunkFinished(generation(), m_cacheIdx);
+    }
+
+    void finished(bool bLast) override
     {
-        m_pDTW->recalcWordWrapHelper(0, m_visibleTextWidth, m_cacheIdx);
-        int newValue = s_runnableCount.fetchAndAddOrdered(-1) - 1;
-        g_pProgressDialog->setCurrent(s_maxNofRunnables - getAtomic(s_runnableCount));
-        if(newValue == 0)
+        g_pProgressDialog->setCurrent(group().nofFinishedTasks());
+        if(bLast)
         {
-            Q_EMIT m_pDTW->finishRecalcWordWrap(m_visibleTextWidth);
+            Q_EMIT m_pDTW->wordWrapTasksFinished(m_visibleTextWidth, generation());
         }
     }
 };
 
-QAtomicInt RecalcWordWrapRunnable::s_runnableCount = 0;
-QAtomicInt RecalcWordWrapRunnable::s_maxNofRunnables = 0;
-
 class WrapLineCacheData
 {
   public:
@@ -108,7 +112,10 @@ class DiffTextWindowData
 #endif
     }
 
+    // nullptr if this window has no line in the Diff3Line.
+    const LineData* getLineData(int d3lIdx);
     QString getString(int d3lIdx);
+    int getLineLength(int d3lIdx);
     QString getLineString(int line);
 
     void writeLine(
@@ -125,8 +132,21 @@ class DiffTextWindowData
     int convertLineOnScreenToLineInSource(int lineOnScreen, e_CoordType coordType, bool bFirstLine);
 
     void prepareTextLayout(QTextLayout& textLayout, int visibleTextWidth = -1);
-
-    bool isThreeWay() const { return KDiff3App::isTripleDiff(); };
+    void applyWrapChunk(int cacheListIdx);
+    void positionTextLayout(QTextLayout& textLayout, int visibleTextWidth = -1);
+    TextLayoutCache::Settings textLayoutSettings() const;
+    // A laid out single line from m_textLayoutCache, only valid until the next call.
+    QTextLayout* cachedTextLayout(int line, int wrapLineOffset, const QString& text);
+    // The text draw() lays out for a line on the screen, false if this window has no line there.
+    bool getLayoutText(int line, LineRef& srcLineIdx, int& wrapLineOffset, QString& text) const;
+    // Must be called on the GUI thread before textWidth() is used.
+    void updateTextWidthSettings();
+    // The unwrapped width of s, textLayout is only used for lines that have to be laid out.
+    int textWidth(const QString& s, QTextLayout& textLayout);
+    // The same for a line of the Diff3Line vector, Latin-1 text is measured without a QString.
+    int lineWidth(int d3lIdx, QTextLayout& textLayout);
+
+    bool isThreeWay() const { return m_bTripleDiff; };
     const QString& getFileName() { return m_filename; }
 
     const Diff3LineVector* getDiff3LineVector() { return m_pDiff3LineVector; }
@@ -149,7 +169,26 @@ class DiffTextWindowData
     const Diff3LineVector* m_pDiff3LineVector = nullptr;
     Diff3WrapLineVector m_diff3WrapLineVector;
     const ManualDiffHelpList* m_pManualDiffHelpList = nullptr;
+    bool m_bTripleDiff = false;
     QList<QVector<WrapLineCacheData>> m_wrapLineCacheList;
+    // The chunks of m_wrapLineCacheList that are complete, only used by the GUI thread.
+    QVector<bool> m_wrapChunkDone;
+    TextLayoutCache m_textLayoutCache;
+    // Used instead of m_textLayoutCache while print() draws a page laid out before.
+    TextLayoutCache* m_pPrintLayouts = nullptr;
+
+    // Where the text last searched for occurs, ordered by Diff3Line and position.
+    struct FindMatch
+    {
+        int d3lIdx;
+        int pos;
+    };
+    static bool lessFindMatch(const FindMatch& a, const FindMatch& b) { return a.d3lIdx < b.d3lIdx || (a.d3lIdx == b.d3lIdx && a.pos < b.pos); }
+    QVector<FindMatch> m_findMatches;
+    QString m_findText;
+    bool m_bFindCaseSensitive = false;
+    bool m_bFindMatchesValid = false;
+    void findMatches(const QString& s, bool bCaseSensitive);
 
     QSharedPointer<Options> m_pOptions;
     QColor m_cThis;
@@ -166,6 +205,7 @@ class DiffTextWindowData
     int m_horizScrollOffset = 0;
     int m_lineNumberWidth = 0;
     QAtomicInt m_maxTextWidth = -1;
+    TextWidthCache m_textWidthCache;
 
     Selection m_selection;
 
@@ -231,14 +271,20 @@ void DiffTextWindow::init(
     const QVector<LineData>* pLineData,
     int size,
     const Diff3LineVector* pDiff3LineVector,
-    const ManualDiffHelpList* pManualDiffHelpList)
+    const ManualDiffHelpList* pManualDiffHelpList,
+    bool bTripleDiff)
 {
     d->m_filename = filename;
     d->m_pLineData = pLineData;
     d->m_size = size;
     d->m_pDiff3LineVector = pDiff3LineVector;
     d->m_diff3WrapLineVector.clear();
+    d->m_wrapChunkDone.clear();
+    d->m_bFindMatchesValid = false;
+    d->m_findMatches.clear();
     d->m_pManualDiffHelpList = pManualDiffHelpList;
+    d->m_bTripleDiff = bTripleDiff;
+    d->m_textLayoutCache.clear();
 
     d->m_firstLine = 0;
     d->m_oldFirstLine = -1;
@@ -267,7 +313,11 @@ void DiffTextWindow::setupConnections(const KDiff3App* app) const
     chk_connect_a(this, &DiffTextWindow::newSelection, app, &KDiff3App::slotSelectionStart);
     chk_connect_a(this, &DiffTextWindow::selectionEnd, app, &KDiff3App::slotSelectionEnd);
     chk_connect_a(this, &DiffTextWindow::scrollDiffTextWindow, app, &KDiff3App::scrollDiffTextWindow);
-    chk_connect_q(this, &DiffTextWindow::finishRecalcWordWrap, app, &KDiff3App::slotFinishRecalcWordWrap);
+    // Emitted on the GUI thread, a queued call could arrive after the word wrap was cancelled.
+    chk_connect_a(this, &DiffTextWindow::finishRecalcWordWrap, app, &KDiff3App::slotFinishRecalcWordWrap);
+    chk_connect_q(this, &DiffTextWindow::wordWrapTasksFinished, this, &DiffTextWindow::slotWordWrapTasksFinished);
+    chk_connect_q(this, &DiffTextWindow::wrapChunkFinished, this, &DiffTextWindow::slotWrapChunkFinished);
+    chk_connect_a(this, &DiffTextWindow::wordWrapProgress, app, &KDiff3App::slotWordWrapProgress);
 
     chk_connect_a(this, &DiffTextWindow::finishDrop, app, &KDiff3App::slotFinishDrop);
 
@@ -286,6 +336,7 @@ void DiffTextWindow::reset()
     d->m_pDiff3LineVector = nullptr;
     d->m_filename = "";
     d->m_diff3WrapLineVector.clear();
+    d->m_textLayoutCache.clear();
 }
 
 void DiffTextWindow::slotRefresh()
@@ -359,7 +410,8 @@ void DiffTextWindow::dropEvent(QDropEvent* dropEvent)
     }
 }
 
-void DiffTextWindow::printWindow(RLPainter& painter, const QRect& view, const QString& headerText, int line, int linesPerPage, const QColor& fgColor)
+void DiffTextWindow::printWindow(RLPainter& painter, const QRect& view, const QString& headerText, int line, int linesPerPage, const QColor& fgColor,
+                                 TextLayoutCache* pLayouts)
 {
     QRect clipRect = view;
     clipRect.setTop(0);
@@ -390,7 +442,7 @@ void DiffTextWindow::printWindow(RLPainter& painter, const QRect& view, const QS
     }
 
     painter.translate(0, view.top());
-    print(painter, view, line, linesPerPage);
+    print(painter, view, line, linesPerPage, pLayouts);
     painter.resetTransform();
 }
 
@@ -440,6 +492,7 @@ void DiffTextWindow::setHorizScrollOffset(int horizScrollOffset)
         int pos;
         convertToLinePos(d->m_lastKnownMousePos.x(), d->m_lastKnownMousePos.y(), line, pos);
         d->m_selection.end(line, pos);
+        update();
     }
     else
     {
@@ -451,10 +504,9 @@ void DiffTextWindow::setHorizScrollOffset(int horizScrollOffset)
             r = QRect(width() - xOffset - 2, 0, -(width()), height()).normalized();
         }
 
+        // Repaints the exposed columns only, the line numbers don't move.
         scroll(deltaX, 0, r);
     }
-
-    update();
 }
 
 int DiffTextWindow::getMaxTextWidth()
@@ -466,14 +518,13 @@ int DiffTextWindow::getMaxTextWidth()
     else if(getAtomic(d->m_maxTextWidth) < 0)
     {
         d->m_maxTextWidth = 0;
+        d->updateTextWidthSettings();
         QTextLayout textLayout(QString(), font(), this);
         for(int i = 0; i < d->m_size; ++i)
         {
-            textLayout.clearLayout();
-            textLayout.setText(d->getString(i));
-            d->prepareTextLayout(textLayout);
-            if(textLayout.maximumWidth() > getAtomic(d->m_maxTextWidth))
-                d->m_maxTextWidth = qCeil(textLayout.maximumWidth());
+            const int width = d->lineWidth(i, textLayout);
+            if(width > getAtomic(d->m_maxTextWidth))
+                d->m_maxTextWidth = width;
         }
     }
     return getAtomic(d->m_maxTextWidth);
@@ -484,6 +535,12 @@ LineCount DiffTextWindow::getNofLines()
     return d->m_bWordWrap ? d->m_diff3WrapLineVector.size() : d->m_pDiff3LineVector->size();
 }
 
+qint64 DiffTextWindow::memoryUsage() const
+{
+    // The chunks in m_wrapLineCacheList are still written by the word wrap tasks, they are left out.
+    return MemoryUsage::ofVector(d->m_diff3WrapLineVector);
+}
+
 int DiffTextWindow::convertLineToDiff3LineIdx(LineRef line)
 {
     if(line.isValid() && d->m_bWordWrap && d->m_diff3WrapLineVector.size() > 0)
@@ -789,10 +846,17 @@ void DiffTextWindow::convertToLinePos(int x, int y, LineRef& line, int& pos)
     line = (y - yOffset) / fontHeight;
     if(line.isValid() && (!d->getOptions()->wordWrapOn() || line < d->m_diff3WrapLineVector.count()))
     {
-        QString s = d->getLineString(line);
-        QTextLayout textLayout(s, font(), this);
-        d->prepareTextLayout(textLayout);
-        pos = textLayout.lineAt(0).xToCursor(x - textLayout.position().x());
+        // The layout the line was painted with, so moving the mouse over it lays out nothing.
+        LineRef srcLineIdx;
+        int wrapLineOffset = 0;
+        QString text;
+        if(d->getLayoutText(line, srcLineIdx, wrapLineOffset, text))
+        {
+            QTextLayout* pTextLayout = d->cachedTextLayout(srcLineIdx, wrapLineOffset, text);
+            pos = pTextLayout->lineAt(0).xToCursor(x - pTextLayout->position().x());
+        }
+        else
+            pos = 0;
     }
     else
         pos = -1;
@@ -881,12 +945,6 @@ void DiffTextWindowData::prepareTextLayout(QTextLayout& textLayout, int visibleT
     int leading = m_pDiffTextWindow->fontMetrics().leading();
     int height = 0;
 
-    int fontWidth = Utils::getHorizontalAdvance(m_pDiffTextWindow->fontMetrics(), '0');
-    int xOffset = leftInfoWidth() * fontWidth - m_horizScrollOffset;
-    int textWidth = visibleTextWidth;
-    if(textWidth < 0)
-        textWidth = m_pDiffTextWindow->width() - xOffset;
-
     int indentation = 0;
     while(true)
     {
@@ -912,12 +970,132 @@ void DiffTextWindowData::prepareTextLayout(QTextLayout& textLayout, int visibleT
     }
 
     textLayout.endLayout();
+    positionTextLayout(textLayout, visibleTextWidth);
+}
+
+void DiffTextWindowData::updateTextWidthSettings()
+{
+    const QFont& font = m_pDiffTextWindow->font();
+    // The tab stops of prepareTextLayout()
+    m_textWidthCache.setSettings(TextWidthCache::Settings{font, QFontMetricsF(font).width(' ') * m_pOptions->m_tabSize});
+}
+
+int DiffTextWindowData::textWidth(const QString& s, QTextLayout& textLayout)
+{
+    int width = 0;
+    if(m_textWidthCache.advanceWidth(s, width))
+        return width;
+
+    textLayout.clearLayout();
+    textLayout.setText(s);
+    prepareTextLayout(textLayout);
+    return qCeil(textLayout.maximumWidth());
+}
+
+int DiffTextWindowData::lineWidth(int d3lIdx, QTextLayout& textLayout)
+{
+    const LineData* pld = getLineData(d3lIdx);
+    if(pld == nullptr)
+        return textWidth(QString(), textLayout);
+
+    int width = 0;
+    if(pld->isLatin1() && m_textWidthCache.advanceWidth(pld->latin1(), pld->size(), width))
+        return width;
+    return textWidth(pld->getLine(), textLayout);
+}
+
+void DiffTextWindowData::positionTextLayout(QTextLayout& textLayout, int visibleTextWidth)
+{
+    int fontWidth = Utils::getHorizontalAdvance(m_pDiffTextWindow->fontMetrics(), '0');
+    int xOffset = leftInfoWidth() * fontWidth - m_horizScrollOffset;
+    int textWidth = visibleTextWidth;
+    if(textWidth < 0)
+        textWidth = m_pDiffTextWindow->width() - xOffset;
+
     if(m_pOptions->m_bRightToLeftLanguage)
         textLayout.setPosition(QPointF(textWidth - textLayout.maximumWidth(), 0));
     else
         textLayout.setPosition(QPointF(xOffset, 0));
 }
 
+/*
+    The layout of a line only depends on its text and the settings, not on the colors or the
+    selection which are given when drawing. Lines keep their layout while scrolling.
+*/
+TextLayoutCache::Settings DiffTextWindowData::textLayoutSettings() const
+{
+    return TextLayoutCache::Settings{m_pDiffTextWindow->font(), m_pOptions->m_tabSize,
+                                     m_pOptions->m_bShowWhiteSpaceCharacters, m_pOptions->m_bRightToLeftLanguage};
+}
+
+QTextLayout* DiffTextWindowData::cachedTextLayout(int line, int wrapLineOffset, const QString& text)
+{
+    TextLayoutCache& layouts = m_pPrintLayouts != nullptr ? *m_pPrintLayouts : m_textLayoutCache;
+    layouts.setSettings(textLayoutSettings());
+
+    QTextLayout* pTextLayout = layouts.find(line, wrapLineOffset, text);
+    if(pTextLayout != nullptr)
+    {
+        positionTextLayout(*pTextLayout);
+        return pTextLayout;
+    }
+
+    pTextLayout = new QTextLayout(text, m_pDiffTextWindow->font(), m_pDiffTextWindow);
+    prepareTextLayout(*pTextLayout);
+    return layouts.insert(line, wrapLineOffset, pTextLayout);
+}
+
+// The text of a line as writeLine() draws it, the line end is shown as a character.
+static QString shownLineString(const LineData& lineData)
+{
+    QString lineString = lineData.getLine();
+    if(!lineString.isEmpty())
+    {
+        switch(lineString[lineString.length() - 1].unicode())
+        {
+            case '\n':
+                lineString[lineString.length() - 1] = 0x00B6;
+                break; // "Pilcrow", "paragraph mark"
+            case '\r':
+                lineString[lineString.length() - 1] = 0x00A4;
+                break; // Currency sign ;0x2761 "curved stem paragraph sign ornament"
+            //case '\0b' : lineString[lineString.length()-1] = 0x2756; break; // some other nice looking character
+        }
+    }
+    return lineString;
+}
+
+bool DiffTextWindowData::getLayoutText(int line, LineRef& srcLineIdx, int& wrapLineOffset, QString& text) const
+{
+    int wrapLineLength = 0;
+    const Diff3Line* d3l = nullptr;
+    wrapLineOffset = 0;
+    if(m_bWordWrap)
+    {
+        if(line >= m_diff3WrapLineVector.count())
+            return false;
+        const Diff3WrapLine& d3wl = m_diff3WrapLineVector[line];
+        wrapLineOffset = d3wl.wrapLineOffset;
+        wrapLineLength = d3wl.wrapLineLength;
+        d3l = d3wl.pD3L;
+    }
+    else
+    {
+        if(m_pDiff3LineVector == nullptr || line >= m_pDiff3LineVector->size())
+            return false;
+        d3l = (*m_pDiff3LineVector)[line];
+    }
+
+    srcLineIdx = d3l->getLineInFile(m_winIdx);
+    if(!srcLineIdx.isValid())
+        return false;
+
+    const QString lineString = shownLineString((*m_pLineData)[srcLineIdx]);
+    const int lineLength = m_bWordWrap ? wrapLineOffset + wrapLineLength : lineString.length();
+    text = lineString.mid(wrapLineOffset, lineLength - wrapLineOffset);
+    return true;
+}
+
 /*
     Don't try to use invalid rect to block drawing of lines based on there apparent horizontal dementions.
     This does not always work for very long lines being scrolled horzontally. (Causes blanking of diff text area)
@@ -985,20 +1163,7 @@ void DiffTextWindowData::writeLine(
     {
         // First calculate the "changed" information for each character.
         int i = 0;
-        QString lineString = pld->getLine();
-        if(!lineString.isEmpty())
-        {
-            switch(lineString[lineString.length() - 1].unicode())
-            {
-                case '\n':
-                    lineString[lineString.length() - 1] = 0x00B6;
-                    break; // "Pilcrow", "paragraph mark"
-                case '\r':
-                    lineString[lineString.length() - 1] = 0x00A4;
-                    break; // Currency sign ;0x2761 "curved stem paragraph sign ornament"
-                //case '\0b' : lineString[lineString.length()-1] = 0x2756; break; // some other nice looking character
-            }
-        }
+        const QString lineString = shownLineString(*pld);
         QVector<ChangeFlags> charChanged(pld->size());
         Merger merger(pLineDiff1, pLineDiff2);
         while(!merger.isEndReached() && i < pld->size())
@@ -1067,9 +1232,8 @@ void DiffTextWindowData::writeLine(
             ++outPos;
         } // end for
 
-        QTextLayout textLayout(lineString.mid(wrapLineOffset, lineLength - wrapLineOffset), m_pDiffTextWindow->font(), m_pDiffTextWindow);
-        prepareTextLayout(textLayout);
-        textLayout.draw(&p, QPoint(0, yOffset), frh /*, const QRectF & clip = QRectF() */);
+        QTextLayout* pTextLayout = cachedTextLayout(srcLineIdx, wrapLineOffset, lineString.mid(wrapLineOffset, lineLength - wrapLineOffset));
+        pTextLayout->draw(&p, QPoint(0, yOffset), frh /*, const QRectF & clip = QRectF() */);
     }
 
     p.fillRect(0, yOffset, leftInfoWidth() * fontWidth, fontHeight, m_pOptions->m_bgColor);
@@ -1162,7 +1326,7 @@ void DiffTextWindow::paintEvent(QPaintEvent* e)
         Q_EMIT newSelection();
 }
 
-void DiffTextWindow::print(RLPainter& p, const QRect&, int firstLine, int nofLinesPerPage)
+void DiffTextWindow::print(RLPainter& p, const QRect&, int firstLine, int nofLinesPerPage, TextLayoutCache* pLayouts)
 {
     if(d->m_pDiff3LineVector == nullptr || !updatesEnabled() ||
        (d->m_diff3WrapLineVector.empty() && d->m_bWordWrap))
@@ -1173,11 +1337,34 @@ void DiffTextWindow::print(RLPainter& p, const QRect&, int firstLine, int nofLin
     QRect invalidRect = QRect(0, 0, 1000000000, 1000000000);
     QColor bgColor = d->getOptions()->m_bgColor;
     d->getOptions()->m_bgColor = Qt::white;
+    d->m_pPrintLayouts = pLayouts;
     d->draw(p, invalidRect, firstLine, std::min(firstLine + nofLinesPerPage, getNofLines()));
+    d->m_pPrintLayouts = nullptr;
     d->getOptions()->m_bgColor = bgColor;
     d->m_firstLine = oldFirstLine;
 }
 
+void DiffTextWindow::layoutPrintPage(TextLayoutCache& layouts, int firstLine, int nofLinesPerPage)
+{
+    if(d->m_pDiff3LineVector == nullptr || (d->m_diff3WrapLineVector.empty() && d->m_bWordWrap))
+        return;
+
+    layouts.setSettings(d->textLayoutSettings());
+    const int endLine = std::min(firstLine + nofLinesPerPage, getNofLines());
+    for(int line = firstLine; line < endLine; ++line)
+    {
+        LineRef srcLineIdx;
+        int wrapLineOffset = 0;
+        QString text;
+        if(!d->getLayoutText(line, srcLineIdx, wrapLineOffset, text))
+            continue;
+
+        QTextLayout* pTextLayout = new QTextLayout(text, font(), this);
+        d->prepareTextLayout(*pTextLayout);
+        layouts.insert(srcLineIdx, wrapLineOffset, pTextLayout);
+    }
+}
+
 void DiffTextWindowData::draw(RLPainter& p, const QRect& invalidRect, int beginLine, int endLine)
 {
     m_lineNumberWidth = m_pOptions->m_bShowLineNumbers ? (int)log10((double)std::max(m_size, 1)) + 1 : 0;
@@ -1228,7 +1415,7 @@ void DiffTextWindowData::draw(RLPainter& p, const QRect& invalidRect, int beginL
         ChangeFlags changed2 = NoChange;
 
         LineRef srcLineIdx;
-        d3l->getLineInfo(m_winIdx, KDiff3App::isTripleDiff(), srcLineIdx, pFineDiff1, pFineDiff2, changed, changed2);
+        d3l->getLineInfo(m_winIdx, isThreeWay(), srcLineIdx, pFineDiff1, pFineDiff2, changed, changed2);
 
         writeLine(
             p,                                                             // QPainter
@@ -1246,24 +1433,51 @@ void DiffTextWindowData::draw(RLPainter& p, const QRect& invalidRect, int beginL
     }
 }
 
-QString DiffTextWindowData::getString(int d3lIdx)
+const LineData* DiffTextWindowData::getLineData(int d3lIdx)
 {
     if(d3lIdx < 0 || d3lIdx >= m_pDiff3LineVector->size())
-        return QString();
+        return nullptr;
 
-    const Diff3Line* d3l = (*m_pDiff3LineVector)[d3lIdx];
-    DiffList* pFineDiff1;
-    DiffList* pFineDiff2;
-    ChangeFlags changed = NoChange;
-    ChangeFlags changed2 = NoChange;
-    LineRef lineIdx;
+    // Not getLineInfo(), that would compute the pending fine diff just to find the line.
+    const LineRef lineIdx = (*m_pDiff3LineVector)[d3lIdx]->getLineInFile(m_winIdx);
+    if(!lineIdx.isValid())
+        return nullptr;
 
-    d3l->getLineInfo(m_winIdx, KDiff3App::isTripleDiff(), lineIdx, pFineDiff1, pFineDiff2, changed, changed2);
+    return &(*m_pLineData)[lineIdx];
+}
 
-    if(!lineIdx.isValid())
-        return QString();
+QString DiffTextWindowData::getString(int d3lIdx)
+{
+    const LineData* pld = getLineData(d3lIdx);
+    return pld != nullptr ? pld->getLine() : QString();
+}
 
-    return (*m_pLineData)[lineIdx].getLine();
+int DiffTextWindowData::getLineLength(int d3lIdx)
+{
+    const LineData* pld = getLineData(d3lIdx);
+    return pld != nullptr ? pld->size() : 0;
+}
+
+/*
+    A line needs as many wrap lines as it has entries in the cache, the window needing the most
+    decides for all. The runnables only fill the cache so the Diff3Lines are only changed here.
+*/
+void DiffTextWindowData::applyWrapChunk(int cacheListIdx)
+{
+    m_wrapChunkDone[cacheListIdx] = true;
+
+    const QVector<WrapLineCacheData>& wrapLineCache = m_wrapLineCacheList.at(cacheListIdx);
+    for(int i = 0; i < wrapLineCache.size();)
+    {
+        const int d3lIdx = wrapLineCache[i].d3LineIdx();
+        int linesNeeded = 0;
+        for(; i < wrapLineCache.size() && wrapLineCache[i].d3LineIdx() == d3lIdx; ++i)
+            ++linesNeeded;
+
+        Diff3Line& d3l = *(*m_pDiff3LineVector)[d3lIdx];
+        if(d3l.linesNeededForDisplay() < linesNeeded)
+            d3l.setLinesNeeded(linesNeeded);
+    }
 }
 
 QString DiffTextWindowData::getLineString(int line)
@@ -1377,11 +1591,133 @@ QString DiffTextWindow::getSelection()
     return selectionString;
 }
 
+class FindMatchesRunnable : public TaskGroup::Task
+{
+  private:
+    DiffTextWindow* m_pDTW;
+    QString m_text;
+    bool m_bCaseSensitive;
+
+  public:
+    FindMatchesRunnable(TaskGroup& group, DiffTextWindow* p, const QString& s, bool bCaseSensitive)
+        : Task(group), m_pDTW(p), m_text(s), m_bCaseSensitive(bCaseSensitive)
+    {
+    }
+
+  protected:
+    void execute() override { m_pDTW->findMatches(m_text, m_bCaseSensitive); }
+};
+
+void DiffTextWindow::prepareFind(const QVector<DiffTextWindow*>& windows, const QString& s, bool bCaseSensitive)
+{
+    TaskGroup findTasks;
+    for(DiffTextWindow* pDTW: windows)
+    {
+        if(pDTW != nullptr && !pDTW->hasFindMatches(s, bCaseSensitive))
+            findTasks.add(new FindMatchesRunnable(findTasks, pDTW, s, bCaseSensitive), TaskGroup::e_Priority::Visible);
+    }
+    findTasks.startPending();
+    findTasks.wait();
+}
+
+bool DiffTextWindow::hasFindMatches(const QString& s, bool bCaseSensitive) const
+{
+    return d->m_bFindMatchesValid && d->m_findText == s && d->m_bFindCaseSensitive == bCaseSensitive;
+}
+
+void DiffTextWindow::findMatches(const QString& s, bool bCaseSensitive)
+{
+    d->findMatches(s, bCaseSensitive);
+}
+
+/*
+    Searches the whole text buffer of the file at once instead of line by line. A match is kept if
+    it lies within one line and that line is shown, it is then mapped to its Diff3Line.
+*/
+void DiffTextWindowData::findMatches(const QString& s, bool bCaseSensitive)
+{
+    m_findMatches.clear();
+    m_findText = s;
+    m_bFindCaseSensitive = bCaseSensitive;
+    m_bFindMatchesValid = true;
+
+    if(m_pLineData == nullptr || m_pDiff3LineVector == nullptr || s.isEmpty())
+        return;
+
+    const int nofLines = std::min(m_size, m_pLineData->size());
+    QVector<int> d3lIdxOfLine(nofLines, -1);
+    for(int i = 0; i < m_pDiff3LineVector->size(); ++i)
+    {
+        const LineRef lineIdx = (*m_pDiff3LineVector)[i]->getLineInFile(m_winIdx);
+        if(lineIdx.isValid() && lineIdx < nofLines)
+            d3lIdxOfLine[lineIdx] = i;
+    }
+
+    // The lines normally share one buffer in ascending order, otherwise they are searched one by one.
+    const TextChunk* pBuffer = nofLines > 0 ? (*m_pLineData)[0].getBuffer() : nullptr;
+    bool bContiguous = pBuffer != nullptr;
+    for(int i = 0; i < nofLines && bContiguous; ++i)
+    {
+        const LineData& lineData = (*m_pLineData)[i];
+        bContiguous = lineData.getBuffer() == pBuffer && (i == 0 || lineData.getOffset() >= (*m_pLineData)[i - 1].getOffset() + (*m_pLineData)[i - 1].size());
+    }
+
+    const Qt::CaseSensitivity cs = bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if(bContiguous)
+    {
+        // Shares the text of a UTF-16 buffer, a Latin-1 one is converted once for all lines.
+        const QString text = pBuffer->toString();
+        int lineIdx = 0;
+        for(int pos = text.indexOf(s, 0, cs); pos >= 0 && lineIdx < nofLines; pos = text.indexOf(s, pos + 1, cs))
+        {
+            while(lineIdx < nofLines && pos >= (*m_pLineData)[lineIdx].getOffset() + (*m_pLineData)[lineIdx].size())
+                ++lineIdx;
+            if(lineIdx == nofLines)
+                break;
+
+            const LineData& lineData = (*m_pLineData)[lineIdx];
+            const int posInLine = pos - (int)lineData.getOffset();
+            if(posInLine >= 0 && posInLine + s.length() <= lineData.size() && d3lIdxOfLine[lineIdx] >= 0)
+                m_findMatches.push_back(FindMatch{d3lIdxOfLine[lineIdx], posInLine});
+        }
+    }
+    else
+    {
+        for(int lineIdx = 0; lineIdx < nofLines; ++lineIdx)
+        {
+            if(d3lIdxOfLine[lineIdx] < 0)
+                continue;
+
+            const QString line = (*m_pLineData)[lineIdx].getLine();
+            for(int pos = line.indexOf(s, 0, cs); pos >= 0; pos = line.indexOf(s, pos + 1, cs))
+                m_findMatches.push_back(FindMatch{d3lIdxOfLine[lineIdx], pos});
+        }
+    }
+
+    // Moved lines may be shown out of file order.
+    std::sort(m_findMatches.begin(), m_findMatches.end(), lessFindMatch);
+}
+
 bool DiffTextWindow::findString(const QString& s, LineRef& d3vLine, int& posInLine, bool bDirDown, bool bCaseSensitive)
 {
+    if(bDirDown)
+    {
+        if(!hasFindMatches(s, bCaseSensitive))
+            findMatches(s, bCaseSensitive);
+
+        const DiffTextWindowData::FindMatch start{d3vLine, posInLine};
+        QVector<DiffTextWindowData::FindMatch>::const_iterator it = std::lower_bound(d->m_findMatches.constBegin(), d->m_findMatches.constEnd(), start, DiffTextWindowData::lessFindMatch);
+        if(it == d->m_findMatches.constEnd())
+            return false;
+
+        d3vLine = it->d3lIdx;
+        posInLine = it->pos;
+        return true;
+    }
+
     int it = d3vLine;
-    int endIt = bDirDown ? d->m_pDiff3LineVector->size() : -1;
-    int step = bDirDown ? 1 : -1;
+    int endIt = -1;
+    int step = -1;
     int startPos = posInLine;
 
     for(; it != endIt; it += step)
@@ -1558,7 +1894,7 @@ void DiffTextWindow::convertSelectionToD3LCoords()
 
 bool DiffTextWindow::startRunnables()
 {
-    if(s_runnables.count() == 0)
+    if(s_wordWrapTasks.nofPendingTasks() == 0)
     {
         return false;
     }
@@ -1566,21 +1902,21 @@ bool DiffTextWindow::startRunnables()
     {
         g_pProgressDialog->setStayHidden(true);
         g_pProgressDialog->push();
-        g_pProgressDialog->setMaxNofSteps(s_runnables.count());
-        RecalcWordWrapRunnable::s_maxNofRunnables = s_runnables.count();
+        g_pProgressDialog->setMaxNofSteps(s_wordWrapTasks.nofPendingTasks());
         g_pProgressDialog->setCurrent(0);
 
-        for(int i = 0; i < s_runnables.count(); ++i)
-        {
-            QThreadPool::globalInstance()->start(s_runnables[i]);
-        }
-
-        s_runnables.clear();
+        s_wordWrapTasks.startPending();
         return true;
     }
 }
 
-void DiffTextWindow::recalcWordWrap(bool bWordWrap, int wrapLineVectorSize, int visibleTextWidth)
+void DiffTextWindow::stopRunnables()
+{
+    s_wordWrapTasks.cancel();
+    s_wordWrapTasks.wait();
+}
+
+void DiffTextWindow::recalcWordWrap(bool bWordWrap, int wrapLineVectorSize, int visibleTextWidth, int firstD3LIdx)
 {
     if(d->m_pDiff3LineVector == nullptr || !isVisible())
     {
@@ -1599,12 +1935,33 @@ void DiffTextWindow::recalcWordWrap(bool bWordWrap, int wrapLineVectorSize, int
 
         if(wrapLineVectorSize == 0)
         {
+            // Before the runnables read it.
+            d->updateTextWidthSettings();
             d->m_wrapLineCacheList.clear();
+            d->m_wrapChunkDone.clear();
             setUpdatesEnabled(false);
-            for(int i = 0, j = 0; i < d->m_pDiff3LineVector->size(); i += s_linesPerRunnable, ++j)
+            for(int i = 0; i < d->m_pDiff3LineVector->size(); i += s_linesPerRunnable)
             {
                 d->m_wrapLineCacheList.append(QVector<WrapLineCacheData>());
-                s_runnables.push_back(new RecalcWordWrapRunnable(this, visibleTextWidth, j));
+                d->m_wrapChunkDone.append(false);
+            }
+
+            // One screen above and below the first visible line is wrapped before anything is shown.
+            const int nofVisibleLines = getNofVisibleLines();
+            const int firstUrgentIdx = firstD3LIdx - nofVisibleLines;
+            const int endUrgentIdx = firstD3LIdx + 2 * nofVisibleLines;
+            for(int i = 0, j = 0; i < d->m_pDiff3LineVector->size(); i += s_linesPerRunnable, ++j)
+            {
+                if(firstD3LIdx >= 0 && i < endUrgentIdx && i + s_linesPerRunnable > firstUrgentIdx)
+                {
+                    recalcWordWrapHelper(0, visibleTextWidth, j);
+                    if(!g_pProgressDialog->wasCancelled())
+                        d->applyWrapChunk(j);
+                }
+                else
+                {
+                    s_wordWrapTasks.add(new RecalcWordWrapRunnable(s_wordWrapTasks, this, visibleTextWidth, j), TaskGroup::e_Priority::Visible);
+                }
             }
         }
         else
@@ -1619,10 +1976,12 @@ void DiffTextWindow::recalcWordWrap(bool bWordWrap, int wrapLineVectorSize, int
         {
             d->m_diff3WrapLineVector.resize(0);
             d->m_wrapLineCacheList.clear();
+            d->m_wrapChunkDone.clear();
+            d->updateTextWidthSettings();
             setUpdatesEnabled(false);
             for(int i = 0, j = 0; i < d->m_pDiff3LineVector->size(); i += s_linesPerRunnable, ++j)
             {
-                s_runnables.push_back(new RecalcWordWrapRunnable(this, visibleTextWidth, j));
+                s_wordWrapTasks.add(new RecalcWordWrapRunnable(s_wordWrapTasks, this, visibleTextWidth, j));
             }
         }
         else
@@ -1632,93 +1991,116 @@ void DiffTextWindow::recalcWordWrap(bool bWordWrap, int wrapLineVectorSize, int
     }
 }
 
-void DiffTextWindow::recalcWordWrapHelper(int wrapLineVectorSize, int visibleTextWidth, int cacheListIdx)
+void DiffTextWindow::slotWrapChunkFinished(int wrapGeneration, int cacheListIdx)
+{
+    if(!d->m_bWordWrap || !s_wordWrapTasks.isCurrent(wrapGeneration) || cacheListIdx >= d->m_wrapChunkDone.size())
+        return;
+
+    d->applyWrapChunk(cacheListIdx);
+    Q_EMIT wordWrapProgress();
+}
+
+void DiffTextWindow::slotWordWrapTasksFinished(int visibleTextWidthForPrinting, int wrapGeneration)
+{
+    if(s_wordWrapTasks.isCurrent(wrapGeneration))
+        Q_EMIT finishRecalcWordWrap(visibleTextWidthForPrinting);
+}
+
+void DiffTextWindow::recalcWordWrapHelper(int wrapLineVectorSize, int visibleTextWidth, int cacheListIdx, const TaskGroup::Task* pTask)
 {
     if(d->m_bWordWrap)
     {
-        if(g_pProgressDialog->wasCancelled())
+        // Also called while painting is allowed, don't process events then.
+        if(wrapLineVectorSize == 0 && (g_pProgressDialog->isCancelled() || (pTask != nullptr && pTask->isCancelled())))
             return;
         if(visibleTextWidth < 0)
             visibleTextWidth = getVisibleTextAreaWidth();
         else
             visibleTextWidth -= d->leftInfoWidth() * Utils::getHorizontalAdvance(fontMetrics(), '0');
-        int i;
-        int wrapLineIdx = 0;
         int size = d->m_pDiff3LineVector->size();
-        int firstD3LineIdx = wrapLineVectorSize > 0 ? 0 : cacheListIdx * s_linesPerRunnable;
-        int endIdx = wrapLineVectorSize > 0 ? size : std::min(firstD3LineIdx + s_linesPerRunnable, size);
-        QVector<WrapLineCacheData>& wrapLineCache = d->m_wrapLineCacheList[cacheListIdx];
-        int cacheListIdx2 = 0;
-        QTextLayout textLayout(QString(), font(), this);
-        for(i = firstD3LineIdx; i < endIdx; ++i)
+        if(wrapLineVectorSize == 0)
         {
-            if(g_pProgressDialog->wasCancelled())
-                return;
-
-            int linesNeeded = 0;
-            if(wrapLineVectorSize == 0)
+            // Lay out the lines of one chunk, applyWrapChunk() takes the result.
+            int firstD3LineIdx = cacheListIdx * s_linesPerRunnable;
+            int endIdx = std::min(firstD3LineIdx + s_linesPerRunnable, size);
+            TraceSpan span("wordWrapChunk", std::max(0, endIdx - firstD3LineIdx));
+            QVector<WrapLineCacheData>& wrapLineCache = d->m_wrapLineCacheList[cacheListIdx];
+            QTextLayout textLayout(QString(), font(), this);
+            for(int i = firstD3LineIdx; i < endIdx; ++i)
             {
+                if(g_pProgressDialog->isCancelled() || (pTask != nullptr && pTask->isCancelled()))
+                    return;
+
+                // A line that fits needs no layout to find that it stays one display line.
+                const LineData* pld = d->getLineData(i);
+                int width = 0;
+                if(pld == nullptr || ((pld->isLatin1() ? d->m_textWidthCache.advanceWidth(pld->latin1(), pld->size(), width)
+                                                       : d->m_textWidthCache.advanceWidth(pld->utf16(), pld->size(), width)) &&
+                                      width <= visibleTextWidth))
+                {
+                    wrapLineCache.push_back(WrapLineCacheData(i, 0, pld != nullptr ? pld->size() : 0));
+                    continue;
+                }
+
                 QString s = d->getString(i);
+
                 textLayout.clearLayout();
                 textLayout.setText(s);
                 d->prepareTextLayout(textLayout, visibleTextWidth);
-                linesNeeded = textLayout.lineCount();
-                for(int l = 0; l < linesNeeded; ++l)
+                for(int l = 0; l < textLayout.lineCount(); ++l)
                 {
                     QTextLine line = textLayout.lineAt(l);
                     wrapLineCache.push_back(WrapLineCacheData(i, line.textStart(), line.textLength()));
                 }
             }
-            else if(wrapLineVectorSize > 0 && cacheListIdx2 < d->m_wrapLineCacheList.count())
+        }
+        else
+        {
+            int wrapLineIdx = 0;
+            const WrapLineCacheData* pWrapLineCache = nullptr;
+            const WrapLineCacheData* pWrapLineCacheEnd = nullptr;
+            for(int i = 0; i < size; ++i)
             {
-                WrapLineCacheData* pWrapLineCache = d->m_wrapLineCacheList[cacheListIdx2].data();
-                int cacheIdx = 0;
-                int clc = d->m_wrapLineCacheList.count() - 1;
-                int cllc = d->m_wrapLineCacheList.last().count();
-                int curCount = d->m_wrapLineCacheList[cacheListIdx2].count() - 1;
-                int l = 0;
-                while((cacheListIdx2 < clc || (cacheListIdx2 == clc && cacheIdx < cllc)) && pWrapLineCache->d3LineIdx() <= i)
+                if(i % s_linesPerRunnable == 0)
                 {
-                    if(pWrapLineCache->d3LineIdx() == i)
+                    // The cache of a chunk still being laid out must not be read.
+                    const int chunkIdx = i / s_linesPerRunnable;
+                    if(chunkIdx < d->m_wrapChunkDone.size() && d->m_wrapChunkDone[chunkIdx])
                     {
-                        Diff3WrapLine* pDiff3WrapLine = &d->m_diff3WrapLineVector[wrapLineIdx + l];
-                        pDiff3WrapLine->wrapLineOffset = pWrapLineCache->textStart();
-                        pDiff3WrapLine->wrapLineLength = pWrapLineCache->textLength();
-                        ++l;
-                    }
-                    if(cacheIdx < curCount)
-                    {
-                        ++cacheIdx;
-                        ++pWrapLineCache;
+                        const QVector<WrapLineCacheData>& wrapLineCache = d->m_wrapLineCacheList.at(chunkIdx);
+                        pWrapLineCache = wrapLineCache.constData();
+                        pWrapLineCacheEnd = pWrapLineCache + wrapLineCache.size();
                     }
                     else
                     {
-                        ++cacheListIdx2;
-                        if(cacheListIdx2 >= d->m_wrapLineCacheList.count())
-                            break;
-                        pWrapLineCache = d->m_wrapLineCacheList[cacheListIdx2].data();
-                        curCount = d->m_wrapLineCacheList[cacheListIdx2].count();
-                        cacheIdx = 0;
+                        pWrapLineCache = nullptr;
+                        pWrapLineCacheEnd = nullptr;
                     }
                 }
-                linesNeeded = l;
-            }
 
-            Diff3Line& d3l = *(*d->m_pDiff3LineVector)[i];
-            if(d3l.linesNeededForDisplay() < linesNeeded)
-            {
-                Q_ASSERT(wrapLineVectorSize == 0);
-                d3l.setLinesNeeded(linesNeeded);
-            }
+                Diff3Line* pD3L = (*d->m_pDiff3LineVector)[i];
+                int linesNeeded = 0;
+                if(pWrapLineCache == nullptr)
+                {
+                    // Not wrapped yet, show the whole line for now.
+                    Diff3WrapLine& d3wl = d->m_diff3WrapLineVector[wrapLineIdx];
+                    d3wl.wrapLineOffset = 0;
+                    d3wl.wrapLineLength = d->getLineLength(i);
+                    linesNeeded = 1;
+                }
+                for(; pWrapLineCache != pWrapLineCacheEnd && pWrapLineCache->d3LineIdx() == i; ++pWrapLineCache, ++linesNeeded)
+                {
+                    Q_ASSERT(linesNeeded < pD3L->linesNeededForDisplay());
+                    Diff3WrapLine& d3wl = d->m_diff3WrapLineVector[wrapLineIdx + linesNeeded];
+                    d3wl.wrapLineOffset = pWrapLineCache->textStart();
+                    d3wl.wrapLineLength = pWrapLineCache->textLength();
+                }
 
-            if(wrapLineVectorSize > 0)
-            {
-                int j;
-                for(j = 0; j < d3l.linesNeededForDisplay(); ++j, ++wrapLineIdx)
+                for(int j = 0; j < pD3L->linesNeededForDisplay(); ++j, ++wrapLineIdx)
                 {
                     Diff3WrapLine& d3wl = d->m_diff3WrapLineVector[wrapLineIdx];
                     d3wl.diff3LineIndex = i;
-                    d3wl.pD3L = (*d->m_pDiff3LineVector)[i];
+                    d3wl.pD3L = pD3L;
                     if(j >= linesNeeded)
                     {
                         d3wl.wrapLineOffset = 0;
@@ -1726,10 +2108,7 @@ void DiffTextWindow::recalcWordWrapHelper(int wrapLineVectorSize, int visibleTex
                     }
                 }
             }
-        }
 
-        if(wrapLineVectorSize > 0)
-        {
             d->m_firstLine = std::min(d->m_firstLine, wrapLineVectorSize - 1);
             d->m_horizScrollOffset = 0;
 
@@ -1738,7 +2117,7 @@ void DiffTextWindow::recalcWordWrapHelper(int wrapLineVectorSize, int visibleTex
     }
     else // no word wrap, just calc the maximum text width
     {
-        if(g_pProgressDialog->wasCancelled())
+        if(g_pProgressDialog->isCancelled())
             return;
         int size = d->m_pDiff3LineVector->size();
         int firstD3LineIdx = cacheListIdx * s_linesPerRunnable;
@@ -1748,13 +2127,9 @@ void DiffTextWindow::recalcWordWrapHelper(int wrapLineVectorSize, int visibleTex
         QTextLayout textLayout(QString(), font(), this);
         for(int i = firstD3LineIdx; i < endIdx; ++i)
         {
-            if(g_pProgressDialog->wasCancelled())
+            if(g_pProgressDialog->isCancelled())
                 return;
-            textLayout.clearLayout();
-            textLayout.setText(d->getString(i));
-            d->prepareTextLayout(textLayout);
-            if(textLayout.maximumWidth() > maxTextWidth)
-                maxTextWidth = qCeil(textLayout.maximumWidth());
+            maxTextWidth = std::max(maxTextWidth, d->lineWidth(i, textLayout));
         }
 
         for(;;)
@@ -10,6 +10,7 @@
 #define DIFFTEXTWINDOW_H
 
 #include "diff.h"
+#include "TaskGroup.h"
 
 #include <QLabel>
 #include <QSharedPointer>  // for QSharedPointer
@@ -24,6 +25,7 @@ class DiffTextWindowData;
 class DiffTextWindowFrame;
 class EncodingLabel;
 class RLPainter;
+class TextLayoutCache;
 
 class KDiff3App;
 
@@ -43,7 +45,8 @@ class DiffTextWindow : public QWidget
         const QVector<LineData>* pLineData,
         int size,
         const Diff3LineVector* pDiff3LineVector,
-        const ManualDiffHelpList* pManualDiffHelpList
+        const ManualDiffHelpList* pManualDiffHelpList,
+        bool bTripleDiff
     );
 
     void setupConnections(const KDiff3App *app) const;
@@ -57,6 +60,8 @@ class DiffTextWindow : public QWidget
 
     int getMaxTextWidth();
     LineCount getNofLines();
+    // The wrapped lines, see MemoryUsage.
+    qint64 memoryUsage() const;
     int getNofVisibleLines();
     int getVisibleTextAreaWidth();
 
@@ -69,17 +74,39 @@ class DiffTextWindow : public QWidget
     void convertSelectionToD3LCoords();
 
     bool findString(const QString& s, LineRef& d3vLine, int& posInLine, bool bDirDown, bool bCaseSensitive);
+    // Finds all matches in the windows in parallel, findString() then only looks them up.
+    static void prepareFind(const QVector<DiffTextWindow*>& windows, const QString& s, bool bCaseSensitive);
+    bool hasFindMatches(const QString& s, bool bCaseSensitive) const;
+    void findMatches(const QString& s, bool bCaseSensitive);
     void setSelection(LineRef firstLine, int startPos, LineRef lastLine, int endPos, LineRef& l, int& p);
     void getSelectionRange(LineRef* firstLine, LineRef* lastLine, e_CoordType coordType);
 
     void setPaintingAllowed(bool bAllowPainting);
-    void recalcWordWrap(bool bWordWrap, int wrapLineVectorSize, int visibleTextWidth);
-    void recalcWordWrapHelper(int wrapLineVectorSize, int visibleTextWidth, int cacheListIdx);
-
-    void printWindow(RLPainter& painter, const QRect& view, const QString& headerText, int line, int linesPerPage, const QColor& fgColor);
-    void print(RLPainter& painter, const QRect& r, int firstLine, int nofLinesPerPage);
+    /*
+        With wrapLineVectorSize 0 the lines are laid out, the chunks around firstD3LIdx right away
+        and the others by runnables. Otherwise the wrap lines are made from the chunks laid out,
+        lines of other chunks are shown unwrapped until theirs is done.
+    */
+    void recalcWordWrap(bool bWordWrap, int wrapLineVectorSize, int visibleTextWidth, int firstD3LIdx = -1);
+    // pTask is the runnable calling, the layout stops once it is cancelled.
+    void recalcWordWrapHelper(int wrapLineVectorSize, int visibleTextWidth, int cacheListIdx, const TaskGroup::Task* pTask = nullptr);
+
+    // With pLayouts the lines are drawn with the layouts layoutPrintPage() made, see print().
+    void printWindow(RLPainter& painter, const QRect& view, const QString& headerText, int line, int linesPerPage, const QColor& fgColor,
+                     TextLayoutCache* pLayouts = nullptr);
+    void print(RLPainter& painter, const QRect& r, int firstLine, int nofLinesPerPage, TextLayoutCache* pLayouts = nullptr);
+    /*
+        Lays out the lines print() draws for the page into layouts. Doesn't change the window, so it
+        may run on a worker thread while the GUI thread prints another page.
+    */
+    void layoutPrintPage(TextLayoutCache& layouts, int firstLine, int nofLinesPerPage);
 
     static bool startRunnables();
+    /*
+        Cancels the runnables, pending or started, and blocks until the started ones ended.
+        No finishRecalcWordWrap is emitted for them.
+    */
+    static void stopRunnables();
 
     bool isThreeWay() const;
     const QString& getFileName() const;
@@ -106,6 +133,10 @@ class DiffTextWindow : public QWidget
     void lineClicked(e_SrcSelector winIdx, LineRef line);
 
     void finishRecalcWordWrap(int visibleTextWidthForPrinting);
+    void wrapChunkFinished(int wrapGeneration, int cacheListIdx);
+    void wordWrapTasksFinished(int visibleTextWidthForPrinting, int wrapGeneration);
+    // More lines of this window were wrapped in the background.
+    void wordWrapProgress();
 
     void finishDrop();
 
@@ -119,6 +150,10 @@ class DiffTextWindow : public QWidget
 
     void slotSelectAll();
 
+  private Q_SLOTS:
+    void slotWrapChunkFinished(int wrapGeneration, int cacheListIdx);
+    void slotWordWrapTasksFinished(int visibleTextWidthForPrinting, int wrapGeneration);
+
   protected:
     void mousePressEvent(QMouseEvent*) override;
     void mouseReleaseEvent(QMouseEvent*) override;
@@ -137,7 +172,7 @@ class DiffTextWindow : public QWidget
     void timerEvent(QTimerEvent*) override;
 
   private:
-    static QList<RecalcWordWrapRunnable*> s_runnables;
+    static TaskGroup s_wordWrapTasks;
     static constexpr int s_linesPerRunnable = 2000;
 
     DiffTextWindowData* d;
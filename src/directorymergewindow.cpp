@@ -7,10 +7,13 @@
 */
 #include "directorymergewindow.h"
 
+#include "ContentHashCache.h"
 #include "DirectoryInfo.h"
 #include "MergeFileInfos.h"
 #include "PixMapUtils.h"
+#include "Logging.h"
 #include "Utils.h"
+#include "WildcardMatcher.h"
 #include "guiutils.h"
 #include "kdiff3.h"
 #include "options.h"
@@ -26,28 +29,41 @@
 #include <QDir>
 #include <QElapsedTimer>
 #include <QFileDialog>
+#include <QFileSystemWatcher>
+#include <QHash>
 #include <QImage>
 #include <QKeyEvent>
 #include <QLabel>
 #include <QLayout>
 #include <QMenu>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QPainter>
 #include <QPushButton>
 #include <QRegExp>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QScrollBar>
+#include <QSemaphore>
+#include <QSet>
 #include <QSplitter>
 #include <QStyledItemDelegate>
-#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
 
 #include <KLocalizedString>
 #include <KMessageBox>
 #include <KTextEdit>
 #include <KToggleAction>
 
+// The state of an item kept over a rescan, see DirectoryMergeWindowPrivate::init().
 struct DirectoryMergeWindow::t_ItemInfo {
     bool bExpanded;
     bool bOperationComplete;
-    QString status;
+    e_OperationStatus eOpStatus;
     e_MergeOperation eMergeOperation;
+    int comparison; // See comparisonState(), the operation is only kept if this is the same.
 };
 
 class StatusInfo : public QDialog
@@ -117,6 +133,53 @@ enum Columns
 
 static Qt::CaseSensitivity s_eCaseSensitivity = Qt::CaseSensitive;
 
+/*
+    The comparisons of local files that run on worker threads while the tree is shown already.
+    The workers take the items prioritize() put first, then the others in tree order. Only the GUI
+    thread reads the results of an item, after it took it back with takeCompared().
+*/
+class ComparisonQueue
+{
+  public:
+    ComparisonQueue();
+    ~ComparisonQueue() { stop(); }
+
+    void start(const QVector<MergeFileInfos*>& items, const QVector<MergeFileInfos*>& priorityItems, const QSharedPointer<Options>& pOptions);
+    // Replaces the items compared first, the ones compared already are left out.
+    void prioritize(const QVector<MergeFileInfos*>& items);
+    // Takes items out that no worker has started, returns those.
+    QVector<MergeFileInfos*> unqueue(const QVector<MergeFileInfos*>& items);
+    // The items compared since the last call.
+    QVector<MergeFileInfos*> takeCompared(QStringList& errors);
+    // Returns false if no item was compared within msecs.
+    bool waitForCompared(int msecs) { return m_itemCompared.tryAcquire(1, msecs); }
+    // Waits for the items being compared, the others aren't compared anymore.
+    void stop();
+
+    // For the workers, takeNext() returns nullptr once there is nothing left.
+    MergeFileInfos* takeNext();
+    void compared(MergeFileInfos* pMFI, const QStringList& errors);
+
+  private:
+    QMutex m_mutex;
+    QVector<MergeFileInfos*> m_items;
+    int m_nextItem = 0;
+    QVector<MergeFileInfos*> m_priorityItems;
+    int m_nextPriorityItem = 0;
+    QSet<MergeFileInfos*> m_queuedItems; // Not taken by a worker yet.
+    QVector<MergeFileInfos*> m_comparedItems;
+    QStringList m_errors;
+    QAtomicInt m_bStop;
+    QSemaphore m_itemCompared;
+    QSemaphore m_workersFinished;
+    int m_nofWorkers = 0;
+    /*
+        The workers keep comparing until the queue is empty. On the global pool they would hold the
+        threads that loading, word wrapping and printing a file comparison wait for.
+    */
+    QThreadPool m_pool;
+};
+
 //TODO: clean up this mess.
 class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemModel
 {
@@ -129,9 +192,17 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemMo
         mWindow = pDMW;
         m_pStatusInfo = new StatusInfo(mWindow);
         m_pStatusInfo->hide();
+
+        m_folderChangeTimer.setSingleShot(true);
+        m_folderChangeTimer.setInterval(folderChangeDelay);
+        m_comparedItemsTimer.setInterval(comparedItemsInterval);
+        m_prioritizeTimer.setSingleShot(true);
+        m_prioritizeTimer.setInterval(prioritizeDelay);
     }
     ~DirectoryMergeWindowPrivate() override
     {
+        // The workers use the items.
+        m_comparisons.stop();
         delete m_pRoot;
     }
     // Implement QAbstractItemModel
@@ -146,11 +217,12 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemMo
         MergeFileInfos* pParentsParent = pMFI->parent()->parent();
         return createIndex(pParentsParent->children().indexOf(pMFI->parent()), 0, pMFI->parent());
     }
+    // Folders other than the top level only show their rows once the view fetched them.
     int rowCount(const QModelIndex& parent = QModelIndex()) const override
     {
         MergeFileInfos* pParentMFI = getMFI(parent);
         if(pParentMFI != nullptr)
-            return pParentMFI->children().count();
+            return isFetched(pParentMFI) ? pParentMFI->children().count() : 0;
         else
             return m_pRoot->children().count();
     }
@@ -160,14 +232,20 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemMo
     }
     QModelIndex index(int row, int column, const QModelIndex& parent) const override
     {
-        MergeFileInfos* pParentMFI = getMFI(parent);
-        if(pParentMFI == nullptr && row < m_pRoot->children().count())
-            return createIndex(row, column, m_pRoot->children()[row]);
-        else if(pParentMFI != nullptr && row < pParentMFI->children().count())
-            return createIndex(row, column, pParentMFI->children()[row]);
-        else
+        if(row < 0 || row >= rowCount(parent))
             return QModelIndex();
+        return createIndex(row, column, childMFI(row, parent));
+    }
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const override
+    {
+        return nofChildren(parent) > 0;
+    }
+    bool canFetchMore(const QModelIndex& parent) const override
+    {
+        MergeFileInfos* pParentMFI = getMFI(parent);
+        return pParentMFI != nullptr && !isFetched(pParentMFI) && !pParentMFI->children().isEmpty();
     }
+    void fetchMore(const QModelIndex& parent) override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
     void sort(int column, Qt::SortOrder order) override;
     // private data and helper methods
@@ -179,6 +257,31 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemMo
             return nullptr;
     }
 
+    /*
+        The whole tree, whether the view fetched the rows or not. Everything but the view walks the
+        items with these, the indexes they return must only be passed to the view after
+        ensureFetched().
+    */
+    int nofChildren(const QModelIndex& parent) const
+    {
+        MergeFileInfos* pParentMFI = getMFI(parent);
+        return (pParentMFI != nullptr ? pParentMFI : m_pRoot)->children().count();
+    }
+    QModelIndex childIndex(int row, const QModelIndex& parent) const
+    {
+        if(row < 0 || row >= nofChildren(parent))
+            return QModelIndex();
+        return createIndex(row, 0, childMFI(row, parent));
+    }
+    void ensureFetched(const QModelIndex& mi);
+    bool isItemHidden(const QModelIndex& mi) const { return m_hiddenItems.contains(getMFI(mi)); }
+    void setItemHidden(const QModelIndex& mi, bool bHidden);
+    void itemChanged(const QModelIndex& mi)
+    {
+        if(mi.isValid() && isFetched(mi.parent()))
+            Q_EMIT dataChanged(mi, mi);
+    }
+
     bool isThreeWay() const
     {
         if(rootMFI() == nullptr) return false;
@@ -188,12 +291,101 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemMo
 
     QSharedPointer<Options> m_pOptions = nullptr;
 
-    void calcDirStatus(bool bThreeDirs, const QModelIndex& mi,
-                       int& nofFiles, int& nofDirs, int& nofEqualFiles, int& nofManualMerges);
+    // Counts for the status report, gathered while the items are compared and their operations set.
+    struct DirStatus
+    {
+        int nofFiles = 0;
+        int nofDirs = 0;
+        int nofEqualFiles = 0;
+        int nofManualMerges = 0;
+    };
+    DirStatus m_dirStatus;
+
+    void addToDirStatus(const MergeFileInfos& mfi);
+    static bool isManualMerge(const MergeFileInfos& mfi);
+
+    /*
+        In watch mode the local folders are watched once they are scanned. A changed folder is
+        listed again: if it still has the same entries only its changed files are compared again,
+        otherwise all is rescanned, keeping the expanded folders and the operations of the items.
+        The changes are taken together, editors often write several times when saving.
+    */
+    static const int folderChangeDelay = 500; // ms
+    QFileSystemWatcher m_folderWatcher;
+    QTimer m_folderChangeTimer;
+    QSet<QString> m_changedFolders;
+
+    /*
+        A snapshot of a folder comparison saved by saveSnapshot(). Loading one opens its folders
+        again, then the items whose files still have the same type, size and time take their
+        comparison results from it instead of being compared again. Their operations are kept
+        like on a rescan.
+    */
+    struct SnapshotFile
+    {
+        quint8 type; // 0 if missing, see snapshotFile().
+        qint64 size;
+        qint64 lastModified;
+    };
+    struct SnapshotItem
+    {
+        SnapshotFile files[3];
+        QByteArray comparison; // See MergeFileInfos::writeComparison().
+        t_ItemInfo state;
+    };
+    QStringList m_snapshotDirs; // A, B, C and the destination if one was given.
+    quint8 m_snapshotComparisonMode = 0;
+    QHash<QString, SnapshotItem> m_snapshot;
+
+    bool saveSnapshot(const QString& fileName);
+    bool loadSnapshot(const QString& fileName);
+    bool takeSnapshotComparison(MergeFileInfos& mfi) const;
+    static QStringList snapshotDirs(const DirectoryInfo& dirInfo);
+    static SnapshotFile snapshotFile(const FileAccess* pFA);
+    // The options that change the results of the comparisons.
+    static quint8 comparisonMode(const Options& options);
+
+    /*
+        Local files are compared on worker threads while the tree is shown, the rows on screen and
+        in expanded folders first. The scan only waits for the rows shown first, and for all of them
+        unless that takes longer than backgroundComparisonDelay. The results of a pending item are
+        only read once takeComparedItems() took it back, then its operation is suggested.
+        Everything that needs all results calls finishComparisons() first.
+    */
+    static const int backgroundComparisonDelay = 1000; // ms
+    static const int comparedItemsInterval = 200; // ms
+    static const int prioritizeDelay = 50; // ms, scrolling moves the view many times
+    static const int maxNofFirstItems = 200; // About the rows of a screen
+    ComparisonQueue m_comparisons;
+    QSet<const MergeFileInfos*> m_pendingItems;
+    // The operations kept over a rescan of items still pending, see init().
+    QHash<const MergeFileInfos*, t_ItemInfo> m_pendingItemStates;
+    QStringList m_comparisonErrors;
+    bool m_bDirStatusPending = false; // The status report waits for the pending items.
+    QTimer m_comparedItemsTimer;
+    QTimer m_prioritizeTimer;
+
+    bool isComparisonPending(const MergeFileInfos* pMFI) const { return m_pendingItems.contains(pMFI); }
+    void prioritizeComparisons();
+    void takeComparedItems();
+    void finishComparison(MergeFileInfos* pMFI);
+    // Returns false if the user cancelled waiting.
+    bool finishComparisons();
+    void stopComparisons();
+    void showComparisonErrors();
+    void showDirStatus();
+
+    void watchFolders();
+    void unwatchFolders();
+    void updateChangedFolders();
+    bool updateChangedFolder(const QString& path, QVector<MergeFileInfos*>& changedItems);
+    static int comparisonState(const MergeFileInfos& mfi);
+    e_MergeOperation defaultMergeOperation() const;
+    QModelIndex indexOf(MergeFileInfos* pMFI) const;
 
     void mergeContinue(bool bStart, bool bVerbose);
 
-    void prepareListView(ProgressProxy& pp);
+    void prepareListView(ProgressProxy& pp, const std::map<QString, t_ItemInfo>& expandedDirsMap);
     void calcSuggestedOperation(const QModelIndex& mi, e_MergeOperation eDefaultMergeOp);
     void setAllMergeOperations(e_MergeOperation eDefaultOperation);
 
@@ -201,6 +393,30 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemMo
     QModelIndex treeIterator(QModelIndex mi, bool bVisitChildren = true, bool bFindInvisible = false);
     void prepareMergeStart(const QModelIndex& miBegin, const QModelIndex& miEnd, bool bVerbose);
     bool executeMergeOperation(MergeFileInfos& mfi, bool& bSingleFileMerge);
+    // Runs the operations that need neither the user nor KIO.
+    bool executeFileOperation(const MergeFileInfos& mfi, QStringList& statusText);
+    void addStatusText(const QStringList& statusText);
+
+    /*
+        Copies and deletes in local folders run on worker threads in batches. A batch takes the
+        items from the current one on up to the first that needs the GUI thread, like a manual
+        merge. Its folders are made first, then the files, with the items of a folder in order.
+        mergeContinue() takes the results in the order of m_mergeItemList.
+    */
+    struct FileOperation
+    {
+        MergeFileInfos* pMFI;
+        bool bDone;
+        bool bSuccess;
+        QStringList statusText;
+    };
+    class FileOperationsRunnable;
+
+    bool canRunOnWorkerThread(const MergeFileInfos& mfi) const;
+    void runFileOperationBatch(ProgressProxy& pp);
+    void runFileOperations(std::vector<std::vector<FileOperation>>& folders, int nofWorkers, QAtomicInt& bStop, ProgressProxy& pp);
+
+    QHash<const MergeFileInfos*, FileOperation> m_fileOperationResults;
 
     void scanDirectory(const QString& dirName, t_DirectoryList& dirList);
     void scanLocalDirectory(const QString& dirName, t_DirectoryList& dirList);
@@ -209,68 +425,42 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemMo
     bool isDir(const QModelIndex& mi) const;
     QString getFileName(const QModelIndex& mi) const;
 
-    bool copyFLD(const QString& srcName, const QString& destName);
-    bool deleteFLD(const QString& name, bool bCreateBackup);
-    bool makeDir(const QString& name, bool bQuiet = false);
-    bool renameFLD(const QString& srcName, const QString& destName);
+    // These only add their messages to statusText, so they can run on worker threads for local files.
+    bool copyFLD(const QString& srcName, const QString& destName, QStringList& statusText);
+    bool deleteFLD(const QString& name, bool bCreateBackup, QStringList& statusText);
+    bool makeDir(const QString& name, QStringList& statusText, bool bQuiet = false);
+    bool renameFLD(const QString& srcName, const QString& destName, QStringList& statusText);
     bool mergeFLD(const QString& nameA, const QString& nameB, const QString& nameC,
                   const QString& nameDest, bool& bSingleFileMerge);
 
     void buildMergeMap(const QSharedPointer<DirectoryInfo>& dirInfo);
 
   private:
-    class FileKey
-    {
-      private:
-        const FileAccess* m_pFA;
-
-      public:
-        explicit FileKey(const FileAccess& fa)
-            : m_pFA(&fa) {}
+    // See MergeFileInfos::buildMergeMap().
+    typedef QHash<QString, MergeFileInfos> t_fileMergeMap;
 
-        quint32 getParents(const FileAccess* pFA, const FileAccess* v[], quint32 maxSize) const
-        {
-            quint32 s = 0;
-            for(s = 0; pFA->parent() != nullptr; pFA = pFA->parent(), ++s)
-            {
-                if(s == maxSize)
-                    break;
-                v[s] = pFA;
-            }
-            return s;
-        }
-
-        // This is essentially the same as
-        // int r = filePath().compare( fa.filePath() )
-        // if ( r<0 ) return true;
-        // if ( r==0 ) return m_col < fa.m_col;
-        // return false;
-        bool operator<(const FileKey& fk) const
-        {
-            const FileAccess* v1[100];
-            const FileAccess* v2[100];
-            quint32 v1Size = getParents(m_pFA, v1, 100);
-            quint32 v2Size = getParents(fk.m_pFA, v2, 100);
-
-            for(quint32 i = 0; i < v1Size && i < v2Size; ++i)
-            {
-                int r = v1[v1Size - i - 1]->fileName().compare(v2[v2Size - i - 1]->fileName(), s_eCaseSensitivity);
-                if(r < 0)
-                    return true;
-                else if(r > 0)
-                    return false;
-            }
-
-            return v1Size < v2Size;
-        }
-    };
+    // Orders the items by path with a parent folder right before its contents.
+    static bool lessMergeKey(const t_fileMergeMap::iterator& i1, const t_fileMergeMap::iterator& i2);
 
-    typedef QMap<FileKey, MergeFileInfos> t_fileMergeMap;
+    MergeFileInfos* childMFI(int row, const QModelIndex& parent) const
+    {
+        MergeFileInfos* pParentMFI = getMFI(parent);
+        return (pParentMFI != nullptr ? pParentMFI : m_pRoot)->children()[row];
+    }
+    bool isFetched(const MergeFileInfos* pMFI) const { return pMFI == m_pRoot || m_fetchedDirs.contains(pMFI); }
+    bool isFetched(const QModelIndex& mi) const { return !mi.isValid() || isFetched(getMFI(mi)); }
+    // Applies the visibility kept in m_hiddenItems to the rows of a folder the view just got.
+    void showFetchedRows(const QModelIndex& parent);
 
     MergeFileInfos* m_pRoot = new MergeFileInfos();
 
     t_fileMergeMap m_fileMergeMap;
 
+    // Folders whose rows were inserted for the view, the top level always is.
+    QSet<const MergeFileInfos*> m_fetchedDirs;
+    // Kept here as the view only knows of fetched rows.
+    QSet<const MergeFileInfos*> m_hiddenItems;
+
   public:
     bool m_bFollowDirLinks = false;
     bool m_bFollowFileLinks = false;
@@ -301,6 +491,7 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemMo
     QPointer<QAction> m_pDirCompareCurrent;
     QPointer<QAction> m_pDirMergeCurrent;
     QPointer<QAction> m_pDirRescan;
+    KToggleAction* m_pDirWatchFolders;
     QPointer<QAction> m_pDirChooseAEverywhere;
     QPointer<QAction> m_pDirChooseBEverywhere;
     QPointer<QAction> m_pDirChooseCEverywhere;
@@ -341,13 +532,14 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate : public QAbstractItemMo
     QPointer<QAction> m_pDirSaveMergeState;
     QPointer<QAction> m_pDirLoadMergeState;
 
-    bool init(const QSharedPointer<DirectoryInfo>& dirInfo, bool bDirectoryMerge, bool bReload);
+    // bShowStatus is false for the rescans of watch mode, they only report on the status bar.
+    bool init(const QSharedPointer<DirectoryInfo>& dirInfo, bool bDirectoryMerge, bool bReload, bool bShowStatus = true);
     void setOpStatus(const QModelIndex& mi, e_OperationStatus eOpStatus)
     {
         if(MergeFileInfos* pMFI = getMFI(mi))
         {
             pMFI->setOpStatus(eOpStatus);
-            Q_EMIT dataChanged(mi, mi);
+            itemChanged(mi);
         }
     }
 
@@ -359,8 +551,15 @@ QVariant DirectoryMergeWindow::DirectoryMergeWindowPrivate::data(const QModelInd
     MergeFileInfos* pMFI = getMFI(index);
     if(pMFI)
     {
+        // A worker writes the results of a pending item meanwhile, only its files are shown.
+        const bool bPending = isComparisonPending(pMFI);
         if(role == Qt::DisplayRole)
         {
+            if(bPending && index.column() >= s_UnsolvedCol)
+                return QVariant();
+            if(bPending && index.column() == s_OpStatusCol && pMFI->getOpStatus() == eOpStatusNone)
+                return i18n("Comparing...");
+
             switch(index.column())
             {
                 case s_NameCol:
@@ -476,15 +675,15 @@ QVariant DirectoryMergeWindow::DirectoryMergeWindowPrivate::data(const QModelInd
 
             if(s_ACol == index.column())
             {
-                return PixMapUtils::getOnePixmap(pMFI->getAgeA(), pMFI->isLinkA(), pMFI->isDirA());
+                return PixMapUtils::getOnePixmap(bPending && pMFI->existsInA() ? eAgeEnd : pMFI->getAgeA(), pMFI->isLinkA(), pMFI->isDirA());
             }
             if(s_BCol == index.column())
             {
-                return PixMapUtils::getOnePixmap(pMFI->getAgeB(), pMFI->isLinkB(), pMFI->isDirB());
+                return PixMapUtils::getOnePixmap(bPending && pMFI->existsInB() ? eAgeEnd : pMFI->getAgeB(), pMFI->isLinkB(), pMFI->isDirB());
             }
             if(s_CCol == index.column())
             {
-                return PixMapUtils::getOnePixmap(pMFI->getAgeC(), pMFI->isLinkC(), pMFI->isDirC());
+                return PixMapUtils::getOnePixmap(bPending && pMFI->existsInC() ? eAgeEnd : pMFI->getAgeC(), pMFI->isLinkC(), pMFI->isDirC());
             }
         }
         else if(role == Qt::TextAlignmentRole)
@@ -630,6 +829,11 @@ DirectoryMergeWindow::DirectoryMergeWindow(QWidget* pParent, const QSharedPointe
     setItemDelegate(new DirMergeItemDelegate(this));
     chk_connect_a(this, &DirectoryMergeWindow::doubleClicked, this, &DirectoryMergeWindow::onDoubleClick);
     chk_connect_a(this, &DirectoryMergeWindow::expanded, this, &DirectoryMergeWindow::onExpanded);
+    chk_connect_a(&d->m_folderWatcher, &QFileSystemWatcher::directoryChanged, this, &DirectoryMergeWindow::slotFolderChanged);
+    chk_connect_a(&d->m_folderChangeTimer, &QTimer::timeout, this, &DirectoryMergeWindow::slotUpdateChangedFolders);
+    chk_connect_a(&d->m_comparedItemsTimer, &QTimer::timeout, this, &DirectoryMergeWindow::slotTakeComparedItems);
+    chk_connect_a(&d->m_prioritizeTimer, &QTimer::timeout, this, &DirectoryMergeWindow::slotPrioritizeComparisons);
+    chk_connect_a(verticalScrollBar(), &QScrollBar::valueChanged, this, &DirectoryMergeWindow::slotViewMoved);
 
     d->m_pOptions = pOptions;
 
@@ -686,29 +890,308 @@ void DirectoryMergeWindow::reload()
     updateFileVisibilities();
 }
 
-void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcDirStatus(bool bThreeDirs, const QModelIndex& mi,
-                                                                      int& nofFiles, int& nofDirs, int& nofEqualFiles, int& nofManualMerges)
+void DirectoryMergeWindow::slotWatchFolders()
+{
+    d->m_pOptions->m_bDmWatchFolders = d->m_pDirWatchFolders->isChecked();
+    if(d->m_pOptions->m_bDmWatchFolders && !d->m_bScanning)
+        d->watchFolders();
+    else
+        d->unwatchFolders();
+}
+
+void DirectoryMergeWindow::slotFolderChanged(const QString& path)
+{
+    d->m_changedFolders.insert(path);
+    d->m_folderChangeTimer.start();
+}
+
+void DirectoryMergeWindow::slotUpdateChangedFolders()
 {
-    const MergeFileInfos* pMFI = getMFI(mi);
-    if(pMFI->hasDir())
+    d->updateChangedFolders();
+}
+
+// Only local folders can be watched, remote ones still need a rescan.
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::watchFolders()
+{
+    unwatchFolders();
+
+    const QSharedPointer<DirectoryInfo> dirInfo = rootMFI()->getDirectoryInfo();
+    if(!m_pOptions->m_bDmWatchFolders || dirInfo == nullptr)
+        return;
+
+    const FileAccess dirs[3] = {dirInfo->dirA(), dirInfo->dirB(), dirInfo->dirC()};
+    const t_DirectoryList* const dirLists[3] = {&dirInfo->getDirListA(), &dirInfo->getDirListB(), &dirInfo->getDirListC()};
+    QStringList folders;
+    for(int i = 0; i < 3; ++i)
+    {
+        if(!dirs[i].isValid() || !dirs[i].isLocal())
+            continue;
+
+        folders.append(dirs[i].absoluteFilePath());
+        for(const FileAccess& fa: *dirLists[i])
+        {
+            if(fa.isDir() && (!fa.isSymLink() || m_bFollowDirLinks))
+                folders.append(fa.absoluteFilePath());
+        }
+    }
+
+    if(folders.isEmpty())
+        return;
+
+    // The system limits the number of watches, the folders beyond it are only updated by a rescan.
+    const QStringList failedFolders = m_folderWatcher.addPaths(folders);
+    if(!failedFolders.isEmpty())
+        qCWarning(kdiffMain) << "Watching" << failedFolders.size() << "of" << folders.size() << "folders failed.";
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::unwatchFolders()
+{
+    const QStringList folders = m_folderWatcher.directories();
+    if(!folders.isEmpty())
+        m_folderWatcher.removePaths(folders);
+
+    m_folderChangeTimer.stop();
+    m_changedFolders.clear();
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::updateChangedFolders()
+{
+    // A folder merge changes the folders itself and shows the results already.
+    if(m_bRealMergeStarted)
+    {
+        m_changedFolders.clear();
+        return;
+    }
+    // The changed items may be pending still.
+    if(m_bScanning || !m_pendingItems.isEmpty())
+    {
+        m_folderChangeTimer.start();
+        return;
+    }
+
+    // Events are processed while the files are read, more changes may come in meanwhile.
+    const QSet<QString> changedFolders = m_changedFolders;
+    m_changedFolders.clear();
+    m_bScanning = true;
+
+    QVector<MergeFileInfos*> changedItems;
+    bool bRescan = false;
+    for(const QString& path: changedFolders)
+    {
+        if(!updateChangedFolder(path, changedItems))
+        {
+            bRescan = true;
+            break;
+        }
+    }
+
+    if(bRescan)
+    {
+        m_bScanning = false;
+        init(rootMFI()->getDirectoryInfo(), m_bDirectoryMerge, true, false);
+        mWindow->updateFileVisibilities();
+        Q_EMIT mWindow->statusBarMessage(i18n("Folders changed, rescan done."));
+        return;
+    }
+
+    if(changedItems.isEmpty())
     {
-        ++nofDirs;
+        m_bScanning = false;
+        return;
+    }
+
+    QStringList errors;
+    for(MergeFileInfos* pMFI: changedItems)
+    {
+        const int previousComparison = comparisonState(*pMFI);
+        pMFI->resetComparison();
+        pMFI->compareFilesAndCalcAges(errors, m_pOptions, mWindow);
+
+        // Operations the user already chose or ran stay, only suggestions follow the new result.
+        const QModelIndex mi = indexOf(pMFI);
+        if(pMFI->getOpStatus() == eOpStatusNone && comparisonState(*pMFI) != previousComparison)
+        {
+            e_MergeOperation eParentMergeOp = pMFI->parent() == m_pRoot ? defaultMergeOperation() : pMFI->parent()->getOperation();
+            if(eParentMergeOp == eConflictingFileTypes)
+                eParentMergeOp = eMergeABCToDest;
+            calcSuggestedOperation(mi, eParentMergeOp);
+        }
+
+        for(QModelIndex miChanged = mi; miChanged.isValid(); miChanged = miChanged.parent())
+            itemChanged(miChanged);
     }
+
+    if(m_pOptions->m_bDmUseHashCache)
+        ContentHashCache::instance().save();
+
+    // Sets the equality of the folders above the changed files again.
+    mWindow->updateFileVisibilities();
+    m_bScanning = false;
+
+    if(errors.isEmpty())
+        Q_EMIT mWindow->statusBarMessage(i18np("Compared 1 changed item again.", "Compared %1 changed items again.", changedItems.size()));
     else
+        Q_EMIT mWindow->statusBarMessage(i18n("Some changed files could not be processed: %1", errors.first()));
+}
+
+/*
+    Reads the status of the files of a changed folder again and collects the items whose files
+    changed. Returns false if entries were added or removed or changed their type, the tree only
+    gets those with a rescan.
+*/
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::updateChangedFolder(const QString& path, QVector<MergeFileInfos*>& changedItems)
+{
+    const QSharedPointer<DirectoryInfo> dirInfo = rootMFI()->getDirectoryInfo();
+    const FileAccess dirs[3] = {dirInfo->dirA(), dirInfo->dirB(), dirInfo->dirC()};
+    FileAccess* (MergeFileInfos::*const getFileInfos[3])() const = {&MergeFileInfos::getFileInfoA, &MergeFileInfos::getFileInfoB, &MergeFileInfos::getFileInfoC};
+
+    for(int i = 0; i < 3; ++i)
     {
-        ++nofFiles;
-        if(pMFI->isEqualAB() && (!bThreeDirs || pMFI->isEqualAC()))
+        if(!dirs[i].isValid() || !dirs[i].isLocal())
+            continue;
+
+        const QString rootPath = dirs[i].absoluteFilePath();
+        if(path != rootPath && !path.startsWith(rootPath + '/'))
+            continue;
+
+        const MergeFileInfos* pFolderMFI = m_pRoot;
+        if(path != rootPath)
         {
-            ++nofEqualFiles;
+            const QString relPath = QDir(rootPath).relativeFilePath(path);
+            const t_fileMergeMap::const_iterator it = m_fileMergeMap.constFind(s_eCaseSensitivity == Qt::CaseSensitive ? relPath : relPath.toCaseFolded());
+            if(it == m_fileMergeMap.constEnd())
+                return false;
+            pFolderMFI = &it.value();
         }
-        else
+
+        FileAccess folder(path);
+        t_DirectoryList entries;
+        if(!folder.listDir(&entries, false, m_pOptions->m_bDmFindHidden, m_pOptions->m_DmFilePattern, m_pOptions->m_DmFileAntiPattern,
+                           m_pOptions->m_DmDirAntiPattern, m_bFollowDirLinks, m_pOptions->m_bDmUseCvsIgnore))
+            return false;
+
+        QHash<QString, const FileAccess*> listedEntries;
+        for(const FileAccess& fa: entries)
+            listedEntries.insert(s_eCaseSensitivity == Qt::CaseSensitive ? fa.fileName() : fa.fileName().toCaseFolded(), &fa);
+
+        int nofKnownEntries = 0;
+        for(MergeFileInfos* pMFI: pFolderMFI->children())
         {
-            if(pMFI->getOperation() == eMergeABCToDest || pMFI->getOperation() == eMergeABToDest)
-                ++nofManualMerges;
+            FileAccess* pFA = (pMFI->*getFileInfos[i])();
+            if(pFA == nullptr)
+                continue;
+
+            ++nofKnownEntries;
+            const QHash<QString, const FileAccess*>::const_iterator it =
+                listedEntries.constFind(s_eCaseSensitivity == Qt::CaseSensitive ? pFA->fileName() : pFA->fileName().toCaseFolded());
+            if(it == listedEntries.constEnd() || (*it)->isDir() != pFA->isDir() || (*it)->isSymLink() != pFA->isSymLink())
+                return false;
+
+            if(!pFA->isDir() && ((*it)->size() != pFA->size() || (*it)->lastModified() != pFA->lastModified()))
+            {
+                pFA->setFile(pFA->parent(), QFileInfo(pFA->absoluteFilePath()));
+                if(!changedItems.contains(pMFI))
+                    changedItems.push_back(pMFI);
+            }
         }
+
+        if(nofKnownEntries != listedEntries.size())
+            return false;
+    }
+
+    return true;
+}
+
+// Which files exist and which are equal, a rescan keeps the operation of an item while this stays.
+int DirectoryMergeWindow::DirectoryMergeWindowPrivate::comparisonState(const MergeFileInfos& mfi)
+{
+    return (mfi.existsInA() ? 1 : 0) | (mfi.existsInB() ? 2 : 0) | (mfi.existsInC() ? 4 : 0) | (mfi.isEqualAB() ? 8 : 0) |
+           (mfi.isEqualAC() ? 16 : 0) | (mfi.isEqualBC() ? 32 : 0) | (mfi.hasDir() ? 64 : 0);
+}
+
+e_MergeOperation DirectoryMergeWindow::DirectoryMergeWindowPrivate::defaultMergeOperation() const
+{
+    if(rootMFI()->getDirectoryInfo()->dirC().isValid())
+        return eMergeABCToDest;
+
+    return m_bSyncMode ? eMergeToAB : eMergeABToDest;
+}
+
+QModelIndex DirectoryMergeWindow::DirectoryMergeWindowPrivate::indexOf(MergeFileInfos* pMFI) const
+{
+    if(pMFI == nullptr || pMFI == m_pRoot)
+        return QModelIndex();
+
+    return createIndex(pMFI->parent()->children().indexOf(pMFI), 0, pMFI);
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::fetchMore(const QModelIndex& parent)
+{
+    if(!canFetchMore(parent))
+        return;
+
+    MergeFileInfos* pParentMFI = getMFI(parent);
+    beginInsertRows(parent, 0, pParentMFI->children().count() - 1);
+    m_fetchedDirs.insert(pParentMFI);
+    endInsertRows();
+
+    showFetchedRows(parent);
+}
+
+// Fetches the folders above mi, so the view can show it.
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::ensureFetched(const QModelIndex& mi)
+{
+    if(!mi.isValid())
+        return;
+
+    const QModelIndex miParent = mi.parent();
+    ensureFetched(miParent);
+    fetchMore(miParent);
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::setItemHidden(const QModelIndex& mi, bool bHidden)
+{
+    if(bHidden)
+        m_hiddenItems.insert(getMFI(mi));
+    else
+        m_hiddenItems.remove(getMFI(mi));
+
+    if(isFetched(mi.parent()))
+        mWindow->setRowHidden(mi.row(), mi.parent(), bHidden);
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::showFetchedRows(const QModelIndex& parent)
+{
+    if(m_hiddenItems.isEmpty())
+        return;
+
+    for(int row = 0; row < nofChildren(parent); ++row)
+    {
+        if(m_hiddenItems.contains(childMFI(row, parent)))
+            mWindow->setRowHidden(row, parent, true);
+    }
+}
+
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::isManualMerge(const MergeFileInfos& mfi)
+{
+    if(mfi.hasDir() || (mfi.isEqualAB() && (!mfi.isThreeWay() || mfi.isEqualAC())))
+        return false;
+
+    return mfi.getOperation() == eMergeABCToDest || mfi.getOperation() == eMergeABToDest;
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::addToDirStatus(const MergeFileInfos& mfi)
+{
+    if(mfi.hasDir())
+    {
+        ++m_dirStatus.nofDirs;
+    }
+    else
+    {
+        ++m_dirStatus.nofFiles;
+        if(mfi.isEqualAB() && (!mfi.isThreeWay() || mfi.isEqualAC()))
+            ++m_dirStatus.nofEqualFiles;
     }
-    for(int childIdx = 0; childIdx < rowCount(mi); ++childIdx)
-        calcDirStatus(bThreeDirs, index(childIdx, 0, mi), nofFiles, nofDirs, nofEqualFiles, nofManualMerges);
 }
 
 bool DirectoryMergeWindow::init(
@@ -719,48 +1202,57 @@ bool DirectoryMergeWindow::init(
     return d->init(dirInfo, bDirectoryMerge, bReload);
 }
 
-void DirectoryMergeWindow::DirectoryMergeWindowPrivate::buildMergeMap(const QSharedPointer<DirectoryInfo>& dirInfo)
+// Lists one of the folders of a DirectoryInfo on a worker thread, each folder has a list of its own.
+class ListDirRunnable : public QRunnable
 {
-    t_DirectoryList::iterator dirIterator;
+  private:
+    DirectoryInfo& m_dirInfo;
+    bool (DirectoryInfo::*m_listDir)(const Options&);
+    const Options& m_options;
+    bool& m_bSuccess;
+    QSemaphore& m_finished;
 
-    if(dirInfo->dirA().isValid())
+  public:
+    ListDirRunnable(DirectoryInfo& dirInfo, bool (DirectoryInfo::*listDir)(const Options&), const Options& options, bool& bSuccess, QSemaphore& finished)
+        : m_dirInfo(dirInfo), m_listDir(listDir), m_options(options), m_bSuccess(bSuccess), m_finished(finished)
     {
-        for(dirIterator = dirInfo->getDirListA().begin(); dirIterator != dirInfo->getDirListA().end(); ++dirIterator)
-        {
-            MergeFileInfos& mfi = m_fileMergeMap[FileKey(*dirIterator)];
-
-            mfi.setFileInfoA(&(*dirIterator));
-            mfi.setDirectoryInfo(dirInfo);
-        }
+        setAutoDelete(true);
     }
 
-    if(dirInfo->dirB().isValid())
+    void run() override
     {
-        for(dirIterator = dirInfo->getDirListB().begin(); dirIterator != dirInfo->getDirListB().end(); ++dirIterator)
-        {
-            MergeFileInfos& mfi = m_fileMergeMap[FileKey(*dirIterator)];
-
-            mfi.setFileInfoB(&(*dirIterator));
-            mfi.setDirectoryInfo(dirInfo);
-        }
+        m_bSuccess = (m_dirInfo.*m_listDir)(m_options);
+        m_finished.release();
     }
+};
 
-    if(dirInfo->dirC().isValid())
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::lessMergeKey(const t_fileMergeMap::iterator& i1, const t_fileMergeMap::iterator& i2)
+{
+    // Compares the names one folder level after the other, as if '/' came before every other character.
+    const QString& key1 = i1.key();
+    const QString& key2 = i2.key();
+    const int size = std::min(key1.size(), key2.size());
+    for(int i = 0; i < size; ++i)
     {
-        for(dirIterator = dirInfo->getDirListC().begin(); dirIterator != dirInfo->getDirListC().end(); ++dirIterator)
-        {
-            MergeFileInfos& mfi = m_fileMergeMap[FileKey(*dirIterator)];
-
-            mfi.setFileInfoC(&(*dirIterator));
-            mfi.setDirectoryInfo(dirInfo);
-        }
+        const QChar c1 = key1[i];
+        const QChar c2 = key2[i];
+        if(c1 != c2)
+            return c1 == '/' || (c2 != '/' && c1 < c2);
     }
+
+    return key1.size() < key2.size();
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::buildMergeMap(const QSharedPointer<DirectoryInfo>& dirInfo)
+{
+    MergeFileInfos::buildMergeMap(dirInfo, s_eCaseSensitivity, m_fileMergeMap);
 }
 
 bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     const QSharedPointer<DirectoryInfo>& dirInfo,
     bool bDirectoryMerge,
-    bool bReload)
+    bool bReload,
+    bool bShowStatus)
 {
     //set root data now that we have the directory info.
     rootMFI()->setDirectoryInfo(dirInfo);
@@ -777,22 +1269,49 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     mWindow->show();
     mWindow->setUpdatesEnabled(true);
 
+    // The items of the last scan go away, the workers must be done with them.
+    const QSet<const MergeFileInfos*> pendingItems = m_pendingItems;
+    const QHash<const MergeFileInfos*, t_ItemInfo> pendingItemStates = m_pendingItemStates;
+    stopComparisons();
+
     std::map<QString, t_ItemInfo> expandedDirsMap;
 
     if(bReload)
     {
-        // Remember expanded items TODO
-        //QTreeWidgetItemIterator it( this );
-        //while ( *it )
-        //{
-        //   DirMergeItem* pDMI = static_cast<DirMergeItem*>( *it );
-        //   t_ItemInfo& ii = expandedDirsMap[ pDMI->m_pMFI->subPath() ];
-        //   ii.bExpanded = pDMI->isExpanded();
-        //   ii.bOperationComplete = pDMI->m_pMFI->m_bOperationComplete;
-        //   ii.status = pDMI->text( s_OpStatusCol );
-        //   ii.eMergeOperation = pDMI->m_pMFI->getOperation();
-        //   ++it;
-        //}
+        // Remember expanded items
+        for(QModelIndex mi = childIndex(0, QModelIndex()); mi.isValid(); mi = treeIterator(mi, true, true))
+        {
+            MergeFileInfos* pMFI = getMFI(mi);
+            // An item that wasn't compared has no state but the one kept for it.
+            if(pendingItems.contains(pMFI))
+            {
+                const QHash<const MergeFileInfos*, t_ItemInfo>::const_iterator it = pendingItemStates.constFind(pMFI);
+                if(it != pendingItemStates.constEnd())
+                    expandedDirsMap[pMFI->subPath()] = *it;
+                continue;
+            }
+
+            t_ItemInfo& ii = expandedDirsMap[pMFI->subPath()];
+            ii.bExpanded = isFetched(mi.parent()) && mWindow->isExpanded(mi);
+            ii.bOperationComplete = !pMFI->isOperationRunning();
+            ii.eOpStatus = pMFI->getOpStatus();
+            ii.eMergeOperation = pMFI->getOperation();
+            ii.comparison = comparisonState(*pMFI);
+        }
+    }
+
+    if(!m_snapshot.isEmpty())
+    {
+        // A loaded snapshot only applies to the folders it was made of.
+        if(m_snapshotDirs == snapshotDirs(*dirInfo))
+        {
+            for(QHash<QString, SnapshotItem>::const_iterator it = m_snapshot.constBegin(); it != m_snapshot.constEnd(); ++it)
+                expandedDirsMap[it.key()] = it->state;
+        }
+        else
+        {
+            m_snapshot.clear();
+        }
     }
 
     ProgressProxy pp;
@@ -812,8 +1331,15 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     beginResetModel();
     m_pRoot->clear();
     m_mergeItemList.clear();
+    m_fileOperationResults.clear();
+    m_fetchedDirs.clear();
+    m_hiddenItems.clear();
+    m_dirStatus = DirStatus();
     endResetModel();
 
+    // Watching starts again when the scan is done.
+    unwatchFolders();
+
     m_currentIndexForOperation = m_mergeItemList.end();
 
     if(!bReload)
@@ -890,42 +1416,63 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     bool bListDirSuccessB = true;
     bool bListDirSuccessC = true;
 
-    if(dirA.isValid())
+    /*
+        Local folders are listed at the same time on worker threads, so the scan takes only as long
+        as the slowest folder. Remote ones need KIO and are listed here meanwhile.
+    */
+    const FileAccess* const dirs[3] = {&dirA, &dirB, &dirC};
+    bool (DirectoryInfo::*const listDirs[3])(const Options&) = {&DirectoryInfo::listDirA, &DirectoryInfo::listDirB, &DirectoryInfo::listDirC};
+    bool* const listDirSuccess[3] = {&bListDirSuccessA, &bListDirSuccessB, &bListDirSuccessC};
+    const QString dirNames[3] = {i18n("A"), i18n("B"), i18n("C")};
+
+    QSemaphore listingsFinished;
+    QStringList parallelDirNames;
+    for(int i = 0; i < 3; ++i)
     {
-        pp.setInformation(i18n("Reading Folder A"));
-        pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
-        ++currentScan;
-
-        bListDirSuccessA = dirInfo->listDirA(*m_pOptions);
+        if(dirs[i]->isValid() && dirs[i]->isLocal())
+        {
+            QThreadPool::globalInstance()->start(new ListDirRunnable(*dirInfo, listDirs[i], *m_pOptions, *listDirSuccess[i], listingsFinished));
+            parallelDirNames.append(dirNames[i]);
+        }
     }
 
-    if(dirB.isValid())
+    for(int i = 0; i < 3; ++i)
     {
-        pp.setInformation(i18n("Reading Folder B"));
-        pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
-        ++currentScan;
+        if(dirs[i]->isValid() && !dirs[i]->isLocal())
+        {
+            pp.setInformation(i18n("Reading Folder %1", dirNames[i]));
+            pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
+            ++currentScan;
 
-        bListDirSuccessB = dirInfo->listDirB(*m_pOptions);
+            *listDirSuccess[i] = ((*dirInfo).*listDirs[i])(*m_pOptions);
+        }
     }
 
-    e_MergeOperation eDefaultMergeOp;
-    if(dirC.isValid())
+    if(!parallelDirNames.isEmpty())
     {
-        pp.setInformation(i18n("Reading Folder C"));
-        pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
-        ++currentScan;
-
-        bListDirSuccessC = dirInfo->listDirC(*m_pOptions);
-
-        eDefaultMergeOp = eMergeABCToDest;
+        // The workers can't report progress, so each finished folder is one step.
+        pp.setInformation(i18n("Reading Folder %1", parallelDirNames.join(", ")));
+        pp.setSubRangeTransformation(currentScan / nofScans, 1);
+        pp.setMaxNofSteps(parallelDirNames.size());
+        for(int i = 0; i < parallelDirNames.size(); ++i)
+        {
+            // wasCancelled() keeps processing events while the folders are read.
+            while(!listingsFinished.tryAcquire(1, 100))
+                pp.wasCancelled();
+            pp.step();
+        }
     }
-    else
-        eDefaultMergeOp = m_bSyncMode ? eMergeToAB : eMergeABToDest;
+
+    const e_MergeOperation eDefaultMergeOp = defaultMergeOperation();
 
     buildMergeMap(dirInfo);
 
     bool bContinue = true;
-    if(!bListDirSuccessA || !bListDirSuccessB || !bListDirSuccessC)
+    if(!bShowStatus && (!bListDirSuccessA || !bListDirSuccessB || !bListDirSuccessC))
+    {
+        Q_EMIT mWindow->statusBarMessage(i18n("Some subfolders were not readable."));
+    }
+    else if(!bListDirSuccessA || !bListDirSuccessB || !bListDirSuccessC)
     {
         QString s = i18n("Some subfolders were not readable in");
         if(!bListDirSuccessA) s += "\nA: " + dirA.prettyAbsPath();
@@ -938,7 +1485,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
 
     if(bContinue)
     {
-        prepareListView(pp);
+        prepareListView(pp, expandedDirsMap);
 
         mWindow->updateFileVisibilities();
 
@@ -951,8 +1498,12 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
 
     mWindow->sortByColumn(0, Qt::AscendingOrder);
 
+    // Only the rows the view has fetched and laid out are measured.
     for(int column = 0; column < columnCount(QModelIndex()); ++column)
-        mWindow->resizeColumnToContents(column);
+    {
+        if(!mWindow->isColumnHidden(column))
+            mWindow->resizeColumnToContents(column);
+    }
 
     // Try to improve the view a little bit.
     QWidget* pParent = mWindow->parentWidget();
@@ -971,61 +1522,61 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     m_bScanning = false;
     Q_EMIT mWindow->statusBarMessage(i18n("Ready."));
 
-    if(bContinue && !m_bSkipDirStatus)
+    if(bContinue && !m_bSkipDirStatus && bShowStatus)
     {
-        // Generate a status report
-        int nofFiles = 0;
-        int nofDirs = 0;
-        int nofEqualFiles = 0;
-        int nofManualMerges = 0;
-        //TODO
-        for(int childIdx = 0; childIdx < rowCount(); ++childIdx)
-            calcDirStatus(dirC.isValid(), index(childIdx, 0, QModelIndex()),
-                          nofFiles, nofDirs, nofEqualFiles, nofManualMerges);
-
-        QString s;
-        s = i18n("Folder Comparison Status\n\n"
-                 "Number of subfolders: %1\n"
-                 "Number of equal files: %2\n"
-                 "Number of different files: %3",
-                 nofDirs, nofEqualFiles, nofFiles - nofEqualFiles);
-
-        if(dirC.isValid())
-            s += '\n' + i18n("Number of manual merges: %1", nofManualMerges);
-        KMessageBox::information(mWindow, s);
-        //
-        //TODO
-        //if ( topLevelItemCount()>0 )
-        //{
-        //   topLevelItem(0)->setSelected(true);
-        //   setCurrentItem( topLevelItem(0) );
-        //}
+        // The counts of the pending items come with their comparisons.
+        if(m_pendingItems.isEmpty())
+            showDirStatus();
+        else
+            m_bDirStatusPending = true;
     }
 
-    if(bReload)
+    if(!expandedDirsMap.empty())
     {
-        // Remember expanded items
-        //TODO
-        //QTreeWidgetItemIterator it( this );
-        //while ( *it )
-        //{
-        //   DirMergeItem* pDMI = static_cast<DirMergeItem*>( *it );
-        //   std::map<QString,t_ItemInfo>::iterator i = expandedDirsMap.find( pDMI->m_pMFI->subPath() );
-        //   if ( i!=expandedDirsMap.end() )
-        //   {
-        //      t_ItemInfo& ii = i->second;
-        //      pDMI->setExpanded( ii.bExpanded );
-        //      //pDMI->m_pMFI->setMergeOperation( ii.eMergeOperation, false ); unsafe, might have changed
-        //      pDMI->m_pMFI->m_bOperationComplete = ii.bOperationComplete;
-        //      pDMI->setText( s_OpStatusCol, ii.status );
-        //   }
-        //   ++it;
-        //}
-    }
-    else if(m_bUnfoldSubdirs)
+        // Restore expanded items, the operations only where the comparison gave the same result.
+        for(QModelIndex mi = childIndex(0, QModelIndex()); mi.isValid(); mi = treeIterator(mi, true, true))
+        {
+            MergeFileInfos* pMFI = getMFI(mi);
+            std::map<QString, t_ItemInfo>::const_iterator i = expandedDirsMap.find(pMFI->subPath());
+            if(i == expandedDirsMap.end())
+                continue;
+
+            const t_ItemInfo& ii = i->second;
+            if(isComparisonPending(pMFI))
+            {
+                m_pendingItemStates.insert(pMFI, ii);
+                continue;
+            }
+            if(ii.comparison == comparisonState(*pMFI))
+            {
+                setMergeOperation(mi, ii.eMergeOperation, false);
+                if(ii.bOperationComplete)
+                    pMFI->endOperation();
+                setOpStatus(mi, ii.eOpStatus);
+            }
+            if(ii.bExpanded)
+            {
+                ensureFetched(mi);
+                mWindow->setExpanded(mi, true);
+            }
+        }
+    }
+    else if(!bReload && m_bUnfoldSubdirs)
     {
         m_pDirUnfoldAll->trigger();
     }
+    m_snapshot.clear();
+
+    if(bContinue)
+        watchFolders();
+
+    if(!m_pendingItems.isEmpty())
+    {
+        // The view has its rows now.
+        prioritizeComparisons();
+        m_comparedItemsTimer.start();
+        Q_EMIT mWindow->statusBarMessage(i18np("Comparing 1 file...", "Comparing %1 files...", m_pendingItems.size()));
+    }
 
     return true;
 }
@@ -1050,6 +1601,23 @@ inline QString DirectoryMergeWindow::getDirNameDest() const
 void DirectoryMergeWindow::onExpanded()
 {
     resizeColumnToContents(s_NameCol);
+    slotViewMoved();
+}
+
+void DirectoryMergeWindow::slotViewMoved()
+{
+    if(!d->m_pendingItems.isEmpty())
+        d->m_prioritizeTimer.start();
+}
+
+void DirectoryMergeWindow::slotPrioritizeComparisons()
+{
+    d->prioritizeComparisons();
+}
+
+void DirectoryMergeWindow::slotTakeComparedItems()
+{
+    d->takeComparedItems();
 }
 
 void DirectoryMergeWindow::slotChooseAEverywhere()
@@ -1260,7 +1828,8 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::setAllMergeOperations(e_
                                                      i18n("This affects all merge operations."),
                                                      i18n("Changing All Merge Operations"),
                                                      KStandardGuiItem::cont(),
-                                                     KStandardGuiItem::cancel()))
+                                                     KStandardGuiItem::cancel()) &&
+       finishComparisons())
     {
         for(int i = 0; i < rowCount(); ++i)
         {
@@ -1273,8 +1842,8 @@ QModelIndex DirectoryMergeWindow::DirectoryMergeWindowPrivate::nextSibling(const
 {
     QModelIndex miParent = mi.parent();
     int currentIdx = mi.row();
-    if(currentIdx + 1 < mi.model()->rowCount(miParent))
-        return mi.model()->index(mi.row() + 1, 0, miParent); // next child of parent
+    if(currentIdx + 1 < nofChildren(miParent))
+        return childIndex(mi.row() + 1, miParent); // next child of parent
     return QModelIndex();
 }
 
@@ -1285,8 +1854,8 @@ QModelIndex DirectoryMergeWindow::DirectoryMergeWindowPrivate::treeIterator(QMod
     {
         do
         {
-            if(bVisitChildren && mi.model()->rowCount(mi) != 0)
-                mi = mi.model()->index(0, 0, mi);
+            if(bVisitChildren && nofChildren(mi) != 0)
+                mi = childIndex(0, mi);
             else
             {
                 QModelIndex miNextSibling = nextSibling(mi);
@@ -1310,75 +1879,473 @@ QModelIndex DirectoryMergeWindow::DirectoryMergeWindowPrivate::treeIterator(QMod
                     }
                 }
             }
-        } while(mi.isValid() && mWindow->isRowHidden(mi.row(), mi.parent()) && !bFindInvisible);
+        } while(mi.isValid() && isItemHidden(mi) && !bFindInvisible);
+    }
+    return mi;
+}
+
+// Upper limit for the comparisons running at once, each one reads two files.
+static const int maxParallelComparisons = 16;
+// Items taken into one batch of file operations, so a long merge still moves the progress bar.
+static const int maxNofBatchOperations = 1000;
+
+// Compares the files of local items on a worker thread, each worker takes the next item nobody has taken yet.
+class CompareFilesRunnable : public QRunnable
+{
+  private:
+    ComparisonQueue& m_queue;
+    QSharedPointer<Options> m_pOptions;
+    QSemaphore& m_finished;
+
+  public:
+    CompareFilesRunnable(ComparisonQueue& queue, const QSharedPointer<Options>& pOptions, QSemaphore& finished)
+        : m_queue(queue), m_pOptions(pOptions), m_finished(finished)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        for(MergeFileInfos* pMFI = m_queue.takeNext(); pMFI != nullptr; pMFI = m_queue.takeNext())
+        {
+            // Only a full analysis that can't run on any thread needs the window, it never runs here.
+            QStringList errors;
+            pMFI->compareFilesAndCalcAges(errors, m_pOptions, nullptr);
+            m_queue.compared(pMFI, errors);
+        }
+        m_finished.release();
+    }
+};
+
+ComparisonQueue::ComparisonQueue()
+{
+    m_pool.setMaxThreadCount(std::min(QThread::idealThreadCount(), maxParallelComparisons));
+}
+
+void ComparisonQueue::start(const QVector<MergeFileInfos*>& items, const QVector<MergeFileInfos*>& priorityItems, const QSharedPointer<Options>& pOptions)
+{
+    stop();
+    if(items.isEmpty())
+        return;
+
+    m_items = items;
+    m_priorityItems = priorityItems;
+    m_queuedItems.reserve(items.size());
+    for(MergeFileInfos* pMFI: items)
+        m_queuedItems.insert(pMFI);
+    m_bStop.storeRelease(0);
+
+    m_nofWorkers = std::min(m_pool.maxThreadCount(), items.size());
+    for(int i = 0; i < m_nofWorkers; ++i)
+        m_pool.start(new CompareFilesRunnable(*this, pOptions, m_workersFinished));
+}
+
+void ComparisonQueue::prioritize(const QVector<MergeFileInfos*>& items)
+{
+    QMutexLocker locker(&m_mutex);
+    m_priorityItems.clear();
+    m_nextPriorityItem = 0;
+    for(MergeFileInfos* pMFI: items)
+    {
+        if(m_queuedItems.contains(pMFI))
+            m_priorityItems.push_back(pMFI);
+    }
+}
+
+QVector<MergeFileInfos*> ComparisonQueue::unqueue(const QVector<MergeFileInfos*>& items)
+{
+    QMutexLocker locker(&m_mutex);
+    QVector<MergeFileInfos*> unqueuedItems;
+    for(MergeFileInfos* pMFI: items)
+    {
+        if(m_queuedItems.remove(pMFI))
+            unqueuedItems.push_back(pMFI);
+    }
+    return unqueuedItems;
+}
+
+QVector<MergeFileInfos*> ComparisonQueue::takeCompared(QStringList& errors)
+{
+    QMutexLocker locker(&m_mutex);
+    QVector<MergeFileInfos*> comparedItems;
+    comparedItems.swap(m_comparedItems);
+    errors.append(m_errors);
+    m_errors.clear();
+    return comparedItems;
+}
+
+void ComparisonQueue::stop()
+{
+    m_bStop.storeRelease(1);
+    m_workersFinished.acquire(m_nofWorkers);
+    m_nofWorkers = 0;
+
+    // No worker runs anymore.
+    m_items.clear();
+    m_nextItem = 0;
+    m_priorityItems.clear();
+    m_nextPriorityItem = 0;
+    m_queuedItems.clear();
+    m_comparedItems.clear();
+    m_errors.clear();
+    m_itemCompared.tryAcquire(m_itemCompared.available());
+}
+
+MergeFileInfos* ComparisonQueue::takeNext()
+{
+    QMutexLocker locker(&m_mutex);
+    if(m_bStop.loadAcquire() != 0)
+        return nullptr;
+
+    // Items are left in both lists, the first of them to take one compares it.
+    while(m_nextPriorityItem < m_priorityItems.size())
+    {
+        MergeFileInfos* pMFI = m_priorityItems[m_nextPriorityItem++];
+        if(m_queuedItems.remove(pMFI))
+            return pMFI;
+    }
+    while(m_nextItem < m_items.size())
+    {
+        MergeFileInfos* pMFI = m_items[m_nextItem++];
+        if(m_queuedItems.remove(pMFI))
+            return pMFI;
+    }
+    return nullptr;
+}
+
+void ComparisonQueue::compared(MergeFileInfos* pMFI, const QStringList& errors)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_comparedItems.push_back(pMFI);
+        //Limit size of error list in memmory.
+        for(const QString& error: errors)
+        {
+            if(m_errors.size() < 30)
+                m_errors.append(error);
+        }
+    }
+    m_itemCompared.release();
+}
+
+// Remote files are copied with KIO first, which has to happen on the GUI thread.
+static bool canCompareOnWorkerThread(MergeFileInfos& mfi, const QSharedPointer<Options>& pOptions)
+{
+    if(pOptions->m_bDmFullAnalysis && !mfi.hasDir())
+        return mfi.canRunFullAnalysis(pOptions);
+
+    return (!mfi.existsInA() || mfi.getFileInfoA()->isLocal()) && (!mfi.existsInB() || mfi.getFileInfoB()->isLocal()) &&
+           (!mfi.existsInC() || mfi.getFileInfoC()->isLocal());
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareListView(ProgressProxy& pp, const std::map<QString, t_ItemInfo>& expandedDirsMap)
+{
+    QStringList errors;
+    //TODO   clear();
+    PixMapUtils::initPixmaps(m_pOptions->m_newestFileColor, m_pOptions->m_oldestFileColor,
+                             m_pOptions->m_midAgeFileColor, m_pOptions->m_missingFileColor);
+
+    mWindow->setRootIsDecorated(true);
+
+    // The map itself is unordered, the items are sorted once here.
+    QVector<t_fileMergeMap::iterator> sortedItems;
+    sortedItems.reserve(m_fileMergeMap.size());
+    for(t_fileMergeMap::iterator j = m_fileMergeMap.begin(); j != m_fileMergeMap.end(); ++j)
+        sortedItems.push_back(j);
+    std::sort(sortedItems.begin(), sortedItems.end(), lessMergeKey);
+
+    int nrOfFiles = m_fileMergeMap.size();
+    int currentIdx = 1;
+    QElapsedTimer t;
+    t.start();
+    pp.setMaxNofSteps(nrOfFiles);
+
+    /*
+        The files of local items are compared on worker threads, with a full analysis too unless the
+        options need the merge result window. The rows shown first are compared first: those of the
+        top level and of the folders that are expanded again. The tree is built meanwhile.
+    */
+    QVector<MergeFileInfos*> parallelItems;
+    QVector<MergeFileInfos*> firstItems;
+    QSet<const MergeFileInfos*> snapshotItems;
+    for(const t_fileMergeMap::iterator& j: sortedItems)
+    {
+        MergeFileInfos& mfi = j.value();
+        if(takeSnapshotComparison(mfi))
+        {
+            snapshotItems.insert(&mfi);
+        }
+        else if(!mfi.hasDir() && canCompareOnWorkerThread(mfi, m_pOptions))
+        {
+            parallelItems.push_back(&mfi);
+            m_pendingItems.insert(&mfi);
+
+            mfi.prepareForWorkerThread();
+            const QString subPath = mfi.subPath();
+
+            const int pos = subPath.lastIndexOf('/');
+            if(firstItems.size() < maxNofFirstItems)
+            {
+                std::map<QString, t_ItemInfo>::const_iterator dir = pos == -1 ? expandedDirsMap.end() : expandedDirsMap.find(subPath.left(pos));
+                if(pos == -1 || (dir != expandedDirsMap.end() && dir->second.bExpanded))
+                    firstItems.push_back(&mfi);
+            }
+        }
+    }
+    m_comparisons.start(parallelItems, firstItems, m_pOptions);
+
+    int itemIdx = 0;
+    for(; itemIdx < sortedItems.size(); ++itemIdx)
+    {
+        MergeFileInfos& mfi = sortedItems[itemIdx].value();
+
+        // const QString& fileName = j->first;
+        const QString& fileName = mfi.subPath();
+
+        pp.setInformation(
+            i18n("Processing %1 / %2\n%3", currentIdx, nrOfFiles, fileName), currentIdx, false);
+        if(pp.wasCancelled()) break;
+        ++currentIdx;
+
+        // The comparisons and calculations for each file take place here.
+        if(!isComparisonPending(&mfi) && !snapshotItems.contains(&mfi))
+        {
+            mfi.compareFilesAndCalcAges(errors, m_pOptions, mWindow);
+        }
+        // Get dirname from fileName: Search for "/" from end:
+        int pos = fileName.lastIndexOf('/');
+        QString dirPart;
+        QString filePart;
+        if(pos == -1)
+        {
+            // Top dir
+            filePart = fileName;
+        }
+        else
+        {
+            dirPart = fileName.left(pos);
+            filePart = fileName.mid(pos + 1);
+        }
+
+        if(dirPart.isEmpty()) // Top level
+        {
+            m_pRoot->addChild(&mfi); //new DirMergeItem( this, filePart, &mfi );
+            mfi.setParent(m_pRoot);
+        }
+        else
+        {
+            // The key of the parent folder is the same path without the last name.
+            const QString& key = sortedItems[itemIdx].key();
+            const t_fileMergeMap::iterator parentIt = m_fileMergeMap.find(key.left(key.lastIndexOf('/')));
+            MergeFileInfos& dirMfi = parentIt != m_fileMergeMap.end() ? parentIt.value() : *m_pRoot; // parent
+
+            dirMfi.addChild(&mfi); //new DirMergeItem( dirMfi.m_pDMI, filePart, &mfi );
+            mfi.setParent(&dirMfi);
+
+            //   // Equality for parent dirs is set in updateFileVisibilities()
+        }
+
+        // Pending items are counted once they are compared, see takeComparedItems().
+        if(!isComparisonPending(&mfi))
+        {
+            mfi.updateAge();
+            addToDirStatus(mfi);
+        }
+    }
+
+    // A cancelled scan leaves out the items not added so far, as far as no worker has them.
+    if(itemIdx < sortedItems.size())
+    {
+        QVector<MergeFileInfos*> leftOutItems;
+        for(; itemIdx < sortedItems.size(); ++itemIdx)
+        {
+            if(isComparisonPending(&sortedItems[itemIdx].value()))
+                leftOutItems.push_back(&sortedItems[itemIdx].value());
+        }
+        for(const MergeFileInfos* pMFI: m_comparisons.unqueue(leftOutItems))
+            m_pendingItems.remove(pMFI);
+    }
+
+    // Waits for the rows shown first, and for all unless that takes long. Cancelling only stops waiting.
+    while(!m_pendingItems.isEmpty() && !pp.wasCancelled())
+    {
+        if(t.elapsed() >= backgroundComparisonDelay)
+        {
+            bool bFirstItemPending = false;
+            for(const MergeFileInfos* pMFI: firstItems)
+                bFirstItemPending = bFirstItemPending || isComparisonPending(pMFI);
+            if(!bFirstItemPending)
+                break;
+        }
+
+        pp.setInformation(i18np("Comparing 1 file...", "Comparing %1 files...", m_pendingItems.size()), false);
+        m_comparisons.waitForCompared(100);
+        for(MergeFileInfos* pMFI: m_comparisons.takeCompared(m_comparisonErrors))
+        {
+            m_pendingItems.remove(pMFI);
+            if(pMFI->parent() != nullptr)
+            {
+                pMFI->updateAge();
+                addToDirStatus(*pMFI);
+            }
+        }
+    }
+    m_comparisonErrors.append(errors);
+
+    if(m_pOptions->m_bDmUseHashCache)
+        ContentHashCache::instance().save();
+
+    showComparisonErrors();
+
+    beginResetModel();
+    m_fetchedDirs.clear();
+    endResetModel();
+}
+
+// The pending rows on screen first, then those of the other expanded folders.
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prioritizeComparisons()
+{
+    if(m_pendingItems.isEmpty())
+        return;
+
+    QVector<MergeFileInfos*> items;
+    QSet<const MergeFileInfos*> visibleItems;
+    const int viewHeight = mWindow->viewport()->height();
+    for(QModelIndex mi = mWindow->indexAt(QPoint(0, 0)); mi.isValid() && mWindow->visualRect(mi).top() < viewHeight; mi = mWindow->indexBelow(mi))
+    {
+        MergeFileInfos* pMFI = getMFI(mi);
+        if(isComparisonPending(pMFI))
+        {
+            items.push_back(pMFI);
+            visibleItems.insert(pMFI);
+        }
+    }
+
+    // Only fetched folders can be expanded, the others aren't walked.
+    QVector<QModelIndex> folders(1, QModelIndex());
+    while(!folders.isEmpty())
+    {
+        const QModelIndex folder = folders.takeLast();
+        for(int row = 0; row < nofChildren(folder); ++row)
+        {
+            const QModelIndex mi = childIndex(row, folder);
+            MergeFileInfos* pMFI = getMFI(mi);
+            if(isComparisonPending(pMFI))
+            {
+                if(!visibleItems.contains(pMFI))
+                    items.push_back(pMFI);
+            }
+            else if(pMFI->hasDir() && isFetched(pMFI) && mWindow->isExpanded(mi))
+            {
+                folders.push_back(mi);
+            }
+        }
     }
-    return mi;
+
+    m_comparisons.prioritize(items);
 }
 
-void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareListView(ProgressProxy& pp)
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::takeComparedItems()
 {
-    QStringList errors;
-    //TODO   clear();
-    PixMapUtils::initPixmaps(m_pOptions->m_newestFileColor, m_pOptions->m_oldestFileColor,
-                             m_pOptions->m_midAgeFileColor, m_pOptions->m_missingFileColor);
+    const QVector<MergeFileInfos*> comparedItems = m_comparisons.takeCompared(m_comparisonErrors);
+    for(MergeFileInfos* pMFI: comparedItems)
+        finishComparison(pMFI);
 
-    mWindow->setRootIsDecorated(true);
+    if(!comparedItems.isEmpty())
+    {
+        // Sets the equality of the folders above the compared files.
+        mWindow->updateFileVisibilities();
+        if(!m_pendingItems.isEmpty())
+            Q_EMIT mWindow->statusBarMessage(i18np("Comparing 1 file...", "Comparing %1 files...", m_pendingItems.size()));
+    }
+    if(!m_pendingItems.isEmpty())
+        return;
 
-    t_fileMergeMap::iterator j;
-    int nrOfFiles = m_fileMergeMap.size();
-    int currentIdx = 1;
-    QElapsedTimer t;
-    t.start();
-    pp.setMaxNofSteps(nrOfFiles);
+    m_comparedItemsTimer.stop();
+    m_pendingItemStates.clear();
+    if(m_pOptions->m_bDmUseHashCache)
+        ContentHashCache::instance().save();
+    Q_EMIT mWindow->statusBarMessage(i18n("Ready."));
 
-    for(j = m_fileMergeMap.begin(); j != m_fileMergeMap.end(); ++j)
+    showComparisonErrors();
+    if(m_bDirStatusPending)
     {
-        MergeFileInfos& mfi = j.value();
+        m_bDirStatusPending = false;
+        showDirStatus();
+    }
+}
 
-        // const QString& fileName = j->first;
-        const QString& fileName = mfi.subPath();
+// What prepareListView() and init() do for an item that is compared in time, like updateChangedFolders().
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::finishComparison(MergeFileInfos* pMFI)
+{
+    m_pendingItems.remove(pMFI);
+    // Left out of the tree by a cancelled scan.
+    if(pMFI->parent() == nullptr)
+        return;
 
-        pp.setInformation(
-            i18n("Processing %1 / %2\n%3", currentIdx, nrOfFiles, fileName), currentIdx, false);
-        if(pp.wasCancelled()) break;
-        ++currentIdx;
+    pMFI->updateAge();
+    addToDirStatus(*pMFI);
 
-        // The comparisons and calculations for each file take place here.
-        mfi.compareFilesAndCalcAges(errors, m_pOptions, mWindow);
-        // Get dirname from fileName: Search for "/" from end:
-        int pos = fileName.lastIndexOf('/');
-        QString dirPart;
-        QString filePart;
-        if(pos == -1)
-        {
-            // Top dir
-            filePart = fileName;
-        }
-        else
-        {
-            dirPart = fileName.left(pos);
-            filePart = fileName.mid(pos + 1);
-        }
+    const QModelIndex mi = indexOf(pMFI);
+    const QHash<const MergeFileInfos*, t_ItemInfo>::const_iterator state = m_pendingItemStates.constFind(pMFI);
+    if(state != m_pendingItemStates.constEnd() && state->comparison == comparisonState(*pMFI))
+    {
+        setMergeOperation(mi, state->eMergeOperation, false);
+        if(state->bOperationComplete)
+            pMFI->endOperation();
+        setOpStatus(mi, state->eOpStatus);
+    }
+    // An operation the user chose meanwhile stays.
+    else if(pMFI->getOperation() == eNoOperation)
+    {
+        e_MergeOperation eParentMergeOp = pMFI->parent() == m_pRoot ? defaultMergeOperation() : pMFI->parent()->getOperation();
+        if(eParentMergeOp == eConflictingFileTypes)
+            eParentMergeOp = eMergeABCToDest;
+        calcSuggestedOperation(mi, eParentMergeOp);
+    }
+    m_pendingItemStates.remove(pMFI);
 
-        if(dirPart.isEmpty()) // Top level
-        {
-            m_pRoot->addChild(&mfi); //new DirMergeItem( this, filePart, &mfi );
-            mfi.setParent(m_pRoot);
-        }
-        else
-        {
-            FileAccess* pFA = mfi.getFileInfoA() ? mfi.getFileInfoA() : mfi.getFileInfoB() ? mfi.getFileInfoB() : mfi.getFileInfoC();
-            MergeFileInfos& dirMfi = pFA->parent() ? m_fileMergeMap[FileKey(*pFA->parent())] : *m_pRoot; // parent
+    for(QModelIndex miChanged = mi; miChanged.isValid(); miChanged = miChanged.parent())
+        itemChanged(miChanged);
+}
 
-            dirMfi.addChild(&mfi); //new DirMergeItem( dirMfi.m_pDMI, filePart, &mfi );
-            mfi.setParent(&dirMfi);
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::finishComparisons()
+{
+    if(m_pendingItems.isEmpty())
+        return true;
 
-            //   // Equality for parent dirs is set in updateFileVisibilities()
-        }
+    ProgressProxy pp;
+    const int nofPendingItems = m_pendingItems.size();
+    pp.setMaxNofSteps(nofPendingItems);
+    while(!m_pendingItems.isEmpty())
+    {
+        pp.setInformation(i18np("Comparing 1 file...", "Comparing %1 files...", m_pendingItems.size()), nofPendingItems - m_pendingItems.size(), false);
+        if(pp.wasCancelled())
+            return false;
 
-        mfi.updateAge();
+        if(m_comparisons.waitForCompared(100))
+            takeComparedItems();
     }
+    return true;
+}
+
+// The pending items stay as they are, they go away with the next scan.
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::stopComparisons()
+{
+    m_comparisons.stop();
+    m_comparedItemsTimer.stop();
+    m_prioritizeTimer.stop();
+    m_pendingItems.clear();
+    m_pendingItemStates.clear();
+    m_comparisonErrors.clear();
+    m_bDirStatusPending = false;
+}
 
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::showComparisonErrors()
+{
+    // The message box processes events, which may bring more errors.
+    const QStringList errors = m_comparisonErrors;
+    m_comparisonErrors.clear();
     if(errors.size() > 0)
     {
         if(errors.size() < 15)
@@ -1390,9 +2357,28 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareListView(Progress
             KMessageBox::error(mWindow, i18n("Some files could not be processed."));
         }
     }
+}
 
-    beginResetModel();
-    endResetModel();
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::showDirStatus()
+{
+    // Generate a status report
+    QString s;
+    s = i18n("Folder Comparison Status\n\n"
+             "Number of subfolders: %1\n"
+             "Number of equal files: %2\n"
+             "Number of different files: %3",
+             m_dirStatus.nofDirs, m_dirStatus.nofEqualFiles, m_dirStatus.nofFiles - m_dirStatus.nofEqualFiles);
+
+    if(isThreeWay())
+        s += '\n' + i18n("Number of manual merges: %1", m_dirStatus.nofManualMerges);
+    KMessageBox::information(mWindow, s);
+    //
+    //TODO
+    //if ( topLevelItemCount()>0 )
+    //{
+    //   topLevelItem(0)->setSelected(true);
+    //   setCurrentItem( topLevelItem(0) );
+    //}
 }
 
 void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperation(const QModelIndex& mi, e_MergeOperation eDefaultMergeOp)
@@ -1400,6 +2386,9 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperation(c
     MergeFileInfos* pMFI = getMFI(mi);
     if(pMFI == nullptr)
         return;
+    // Gets its operation once compared, see finishComparison().
+    if(isComparisonPending(pMFI))
+        return;
 
     bool bCheckC = pMFI->isThreeWay();
     bool bCopyNewer = m_pOptions->m_bDmCopyNewer;
@@ -1832,7 +2821,10 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::sort(int column, Qt::Sor
     Q_UNUSED(column);
     beginResetModel();
     m_pRoot->sort(order);
+    m_fetchedDirs.clear();
     endResetModel();
+    // The view forgets the hidden rows on a reset.
+    showFetchedRows(QModelIndex());
 }
 
 void DirectoryMergeWindow::DirectoryMergeWindowPrivate::setMergeOperation(const QModelIndex& mi, e_MergeOperation eMergeOp, bool bRecursive)
@@ -1847,7 +2839,12 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::setMergeOperation(const
         setOpStatus(mi, eOpStatusNone);
     }
 
+    if(isManualMerge(*pMFI))
+        --m_dirStatus.nofManualMerges;
     pMFI->setOperation(eMergeOp);
+    if(isManualMerge(*pMFI))
+        ++m_dirStatus.nofManualMerges;
+
     if(bRecursive)
     {
         e_MergeOperation eChildrenMergeOp = pMFI->getOperation();
@@ -1855,7 +2852,7 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::setMergeOperation(const
 
         for(int childIdx = 0; childIdx < pMFI->children().count(); ++childIdx)
         {
-            calcSuggestedOperation(index(childIdx, 0, mi), eChildrenMergeOp);
+            calcSuggestedOperation(childIndex(childIdx, mi), eChildrenMergeOp);
         }
     }
 }
@@ -1959,7 +2956,9 @@ void DirectoryMergeWindow::mergeResultSaved(const QString& fileName)
     {
         if(pMFI->getOperation() == eMergeToAB)
         {
-            bool bSuccess = d->copyFLD(pMFI->fullNameB(), pMFI->fullNameA());
+            QStringList statusText;
+            bool bSuccess = d->copyFLD(pMFI->fullNameB(), pMFI->fullNameA(), statusText);
+            d->addStatusText(statusText);
             if(!bSuccess)
             {
                 KMessageBox::error(this, i18n("An error occurred while copying."));
@@ -2007,41 +3006,68 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::canContinue()
     return false;
 }
 
-bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::executeMergeOperation(MergeFileInfos& mfi, bool& bSingleFileMerge)
+// The file or folder written by an operation, empty for those that only delete in A and B.
+static QString destinationName(const MergeFileInfos& mfi)
 {
-    bool bCreateBackups = m_pOptions->m_bDmCreateBakFiles;
-    // First decide destname
-    QString destName;
     switch(mfi.getOperation())
     {
-        case eNoOperation:
-        case eDeleteAB:
-            break;
         case eMergeToAB: // let the user save in B. In mergeResultSaved() the file will be copied to A.
         case eMergeToB:
         case eDeleteB:
         case eCopyAToB:
-            destName = mfi.fullNameB();
-            break;
+            return mfi.fullNameB();
         case eMergeToA:
         case eDeleteA:
         case eCopyBToA:
-            destName = mfi.fullNameA();
-            break;
+            return mfi.fullNameA();
         case eMergeABToDest:
         case eMergeABCToDest:
         case eCopyAToDest:
         case eCopyBToDest:
         case eCopyCToDest:
         case eDeleteFromDest:
-            destName = mfi.fullNameDest();
-            break;
+            return mfi.fullNameDest();
         default:
-            KMessageBox::error(mWindow, i18n("Unknown merge operation. (This must never happen!)"));
+            return QString();
     }
+}
 
-    bool bSuccess = false;
+static bool isMergeOperation(e_MergeOperation eMergeOp)
+{
+    return eMergeOp == eMergeABToDest || eMergeOp == eMergeToA || eMergeOp == eMergeToAB ||
+           eMergeOp == eMergeToB || eMergeOp == eMergeABCToDest;
+}
+
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::executeMergeOperation(MergeFileInfos& mfi, bool& bSingleFileMerge)
+{
     bSingleFileMerge = false;
+    if(!isMergeOperation(mfi.getOperation()))
+    {
+        QStringList statusText;
+        bool bSuccess = executeFileOperation(mfi, statusText);
+        addStatusText(statusText);
+        return bSuccess;
+    }
+
+    const QString destName = destinationName(mfi);
+    if(mfi.getOperation() == eMergeABCToDest)
+    {
+        return mergeFLD(
+            mfi.existsInA() ? mfi.fullNameA() : QString(""),
+            mfi.existsInB() ? mfi.fullNameB() : QString(""),
+            mfi.existsInC() ? mfi.fullNameC() : QString(""),
+            destName, bSingleFileMerge);
+    }
+
+    return mergeFLD(mfi.fullNameA(), mfi.fullNameB(), "", destName, bSingleFileMerge);
+}
+
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::executeFileOperation(const MergeFileInfos& mfi, QStringList& statusText)
+{
+    bool bCreateBackups = m_pOptions->m_bDmCreateBakFiles;
+    const QString destName = destinationName(mfi);
+
+    bool bSuccess = false;
     switch(mfi.getOperation())
     {
         case eNoOperation:
@@ -2049,45 +3075,175 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::executeMergeOperation(Me
             break;
         case eCopyAToDest:
         case eCopyAToB:
-            bSuccess = copyFLD(mfi.fullNameA(), destName);
+            bSuccess = copyFLD(mfi.fullNameA(), destName, statusText);
             break;
         case eCopyBToDest:
         case eCopyBToA:
-            bSuccess = copyFLD(mfi.fullNameB(), destName);
+            bSuccess = copyFLD(mfi.fullNameB(), destName, statusText);
             break;
         case eCopyCToDest:
-            bSuccess = copyFLD(mfi.fullNameC(), destName);
+            bSuccess = copyFLD(mfi.fullNameC(), destName, statusText);
             break;
         case eDeleteFromDest:
         case eDeleteA:
         case eDeleteB:
-            bSuccess = deleteFLD(destName, bCreateBackups);
+            bSuccess = deleteFLD(destName, bCreateBackups, statusText);
             break;
         case eDeleteAB:
-            bSuccess = deleteFLD(mfi.fullNameA(), bCreateBackups) &&
-                       deleteFLD(mfi.fullNameB(), bCreateBackups);
+            bSuccess = deleteFLD(mfi.fullNameA(), bCreateBackups, statusText) &&
+                       deleteFLD(mfi.fullNameB(), bCreateBackups, statusText);
             break;
         case eMergeABToDest:
         case eMergeToA:
         case eMergeToAB:
         case eMergeToB:
-            bSuccess = mergeFLD(mfi.fullNameA(), mfi.fullNameB(), "",
-                                destName, bSingleFileMerge);
-            break;
         case eMergeABCToDest:
-            bSuccess = mergeFLD(
-                mfi.existsInA() ? mfi.fullNameA() : QString(""),
-                mfi.existsInB() ? mfi.fullNameB() : QString(""),
-                mfi.existsInC() ? mfi.fullNameC() : QString(""),
-                destName, bSingleFileMerge);
+            // Only reached for folders, see canRunOnWorkerThread(). A merge of folders just makes the destination.
+            bSuccess = makeDir(destName, statusText);
             break;
         default:
-            KMessageBox::error(mWindow, i18n("Unknown merge operation."));
+            statusText.append(i18n("Unknown merge operation."));
     }
 
     return bSuccess;
 }
 
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::addStatusText(const QStringList& statusText)
+{
+    for(const QString& s: statusText)
+        m_pStatusInfo->addText(s);
+}
+
+class DirectoryMergeWindow::DirectoryMergeWindowPrivate::FileOperationsRunnable : public QRunnable
+{
+  private:
+    DirectoryMergeWindowPrivate& m_d;
+    std::vector<std::vector<FileOperation>>& m_folders;
+    QAtomicInt& m_nextFolder;
+    QAtomicInt& m_bStop;
+    QSemaphore& m_finished;
+
+  public:
+    FileOperationsRunnable(DirectoryMergeWindowPrivate& d, std::vector<std::vector<FileOperation>>& folders, QAtomicInt& nextFolder, QAtomicInt& bStop, QSemaphore& finished)
+        : m_d(d), m_folders(folders), m_nextFolder(nextFolder), m_bStop(bStop), m_finished(finished)
+    {
+        setAutoDelete(true);
+    }
+
+    // The first failure stops all workers, the items after it are left to mergeContinue().
+    void run() override
+    {
+        while(m_bStop.loadAcquire() == 0)
+        {
+            const int i = m_nextFolder.fetchAndAddOrdered(1);
+            if(i >= (int)m_folders.size())
+                break;
+
+            for(FileOperation& operation: m_folders[i])
+            {
+                if(m_bStop.loadAcquire() != 0)
+                    break;
+
+                operation.bSuccess = m_d.executeFileOperation(*operation.pMFI, operation.statusText);
+                operation.bDone = true;
+                if(!operation.bSuccess)
+                {
+                    m_bStop.storeRelease(1);
+                    break;
+                }
+            }
+        }
+        m_finished.release();
+    }
+};
+
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::canRunOnWorkerThread(const MergeFileInfos& mfi) const
+{
+    if(m_bSimulatedMergeStarted || m_pOptions->m_maxNofParallelDmOperations < 2)
+        return false;
+
+    const QSharedPointer<DirectoryInfo> dirInfo = rootMFI()->getDirectoryInfo();
+    const FileAccess dirs[4] = {dirInfo->dirA(), dirInfo->dirB(), dirInfo->dirC(), dirInfo->destDir()};
+    for(const FileAccess& dir: dirs)
+    {
+        if(dir.isValid() && !dir.isLocal())
+            return false;
+    }
+
+    // Merging a file needs the user, merging a folder only makes it.
+    return !isMergeOperation(mfi.getOperation()) || mfi.isDirA();
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::runFileOperationBatch(ProgressProxy& pp)
+{
+    std::vector<std::vector<FileOperation>> dirOperations(1);
+    std::vector<std::vector<FileOperation>> fileOperations;
+    QHash<const MergeFileInfos*, int> folderIndexes;
+    int nofOperations = 0;
+    for(MergeItemList::iterator it = m_currentIndexForOperation; it != m_mergeItemList.end() && nofOperations < maxNofBatchOperations; ++it)
+    {
+        MergeFileInfos* pMFI = getMFI(*it);
+        if(m_fileOperationResults.contains(pMFI))
+            continue; // Done by an earlier batch that was stopped.
+        if(!canRunOnWorkerThread(*pMFI))
+            break;
+
+        const FileOperation operation{pMFI, false, false, QStringList()};
+        if(pMFI->hasDir())
+        {
+            dirOperations[0].push_back(operation);
+        }
+        else
+        {
+            QHash<const MergeFileInfos*, int>::const_iterator folderIt = folderIndexes.constFind(pMFI->parent());
+            if(folderIt == folderIndexes.constEnd())
+            {
+                folderIt = folderIndexes.insert(pMFI->parent(), (int)fileOperations.size());
+                fileOperations.push_back(std::vector<FileOperation>());
+            }
+            fileOperations[*folderIt].push_back(operation);
+        }
+        ++nofOperations;
+    }
+
+    QAtomicInt bStop(0);
+    runFileOperations(dirOperations, 1, bStop, pp);
+    if(bStop.loadAcquire() == 0)
+        runFileOperations(fileOperations, m_pOptions->m_maxNofParallelDmOperations, bStop, pp);
+
+    const std::vector<std::vector<FileOperation>>* const phases[2] = {&dirOperations, &fileOperations};
+    for(const std::vector<std::vector<FileOperation>>* pFolders: phases)
+    {
+        for(const std::vector<FileOperation>& folder: *pFolders)
+        {
+            for(const FileOperation& operation: folder)
+            {
+                if(operation.bDone)
+                    m_fileOperationResults.insert(operation.pMFI, operation);
+            }
+        }
+    }
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::runFileOperations(std::vector<std::vector<FileOperation>>& folders, int nofWorkers, QAtomicInt& bStop, ProgressProxy& pp)
+{
+    nofWorkers = std::min(nofWorkers, (int)folders.size());
+    if(nofWorkers == 0 || (folders.size() == 1 && folders[0].empty()))
+        return;
+
+    QAtomicInt nextFolder(0);
+    QSemaphore workersFinished;
+    for(int i = 0; i < nofWorkers; ++i)
+        QThreadPool::globalInstance()->start(new FileOperationsRunnable(*this, folders, nextFolder, bStop, workersFinished));
+
+    // wasCancelled() keeps processing events while waiting.
+    while(!workersFinished.tryAcquire(nofWorkers, 100))
+    {
+        if(pp.wasCancelled())
+            bStop.storeRelease(1);
+    }
+}
+
 // Check if the merge can start, and prepare the m_mergeItemList which then contains all
 // items that must be merged.
 void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareMergeStart(const QModelIndex& miBegin, const QModelIndex& miEnd, bool bVerbose)
@@ -2116,6 +3272,7 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareMergeStart(const
     }
 
     m_mergeItemList.clear();
+    m_fileOperationResults.clear();
     if(!miBegin.isValid())
         return;
 
@@ -2140,6 +3297,7 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareMergeStart(const
             }
             if(!errorText.isEmpty())
             {
+                ensureFetched(mi);
                 mWindow->scrollTo(mi, QAbstractItemView::EnsureVisible);
                 mWindow->setCurrentIndex(mi);
                 KMessageBox::error(mWindow, errorText);
@@ -2155,7 +3313,8 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareMergeStart(const
 
 void DirectoryMergeWindow::slotRunOperationForCurrentItem()
 {
-    if(!d->canContinue()) return;
+    // The operations follow from the results of all items.
+    if(!d->canContinue() || !d->finishComparisons()) return;
 
     bool bVerbose = false;
     if(d->m_mergeItemList.empty())
@@ -2172,7 +3331,7 @@ void DirectoryMergeWindow::slotRunOperationForCurrentItem()
 
 void DirectoryMergeWindow::slotRunOperationForAllItems()
 {
-    if(!d->canContinue()) return;
+    if(!d->canContinue() || !d->finishComparisons()) return;
 
     bool bVerbose = true;
     if(d->m_mergeItemList.empty())
@@ -2282,14 +3441,14 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeContinue(bool bStar
         {
             if(bSim)
             {
-                if(rowCount(miCurrent) == 0)
+                if(nofChildren(miCurrent) == 0)
                 {
                     pMFI->endSimOp();
                 }
             }
             else
             {
-                if(rowCount(miCurrent) == 0)
+                if(nofChildren(miCurrent) == 0)
                 {
                     if(pMFI->isOperationRunning())
                     {
@@ -2318,9 +3477,9 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeContinue(bool bStar
                 bool bDone = true;
                 while(bDone && miParent.isValid())
                 {
-                    for(int childIdx = 0; childIdx < rowCount(miParent); ++childIdx)
+                    for(int childIdx = 0; childIdx < nofChildren(miParent); ++childIdx)
                     {
-                        pMFI = getMFI(index(childIdx, 0, miParent));
+                        pMFI = getMFI(childIndex(childIdx, miParent));
                         if((!bSim && pMFI->isOperationRunning()) || (bSim && !pMFI->isSimOpRunning()))
                         {
                             bDone = false;
@@ -2377,7 +3536,22 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeContinue(bool bStar
                           false // bRedrawUpdate
         );
 
-        bSuccess = executeMergeOperation(*pMFI, bSingleFileMerge); // Here the real operation happens.
+        if(!m_fileOperationResults.contains(pMFI) && canRunOnWorkerThread(*pMFI))
+            runFileOperationBatch(pp);
+
+        QHash<const MergeFileInfos*, FileOperation>::iterator resultIt = m_fileOperationResults.find(pMFI);
+        if(resultIt != m_fileOperationResults.end())
+        {
+            // Already done on a worker thread.
+            bSingleFileMerge = false;
+            bSuccess = resultIt->bSuccess;
+            addStatusText(resultIt->statusText);
+            m_fileOperationResults.erase(resultIt);
+        }
+        else
+        {
+            bSuccess = executeMergeOperation(*pMFI, bSingleFileMerge); // Here the real operation happens.
+        }
 
         if(bSuccess)
         {
@@ -2394,6 +3568,7 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeContinue(bool bStar
 
     //g_pProgressDialog->hide();
 
+    ensureFetched(miCurrent);
     mWindow->setCurrentIndex(miCurrent);
     mWindow->scrollTo(miCurrent, EnsureVisible);
     if(!bSuccess && !bSingleFileMerge)
@@ -2420,7 +3595,7 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeContinue(bool bStar
     }
 }
 
-bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::deleteFLD(const QString& name, bool bCreateBackup)
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::deleteFLD(const QString& name, bool bCreateBackup, QStringList& statusText)
 {
     FileAccess fi(name, true);
     if(!fi.exists())
@@ -2428,19 +3603,19 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::deleteFLD(const QString&
 
     if(bCreateBackup)
     {
-        bool bSuccess = renameFLD(name, name + ".orig");
+        bool bSuccess = renameFLD(name, name + ".orig", statusText);
         if(!bSuccess)
         {
-            m_pStatusInfo->addText(i18n("Error: While deleting %1: Creating backup failed.", name));
+            statusText.append(i18n("Error: While deleting %1: Creating backup failed.", name));
             return false;
         }
     }
     else
     {
         if(fi.isDir() && !fi.isSymLink())
-            m_pStatusInfo->addText(i18n("delete folder recursively( %1 )", name));
+            statusText.append(i18n("delete folder recursively( %1 )", name));
         else
-            m_pStatusInfo->addText(i18n("delete( %1 )", name));
+            statusText.append(i18n("delete( %1 )", name));
 
         if(m_bSimulatedMergeStarted)
         {
@@ -2455,7 +3630,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::deleteFLD(const QString&
             if(!bSuccess)
             {
                 // No Permission to read directory or other error.
-                m_pStatusInfo->addText(i18n("Error: delete folder operation failed while trying to read the folder."));
+                statusText.append(i18n("Error: delete folder operation failed while trying to read the folder."));
                 return false;
             }
 
@@ -2466,7 +3641,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::deleteFLD(const QString&
                 FileAccess& fi2 = *it;
                 Q_ASSERT(fi2.fileName() != "." && fi2.fileName() != "..");
 
-                bSuccess = deleteFLD(fi2.absoluteFilePath(), false);
+                bSuccess = deleteFLD(fi2.absoluteFilePath(), false, statusText);
                 if(!bSuccess) break;
             }
             if(bSuccess)
@@ -2474,7 +3649,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::deleteFLD(const QString&
                 bSuccess = FileAccess::removeDir(name);
                 if(!bSuccess)
                 {
-                    m_pStatusInfo->addText(i18n("Error: rmdir( %1 ) operation failed.", name)); // krazy:exclude=syscalls
+                    statusText.append(i18n("Error: rmdir( %1 ) operation failed.", name)); // krazy:exclude=syscalls
                     return false;
                 }
             }
@@ -2484,7 +3659,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::deleteFLD(const QString&
             bool bSuccess = fi.removeFile();
             if(!bSuccess)
             {
-                m_pStatusInfo->addText(i18n("Error: delete operation failed."));
+                statusText.append(i18n("Error: delete operation failed."));
                 return false;
             }
         }
@@ -2494,10 +3669,13 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::deleteFLD(const QString&
 
 bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeFLD(const QString& nameA, const QString& nameB, const QString& nameC, const QString& nameDest, bool& bSingleFileMerge)
 {
+    QStringList statusText;
     FileAccess fi(nameA);
     if(fi.isDir())
     {
-        return makeDir(nameDest);
+        bool bSuccess = makeDir(nameDest, statusText);
+        addStatusText(statusText);
+        return bSuccess;
     }
 
     // Make sure that the dir exists, into which we will save the file later.
@@ -2505,7 +3683,8 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeFLD(const QString&
     if(pos > 0)
     {
         QString parentName = nameDest.left(pos);
-        bool bSuccess = makeDir(parentName, true /*quiet*/);
+        bool bSuccess = makeDir(parentName, statusText, true /*quiet*/);
+        addStatusText(statusText);
         if(!bSuccess)
             return false;
     }
@@ -2519,6 +3698,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeFLD(const QString&
 
     bSingleFileMerge = true;
     setOpStatus(*m_currentIndexForOperation, eOpStatusInProgress);
+    ensureFetched(*m_currentIndexForOperation);
     mWindow->scrollTo(*m_currentIndexForOperation, EnsureVisible);
 
     Q_EMIT mWindow->startDiffMerge(nameA, nameB, nameC, nameDest, "", "", "", nullptr);
@@ -2526,7 +3706,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeFLD(const QString&
     return false;
 }
 
-bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& srcName, const QString& destName)
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& srcName, const QString& destName, QStringList& statusText)
 {
     bool bSuccess = false;
 
@@ -2537,10 +3717,10 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& s
     FileAccess faDest(destName, true);
     if(faDest.exists() && !(fi.isDir() && faDest.isDir() && (fi.isSymLink() == faDest.isSymLink())))
     {
-        bSuccess = deleteFLD(destName, m_pOptions->m_bDmCreateBakFiles);
+        bSuccess = deleteFLD(destName, m_pOptions->m_bDmCreateBakFiles, statusText);
         if(!bSuccess)
         {
-            m_pStatusInfo->addText(i18n("Error: copy( %1 -> %2 ) failed."
+            statusText.append(i18n("Error: copy( %1 -> %2 ) failed."
                                         "Deleting existing destination failed.",
                                         srcName, destName));
             return bSuccess;
@@ -2549,7 +3729,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& s
 
     if(fi.isSymLink() && ((fi.isDir() && !m_bFollowDirLinks) || (!fi.isDir() && !m_bFollowFileLinks)))
     {
-        m_pStatusInfo->addText(i18n("copyLink( %1 -> %2 )", srcName, destName));
+        statusText.append(i18n("copyLink( %1 -> %2 )", srcName, destName));
 
         if(m_bSimulatedMergeStarted)
         {
@@ -2558,7 +3738,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& s
         FileAccess destFi(destName);
         if(!destFi.isLocal() || !fi.isLocal())
         {
-            m_pStatusInfo->addText(i18n("Error: copyLink failed: Remote links are not yet supported."));
+            statusText.append(i18n("Error: copyLink failed: Remote links are not yet supported."));
             return false;
         }
 
@@ -2568,7 +3748,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& s
         {
             bSuccess = FileAccess::symLink(linkTarget, destName);
             if(!bSuccess)
-                m_pStatusInfo->addText(i18n("Error: copyLink failed."));
+                statusText.append(i18n("Error: copyLink failed."));
         }
         return bSuccess;
     }
@@ -2578,7 +3758,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& s
         if(faDest.exists())
             return true;
 
-        bSuccess = makeDir(destName);
+        bSuccess = makeDir(destName, statusText);
         return bSuccess;
     }
 
@@ -2586,12 +3766,12 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& s
     if(pos > 0)
     {
         QString parentName = destName.left(pos);
-        bSuccess = makeDir(parentName, true /*quiet*/);
+        bSuccess = makeDir(parentName, statusText, true /*quiet*/);
         if(!bSuccess)
             return false;
     }
 
-    m_pStatusInfo->addText(i18n("copy( %1 -> %2 )", srcName, destName));
+    statusText.append(i18n("copy( %1 -> %2 )", srcName, destName));
 
     if(m_bSimulatedMergeStarted)
     {
@@ -2600,31 +3780,31 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& s
 
     FileAccess faSrc(srcName);
     bSuccess = faSrc.copyFile(destName);
-    if(!bSuccess) m_pStatusInfo->addText(faSrc.getStatusText());
+    if(!bSuccess) statusText.append(faSrc.getStatusText());
     return bSuccess;
 }
 
 // Rename is not an operation that can be selected by the user.
 // It will only be used to create backups.
 // Hence it will delete an existing destination without making a backup (of the old backup.)
-bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::renameFLD(const QString& srcName, const QString& destName)
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::renameFLD(const QString& srcName, const QString& destName, QStringList& statusText)
 {
     if(srcName == destName)
         return true;
     FileAccess destFile = FileAccess(destName, true);
     if(destFile.exists())
     {
-        bool bSuccess = deleteFLD(destName, false /*no backup*/);
+        bool bSuccess = deleteFLD(destName, false /*no backup*/, statusText);
         if(!bSuccess)
         {
-            m_pStatusInfo->addText(i18n("Error during rename( %1 -> %2 ): "
+            statusText.append(i18n("Error during rename( %1 -> %2 ): "
                                         "Cannot delete existing destination.",
                                         srcName, destName));
             return false;
         }
     }
 
-    m_pStatusInfo->addText(i18n("rename( %1 -> %2 )", srcName, destName));
+    statusText.append(i18n("rename( %1 -> %2 )", srcName, destName));
     if(m_bSimulatedMergeStarted)
     {
         return true;
@@ -2633,14 +3813,14 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::renameFLD(const QString&
     bool bSuccess = FileAccess(srcName).rename(destFile);
     if(!bSuccess)
     {
-        m_pStatusInfo->addText(i18n("Error: Rename failed."));
+        statusText.append(i18n("Error: Rename failed."));
         return false;
     }
 
     return true;
 }
 
-bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::makeDir(const QString& name, bool bQuiet)
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::makeDir(const QString& name, QStringList& statusText, bool bQuiet)
 {
     FileAccess fi(name, true);
     if(fi.exists() && fi.isDir())
@@ -2648,10 +3828,10 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::makeDir(const QString& n
 
     if(fi.exists() && !fi.isDir())
     {
-        bool bSuccess = deleteFLD(name, true);
+        bool bSuccess = deleteFLD(name, true, statusText);
         if(!bSuccess)
         {
-            m_pStatusInfo->addText(i18n("Error during makeDir of %1. "
+            statusText.append(i18n("Error during makeDir of %1. "
                                         "Cannot delete existing file.",
                                         name));
             return false;
@@ -2662,23 +3842,24 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::makeDir(const QString& n
     if(pos > 0)
     {
         QString parentName = name.left(pos);
-        bool bSuccess = makeDir(parentName, true);
+        bool bSuccess = makeDir(parentName, statusText, true);
         if(!bSuccess)
             return false;
     }
 
     if(!bQuiet)
-        m_pStatusInfo->addText(i18n("makeDir( %1 )", name));
+        statusText.append(i18n("makeDir( %1 )", name));
 
     if(m_bSimulatedMergeStarted)
     {
         return true;
     }
 
-    bool bSuccess = FileAccess::makeDir(name);
+    // Another worker thread may have made it in the meantime.
+    bool bSuccess = FileAccess::makeDir(name) || FileAccess(name, true).isDir();
     if(!bSuccess)
     {
-        m_pStatusInfo->addText(i18n("Error while creating folder."));
+        statusText.append(i18n("Error while creating folder."));
         return false;
     }
     return true;
@@ -2836,32 +4017,166 @@ void DirectoryMergeInfo::setInfo(
 
 void DirectoryMergeWindow::slotSaveMergeState()
 {
-    //slotStatusMsg(i18n("Saving Directory Merge State ..."));
+    const QString fileName = QFileDialog::getSaveFileName(this, i18n("Save Folder Merge State As..."), QDir::currentPath());
+    if(!fileName.isEmpty() && !d->saveSnapshot(fileName))
+        KMessageBox::error(this, i18n("Saving the folder merge state to \"%1\" failed.", fileName));
+}
+
+void DirectoryMergeWindow::slotLoadMergeState()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, i18n("Load Folder Merge State"), QDir::currentPath());
+    if(fileName.isEmpty())
+        return;
+
+    if(!d->loadSnapshot(fileName))
+    {
+        KMessageBox::error(this, i18n("\"%1\" is no folder merge state this version of KDiff3 can read.", fileName));
+        return;
+    }
+
+    // Opening the folders scans them, init() takes what is still valid from the snapshot.
+    Q_EMIT startDiffMerge(d->m_snapshotDirs[0], d->m_snapshotDirs[1], d->m_snapshotDirs[2], d->m_snapshotDirs[3], "", "", "", nullptr);
+}
+
+// Written at the start of a snapshot, a file with another value is not read.
+static const quint32 snapshotMagic = 0x4B444D53; // "KDMS"
+static const quint32 snapshotVersion = 1;
+
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::saveSnapshot(const QString& fileName)
+{
+    if(!finishComparisons())
+        return false;
+
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
 
-    QString dirMergeStateFilename = QFileDialog::getSaveFileName(this, i18n("Save Folder Merge State As..."), QDir::currentPath());
-    if(!dirMergeStateFilename.isEmpty())
+    QVector<QModelIndex> items;
+    for(QModelIndex mi = childIndex(0, QModelIndex()); mi.isValid(); mi = treeIterator(mi, true, true))
+        items.push_back(mi);
+
+    QDataStream stream(&file);
+    stream << snapshotMagic << snapshotVersion << snapshotDirs(*rootMFI()->getDirectoryInfo()) << comparisonMode(*m_pOptions) << (qint32)items.size();
+    for(const QModelIndex& mi: items)
     {
-        QFile file(dirMergeStateFilename);
-        bool bSuccess = file.open(QIODevice::WriteOnly);
-        if(bSuccess)
-        {
-            QTextStream ts(&file);
+        const MergeFileInfos* pMFI = getMFI(mi);
+        stream << pMFI->subPath();
 
-            QModelIndex mi(d->index(0, 0, QModelIndex()));
-            while(mi.isValid())
-            {
-                MergeFileInfos* pMFI = d->getMFI(mi);
-                ts << *pMFI;
-                mi = d->treeIterator(mi, true, true);
-            }
+        const FileAccess* const files[3] = {pMFI->getFileInfoA(), pMFI->getFileInfoB(), pMFI->getFileInfoC()};
+        for(const FileAccess* pFA: files)
+        {
+            const SnapshotFile f = snapshotFile(pFA);
+            stream << f.type << f.size << f.lastModified;
         }
+
+        QByteArray comparison;
+        QDataStream comparisonStream(&comparison, QIODevice::WriteOnly);
+        pMFI->writeComparison(comparisonStream);
+
+        const bool bExpanded = isFetched(mi.parent()) && mWindow->isExpanded(mi);
+        stream << comparison << (qint32)pMFI->getOperation() << (qint32)pMFI->getOpStatus() << !pMFI->isOperationRunning() << bExpanded
+               << (qint32)comparisonState(*pMFI);
     }
 
-    //slotStatusMsg(i18n("Ready."));
+    return stream.status() == QDataStream::Ok && file.commit();
 }
 
-void DirectoryMergeWindow::slotLoadMergeState()
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::loadSnapshot(const QString& fileName)
+{
+    m_snapshot.clear();
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if(magic != snapshotMagic || version != snapshotVersion)
+        return false;
+
+    QStringList dirs;
+    quint8 comparisonMode = 0;
+    qint32 nofItems = 0;
+    stream >> dirs >> comparisonMode >> nofItems;
+    if(stream.status() != QDataStream::Ok || dirs.size() != 4 || nofItems < 0)
+        return false;
+
+    m_snapshot.reserve(nofItems);
+    for(qint32 i = 0; i < nofItems && stream.status() == QDataStream::Ok; ++i)
+    {
+        QString subPath;
+        SnapshotItem item;
+        stream >> subPath;
+        for(SnapshotFile& f: item.files)
+            stream >> f.type >> f.size >> f.lastModified;
+
+        qint32 operation = 0, opStatus = 0, comparison = 0;
+        bool bOperationComplete = false, bExpanded = false;
+        stream >> item.comparison >> operation >> opStatus >> bOperationComplete >> bExpanded >> comparison;
+        if(operation < eTitleId || operation > eConflictingAges || opStatus < eOpStatusNone || opStatus > eOpStatusToDo)
+            stream.setStatus(QDataStream::ReadCorruptData);
+
+        item.state = t_ItemInfo{bExpanded, bOperationComplete, (e_OperationStatus)opStatus, (e_MergeOperation)operation, comparison};
+        m_snapshot.insert(subPath, item);
+    }
+
+    if(stream.status() != QDataStream::Ok)
+    {
+        m_snapshot.clear();
+        return false;
+    }
+
+    m_snapshotDirs = dirs;
+    m_snapshotComparisonMode = comparisonMode;
+    return true;
+}
+
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::takeSnapshotComparison(MergeFileInfos& mfi) const
+{
+    if(m_snapshot.isEmpty() || m_snapshotComparisonMode != comparisonMode(*m_pOptions))
+        return false;
+
+    const QHash<QString, SnapshotItem>::const_iterator it = m_snapshot.constFind(mfi.subPath());
+    if(it == m_snapshot.constEnd())
+        return false;
+
+    const FileAccess* const files[3] = {mfi.getFileInfoA(), mfi.getFileInfoB(), mfi.getFileInfoC()};
+    for(int i = 0; i < 3; ++i)
+    {
+        const SnapshotFile f = snapshotFile(files[i]);
+        if(f.type != it->files[i].type || f.size != it->files[i].size || f.lastModified != it->files[i].lastModified)
+            return false;
+    }
+
+    QDataStream stream(it->comparison);
+    if(mfi.readComparison(stream))
+        return true;
+
+    mfi.resetComparison();
+    return false;
+}
+
+QStringList DirectoryMergeWindow::DirectoryMergeWindowPrivate::snapshotDirs(const DirectoryInfo& dirInfo)
+{
+    return QStringList() << dirInfo.dirA().absoluteFilePath() << dirInfo.dirB().absoluteFilePath()
+                         << (dirInfo.dirC().isValid() ? dirInfo.dirC().absoluteFilePath() : QString())
+                         << (dirInfo.hasDestDir() ? dirInfo.destDir().absoluteFilePath() : QString());
+}
+
+DirectoryMergeWindow::DirectoryMergeWindowPrivate::SnapshotFile DirectoryMergeWindow::DirectoryMergeWindowPrivate::snapshotFile(const FileAccess* pFA)
+{
+    if(pFA == nullptr)
+        return SnapshotFile{0, 0, 0};
+
+    const quint8 type = 1 | (pFA->isDir() ? 2 : 0) | (pFA->isSymLink() ? 4 : 0);
+    return SnapshotFile{type, pFA->size(), pFA->lastModified().toMSecsSinceEpoch()};
+}
+
+quint8 DirectoryMergeWindow::DirectoryMergeWindowPrivate::comparisonMode(const Options& options)
 {
+    return (options.m_bDmFullAnalysis ? 1 : 0) | (options.m_bDmTrustDate ? 2 : 0) | (options.m_bDmTrustDateFallbackToBinary ? 4 : 0) |
+           (options.m_bDmTrustSize ? 8 : 0) | (options.m_bDmWhiteSpaceEqual ? 16 : 0) | (options.m_bDmFollowFileLinks ? 32 : 0);
 }
 
 void DirectoryMergeWindow::updateFileVisibilities()
@@ -2875,6 +4190,9 @@ void DirectoryMergeWindow::updateFileVisibilities()
     d->m_selection1Index = QModelIndex();
     d->m_selection2Index = QModelIndex();
     d->m_selection3Index = QModelIndex();
+    const WildcardMatcher fileMatcher(d->m_pOptions->m_DmFilePattern, d->m_bCaseSensitive);
+    const WildcardMatcher fileAntiMatcher(d->m_pOptions->m_DmFileAntiPattern, d->m_bCaseSensitive);
+    const WildcardMatcher dirAntiMatcher(d->m_pOptions->m_DmDirAntiPattern, d->m_bCaseSensitive);
 
     // in first run set all dirs to equal and determine if they are not equal.
     // on second run don't change the equal-status anymore; it is needed to
@@ -2885,6 +4203,14 @@ void DirectoryMergeWindow::updateFileVisibilities()
         while(mi.isValid())
         {
             MergeFileInfos* pMFI = d->getMFI(mi);
+            // Shown until its results are there, then this runs again.
+            if(d->isComparisonPending(pMFI))
+            {
+                if(loop != 0)
+                    d->setItemHidden(mi, false);
+                mi = d->treeIterator(mi, true, true);
+                continue;
+            }
             bool bDir = pMFI->hasDir();
             if(loop == 0 && bDir)
             { //Treat all links and directories to equal by default.
@@ -2897,10 +4223,10 @@ void DirectoryMergeWindow::updateFileVisibilities()
                 (bShowOnlyInA && pMFI->onlyInA()) || (bShowOnlyInB && pMFI->onlyInB()) || (bShowOnlyInC && pMFI->onlyInC());
 
             QString fileName = pMFI->fileName();
-            bVisible = bVisible && ((bDir && !Utils::wildcardMultiMatch(d->m_pOptions->m_DmDirAntiPattern, fileName, d->m_bCaseSensitive)) || (Utils::wildcardMultiMatch(d->m_pOptions->m_DmFilePattern, fileName, d->m_bCaseSensitive) && !Utils::wildcardMultiMatch(d->m_pOptions->m_DmFileAntiPattern, fileName, d->m_bCaseSensitive)));
+            bVisible = bVisible && ((bDir && !dirAntiMatcher.matches(fileName)) || (fileMatcher.matches(fileName) && !fileAntiMatcher.matches(fileName)));
 
             if(loop != 0)
-                setRowHidden(mi.row(), mi.parent(), !bVisible);
+                d->setItemHidden(mi, !bVisible);
 
             bool bEqual = bThreeDirs ? pMFI->isEqualAB() && pMFI->isEqualAC() : pMFI->isEqualAB();
             if(!bEqual && bVisible && loop == 0) // Set all parents to "not equal"
@@ -2952,8 +4278,10 @@ void DirectoryMergeWindow::initDirectoryMergeActions(KDiff3App* pKDiff3App, KAct
     d->m_pDirFoldAll = GuiUtils::createAction<QAction>(i18n("Fold All Subfolders"), this, &DirectoryMergeWindow::collapseAll, ac, "dir_fold_all");
     d->m_pDirUnfoldAll = GuiUtils::createAction<QAction>(i18n("Unfold All Subfolders"), this, &DirectoryMergeWindow::expandAll, ac, "dir_unfold_all");
     d->m_pDirRescan = GuiUtils::createAction<QAction>(i18n("Rescan"), QKeySequence(Qt::SHIFT + Qt::Key_F5), this, &DirectoryMergeWindow::reload, ac, "dir_rescan");
-    d->m_pDirSaveMergeState = nullptr; //GuiUtils::createAction< QAction >(i18n("Save Directory Merge State ..."), 0, this, &DirectoryMergeWindow::slotSaveMergeState, ac, "dir_save_merge_state");
-    d->m_pDirLoadMergeState = nullptr; //GuiUtils::createAction< QAction >(i18n("Load Directory Merge State ..."), 0, this, &DirectoryMergeWindow::slotLoadMergeState, ac, "dir_load_merge_state");
+    d->m_pDirWatchFolders = GuiUtils::createAction<KToggleAction>(i18n("Watch Folders for Changes"), this, &DirectoryMergeWindow::slotWatchFolders, ac, "dir_watch_folders");
+    d->m_pDirWatchFolders->setChecked(d->m_pOptions->m_bDmWatchFolders);
+    d->m_pDirSaveMergeState = GuiUtils::createAction<QAction>(i18n("Save Folder Merge State..."), this, &DirectoryMergeWindow::slotSaveMergeState, ac, "dir_save_merge_state");
+    d->m_pDirLoadMergeState = GuiUtils::createAction<QAction>(i18n("Load Folder Merge State..."), this, &DirectoryMergeWindow::slotLoadMergeState, ac, "dir_load_merge_state");
     d->m_pDirChooseAEverywhere = GuiUtils::createAction<QAction>(i18n("Choose A for All Items"), this, &DirectoryMergeWindow::slotChooseAEverywhere, ac, "dir_choose_a_everywhere");
     d->m_pDirChooseBEverywhere = GuiUtils::createAction<QAction>(i18n("Choose B for All Items"), this, &DirectoryMergeWindow::slotChooseBEverywhere, ac, "dir_choose_b_everywhere");
     d->m_pDirChooseCEverywhere = GuiUtils::createAction<QAction>(i18n("Choose C for All Items"), this, &DirectoryMergeWindow::slotChooseCEverywhere, ac, "dir_choose_c_everywhere");
@@ -3015,6 +4343,8 @@ void DirectoryMergeWindow::updateAvailabilities(bool bDirCompare, bool bDiffWind
     d->m_pDirMergeCurrent->setEnabled((bDirCompare && isVisible() && isFileSelected()) || bDiffWindowVisible);
 
     d->m_pDirRescan->setEnabled(bDirCompare);
+    d->m_pDirWatchFolders->setEnabled(bDirCompare);
+    d->m_pDirSaveMergeState->setEnabled(bDirCompare);
 
     bool bThreeDirs = d->isThreeWay();
     d->m_pDirAutoChoiceEverywhere->setEnabled(bDirCompare && isVisible());
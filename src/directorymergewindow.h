@@ -117,6 +117,8 @@ class DirectoryMergeWindow : public QTreeView
    void slotSaveMergeState();
    void slotLoadMergeState();
 
+   void slotWatchFolders();
+
    inline void slotRefresh() { updateFileVisibilities(); };
 
 Q_SIGNALS:
@@ -126,6 +128,11 @@ Q_SIGNALS:
 protected Q_SLOTS:
    void onDoubleClick(const QModelIndex&);
    void onExpanded();
+   void slotFolderChanged(const QString& path);
+   void slotUpdateChangedFolders();
+   void slotViewMoved();
+   void slotPrioritizeComparisons();
+   void slotTakeComparedItems();
    void currentChanged(const QModelIndex& current, const QModelIndex& previous) override; // override
 private:
   int getIntFromIndex(const QModelIndex& index) const;
@@ -10,19 +10,53 @@
 #include "cvsignorelist.h"
 #include "common.h"
 #include "Logging.h"
+#include "MemoryUsage.h"
 #include "progress.h"
 #include "ProgressProxyExtender.h"
-#include "Utils.h"
+#include "TaskGroup.h"
+#include "Tracing.h"
+#include "TypeUtils.h"
+#include "WildcardMatcher.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <vector>
 
+#ifndef Q_OS_WIN
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+
+// The copies of macOS and Windows have not been compiled yet, so they must be asked for.
+#if defined(Q_OS_DARWIN) && defined(ENABLE_NATIVE_COPY_MAC_WIN)
+#define NATIVE_COPY_DARWIN
+#include <copyfile.h>
+#endif
+
+#if defined(Q_OS_WIN) && defined(ENABLE_NATIVE_COPY_MAC_WIN)
+#define NATIVE_COPY_WIN
+#include <qt_windows.h>
+#endif
+
 #include <QDir>
 #include <QFile>
 #include <QtMath>
 #include <QRegExp>
+#include <QRunnable>
+#include <QSemaphore>
 #include <QTemporaryFile>
 
 #include <KIO/CopyJob>
@@ -50,11 +84,8 @@ void FileAccess::setFile(FileAccess* pParent, const QFileInfo& fi)
 {
     reset();
 
+    // A local entry of a listing has no URL, see url().
     m_fileInfo = fi;
-    m_url = QUrl::fromLocalFile(m_fileInfo.filePath());
-    if(!m_url.scheme().isEmpty())
-        m_url.setScheme(QLatin1Literal("file"));
-
     m_pParent = pParent;
     loadData();
 }
@@ -143,7 +174,6 @@ void FileAccess::loadData()
 #endif
     }
 
-    realFile = QSharedPointer<QFile>::create(absoluteFilePath());
     m_bValidData = true;
 }
 
@@ -252,7 +282,9 @@ void FileAccess::setFromUdsEntry(const KIO::UDSEntry& e, FileAccess *parent)
     {
         if(parent != nullptr)
         {
-            m_url = parent->url().resolved(QUrl(filePath));
+            // The name may contain characters like '#' or '?', so it is not resolved as relative url.
+            m_url = parent->url().adjusted(QUrl::StripTrailingSlash);
+            m_url.setPath(m_url.path() + '/' + filePath);
             //Verify that the scheme doesn't change.
             Q_ASSERT(m_url.scheme() == parent->url().scheme());
         }
@@ -273,10 +305,14 @@ void FileAccess::setFromUdsEntry(const KIO::UDSEntry& e, FileAccess *parent)
     {
         m_name = m_fileInfo.absoluteDir().dirName();
     }
-    m_bExists = m_fileInfo.exists();
-    //insure modification time is initialized if it wasn't already.
-    if(m_modificationTime == QDateTime::fromMSecsSinceEpoch(0))
-        m_modificationTime = m_fileInfo.lastModified();
+    // m_fileInfo only knows the name of remote files, those get everything from the entry.
+    if(isLocal())
+    {
+        m_bExists = m_fileInfo.exists();
+        //insure modification time is initialized if it wasn't already.
+        if(m_modificationTime == QDateTime::fromMSecsSinceEpoch(0))
+            m_modificationTime = m_fileInfo.lastModified();
+    }
 
     m_bValidData = true;
     m_bSymLink = !m_linkTarget.isEmpty();
@@ -296,51 +332,37 @@ bool FileAccess::isNormal() const
     return !exists() || isFile() || isDir() || isSymLink();
 }
 
+// The status is read once when the file is set or listed, see loadData() and listDir().
 bool FileAccess::isFile() const
 {
-    if(!isLocal())
-        return m_bFile;
-    else
-        return m_fileInfo.isFile();
+    return m_bFile;
 }
 
 bool FileAccess::isDir() const
 {
-    if(!isLocal())
-        return m_bDir;
-    else
-        return m_fileInfo.isDir();
+    return m_bDir;
 }
 
 bool FileAccess::isSymLink() const
 {
-    if(!isLocal())
-        return m_bSymLink;
-    else
-        return m_fileInfo.isSymLink();
+    return m_bSymLink;
 }
 
 bool FileAccess::exists() const
 {
-    if(!isLocal())
-        return m_bExists;
-    else
-        return m_fileInfo.exists();
+    return m_bExists;
 }
 
 qint64 FileAccess::size() const
 {
-    if(!isLocal())
-        return m_size;
-    else
-        return m_fileInfo.size();
+    return m_size;
 }
 
 QUrl FileAccess::url() const
 {
     QUrl url = m_url;
 
-    if(url.isLocalFile())
+    if(url.isLocalFile() || (url.isEmpty() && m_pParent != nullptr))
     {
         url = QUrl::fromLocalFile(absoluteFilePath());
     }
@@ -381,10 +403,7 @@ bool FileAccess::isExecutable() const
 
 bool FileAccess::isHidden() const
 {
-    if(!(isLocal()))
-        return m_bHidden;
-    else
-        return m_fileInfo.isHidden();
+    return m_bHidden;
 }
 
 QString FileAccess::readLink() const
@@ -411,6 +430,10 @@ QString FileAccess::fileName(bool needTmp) const
 
 QString FileAccess::fileRelPath() const
 {
+    // Remote entries have no local path, they are relative to the listed folder at the top.
+    if(!isLocal())
+        return m_pParent == nullptr || m_pParent->parent() == nullptr ? m_name : m_pParent->fileRelPath() + '/' + m_name;
+
     QString path = m_baseDir.relativeFilePath(m_fileInfo.absoluteFilePath());
 
     return path;
@@ -478,7 +501,7 @@ bool FileAccess::readFile(void* pDestBuffer, qint64 maxLength)
     }
 
     close();
-    Q_ASSERT(!realFile->isOpen() && !tmpFile->isOpen());
+    Q_ASSERT(!isOpen());
     return success;
 }
 
@@ -487,7 +510,8 @@ bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
     ProgressProxy pp;
     if(isLocal())
     {
-        if(realFile->open(QIODevice::WriteOnly))
+        QFile& file = localFile();
+        if(file.open(QIODevice::WriteOnly))
         {
             const qint64 maxChunkSize = 100000;
             pp.setMaxNofSteps(length / maxChunkSize + 1);
@@ -495,10 +519,10 @@ bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
             while(i < length)
             {
                 qint64 nextLength = std::min(length - i, maxChunkSize);
-                qint64 reallyWritten = realFile->write((char*)pSrcBuffer + i, nextLength);
+                qint64 reallyWritten = file.write((char*)pSrcBuffer + i, nextLength);
                 if(reallyWritten != nextLength)
                 {
-                    realFile->close();
+                    file.close();
                     return false;
                 }
                 i += reallyWritten;
@@ -506,7 +530,7 @@ bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
                 pp.step();
                 if(pp.wasCancelled())
                 {
-                    realFile->close();
+                    file.close();
                     return false;
                 }
             }
@@ -514,10 +538,10 @@ bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
             if(isExecutable()) // value is true if the old file was executable
             {
                 // Preserve attributes
-                realFile->setPermissions(realFile->permissions() | QFile::ExeUser);
+                file.setPermissions(file.permissions() | QFile::ExeUser);
             }
 
-            realFile->close();
+            file.close();
             return true;
         }
     }
@@ -527,12 +551,12 @@ bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
         bool success = jh.put(pSrcBuffer, length, true /*overwrite*/);
         close();
 
-        Q_ASSERT(!realFile->isOpen() && !tmpFile->isOpen());
+        Q_ASSERT(!isOpen());
 
         return success;
     }
     close();
-    Q_ASSERT(!realFile->isOpen() && !tmpFile->isOpen());
+    Q_ASSERT(!isOpen());
     return false;
 }
 
@@ -563,11 +587,14 @@ bool FileAccess::removeFile()
 
 bool FileAccess::listDir(t_DirectoryList* pDirList, bool bRecursive, bool bFindHidden,
                          const QString& filePattern, const QString& fileAntiPattern, const QString& dirAntiPattern,
-                         bool bFollowDirLinks, bool bUseCvsIgnore)
+                         bool bFollowDirLinks, bool bUseCvsIgnore, int maxNofRemoteListings)
 {
+    TraceSpan span("listDir");
     FileAccessJobHandler jh(this);
-    return jh.listDir(pDirList, bRecursive, bFindHidden, filePattern, fileAntiPattern,
-                      dirAntiPattern, bFollowDirLinks, bUseCvsIgnore);
+    const bool bSuccess = jh.listDir(pDirList, bRecursive, bFindHidden, filePattern, fileAntiPattern,
+                                     dirAntiPattern, bFollowDirLinks, bUseCvsIgnore, maxNofRemoteListings);
+    span.setItemCount(pDirList->size());
+    return bSuccess;
 }
 
 QString FileAccess::getTempName() const
@@ -580,6 +607,13 @@ const QString& FileAccess::errorString() const
     return getStatusText();
 }
 
+qint64 FileAccess::memoryUsage() const
+{
+    // The private data of m_url and m_fileInfo is left out, it is not accessible. The files are only made when opened.
+    return (qint64)sizeof(FileAccess) + MemoryUsage::ofString(m_name) + MemoryUsage::ofString(m_linkTarget) +
+           MemoryUsage::ofString(m_localCopy) + MemoryUsage::ofString(m_statusText);
+}
+
 bool FileAccess::open(const QFile::OpenMode flags)
 {
     bool result;
@@ -590,16 +624,16 @@ bool FileAccess::open(const QFile::OpenMode flags)
         return result;
     }
 
-    if(m_localCopy.isEmpty() && realFile != nullptr)
+    if(m_localCopy.isEmpty() && hasLocalFile())
     {
-        bool r = realFile->open(flags);
+        bool r = localFile().open(flags);
 
-        setStatusText(i18n("Opening %1 failed. %2", absoluteFilePath(), realFile->errorString()));
+        setStatusText(i18n("Opening %1 failed. %2", absoluteFilePath(), localFile().errorString()));
         return r;
     }
 
-    bool r = tmpFile->open();
-    setStatusText(i18n("Opening %1 failed. %2", tmpFile->fileName(), tmpFile->errorString()));
+    bool r = tempFile().open();
+    setStatusText(i18n("Opening %1 failed. %2", tempFile().fileName(), tempFile().errorString()));
     return r;
 }
 
@@ -613,20 +647,20 @@ qint64 FileAccess::read(char* data, const qint64 maxlen)
     }
 
     qint64 len = 0;
-    if(m_localCopy.isEmpty() && realFile != nullptr)
+    if(m_localCopy.isEmpty() && hasLocalFile())
     {
-        len = realFile->read(data, maxlen);
+        len = localFile().read(data, maxlen);
         if(len != maxlen)
         {
-            setStatusText(i18n("Error reading from %1. %2", absoluteFilePath(), realFile->errorString()));
+            setStatusText(i18n("Error reading from %1. %2", absoluteFilePath(), localFile().errorString()));
         }
     }
     else
     {
-        len = tmpFile->read(data, maxlen);
+        len = tempFile().read(data, maxlen);
         if(len != maxlen)
         {
-            setStatusText(i18n("Error reading from %1. %2", absoluteFilePath(), tmpFile->errorString()));
+            setStatusText(i18n("Error reading from %1. %2", absoluteFilePath(), tempFile().errorString()));
         }
     }
 
@@ -640,7 +674,33 @@ void FileAccess::close()
         realFile->close();
     }
 
-    tmpFile->close();
+    if(tmpFile != nullptr)
+        tmpFile->close();
+}
+
+bool FileAccess::isOpen() const
+{
+    return (realFile != nullptr && realFile->isOpen()) || (tmpFile != nullptr && tmpFile->isOpen());
+}
+
+// Valid local files, the ones realFile is made for.
+bool FileAccess::hasLocalFile() const
+{
+    return m_bValidData && isLocal();
+}
+
+QFile& FileAccess::localFile()
+{
+    if(realFile == nullptr)
+        realFile = QSharedPointer<QFile>::create(absoluteFilePath());
+    return *realFile;
+}
+
+QTemporaryFile& FileAccess::tempFile()
+{
+    if(tmpFile == nullptr)
+        tmpFile = QSharedPointer<QTemporaryFile>::create();
+    return *tmpFile;
 }
 
 bool FileAccess::createLocalCopy()
@@ -648,12 +708,13 @@ bool FileAccess::createLocalCopy()
     if(isLocal() || !m_localCopy.isEmpty())
         return true;
 
-    tmpFile->setAutoRemove(true);
-    tmpFile->open();
-    tmpFile->close();
-    m_localCopy = tmpFile->fileName();
+    QTemporaryFile& file = tempFile();
+    file.setAutoRemove(true);
+    file.open();
+    file.close();
+    m_localCopy = file.fileName();
 
-    return copyFile(tmpFile->fileName());
+    return copyFile(file.fileName());
 }
 //static tempfile Generator
 void FileAccess::createTempFile(QTemporaryFile& tmpFile)
@@ -697,7 +758,7 @@ qint64 FileAccess::sizeForReading()
     {
         // Size couldn't be determined. Copy the file to a local temp place.
         createLocalCopy();
-        QString localCopy = tmpFile->fileName();
+        QString localCopy = tempFile().fileName();
         bool bSuccess = copyFile(localCopy);
         if(bSuccess)
         {
@@ -785,6 +846,9 @@ void FileAccess::filterList(t_DirectoryList* pDirList, const QString& filePatter
 #else
     bool bCaseSensitive = true;
 #endif
+    const WildcardMatcher fileMatcher(filePattern, bCaseSensitive);
+    const WildcardMatcher fileAntiMatcher(fileAntiPattern, bCaseSensitive);
+    const WildcardMatcher dirAntiMatcher(dirAntiPattern, bCaseSensitive);
 
     // Now remove all entries that should be ignored:
     t_DirectoryList::iterator i;
@@ -794,10 +858,8 @@ void FileAccess::filterList(t_DirectoryList* pDirList, const QString& filePatter
         ++i2;
         QString fileName = i->fileName();
 
-        if((i->isFile() &&
-            (!Utils::wildcardMultiMatch(filePattern, fileName, bCaseSensitive) ||
-             Utils::wildcardMultiMatch(fileAntiPattern, fileName, bCaseSensitive))) ||
-           (i->isDir() && Utils::wildcardMultiMatch(dirAntiPattern, fileName, bCaseSensitive)) ||
+        if((i->isFile() && (!fileMatcher.matches(fileName) || fileAntiMatcher.matches(fileName))) ||
+           (i->isDir() && dirAntiMatcher.matches(fileName)) ||
            (bUseCvsIgnore && cvsIgnoreList.matches(fileName, bCaseSensitive)))
         {
             // Remove it
@@ -845,7 +907,7 @@ void FileAccessJobHandler::slotStatResult(KJob* pJob)
 
         const KIO::UDSEntry e = static_cast<KIO::StatJob*>(pJob)->statResult();
 
-        m_pFileAccess->setFromUdsEntry(e, m_pFileAccess);
+        m_pFileAccess->setFromUdsEntry(e, m_pFileAccess->m_pParent);
     }
 
     ProgressProxy::exitEventLoop();
@@ -1079,6 +1141,9 @@ bool FileAccessJobHandler::copyFile(const QString& inDest)
     if(!m_pFileAccess->isNormal() || !dest.isNormal()) return false;
 
     int permissions = (m_pFileAccess->isExecutable() ? 0111 : 0) + (m_pFileAccess->isWritable() ? 0222 : 0) + (m_pFileAccess->isReadable() ? 0444 : 0);
+    if(m_pFileAccess->isLocal() && dest.isLocal())
+        return copyLocalFile(dest.absoluteFilePath(), permissions);
+
     m_bSuccess = false;
     KIO::FileCopyJob* pJob = KIO::file_copy(m_pFileAccess->url(), dest.url(), permissions, KIO::HideProgressInfo|KIO::Overwrite);
     chk_connect_a(pJob, &KIO::FileCopyJob::result, this, &FileAccessJobHandler::slotSimpleJobResult);
@@ -1090,8 +1155,283 @@ bool FileAccessJobHandler::copyFile(const QString& inDest)
     // Note that the KIO-slave preserves the original date, if this is supported.
 }
 
+// Bytes read and written at a time by copyLocalFile(), the system copies larger pieces.
+static const int maxCopyChunkSize = 1024 * 1024;
+static const size_t maxKernelCopyChunkSize = 64 * 1024 * 1024;
+
+static QFileDevice::Permissions toFilePermissions(int permissions)
+{
+    QFileDevice::Permissions filePermissions;
+    if(permissions & 0444)
+        filePermissions |= QFileDevice::ReadOwner | QFileDevice::ReadUser | QFileDevice::ReadGroup | QFileDevice::ReadOther;
+    if(permissions & 0222)
+        filePermissions |= QFileDevice::WriteOwner | QFileDevice::WriteUser | QFileDevice::WriteGroup | QFileDevice::WriteOther;
+    if(permissions & 0111)
+        filePermissions |= QFileDevice::ExeOwner | QFileDevice::ExeUser | QFileDevice::ExeGroup | QFileDevice::ExeOther;
+    return filePermissions;
+}
+
+enum e_KernelCopyResult
+{
+    eKernelCopyDone,
+    eKernelCopyUnsupported, // Nothing was written, the data has to be copied by reading and writing.
+    eKernelCopyFailed
+};
+
+/*
+    Lets the system copy the data of the open files, so it doesn't pass through KDiff3. A reflink
+    clone on Btrfs or XFS shares the blocks and copies nothing at all, elsewhere copy_file_range()
+    copies inside the kernel. sendfile() is taken on kernels that have neither. APFS clones are made
+    before the destination is opened, in copyLocalFile(). The macOS paths need ENABLE_NATIVE_COPY_MAC_WIN.
+*/
+static e_KernelCopyResult kernelCopy(QFile& srcFile, QFile& destFile)
+{
+#if defined(Q_OS_LINUX)
+    const int srcFd = srcFile.handle();
+    const int destFd = destFile.handle();
+#ifdef FICLONE
+    if(ioctl(destFd, FICLONE, srcFd) == 0)
+        return eKernelCopyDone;
+#endif
+
+    qint64 nofCopied = 0;
+    bool bUseSendFile = false;
+    for(;;)
+    {
+#ifdef __NR_copy_file_range
+        const ssize_t n = bUseSendFile ? sendfile(destFd, srcFd, nullptr, maxKernelCopyChunkSize)
+                                       : syscall(__NR_copy_file_range, srcFd, nullptr, destFd, nullptr, maxKernelCopyChunkSize, 0u);
+#else
+        const ssize_t n = sendfile(destFd, srcFd, nullptr, maxKernelCopyChunkSize);
+#endif
+        if(n == 0)
+            return eKernelCopyDone;
+
+        if(n > 0)
+        {
+            nofCopied += n;
+            continue;
+        }
+
+        if(errno == EINTR)
+            continue;
+        // Not supported between these files, only known if nothing was copied yet.
+        const bool bUnsupported = nofCopied == 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP || errno == EBADF);
+        if(!bUnsupported)
+            return eKernelCopyFailed;
+        if(bUseSendFile)
+            return eKernelCopyUnsupported;
+        bUseSendFile = true;
+    }
+#elif defined(NATIVE_COPY_DARWIN)
+    return fcopyfile(srcFile.handle(), destFile.handle(), nullptr, COPYFILE_DATA) == 0 ? eKernelCopyDone : eKernelCopyFailed;
+#else
+    Q_UNUSED(srcFile);
+    Q_UNUSED(destFile);
+    return eKernelCopyUnsupported;
+#endif
+}
+
+/*
+    Copies between local files without KIO and without an event loop, so folder merges can copy on
+    worker threads. The permissions and the modification time are set like the KIO file slave does.
+    The system copies the data where it can, otherwise it is read and written here.
+*/
+bool FileAccessJobHandler::copyLocalFile(const QString& destName, int permissions)
+{
+#if defined(NATIVE_COPY_WIN)
+    // Copies the modification time too, and clones where the file system can.
+    if(CopyFileExW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(m_pFileAccess->absoluteFilePath()).utf16()),
+                   reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(destName).utf16()), nullptr, nullptr, nullptr, 0))
+    {
+        if(QFile::setPermissions(destName, toFilePermissions(permissions)))
+            return true;
+    }
+#elif defined(NATIVE_COPY_DARWIN)
+    // A clone on APFS, which keeps the modification time. It needs a destination that doesn't exist yet.
+    if(copyfile(QFile::encodeName(m_pFileAccess->absoluteFilePath()).constData(), QFile::encodeName(destName).constData(), nullptr, COPYFILE_CLONE) == 0)
+    {
+        if(QFile::setPermissions(destName, toFilePermissions(permissions)))
+            return true;
+    }
+#endif
+
+    QFile srcFile(m_pFileAccess->absoluteFilePath());
+    if(!srcFile.open(QIODevice::ReadOnly))
+    {
+        m_pFileAccess->setStatusText(i18n("Opening %1 failed. %2", srcFile.fileName(), srcFile.errorString()));
+        return false;
+    }
+
+    QFile destFile(destName);
+    if(!destFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        m_pFileAccess->setStatusText(i18n("Opening %1 failed. %2", destName, destFile.errorString()));
+        return false;
+    }
+
+    const e_KernelCopyResult kernelCopyResult = kernelCopy(srcFile, destFile);
+    if(kernelCopyResult == eKernelCopyFailed)
+    {
+        const QString errorString = QString::fromLocal8Bit(strerror(errno));
+        m_pFileAccess->setStatusText(i18n("Error writing to %1. %2", destName, errorString));
+        return false;
+    }
+
+    QByteArray buffer(maxCopyChunkSize, Qt::Uninitialized);
+    while(kernelCopyResult == eKernelCopyUnsupported)
+    {
+        const qint64 nofRead = srcFile.read(buffer.data(), buffer.size());
+        if(nofRead < 0)
+        {
+            m_pFileAccess->setStatusText(i18n("Error reading from %1. %2", srcFile.fileName(), srcFile.errorString()));
+            return false;
+        }
+        if(nofRead == 0)
+            break;
+
+        if(destFile.write(buffer.constData(), nofRead) != nofRead)
+        {
+            m_pFileAccess->setStatusText(i18n("Error writing to %1. %2", destName, destFile.errorString()));
+            return false;
+        }
+    }
+
+    if(!destFile.flush() || !destFile.setPermissions(toFilePermissions(permissions)))
+    {
+        m_pFileAccess->setStatusText(i18n("Error writing to %1. %2", destName, destFile.errorString()));
+        return false;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    // Older Qt versions have no way to set it, the copy gets the current time then.
+    destFile.setFileTime(m_pFileAccess->lastModified(), QFileDevice::FileModificationTime);
+#endif
+    return true;
+}
+
+// Lists a subfolder for FileAccessJobHandler::listDir(), on a pool thread or inline.
+class ListSubDirRunnable : public QRunnable
+{
+  private:
+    FileAccess& m_dir;
+    t_DirectoryList& m_dirList;
+    bool m_bRecursive;
+    bool m_bFindHidden;
+    const QString& m_filePattern;
+    const QString& m_fileAntiPattern;
+    const QString& m_dirAntiPattern;
+    bool m_bFollowDirLinks;
+    bool m_bUseCvsIgnore;
+    QSemaphore& m_finished;
+
+  public:
+    ListSubDirRunnable(FileAccess& dir, t_DirectoryList& dirList, bool bRecursive, bool bFindHidden, const QString& filePattern,
+                       const QString& fileAntiPattern, const QString& dirAntiPattern, bool bFollowDirLinks, bool bUseCvsIgnore, QSemaphore& finished)
+        : m_dir(dir), m_dirList(dirList), m_bRecursive(bRecursive), m_bFindHidden(bFindHidden), m_filePattern(filePattern),
+          m_fileAntiPattern(fileAntiPattern), m_dirAntiPattern(dirAntiPattern), m_bFollowDirLinks(bFollowDirLinks), m_bUseCvsIgnore(bUseCvsIgnore),
+          m_finished(finished)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        m_dir.listDir(&m_dirList, m_bRecursive, m_bFindHidden, m_filePattern, m_fileAntiPattern, m_dirAntiPattern, m_bFollowDirLinks, m_bUseCvsIgnore);
+        m_finished.release();
+    }
+};
+
+#ifndef Q_OS_WIN
+static QDateTime modificationTime(const struct stat& status)
+{
+#ifdef Q_OS_DARWIN
+    return QDateTime::fromMSecsSinceEpoch(qint64(status.st_mtimespec.tv_sec) * 1000 + status.st_mtimespec.tv_nsec / 1000000);
+#else
+    return QDateTime::fromMSecsSinceEpoch(qint64(status.st_mtim.tv_sec) * 1000 + status.st_mtim.tv_nsec / 1000000);
+#endif
+}
+
+/*
+    Lists a local folder with readdir() and fstatat() relative to the open folder, so each entry
+    costs one stat call, two for links. The patterns are checked before any FileAccess is created
+    and the entries are left in the order of the file system.
+*/
+bool FileAccessJobHandler::scanLocalDirectory(const QString& dirName, t_DirectoryList* pDirList)
+{
+    DIR* pDir = opendir(QFile::encodeName(dirName).constData());
+    if(pDir == nullptr)
+        return false;
+
+    const int dirFd = dirfd(pDir);
+    const QString dirPrefix = dirName.endsWith('/') ? dirName : dirName + '/';
+    const WildcardMatcher fileMatcher(m_filePattern, true);
+    const WildcardMatcher fileAntiMatcher(m_fileAntiPattern, true);
+    const WildcardMatcher dirAntiMatcher(m_dirAntiPattern, true);
+    for(dirent* pEntry = readdir(pDir); pEntry != nullptr; pEntry = readdir(pDir))
+    {
+        const char* pName = pEntry->d_name;
+        if(strcmp(pName, ".") == 0 || strcmp(pName, "..") == 0 || (!m_bFindHidden && pName[0] == '.'))
+            continue;
+
+        struct stat linkStatus;
+        if(fstatat(dirFd, pName, &linkStatus, AT_SYMLINK_NOFOLLOW) != 0)
+            continue; // Removed in the meantime.
+
+        // Like QFileInfo everything but isSymLink() describes the target of a link.
+        const bool bSymLink = S_ISLNK(linkStatus.st_mode);
+        struct stat status = linkStatus;
+        const bool bExists = !bSymLink || fstatat(dirFd, pName, &status, 0) == 0;
+        if(!bExists)
+            status = linkStatus;
+
+        const bool bFile = bExists && S_ISREG(status.st_mode);
+        const bool bDir = bExists && S_ISDIR(status.st_mode);
+        const QString fileName = QFile::decodeName(pName);
+
+        // Same rules as in filterList().
+        if((bFile && (!fileMatcher.matches(fileName) || fileAntiMatcher.matches(fileName))) ||
+           (bDir && dirAntiMatcher.matches(fileName)))
+            continue;
+
+        pDirList->push_back(FileAccess());
+        FileAccess& fa = pDirList->back();
+
+        fa.m_fileInfo.setFile(dirPrefix + fileName);
+        fa.m_fileInfo.setCaching(true);
+        fa.m_pParent = m_pFileAccess;
+        fa.m_baseDir = m_pFileAccess->m_baseDir;
+        fa.m_name = fileName;
+
+        fa.m_bSymLink = bSymLink;
+        fa.m_bFile = bFile;
+        fa.m_bDir = bDir;
+        fa.m_bExists = bExists;
+        fa.m_size = bExists ? (qint64)status.st_size : 0;
+        fa.m_modificationTime = modificationTime(status);
+        fa.m_bHidden = pName[0] == '.';
+
+        if(bSymLink)
+        {
+            char target[PATH_MAX + 1];
+            const ssize_t len = readlinkat(dirFd, pName, target, PATH_MAX);
+            if(len > 0)
+            {
+                target[len] = '\0';
+                fa.m_linkTarget = QFile::decodeName(target);
+            }
+        }
+
+        fa.m_bValidData = true;
+    }
+
+    closedir(pDir);
+    return true;
+}
+#endif
+
 bool FileAccessJobHandler::listDir(t_DirectoryList* pDirList, bool bRecursive, bool bFindHidden, const QString& filePattern,
-                                   const QString& fileAntiPattern, const QString& dirAntiPattern, bool bFollowDirLinks, const bool bUseCvsIgnore)
+                                   const QString& fileAntiPattern, const QString& dirAntiPattern, bool bFollowDirLinks, const bool bUseCvsIgnore,
+                                   int maxNofRemoteListings)
 {
     ProgressProxyExtender pp;
     m_pDirList = pDirList;
@@ -1108,6 +1448,14 @@ bool FileAccessJobHandler::listDir(t_DirectoryList* pDirList, bool bRecursive, b
 
     pp.setInformation(i18n("Reading folder: %1", m_pFileAccess->absoluteFilePath()), 0, false);
 
+#ifndef Q_OS_WIN
+    const bool bScannedLocally = m_pFileAccess->isLocal();
+    if(bScannedLocally)
+    {
+        m_bSuccess = scanLocalDirectory(m_pFileAccess->absoluteFilePath(), pDirList);
+    }
+#else
+    const bool bScannedLocally = false;
     if(m_pFileAccess->isLocal())
     {
         m_bSuccess = true;
@@ -1144,57 +1492,158 @@ bool FileAccessJobHandler::listDir(t_DirectoryList* pDirList, bool bRecursive, b
             }
         }
     }
+#endif
     else
     {
-        KIO::ListJob* pListJob = nullptr;
-        pListJob = KIO::listDir(m_pFileAccess->url(), KIO::HideProgressInfo, true /*bFindHidden*/);
+        // The subfolders are listed along with the folder itself.
+        m_bSuccess = listRemoteDirs(bUseCvsIgnore, maxNofRemoteListings);
+        return m_bSuccess;
+    }
 
-        m_bSuccess = false;
-        if(pListJob != nullptr)
+    // The local scan already applied the patterns, only the cvsignore files are left.
+    if(!bScannedLocally || bUseCvsIgnore)
+        m_pFileAccess->filterList(pDirList, filePattern, fileAntiPattern, dirAntiPattern, bUseCvsIgnore);
+
+    if(bRecursive)
+    {
+        std::vector<FileAccess*> subDirs;
+        for(t_DirectoryList::iterator i = m_pDirList->begin(); i != m_pDirList->end(); ++i)
         {
-            chk_connect_a(pListJob, &KIO::ListJob::entries, this, &FileAccessJobHandler::slotListDirProcessNewEntries);
-            chk_connect_a(pListJob, &KIO::ListJob::result, this, &FileAccessJobHandler::slotSimpleJobResult);
+            if(i->isDir() && (!i->isSymLink() || m_bFollowDirLinks))
+                subDirs.push_back(&*i);
+        }
 
-            chk_connect_a(pListJob, &KIO::ListJob::infoMessage, &pp, &ProgressProxyExtender::slotListDirInfoMessage);
+        // Local subfolders are listed on idle pool threads, nested listings do the same.
+        std::vector<t_DirectoryList> subDirLists(subDirs.size());
+        // Every listing releases it once, also the ones listed here.
+        QSemaphore finishedListings;
+        for(size_t i = 0; i < subDirs.size(); ++i)
+        {
+            ListSubDirRunnable* pRunnable = new ListSubDirRunnable(*subDirs[i], subDirLists[i], bRecursive, bFindHidden, filePattern, fileAntiPattern,
+                                                                   dirAntiPattern, bFollowDirLinks, bUseCvsIgnore, finishedListings);
+            startOrRunHere(pRunnable, i + 1 == subDirs.size());
+        }
 
-            // This line makes the transfer via fish unreliable.:-(
-            /*if(m_pFileAccess->url().scheme() != QLatin1Literal("fish")){
-                chk_connect_a( pListJob, static_cast<void (KIO::ListJob::*)(KJob*,qint64)>(&KIO::ListJob::percent), &pp, &ProgressProxyExtender::slotPercent);
-            }*/
+        // wasCancelled() keeps processing events on the GUI thread.
+        while(!finishedListings.tryAcquire((int)subDirs.size(), 100))
+            pp.wasCancelled();
 
-            ProgressProxy::enterEventLoop(pListJob,
-                                          i18n("Listing directory: %1", m_pFileAccess->prettyAbsPath()));
-        }
+        // append data onto the main list
+        for(t_DirectoryList& dirList: subDirLists)
+            m_pDirList->splice(m_pDirList->end(), dirList);
     }
 
-    m_pFileAccess->filterList(pDirList, filePattern, fileAntiPattern, dirAntiPattern, bUseCvsIgnore);
+    return m_bSuccess;
+}
 
-    if(bRecursive)
+/*
+    Lists a remote folder and, if recursive, all its subfolders with up to maxNofListings KIO jobs at
+    once. The entries of a listing contain all that is needed, nothing is stat'ed again.
+    Finished listings are filtered here and not in the job slots, because reading a .cvsignore file
+    runs a job of its own. The result has the same order as listing one folder after the other.
+*/
+bool FileAccessJobHandler::listRemoteDirs(const bool bUseCvsIgnore, int maxNofListings)
+{
+    ProgressProxyExtender pp;
+    maxNofListings = std::max(maxNofListings, 1);
+
+    m_remoteListings.clear();
+    m_runningListings.clear();
+    m_finishedListings.clear();
+    m_remoteListings.push_back(RemoteListing{m_pFileAccess, t_DirectoryList(), std::vector<size_t>()});
+
+    m_bSuccess = false;
+    size_t nofStartedListings = 0;
+    size_t nofFilteredListings = 0;
+    while(nofFilteredListings < m_remoteListings.size() && !pp.wasCancelled())
     {
-        t_DirectoryList::iterator i;
-        t_DirectoryList subDirsList;
+        while(nofStartedListings < m_remoteListings.size() && m_runningListings.size() < maxNofListings)
+            startRemoteListing(nofStartedListings++, pp);
 
-        for(i = m_pDirList->begin(); i != m_pDirList->end(); ++i)
+        if(m_finishedListings.isEmpty())
         {
-            if(i->isDir() && (!i->isSymLink() || m_bFollowDirLinks))
-            {
-                t_DirectoryList dirList;
-                i->listDir(&dirList, bRecursive, bFindHidden,
-                           filePattern, fileAntiPattern, dirAntiPattern, bFollowDirLinks, bUseCvsIgnore);
+            if(m_runningListings.isEmpty())
+                break; // No job could be started.
+
+            m_bWaitingForListings = true;
+            ProgressProxy::enterEventLoop(m_runningListings.constBegin().key(),
+                                          i18n("Listing directory: %1", m_remoteListings[m_runningListings.constBegin().value()].pDir->prettyAbsPath()));
+            m_bWaitingForListings = false;
+        }
+
+        while(!m_finishedListings.isEmpty())
+        {
+            const size_t index = m_finishedListings.dequeue();
+            RemoteListing& listing = m_remoteListings[index];
+            ++nofFilteredListings;
+
+            listing.pDir->filterList(&listing.entries, m_filePattern, m_fileAntiPattern, m_dirAntiPattern, bUseCvsIgnore);
+            if(!m_bRecursive)
+                continue;
 
-                // append data onto the main list
-                subDirsList.splice(subDirsList.end(), dirList);
+            for(FileAccess& entry: listing.entries)
+            {
+                if(entry.isDir() && (!entry.isSymLink() || m_bFollowDirLinks))
+                {
+                    listing.subListings.push_back(m_remoteListings.size());
+                    m_remoteListings.push_back(RemoteListing{&entry, t_DirectoryList(), std::vector<size_t>()});
+                }
             }
         }
+    }
 
-        m_pDirList->splice(m_pDirList->end(), subDirsList);
+    if(!m_runningListings.isEmpty())
+    {
+        // Cancelled, the job given to the progress dialog must not be killed twice.
+        ProgressProxy::exitEventLoop();
+        for(QHash<KJob*, size_t>::const_iterator it = m_runningListings.constBegin(); it != m_runningListings.constEnd(); ++it)
+            it.key()->kill(KJob::Quietly);
+        m_runningListings.clear();
     }
 
+    appendRemoteListings(0, m_pDirList);
+    m_remoteListings.clear();
+    m_finishedListings.clear();
+    // Only the listing of the folder itself decides about success, like for local folders.
     return m_bSuccess;
 }
 
-void FileAccessJobHandler::slotListDirProcessNewEntries(KIO::Job*, const KIO::UDSEntryList& l)
+void FileAccessJobHandler::startRemoteListing(size_t listing, ProgressProxyExtender& pp)
+{
+    KIO::ListJob* pListJob = KIO::listDir(m_remoteListings[listing].pDir->url(), KIO::HideProgressInfo, true /*bFindHidden*/);
+    if(pListJob == nullptr)
+    {
+        m_finishedListings.enqueue(listing);
+        return;
+    }
+
+    m_runningListings.insert(pListJob, listing);
+    chk_connect_a(pListJob, &KIO::ListJob::entries, this, &FileAccessJobHandler::slotListDirProcessNewEntries);
+    chk_connect_a(pListJob, &KIO::ListJob::result, this, &FileAccessJobHandler::slotListDirResult);
+
+    chk_connect_a(pListJob, &KIO::ListJob::infoMessage, &pp, &ProgressProxyExtender::slotListDirInfoMessage);
+
+    // This line makes the transfer via fish unreliable.:-(
+    /*if(m_pFileAccess->url().scheme() != QLatin1Literal("fish")){
+        chk_connect_a( pListJob, static_cast<void (KIO::ListJob::*)(KJob*,qint64)>(&KIO::ListJob::percent), &pp, &ProgressProxyExtender::slotPercent);
+    }*/
+}
+
+// Moves the entries of a listing and then those of its subfolders to the end of pDirList.
+void FileAccessJobHandler::appendRemoteListings(size_t listing, t_DirectoryList* pDirList)
 {
+    pDirList->splice(pDirList->end(), m_remoteListings[listing].entries);
+    for(size_t subListing: m_remoteListings[listing].subListings)
+        appendRemoteListings(subListing, pDirList);
+}
+
+void FileAccessJobHandler::slotListDirProcessNewEntries(KIO::Job* pJob, const KIO::UDSEntryList& l)
+{
+    QHash<KJob*, size_t>::const_iterator it = m_runningListings.constFind(pJob);
+    if(it == m_runningListings.constEnd())
+        return;
+
+    RemoteListing& listing = m_remoteListings[it.value()];
     //This function is called for non-local urls. Don't use QUrl::fromLocalFile here as it does not handle these.
     KIO::UDSEntryList::ConstIterator i;
     for(i = l.begin(); i != l.end(); ++i)
@@ -1202,17 +1651,116 @@ void FileAccessJobHandler::slotListDirProcessNewEntries(KIO::Job*, const KIO::UD
         const KIO::UDSEntry& e = *i;
         FileAccess fa;
 
-        fa.setFromUdsEntry(e, m_pFileAccess);
+        fa.setFromUdsEntry(e, listing.pDir);
 
         //must be manually filtered KDE does not supply API for ignoring these.
         if(fa.fileName() != "." && fa.fileName() != "..")
-        {
-            //quick fix to preserve behavoir without creating invalid urls. TODO: look for altertive machanism for use with next major release.
-            fa.setFile(fa.url());
+            listing.entries.push_back(fa);
+    }
+}
 
-            m_pDirList->push_back(fa);
-        }
+void FileAccessJobHandler::slotListDirResult(KJob* pJob)
+{
+    QHash<KJob*, size_t>::iterator it = m_runningListings.find(pJob);
+    if(it == m_runningListings.end())
+        return;
+
+    const size_t listing = it.value();
+    m_runningListings.erase(it);
+
+    if(pJob->error() != KJob::NoError)
+        pJob->uiDelegate()->showErrorMessage();
+    else if(listing == 0)
+        m_bSuccess = true;
+
+    m_finishedListings.enqueue(listing);
+    // While a .cvsignore file is read the event loop belongs to that job.
+    if(m_bWaitingForListings)
+        ProgressProxy::exitEventLoop();
+}
+
+RemoteFetch::~RemoteFetch()
+{
+    for(QHash<KJob*, int>::const_iterator it = m_runningJobs.constBegin(); it != m_runningJobs.constEnd(); ++it)
+        it.key()->kill(KJob::Quietly);
+}
+
+int RemoteFetch::start(const FileAccess& file)
+{
+    const int index = m_fetches.size();
+    m_fetches.push_back(Fetch{file.prettyAbsPath(), QByteArray(), QString()});
+    m_fetches.back().data.reserve((int)std::min<qint64>(file.size(), TYPE_MAX(int)));
+
+    KIO::TransferJob* pJob = KIO::get(file.url(), KIO::NoReload, KIO::HideProgressInfo);
+    m_runningJobs.insert(pJob, index);
+    chk_connect_a(pJob, &KIO::TransferJob::data, this, &RemoteFetch::slotData);
+    chk_connect_a(pJob, &KIO::TransferJob::result, this, &RemoteFetch::slotResult);
+    return index;
+}
+
+int RemoteFetch::waitForNext()
+{
+    ProgressProxyExtender pp;
+    while(m_finished.isEmpty() && !m_runningJobs.isEmpty())
+    {
+        m_bWaiting = true;
+        ProgressProxy::enterEventLoop(m_runningJobs.constBegin().key(), i18n("Reading file: %1", m_fetches[m_runningJobs.constBegin().value()].name));
+        m_bWaiting = false;
+
+        if(m_finished.isEmpty() && pp.wasCancelled())
+            cancel();
+    }
+
+    return m_finished.isEmpty() ? -1 : m_finished.dequeue();
+}
+
+QByteArray RemoteFetch::takeData(int index)
+{
+    QByteArray data;
+    data.swap(m_fetches[index].data);
+    // Empty files are data too.
+    return data.isNull() ? QByteArray("") : data;
+}
+
+void RemoteFetch::slotData(KIO::Job* pJob, const QByteArray& data)
+{
+    QHash<KJob*, int>::const_iterator it = m_runningJobs.constFind(pJob);
+    if(it != m_runningJobs.constEnd())
+        m_fetches[it.value()].data += data;
+}
+
+void RemoteFetch::slotResult(KJob* pJob)
+{
+    QHash<KJob*, int>::iterator it = m_runningJobs.find(pJob);
+    if(it == m_runningJobs.end())
+        return;
+
+    const int index = it.value();
+    m_runningJobs.erase(it);
+    if(pJob->error() != KJob::NoError)
+    {
+        m_fetches[index].data = QByteArray();
+        m_fetches[index].errorString = i18n("Reading %1 failed. %2", m_fetches[index].name, pJob->errorString());
+    }
+
+    m_finished.enqueue(index);
+    if(m_bWaiting)
+        ProgressProxy::exitEventLoop();
+}
+
+// The files not complete yet are returned by waitForNext() with an error.
+void RemoteFetch::cancel()
+{
+    // The job given to the progress dialog must not be killed twice.
+    ProgressProxy::exitEventLoop();
+    for(QHash<KJob*, int>::const_iterator it = m_runningJobs.constBegin(); it != m_runningJobs.constEnd(); ++it)
+    {
+        it.key()->kill(KJob::Quietly);
+        m_fetches[it.value()].data = QByteArray();
+        m_fetches[it.value()].errorString = i18n("Reading %1 was cancelled.", m_fetches[it.value()].name);
+        m_finished.enqueue(it.value());
     }
+    m_runningJobs.clear();
 }
 
 //#include "fileaccess.moc"
@@ -13,20 +13,26 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QDateTime>
+#include <QHash>
+#include <QQueue>
 #include <QSharedPointer>
 #include <QTemporaryFile>
 #include <QUrl>
+#include <QVector>
 
 #include <KIO/UDSEntry>
 #include <KJob>
 
+#include <deque>
 #include <type_traits>
+#include <vector>
 
 namespace KIO {
 class Job;
 }
 
 class t_DirectoryList;
+class ProgressProxyExtender;
 
 class FileAccess
 {
@@ -68,7 +74,8 @@ class FileAccess
     bool writeFile(const void* pSrcBuffer, qint64 length);
     bool listDir(t_DirectoryList* pDirList, bool bRecursive, bool bFindHidden,
                  const QString& filePattern, const QString& fileAntiPattern,
-                 const QString& dirAntiPattern, bool bFollowDirLinks, bool bUseCvsIgnore);
+                 const QString& dirAntiPattern, bool bFollowDirLinks, bool bUseCvsIgnore,
+                 int maxNofRemoteListings = 1);
     bool copyFile(const QString& destUrl);
     bool createBackup(const QString& bakExtension);
 
@@ -104,6 +111,9 @@ class FileAccess
 
     const QString& errorString() const;
 
+    // The entry itself with its names, see MemoryUsage.
+    qint64 memoryUsage() const;
+
   private:
     friend class FileAccessJobHandler;
     void setFromUdsEntry(const KIO::UDSEntry& e, FileAccess* parent);
@@ -113,7 +123,12 @@ class FileAccess
 
     bool interruptableReadFile(void* pDestBuffer, qint64 maxLength);
 
-    QUrl m_url;
+    bool isOpen() const;
+    bool hasLocalFile() const;
+    QFile& localFile();
+    QTemporaryFile& tempFile();
+
+    QUrl m_url; // Empty for the local entries of a listing, see url().
     bool m_bValidData = false;
 
     //long m_fileType; // for testing only
@@ -124,8 +139,9 @@ class FileAccess
     QString m_linkTarget;
     QString m_name;
     QString m_localCopy;
-    QSharedPointer<QTemporaryFile> tmpFile = QSharedPointer<QTemporaryFile>::create();
-    QSharedPointer<QFile> realFile = nullptr;
+    // Made on first use by tempFile() and localFile(), most entries of a listing are never opened.
+    QSharedPointer<QTemporaryFile> tmpFile;
+    QSharedPointer<QFile> realFile;
 
     qint64 m_size = 0;
     QDateTime m_modificationTime = QDateTime::fromMSecsSinceEpoch(0);
@@ -146,6 +162,14 @@ static_assert(std::is_move_constructible<FileAccess>::value, "FileAccess must be
 
 class t_DirectoryList : public std::list<FileAccess>
 {
+  public:
+    qint64 memoryUsage() const
+    {
+        qint64 bytes = (qint64)size() * (qint64)(2 * sizeof(void*));
+        for(const FileAccess& fileAccess: *this)
+            bytes += fileAccess.memoryUsage();
+        return bytes;
+    }
 };
 
 class FileAccessJobHandler : public QObject
@@ -161,7 +185,8 @@ class FileAccessJobHandler : public QObject
     bool rename(const FileAccess& dest);
     bool listDir(t_DirectoryList* pDirList, bool bRecursive, bool bFindHidden,
                  const QString& filePattern, const QString& fileAntiPattern,
-                 const QString& dirAntiPattern, bool bFollowDirLinks, bool bUseCvsIgnore);
+                 const QString& dirAntiPattern, bool bFollowDirLinks, bool bUseCvsIgnore,
+                 int maxNofRemoteListings = 1);
     bool mkDir(const QString& dirName);
     bool rmDir(const QString& dirName);
     bool removeFile(const QUrl& fileName);
@@ -184,7 +209,25 @@ class FileAccessJobHandler : public QObject
     bool m_bRecursive = false;
     bool m_bFollowDirLinks = false;
 
+    // A remote folder whose listing was started, see listRemoteDirs().
+    struct RemoteListing
+    {
+        FileAccess* pDir;
+        t_DirectoryList entries;
+        std::vector<size_t> subListings; // Indexes of the listings of the subfolders in entries.
+    };
+
+    // The deque keeps the addresses of the entries, the listings of subfolders point to them.
+    std::deque<RemoteListing> m_remoteListings;
+    QHash<KJob*, size_t> m_runningListings;
+    QQueue<size_t> m_finishedListings;
+    bool m_bWaitingForListings = false;
+
     bool scanLocalDirectory(const QString& dirName, t_DirectoryList* dirList);
+    bool listRemoteDirs(const bool bUseCvsIgnore, int maxNofListings);
+    void startRemoteListing(size_t listing, ProgressProxyExtender& pp);
+    void appendRemoteListings(size_t listing, t_DirectoryList* pDirList);
+    bool copyLocalFile(const QString& destName, int permissions);
 
   private Q_SLOTS:
     void slotStatResult(KJob*);
@@ -194,7 +237,48 @@ class FileAccessJobHandler : public QObject
     void slotGetData(KJob*, const QByteArray&);
     void slotPutData(KIO::Job*, QByteArray&);
 
-    void slotListDirProcessNewEntries(KIO::Job*, const KIO::UDSEntryList& l);
+    void slotListDirProcessNewEntries(KIO::Job* pJob, const KIO::UDSEntryList& l);
+    void slotListDirResult(KJob* pJob);
+};
+
+/*
+    Reads remote files into memory with a KIO::get() job each, all at the same time. Unlike
+    FileAccess::createLocalCopy() nothing is written to a temporary file, and waitForNext() returns
+    as soon as any file is complete so it can be decoded while the others still transfer.
+    KIO only works on the GUI thread.
+*/
+class RemoteFetch : public QObject
+{
+    Q_OBJECT
+  public:
+    ~RemoteFetch() override;
+
+    // Returns the index of the file for the other functions.
+    int start(const FileAccess& file);
+    // Processes events until a file is complete and returns its index, or -1 when all were returned.
+    int waitForNext();
+    // Empty if reading the file succeeded.
+    const QString& errorString(int index) const { return m_fetches[index].errorString; }
+    QByteArray takeData(int index);
+
+  private Q_SLOTS:
+    void slotData(KIO::Job* pJob, const QByteArray& data);
+    void slotResult(KJob* pJob);
+
+  private:
+    struct Fetch
+    {
+        QString name;
+        QByteArray data;
+        QString errorString;
+    };
+
+    void cancel();
+
+    QVector<Fetch> m_fetches;
+    QHash<KJob*, int> m_runningJobs;
+    QQueue<int> m_finished;
+    bool m_bWaiting = false;
 };
 
 #endif
@@ -33,18 +33,6 @@
 #include <stdlib.h>
 
 
-static GNULineRef *xvec, *yvec;  /* Vectors being compared. */
-static GNULineRef *fdiag;        /* Vector, indexed by diagonal, containing
-                   1 + the X coordinate of the point furthest
-                   along the given diagonal in the forward
-                   search of the edit matrix. */
-static GNULineRef *bdiag;        /* Vector, indexed by diagonal, containing
-                   the X coordinate of the point furthest
-                   along the given diagonal in the backward
-                   search of the edit matrix. */
-static GNULineRef too_expensive; /* Edit scripts longer than this are too
-                   expensive to compute.  */
-
 #define SNAKE_LIMIT 20 /* Snakes bigger than this are considered `big'.  */
 
 struct partition {
@@ -84,8 +72,18 @@ struct partition {
    the worst this can do is cause suboptimal diff output.
    It cannot cause incorrect diff output.  */
 
+/* True if more than 1/FRACTION of the time budget is used up.  (KDiff3)  */
+bool GnuDiff::budget_used_up(qint64 fraction)
+{
+    if(time_limit <= 0 || budget_timer.elapsed() * fraction < time_limit)
+        return false;
+
+    budget_exceeded = true;
+    return true;
+}
+
 GNULineRef GnuDiff::diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal,
-                         partition *part) const
+                         partition *part)
 {
     GNULineRef *const fd = fdiag;        /* Give the compiler a chance. */
     GNULineRef *const bd = bdiag;        /* Additional help for the compiler. */
@@ -163,7 +161,7 @@ GNULineRef GnuDiff::diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
             }
         }
 
-        if(find_minimal)
+        if(find_minimal && !budget_used_up(2))
             continue;
 
         /* Heuristic: check occasionally for a diagonal that has made
@@ -247,7 +245,7 @@ GNULineRef GnuDiff::diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
 
         /* Heuristic: if we've gone well beyond the call of duty,
      give up and report halfway between our best results so far.  */
-        if(c >= too_expensive)
+        if(c >= too_expensive || budget_used_up(1))
         {
             GNULineRef fxybest, fxbest;
             GNULineRef bxybest, bxbest;
@@ -342,6 +340,16 @@ void GnuDiff::compareseq(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
         GNULineRef c;
         partition part;
 
+        /* Out of time: treat everything between the common start and end as changed.  (KDiff3)  */
+        if(budget_used_up(1))
+        {
+            while(xoff < xlim)
+                files[0].changed[files[0].realindexes[xoff++]] = true;
+            while(yoff < ylim)
+                files[1].changed[files[1].realindexes[yoff++]] = true;
+            return;
+        }
+
         /* Find a point of correspondence in the middle of the files.  */
 
         c = diag(xoff, xlim, yoff, ylim, find_minimal, &part);
@@ -378,7 +386,7 @@ void GnuDiff::discard_confusing_lines(file_data filevec[])
     GNULineRef *p;
 
     /* Allocate our results.  */
-    p = (GNULineRef *)xmalloc((filevec[0].buffered_lines + filevec[1].buffered_lines) * (2 * sizeof(*p)));
+    p = (GNULineRef *)scratch_alloc(undiscarded_space, (filevec[0].buffered_lines + filevec[1].buffered_lines) * (2 * sizeof(*p)));
     for(f = 0; f < 2; ++f)
     {
         filevec[f].undiscarded = p;
@@ -390,7 +398,7 @@ void GnuDiff::discard_confusing_lines(file_data filevec[])
     /* Set up equiv_count[F][I] as the number of lines in file F
      that fall in equivalence class I.  */
 
-    p = (GNULineRef *)zalloc(filevec[0].equiv_max * (2 * sizeof(*p)));
+    p = (GNULineRef *)scratch_zalloc(equiv_count_space, filevec[0].equiv_max * (2 * sizeof(*p)));
     equiv_count[0] = p;
     equiv_count[1] = p + filevec[0].equiv_max;
 
@@ -401,7 +409,7 @@ void GnuDiff::discard_confusing_lines(file_data filevec[])
 
     /* Set up tables of which lines are going to be discarded.  */
 
-    discarded[0] = (char *)zalloc(filevec[0].buffered_lines + filevec[1].buffered_lines);
+    discarded[0] = (char *)scratch_zalloc(discarded_space, filevec[0].buffered_lines + filevec[1].buffered_lines);
     discarded[1] = discarded[0] + filevec[0].buffered_lines;
 
     /* Mark to be discarded each line that matches no line of the other file.
@@ -562,9 +570,6 @@ void GnuDiff::discard_confusing_lines(file_data filevec[])
                 filevec[f].changed[i] = true;
         filevec[f].nondiscarded_lines = j;
     }
-
-    free(discarded[0]);
-    free(equiv_count[0]);
 }
 
 /* Adjust inserts/deletes of identical lines to join changes
@@ -768,6 +773,9 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
     int f;
     change *script;
 
+    budget_exceeded = false;
+    budget_timer.start();
+
     read_files(cmp->file, files_can_be_treated_as_binary);
 
     {
@@ -777,9 +785,9 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
      Allocate an extra element, always 0, at each end of each vector.  */
 
         size_t s = cmp->file[0].buffered_lines + cmp->file[1].buffered_lines + 4;
-        bool *flag_space = (bool *)zalloc(s * sizeof(*flag_space));
-        cmp->file[0].changed = flag_space + 1;
-        cmp->file[1].changed = flag_space + cmp->file[0].buffered_lines + 3;
+        bool *flags = (bool *)scratch_zalloc(flag_space, s * sizeof(*flags));
+        cmp->file[0].changed = flags + 1;
+        cmp->file[1].changed = flags + cmp->file[0].buffered_lines + 3;
 
         /* Some lines are obviously insertions or deletions
      because they don't match anything.  Detect them now, and
@@ -793,7 +801,7 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
         xvec = cmp->file[0].undiscarded;
         yvec = cmp->file[1].undiscarded;
         diags = (cmp->file[0].nondiscarded_lines + cmp->file[1].nondiscarded_lines + 3);
-        fdiag = (GNULineRef *)xmalloc(diags * (2 * sizeof(*fdiag)));
+        fdiag = (GNULineRef *)scratch_alloc(diag_space, diags * (2 * sizeof(*fdiag)));
         bdiag = fdiag + diags;
         fdiag += cmp->file[1].nondiscarded_lines + 1;
         bdiag += cmp->file[1].nondiscarded_lines + 1;
@@ -811,8 +819,6 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
         compareseq(0, cmp->file[0].nondiscarded_lines,
                    0, cmp->file[1].nondiscarded_lines, minimal);
 
-        free(fdiag - (cmp->file[1].nondiscarded_lines + 1));
-
         /* Modify the results slightly to make them prettier
      in cases where that can validly be done.  */
 
@@ -823,10 +829,6 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
 
         script = build_script(cmp->file);
 
-        free(cmp->file[0].undiscarded);
-
-        free(flag_space);
-
         for(f = 0; f < 2; ++f)
         {
             free(cmp->file[f].equivs);
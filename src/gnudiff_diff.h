@@ -29,6 +29,7 @@
 
 #include <stdio.h>
 
+#include <QElapsedTimer>
 #include <QString>
 #include <QtGlobal>
 
@@ -38,17 +39,24 @@ typedef qint64 GNULineRef;
 static_assert(std::is_signed<GNULineRef>::value, "GNULineRef must be signed.");
 static_assert(sizeof(GNULineRef) >= sizeof(size_t), "GNULineRef must be able to receive size_t values.");
 
+/* All state of a comparison lives in the GnuDiff object, so that separate
+   objects can be used on several threads at the same time.  (KDiff3)  */
 class GnuDiff
 {
   public:
+    GnuDiff() = default;
+    GnuDiff(const GnuDiff &) = delete;
+    GnuDiff &operator=(const GnuDiff &) = delete;
+    ~GnuDiff();
+
     /* Variables for command line options */
 
     /* Nonzero if output cannot be generated for identical files.  */
-    bool no_diff_means_no_output;
+    bool no_diff_means_no_output = false;
 
     /* Number of lines of context to show in each set of diffs.
    This is zero when context is not to be shown.  */
-    GNULineRef context;
+    GNULineRef context = 0;
 
     /* The significance of white space during comparisons.  */
     enum
@@ -64,26 +72,35 @@ class GnuDiff
 
         /* Ignore all horizontal white space (-w).  */
         IGNORE_ALL_SPACE
-    } ignore_white_space;
+    } ignore_white_space = IGNORE_NO_WHITE_SPACE;
 
     /* Ignore changes that affect only numbers. (J. Eibl)  */
-    bool bIgnoreNumbers;
-    bool bIgnoreWhiteSpace;
+    bool bIgnoreNumbers = false;
+    bool bIgnoreWhiteSpace = false;
 
     /* Files can be compared byte-by-byte, as if they were binary.
    This depends on various options.  */
-    bool files_can_be_treated_as_binary;
+    bool files_can_be_treated_as_binary = false;
 
     /* Ignore differences in case of letters (-i).  */
-    bool ignore_case;
+    bool ignore_case = false;
 
     /* Use heuristics for better speed with large files with a small
    density of changes.  */
-    bool speed_large_files;
+    bool speed_large_files = false;
 
     /* Don't discard lines.  This makes things slower (sometimes much
    slower) but will find a guaranteed minimal set of changes.  */
-    bool minimal;
+    bool minimal = false;
+
+    /* Time budget of one comparison in milliseconds, 0 means no limit.
+   Once half of it is used up the search continues as without --minimal,
+   once all of it is used up the remaining parts are only matched at their
+   common start and end.  (KDiff3)  */
+    qint64 time_limit = 0;
+
+    /* Set by diff_2_files if the time budget made the result worse.  (KDiff3)  */
+    bool budget_exceeded = false;
 
     /* The result of comparison is an "edit script": a chain of `struct change'.
    Each `struct change' represents one place where some lines are deleted
@@ -110,18 +127,19 @@ class GnuDiff
     /* Data on one input file being compared.  */
 
     struct file_data {
-        /* Buffer in which text of file is read.  */
-        const QChar *buffer;
+        /* Buffer in which text of file is read.  UTF-16 (QChar), or Latin-1
+       (char) with one byte per character if latin1 is set.  (KDiff3)  */
+        const void *buffer;
+        bool latin1;
 
-        /* Allocated size of buffer, in QChars.  Always a multiple of
-       sizeof(*buffer).  */
+        /* Allocated size of buffer, in characters.  */
         size_t bufsize;
 
-        /* Number of valid bytes now in the buffer.  */
+        /* Number of valid characters now in the buffer.  */
         size_t buffered;
 
-        /* Array of pointers to lines in the file.  */
-        const QChar **linbuf;
+        /* Array of offsets in buffer of the lines in the file.  */
+        size_t *linbuf;
 
         /* linbuf_base <= buffered_lines <= valid_lines <= alloc_lines.
        linebuf[linbuf_base ... buffered_lines - 1] are possibly differing.
@@ -129,15 +147,15 @@ class GnuDiff
        linebuf[linbuf_base ... alloc_lines - 1] are allocated.  */
         GNULineRef linbuf_base, buffered_lines, valid_lines, alloc_lines;
 
-        /* Pointer to end of prefix of this file to ignore when hashing.  */
-        const QChar *prefix_end;
+        /* Offset of the end of prefix of this file to ignore when hashing.  */
+        size_t prefix_end;
 
         /* Count of lines in the prefix.
        There are this many lines in the file before linbuf[0].  */
         GNULineRef prefix_lines;
 
-        /* Pointer to start of suffix of this file to ignore when hashing.  */
-        const QChar *suffix_begin;
+        /* Offset of the start of suffix of this file to ignore when hashing.  */
+        size_t suffix_begin;
 
         /* Vector, indexed by line number, containing an equivalence code for
        each line.  It is this vector that is actually compared with that
@@ -166,6 +184,11 @@ class GnuDiff
         /* 1 more than the maximum equivalence value used for this or its
        sibling file.  */
         GNULineRef equiv_max;
+
+        /* Optional precomputed line_hash() of every line in buffer, indexed
+       by line number.  Only used with IGNORE_ALL_SPACE and without
+       ignore_case.  (KDiff3)  */
+        const size_t *line_hashes;
     };
 
     /* Data on two input files being compared.  */
@@ -187,12 +210,82 @@ class GnuDiff
     bool read_files(file_data[], bool);
 
     /* util.c */
-    bool lines_differ(const QChar *, size_t, const QChar *, size_t);
+    /* For UTF-16 (QChar) and Latin-1 (char) text in any combination.  (KDiff3)  */
+    template <typename Char1, typename Char2>
+    bool lines_differ(const Char1 *, size_t, const Char2 *, size_t);
     void *zalloc(size_t);
 
+    /* Hash of a line as find_and_hash_each_line computes it for IGNORE_ALL_SPACE
+   without ignore_case.  Latin-1 text hashes the same as its UTF-16 form.  (KDiff3)  */
+    template <typename Char>
+    static size_t line_hash(const Char *line, size_t length, bool ignoreNumbers);
+
   private:
+    /* Lines are put into equivalence classes of lines that match in lines_differ.
+   Each equivalence class is represented by one of these structures,
+   but only while the classes are being computed.
+   Afterward, each class is represented by a number.  */
+    struct equivclass {
+        GNULineRef next;   /* Next item in this bucket.  */
+        size_t hash;       /* Hash of lines in this class.  */
+        const file_data *file; /* The file of a line that fits this class.  */
+        size_t line;           /* That line's offset in the buffer of file.  */
+        size_t length;         /* That line's length, not counting its newline.  */
+    };
+
+    /* Work space that is kept from one diff_2_files call to the next,
+   so that repeated comparisons need not allocate it again.  (KDiff3)  */
+    struct scratch_buffer {
+        void *data = nullptr;
+        size_t size = 0;
+    };
+
+    /* gnudiff_io.cpp */
+
+    /* Hash-table: array of buckets, each being a chain of equivalence classes.
+   buckets[-1] is reserved for incomplete lines.  */
+    GNULineRef *buckets = nullptr;
+
+    /* Number of buckets in the hash table array, not counting buckets[-1].  */
+    size_t nbuckets = 0;
+
+    /* Array in which the equivalence classes are allocated.
+   The bucket-chains go through the elements in this array.
+   The number of an equivalence class is its index in this array.  */
+    equivclass *equiv_classes = nullptr;
+
+    /* Index of first free element in the array `equiv_classes'.  */
+    GNULineRef equivs_index = 0;
+
+    /* Number of elements allocated in the array `equiv_classes'.  */
+    GNULineRef equivs_alloc = 0;
+
+    /* gnudiff_analyze.cpp */
+
+    GNULineRef *xvec = nullptr, *yvec = nullptr; /* Vectors being compared. */
+    GNULineRef *fdiag = nullptr;                 /* Vector, indexed by diagonal, containing
+                   1 + the X coordinate of the point furthest
+                   along the given diagonal in the forward
+                   search of the edit matrix. */
+    GNULineRef *bdiag = nullptr;                 /* Vector, indexed by diagonal, containing
+                   the X coordinate of the point furthest
+                   along the given diagonal in the backward
+                   search of the edit matrix. */
+    GNULineRef too_expensive = 0;                /* Edit scripts longer than this are too
+                   expensive to compute.  */
+    QElapsedTimer budget_timer;                  /* Started by diff_2_files for time_limit. */
+
+    scratch_buffer buckets_space;
+    scratch_buffer equivs_space;
+    scratch_buffer flag_space;
+    scratch_buffer diag_space;
+    scratch_buffer undiscarded_space;
+    scratch_buffer equiv_count_space;
+    scratch_buffer discarded_space;
+
     // gnudiff_analyze.cpp
-    GNULineRef diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal, struct partition *part) const;
+    GNULineRef diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal, struct partition *part);
+    bool budget_used_up(qint64 fraction);
     void compareseq(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal);
     void discard_confusing_lines(file_data filevec[]);
     void shift_boundaries(file_data filevec[]);
@@ -203,17 +296,39 @@ class GnuDiff
     // gnudiff_io.cpp
     GNULineRef guess_lines(GNULineRef n, size_t s, size_t t);
     void find_and_hash_each_line(file_data *current);
+    template <typename Char>
+    void find_and_hash_each_line(file_data *current, const Char *buffer);
+    template <typename Char>
+    bool fits_class(const equivclass &eq, const Char *line, size_t length);
+    template <typename Char1, typename Char2>
+    bool lines_match(const Char1 *eqline, size_t eqlength, const Char2 *line, size_t length);
     void find_identical_ends(file_data filevec[]);
+    template <typename Char0, typename Char1>
+    void find_identical_ends(file_data filevec[], const Char0 *buffer0, const Char1 *buffer1);
 
     // gnudiff_xmalloc.cpp
     void *xmalloc(size_t n);
     void *xrealloc(void *p, size_t n);
     void xalloc_die();
+    void *scratch_alloc(scratch_buffer &buf, size_t n);
+    void *scratch_realloc(scratch_buffer &buf, size_t n);
+    void *scratch_zalloc(scratch_buffer &buf, size_t n);
 
-    inline bool isWhite(QChar c)
+    static inline bool isWhite(QChar c)
     {
         return c == ' ' || c == '\t' || c == '\r';
     }
+
+    /* The buffers come from SourceData which already split them into lines,
+   each ending with '\n'.  Line numbers have to match its line numbers.  */
+    static inline bool isEndOfLine(QChar c)
+    {
+        return c == '\n';
+    }
+    static inline bool isEndOfLine(char c)
+    {
+        return c == '\n';
+    }
 }; // class GnuDiff
 
 #endif
@@ -12,6 +12,7 @@
 */
 
 #include "gnudiff_diff.h"
+#include <algorithm>
 #include <stdlib.h>
 #include <type_traits>
 
@@ -25,35 +26,6 @@
 typedef size_t hash_value;
 static_assert(std::is_unsigned<hash_value>::value, "hash_value must be signed.");
 
-/* Lines are put into equivalence classes of lines that match in lines_differ.
-   Each equivalence class is represented by one of these structures,
-   but only while the classes are being computed.
-   Afterward, each class is represented by a number.  */
-struct equivclass {
-    GNULineRef next;   /* Next item in this bucket.  */
-    hash_value hash;   /* Hash of lines in this class.  */
-    const QChar *line; /* A line that fits this class.  */
-    size_t length;     /* That line's length, not counting its newline.  */
-};
-
-/* Hash-table: array of buckets, each being a chain of equivalence classes.
-   buckets[-1] is reserved for incomplete lines.  */
-static GNULineRef *buckets;
-
-/* Number of buckets in the hash table array, not counting buckets[-1].  */
-static size_t nbuckets;
-
-/* Array in which the equivalence classes are allocated.
-   The bucket-chains go through the elements in this array.
-   The number of an equivalence class is its index in this array.  */
-static equivclass *equivs;
-
-/* Index of first free element in the array `equivs'.  */
-static GNULineRef equivs_index;
-
-/* Number of elements allocated in the array `equivs'.  */
-static GNULineRef equivs_alloc;
-
 /* Check for binary files and compare them for exact identity.  */
 
 /* Return 1 if BUF contains a non text character.
@@ -67,94 +39,165 @@ static GNULineRef equivs_alloc;
    but an option like -i might cause us to ignore the difference.
    Return nonzero if the lines differ.  */
 
-bool GnuDiff::lines_differ(const QChar *s1, size_t len1, const QChar *s2, size_t len2)
+template <typename Char1, typename Char2>
+bool GnuDiff::lines_differ(const Char1 *s1, size_t len1, const Char2 *s2, size_t len2)
 {
-    const QChar *t1 = s1;
-    const QChar *t2 = s2;
-    const QChar *s1end = s1 + len1;
-    const QChar *s2end = s2 + len2;
+    const Char1 *t1 = s1;
+    const Char2 *t2 = s2;
+    const Char1 *s1end = s1 + len1;
+    const Char2 *s2end = s2 + len2;
 
     for(;; ++t1, ++t2)
     {
-        /* Test for exact char equality first, since it's a common case.  */
-        if(t1 != s1end && t2 != s2end && *t1 == *t2)
-            continue;
-        else
+        /* Test for exact char equality first, since it's a common case.
+           Whole runs of equal chars are skipped at once.  */
+        const qint64 nofEquals = Utils::commonPrefixLength(t1, t2, std::min(s1end - t1, s2end - t2));
+        t1 += nofEquals;
+        t2 += nofEquals;
+
+        while(t1 != s1end &&
+              ((bIgnoreWhiteSpace && isWhite(Utils::toQChar(*t1))) ||
+               (bIgnoreNumbers && (Utils::toQChar(*t1).isDigit() || *t1 == '-' || *t1 == '.'))))
         {
-            while(t1 != s1end &&
-                  ((bIgnoreWhiteSpace && isWhite(*t1)) ||
-                   (bIgnoreNumbers && (t1->isDigit() || *t1 == '-' || *t1 == '.'))))
-            {
-                ++t1;
-            }
+            ++t1;
+        }
 
-            while(t2 != s2end &&
-                  ((bIgnoreWhiteSpace && isWhite(*t2)) ||
-                   (bIgnoreNumbers && (t2->isDigit() || *t2 == '-' || *t2 == '.'))))
-            {
-                ++t2;
-            }
+        while(t2 != s2end &&
+              ((bIgnoreWhiteSpace && isWhite(Utils::toQChar(*t2))) ||
+               (bIgnoreNumbers && (Utils::toQChar(*t2).isDigit() || *t2 == '-' || *t2 == '.'))))
+        {
+            ++t2;
+        }
 
-            if(t1 != s1end && t2 != s2end)
-            {
-                if(ignore_case)
-                { /* Lowercase comparison. */
-                    if(t1->toLower() == t2->toLower())
-                        continue;
-                }
-                else if(*t1 == *t2)
+        if(t1 != s1end && t2 != s2end)
+        {
+            if(ignore_case)
+            { /* Lowercase comparison. */
+                if(Utils::toQChar(*t1).toLower() == Utils::toQChar(*t2).toLower())
                     continue;
-                else
-                    return true;
             }
-            else if(t1 == s1end && t2 == s2end)
-                return false;
+            else if(Utils::toQChar(*t1) == Utils::toQChar(*t2))
+                continue;
             else
                 return true;
         }
+        else if(t1 == s1end && t2 == s2end)
+            return false;
+        else
+            return true;
     }
     return false;
 }
 
+template <typename Char>
+size_t GnuDiff::line_hash(const Char *line, size_t length, bool ignoreNumbers)
+{
+    hash_value h = 0;
+    for(const Char *p = line, *end = line + length; p < end; ++p)
+    {
+        const QChar c = Utils::toQChar(*p);
+        if(!(isWhite(c) || (ignoreNumbers && (c.isDigit() || c == '-' || c == '.'))))
+            h = HASH(h, c.unicode());
+    }
+    return h;
+}
+
+/* The text kinds SourceData keeps, see TextChunk.  (KDiff3)  */
+template bool GnuDiff::lines_differ<QChar, QChar>(const QChar *, size_t, const QChar *, size_t);
+template bool GnuDiff::lines_differ<QChar, char>(const QChar *, size_t, const char *, size_t);
+template bool GnuDiff::lines_differ<char, QChar>(const char *, size_t, const QChar *, size_t);
+template bool GnuDiff::lines_differ<char, char>(const char *, size_t, const char *, size_t);
+template size_t GnuDiff::line_hash<QChar>(const QChar *, size_t, bool);
+template size_t GnuDiff::line_hash<char>(const char *, size_t, bool);
+
+/* Whether LINE belongs to the equivalence class of EQLINE, which may be of
+   the other kind of text.  (KDiff3)  */
+
+template <typename Char1, typename Char2>
+bool GnuDiff::lines_match(const Char1 *eqline, size_t eqlength, const Char2 *line, size_t length)
+{
+    bool diff_length_compare_anyway =
+        ignore_white_space != IGNORE_NO_WHITE_SPACE || bIgnoreNumbers;
+    bool same_length_diff_contents_compare_anyway =
+        diff_length_compare_anyway | ignore_case;
+
+    if(eqlength == length)
+    {
+        /* Reuse existing equivalence class if the lines are identical.
+           This detects the common case of exact identity
+           faster than lines_differ would.  */
+        if(Utils::commonPrefixLength(eqline, line, (qint64)length) == (qint64)length)
+            return true;
+        if(!same_length_diff_contents_compare_anyway)
+            return false;
+    }
+    else if(!diff_length_compare_anyway)
+        return false;
+
+    return !lines_differ(eqline, eqlength, line, length);
+}
+
+template <typename Char>
+bool GnuDiff::fits_class(const equivclass &eq, const Char *line, size_t length)
+{
+    if(eq.file->latin1)
+        return lines_match(static_cast<const char *>(eq.file->buffer) + eq.line, eq.length, line, length);
+    return lines_match(static_cast<const QChar *>(eq.file->buffer) + eq.line, eq.length, line, length);
+}
+
 /* Split the file into lines, simultaneously computing the equivalence
    class for each line.  */
 
 void GnuDiff::find_and_hash_each_line(file_data *current)
+{
+    if(current->latin1)
+        find_and_hash_each_line(current, static_cast<const char *>(current->buffer));
+    else
+        find_and_hash_each_line(current, static_cast<const QChar *>(current->buffer));
+}
+
+template <typename Char>
+void GnuDiff::find_and_hash_each_line(file_data *current, const Char *buffer)
 {
     hash_value h;
-    const QChar *p = current->prefix_end;
+    const Char *p = buffer + current->prefix_end;
     QChar c;
     GNULineRef i, *bucket;
     size_t length;
 
     /* Cache often-used quantities in local variables to help the compiler.  */
-    const QChar **linbuf = current->linbuf;
+    size_t *linbuf = current->linbuf;
     GNULineRef alloc_lines = current->alloc_lines;
     GNULineRef line = 0;
     GNULineRef linbuf_base = current->linbuf_base;
     GNULineRef *cureqs = (GNULineRef *)xmalloc(alloc_lines * sizeof(*cureqs));
-    equivclass *eqs = equivs;
+    equivclass *eqs = equiv_classes;
     GNULineRef eqs_index = equivs_index;
     GNULineRef eqs_alloc = equivs_alloc;
-    const QChar *suffix_begin = current->suffix_begin;
-    const QChar *bufend = current->buffer + current->buffered;
-    bool diff_length_compare_anyway =
-        ignore_white_space != IGNORE_NO_WHITE_SPACE || bIgnoreNumbers;
-    bool same_length_diff_contents_compare_anyway =
-        diff_length_compare_anyway | ignore_case;
+    const Char *suffix_begin = buffer + current->suffix_begin;
+    const Char *bufend = buffer + current->buffered;
+    /* Hashes computed once per line by the caller, indexed from the start of buffer.  */
+    const size_t *line_hashes =
+        (ignore_white_space == IGNORE_ALL_SPACE && !ignore_case) ? current->line_hashes : nullptr;
 
     while(p < suffix_begin)
     {
-        const QChar *ip = p;
+        const Char *ip = p;
 
         h = 0;
 
         /* Hash this line until we find a newline or bufend is reached.  */
-        if(ignore_case)
+        if(line_hashes)
+        {
+            h = line_hashes[current->prefix_lines + line];
+            while(p < bufend && !isEndOfLine(*p))
+                ++p;
+        }
+        else if(ignore_case)
             switch(ignore_white_space)
             {
                 case IGNORE_ALL_SPACE:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
+                    while(p < bufend && !isEndOfLine(c = Utils::toQChar(*p)))
                     {
                         if(!(isWhite(c) || (bIgnoreNumbers && (c.isDigit() || c == '-' || c == '.'))))
                             h = HASH(h, c.toLower().unicode());
@@ -163,7 +206,7 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
                     break;
 
                 default:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
+                    while(p < bufend && !isEndOfLine(c = Utils::toQChar(*p)))
                     {
                         h = HASH(h, c.toLower().unicode());
                         ++p;
@@ -174,16 +217,13 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
             switch(ignore_white_space)
             {
                 case IGNORE_ALL_SPACE:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
-                    {
-                        if(!(isWhite(c) || (bIgnoreNumbers && (c.isDigit() || c == '-' || c == '.'))))
-                            h = HASH(h, c.unicode());
+                    while(p < bufend && !isEndOfLine(*p))
                         ++p;
-                    }
+                    h = line_hash(ip, p - ip, bIgnoreNumbers);
                     break;
 
                 default:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
+                    while(p < bufend && !isEndOfLine(c = Utils::toQChar(*p)))
                     {
                         h = HASH(h, c.unicode());
                         ++p;
@@ -205,36 +245,21 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
                     if((GNULineRef)(GNULINEREF_MAX / (2 * sizeof(*eqs))) <= eqs_alloc)
                         xalloc_die();
                     eqs_alloc *= 2;
-                    eqs = (equivclass *)xrealloc(eqs, eqs_alloc * sizeof(*eqs));
+                    eqs = (equivclass *)scratch_realloc(equivs_space, eqs_alloc * sizeof(*eqs));
                 }
                 eqs[i].next = *bucket;
                 eqs[i].hash = h;
-                eqs[i].line = ip;
+                eqs[i].file = current;
+                eqs[i].line = ip - buffer;
                 eqs[i].length = length;
                 *bucket = i;
                 break;
             }
-            else if(eqs[i].hash == h)
+            else if(eqs[i].hash == h && fits_class(eqs[i], ip, length))
             {
-                const QChar *eqline = eqs[i].line;
-
                 /* Reuse existing class if lines_differ reports the lines
                equal.  */
-                if(eqs[i].length == length)
-                {
-                    /* Reuse existing equivalence class if the lines are identical.
-           This detects the common case of exact identity
-           faster than lines_differ would.  */
-                    if(memcmp(eqline, ip, length * sizeof(QChar)) == 0)
-                        break;
-                    if(!same_length_diff_contents_compare_anyway)
-                        continue;
-                }
-                else if(!diff_length_compare_anyway)
-                    continue;
-
-                if(!lines_differ(eqline, eqs[i].length, ip, length))
-                    break;
+                break;
             }
 
         /* Maybe increase the size of the line table.  */
@@ -246,11 +271,11 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
             alloc_lines = 2 * alloc_lines - linbuf_base;
             cureqs = (GNULineRef *)xrealloc(cureqs, alloc_lines * sizeof(*cureqs));
             linbuf += linbuf_base;
-            linbuf = (const QChar **)xrealloc(linbuf,
-                                              (alloc_lines - linbuf_base) * sizeof(ptrdiff_t));
+            linbuf = (size_t *)xrealloc(linbuf,
+                                        (alloc_lines - linbuf_base) * sizeof(*linbuf));
             linbuf -= linbuf_base;
         }
-        linbuf[line] = ip;
+        linbuf[line] = ip - buffer;
         cureqs[line] = i;
         ++line;
     }
@@ -269,11 +294,11 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
                 xalloc_die();
             alloc_lines = 2 * alloc_lines - linbuf_base;
             linbuf += linbuf_base;
-            linbuf = (const QChar **)xrealloc(linbuf,
-                                              (alloc_lines - linbuf_base) * sizeof(ptrdiff_t));
+            linbuf = (size_t *)xrealloc(linbuf,
+                                        (alloc_lines - linbuf_base) * sizeof(*linbuf));
             linbuf -= linbuf_base;
         }
-        linbuf[line] = p;
+        linbuf[line] = p - buffer;
 
         if(p >= bufend)
             break;
@@ -283,7 +308,7 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
 
         line++;
 
-        while(p < bufend && !Utils::isEndOfLine(*p++))
+        while(p < bufend && !isEndOfLine(*p++))
             continue;
     }
 
@@ -292,7 +317,7 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
     current->valid_lines = line;
     current->alloc_lines = alloc_lines;
     current->equivs = cureqs;
-    equivs = eqs;
+    equiv_classes = eqs;
     equivs_alloc = eqs_alloc;
     equivs_index = eqs_index;
 }
@@ -313,39 +338,54 @@ GnuDiff::guess_lines(GNULineRef n, size_t s, size_t t)
    prefixes and suffixes of each object.  */
 
 void GnuDiff::find_identical_ends(file_data filevec[])
+{
+    const void *buffer0 = filevec[0].buffer;
+    const void *buffer1 = filevec[1].buffer;
+    if(filevec[0].latin1 && filevec[1].latin1)
+        find_identical_ends(filevec, static_cast<const char *>(buffer0), static_cast<const char *>(buffer1));
+    else if(filevec[0].latin1)
+        find_identical_ends(filevec, static_cast<const char *>(buffer0), static_cast<const QChar *>(buffer1));
+    else if(filevec[1].latin1)
+        find_identical_ends(filevec, static_cast<const QChar *>(buffer0), static_cast<const char *>(buffer1));
+    else
+        find_identical_ends(filevec, static_cast<const QChar *>(buffer0), static_cast<const QChar *>(buffer1));
+}
+
+template <typename Char0, typename Char1>
+void GnuDiff::find_identical_ends(file_data filevec[], const Char0 *buffer0, const Char1 *buffer1)
 {
     /* Find identical prefix.  */
-    const QChar *p0, *p1, *buffer0, *buffer1;
-    p0 = buffer0 = filevec[0].buffer;
-    p1 = buffer1 = filevec[1].buffer;
+    const Char0 *p0 = buffer0;
+    const Char1 *p1 = buffer1;
     size_t n0, n1;
     n0 = filevec[0].buffered;
     n1 = filevec[1].buffered;
-    const QChar *const pEnd0 = p0 + n0;
-    const QChar *const pEnd1 = p1 + n1;
+    const Char0 *const pEnd0 = p0 + n0;
+    const Char1 *const pEnd1 = p1 + n1;
 
-    if(p0 == p1)
+    if(filevec[0].buffer == filevec[1].buffer)
+    {
         /* The buffers are the same; sentinels won't work.  */
-        p0 = p1 += n1;
+        p0 += n1;
+        p1 += n1;
+    }
     else
     {
         /* Loop until first mismatch, or end. */
-        while(p0 != pEnd0 && p1 != pEnd1 && *p0 == *p1)
-        {
-            p0++;
-            p1++;
-        }
+        const qint64 nofEquals = Utils::commonPrefixLength(p0, p1, (qint64)std::min(n0, n1));
+        p0 += nofEquals;
+        p1 += nofEquals;
     }
 
     /* Now P0 and P1 point at the first nonmatching characters.  */
 
     /* Skip back to last line-beginning in the prefix. */
-    while(p0 != buffer0 && !Utils::isEndOfLine(p0[-1]))
+    while(p0 != buffer0 && !isEndOfLine(p0[-1]))
         p0--, p1--;
 
     /* Record the prefix.  */
-    filevec[0].prefix_end = p0;
-    filevec[1].prefix_end = p1;
+    filevec[0].prefix_end = p0 - buffer0;
+    filevec[1].prefix_end = p1 - buffer1;
 
     /* Find identical suffix.  */
 
@@ -353,18 +393,18 @@ void GnuDiff::find_identical_ends(file_data filevec[])
     p0 = buffer0 + n0;
     p1 = buffer1 + n1;
 
-    const QChar *end0, *beg0;
+    const Char0 *end0, *beg0;
     end0 = p0; /* Addr of last char in file 0.  */
 
     /* Get value of P0 at which we should stop scanning backward:
       this is when either P0 or P1 points just past the last char
       of the identical prefix.  */
-    beg0 = filevec[0].prefix_end + (n0 < n1 ? 0 : n0 - n1);
+    beg0 = buffer0 + filevec[0].prefix_end + (n0 < n1 ? 0 : n0 - n1);
 
     /* Scan back until chars don't match or we reach that point.  */
     for(; p0 != beg0; p0--, p1--)
     {
-        if(*p0 != *p1)
+        if(Utils::toQChar(*p0) != Utils::toQChar(*p1))
         {
             /* Point at the first char of the matching suffix.  */
             beg0 = p0;
@@ -375,17 +415,17 @@ void GnuDiff::find_identical_ends(file_data filevec[])
     // Go to the next line (skip last line with a difference)
     if(p0 != end0)
     {
-        if(*p0 != *p1)
+        if(Utils::toQChar(*p0) != Utils::toQChar(*p1))
             ++p0;
-        while(p0 < pEnd0 && !Utils::isEndOfLine(*p0++))
+        while(p0 < pEnd0 && !isEndOfLine(*p0++))
             continue;
     }
 
     p1 += p0 - beg0;
 
     /* Record the suffix.  */
-    filevec[0].suffix_begin = p0;
-    filevec[1].suffix_begin = p1;
+    filevec[0].suffix_begin = p0 - buffer0;
+    filevec[1].suffix_begin = p1 - buffer1;
 
     /* Calculate number of lines of prefix to save.
 
@@ -401,13 +441,13 @@ void GnuDiff::find_identical_ends(file_data filevec[])
      Handle 1 more line than the context says (because we count 1 too many),
      rounded up to the next power of 2 to speed index computation.  */
 
-    const QChar **linbuf0, **linbuf1;
+    size_t *linbuf0, *linbuf1;
     GNULineRef alloc_lines0, alloc_lines1;
     GNULineRef buffered_prefix, prefix_count, prefix_mask;
     GNULineRef middle_guess, suffix_guess;
     if(no_diff_means_no_output && context < (GNULineRef)(GNULINEREF_MAX / 4) && context < (GNULineRef)(n0))
     {
-        middle_guess = guess_lines(0, 0, p0 - filevec[0].prefix_end);
+        middle_guess = guess_lines(0, 0, p0 - (buffer0 + filevec[0].prefix_end));
         suffix_guess = guess_lines(0, 0, buffer0 + n0 - p0);
         for(prefix_count = 1; prefix_count <= context; prefix_count *= 2)
             continue;
@@ -421,13 +461,13 @@ void GnuDiff::find_identical_ends(file_data filevec[])
 
     prefix_mask = prefix_count - 1;
     GNULineRef lines = 0;
-    linbuf0 = (const QChar **)xmalloc(alloc_lines0 * sizeof(ptrdiff_t));
+    linbuf0 = (size_t *)xmalloc(alloc_lines0 * sizeof(*linbuf0));
     p0 = buffer0;
 
     /* If the prefix is needed, find the prefix lines.  */
-    if(!(no_diff_means_no_output && filevec[0].prefix_end == p0 && filevec[1].prefix_end == p1))
+    if(!(no_diff_means_no_output && filevec[0].prefix_end == 0 && filevec[1].prefix_end == (size_t)(p1 - buffer1)))
     {
-        end0 = filevec[0].prefix_end;
+        end0 = buffer0 + filevec[0].prefix_end;
         while(p0 != end0)
         {
             GNULineRef l = lines++ & prefix_mask;
@@ -436,10 +476,10 @@ void GnuDiff::find_identical_ends(file_data filevec[])
                 if((GNULineRef)(GNULINEREF_MAX / (2 * sizeof(ptrdiff_t))) <= alloc_lines0)
                     xalloc_die();
                 alloc_lines0 *= 2;
-                linbuf0 = (const QChar **)xrealloc(linbuf0, alloc_lines0 * sizeof(ptrdiff_t));
+                linbuf0 = (size_t *)xrealloc(linbuf0, alloc_lines0 * sizeof(*linbuf0));
             }
-            linbuf0[l] = p0;
-            while(p0 < pEnd0 && !Utils::isEndOfLine(*p0++))
+            linbuf0[l] = p0 - buffer0;
+            while(p0 < pEnd0 && !isEndOfLine(*p0++))
                 continue;
         }
     }
@@ -447,12 +487,12 @@ void GnuDiff::find_identical_ends(file_data filevec[])
 
     /* Allocate line buffer 1.  */
 
-    middle_guess = guess_lines(lines, p0 - buffer0, p1 - filevec[1].prefix_end);
+    middle_guess = guess_lines(lines, p0 - buffer0, p1 - (buffer1 + filevec[1].prefix_end));
     suffix_guess = guess_lines(lines, p0 - buffer0, buffer1 + n1 - p1);
     alloc_lines1 = buffered_prefix + middle_guess + std::min(context, suffix_guess);
     if(alloc_lines1 < buffered_prefix || (GNULineRef)(GNULINEREF_MAX / sizeof(ptrdiff_t)) <= alloc_lines1)
         xalloc_die();
-    linbuf1 = (const QChar **)xmalloc(alloc_lines1 * sizeof(ptrdiff_t));
+    linbuf1 = (size_t *)xmalloc(alloc_lines1 * sizeof(*linbuf1));
 
     GNULineRef i;
     if(buffered_prefix != lines)
@@ -464,9 +504,9 @@ void GnuDiff::find_identical_ends(file_data filevec[])
             linbuf0[i] = linbuf1[i];
     }
 
-    /* Initialize line buffer 1 from line buffer 0.  */
+    /* Initialize line buffer 1 from line buffer 0, the prefixes have the same offsets.  */
     for(i = 0; i < buffered_prefix; ++i)
-        linbuf1[i] = linbuf0[i] - buffer0 + buffer1;
+        linbuf1[i] = linbuf0[i];
 
     /* Record the line buffer, adjusted so that
      linbuf[0] points at the first differing line.  */
@@ -505,9 +545,9 @@ bool GnuDiff::read_files(file_data filevec[], bool /*pretend_binary*/)
     find_identical_ends(filevec);
 
     equivs_alloc = filevec[0].alloc_lines + filevec[1].alloc_lines + 1;
-    if((GNULineRef)(GNULINEREF_MAX / sizeof(*equivs)) <= equivs_alloc)
+    if((GNULineRef)(GNULINEREF_MAX / sizeof(*equiv_classes)) <= equivs_alloc)
         xalloc_die();
-    equivs = (equivclass *)xmalloc(equivs_alloc * sizeof(*equivs));
+    equiv_classes = (equivclass *)scratch_alloc(equivs_space, equivs_alloc * sizeof(*equiv_classes));
     /* Equivalence class 0 is permanently safe for lines that were not
      hashed.  Real equivalence classes start at 1.  */
     equivs_index = 1;
@@ -520,7 +560,7 @@ bool GnuDiff::read_files(file_data filevec[], bool /*pretend_binary*/)
     nbuckets = ((GNULineRef)1 << i) - prime_offset[i];
     if(GNULINEREF_MAX / sizeof(*buckets) <= nbuckets)
         xalloc_die();
-    buckets = (GNULineRef *)zalloc((nbuckets + 1) * sizeof(*buckets));
+    buckets = (GNULineRef *)scratch_zalloc(buckets_space, (nbuckets + 1) * sizeof(*buckets));
     buckets++;
 
     for(i = 0; i < 2; ++i)
@@ -528,8 +568,5 @@ bool GnuDiff::read_files(file_data filevec[], bool /*pretend_binary*/)
 
     filevec[0].equiv_max = filevec[1].equiv_max = equivs_index;
 
-    free(equivs);
-    free(buckets - 1);
-
     return false;
 }
@@ -68,3 +68,52 @@ GnuDiff::zalloc(size_t size)
     memset(p, 0, size);
     return p;
 }
+
+/* Return at least N bytes of BUF, growing it if needed.
+   The previous contents are lost when it grows.  */
+
+void *
+GnuDiff::scratch_alloc(scratch_buffer &buf, size_t n)
+{
+    if(n > buf.size)
+    {
+        free(buf.data);
+        buf.data = xmalloc(n);
+        buf.size = n;
+    }
+    return buf.data;
+}
+
+/* Like scratch_alloc but keeps the previous contents.  */
+
+void *
+GnuDiff::scratch_realloc(scratch_buffer &buf, size_t n)
+{
+    if(n > buf.size)
+    {
+        buf.data = xrealloc(buf.data, n);
+        buf.size = n;
+    }
+    return buf.data;
+}
+
+/* Like scratch_alloc but the first SIZE bytes are set to zero.  */
+
+void *
+GnuDiff::scratch_zalloc(scratch_buffer &buf, size_t size)
+{
+    void *p = scratch_alloc(buf, size);
+    memset(p, 0, size);
+    return p;
+}
+
+GnuDiff::~GnuDiff()
+{
+    free(buckets_space.data);
+    free(equivs_space.data);
+    free(flag_space.data);
+    free(diag_space.data);
+    free(undiscarded_space.data);
+    free(equiv_count_space.data);
+    free(discarded_space.data);
+}
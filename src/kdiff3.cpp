@@ -11,16 +11,20 @@
 #include "kdiff3.h"
 
 #include "directorymergewindow.h"
+#include "FullAnalysis.h"
 #include "fileaccess.h"
 #include "guiutils.h"
 #include "kdiff3_part.h"
 #include "kdiff3_shell.h"
-#include "optiondialog.h"
+#include "Logging.h"
+#include "options.h"
 #include "progress.h"
 #include "smalldialogs.h"
 #include "difftextwindow.h"
 #include "mergeresultwindow.h"
 #include "RLPainter.h"
+#include "TaskGroup.h"
+#include "TextLayoutCache.h"
 #include "Utils.h"
 
 #ifndef Q_OS_WIN
@@ -33,6 +37,7 @@
 #include <QCommandLineParser>
 #include <QDesktopWidget>
 #include <QDir>
+#include <QFile>
 #include <QFileDialog>
 #include <QLabel>
 #include <QLayout>
@@ -45,9 +50,11 @@
 #include <QPrintDialog>
 #include <QPrinter>
 #include <QPushButton>
+#include <QSemaphore>
 #include <QSplitter>
 #include <QStatusBar>
 #include <QTextStream>
+#include <QThreadPool>
 #include <QUrl>
 // include files for KDE
 #include <KCrash>
@@ -61,8 +68,6 @@
 #include <KToggleAction>
 #include <KToolBar>
 
-bool KDiff3App::m_bTripleDiff = false;
-
 boost::signals2::signal<bool (), or_> KDiff3App::allowCut;
 boost::signals2::signal<bool (), and_> KDiff3App::shouldContinue;
 
@@ -72,6 +77,59 @@ boost::signals2::signal<bool (), and_> KDiff3App::shouldContinue;
 */
 constexpr QLatin1String MAIN_TOOLBAR_NAME = QLatin1String("mainToolBar", sizeof("mainToolBar") - 1);
 
+#ifndef QT_NO_PRINTER
+// A page to print with the layouts of its lines, one cache for each diff window.
+class PrintPage
+{
+  public:
+    PrintPage(int page, int line, int nofLines):
+        m_page(page), m_line(line), m_nofLines(nofLines)
+    {
+        for(TextLayoutCache& layouts: m_layouts)
+            layouts.setMaxNofLayouts(nofLines);
+    }
+
+    int page() const { return m_page; }
+    int line() const { return m_line; }
+    int nofLines() const { return m_nofLines; }
+    TextLayoutCache& layouts(int windowIdx) { return m_layouts[windowIdx]; }
+    // Blocks until the lines are laid out.
+    QSemaphore& laidOut() { return m_laidOut; }
+
+  private:
+    int m_page;
+    int m_line;
+    int m_nofLines;
+    TextLayoutCache m_layouts[3];
+    QSemaphore m_laidOut;
+};
+
+/*
+    Laying out the lines takes most of the time printing, so it is done on worker threads while
+    the GUI thread draws the pages before. A painter on the printer may only be used by one thread.
+*/
+class LayoutPrintPageTask : public TaskGroup::Task
+{
+  public:
+    LayoutPrintPageTask(TaskGroup& group, const QVector<DiffTextWindow*>& windows, const QSharedPointer<PrintPage>& pPage)
+        : Task(group), m_windows(windows), m_pPage(pPage)
+    {
+    }
+
+  protected:
+    void execute() override
+    {
+        for(int i = 0; i < m_windows.size() && !isCancelled(); ++i)
+            m_windows[i]->layoutPrintPage(m_pPage->layouts(i), m_pPage->line(), m_pPage->nofLines());
+        m_pPage->laidOut().release();
+    }
+
+  private:
+    QVector<DiffTextWindow*> m_windows;
+    QSharedPointer<PrintPage> m_pPage;
+};
+#endif
+
 KActionCollection* KDiff3App::actionCollection() const
 {
     if(m_pKDiff3Shell == nullptr)
@@ -114,7 +172,7 @@ bool KDiff3App::isDirComparison() const
 /*
     Don't call completeInit from here it will be called in KDiff3Shell as needed.
 */
-KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3Part)
+KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3Part, const QCommandLineParser* pCmdLineParser)
     : QSplitter(pParent) //previously KMainWindow
 {
     setObjectName(name);
@@ -140,28 +198,26 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3P
     }
 
     // All default values must be set before calling readOptions().
-    m_pOptionDialog = new OptionDialog(m_pKDiff3Shell != nullptr, this);
-    chk_connect_a(m_pOptionDialog, &OptionDialog::applyDone, this, &KDiff3App::slotRefresh);
-
-    // This is just a convenience variable to make code that accesses options more readable
-    m_pOptions = m_pOptionDialog->getOptions();
-
-    m_pOptionDialog->readOptions(KSharedConfig::openConfig());
+    // The option dialog is made in slotConfigure(), starting up doesn't wait for its widgets.
+    m_pOptions = QSharedPointer<Options>::create();
+    m_pOptions->init();
+    m_pOptions->readOptions(KSharedConfig::openConfig());
 
     // Option handling: Only when pParent==0 (no parent)
-    int argCount = KDiff3Shell::getParser()->optionNames().count() + KDiff3Shell::getParser()->positionalArguments().count();
+    const QCommandLineParser* pParser = pCmdLineParser != nullptr ? pCmdLineParser : KDiff3Shell::getParser();
+    int argCount = pParser->optionNames().count() + pParser->positionalArguments().count();
     bool hasArgs = !isPart() && argCount > 0;
     if(hasArgs) {
         QString s;
         QString title;
-        if(KDiff3Shell::getParser()->isSet("confighelp"))
+        if(pParser->isSet("confighelp"))
         {
-            s = m_pOptionDialog->calcOptionHelp();
+            s = m_pOptions->calcOptionHelp();
             title = i18n("Current Configuration:");
         }
         else
         {
-            s = m_pOptionDialog->parseOptions(KDiff3Shell::getParser()->values("cs"));
+            s = m_pOptions->parseOptions(pParser->values("cs"));
             title = i18n("Config Option Error:");
         }
         if(!s.isEmpty())
@@ -202,17 +258,19 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3P
     m_sd3->setOptions(m_pOptions);
 
 #ifdef ENABLE_AUTO
-    m_bAutoFlag = hasArgs && KDiff3Shell::getParser()->isSet("auto") && !KDiff3Shell::getParser()->isSet("noauto");
+    m_bAutoFlag = hasArgs && pParser->isSet("auto") && !pParser->isSet("noauto");
 #else
     m_bAutoFlag = false;
 #endif
 
     m_bAutoMode = m_bAutoFlag || m_pOptions->m_bAutoSaveAndQuitOnMergeWithoutConflicts;
+    // The parser is reset at the end of the constructor.
+    m_bPrintStats = hasArgs && pParser->isSet("stats");
     if(hasArgs) {
-        m_outputFilename = KDiff3Shell::getParser()->value("output");
+        m_outputFilename = pParser->value("output");
 
         if(m_outputFilename.isEmpty())
-            m_outputFilename = KDiff3Shell::getParser()->value("out");
+            m_outputFilename = pParser->value("out");
 
         if(!m_outputFilename.isEmpty())
             m_outputFilename = FileAccess(m_outputFilename, true).absoluteFilePath();
@@ -226,7 +284,7 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3P
             m_bAutoMode = false;
         }
 
-        if(m_outputFilename.isEmpty() && KDiff3Shell::getParser()->isSet("merge"))
+        if(m_outputFilename.isEmpty() && pParser->isSet("merge"))
         {
             m_outputFilename = "unnamed.txt";
             m_bDefaultFilename = true;
@@ -236,10 +294,10 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3P
             m_bDefaultFilename = false;
         }
 
-        g_bAutoSolve = !KDiff3Shell::getParser()->isSet("qall"); // Note that this is effective only once.
-        QStringList args = KDiff3Shell::getParser()->positionalArguments();
+        m_bAutoSolve = !pParser->isSet("qall"); // Note that this is effective only once.
+        QStringList args = pParser->positionalArguments();
 
-        m_sd1->setFilename(KDiff3Shell::getParser()->value("base"));
+        m_sd1->setFilename(pParser->value("base"));
         if(m_sd1->isEmpty()) {
             if(args.count() > 0) m_sd1->setFilename(args[0]); // args->arg(0)
             if(args.count() > 1) m_sd2->setFilename(args[1]);
@@ -253,10 +311,10 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3P
         //Set m_bDirCompare flag
         m_bDirCompare = m_sd1->isDir();
 
-        QStringList aliasList = KDiff3Shell::getParser()->values( "fname" );
+        QStringList aliasList = pParser->values( "fname" );
         QStringList::Iterator ali = aliasList.begin();
 
-        QString an1 = KDiff3Shell::getParser()->value("L1");
+        QString an1 = pParser->value("L1");
         if(!an1.isEmpty()) {
             m_sd1->setAliasName(an1);
         }
@@ -266,7 +324,7 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3P
             ++ali;
         }
 
-        QString an2 = KDiff3Shell::getParser()->value("L2");
+        QString an2 = pParser->value("L2");
         if(!an2.isEmpty()) {
             m_sd2->setAliasName(an2);
         }
@@ -276,7 +334,7 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3P
             ++ali;
         }
 
-        QString an3 = KDiff3Shell::getParser()->value("L3");
+        QString an3 = pParser->value("L3");
         if(!an3.isEmpty()) {
             m_sd3->setAliasName(an3);
         }
@@ -285,11 +343,25 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3P
             m_sd3->setAliasName(*ali);
             ++ali;
         }
+
+        static const char* const alignmentOptions[] = {"alignment-ab", "alignment-ac", "alignment-bc"};
+        for(int i = 0; i < 3; ++i)
+        {
+            const QString alignmentFile = pParser->value(QLatin1String(alignmentOptions[i]));
+            if(alignmentFile.isEmpty())
+                continue;
+
+            QFile file(alignmentFile);
+            if(file.open(QIODevice::ReadOnly))
+                m_alignments[i] = file.readAll();
+            else
+                qCWarning(kdiffMain) << "Reading the alignment failed:" << alignmentFile << file.errorString();
+        }
     }
     else
     {
         m_bDefaultFilename = false;
-        g_bAutoSolve = false;
+        m_bAutoSolve = false;
     }
     g_pProgressDialog->setStayHidden(m_bAutoMode);
 
@@ -358,7 +430,8 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Part* pKDiff3P
     if(qApp != nullptr)
         chk_connect_a(qApp, &QApplication::focusChanged, this, &KDiff3App::slotFocusChanged);
 
-    delete KDiff3Shell::getParser();
+    // Later windows of this process without a parser of their own get no arguments.
+    KDiff3Shell::getParser()->parse(QStringList(QCoreApplication::applicationFilePath()));
 }
 
 /*
@@ -433,23 +506,23 @@ void KDiff3App::completeInit(const QString& fn1, const QString& fn2, const QStri
         mainInit();
         if(m_bAutoMode)
         {
+            if(m_totalDiffStatus.isDiffDegraded())
+                QTextStream(stderr) << i18n("The diff time limit was reached, differences may be larger than necessary.") << "\n";
+
             QSharedPointer<SourceData> pSD = nullptr;
-            if(m_sd3->isEmpty()) {
-                if(m_totalDiffStatus.isBinaryEqualAB()) {
-                    pSD = m_sd1;
-                }
-            }
-            else
+            switch(FullAnalysis::wholeFileResult(m_totalDiffStatus, m_sd3->isEmpty()))
             {
-                if(m_totalDiffStatus.isBinaryEqualBC() || m_totalDiffStatus.isBinaryEqualAB())
-                {
-                    //if B==C (assume A is old), if A==B then C has changed
+                case e_SrcSelector::A:
+                    pSD = m_sd1;
+                    break;
+                case e_SrcSelector::B:
+                    pSD = m_sd2;
+                    break;
+                case e_SrcSelector::C:
                     pSD = m_sd3;
-                }
-                else if(m_totalDiffStatus.isBinaryEqualAC())
-                {
-                    pSD = m_sd2; // assuming B has changed
-                }
+                    break;
+                default:
+                    break;
             }
 
             if(pSD != nullptr)
@@ -691,7 +764,7 @@ void KDiff3App::saveOptions(KSharedConfigPtr config)
                         m_pOptionDialog->m_toolBarPos = (int) toolBar(MAIN_TOOLBAR_NAME)->allowedAreas();*/
         }
 
-        m_pOptionDialog->saveOptions(std::move(config));
+        m_pOptions->saveOptions(std::move(config));
     }
 }
 
@@ -875,7 +948,6 @@ void KDiff3App::slotFilePrint()
         QList<int> pageList; // = printer.pageList();
 
         bool bPrintCurrentPage = false;
-        bool bFirstPrintedPage = false;
 
         bool bPrintSelection = false;
         int totalNofPages = (totalNofLines + linesPerPage - 1) / linesPerPage;
@@ -924,88 +996,98 @@ void KDiff3App::slotFilePrint()
             }
         }
 
-        int page = 1;
+        // All pages are known before the first is drawn, so that the next ones are laid out meanwhile.
+        QVector<QSharedPointer<PrintPage>> pages;
+        if(bPrintSelection)
+        {
+            for(int page = 1; line.isValid() && line < selectionEndLine && line < totalNofLines; line += linesPerPage, ++page)
+                pages.append(QSharedPointer<PrintPage>::create(page, line, std::min<int>(linesPerPage, selectionEndLine - line)));
+        }
+        else if(bPrintCurrentPage)
+        {
+            // Detect the first visible line in the window.
+            line = m_pDiffTextWindow1->convertDiff3LineIdxToLine(currentFirstD3LIdx);
+            if(line.isValid() && line < totalNofLines)
+                pages.append(QSharedPointer<PrintPage>::create(1, line, linesPerPage));
+        }
+        else
+        {
+            for(int page: pageList)
+            {
+                if((page - 1) * linesPerPage < totalNofLines)
+                    pages.append(QSharedPointer<PrintPage>::create(page, (page - 1) * linesPerPage, linesPerPage));
+            }
+        }
+
+        QVector<DiffTextWindow*> windows{m_pDiffTextWindow1, m_pDiffTextWindow2};
+        if(m_bTripleDiff && m_pDiffTextWindow3 != nullptr)
+            windows.append(m_pDiffTextWindow3);
+
+        // Only a few pages are laid out ahead, so the memory used doesn't grow with the pages printed.
+        const int nofPagesAhead = 2 * QThreadPool::globalInstance()->maxThreadCount();
+        TaskGroup layoutTasks;
+        int nofLayoutsStarted = 0;
 
         ProgressProxy pp;
-        pp.setMaxNofSteps(totalNofPages);
-        QList<int>::iterator pageListIt = pageList.begin();
-        for(;;) {
-            pp.setInformation(i18n("Printing page %1 of %2", page, totalNofPages), false);
-            pp.setCurrent(page - 1);
+        pp.setMaxNofSteps(pages.size());
+        for(int i = 0; i < pages.size(); ++i)
+        {
+            for(; nofLayoutsStarted < pages.size() && nofLayoutsStarted <= i + nofPagesAhead; ++nofLayoutsStarted)
+                layoutTasks.add(new LayoutPrintPageTask(layoutTasks, windows, pages[nofLayoutsStarted]));
+            layoutTasks.startPending();
+
+            PrintPage& printPage = *pages[i];
+            pp.setInformation(i18n("Printing page %1 of %2", printPage.page(), totalNofPages), false);
+            pp.setCurrent(i);
+            // Keeps the cancel button working while the page is laid out.
+            while(!printPage.laidOut().tryAcquire(1, 100) && !pp.wasCancelled())
+            {
+            }
             if(pp.wasCancelled())
             {
                 printer.abort();
                 break;
             }
-            if(!bPrintSelection) {
-                if(pageListIt == pageList.end())
-                    break;
-                page = *pageListIt;
-                line = (page - 1) * linesPerPage;
-
-                if(bPrintCurrentPage)
-                {
-                    // Detect the first visible line in the window.
-                    line = m_pDiffTextWindow1->convertDiff3LineIdxToLine(currentFirstD3LIdx);
-                }
-            }
-            else
-            {
-                if(line >= selectionEndLine) {
-                    break;
-                }
-                else
-                {
-                    if(selectionEndLine - line < linesPerPage)
-                        linesPerPage = selectionEndLine - line;
-                }
-            }
-            if(line.isValid() && line < totalNofLines)
-            {
-                if(bFirstPrintedPage)
-                    printer.newPage();
 
-                painter.setClipping(true);
+            if(i > 0)
+                printer.newPage();
 
-                painter.setPen(m_pOptions->m_colorA);
-                QString headerText1 = m_sd1->getAliasName() + ", " + topLineText + ": " + QString::number(m_pDiffTextWindow1->calcTopLineInFile(line) + 1);
-                m_pDiffTextWindow1->printWindow(painter, view1, headerText1, line, linesPerPage, m_pOptions->m_fgColor);
+            const int firstLine = printPage.line();
+            const int nofLines = printPage.nofLines();
+            painter.setClipping(true);
 
-                painter.setPen(m_pOptions->m_colorB);
-                QString headerText2 = m_sd2->getAliasName() + ", " + topLineText + ": " + QString::number(m_pDiffTextWindow2->calcTopLineInFile(line) + 1);
-                m_pDiffTextWindow2->printWindow(painter, view2, headerText2, line, linesPerPage, m_pOptions->m_fgColor);
+            painter.setPen(m_pOptions->m_colorA);
+            QString headerText1 = m_sd1->getAliasName() + ", " + topLineText + ": " + QString::number(m_pDiffTextWindow1->calcTopLineInFile(firstLine) + 1);
+            m_pDiffTextWindow1->printWindow(painter, view1, headerText1, firstLine, nofLines, m_pOptions->m_fgColor, &printPage.layouts(0));
 
-                if(m_bTripleDiff && m_pDiffTextWindow3 != nullptr)
-                {
-                    painter.setPen(m_pOptions->m_colorC);
-                    QString headerText3 = m_sd3->getAliasName() + ", " + topLineText + ": " + QString::number(m_pDiffTextWindow3->calcTopLineInFile(line) + 1);
-                    m_pDiffTextWindow3->printWindow(painter, view3, headerText3, line, linesPerPage, m_pOptions->m_fgColor);
-                }
-                painter.setClipping(false);
-
-                painter.setPen(m_pOptions->m_fgColor);
-                painter.drawLine(0, view.bottom() + 3, view.width(), view.bottom() + 3);
-                QString s = bPrintCurrentPage ? QString("")
-                                              : QString::number(page) + '/' + QString::number(totalNofPages);
-                if(bPrintSelection) s += i18n(" (Selection)");
-                painter.drawText((view.right() - Utils::getHorizontalAdvance(painter.fontMetrics(), s)) / 2,
-                                 view.bottom() + painter.fontMetrics().ascent() + 5, s);
-
-                bFirstPrintedPage = true;
-                if(bPrintCurrentPage) break;
-            }
+            painter.setPen(m_pOptions->m_colorB);
+            QString headerText2 = m_sd2->getAliasName() + ", " + topLineText + ": " + QString::number(m_pDiffTextWindow2->calcTopLineInFile(firstLine) + 1);
+            m_pDiffTextWindow2->printWindow(painter, view2, headerText2, firstLine, nofLines, m_pOptions->m_fgColor, &printPage.layouts(1));
 
-            if(bPrintSelection)
+            if(m_bTripleDiff && m_pDiffTextWindow3 != nullptr)
             {
-                line += linesPerPage;
-                ++page;
-            }
-            else
-            {
-                ++pageListIt;
+                painter.setPen(m_pOptions->m_colorC);
+                QString headerText3 = m_sd3->getAliasName() + ", " + topLineText + ": " + QString::number(m_pDiffTextWindow3->calcTopLineInFile(firstLine) + 1);
+                m_pDiffTextWindow3->printWindow(painter, view3, headerText3, firstLine, nofLines, m_pOptions->m_fgColor, &printPage.layouts(2));
             }
+            painter.setClipping(false);
+
+            painter.setPen(m_pOptions->m_fgColor);
+            painter.drawLine(0, view.bottom() + 3, view.width(), view.bottom() + 3);
+            QString s = bPrintCurrentPage ? QString("")
+                                          : QString::number(printPage.page()) + '/' + QString::number(totalNofPages);
+            if(bPrintSelection) s += i18n(" (Selection)");
+            painter.drawText((view.right() - Utils::getHorizontalAdvance(painter.fontMetrics(), s)) / 2,
+                             view.bottom() + painter.fontMetrics().ascent() + 5, s);
+
+            // The layouts of a printed page are not needed anymore.
+            pages[i].clear();
         }
 
+        // The word wrap below changes the lines the tasks still laying out read.
+        layoutTasks.cancel();
+        layoutTasks.wait();
+
         painter.end();
 
         if(m_pOptions->wordWrapOn())
@@ -42,6 +42,7 @@ class DiffTextWindowFrame;
 class MergeResultWindow;
 class WindowTitleWidget;
 
+class QCommandLineParser;
 class QStatusBar;
 class QMenu;
 
@@ -104,8 +105,9 @@ class KDiff3App : public QSplitter
 
   public:
     /** constructor of KDiff3App, calls all init functions to create the application.
+        The arguments come from pParser, by default from KDiff3Shell::getParser().
      */
-    KDiff3App(QWidget* parent, const QString& name, KDiff3Part* pKDiff3Part);
+    KDiff3App(QWidget* parent, const QString& name, KDiff3Part* pKDiff3Part, const QCommandLineParser* pParser = nullptr);
     ~KDiff3App() override;
 
     bool isPart() const;
@@ -133,7 +135,7 @@ class KDiff3App : public QSplitter
     virtual bool isFileSaved() const;
     virtual bool isDirComparison() const;
 
-    static bool isTripleDiff() { return m_bTripleDiff; }
+    bool isTripleDiff() const { return m_bTripleDiff; }
 
     KActionCollection* actionCollection() const;
 
@@ -217,6 +219,8 @@ public Q_SLOTS:
     void slotRecalcWordWrap();
     void postRecalcWordWrap();
     void slotFinishRecalcWordWrap(int visibleTextWidth);
+    void slotWordWrapProgress();
+    void slotUpdateWordWrap();
 
     void showPopupMenu(const QPoint& point);
 
@@ -295,7 +299,9 @@ public Q_SLOTS:
     void initView();
 
   private:
-    void mainInit(TotalDiffStatus* pTotalDiffStatus = nullptr, bool bLoadFiles = true, bool bUseCurrentEncoding = false);
+    void mainInit(TotalDiffStatus* pTotalDiffStatus = nullptr, bool bLoadFiles = true, bool bUseCurrentEncoding = false, bool bIncrementalReload = false);
+    // Logs the memory the comparison holds, with "--stats" it is printed to stderr.
+    void reportMemoryUsage();
 
     void mainWindowEnable(bool bEnable);
     virtual void wheelEvent(QWheelEvent* pWheelEvent) override;
@@ -311,6 +317,8 @@ public Q_SLOTS:
     QStatusBar* statusBar() const;
     KToolBar* toolBar(const QLatin1String &toolBarId) const;
     void recalcWordWrap(int visibleTextWidthForPrinting = -1);
+    void updateWordWrap(bool bSelectionInD3LCoords);
+    bool stopBackgroundWordWrap();
 
     bool canCut();
 
@@ -391,7 +399,8 @@ public Q_SLOTS:
 
     MergeResultWindow* m_pMergeResultWindow = nullptr;
     WindowTitleWidget* m_pMergeResultWindowTitle;
-    static bool m_bTripleDiff;
+    bool m_bTripleDiff = false;
+    bool m_bAutoSolve = true; // For the next comparison, only the first one of a window can be without, see --qall
 
     QSplitter* m_pDirectoryMergeSplitter = nullptr;
     DirectoryMergeWindow* m_pDirectoryMergeWindow = nullptr;
@@ -416,12 +425,20 @@ public Q_SLOTS:
     DiffList m_diffList12;
     DiffList m_diffList23;
     DiffList m_diffList13;
+    // Unified diffs for A <-> B, A <-> C and B <-> C given on the command line, see runDiff().
+    QByteArray m_alignments[3];
+    // Differing byte ranges of A and B when one of them is binary data.
+    QVector<BinaryDiff::Range> m_binaryDiffList12;
+    // Options the diff lists were computed with, a reload can only reuse them while these are unchanged.
+    LineDiffOptions m_lineDiffOptions;
 
     QSharedPointer<DiffBufferInfo> m_diffBufferInfo = QSharedPointer<DiffBufferInfo>::create();
     Diff3LineList m_diff3LineList;
     Diff3LineVector m_diff3LineVector;
     //ManualDiffHelpDialog* m_pManualDiffHelpDialog;
     ManualDiffHelpList m_manualDiffHelpList;
+    // The alignments the diff lists were computed with, so changing them only compares the affected ranges again.
+    ManualDiffHelpList m_diffManualDiffHelpList;
 
     int m_neededLines;
     int m_DTWHeight;
@@ -429,7 +446,7 @@ public Q_SLOTS:
     bool m_bFileSaved = false;
     bool m_bTimerBlock = false; // Synchronization
 
-    OptionDialog* m_pOptionDialog = nullptr;
+    OptionDialog* m_pOptionDialog = nullptr; // Made by slotConfigure()
     QSharedPointer<Options> m_pOptions = nullptr;
     FindDialog* m_pFindDialog = nullptr;
 
@@ -440,7 +457,11 @@ public Q_SLOTS:
     KParts::MainWindow* m_pKDiff3Shell = nullptr;
     bool m_bAutoFlag = false;
     bool m_bAutoMode = false;
+    bool m_bPrintStats = false; // --stats
     bool m_bRecalcWordWrapPosted = false;
+    // The visible lines are wrapped and shown, the others are still wrapped in the background.
+    bool m_bWordWrapInBackground = false;
+    bool m_bWordWrapUpdatePosted = false;
 
     int m_firstD3LIdx;                 // only needed during recalcWordWrap
     QPointer<QEventLoop> m_pEventLoopForPrinting;
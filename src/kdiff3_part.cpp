@@ -41,7 +41,7 @@ KAboutData KDiff3Part::createAboutData()
 
 //K_PLUGIN_FACTORY(KDiff3PartFactory, registerPlugin<KDiff3Part>();)
 
-KDiff3Part::KDiff3Part(QWidget* parentWidget, QObject* parent, const QVariantList& args)
+KDiff3Part::KDiff3Part(QWidget* parentWidget, QObject* parent, const QVariantList& args, const QCommandLineParser* pParser)
     : KParts::ReadWritePart(parent)
 {
     //set AboutData
@@ -49,7 +49,7 @@ KDiff3Part::KDiff3Part(QWidget* parentWidget, QObject* parent, const QVariantLis
     const QString widgetName = args[0].toString();
 
     // this should be your custom internal widget
-    m_widget = new KDiff3App(parentWidget, widgetName, this);
+    m_widget = new KDiff3App(parentWidget, widgetName, this, pParser);
 
     // notify the part that this is our internal widget
     setWidget(m_widget);
@@ -13,6 +13,7 @@
 #include <KPluginFactory>
 #include <KParts/ReadWritePart>
 
+class QCommandLineParser;
 class QWidget;
 class KDiff3App;
 
@@ -30,7 +31,7 @@ public:
     /**
      * Default constructor
      */
-    KDiff3Part(QWidget *parentWidget, QObject *parent, const QVariantList &args );
+    KDiff3Part(QWidget *parentWidget, QObject *parent, const QVariantList &args, const QCommandLineParser *pParser = nullptr );
 
     /**
      * Destructor
@@ -7,12 +7,17 @@
 */
 
 #include "kdiff3_shell.h"
+#include "InstanceServer.h"
 #include "kdiff3.h"
 #include "kdiff3_part.h"
 
 #include <QApplication>
 #include <QCloseEvent>
+#include <QCommandLineOption>
+#include <QFile>
+#include <QStandardPaths>
 #include <QStatusBar>
+#include <QTextStream>
 
 #include <KConfig>
 #include <KEditToolBar>
@@ -22,7 +27,91 @@
 #include <KStandardAction>
 #include <KToolBar>
 
-KDiff3Shell::KDiff3Shell(bool bCompleteInit)
+static void initialiseCmdLineArgs(QCommandLineParser* cmdLineParser)
+{
+    QString configFileName = QStandardPaths::locate(QStandardPaths::GenericConfigLocation, "kdiff3rc");
+    QFile configFile(configFileName);
+    QString ignorableOptionsLine = "-u;-query;-html;-abort";
+    if(configFile.open(QIODevice::ReadOnly))
+    {
+        QTextStream ts(&configFile);
+        while(!ts.atEnd())
+        {
+            QString line = ts.readLine();
+            if(line.startsWith(QLatin1String("IgnorableCmdLineOptions=")))
+            {
+                int pos = line.indexOf('=');
+                if(pos >= 0)
+                {
+                    ignorableOptionsLine = line.mid(pos + 1);
+                }
+                break;
+            }
+        }
+    }
+    //support our own old preferences this is obsolete
+    QStringList sl = ignorableOptionsLine.split(',');
+
+    if(!sl.isEmpty())
+    {
+        const QStringList ignorableOptions = sl.front().split(';');
+        for(QString ignorableOption : ignorableOptions)
+        {
+            ignorableOption.remove('-');
+            if(!ignorableOption.isEmpty())
+            {
+                if(ignorableOption.length() == 1) {
+                    cmdLineParser->addOption(QCommandLineOption({ignorableOption, QLatin1String("ignore")}, i18n("Ignored. (User defined.)")));
+                }
+                else
+                {
+                    cmdLineParser->addOption(QCommandLineOption(ignorableOption, i18n("Ignored. (User defined.)")));
+                }
+            }
+        }
+    }
+}
+
+void KDiff3Shell::addCommandLineOptions(QCommandLineParser* cmdLineParser)
+{
+    initialiseCmdLineArgs(cmdLineParser);
+    // ignorable command options
+    cmdLineParser->addOption(QCommandLineOption({QLatin1String("m"), QLatin1String("merge")}, i18n("Merge the input.")));
+    cmdLineParser->addOption(QCommandLineOption({QLatin1String("b"), QLatin1String("base")}, i18n("Explicit base file. For compatibility with certain tools."), QLatin1String("file")));
+    cmdLineParser->addOption(QCommandLineOption({QLatin1String("o"), QLatin1String("output")}, i18n("Output file. Implies -m. E.g.: -o newfile.txt"), QLatin1String("file")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("out"), i18n("Output file, again. (For compatibility with certain tools.)"), QLatin1String("file")));
+#ifdef ENABLE_AUTO
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("auto"), i18n("No GUI if all conflicts are auto-solvable. (Needs -o file)")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("noauto"), i18n("Ignore --auto and always show GUI.")));
+#else
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("noauto"), i18n("Ignored.")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("auto"), i18n("Ignored.")));
+#endif
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("qall"), i18n("Do not solve conflicts automatically.")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("L1"), i18n("Visible name replacement for input file 1 (base)."), QLatin1String("alias1")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("L2"), i18n("Visible name replacement for input file 2."), QLatin1String("alias2")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("L3"), i18n("Visible name replacement for input file 3."), QLatin1String("alias3")));
+    cmdLineParser->addOption(QCommandLineOption({QLatin1String("L"), QLatin1String("fname")}, i18n("Alternative visible name replacement. Supply this once for every input."), QLatin1String("alias")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("cs"), i18n("Override a config setting. Use once for every setting. E.g.: --cs \"AutoAdvance=1\""), QLatin1String("string")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("confighelp"), i18n("Show list of config settings and current values.")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("config"), i18n("Use a different config file."), QLatin1String("file")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("alignment-ab"), i18n("Take the alignment of input files 1 and 2 from a unified diff or a list of hunk headers instead of comparing them."), QLatin1String("file")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("alignment-ac"), i18n("Take the alignment of input files 1 and 3 from a unified diff or a list of hunk headers instead of comparing them."), QLatin1String("file")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("alignment-bc"), i18n("Take the alignment of input files 2 and 3 from a unified diff or a list of hunk headers instead of comparing them."), QLatin1String("file")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("stats"), i18n("Print the memory each comparison holds to stderr.")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("diff-output"), i18n("Write the differences to a file or - for standard output without GUI, as a unified diff of two files or in the format of diff3 for three."), QLatin1String("file")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("dir-report"), i18n("Compare two or three folders without GUI and write a line of JSON for each item, to a file or - for standard output."), QLatin1String("file")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("server"), i18n("Stay resident without a window and open the comparisons the file manager integrations hand over in new windows.")));
+    cmdLineParser->addOption(QCommandLineOption(QLatin1String("batch"), i18n("Merge or compare the files listed in a manifest without GUI, one line of tab separated names \"A B C output\" each. "
+                                                                             "A summary line in JSON is printed for each."), QLatin1String("manifest")));
+
+    // other command options
+    cmdLineParser->addPositionalArgument(QLatin1String("[File1]"), i18n("file1 to open (base, if not specified via --base). Any file may also be - for standard input, a named pipe or git:<rev>:<path> for a file of the git repository."));
+    cmdLineParser->addPositionalArgument(QLatin1String("[File2]"), i18n("file2 to open"));
+    cmdLineParser->addPositionalArgument(QLatin1String("[File3]"), i18n("file3 to open"));
+}
+
+KDiff3Shell::KDiff3Shell(bool bCompleteInit, const QCommandLineParser* pParser)
 {
     m_bUnderConstruction = true;
     // set the shell's ui resource file
@@ -39,7 +128,7 @@ KDiff3Shell::KDiff3Shell(bool bCompleteInit)
             break;
     }*/
 
-    m_part = new KDiff3Part(this, this, {QVariant(QLatin1String("KDiff3Part"))});
+    m_part = new KDiff3Part(this, this, {QVariant(QLatin1String("KDiff3Part"))}, pParser);
     m_widget = qobject_cast<KDiff3App*>(m_part->widget());
 
     if(m_part)
@@ -101,6 +190,10 @@ void KDiff3Shell::closeEvent(QCloseEvent* e)
     if(queryClose())
     {
         e->accept();
+        // The server stays when its windows are closed.
+        if(InstanceServer::isRunning())
+            return;
+
         bool bFileSaved = m_widget->isFileSaved();
         bool bDirCompare = m_widget->isDirComparison();
         QApplication::exit(bFileSaved || bDirCompare ? 0 : 1);
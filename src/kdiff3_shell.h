@@ -33,9 +33,9 @@ class KDiff3Shell : public KParts::MainWindow
     Q_OBJECT
 public:
     /**
-     * Default Constructor
+     * Default Constructor. The window takes its arguments from pParser, by default from the command line.
      */
-    explicit KDiff3Shell(bool bCompleteInit=true);
+    explicit KDiff3Shell(bool bCompleteInit=true, const QCommandLineParser* pParser=nullptr);
 
     /**
      * Default Destructor
@@ -50,6 +50,8 @@ public:
       static QCommandLineParser *parser = new QCommandLineParser();
       return parser;
     };
+    // The options and arguments of kdiff3 but those of KAboutData.
+    static void addCommandLineOptions(QCommandLineParser* cmdLineParser);
 private Q_SLOTS:
     void optionsShowToolbar();
     void optionsShowStatusbar();
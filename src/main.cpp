@@ -8,7 +8,16 @@
 #include "kdiff3_shell.h"
 //#include "version.h"
 
+#include "BatchMerge.h"
+#include "diff.h"
+#include "DirectoryReport.h"
+#include "fileaccess.h"
+#include "FullAnalysis.h"
+#include "InstanceServer.h"
 #include "Logging.h"
+#include "options.h"
+#include "progress.h"
+#include "StreamInput.h"
 
 #include <stdio.h>// for fileno, stderr
 #include <stdlib.h>// for exit
@@ -21,59 +30,200 @@
 #include <KCrash/KCrash>
 #include <KLocalizedString>
 #include <KMessageBox>
+#include <KSharedConfig>
 
 #include <QApplication>
-#include <QCommandLineOption>
 #include <QCommandLineParser>
 #include <QFile>
+#include <QSharedPointer>
 #include <QStringList>
-#include <QStandardPaths>
 #include <QTextStream>
 
-void initialiseCmdLineArgs(QCommandLineParser* cmdLineParser)
+// The settings for loading, comparing and merging, read without building the option dialog.
+static QSharedPointer<Options> readOptionsWithoutGui(const QCommandLineParser* cmdLineParser, QString& errors)
 {
-    QString configFileName = QStandardPaths::locate(QStandardPaths::GenericConfigLocation, "kdiff3rc");
-    QFile configFile(configFileName);
-    QString ignorableOptionsLine = "-u;-query;-html;-abort";
-    if(configFile.open(QIODevice::ReadOnly))
+    QSharedPointer<Options> pOptions = QSharedPointer<Options>::create();
+    pOptions->initWithoutGui();
+    pOptions->readOptions(KSharedConfig::openConfig());
+    errors = pOptions->parseOptions(cmdLineParser->values("cs"));
+    return pOptions;
+}
+
+// The options of the modes that never show the GUI, so errors in them go to stderr.
+static QSharedPointer<Options> readOptionsReportingErrors(const QCommandLineParser* cmdLineParser)
+{
+    // Settings only the option dialog knows don't matter here.
+    QString errors;
+    const QSharedPointer<Options> pOptions = readOptionsWithoutGui(cmdLineParser, errors);
+    if(!errors.isEmpty())
+        QTextStream(stderr) << i18n("Config Option Error:") << "\n" << errors;
+    return pOptions;
+}
+
+// Opens the output of --diff-output and --dir-report, - stands for standard output.
+static bool openOutput(const QString& outputName, QFile& output)
+{
+    bool bOpened;
+    if(outputName == QLatin1String("-"))
     {
-        QTextStream ts(&configFile);
-        while(!ts.atEnd())
-        {
-            QString line = ts.readLine();
-            if(line.startsWith(QLatin1String("IgnorableCmdLineOptions=")))
-            {
-                int pos = line.indexOf('=');
-                if(pos >= 0)
-                {
-                    ignorableOptionsLine = line.mid(pos + 1);
-                }
-                break;
-            }
-        }
+        bOpened = output.open(stdout, QIODevice::WriteOnly);
+    }
+    else
+    {
+        output.setFileName(outputName);
+        bOpened = output.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    if(!bOpened)
+        QTextStream(stderr) << i18n("Opening %1 failed. %2", outputName, output.errorString()) << "\n";
+    return bOpened;
+}
+
+// The --batch mode, see BatchMerge. Returns the exit code.
+static int runBatch(const QCommandLineParser* cmdLineParser)
+{
+    HiddenProgressDialog progressDialog;
+    const QSharedPointer<Options> pOptions = readOptionsReportingErrors(cmdLineParser);
+
+    QTextStream summary(stdout);
+    return BatchMerge::run(cmdLineParser->value("batch"), pOptions, summary);
+}
+
+// The --diff-output mode, see FullAnalysis::writeDiff(). Returns the exit code of diff.
+static int runDiffOutput(const QCommandLineParser* cmdLineParser)
+{
+    QStringList files;
+    if(!cmdLineParser->value("base").isEmpty())
+        files.append(cmdLineParser->value("base"));
+    files += cmdLineParser->positionalArguments();
+    if(files.count() < 2 || files.count() > 3)
+    {
+        QTextStream(stderr) << i18n("--diff-output needs two or three files.") << "\n";
+        return 2;
     }
-    //support our own old preferences this is obsolete
-    QStringList sl = ignorableOptionsLine.split(',');
 
-    if(!sl.isEmpty())
+    // The names in the header, --L1 to --L3 replace them as in the windows.
+    QStringList names;
+    for(int i = 0; i < files.count(); ++i)
     {
-        const QStringList ignorableOptions = sl.front().split(';');
-        for(QString ignorableOption : ignorableOptions)
+        const QString alias = cmdLineParser->value(QStringLiteral("L%1").arg(i + 1));
+        names.append(alias.isEmpty() ? files[i] : alias);
+    }
+
+    QFile output;
+    if(!openOutput(cmdLineParser->value("diff-output"), output))
+        return 2;
+
+    HiddenProgressDialog progressDialog;
+    const QSharedPointer<Options> pOptions = readOptionsReportingErrors(cmdLineParser);
+
+    QStringList errors;
+    const int exitCode = FullAnalysis::writeDiff(files[0], files[1], files.value(2), names, pOptions, output, errors);
+    output.close();
+    for(const QString& error: errors)
+        QTextStream(stderr) << error << "\n";
+    return exitCode;
+}
+
+// The --dir-report mode, see DirectoryReport. Returns the exit code of diff.
+static int runDirReport(const QCommandLineParser* cmdLineParser)
+{
+    QStringList dirs;
+    if(!cmdLineParser->value("base").isEmpty())
+        dirs.append(cmdLineParser->value("base"));
+    dirs += cmdLineParser->positionalArguments();
+    if(dirs.count() < 2 || dirs.count() > 3)
+    {
+        QTextStream(stderr) << i18n("--dir-report needs two or three folders.") << "\n";
+        return 2;
+    }
+
+    QFile output;
+    if(!openOutput(cmdLineParser->value("dir-report"), output))
+        return 2;
+
+    HiddenProgressDialog progressDialog;
+    const QSharedPointer<Options> pOptions = readOptionsReportingErrors(cmdLineParser);
+    // Nothing is merged, so the automatic merges that need the merge result window don't matter.
+    pOptions->m_bRunHistoryAutoMergeOnMergeStart = false;
+    pOptions->m_bRunRegExpAutoMergeOnMergeStart = false;
+
+    const int exitCode = DirectoryReport::run(dirs[0], dirs[1], dirs.value(2), pOptions, output);
+    output.close();
+    return exitCode;
+}
+
+// The --server mode, see InstanceServer. Returns the exit code.
+static int runServer()
+{
+    InstanceServer server;
+    if(!server.listen())
+    {
+        QTextStream(stderr) << i18n("A KDiff3 server runs already or its socket %1 can't be made.", InstanceServer::serverName()) << "\n";
+        return 1;
+    }
+
+    // The windows come and go, so the progress dialog belongs to none of them.
+    // Each window sets whether it stays hidden, like the window of its own process would.
+    g_pProgressDialog = new ProgressDialog(nullptr, nullptr);
+    QApplication::setQuitOnLastWindowClosed(false);
+    return QApplication::exec();
+}
+
+#ifdef ENABLE_AUTO
+/*
+    Merges the files of --auto without building the GUI when nothing is left for the user to decide.
+    Returns false if the GUI is needed, it then merges the files again and reports what is left.
+*/
+static bool autoMergeWithoutGui(const QCommandLineParser* cmdLineParser)
+{
+    if(cmdLineParser->isSet("noauto") || cmdLineParser->isSet("qall") || cmdLineParser->isSet("confighelp"))
+        return false;
+
+    QString outputFile = cmdLineParser->value("output");
+    if(outputFile.isEmpty())
+        outputFile = cmdLineParser->value("out");
+    if(outputFile.isEmpty())
+        return false;
+
+    QStringList files;
+    if(!cmdLineParser->value("base").isEmpty())
+        files.append(cmdLineParser->value("base"));
+    files += cmdLineParser->positionalArguments();
+    if(files.count() < 2 || files.count() > 3)
+        return false;
+
+    // The GUI makes its own progress dialog, this one is gone by then.
+    HiddenProgressDialog progressDialog;
+
+    bool bSuccess = false;
+    const FileAccess output(outputFile, true /*bWantToWrite*/);
+    bool bLocal = output.isLocal();
+    for(const QString& file: files)
+    {
+        // FileAccess would take a git: input for a URL.
+        if(StreamInput::isStreamInput(file))
+            continue;
+        const FileAccess input(file);
+        bLocal = bLocal && input.isLocal() && !input.isDir();
+    }
+
+    if(bLocal)
+    {
+        // Settings only the option dialog knows are reported by the GUI.
+        QString errors;
+        const QSharedPointer<Options> pOptions = readOptionsWithoutGui(cmdLineParser, errors);
+        if(errors.isEmpty() && FullAnalysis::isMergeAvailable(pOptions))
         {
-            ignorableOption.remove('-');
-            if(!ignorableOption.isEmpty())
-            {
-                if(ignorableOption.length() == 1) {
-                    cmdLineParser->addOption(QCommandLineOption({ignorableOption, QLatin1String("ignore")}, i18n("Ignored. (User defined.)")));
-                }
-                else
-                {
-                    cmdLineParser->addOption(QCommandLineOption(ignorableOption, i18n("Ignored. (User defined.)")));
-                }
-            }
+            TotalDiffStatus status;
+            QStringList mergeErrors;
+            bSuccess = FullAnalysis::merge(files[0], files[1], files.value(2), output.absoluteFilePath(), pOptions, status, mergeErrors) == FullAnalysis::e_MergeResult::Saved;
+            if(bSuccess && status.isDiffDegraded())
+                QTextStream(stderr) << i18n("The diff time limit was reached, differences may be larger than necessary.") << "\n";
         }
     }
+    return bSuccess;
 }
+#endif
 
 int main(int argc, char* argv[])
 {
@@ -107,32 +257,7 @@ int main(int argc, char* argv[])
 
     aboutData.setupCommandLine(cmdLineParser);
 
-    initialiseCmdLineArgs(cmdLineParser);
-    // ignorable command options
-    cmdLineParser->addOption(QCommandLineOption({QLatin1String("m"), QLatin1String("merge")}, i18n("Merge the input.")));
-    cmdLineParser->addOption(QCommandLineOption({QLatin1String("b"), QLatin1String("base")}, i18n("Explicit base file. For compatibility with certain tools."), QLatin1String("file")));
-    cmdLineParser->addOption(QCommandLineOption({QLatin1String("o"), QLatin1String("output")}, i18n("Output file. Implies -m. E.g.: -o newfile.txt"), QLatin1String("file")));
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("out"), i18n("Output file, again. (For compatibility with certain tools.)"), QLatin1String("file")));
-#ifdef ENABLE_AUTO
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("auto"), i18n("No GUI if all conflicts are auto-solvable. (Needs -o file)")));
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("noauto"), i18n("Ignore --auto and always show GUI.")));
-#else
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("noauto"), i18n("Ignored.")));
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("auto"), i18n("Ignored.")));
-#endif
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("qall"), i18n("Do not solve conflicts automatically.")));
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("L1"), i18n("Visible name replacement for input file 1 (base)."), QLatin1String("alias1")));
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("L2"), i18n("Visible name replacement for input file 2."), QLatin1String("alias2")));
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("L3"), i18n("Visible name replacement for input file 3."), QLatin1String("alias3")));
-    cmdLineParser->addOption(QCommandLineOption({QLatin1String("L"), QLatin1String("fname")}, i18n("Alternative visible name replacement. Supply this once for every input."), QLatin1String("alias")));
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("cs"), i18n("Override a config setting. Use once for every setting. E.g.: --cs \"AutoAdvance=1\""), QLatin1String("string")));
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("confighelp"), i18n("Show list of config settings and current values.")));
-    cmdLineParser->addOption(QCommandLineOption(QLatin1String("config"), i18n("Use a different config file."), QLatin1String("file")));
-
-    // other command options
-    cmdLineParser->addPositionalArgument(QLatin1String("[File1]"), i18n("file1 to open (base, if not specified via --base)"));
-    cmdLineParser->addPositionalArgument(QLatin1String("[File2]"), i18n("file2 to open"));
-    cmdLineParser->addPositionalArgument(QLatin1String("[File3]"), i18n("file3 to open"));
+    KDiff3Shell::addCommandLineOptions(cmdLineParser);
 
     bool isAtty = true;
 
@@ -174,6 +299,20 @@ int main(int argc, char* argv[])
 
     aboutData.processCommandLine(cmdLineParser);
 
+    if(cmdLineParser->isSet("batch"))
+        return runBatch(cmdLineParser);
+    if(cmdLineParser->isSet("diff-output"))
+        return runDiffOutput(cmdLineParser);
+    if(cmdLineParser->isSet("dir-report"))
+        return runDirReport(cmdLineParser);
+    if(cmdLineParser->isSet("server"))
+        return runServer();
+
+#ifdef ENABLE_AUTO
+    if(cmdLineParser->isSet("auto") && autoMergeWithoutGui(cmdLineParser))
+        return 0;
+#endif
+
     KDiff3Shell* p = new KDiff3Shell();
     p->show();
     //p->setWindowState( p->windowState() | Qt::WindowActive ); // Patch for ubuntu: window not active on startup
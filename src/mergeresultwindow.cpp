@@ -8,6 +8,7 @@
 
 #include "mergeresultwindow.h"
 
+#include "FullAnalysis.h"
 #include "kdiff3.h"
 #include "options.h"
 #include "RLPainter.h"
@@ -35,12 +36,12 @@
 #include <QPainter>
 #include <QPixmap>
 #include <QPointer>
-#include <QRegExp>
+#include <QRegularExpression>
 #include <QResizeEvent>
 #include <QStatusBar>
 #include <QTextCodec>
 #include <QTextLayout>
-#include <QTextStream>
+#include <QThread>
 #include <QTimerEvent>
 #include <QUrl>
 #include <QWheelEvent>
@@ -50,7 +51,6 @@
 #include <KMessageBox>
 #include <KToggleAction>
 
-bool g_bAutoSolve = true;
 
 QScrollBar* MergeResultWindow::mVScrollBar = nullptr;
 QPointer<QAction> MergeResultWindow::chooseAEverywhere;
@@ -95,7 +95,9 @@ void MergeResultWindow::init(
     const QVector<LineData>* pLineDataB, LineRef sizeB,
     const QVector<LineData>* pLineDataC, LineRef sizeC,
     const Diff3LineList* pDiff3LineList,
-    TotalDiffStatus* pTotalDiffStatus)
+    const QSharedPointer<DiffBufferInfo>& pDiffBufferInfo,
+    TotalDiffStatus* pTotalDiffStatus,
+    bool bAutoSolve)
 {
     m_firstLine = 0;
     m_horizScrollOffset = 0;
@@ -114,6 +116,7 @@ void MergeResultWindow::init(
     m_sizeC = sizeC;
 
     m_pDiff3LineList = pDiff3LineList;
+    m_pDiffBufferInfo = pDiffBufferInfo;
     m_pTotalDiffStatus = pTotalDiffStatus;
 
     m_selection.reset();
@@ -123,8 +126,7 @@ void MergeResultWindow::init(
 
     m_maxTextWidth = -1;
 
-    merge(g_bAutoSolve, e_SrcSelector::Invalid);
-    g_bAutoSolve = true;
+    merge(bAutoSolve, e_SrcSelector::Invalid);
     update();
     updateSourceMask();
 
@@ -251,12 +253,11 @@ void MergeResultWindow::slotRefresh()
     update();
 }
 
-void MergeResultWindow::slotUpdateAvailabilities()
+void MergeResultWindow::slotUpdateAvailabilities(bool bTripleDiff)
 {
     const QWidget* frame = qobject_cast<QWidget*>(parent());
     Q_ASSERT(frame != nullptr);
     const bool bMergeEditorVisible = frame->isVisible();
-    const bool bTripleDiff = KDiff3App::isTripleDiff();
 
     chooseAEverywhere->setEnabled(bMergeEditorVisible);
     chooseBEverywhere->setEnabled(bMergeEditorVisible);
@@ -280,6 +281,7 @@ void MergeResultWindow::slotStatusMessageChanged(const QString& s)
 void MergeResultWindow::reset()
 {
     m_pDiff3LineList = nullptr;
+    m_pDiffBufferInfo.reset();
     m_pTotalDiffStatus = nullptr;
     m_pldA = nullptr;
     m_pldB = nullptr;
@@ -305,7 +307,7 @@ void Diff3Line::mergeOneLine(
     {
         if(getLineA().isValid() && getLineB().isValid())
         {
-            if(pFineAB == nullptr)
+            if(!hasFineAB())
             {
                 mergeDetails = e_MergeDetails::eNoChange;
                 src = e_SrcSelector::A;
@@ -327,27 +329,27 @@ void Diff3Line::mergeOneLine(
     // A is base.
     if(getLineA().isValid() && getLineB().isValid() && getLineC().isValid())
     {
-        if(pFineAB == nullptr && pFineBC == nullptr && pFineCA == nullptr)
+        if(!hasFineAB() && !hasFineBC() && !hasFineCA())
         {
             mergeDetails = e_MergeDetails::eNoChange;
             src = e_SrcSelector::A;
         }
-        else if(pFineAB == nullptr && pFineBC != nullptr && pFineCA != nullptr)
+        else if(!hasFineAB() && hasFineBC() && hasFineCA())
         {
             mergeDetails = e_MergeDetails::eCChanged;
             src = e_SrcSelector::C;
         }
-        else if(pFineAB != nullptr && pFineBC != nullptr && pFineCA == nullptr)
+        else if(hasFineAB() && hasFineBC() && !hasFineCA())
         {
             mergeDetails = e_MergeDetails::eBChanged;
             src = e_SrcSelector::B;
         }
-        else if(pFineAB != nullptr && pFineBC == nullptr && pFineCA != nullptr)
+        else if(hasFineAB() && !hasFineBC() && hasFineCA())
         {
             mergeDetails = e_MergeDetails::eBCChangedAndEqual;
             src = e_SrcSelector::C;
         }
-        else if(pFineAB != nullptr && pFineBC != nullptr && pFineCA != nullptr)
+        else if(hasFineAB() && hasFineBC() && hasFineCA())
         {
             mergeDetails = e_MergeDetails::eBCChanged;
             bConflict = true;
@@ -357,7 +359,7 @@ void Diff3Line::mergeOneLine(
     }
     else if(getLineA().isValid() && getLineB().isValid() && !getLineC().isValid())
     {
-        if(pFineAB != nullptr)
+        if(hasFineAB())
         {
             mergeDetails = e_MergeDetails::eBChanged_CDeleted;
             bConflict = true;
@@ -371,7 +373,7 @@ void Diff3Line::mergeOneLine(
     }
     else if(getLineA().isValid() && !getLineB().isValid() && getLineC().isValid())
     {
-        if(pFineCA != nullptr)
+        if(hasFineCA())
         {
             mergeDetails = e_MergeDetails::eCChanged_BDeleted;
             bConflict = true;
@@ -385,7 +387,7 @@ void Diff3Line::mergeOneLine(
     }
     else if(!getLineA().isValid() && getLineB().isValid() && getLineC().isValid())
     {
-        if(pFineBC != nullptr)
+        if(hasFineBC())
         {
             mergeDetails = e_MergeDetails::eBCAdded;
             bConflict = true;
@@ -416,20 +418,6 @@ void Diff3Line::mergeOneLine(
         Q_ASSERT(true);
 }
 
-bool MergeResultWindow::sameKindCheck(const MergeLine& ml1, const MergeLine& ml2)
-{
-    if(ml1.bConflict && ml2.bConflict)
-    {
-        // Both lines have conflicts: If one is only a white space conflict and
-        // the other one is a real conflict, then this line returns false.
-        return ml1.id3l->isEqualAC() == ml2.id3l->isEqualAC() && ml1.id3l->isEqualAB() == ml2.id3l->isEqualAB();
-    }
-    else
-        return (
-            (!ml1.bConflict && !ml2.bConflict && ml1.bDelta && ml2.bDelta && ml1.srcSelect == ml2.srcSelect && (ml1.mergeDetails == ml2.mergeDetails || (ml1.mergeDetails != e_MergeDetails::eBCAddedAndEqual && ml2.mergeDetails != e_MergeDetails::eBCAddedAndEqual))) ||
-            (!ml1.bDelta && !ml2.bDelta));
-}
-
 void MergeResultWindow::merge(bool bAutoSolve, e_SrcSelector defaultSelector, bool bConflictsOnly, bool bWhiteSpaceOnly)
 {
     if(!bConflictsOnly)
@@ -447,75 +435,21 @@ void MergeResultWindow::merge(bool bAutoSolve, e_SrcSelector defaultSelector, bo
         }
 
         m_mergeLineList.clear();
+        m_mergeLineIndex.invalidate();
+        m_navigationIndex.bValid = false;
 
-        int lineIdx = 0;
-        Diff3LineList::const_iterator it;
-        for(it = m_pDiff3LineList->begin(); it != m_pDiff3LineList->end(); ++it, ++lineIdx)
-        {
-            const Diff3Line& d = *it;
-
-            MergeLine ml;
-            bool bLineRemoved;
-            d.mergeOneLine( ml.mergeDetails, ml.bConflict, bLineRemoved, ml.srcSelect, m_pldC == nullptr);
-
-            // Automatic solving for only whitespace changes.
-            if(ml.bConflict &&
-               ((m_pldC == nullptr && (d.isEqualAB() || (d.isWhiteLine(e_SrcSelector::A) && d.isWhiteLine(e_SrcSelector::B)))) ||
-                (m_pldC != nullptr && ((d.isEqualAB() && d.isEqualAC()) || (d.isWhiteLine(e_SrcSelector::A) && d.isWhiteLine(e_SrcSelector::B) && d.isWhiteLine(e_SrcSelector::C))))))
-            {
-                ml.bWhiteSpaceConflict = true;
-            }
-
-            ml.d3lLineIdx = lineIdx;
-            ml.bDelta = ml.srcSelect != e_SrcSelector::A;
-            ml.id3l = it;
-            ml.srcRangeLength = 1;
-
-            MergeLine* back = m_mergeLineList.empty() ? nullptr : &m_mergeLineList.back();
-
-            bool bSame = back != nullptr && sameKindCheck(ml, *back);
-            if(bSame)
-            {
-                ++back->srcRangeLength;
-                if(back->bWhiteSpaceConflict && !ml.bWhiteSpaceConflict)
-                    back->bWhiteSpaceConflict = false;
-            }
-            else
-            {
-                m_mergeLineList.push_back(ml);
-            }
-
-            if(!ml.bConflict)
-            {
-                MergeLine& tmpBack = m_mergeLineList.back();
-                MergeEditLine mel(ml.id3l);
-                mel.setSource(ml.srcSelect, bLineRemoved);
-                tmpBack.mergeEditLineList.push_back(mel);
-            }
-            else if(back == nullptr || !back->bConflict || !bSame)
-            {
-                MergeLine& tmpBack = m_mergeLineList.back();
-                MergeEditLine mel(ml.id3l);
-                mel.setConflict();
-                tmpBack.mergeEditLineList.push_back(mel);
-            }
-        }
+        // The edit lines of all deltas are chosen again below, so they are made there in one run per merge line.
+        const bool bChooseAllDeltas = !bAutoSolve && !bWhiteSpaceOnly;
+        m_mergeLineList.build(*m_pDiff3LineList, m_pldC == nullptr, !bChooseAllDeltas);
     }
 
     bool bSolveWhiteSpaceConflicts = false;
     if(bAutoSolve) // when true, then the other params are not used and we can change them here. (see all invocations of merge())
     {
-        if(m_pldC == nullptr && m_pOptions->m_whiteSpace2FileMergeDefault != (int)e_SrcSelector::None) // Only two inputs
+        const e_SrcSelector whiteSpaceMergeDefault = MergeLineList::whiteSpaceMergeDefault(m_pOptions, m_pldC == nullptr);
+        if(whiteSpaceMergeDefault != e_SrcSelector::None)
         {
-            Q_ASSERT(m_pOptions->m_whiteSpace2FileMergeDefault <= (int)e_SrcSelector::Max && m_pOptions->m_whiteSpace2FileMergeDefault >= (int)e_SrcSelector::Min);
-            defaultSelector = (e_SrcSelector)m_pOptions->m_whiteSpace2FileMergeDefault;
-            bWhiteSpaceOnly = true;
-            bSolveWhiteSpaceConflicts = true;
-        }
-        else if(m_pldC != nullptr && m_pOptions->m_whiteSpace3FileMergeDefault != (int)e_SrcSelector::None)
-        {
-            Q_ASSERT(m_pOptions->m_whiteSpace3FileMergeDefault <= (int)e_SrcSelector::Max && m_pOptions->m_whiteSpace2FileMergeDefault >= (int)e_SrcSelector::Min);
-            defaultSelector = (e_SrcSelector)m_pOptions->m_whiteSpace3FileMergeDefault;
+            defaultSelector = whiteSpaceMergeDefault;
             bWhiteSpaceOnly = true;
             bSolveWhiteSpaceConflicts = true;
         }
@@ -524,80 +458,10 @@ void MergeResultWindow::merge(bool bAutoSolve, e_SrcSelector defaultSelector, bo
     if(!bAutoSolve || bSolveWhiteSpaceConflicts)
     {
         // Change all auto selections
-        MergeLineList::iterator mlIt;
-        for(mlIt = m_mergeLineList.begin(); mlIt != m_mergeLineList.end(); ++mlIt)
-        {
-            MergeLine& ml = *mlIt;
-            bool bConflict = ml.mergeEditLineList.empty() || ml.mergeEditLineList.begin()->isConflict();
-            if(ml.bDelta && (!bConflictsOnly || bConflict) && (!bWhiteSpaceOnly || ml.bWhiteSpaceConflict))
-            {
-                ml.mergeEditLineList.clear();
-                if(defaultSelector == e_SrcSelector::Invalid && ml.bDelta)
-                {
-                    MergeEditLine mel(ml.id3l);
-
-                    mel.setConflict();
-                    ml.bConflict = true;
-                    ml.mergeEditLineList.push_back(mel);
-                }
-                else
-                {
-                    Diff3LineList::const_iterator d3llit = ml.id3l;
-                    int j;
-
-                    for(j = 0; j < ml.srcRangeLength; ++j)
-                    {
-                        MergeEditLine mel(d3llit);
-                        mel.setSource(defaultSelector, false);
-
-                        LineRef srcLine = defaultSelector == e_SrcSelector::A ? d3llit->getLineA() : defaultSelector == e_SrcSelector::B ? d3llit->getLineB() : defaultSelector == e_SrcSelector::C ? d3llit->getLineC() : LineRef();
-
-                        if(srcLine.isValid())
-                        {
-                            ml.mergeEditLineList.push_back(mel);
-                        }
-
-                        ++d3llit;
-                    }
-
-                    if(ml.mergeEditLineList.empty()) // Make a line nevertheless
-                    {
-                        MergeEditLine mel(ml.id3l);
-                        mel.setRemoved(defaultSelector);
-                        ml.mergeEditLineList.push_back(mel);
-                    }
-                }
-            }
-        }
+        m_mergeLineList.chooseDeltas(defaultSelector, bConflictsOnly, bWhiteSpaceOnly);
     }
 
-    MergeLineList::iterator mlIt;
-    for(mlIt = m_mergeLineList.begin(); mlIt != m_mergeLineList.end(); ++mlIt)
-    {
-        MergeLine& ml = *mlIt;
-        // Remove all lines that are empty, because no src lines are there.
-
-        LineRef oldSrcLine;
-        e_SrcSelector oldSrc = e_SrcSelector::Invalid;
-        MergeEditLineList::iterator melIt;
-        for(melIt = ml.mergeEditLineList.begin(); melIt != ml.mergeEditLineList.end();)
-        {
-            MergeEditLine& mel = *melIt;
-            e_SrcSelector melsrc = mel.src();
-
-            LineRef srcLine = mel.isRemoved() ? LineRef() : melsrc == e_SrcSelector::A ? mel.id3l()->getLineA() : melsrc == e_SrcSelector::B ? mel.id3l()->getLineB() : melsrc == e_SrcSelector::C ? mel.id3l()->getLineC() : LineRef();
-
-            // At least one line remains because oldSrc != melsrc for first line in list
-            // Other empty lines will be removed
-            if(!srcLine.isValid() && !oldSrcLine.isValid() && oldSrc == melsrc)
-                melIt = ml.mergeEditLineList.erase(melIt);
-            else
-                ++melIt;
-
-            oldSrcLine = srcLine;
-            oldSrc = melsrc;
-        }
-    }
+    m_mergeLineList.removeEmptyEditLines();
 
     if(bAutoSolve && !bConflictsOnly)
     {
@@ -648,8 +512,22 @@ void MergeResultWindow::merge(bool bAutoSolve, e_SrcSelector defaultSelector, bo
 
 void MergeResultWindow::setFirstLine(QtNumberType firstLine)
 {
-    m_firstLine = std::max(0, firstLine);
-    update();
+    const LineRef newFirstLine = std::max(0, firstLine);
+    const int deltaY = fontMetrics().lineSpacing() * (m_firstLine - newFirstLine);
+    m_firstLine = newFirstLine;
+
+    // The pixmap moves along with the window, then only the exposed lines are drawn again.
+    const qreal dpr = devicePixelRatioF();
+    const qreal pixmapDeltaY = deltaY * dpr;
+    if(m_pixmap.size() == size() * dpr && qAbs(deltaY) < height() && pixmapDeltaY == qRound(pixmapDeltaY))
+    {
+        m_pixmap.scroll(0, qRound(pixmapDeltaY), m_pixmap.rect());
+        scroll(0, deltaY);
+    }
+    else
+    {
+        update();
+    }
 }
 
 void MergeResultWindow::setHorizScrollOffset(int horizScrollOffset)
@@ -660,6 +538,10 @@ void MergeResultWindow::setHorizScrollOffset(int horizScrollOffset)
 
 int MergeResultWindow::getMaxTextWidth()
 {
+    // The tab stops of layoutText()
+    if(m_textWidthCache.setSettings(TextWidthCache::Settings{font(), QFontMetricsF(font()).width(' ') * m_pOptions->m_tabSize}))
+        m_maxTextWidth = -1;
+
     if(m_maxTextWidth < 0)
     {
         m_maxTextWidth = 0;
@@ -672,16 +554,7 @@ int MergeResultWindow::getMaxTextWidth()
             for(melIt = ml.mergeEditLineList.begin(); melIt != ml.mergeEditLineList.end(); ++melIt)
             {
                 MergeEditLine& mel = *melIt;
-                QString s = mel.getString(m_pldA, m_pldB, m_pldC);
-
-                QTextLayout textLayout(s, font(), this);
-                textLayout.beginLayout();
-                textLayout.createLine();
-                textLayout.endLayout();
-                if(m_maxTextWidth < textLayout.maximumWidth())
-                {
-                    m_maxTextWidth =  qCeil(textLayout.maximumWidth());
-                }
+                m_maxTextWidth = std::max(m_maxTextWidth, m_textWidthCache.width(mel.getString(m_pldA, m_pldB, m_pldC), this));
             }
         }
         m_maxTextWidth += 5; // cursorwidth
@@ -745,7 +618,6 @@ void MergeResultWindow::go(e_Direction eDir, e_EndPoint eEndPoint)
 {
     Q_ASSERT(eDir == eUp || eDir == eDown);
     MergeLineList::iterator i = m_currentMergeLineIt;
-    bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
     if(eEndPoint == eEnd)
     {
         if(eDir == eUp)
@@ -761,35 +633,22 @@ void MergeResultWindow::go(e_Direction eDir, e_EndPoint eEndPoint)
                 --i; // search upwards
         }
     }
-    else if(eEndPoint == eDelta && isItAtEnd(eDir != eUp, i))
-    {
-        do
-        {
-            if(eDir == eUp)
-                --i;
-            else
-                ++i;
-        } while(isItAtEnd(eDir != eUp, i) && (!i->bDelta || checkOverviewIgnore(i) || (bSkipWhiteConflicts && i->bWhiteSpaceConflict)));
-    }
-    else if(eEndPoint == eConflict && isItAtEnd(eDir != eUp, i))
+    else if((eEndPoint == eDelta || eEndPoint == eConflict || eEndPoint == eUnsolvedConflict) && isItAtEnd(eDir != eUp, i))
     {
-        do
+        const NavigationIndex& index = navigationIndex();
+        const QVector<int>& positions = eEndPoint == eDelta ? index.deltas : eEndPoint == eConflict ? index.conflicts : index.unsolvedConflicts;
+        const int currentPos = index.position(m_mergeLineList, i);
+        // Without a match the search stops at the first or after the last merge line.
+        if(eDir == eUp)
         {
-            if(eDir == eUp)
-                --i;
-            else
-                ++i;
-        } while(isItAtEnd(eDir != eUp, i) && (!i->bConflict || (bSkipWhiteConflicts && i->bWhiteSpaceConflict)));
-    }
-    else if(isItAtEnd(eDir != eUp, i) && eEndPoint == eUnsolvedConflict)
-    {
-        do
+            QVector<int>::const_iterator it = std::lower_bound(positions.constBegin(), positions.constEnd(), currentPos);
+            i = it == positions.constBegin() ? m_mergeLineList.begin() : index.mergeLines[*(it - 1)];
+        }
+        else
         {
-            if(eDir == eUp)
-                --i;
-            else
-                ++i;
-        } while(isItAtEnd(eDir != eUp, i) && !i->mergeEditLineList.begin()->isConflict());
+            QVector<int>::const_iterator it = std::upper_bound(positions.constBegin(), positions.constEnd(), currentPos);
+            i = it == positions.constEnd() ? m_mergeLineList.end() : index.mergeLines[*it];
+        }
     }
 
     if(isVisible())
@@ -798,71 +657,90 @@ void MergeResultWindow::go(e_Direction eDir, e_EndPoint eEndPoint)
     setFastSelector(i);
 }
 
-bool MergeResultWindow::isDeltaAboveCurrent()
+int MergeResultWindow::NavigationIndex::position(const MergeLineList& mergeLineList, MergeLineList::const_iterator i) const
 {
-    bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
-    if(m_mergeLineList.empty()) return false;
-    MergeLineList::iterator i = m_currentMergeLineIt;
-    if(i == m_mergeLineList.begin()) return false;
-    do
-    {
-        --i;
-        if(i->bDelta && !checkOverviewIgnore(i) && !(bSkipWhiteConflicts && i->bWhiteSpaceConflict)) return true;
-    } while(i != m_mergeLineList.begin());
-
-    return false;
+    return i == mergeLineList.end() ? mergeLines.size() : positions.value(&*i, mergeLines.size());
 }
 
-bool MergeResultWindow::isDeltaBelowCurrent()
-{
-    bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
-    if(m_mergeLineList.empty()) return false;
-
-    MergeLineList::iterator i = m_currentMergeLineIt;
-    if(i != m_mergeLineList.end())
-    {
-        ++i;
-        for(; i != m_mergeLineList.end(); ++i)
-        {
-            if(i->bDelta && !checkOverviewIgnore(i) && !(bSkipWhiteConflicts && i->bWhiteSpaceConflict)) return true;
+/*
+    Where the deltas and conflicts are, made again when any merge line or the options for skipping
+    them changed.
+*/
+const MergeResultWindow::NavigationIndex& MergeResultWindow::navigationIndex()
+{
+    NavigationIndex& index = m_navigationIndex;
+    const bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
+    if(index.bValid && index.changeCount == MergeEditLine::changeCount() && index.sizeChangeCount == MergeEditLineList::sizeChangeCount() &&
+       index.bSkipWhiteConflicts == bSkipWhiteConflicts && index.overviewMode == mOverviewMode)
+        return index;
+
+    index.bValid = true;
+    index.changeCount = MergeEditLine::changeCount();
+    index.sizeChangeCount = MergeEditLineList::sizeChangeCount();
+    index.bSkipWhiteConflicts = bSkipWhiteConflicts;
+    index.overviewMode = mOverviewMode;
+    index.mergeLines.clear();
+    index.positions.clear();
+    index.deltas.clear();
+    index.conflicts.clear();
+    index.unsolvedConflicts.clear();
+    index.nofWhiteSpaceUnsolvedConflicts = 0;
+    index.nofDeltasAndConflicts = 0;
+
+    int pos = 0;
+    for(MergeLineList::iterator i = m_mergeLineList.begin(); i != m_mergeLineList.end(); ++i, ++pos)
+    {
+        index.mergeLines.push_back(i);
+        index.positions.insert(&*i, pos);
+
+        const bool bSkipped = bSkipWhiteConflicts && i->bWhiteSpaceConflict;
+        if(i->bDelta && !checkOverviewIgnore(i) && !bSkipped)
+            index.deltas.push_back(pos);
+        if(i->bConflict && !bSkipped)
+            index.conflicts.push_back(pos);
+        if(!i->mergeEditLineList.empty() && i->mergeEditLineList.begin()->isConflict())
+        {
+            index.unsolvedConflicts.push_back(pos);
+            if(i->bWhiteSpaceConflict)
+                ++index.nofWhiteSpaceUnsolvedConflicts;
         }
+        if(i->bConflict || i->bDelta)
+            ++index.nofDeltasAndConflicts;
     }
-    return false;
+
+    return index;
 }
 
-bool MergeResultWindow::isConflictAboveCurrent()
+bool MergeResultWindow::isAboveCurrent(const QVector<int>& positions)
 {
-    if(m_mergeLineList.empty()) return false;
-    MergeLineList::iterator i = m_currentMergeLineIt;
-    if(i == m_mergeLineList.begin()) return false;
-
-    bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
+    const NavigationIndex& index = navigationIndex();
+    return !positions.isEmpty() && positions.first() < index.position(m_mergeLineList, m_currentMergeLineIt);
+}
 
-    do
-    {
-        --i;
-        if(i->bConflict && !(bSkipWhiteConflicts && i->bWhiteSpaceConflict)) return true;
-    } while(i != m_mergeLineList.begin());
+bool MergeResultWindow::isBelowCurrent(const QVector<int>& positions)
+{
+    const NavigationIndex& index = navigationIndex();
+    return !positions.isEmpty() && positions.last() > index.position(m_mergeLineList, m_currentMergeLineIt);
+}
 
-    return false;
+bool MergeResultWindow::isDeltaAboveCurrent()
+{
+    return isAboveCurrent(navigationIndex().deltas);
 }
 
-bool MergeResultWindow::isConflictBelowCurrent()
+bool MergeResultWindow::isDeltaBelowCurrent()
 {
-    MergeLineList::iterator i = m_currentMergeLineIt;
-    if(m_mergeLineList.empty()) return false;
+    return isBelowCurrent(navigationIndex().deltas);
+}
 
-    bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
+bool MergeResultWindow::isConflictAboveCurrent()
+{
+    return isAboveCurrent(navigationIndex().conflicts);
+}
 
-    if(i != m_mergeLineList.end())
-    {
-        ++i;
-        for(; i != m_mergeLineList.end(); ++i)
-        {
-            if(i->bConflict && !(bSkipWhiteConflicts && i->bWhiteSpaceConflict)) return true;
-        }
-    }
-    return false;
+bool MergeResultWindow::isConflictBelowCurrent()
+{
+    return isBelowCurrent(navigationIndex().conflicts);
 }
 
 bool MergeResultWindow::isUnsolvedConflictAtCurrent()
@@ -874,33 +752,12 @@ bool MergeResultWindow::isUnsolvedConflictAtCurrent()
 
 bool MergeResultWindow::isUnsolvedConflictAboveCurrent()
 {
-    if(m_mergeLineList.empty()) return false;
-    MergeLineList::iterator i = m_currentMergeLineIt;
-    if(i == m_mergeLineList.begin()) return false;
-
-    do
-    {
-        --i;
-        if(i->mergeEditLineList.begin()->isConflict()) return true;
-    } while(i != m_mergeLineList.begin());
-
-    return false;
+    return isAboveCurrent(navigationIndex().unsolvedConflicts);
 }
 
 bool MergeResultWindow::isUnsolvedConflictBelowCurrent()
 {
-    MergeLineList::iterator i = m_currentMergeLineIt;
-    if(m_mergeLineList.empty()) return false;
-
-    if(i != m_mergeLineList.end())
-    {
-        ++i;
-        for(; i != m_mergeLineList.end(); ++i)
-        {
-            if(i->mergeEditLineList.begin()->isConflict()) return true;
-        }
-    }
-    return false;
+    return isBelowCurrent(navigationIndex().unsolvedConflicts);
 }
 
 void MergeResultWindow::slotGoTop()
@@ -968,37 +825,18 @@ void MergeResultWindow::slotSetFastSelectorLine(LineIndex line)
 
 int MergeResultWindow::getNrOfUnsolvedConflicts(int* pNrOfWhiteSpaceConflicts)
 {
-    int nrOfUnsolvedConflicts = 0;
+    const NavigationIndex& index = navigationIndex();
     if(pNrOfWhiteSpaceConflicts != nullptr)
-        *pNrOfWhiteSpaceConflicts = 0;
-
-    MergeLineList::iterator mlIt = m_mergeLineList.begin();
-    for(mlIt = m_mergeLineList.begin(); mlIt != m_mergeLineList.end(); ++mlIt)
-    {
-        MergeLine& ml = *mlIt;
-        MergeEditLineList::iterator melIt = ml.mergeEditLineList.begin();
-        if(melIt->isConflict())
-        {
-            ++nrOfUnsolvedConflicts;
-            if(ml.bWhiteSpaceConflict && pNrOfWhiteSpaceConflicts != nullptr)
-                ++*pNrOfWhiteSpaceConflicts;
-        }
-    }
+        *pNrOfWhiteSpaceConflicts = index.nofWhiteSpaceUnsolvedConflicts;
 
-    return nrOfUnsolvedConflicts;
+    return index.unsolvedConflicts.size();
 }
 
 void MergeResultWindow::showNrOfConflicts()
 {
     if(!m_pOptions->m_bShowInfoDialogs)
         return;
-    int nrOfConflicts = 0;
-    MergeLineList::iterator i;
-    for(i = m_mergeLineList.begin(); i != m_mergeLineList.end(); ++i)
-    {
-        if(i->bConflict || i->bDelta)
-            ++nrOfConflicts;
-    }
+    int nrOfConflicts = navigationIndex().nofDeltasAndConflicts;
     QString totalInfo;
     if(m_pTotalDiffStatus->isBinaryEqualAB() && m_pTotalDiffStatus->isBinaryEqualAC())
         totalInfo += i18n("All input files are binary equal.");
@@ -1020,6 +858,9 @@ void MergeResultWindow::showNrOfConflicts()
             totalInfo += i18n("Files %1 and %2 have equal text.\n", i18n("B"), i18n("C"));
     }
 
+    if(m_pTotalDiffStatus->isDiffDegraded())
+        totalInfo += i18n("The diff time limit was reached, differences may be shown larger than necessary.\n");
+
     int nrOfUnsolvedConflicts = getNrOfUnsolvedConflicts();
 
     KMessageBox::information(this,
@@ -1212,7 +1053,7 @@ bool findParenthesesGroups(const QString& s, QStringList& sl)
     return startPosStack.empty(); // false if parentheses don't match
 }
 
-QString calcHistorySortKey(const QString& keyOrder, QRegExp& matchedRegExpr, const QStringList& parenthesesGroupList)
+QString calcHistorySortKey(const QString& keyOrder, const QRegularExpressionMatch& match, const QStringList& parenthesesGroupList)
 {
     const QStringList keyOrderList = keyOrder.split(',');
     QString key;
@@ -1225,7 +1066,7 @@ QString calcHistorySortKey(const QString& keyOrder, QRegExp& matchedRegExpr, con
         int groupIdx = keyIt.toInt(&bOk);
         if(!bOk || groupIdx < 0 || groupIdx > parenthesesGroupList.size())
             continue;
-        QString s = matchedRegExpr.cap(groupIdx);
+        QString s = match.captured(groupIdx);
         if(groupIdx == 0)
         {
             key += s + ' ';
@@ -1273,15 +1114,15 @@ void MergeResultWindow::collectHistoryInformation(
     Diff3LineList::const_iterator id3l = iHistoryBegin;
     QString historyLead;
     {
-        const LineData* pld = id3l->getLineData(src);
+        const LineData* pld = id3l->getLineData(src, *m_pDiffBufferInfo);
 
         historyLead = Utils::calcHistoryLead(pld->getLine());
     }
-    QRegExp historyStart(m_pOptions->m_historyStartRegExp);
+    const QRegularExpression historyStart = m_regExpCache.exactMatch(m_pOptions->m_historyStartRegExp);
     if(id3l == iHistoryEnd)
         return;
     ++id3l; // Skip line with "$Log ... $"
-    QRegExp newHistoryEntry(m_pOptions->m_historyEntryStartRegExp);
+    const QRegularExpression newHistoryEntry = m_regExpCache.exactMatch(m_pOptions->m_historyEntryStartRegExp);
     QStringList parenthesesGroups;
     findParenthesesGroups(m_pOptions->m_historyEntryStartRegExp, parenthesesGroups);
     QString key;
@@ -1290,13 +1131,16 @@ void MergeResultWindow::collectHistoryInformation(
     bool bUseRegExp = !m_pOptions->m_historyEntryStartRegExp.isEmpty();
     for(; id3l != iHistoryEnd; ++id3l)
     {
-        const LineData* pld = id3l->getLineData(src);
+        const LineData* pld = id3l->getLineData(src, *m_pDiffBufferInfo);
         if(!pld) continue;
 
         const QString& oriLine = pld->getLine();
         if(historyLead.isEmpty()) historyLead = Utils::calcHistoryLead(oriLine);
         QString sLine = oriLine.mid(historyLead.length());
-        if((!bUseRegExp && !sLine.trimmed().isEmpty() && bPrevLineIsEmpty) || (bUseRegExp && newHistoryEntry.exactMatch(sLine)))
+        QRegularExpressionMatch newHistoryEntryMatch;
+        if(bUseRegExp)
+            newHistoryEntryMatch = newHistoryEntry.match(sLine);
+        if((!bUseRegExp && !sLine.trimmed().isEmpty() && bPrevLineIsEmpty) || (bUseRegExp && newHistoryEntryMatch.hasMatch()))
         {
             if(!key.isEmpty() && !melList.empty())
             {
@@ -1315,12 +1159,12 @@ void MergeResultWindow::collectHistoryInformation(
             if(!bUseRegExp)
                 key = sLine;
             else
-                key = calcHistorySortKey(m_pOptions->m_historyEntryStartSortKeyOrder, newHistoryEntry, parenthesesGroups);
+                key = calcHistorySortKey(m_pOptions->m_historyEntryStartSortKeyOrder, newHistoryEntryMatch, parenthesesGroups);
 
             melList.clear();
             melList.push_back(MergeEditLine(id3l, src));
         }
-        else if(!historyStart.exactMatch(oriLine))
+        else if(!historyStart.match(oriLine).hasMatch())
         {
             melList.push_back(MergeEditLine(id3l, src));
         }
@@ -1400,7 +1244,7 @@ void MergeResultWindow::slotMergeHistory()
     int d3lHistoryEndLineIdx = -1;
 
     // Search for history start, history end in the diff3LineList
-    m_pDiff3LineList->findHistoryRange(QRegExp(m_pOptions->m_historyStartRegExp), m_pldC != nullptr, iD3LHistoryBegin, iD3LHistoryEnd, d3lHistoryBeginLineIdx, d3lHistoryEndLineIdx);
+    m_pDiff3LineList->findHistoryRange(m_regExpCache.exactMatch(m_pOptions->m_historyStartRegExp), m_pldC != nullptr, *m_pDiffBufferInfo, iD3LHistoryBegin, iD3LHistoryEnd, d3lHistoryBeginLineIdx, d3lHistoryEndLineIdx);
 
     if(iD3LHistoryBegin != m_pDiff3LineList->end())
     {
@@ -1472,7 +1316,7 @@ void MergeResultWindow::slotMergeHistory()
         iMLLStart->mergeEditLineList.clear();
         // Now insert the complete history into the first MergeLine of the history
         iMLLStart->mergeEditLineList.push_back(MergeEditLine(iD3LHistoryBegin, m_pldC == nullptr ? e_SrcSelector::B : e_SrcSelector::C));
-        QString lead = Utils::calcHistoryLead(iD3LHistoryBegin->getString(e_SrcSelector::A));
+        QString lead = Utils::calcHistoryLead(iD3LHistoryBegin->getString(e_SrcSelector::A, *m_pDiffBufferInfo));
         MergeEditLine mel(m_pDiff3LineList->end());
         mel.setString(lead);
         iMLLStart->mergeEditLineList.push_back(mel);
@@ -1521,26 +1365,93 @@ void MergeResultWindow::slotMergeHistory()
     }
 }
 
+/*
+    Counts for each conflict in a range how many of its lines, from the first one on, match the
+    auto merge regular expression in all inputs.
+*/
+class RegExpAutoMergeRunnable : public TaskGroup::Task
+{
+  private:
+    const QRegularExpression m_regExp;
+    const bool m_bThreeInputs;
+    const DiffBufferInfo& m_bufferInfo;
+    const QVector<MergeLineList::iterator>& m_conflicts;
+    QVector<LineCount>& m_nofMatchingLines;
+    const int m_begin;
+    const int m_end;
+
+  public:
+    RegExpAutoMergeRunnable(TaskGroup& group, const QRegularExpression& regExp, bool bThreeInputs, const DiffBufferInfo& bufferInfo,
+                            const QVector<MergeLineList::iterator>& conflicts, QVector<LineCount>& nofMatchingLines, int begin, int end)
+        : Task(group), m_regExp(regExp), m_bThreeInputs(bThreeInputs), m_bufferInfo(bufferInfo), m_conflicts(conflicts),
+          m_nofMatchingLines(nofMatchingLines), m_begin(begin), m_end(end)
+    {
+    }
+
+  protected:
+    void execute() override
+    {
+        for(int i = m_begin; i < m_end && !isCancelled(); ++i)
+        {
+            const MergeLine& ml = *m_conflicts[i];
+            Diff3LineList::const_iterator id3l = ml.id3l;
+            LineCount nofLines = 0;
+            for(; nofLines < ml.srcRangeLength; ++nofLines, ++id3l)
+            {
+                if(!m_regExp.match(id3l->getString(e_SrcSelector::A, m_bufferInfo)).hasMatch() ||
+                   !m_regExp.match(id3l->getString(e_SrcSelector::B, m_bufferInfo)).hasMatch() ||
+                   (m_bThreeInputs && !m_regExp.match(id3l->getString(e_SrcSelector::C, m_bufferInfo)).hasMatch()))
+                    break;
+            }
+            m_nofMatchingLines[i] = nofLines;
+        }
+    }
+};
+
+/*
+    The conflicts are matched on all cores, then the matching lines at the start of each conflict
+    are solved with the last input and split off, each into a merge line of its own.
+*/
 void MergeResultWindow::slotRegExpAutoMerge()
 {
     if(m_pOptions->m_autoMergeRegExp.isEmpty())
         return;
 
-    QRegExp vcsKeywords(m_pOptions->m_autoMergeRegExp);
+    QVector<MergeLineList::iterator> conflicts;
     MergeLineList::iterator i;
     for(i = m_mergeLineList.begin(); i != m_mergeLineList.end(); ++i)
     {
         if(i->bConflict)
+            conflicts.push_back(i);
+    }
+
+    QVector<LineCount> nofMatchingLines(conflicts.size(), 0);
+    const QRegularExpression vcsKeywords = m_regExpCache.exactMatch(m_pOptions->m_autoMergeRegExp);
+    const int nofTasks = std::max(1, std::min(QThread::idealThreadCount(), conflicts.size()));
+    TaskGroup autoMergeTasks;
+    for(int taskIdx = 0; taskIdx < nofTasks; ++taskIdx)
+    {
+        autoMergeTasks.add(new RegExpAutoMergeRunnable(autoMergeTasks, vcsKeywords, m_pldC != nullptr, *m_pDiffBufferInfo, conflicts, nofMatchingLines,
+                                                       conflicts.size() * taskIdx / nofTasks, conflicts.size() * (taskIdx + 1) / nofTasks),
+                           TaskGroup::e_Priority::Visible);
+    }
+    autoMergeTasks.startPending();
+    autoMergeTasks.wait();
+
+    const e_SrcSelector src = m_pldC == nullptr ? e_SrcSelector::B : e_SrcSelector::C;
+    for(int conflictIdx = 0; conflictIdx < conflicts.size(); ++conflictIdx)
+    {
+        MergeLineList::iterator mlIt = conflicts[conflictIdx];
+        for(LineCount j = 0; j < nofMatchingLines[conflictIdx]; ++j)
         {
-            Diff3LineList::const_iterator id3l = i->id3l;
-            if(vcsKeywords.exactMatch(id3l->getString(e_SrcSelector::A)) &&
-               vcsKeywords.exactMatch(id3l->getString(e_SrcSelector::B)) &&
-               (m_pldC == nullptr || vcsKeywords.exactMatch(id3l->getString(e_SrcSelector::C))))
-            {
-                MergeEditLine& mel = *i->mergeEditLineList.begin();
-                mel.setSource(m_pldC == nullptr ? e_SrcSelector::B : e_SrcSelector::C, false);
-                splitAtDiff3LineIdx(i->d3lLineIdx + 1);
-            }
+            mlIt->mergeEditLineList.begin()->setSource(src, false);
+            if(mlIt->srcRangeLength <= 1)
+                break;
+
+            MergeLine newML;
+            mlIt->split(newML, mlIt->d3lLineIdx + 1);
+            ++mlIt;
+            mlIt = m_mergeLineList.insert(mlIt, newML);
         }
     }
     update();
@@ -1553,19 +1464,10 @@ void MergeResultWindow::slotRegExpAutoMerge()
 // Precondition: The VCS-keyword would also be C.
 bool MergeResultWindow::doRelevantChangesExist()
 {
-    if(m_pldC == nullptr || m_mergeLineList.size() <= 1)
+    if(m_pldC == nullptr)
         return true;
 
-    MergeLineList::iterator i;
-    for(i = m_mergeLineList.begin(); i != m_mergeLineList.end(); ++i)
-    {
-        if((i->bConflict && i->mergeEditLineList.begin()->src() != e_SrcSelector::C) || i->srcSelect == e_SrcSelector::B)
-        {
-            return true;
-        }
-    }
-
-    return false;
+    return m_mergeLineList.hasRelevantChanges();
 }
 
 // Returns the iterator to the MergeLine after the split
@@ -1664,7 +1566,28 @@ void MergeResultWindow::timerEvent(QTimerEvent*)
 
     if(m_bMyUpdate)
     {
-        update();
+        // Only the lines between the previous and the current end of the selection changed, the cursor follows it.
+        const int fontHeight = fontMetrics().lineSpacing();
+        LineRef firstLine = std::min(m_selection.getLastLine(), m_selection.getOldLastLine());
+        LineRef lastLine = std::max(m_selection.getLastLine(), m_selection.getOldLastLine());
+        if(m_selection.getOldFirstLine().isValid())
+        {
+            firstLine = std::min(firstLine, m_selection.getOldFirstLine());
+            lastLine = std::max(lastLine, m_selection.getOldFirstLine());
+        }
+
+        if(!m_selection.getOldLastLine().isValid() || !m_selection.getLastLine().isValid())
+        {
+            update();
+        }
+        else
+        {
+            const int y1 = (firstLine - m_firstLine) * fontHeight;
+            const int y2 = std::min(height(), (lastLine - m_firstLine + 1) * fontHeight);
+            if(y1 < height() && y2 > 0)
+                update(QRect(0, y1 - 1, width(), y2 - y1 + fontHeight)); // Some characters in exotic fonts exceed the regular bottom.
+        }
+        m_selection.clearOldSelection();
         m_bMyUpdate = false;
     }
 
@@ -1677,7 +1600,14 @@ void MergeResultWindow::timerEvent(QTimerEvent*)
     }
 }
 
-QVector<QTextLayout::FormatRange> MergeResultWindow::getTextLayoutForLine(int line, const QString& str, QTextLayout& textLayout)
+QVector<QTextLayout::FormatRange> MergeResultWindow::getTextLayoutForLine(int line, QTextLayout& textLayout)
+{
+    layoutText(textLayout);
+    positionTextLayout(textLayout);
+    return getSelectionFormat(line);
+}
+
+void MergeResultWindow::layoutText(QTextLayout& textLayout)
 {
     // tabs
     QTextOption textOption;
@@ -1698,13 +1628,29 @@ QVector<QTextLayout::FormatRange> MergeResultWindow::getTextLayoutForLine(int li
         QVector<QTextLayout::FormatRange> formats;
         QTextLayout::FormatRange formatRange;
         formatRange.start = 0;
-        formatRange.length = str.length();
+        formatRange.length = textLayout.text().length();
         formatRange.format.setFont(font());
         formats.append(formatRange);
         textLayout.setFormats(formats);
     }
-    QVector<QTextLayout::FormatRange> selectionFormat;
     textLayout.beginLayout();
+    QTextLine textLine = textLayout.createLine();
+    textLine.setPosition(QPointF(0, fontMetrics().leading()));
+    textLayout.endLayout();
+}
+
+void MergeResultWindow::positionTextLayout(QTextLayout& textLayout)
+{
+    int cursorWidth = 5;
+    if(m_pOptions->m_bRightToLeftLanguage)
+        textLayout.setPosition(QPointF(width() - textLayout.maximumWidth() - getTextXOffset() + m_horizScrollOffset - cursorWidth, 0));
+    else
+        textLayout.setPosition(QPointF(getTextXOffset() - m_horizScrollOffset, 0));
+}
+
+QVector<QTextLayout::FormatRange> MergeResultWindow::getSelectionFormat(int line)
+{
+    QVector<QTextLayout::FormatRange> selectionFormat;
     if(m_selection.lineWithin(line))
     {
         int firstPosInText = m_selection.firstPosInLine(line);
@@ -1720,17 +1666,26 @@ QVector<QTextLayout::FormatRange> MergeResultWindow::getTextLayoutForLine(int li
         selection.format.setForeground(palette().highlightedText().color());
         selectionFormat.push_back(selection);
     }
-    QTextLine textLine = textLayout.createLine();
-    textLine.setPosition(QPointF(0, fontMetrics().leading()));
-    textLayout.endLayout();
-    int cursorWidth = 5;
-    if(m_pOptions->m_bRightToLeftLanguage)
-        textLayout.setPosition(QPointF(width() - textLayout.maximumWidth() - getTextXOffset() + m_horizScrollOffset - cursorWidth, 0));
-    else
-        textLayout.setPosition(QPointF(getTextXOffset() - m_horizScrollOffset, 0));
     return selectionFormat;
 }
 
+// Like in DiffTextWindow the selection is given when drawing, so it does not change the layout.
+QTextLayout* MergeResultWindow::cachedTextLayout(int line, const QString& str)
+{
+    m_textLayoutCache.setSettings(TextLayoutCache::Settings{font(), m_pOptions->m_tabSize, m_pOptions->m_bShowWhiteSpaceCharacters, m_pOptions->m_bRightToLeftLanguage});
+
+    QTextLayout* pTextLayout = m_textLayoutCache.find(line, 0, str);
+    if(pTextLayout == nullptr)
+    {
+        pTextLayout = new QTextLayout(str, font(), this);
+        layoutText(*pTextLayout);
+        pTextLayout = m_textLayoutCache.insert(line, 0, pTextLayout);
+    }
+
+    positionTextLayout(*pTextLayout);
+    return pTextLayout;
+}
+
 void MergeResultWindow::writeLine(
     RLPainter& p, int line, const QString& str,
     e_SrcSelector srcSelect, e_MergeDetails mergeDetails, int rangeMark, bool bUserModified, bool bLineRemoved, bool bWhiteSpaceConflict)
@@ -1791,15 +1746,14 @@ void MergeResultWindow::writeLine(
 
         p.setPen(m_pOptions->m_fgColor);
 
-        QTextLayout textLayout(str, font(), this);
-        QVector<QTextLayout::FormatRange> selectionFormat = getTextLayoutForLine(line, str, textLayout);
-        textLayout.draw(&p, QPointF(0, yOffset), selectionFormat);
+        QTextLayout* pTextLayout = cachedTextLayout(line, str);
+        pTextLayout->draw(&p, QPointF(0, yOffset), getSelectionFormat(line));
 
         if(line == m_cursorYPos)
         {
-            m_cursorXPixelPos =  qCeil(textLayout.lineAt(0).cursorToX(m_cursorXPos));
+            m_cursorXPixelPos =  qCeil(pTextLayout->lineAt(0).cursorToX(m_cursorXPos));
             if(m_pOptions->m_bRightToLeftLanguage)
-                m_cursorXPixelPos +=  qCeil(textLayout.position().x() - m_horizScrollOffset);
+                m_cursorXPixelPos +=  qCeil(pTextLayout->position().x() - m_horizScrollOffset);
         }
 
         p.setClipping(false);
@@ -1871,7 +1825,7 @@ void MergeResultWindow::setPaintingAllowed(bool bPaintingAllowed)
         update();
 }
 
-void MergeResultWindow::paintEvent(QPaintEvent*)
+void MergeResultWindow::paintEvent(QPaintEvent* e)
 {
     if(m_pDiff3LineList == nullptr)
         return;
@@ -1882,20 +1836,27 @@ void MergeResultWindow::paintEvent(QPaintEvent*)
 
     if(!m_bCursorUpdate) // Don't redraw everything for blinking cursor?
     {
-        m_selection.bSelectionContainsData = false;
+        // The pixmap keeps the rest of the window, e.g. after scroll() in setFirstLine().
+        QRect invalidRect = e->rect();
         const auto dpr = devicePixelRatioF();
         if(size() * dpr != m_pixmap.size()) {
             m_pixmap = QPixmap(size() * dpr);
             m_pixmap.setDevicePixelRatio(dpr);
+            invalidRect = rect();
         }
+        // Lines that aren't drawn again may still hold selected text.
+        if(invalidRect.contains(rect()))
+            m_selection.bSelectionContainsData = false;
 
         RLPainter p(&m_pixmap, m_pOptions->m_bRightToLeftLanguage, width(), fontWidth);
         p.setFont(font());
-        p.QPainter::fillRect(rect(), m_pOptions->m_bgColor);
-
-        //int visibleLines = height() / fontHeight;
+        p.QPainter::setClipRect(invalidRect);
+        p.QPainter::fillRect(invalidRect, m_pOptions->m_bgColor);
 
-        int lastVisibleLine = m_firstLine + getNofVisibleLines() + 5;
+        // A line more on both sides for characters that exceed their line.
+        const int fontHeight = fm.lineSpacing();
+        const int firstDrawnLine = m_firstLine + invalidRect.top() / fontHeight - 1;
+        int lastVisibleLine = std::min(m_firstLine + getNofVisibleLines() + 5, m_firstLine + invalidRect.bottom() / fontHeight + 1);
         LineRef line = 0;
         MergeLineList::iterator mlIt = m_mergeLineList.begin();
         for(mlIt = m_mergeLineList.begin(); mlIt != m_mergeLineList.end(); ++mlIt)
@@ -1910,7 +1871,7 @@ void MergeResultWindow::paintEvent(QPaintEvent*)
                 MergeEditLineList::iterator melIt;
                 for(melIt = ml.mergeEditLineList.begin(); melIt != ml.mergeEditLineList.end(); ++melIt)
                 {
-                    if(line >= m_firstLine && line <= lastVisibleLine)
+                    if(line >= m_firstLine && line >= firstDrawnLine && line <= lastVisibleLine)
                     {
                         MergeEditLine& mel = *melIt;
                         MergeEditLineList::iterator melIt1 = melIt;
@@ -1958,9 +1919,7 @@ void MergeResultWindow::paintEvent(QPaintEvent*)
         painter.setPen(m_pOptions->m_fgColor);
 
         QString str = getString(m_cursorYPos);
-        QTextLayout textLayout(str, font(), this);
-        getTextLayoutForLine(m_cursorYPos, str, textLayout);
-        textLayout.drawCursor(&painter, QPointF(0, (m_cursorYPos - m_firstLine) * fontMetrics().lineSpacing()), m_cursorXPos);
+        cachedTextLayout(m_cursorYPos, str)->drawCursor(&painter, QPointF(0, (m_cursorYPos - m_firstLine) * fontMetrics().lineSpacing()), m_cursorXPos);
     }
 
     painter.end();
@@ -2030,10 +1989,9 @@ void MergeResultWindow::mousePressEvent(QMouseEvent* e)
     int xOffset = getTextXOffset();
 
     LineRef line = convertToLine(e->y());
-    QString s = getString(line);
-    QTextLayout textLayout(s, font(), this);
-    getTextLayoutForLine(line, s, textLayout);
-    QtNumberType pos = textLayout.lineAt(0).xToCursor(e->x() - textLayout.position().x());
+    // The layout the line was painted with, hit testing lays out nothing.
+    QTextLayout* pTextLayout = cachedTextLayout(line, getString(line));
+    QtNumberType pos = pTextLayout->lineAt(0).xToCursor(e->x() - pTextLayout->position().x());
 
     bool bLMB = e->button() == Qt::LeftButton;
     bool bMMB = e->button() == Qt::MidButton;
@@ -2083,9 +2041,9 @@ void MergeResultWindow::mousePressEvent(QMouseEvent* e)
             m_selection.end(line, pos);
         }
         m_cursorXPos = pos;
-        m_cursorXPixelPos =  qCeil(textLayout.lineAt(0).cursorToX(pos));
+        m_cursorXPixelPos =  qCeil(pTextLayout->lineAt(0).cursorToX(pos));
         if(m_pOptions->m_bRightToLeftLanguage)
-            m_cursorXPixelPos +=  qCeil(textLayout.position().x() - m_horizScrollOffset);
+            m_cursorXPixelPos +=  qCeil(pTextLayout->position().x() - m_horizScrollOffset);
         m_cursorOldXPixelPos = m_cursorXPixelPos;
         m_cursorYPos = line;
 
@@ -2112,9 +2070,8 @@ void MergeResultWindow::mouseDoubleClickEvent(QMouseEvent* e)
     {
         LineRef line = convertToLine(e->y());
         QString s = getString(line);
-        QTextLayout textLayout(s, font(), this);
-        getTextLayoutForLine(line, s, textLayout);
-        int pos = textLayout.lineAt(0).xToCursor(e->x() - textLayout.position().x());
+        QTextLayout* pTextLayout = cachedTextLayout(line, s);
+        int pos = pTextLayout->lineAt(0).xToCursor(e->x() - pTextLayout->position().x());
         m_cursorXPos = pos;
         m_cursorOldXPixelPos = m_cursorXPixelPos;
         m_cursorYPos = line;
@@ -2157,10 +2114,8 @@ void MergeResultWindow::mouseReleaseEvent(QMouseEvent* e)
 void MergeResultWindow::mouseMoveEvent(QMouseEvent* e)
 {
     LineRef line = convertToLine(e->y());
-    QString s = getString(line);
-    QTextLayout textLayout(s, font(), this);
-    getTextLayoutForLine(line, s, textLayout);
-    int pos = textLayout.lineAt(0).xToCursor(e->x() - textLayout.position().x());
+    QTextLayout* pTextLayout = cachedTextLayout(line, getString(line));
+    int pos = pTextLayout->lineAt(0).xToCursor(e->x() - pTextLayout->position().x());
     m_cursorXPos = pos;
     m_cursorOldXPixelPos = m_cursorXPixelPos;
     m_cursorYPos = line;
@@ -2211,7 +2166,17 @@ void MergeResultWindow::slotCursorUpdate()
         int topLineYOffset = 0;
         int yOffset = (m_cursorYPos - m_firstLine) * fm.lineSpacing() + topLineYOffset;
 
-        repaint(0, yOffset, width(), fm.lineSpacing() + 2);
+        // Only the few pixels around the cursor, see paintEvent().
+        QTextLayout* pTextLayout = cachedTextLayout(m_cursorYPos, getString(m_cursorYPos));
+        if(pTextLayout->lineCount() > 0)
+        {
+            const int x = qFloor(pTextLayout->position().x() + pTextLayout->lineAt(0).cursorToX(m_cursorXPos));
+            repaint(x - 2, yOffset, 5, fm.lineSpacing() + 2);
+        }
+        else
+        {
+            repaint(0, yOffset, width(), fm.lineSpacing() + 2);
+        }
 
         m_bCursorUpdate = false;
     }
@@ -2256,7 +2221,7 @@ void MergeResultWindow::keyPressEvent(QKeyEvent* e)
     int x = m_cursorXPos;
 
     QTextLayout textLayoutOrig(str, font(), this);
-    getTextLayoutForLine(y, str, textLayoutOrig);
+    getTextLayoutForLine(y, textLayoutOrig);
 
     bool bCtrl = (e->QInputEvent::modifiers() & Qt::ControlModifier) != 0;
     bool bShift = (e->QInputEvent::modifiers() & Qt::ShiftModifier) != 0;
@@ -2572,23 +2537,23 @@ void MergeResultWindow::keyPressEvent(QKeyEvent* e)
     else if(y > m_firstLine + getNofVisibleLines())
         newFirstLine = y - getNofVisibleLines();
 
-    QTextLayout textLayout(str, font(), this);
-    getTextLayoutForLine(m_cursorYPos, str, textLayout);
+    // Moving the cursor through a line lays it out once.
+    QTextLayout* pTextLayout = cachedTextLayout(y, str);
 
     // try to preserve cursor x pixel position when moving to another line
     if(bYMoveKey)
     {
         if(m_pOptions->m_bRightToLeftLanguage)
-            x = textLayout.lineAt(0).xToCursor(m_cursorOldXPixelPos - (textLayout.position().x() - m_horizScrollOffset));
+            x = pTextLayout->lineAt(0).xToCursor(m_cursorOldXPixelPos - (pTextLayout->position().x() - m_horizScrollOffset));
         else
-            x = textLayout.lineAt(0).xToCursor(m_cursorOldXPixelPos);
+            x = pTextLayout->lineAt(0).xToCursor(m_cursorOldXPixelPos);
     }
 
-    m_cursorXPixelPos =  qCeil(textLayout.lineAt(0).cursorToX(x));
+    m_cursorXPixelPos =  qCeil(pTextLayout->lineAt(0).cursorToX(x));
     int hF = 1; // horizontal factor
     if(m_pOptions->m_bRightToLeftLanguage)
     {
-        m_cursorXPixelPos +=  qCeil(textLayout.position().x() - m_horizScrollOffset);
+        m_cursorXPixelPos +=  qCeil(pTextLayout->position().x() - m_horizScrollOffset);
         hF = -1;
     }
     int cursorWidth = 5;
@@ -2612,9 +2577,9 @@ void MergeResultWindow::keyPressEvent(QKeyEvent* e)
     m_cursorXPos = newCursorX;
 
     // TODO if width of current line exceeds the current maximum width then force recalculating the scrollbars
-    if(textLayout.maximumWidth() > getMaxTextWidth())
+    if(pTextLayout->maximumWidth() > getMaxTextWidth())
     {
-        m_maxTextWidth =  qCeil(textLayout.maximumWidth());
+        m_maxTextWidth =  qCeil(pTextLayout->maximumWidth());
         Q_EMIT resizeSignal();
     }
     if(!bYMoveKey)
@@ -2637,22 +2602,8 @@ void MergeResultWindow::calcIteratorFromLineNr(
     MergeLineList::iterator& mlIt,
     MergeEditLineList::iterator& melIt)
 {
-    for(mlIt = m_mergeLineList.begin(); mlIt != m_mergeLineList.end(); ++mlIt)
-    {
-        MergeLine& ml = *mlIt;
-        if(line > ml.mergeEditLineList.size())
-        {
-            line -= ml.mergeEditLineList.size();
-        }
-        else
-        {
-            for(melIt = ml.mergeEditLineList.begin(); melIt != ml.mergeEditLineList.end(); ++melIt)
-            {
-                --line;
-                if(line < 0) return;
-            }
-        }
-    }
+    if(!m_mergeLineIndex.find(m_mergeLineList, std::max(line, 0), mlIt, melIt))
+        mlIt = m_mergeLineList.end();
 }
 
 QString MergeResultWindow::getSelection()
@@ -2937,47 +2888,7 @@ bool MergeResultWindow::saveDocument(const QString& fileName, QTextCodec* pEncod
         }
     }
 
-    QByteArray dataArray;
-    QTextStream textOutStream(&dataArray, QIODevice::WriteOnly);
-    if(pEncoding->name() == "UTF-8")
-        textOutStream.setGenerateByteOrderMark(false); // Shouldn't be necessary. Bug in Qt or docs
-    else
-        textOutStream.setGenerateByteOrderMark(true); // Only for UTF-16
-    textOutStream.setCodec(pEncoding);
-
-    int line = 0;
-    MergeLineList::iterator mlIt = m_mergeLineList.begin();
-    for(mlIt = m_mergeLineList.begin(); mlIt != m_mergeLineList.end(); ++mlIt)
-    {
-        MergeLine& ml = *mlIt;
-        MergeEditLineList::iterator melIt;
-        for(melIt = ml.mergeEditLineList.begin(); melIt != ml.mergeEditLineList.end(); ++melIt)
-        {
-            MergeEditLine& mel = *melIt;
-
-            if(mel.isEditableText())
-            {
-                QString str = mel.getString(m_pldA, m_pldB, m_pldC);
-
-                if(line > 0) // Prepend line feed, but not for first line
-                {
-                    if(eLineEndStyle == eLineEndStyleDos)
-                    {
-                        str.prepend("\r\n");
-                    }
-                    else
-                    {
-                        str.prepend("\n");
-                    }
-                }
-
-                textOutStream << str;
-                ++line;
-            }
-        }
-    }
-    textOutStream.flush();
-    bool bSuccess = file.writeFile(dataArray.data(), dataArray.size());
+    const bool bSuccess = m_mergeLineList.writeFile(file, pEncoding, eLineEndStyle, m_pldA, m_pldB, m_pldC);
     if(!bSuccess)
     {
         KMessageBox::error(this, i18n("Error while writing."), i18n("File Save Error"));
@@ -3128,43 +3039,7 @@ void WindowTitleWidget::setLineEndStyles(e_LineEndStyle eLineEndStyleA, e_LineEn
     m_pLineEndStyleSelector->addItem(i18n("Unix") + (unxUsers.isEmpty() ? QString("") : QLatin1String(" (") + unxUsers + QLatin1String(")")));
     m_pLineEndStyleSelector->addItem(i18n("DOS") + (dosUsers.isEmpty() ? QString("") : QLatin1String(" (") + dosUsers + QLatin1String(")")));
 
-    e_LineEndStyle autoChoice = (e_LineEndStyle)m_pOptions->m_lineEndStyle;
-
-    if(m_pOptions->m_lineEndStyle == eLineEndStyleAutoDetect)
-    {
-        if(eLineEndStyleA != eLineEndStyleUndefined && eLineEndStyleB != eLineEndStyleUndefined && eLineEndStyleC != eLineEndStyleUndefined)
-        {
-            if(eLineEndStyleA == eLineEndStyleB)
-                autoChoice = eLineEndStyleC;
-            else if(eLineEndStyleA == eLineEndStyleC)
-                autoChoice = eLineEndStyleB;
-            else
-                autoChoice = eLineEndStyleConflict; //conflict (not likely while only two values exist)
-        }
-        else
-        {
-            e_LineEndStyle c1, c2;
-            if(eLineEndStyleA == eLineEndStyleUndefined)
-            {
-                c1 = eLineEndStyleB;
-                c2 = eLineEndStyleC;
-            }
-            else if(eLineEndStyleB == eLineEndStyleUndefined)
-            {
-                c1 = eLineEndStyleA;
-                c2 = eLineEndStyleC;
-            }
-            else /*if( eLineEndStyleC == eLineEndStyleUndefined )*/
-            {
-                c1 = eLineEndStyleA;
-                c2 = eLineEndStyleB;
-            }
-            if(c1 == c2 && c1 != eLineEndStyleUndefined)
-                autoChoice = c1;
-            else
-                autoChoice = eLineEndStyleConflict;
-        }
-    }
+    const e_LineEndStyle autoChoice = FullAnalysis::outputLineEndStyle(m_pOptions, eLineEndStyleA, eLineEndStyleB, eLineEndStyleC);
 
     if(autoChoice == eLineEndStyleUnix)
         m_pLineEndStyleSelector->setCurrentIndex(0);
@@ -3189,11 +3064,8 @@ e_LineEndStyle WindowTitleWidget::getLineEndStyle()
         return eLineEndStyleConflict;
 }
 
-void WindowTitleWidget::setEncodings(QTextCodec* pCodecForA, QTextCodec* pCodecForB, QTextCodec* pCodecForC)
+static std::map<QString, QTextCodec*> sortedCodecs()
 {
-    m_pEncodingSelector->clear();
-
-    // First sort codec names:
     std::map<QString, QTextCodec*> names;
     QList<int> mibs = QTextCodec::availableMibs();
     for(int i: mibs)
@@ -3202,6 +3074,15 @@ void WindowTitleWidget::setEncodings(QTextCodec* pCodecForA, QTextCodec* pCodecF
         if(c != nullptr)
             names[QLatin1String(c->name())] = c;
     }
+    return names;
+}
+
+void WindowTitleWidget::setEncodings(QTextCodec* pCodecForA, QTextCodec* pCodecForB, QTextCodec* pCodecForC)
+{
+    m_pEncodingSelector->clear();
+
+    // Looking up all codecs takes a while, the list is made for the first comparison only.
+    static const std::map<QString, QTextCodec*> names = sortedCodecs();
 
     if(pCodecForA != nullptr)
         m_pEncodingSelector->addItem(i18n("Codec from A: %1", QLatin1String(pCodecForA->name())), QVariant::fromValue((void*)pCodecForA));
@@ -3210,7 +3091,7 @@ void WindowTitleWidget::setEncodings(QTextCodec* pCodecForA, QTextCodec* pCodecF
     if(pCodecForC != nullptr)
         m_pEncodingSelector->addItem(i18n("Codec from C: %1", QLatin1String(pCodecForC->name())), QVariant::fromValue((void*)pCodecForC));
 
-    std::map<QString, QTextCodec*>::iterator it;
+    std::map<QString, QTextCodec*>::const_iterator it;
     for(it = names.begin(); it != names.end(); ++it)
     {
         m_pEncodingSelector->addItem(it->first, QVariant::fromValue((void*)it->second));
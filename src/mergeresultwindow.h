@@ -13,11 +13,14 @@
 #include "FileNameLineEdit.h"
 #include "MergeEditLine.h"
 #include "Overview.h"
-
+#include "RegExpCache.h"
 #include "selection.h"
+#include "TextLayoutCache.h"
+#include "TextWidthCache.h"
 
 #include <boost/signals2.hpp>
 
+#include <QHash>
 #include <QLineEdit>
 #include <QPointer>
 #include <QStatusBar>
@@ -46,7 +49,9 @@ class MergeResultWindow : public QWidget
         const QVector<LineData>* pLineDataB, LineRef sizeB,
         const QVector<LineData>* pLineDataC, LineRef sizeC,
         const Diff3LineList* pDiff3LineList,
-        TotalDiffStatus* pTotalDiffStatus
+        const QSharedPointer<DiffBufferInfo>& pDiffBufferInfo,
+        TotalDiffStatus* pTotalDiffStatus,
+        bool bAutoSolve
     );
 
     void setupConnections(const KDiff3App* app);
@@ -56,6 +61,8 @@ class MergeResultWindow : public QWidget
         m_mergeLineList.clear();
     }
 
+    qint64 memoryUsage() const { return m_mergeLineList.memoryUsage(); }
+
     static void initActions(KActionCollection* ac);
 
     void connectActions() const;
@@ -84,7 +91,7 @@ class MergeResultWindow : public QWidget
     void setSelection(int firstLine, int startPos, int lastLine, int endPos);
     e_OverviewMode getOverviewMode();
 
-    void slotUpdateAvailabilities();
+    void slotUpdateAvailabilities(bool bTripleDiff);
 
   public Q_SLOTS:
     void setOverviewMode(e_OverviewMode eOverviewMode);
@@ -167,6 +174,7 @@ class MergeResultWindow : public QWidget
     LineRef m_sizeC = 0;
 
     const Diff3LineList* m_pDiff3LineList = nullptr;
+    QSharedPointer<DiffBufferInfo> m_pDiffBufferInfo; // Of m_pDiff3LineList, for the texts of its lines
     TotalDiffStatus* m_pTotalDiffStatus = nullptr;
 
     int m_delayedDrawTimer = 0;
@@ -174,7 +182,6 @@ class MergeResultWindow : public QWidget
     QString m_persistentStatusMessage;
 
   private:
-    static bool sameKindCheck(const MergeLine& ml1, const MergeLine& ml2);
     struct HistoryMapEntry {
         MergeEditLineList mellA;
         MergeEditLineList mellB;
@@ -198,6 +205,31 @@ class MergeResultWindow : public QWidget
     int m_currentPos;
     bool checkOverviewIgnore(MergeLineList::iterator& i);
 
+    struct NavigationIndex
+    {
+        bool bValid = false;
+        int changeCount = 0;
+        int sizeChangeCount = 0;
+        bool bSkipWhiteConflicts = false;
+        e_OverviewMode overviewMode = e_OverviewMode::eOMNormal;
+
+        QVector<MergeLineList::iterator> mergeLines;
+        QHash<const MergeLine*, int> positions;
+        // Positions in mergeLines in ascending order
+        QVector<int> deltas;
+        QVector<int> conflicts;
+        QVector<int> unsolvedConflicts;
+        int nofWhiteSpaceUnsolvedConflicts = 0;
+        int nofDeltasAndConflicts = 0;
+
+        // Position of i in mergeLines, the end is after the last one.
+        int position(const MergeLineList& mergeLineList, MergeLineList::const_iterator i) const;
+    };
+    NavigationIndex m_navigationIndex;
+    const NavigationIndex& navigationIndex();
+    bool isAboveCurrent(const QVector<int>& positions);
+    bool isBelowCurrent(const QVector<int>& positions);
+
     enum e_Direction
     {
         eUp,
@@ -221,7 +253,12 @@ class MergeResultWindow : public QWidget
     void paintEvent(QPaintEvent* e) override;
 
     int getTextXOffset();
-    QVector<QTextLayout::FormatRange> getTextLayoutForLine(int line, const QString& s, QTextLayout& textLayout);
+    QVector<QTextLayout::FormatRange> getTextLayoutForLine(int line, QTextLayout& textLayout);
+    void layoutText(QTextLayout& textLayout);
+    void positionTextLayout(QTextLayout& textLayout);
+    QVector<QTextLayout::FormatRange> getSelectionFormat(int line);
+    // A laid out line from m_textLayoutCache, only valid until the next call.
+    QTextLayout* cachedTextLayout(int line, const QString& str);
     void myUpdate(int afterMilliSecs);
     void timerEvent(QTimerEvent*) override;
     void writeLine(
@@ -264,6 +301,10 @@ class MergeResultWindow : public QWidget
     QStatusBar* m_pStatusBar;
 
     Selection m_selection;
+    TextLayoutCache m_textLayoutCache;
+    TextWidthCache m_textWidthCache;
+    MergeLineIndex m_mergeLineIndex;
+    RegExpCache m_regExpCache;
 
     bool deleteSelection2(QString& str, int& x, int& y,
                           MergeLineList::iterator& mlIt, MergeEditLineList::iterator& melIt);
@@ -21,11 +21,9 @@
 #include <KMessageBox>
 #include <KToolBar>
 
-#include <QApplication>
 #include <QCheckBox>
 #include <QComboBox>
 #include <QDialogButtonBox>
-#include <QFontDatabase>
 #include <QFontDialog>
 #include <QFrame>
 #include <QGridLayout>
@@ -33,7 +31,6 @@
 #include <QLabel>
 #include <QLayout>
 #include <QLineEdit>
-#include <QPixmap>
 #include <QPlainTextEdit>
 #include <QPointer>
 #include <QPushButton>
@@ -59,38 +56,47 @@ const QString OptionDialog::s_historyStartRegExpToolTip = i18n("Regular expressi
                                            "Usually this line contains the \"$Log$\" keyword.\n"
                                            "Default value: \".*\\$Log.*\\$.*\"");
 
-class OptionCheckBox : public QCheckBox, public OptionBool
+/*
+    The widget of a setting of Options. The value and the default come from the setting, apply()
+    changes it.
+*/
+class OptionWidget
 {
   public:
-    OptionCheckBox(const QString& text, bool bDefaultVal, const QString& saveName, bool* pbVar,
-                   QWidget* pParent)
-        : QCheckBox(text, pParent), OptionBool(pbVar, bDefaultVal, saveName)
-    {}
-    void setToDefault() override { setChecked(getDefault()); }
-    void setToCurrent() override { setChecked(getCurrent()); }
+    virtual ~OptionWidget() {}
+    virtual void setToDefault() = 0;
+    virtual void setToCurrent() = 0;
+    virtual void apply() = 0;
+};
 
-    using OptionBool::apply;
-    void apply() override { apply(isChecked()); }
+class OptionCheckBox : public QCheckBox, public OptionWidget
+{
+  public:
+    OptionCheckBox(const QString& text, OptionBool* pItem, QWidget* pParent)
+        : QCheckBox(text, pParent), m_pItem(pItem)
+    {}
+    void setToDefault() override { setChecked(m_pItem->getDefault()); }
+    void setToCurrent() override { setChecked(m_pItem->getCurrent()); }
+    void apply() override { m_pItem->apply(isChecked()); }
 
   private:
     Q_DISABLE_COPY(OptionCheckBox)
+    OptionBool* m_pItem;
 };
 
-class OptionRadioButton : public QRadioButton, public OptionBool
+class OptionRadioButton : public QRadioButton, public OptionWidget
 {
   public:
-    OptionRadioButton(const QString& text, bool bDefaultVal, const QString& saveName, bool* pbVar,
-                      QWidget* pParent)
-        : QRadioButton(text, pParent), OptionBool(pbVar, bDefaultVal, saveName)
+    OptionRadioButton(const QString& text, OptionBool* pItem, QWidget* pParent)
+        : QRadioButton(text, pParent), m_pItem(pItem)
     {}
-    void setToDefault() override { setChecked(getDefault()); }
-    void setToCurrent() override { setChecked(getCurrent()); }
-
-    using OptionBool::apply;
-    void apply() override { apply(isChecked()); }
+    void setToDefault() override { setChecked(m_pItem->getDefault()); }
+    void setToCurrent() override { setChecked(m_pItem->getCurrent()); }
+    void apply() override { m_pItem->apply(isChecked()); }
 
   private:
     Q_DISABLE_COPY(OptionRadioButton)
+    OptionBool* m_pItem;
 };
 
 FontChooser::FontChooser(QWidget* pParent)
@@ -140,98 +146,73 @@ void FontChooser::slotSelectFont()
     m_pLabel->setText(i18n("Font: %1, %2, %3\n\nExample:", m_font.family(), m_font.styleName(), m_font.pointSize()));
 }
 
-class OptionFontChooser : public FontChooser, public OptionFont
+class OptionFontChooser : public FontChooser, public OptionWidget
 {
   public:
-    OptionFontChooser(const QFont& defaultVal, const QString& saveName, QFont* pVar, QWidget* pParent) : FontChooser(pParent),
-                                                                                                                            OptionFont(pVar, defaultVal, saveName)
+    OptionFontChooser(OptionFont* pItem, QWidget* pParent)
+        : FontChooser(pParent), m_pItem(pItem)
     {}
 
-    void setToDefault() override { setFont(getDefault(), false); }
-    void setToCurrent() override { setFont(getCurrent(), false); }
-    using OptionFont::apply;
-    void apply() override { apply(font()); }
+    void setToDefault() override { setFont(m_pItem->getDefault(), false); }
+    void setToCurrent() override { setFont(m_pItem->getCurrent(), false); }
+    void apply() override { m_pItem->apply(font()); }
   private:
     Q_DISABLE_COPY(OptionFontChooser)
+    OptionFont* m_pItem;
 };
 
-class OptionColorButton : public KColorButton, public OptionColor
+class OptionColorButton : public KColorButton, public OptionWidget
 {
   public:
-    OptionColorButton(const QColor &defaultVal, const QString& saveName, QColor* pVar, QWidget* pParent)
-        : KColorButton(pParent), OptionColor(pVar, defaultVal, saveName)
+    OptionColorButton(OptionColor* pItem, QWidget* pParent)
+        : KColorButton(pParent), m_pItem(pItem)
     {}
 
-    void setToDefault() override { setColor(getDefault()); }
-    void setToCurrent() override { setColor(getCurrent()); }
-    using OptionColor::apply;
-    void apply() override { apply(color()); }
+    void setToDefault() override { setColor(m_pItem->getDefault()); }
+    void setToCurrent() override { setColor(m_pItem->getCurrent()); }
+    void apply() override { m_pItem->apply(color()); }
 
   private:
     Q_DISABLE_COPY(OptionColorButton)
+    OptionColor* m_pItem;
 };
 
-class OptionLineEdit : public QComboBox, public OptionString
+class OptionLineEdit : public QComboBox, public OptionWidget
 {
   public:
-    OptionLineEdit(const QString& defaultVal, const QString& saveName, QString* pVar,
-                   QWidget* pParent)
-        : QComboBox(pParent), OptionString(pVar, defaultVal, saveName)
+    OptionLineEdit(OptionStringHistory* pItem, QWidget* pParent)
+        : QComboBox(pParent), m_pItem(pItem)
     {
         setMinimumWidth(50);
         setEditable(true);
-        m_list.push_back(defaultVal);
-        insertText();
     }
     void setToDefault() override
     {
-        setEditText(getDefault());
+        setEditText(m_pItem->getDefault());
     }
     void setToCurrent() override
     {
-        setEditText(getCurrent());
+        clear();
+        insertItems(0, m_pItem->getHistory());
+        setEditText(m_pItem->getCurrent());
     }
-
-    using OptionString::apply;
     void apply() override
     {
-        apply(currentText());
-        insertText();
-    }
-    void write(ValueMap* config) const override
-    {
-        config->writeEntry(m_saveName, m_list);
-    }
-    void read(ValueMap* config) override
-    {
-        m_list = config->readEntry(m_saveName, QStringList(m_defaultVal));
-        if(!m_list.empty()) setCurrent(m_list.front());
-        clear();
-        insertItems(0, m_list);
+        // Moves the text to the front of the history.
+        m_pItem->apply(currentText());
+        setToCurrent();
     }
 
   private:
-    void insertText()
-    { // Check if the text exists. If yes remove it and push it in as first element
-        QString current = currentText();
-        m_list.removeAll(current);
-        m_list.push_front(current);
-        clear();
-        if(m_list.size() > 10)
-            m_list.erase(m_list.begin() + 10, m_list.end());
-        insertItems(0, m_list);
-    }
-
     Q_DISABLE_COPY(OptionLineEdit)
-    QStringList m_list;
+    OptionStringHistory* m_pItem;
 };
 
-class OptionIntEdit : public QLineEdit, public OptionNum<int>
+class OptionIntEdit : public QLineEdit, public OptionWidget
 {
   public:
-    OptionIntEdit(int defaultVal, const QString& saveName, int* pVar, int rangeMin, int rangeMax,
-                  QWidget* pParent)
-        : QLineEdit(pParent), OptionNum<int>(pVar, defaultVal, saveName)
+    OptionIntEdit(OptionInt* pItem, int rangeMin, int rangeMax, QWidget* pParent)
+        : QLineEdit(pParent), m_pItem(pItem)
     {
         QIntValidator* v = new QIntValidator(this);
         v->setRange(rangeMin, rangeMax);
@@ -240,145 +221,56 @@ class OptionIntEdit : public QLineEdit, public OptionNum<int>
     void setToDefault() override
     {
         //QString::setNum does not account for locale settings
-        setText(OptionNum::toString(getDefault()));
+        setText(OptionInt::toString(m_pItem->getDefault()));
     }
 
     void setToCurrent() override
     {
-        setText(getString());
+        setText(m_pItem->getString());
     }
 
-    using OptionNum<int>::apply;
     void apply() override
     {
         const QIntValidator* v = static_cast<const QIntValidator*>(validator());
-        setCurrent( qBound(v->bottom(), text().toInt(), v->top()) );
+        m_pItem->apply(qBound(v->bottom(), text().toInt(), v->top()));
 
-        setText(getString());
+        setText(m_pItem->getString());
     }
 
   private:
     Q_DISABLE_COPY(OptionIntEdit)
+    OptionInt* m_pItem;
 };
 
-class OptionComboBox : public QComboBox, public OptionItemBase
+// The setting is the index of the chosen entry.
+class OptionComboBox : public QComboBox, public OptionWidget
 {
   public:
-    OptionComboBox(int defaultVal, const QString& saveName, int* pVarNum,
-                   QWidget* pParent)
-        : QComboBox(pParent), OptionItemBase(saveName)
+    OptionComboBox(OptionInt* pItem, QWidget* pParent)
+        : QComboBox(pParent), m_pItem(pItem)
     {
         setMinimumWidth(50);
-        m_pVarNum = pVarNum;
-        m_pVarStr = nullptr;
-        m_defaultVal = defaultVal;
-        setEditable(false);
-    }
-    OptionComboBox(int defaultVal, const QString& saveName, QString* pVarStr,
-                   QWidget* pParent)
-        : QComboBox(pParent), OptionItemBase(saveName)
-    {
-        m_pVarNum = nullptr;
-        m_pVarStr = pVarStr;
-        m_defaultVal = defaultVal;
         setEditable(false);
     }
-    void setToDefault() override
-    {
-        setCurrentIndex(m_defaultVal);
-        if(m_pVarStr != nullptr) {
-            *m_pVarStr = currentText();
-        }
-    }
-    void setToCurrent() override
-    {
-        if(m_pVarNum != nullptr)
-            setCurrentIndex(*m_pVarNum);
-        else
-            setText(*m_pVarStr);
-    }
-    using OptionItemBase::apply;
-    void apply() override
-    {
-        if(m_pVarNum != nullptr) {
-            *m_pVarNum = currentIndex();
-        }
-        else
-        {
-            *m_pVarStr = currentText();
-        }
-    }
-    void write(ValueMap* config) const override
-    {
-        if(m_pVarStr != nullptr)
-            config->writeEntry(m_saveName, *m_pVarStr);
-        else
-            config->writeEntry(m_saveName, *m_pVarNum);
-    }
-    void read(ValueMap* config) override
-    {
-        if(m_pVarStr != nullptr)
-            setText(config->readEntry(m_saveName, currentText()));
-        else
-            *m_pVarNum = config->readEntry(m_saveName, *m_pVarNum);
-    }
-    void preserve() override
-    {
-        if(m_pVarStr != nullptr) {
-            m_preservedStrVal = *m_pVarStr;
-        }
-        else
-        {
-            m_preservedNumVal = *m_pVarNum;
-        }
-    }
-    void unpreserve() override
-    {
-        if(m_pVarStr != nullptr) {
-            *m_pVarStr = m_preservedStrVal;
-        }
-        else
-        {
-            *m_pVarNum = m_preservedNumVal;
-        }
-    }
+    void setToDefault() override { setCurrentIndex(m_pItem->getDefault()); }
+    void setToCurrent() override { setCurrentIndex(m_pItem->getCurrent()); }
+    void apply() override { m_pItem->apply(currentIndex()); }
 
   private:
     Q_DISABLE_COPY(OptionComboBox)
-    int* m_pVarNum;
-    int m_preservedNumVal = 0;
-    QString* m_pVarStr;
-    QString m_preservedStrVal;
-    int m_defaultVal;
-
-    void setText(const QString& s)
-    {
-        // Find the string in the combobox-list, don't change the value if nothing fits.
-        for(int i = 0; i < count(); ++i)
-        {
-            if(itemText(i) == s)
-            {
-                if(m_pVarNum != nullptr) *m_pVarNum = i;
-                if(m_pVarStr != nullptr) *m_pVarStr = s;
-                setCurrentIndex(i);
-                return;
-            }
-        }
-    }
+    OptionInt* m_pItem;
 };
 
-class OptionEncodingComboBox : public QComboBox, public OptionCodec
+class OptionEncodingComboBox : public QComboBox, public OptionWidget
 {
     Q_OBJECT
     QVector<QTextCodec*> m_codecVec;
-    QTextCodec** m_ppVarCodec;
+    OptionCodecPointer* m_pItem;
 
   public:
-    OptionEncodingComboBox(const QString& saveName, QTextCodec** ppVarCodec,
-                           QWidget* pParent)
-        : QComboBox(pParent), OptionCodec(saveName)
+    OptionEncodingComboBox(OptionCodecPointer* pItem, QWidget* pParent)
+        : QComboBox(pParent), m_pItem(pItem)
     {
-        m_ppVarCodec = ppVarCodec;
         insertCodec(i18n("Unicode, 8 bit"), QTextCodec::codecForName("UTF-8"));
         insertCodec(i18n("Unicode"), QTextCodec::codecForName("iso-10646-UCS-2"));
         insertCodec(i18n("Latin1"), QTextCodec::codecForName("iso 8859-1"));
@@ -415,74 +307,44 @@ class OptionEncodingComboBox : public QComboBox, public OptionCodec
                     return; // don't insert any codec twice
             }
 
-            // The m_codecVec.size will at this point return the value we need for the index.
-            if(codecName == defaultName())
-                saveDefaultIndex(m_codecVec.size());
             QString itemText = visibleCodecName.isEmpty() ? codecName : visibleCodecName + QLatin1String(" (") + codecName + QLatin1String(")");
             addItem(itemText, m_codecVec.size());
             m_codecVec.push_back(c);
         }
     }
-    void setToDefault() override
-    {
-        int index = getDefaultIndex();
+    void setToDefault() override { setCodec(m_pItem->getDefault()); }
+    void setToCurrent() override { setCodec(m_pItem->getCurrent()); }
+    void apply() override { m_pItem->apply(m_codecVec[currentIndex()]); }
 
-        setCurrentIndex(index);
-        if(m_ppVarCodec != nullptr) {
-            *m_ppVarCodec = m_codecVec[index];
-        }
-    }
-    void setToCurrent() override
-    {
-        if(m_ppVarCodec != nullptr)
-        {
-            for(int i = 0; i < m_codecVec.size(); ++i)
-            {
-                if(*m_ppVarCodec == m_codecVec[i])
-                {
-                    setCurrentIndex(i);
-                    break;
-                }
-            }
-        }
-    }
-    using OptionCodec::apply;
-    void apply() override
-    {
-        if(m_ppVarCodec != nullptr) {
-            *m_ppVarCodec = m_codecVec[currentIndex()];
-        }
-    }
-    void write(ValueMap* config) const override
-    {
-        if(m_ppVarCodec != nullptr) config->writeEntry(m_saveName, (const char*)(*m_ppVarCodec)->name());
-    }
-    void read(ValueMap* config) override
+  private:
+    void setCodec(QTextCodec* pCodec)
     {
-        QString codecName = config->readEntry(m_saveName, (const char*)m_codecVec[currentIndex()]->name());
         for(int i = 0; i < m_codecVec.size(); ++i)
         {
-            if(codecName == QLatin1String(m_codecVec[i]->name()))
+            if(pCodec == m_codecVec[i])
             {
                 setCurrentIndex(i);
-                if(m_ppVarCodec != nullptr) *m_ppVarCodec = m_codecVec[i];
                 break;
             }
         }
     }
-
-  protected:
-    void preserve() override { m_preservedVal = currentIndex(); }
-    void unpreserve() override { setCurrentIndex(m_preservedVal); }
-    int m_preservedVal;
 };
 
-void OptionDialog::addOptionItem(OptionItemBase* p)
+void OptionDialog::addOptionWidget(OptionWidget* p)
+{
+    m_optionWidgets.push_back(p);
+}
+
+template <class T>
+T* OptionDialog::findItem(const char* saveName) const
 {
-    m_options->addOptionItem(p);
+    T* pItem = dynamic_cast<T*>(m_options->findItem(QLatin1String(saveName)));
+    Q_ASSERT(pItem != nullptr);
+    return pItem;
 }
 
-OptionDialog::OptionDialog(bool bShowDirMergeSettings, QWidget* parent) : KPageDialog(parent)
+OptionDialog::OptionDialog(bool bShowDirMergeSettings, const QSharedPointer<Options>& pOptions, QWidget* parent)
+    : KPageDialog(parent), m_options(pOptions)
 {
     setFaceType(List);
     setWindowTitle(i18n("Configure"));
@@ -494,22 +356,19 @@ OptionDialog::OptionDialog(bool bShowDirMergeSettings, QWidget* parent) : KPageD
     //showButtonSeparator( true );
     //setHelp( "kdiff3/index.html", QString::null );
 
-    m_options->init();
     setupFontPage();
     setupColorPage();
     setupEditPage();
     setupDiffPage();
     setupMergePage();
-    setupOtherOptions();
     if(bShowDirMergeSettings)
         setupDirectoryMergePage();
 
     setupRegionalPage();
     setupIntegrationPage();
 
-    // Initialize all values in the dialog
-    resetToDefaults();
-    slotApply();
+    // The settings are read already.
+    setState();
     chk_connect_a(button(QDialogButtonBox::Apply), &QPushButton::clicked, this, &OptionDialog::slotApply);
     chk_connect_a(button(QDialogButtonBox::Ok), &QPushButton::clicked, this, &OptionDialog::slotOk);
     chk_connect_a(button(QDialogButtonBox::RestoreDefaults), &QPushButton::clicked, this, &OptionDialog::slotDefault);
@@ -529,25 +388,6 @@ OptionDialog::~OptionDialog()
 {
 }
 
-void OptionDialog::setupOtherOptions()
-{
-    //TODO move to Options class
-    addOptionItem(new OptionToggleAction(false, "AutoAdvance", &m_options->m_bAutoAdvance));
-    addOptionItem(new OptionToggleAction(true, "ShowWhiteSpaceCharacters", &m_options->m_bShowWhiteSpaceCharacters));
-    addOptionItem(new OptionToggleAction(true, "ShowWhiteSpace", &m_options->m_bShowWhiteSpace));
-    addOptionItem(new OptionToggleAction(false, "ShowLineNumbers", &m_options->m_bShowLineNumbers));
-    addOptionItem(new OptionToggleAction(true, "HorizDiffWindowSplitting", &m_options->m_bHorizDiffWindowSplitting));
-    addOptionItem(new OptionToggleAction(false, "WordWrap", &m_options->m_bWordWrap));
-
-    addOptionItem(new OptionToggleAction(true, "ShowIdenticalFiles", &m_options->m_bDmShowIdenticalFiles));
-
-    addOptionItem(new OptionStringList(&m_options->m_recentAFiles, "RecentAFiles"));
-    addOptionItem(new OptionStringList(&m_options->m_recentBFiles, "RecentBFiles"));
-    addOptionItem(new OptionStringList(&m_options->m_recentCFiles, "RecentCFiles"));
-    addOptionItem(new OptionStringList(&m_options->m_recentOutputFiles, "RecentOutputFiles"));
-    addOptionItem(new OptionStringList(&m_options->m_recentEncodings, "RecentEncodings"));
-}
-
 void OptionDialog::setupFontPage()
 {
     QFrame* page = new QFrame();
@@ -564,17 +404,13 @@ void OptionDialog::setupFontPage()
     QVBoxLayout* topLayout = new QVBoxLayout(page);
     topLayout->setMargin(5);
 
-    //requires QT 5.2 or later.
-    static const QFont defaultFont = QFontDatabase::systemFont(QFontDatabase::FixedFont);
-    static QFont defaultAppFont = QApplication::font();
-
-    OptionFontChooser* pAppFontChooser = new OptionFontChooser(defaultAppFont, "ApplicationFont", &m_options->m_appFont, page);
-    addOptionItem(pAppFontChooser);
+    OptionFontChooser* pAppFontChooser = new OptionFontChooser(findItem<OptionFont>("ApplicationFont"), page);
+    addOptionWidget(pAppFontChooser);
     topLayout->addWidget(pAppFontChooser);
     pAppFontChooser->setTitle(i18n("Application font"));
 
-    OptionFontChooser* pFontChooser = new OptionFontChooser(defaultFont, "Font", &m_options->m_font, page);
-    addOptionItem(pFontChooser);
+    OptionFontChooser* pFontChooser = new OptionFontChooser(findItem<OptionFont>("Font"), page);
+    addOptionWidget(pFontChooser);
     topLayout->addWidget(pFontChooser);
     pFontChooser->setTitle(i18n("File view font"));
 
@@ -584,7 +420,7 @@ void OptionDialog::setupFontPage()
 
     // This currently does not work (see rendering in class DiffTextWindow)
     //OptionCheckBox* pItalicDeltas = new OptionCheckBox( i18n("Italic font for deltas"), false, "ItalicForDeltas", &m_options->m_bItalicForDeltas, page, this );
-    //addOptionItem(pItalicDeltas);
+    //addOptionWidget(pItalicDeltas);
     //gbox->addWidget( pItalicDeltas, line, 0, 1, 2 );
     //pItalicDeltas->setToolTip( i18n(
     //   "Selects the italic version of the font for differences.\n"
@@ -618,9 +454,6 @@ void OptionDialog::setupColorPage()
     QLabel* label;
     int line = 0;
 
-    int depth = QPixmap::defaultDepth();
-    bool bLowColor = depth <= 8;
-
     label = new QLabel(i18n("Editor and Diff Views:"), page);
     gbox->addWidget(label, line, 0);
     QFont f(label->font());
@@ -628,89 +461,83 @@ void OptionDialog::setupColorPage()
     label->setFont(f);
     ++line;
 
-    OptionColorButton* pFgColor = new OptionColorButton(Qt::black, "FgColor", &m_options->m_fgColor, page);
+    OptionColorButton* pFgColor = new OptionColorButton(findItem<OptionColor>("FgColor"), page);
     label = new QLabel(i18n("Foreground color:"), page);
     label->setBuddy(pFgColor);
-    addOptionItem(pFgColor);
+    addOptionWidget(pFgColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pFgColor, line, 1);
     ++line;
 
-    OptionColorButton* pBgColor = new OptionColorButton(Qt::white, "BgColor", &m_options->m_bgColor, page);
+    OptionColorButton* pBgColor = new OptionColorButton(findItem<OptionColor>("BgColor"), page);
     label = new QLabel(i18n("Background color:"), page);
     label->setBuddy(pBgColor);
-    addOptionItem(pBgColor);
+    addOptionWidget(pBgColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pBgColor, line, 1);
 
     ++line;
 
-    OptionColorButton* pDiffBgColor = new OptionColorButton(
-        bLowColor ? QColor(Qt::lightGray) : qRgb(224, 224, 224), "DiffBgColor", &m_options->m_diffBgColor, page);
+    OptionColorButton* pDiffBgColor = new OptionColorButton(findItem<OptionColor>("DiffBgColor"), page);
     label = new QLabel(i18n("Diff background color:"), page);
     label->setBuddy(pDiffBgColor);
-    addOptionItem(pDiffBgColor);
+    addOptionWidget(pDiffBgColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pDiffBgColor, line, 1);
     ++line;
 
-    OptionColorButton* pColorA = new OptionColorButton(
-        bLowColor ? qRgb(0, 0, 255) : qRgb(0, 0, 200) /*blue*/, "ColorA", &m_options->m_colorA, page);
+    OptionColorButton* pColorA = new OptionColorButton(findItem<OptionColor>("ColorA"), page);
     label = new QLabel(i18n("Color A:"), page);
     label->setBuddy(pColorA);
-    addOptionItem(pColorA);
+    addOptionWidget(pColorA);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColorA, line, 1);
     ++line;
 
-    OptionColorButton* pColorB = new OptionColorButton(
-        bLowColor ? qRgb(0, 128, 0) : qRgb(0, 150, 0) /*green*/, "ColorB", &m_options->m_colorB, page);
+    OptionColorButton* pColorB = new OptionColorButton(findItem<OptionColor>("ColorB"), page);
     label = new QLabel(i18n("Color B:"), page);
     label->setBuddy(pColorB);
-    addOptionItem(pColorB);
+    addOptionWidget(pColorB);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColorB, line, 1);
     ++line;
 
-    OptionColorButton* pColorC = new OptionColorButton(
-        bLowColor ? qRgb(128, 0, 128) : qRgb(150, 0, 150) /*magenta*/, "ColorC", &m_options->m_colorC, page);
+    OptionColorButton* pColorC = new OptionColorButton(findItem<OptionColor>("ColorC"), page);
     label = new QLabel(i18n("Color C:"), page);
     label->setBuddy(pColorC);
-    addOptionItem(pColorC);
+    addOptionWidget(pColorC);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColorC, line, 1);
     ++line;
 
-    OptionColorButton* pColorForConflict = new OptionColorButton(Qt::red, "ColorForConflict", &m_options->m_colorForConflict, page);
+    OptionColorButton* pColorForConflict = new OptionColorButton(findItem<OptionColor>("ColorForConflict"), page);
     label = new QLabel(i18n("Conflict color:"), page);
     label->setBuddy(pColorForConflict);
-    addOptionItem(pColorForConflict);
+    addOptionWidget(pColorForConflict);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColorForConflict, line, 1);
     ++line;
 
-    OptionColorButton* pColor = new OptionColorButton(
-        bLowColor ? qRgb(192, 192, 192) : qRgb(220, 220, 100), "CurrentRangeBgColor", &m_options->m_currentRangeBgColor, page);
+    OptionColorButton* pColor = new OptionColorButton(findItem<OptionColor>("CurrentRangeBgColor"), page);
     label = new QLabel(i18n("Current range background color:"), page);
     label->setBuddy(pColor);
-    addOptionItem(pColor);
+    addOptionWidget(pColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColor, line, 1);
     ++line;
 
-    pColor = new OptionColorButton(
-        bLowColor ? qRgb(255, 255, 0) : qRgb(255, 255, 150), "CurrentRangeDiffBgColor", &m_options->m_currentRangeDiffBgColor, page);
+    pColor = new OptionColorButton(findItem<OptionColor>("CurrentRangeDiffBgColor"), page);
     label = new QLabel(i18n("Current range diff background color:"), page);
     label->setBuddy(pColor);
-    addOptionItem(pColor);
+    addOptionWidget(pColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColor, line, 1);
     ++line;
 
-    pColor = new OptionColorButton(qRgb(0xff, 0xd0, 0x80), "ManualAlignmentRangeColor", &m_options->m_manualHelpRangeColor, page);
+    pColor = new OptionColorButton(findItem<OptionColor>("ManualAlignmentRangeColor"), page);
     label = new QLabel(i18n("Color for manually aligned difference ranges:"), page);
     label->setBuddy(pColor);
-    addOptionItem(pColor);
+    addOptionWidget(pColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColor, line, 1);
     ++line;
@@ -720,38 +547,38 @@ void OptionDialog::setupColorPage()
     label->setFont(f);
     ++line;
 
-    pColor = new OptionColorButton(qRgb(0, 0xd0, 0), "NewestFileColor", &m_options->m_newestFileColor, page);
+    pColor = new OptionColorButton(findItem<OptionColor>("NewestFileColor"), page);
     label = new QLabel(i18n("Newest file color:"), page);
     label->setBuddy(pColor);
-    addOptionItem(pColor);
+    addOptionWidget(pColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColor, line, 1);
     QString dirColorTip = i18n("Changing this color will only be effective when starting the next folder comparison.");
     label->setToolTip(dirColorTip);
     ++line;
 
-    pColor = new OptionColorButton(qRgb(0xf0, 0, 0), "OldestFileColor", &m_options->m_oldestFileColor, page);
+    pColor = new OptionColorButton(findItem<OptionColor>("OldestFileColor"), page);
     label = new QLabel(i18n("Oldest file color:"), page);
     label->setBuddy(pColor);
-    addOptionItem(pColor);
+    addOptionWidget(pColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColor, line, 1);
     label->setToolTip(dirColorTip);
     ++line;
 
-    pColor = new OptionColorButton(qRgb(0xc0, 0xc0, 0), "MidAgeFileColor", &m_options->m_midAgeFileColor, page);
+    pColor = new OptionColorButton(findItem<OptionColor>("MidAgeFileColor"), page);
     label = new QLabel(i18n("Middle age file color:"), page);
     label->setBuddy(pColor);
-    addOptionItem(pColor);
+    addOptionWidget(pColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColor, line, 1);
     label->setToolTip(dirColorTip);
     ++line;
 
-    pColor = new OptionColorButton(qRgb(0, 0, 0), "MissingFileColor", &m_options->m_missingFileColor, page);
+    pColor = new OptionColorButton(findItem<OptionColor>("MissingFileColor"), page);
     label = new QLabel(i18n("Color for missing files:"), page);
     label->setBuddy(pColor);
-    addOptionItem(pColor);
+    addOptionWidget(pColor);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pColor, line, 1);
     label->setToolTip(dirColorTip);
@@ -786,32 +613,32 @@ void OptionDialog::setupEditPage()
     QLabel* label;
     int line = 0;
 
-    OptionCheckBox* pReplaceTabs = new OptionCheckBox(i18n("Tab inserts spaces"), false, "ReplaceTabs", &m_options->m_bReplaceTabs, page);
-    addOptionItem(pReplaceTabs);
+    OptionCheckBox* pReplaceTabs = new OptionCheckBox(i18n("Tab inserts spaces"), findItem<OptionBool>("ReplaceTabs"), page);
+    addOptionWidget(pReplaceTabs);
     gbox->addWidget(pReplaceTabs, line, 0, 1, 2);
     pReplaceTabs->setToolTip(i18n(
         "On: Pressing tab generates the appropriate number of spaces.\n"
         "Off: A tab character will be inserted."));
     ++line;
 
-    OptionIntEdit* pTabSize = new OptionIntEdit(8, "TabSize", &m_options->m_tabSize, 1, 100, page);
+    OptionIntEdit* pTabSize = new OptionIntEdit(findItem<OptionInt>("TabSize"), 1, 100, page);
     label = new QLabel(i18n("Tab size:"), page);
     label->setBuddy(pTabSize);
-    addOptionItem(pTabSize);
+    addOptionWidget(pTabSize);
     gbox->addWidget(label, line, 0);
     gbox->addWidget(pTabSize, line, 1);
     ++line;
 
-    OptionCheckBox* pAutoIndentation = new OptionCheckBox(i18n("Auto indentation"), true, "AutoIndentation", &m_options->m_bAutoIndentation, page);
+    OptionCheckBox* pAutoIndentation = new OptionCheckBox(i18n("Auto indentation"), findItem<OptionBool>("AutoIndentation"), page);
     gbox->addWidget(pAutoIndentation, line, 0, 1, 2);
-    addOptionItem(pAutoIndentation);
+    addOptionWidget(pAutoIndentation);
     pAutoIndentation->setToolTip(i18n(
         "On: The indentation of the previous line is used for a new line.\n"));
     ++line;
 
-    OptionCheckBox* pAutoCopySelection = new OptionCheckBox(i18n("Auto copy selection"), false, "AutoCopySelection", &m_options->m_bAutoCopySelection, page);
+    OptionCheckBox* pAutoCopySelection = new OptionCheckBox(i18n("Auto copy selection"), findItem<OptionBool>("AutoCopySelection"), page);
     gbox->addWidget(pAutoCopySelection, line, 0, 1, 2);
-    addOptionItem(pAutoCopySelection);
+    addOptionWidget(pAutoCopySelection);
     pAutoCopySelection->setToolTip(i18n(
         "On: Any selection is immediately written to the clipboard.\n"
         "Off: You must explicitly copy e.g. via Ctrl-C."));
@@ -820,9 +647,9 @@ void OptionDialog::setupEditPage()
     label = new QLabel(i18n("Line end style:"), page);
     gbox->addWidget(label, line, 0);
 
-    OptionComboBox* pLineEndStyle = new OptionComboBox(eLineEndStyleAutoDetect, "LineEndStyle", (int*)&m_options->m_lineEndStyle, page);
+    OptionComboBox* pLineEndStyle = new OptionComboBox(findItem<OptionInt>("LineEndStyle"), page);
     gbox->addWidget(pLineEndStyle, line, 1);
-    addOptionItem(pLineEndStyle);
+    addOptionWidget(pLineEndStyle);
     pLineEndStyle->insertItem(eLineEndStyleUnix, "Unix");
     pLineEndStyle->insertItem(eLineEndStyleDos, "Dos/Windows");
     pLineEndStyle->insertItem(eLineEndStyleAutoDetect, "Autodetect");
@@ -865,7 +692,7 @@ void OptionDialog::setupDiffPage()
     m_options->m_bPreserveCarriageReturn = false;
     /*
     OptionCheckBox* pPreserveCarriageReturn = new OptionCheckBox( i18n("Preserve carriage return"), false, "PreserveCarriageReturn", &m_options->m_bPreserveCarriageReturn, page, this );
-    addOptionItem(pPreserveCarriageReturn);
+    addOptionWidget(pPreserveCarriageReturn);
     gbox->addWidget( pPreserveCarriageReturn, line, 0, 1, 2 );
     pPreserveCarriageReturn->setToolTip( i18n(
        "Show carriage return characters '\\r' if they exist.\n"
@@ -873,54 +700,87 @@ void OptionDialog::setupDiffPage()
        );
     ++line;
 */
-    OptionCheckBox* pIgnoreNumbers = new OptionCheckBox(i18n("Ignore numbers (treat as white space)"), false, "IgnoreNumbers", &m_options->m_bIgnoreNumbers, page);
+    OptionCheckBox* pIgnoreNumbers = new OptionCheckBox(i18n("Ignore numbers (treat as white space)"), findItem<OptionBool>("IgnoreNumbers"), page);
     gbox->addWidget(pIgnoreNumbers, line, 0, 1, 2);
-    addOptionItem(pIgnoreNumbers);
+    addOptionWidget(pIgnoreNumbers);
     pIgnoreNumbers->setToolTip(i18n(
         "Ignore number characters during line matching phase. (Similar to Ignore white space.)\n"
         "Might help to compare files with numeric data."));
     ++line;
 
-    OptionCheckBox* pIgnoreComments = new OptionCheckBox(i18n("Ignore C/C++ comments (treat as white space)"), false, "IgnoreComments", &m_options->m_bIgnoreComments, page);
+    OptionCheckBox* pIgnoreComments = new OptionCheckBox(i18n("Ignore C/C++ comments (treat as white space)"), findItem<OptionBool>("IgnoreComments"), page);
     gbox->addWidget(pIgnoreComments, line, 0, 1, 2);
-    addOptionItem(pIgnoreComments);
+    addOptionWidget(pIgnoreComments);
     pIgnoreComments->setToolTip(i18n("Treat C/C++ comments like white space."));
     ++line;
 
-    OptionCheckBox* pIgnoreCase = new OptionCheckBox(i18n("Ignore case (treat as white space)"), false, "IgnoreCase", &m_options->m_bIgnoreCase, page);
+    OptionCheckBox* pIgnoreCase = new OptionCheckBox(i18n("Ignore case (treat as white space)"), findItem<OptionBool>("IgnoreCase"), page);
     gbox->addWidget(pIgnoreCase, line, 0, 1, 2);
-    addOptionItem(pIgnoreCase);
+    addOptionWidget(pIgnoreCase);
     pIgnoreCase->setToolTip(i18n(
         "Treat case differences like white space changes. ('a'<=>'A')"));
     ++line;
 
     label = new QLabel(i18n("Preprocessor command:"), page);
     gbox->addWidget(label, line, 0);
-    OptionLineEdit* pLE = new OptionLineEdit("", "PreProcessorCmd", &m_options->m_PreProcessorCmd, page);
+    OptionLineEdit* pLE = new OptionLineEdit(findItem<OptionStringHistory>("PreProcessorCmd"), page);
     gbox->addWidget(pLE, line, 1);
-    addOptionItem(pLE);
+    addOptionWidget(pLE);
     label->setToolTip(i18n("User defined pre-processing. (See the docs for details.)"));
     ++line;
 
     label = new QLabel(i18n("Line-matching preprocessor command:"), page);
     gbox->addWidget(label, line, 0);
-    pLE = new OptionLineEdit("", "LineMatchingPreProcessorCmd", &m_options->m_LineMatchingPreProcessorCmd, page);
+    pLE = new OptionLineEdit(findItem<OptionStringHistory>("LineMatchingPreProcessorCmd"), page);
     gbox->addWidget(pLE, line, 1);
-    addOptionItem(pLE);
+    addOptionWidget(pLE);
     label->setToolTip(i18n("This pre-processor is only used during line matching.\n(See the docs for details.)"));
     ++line;
 
-    OptionCheckBox* pTryHard = new OptionCheckBox(i18n("Try hard (slower)"), true, "TryHard", &m_options->m_bTryHard, page);
+    OptionCheckBox* pCachePreProcessorOutput = new OptionCheckBox(i18n("Cache preprocessor output"), findItem<OptionBool>("CachePreProcessorOutput"), page);
+    gbox->addWidget(pCachePreProcessorOutput, line, 0, 1, 2);
+    addOptionWidget(pCachePreProcessorOutput);
+    pCachePreProcessorOutput->setToolTip(i18n(
+        "Keeps the output of the preprocessor commands for each input on disk so\n"
+        "comparing the same file again doesn't run the commands again.\n"
+        "Only use this for commands whose output depends on nothing but their input."));
+    ++line;
+
+    OptionCheckBox* pTryHard = new OptionCheckBox(i18n("Try hard (slower)"), findItem<OptionBool>("TryHard"), page);
     gbox->addWidget(pTryHard, line, 0, 1, 2);
-    addOptionItem(pTryHard);
+    addOptionWidget(pTryHard);
     pTryHard->setToolTip(i18n(
         "Enables the --minimal option for the external diff.\n"
         "The analysis of big files will be much slower."));
     ++line;
 
-    OptionCheckBox* pDiff3AlignBC = new OptionCheckBox(i18n("Align B and C for 3 input files"), false, "Diff3AlignBC", &m_options->m_bDiff3AlignBC, page);
+    label = new QLabel(i18n("Diff algorithm:"), page);
+    gbox->addWidget(label, line, 0);
+    OptionComboBox* pDiffAlgorithm = new OptionComboBox(findItem<OptionInt>("DiffAlgorithm"), page);
+    gbox->addWidget(pDiffAlgorithm, line, 1);
+    addOptionWidget(pDiffAlgorithm);
+    pDiffAlgorithm->insertItem(eDiffAlgorithmGnuDiff, i18n("Myers (GNU diff)"));
+    pDiffAlgorithm->insertItem(eDiffAlgorithmHistogram, i18n("Histogram"));
+    label->setToolTip(i18n(
+        "Histogram anchors the comparison on lines that occur rarely.\n"
+        "It is usually faster and aligns moved or reordered code better.\n"
+        "\"Try hard\" only applies to Myers. (Default is Myers.)"));
+    ++line;
+
+    label = new QLabel(i18n("Diff time limit (s):"), page);
+    gbox->addWidget(label, line, 0);
+    OptionIntEdit* pDiffTimeLimit = new OptionIntEdit(findItem<OptionInt>("DiffTimeLimit"), 0, 3600, page);
+    gbox->addWidget(pDiffTimeLimit, line, 1);
+    addOptionWidget(pDiffTimeLimit);
+    label->setToolTip(i18n(
+        "Limits the time Myers may spend on one comparison, 0 means no limit.\n"
+        "After half of the time \"Try hard\" is given up, when the time is up\n"
+        "the remaining differences are shown as one block. Range: 0-3600 s"));
+    ++line;
+
+    OptionCheckBox* pDiff3AlignBC = new OptionCheckBox(i18n("Align B and C for 3 input files"), findItem<OptionBool>("Diff3AlignBC"), page);
     gbox->addWidget(pDiff3AlignBC, line, 0, 1, 2);
-    addOptionItem(pDiff3AlignBC);
+    addOptionWidget(pDiff3AlignBC);
     pDiff3AlignBC->setToolTip(i18n(
         "Try to align B and C when comparing or merging three input files.\n"
         "Not recommended for merging because merge might get more complicated.\n"
@@ -959,25 +819,25 @@ void OptionDialog::setupMergePage()
 
     label = new QLabel(i18n("Auto advance delay (ms):"), page);
     gbox->addWidget(label, line, 0);
-    OptionIntEdit* pAutoAdvanceDelay = new OptionIntEdit(500, "AutoAdvanceDelay", &m_options->m_autoAdvanceDelay, 0, 2000, page);
+    OptionIntEdit* pAutoAdvanceDelay = new OptionIntEdit(findItem<OptionInt>("AutoAdvanceDelay"), 0, 2000, page);
     gbox->addWidget(pAutoAdvanceDelay, line, 1);
-    addOptionItem(pAutoAdvanceDelay);
+    addOptionWidget(pAutoAdvanceDelay);
     label->setToolTip(i18n(
         "When in Auto-Advance mode the result of the current selection is shown \n"
         "for the specified time, before jumping to the next conflict. Range: 0-2000 ms"));
     ++line;
 
-    OptionCheckBox* pShowInfoDialogs = new OptionCheckBox(i18n("Show info dialogs"), true, "ShowInfoDialogs", &m_options->m_bShowInfoDialogs, page);
+    OptionCheckBox* pShowInfoDialogs = new OptionCheckBox(i18n("Show info dialogs"), findItem<OptionBool>("ShowInfoDialogs"), page);
     gbox->addWidget(pShowInfoDialogs, line, 0, 1, 2);
-    addOptionItem(pShowInfoDialogs);
+    addOptionWidget(pShowInfoDialogs);
     pShowInfoDialogs->setToolTip(i18n("Show a dialog with information about the number of conflicts."));
     ++line;
 
     label = new QLabel(i18n("White space 2-file merge default:"), page);
     gbox->addWidget(label, line, 0);
-    OptionComboBox* pWhiteSpace2FileMergeDefault = new OptionComboBox(0, "WhiteSpace2FileMergeDefault", &m_options->m_whiteSpace2FileMergeDefault, page);
+    OptionComboBox* pWhiteSpace2FileMergeDefault = new OptionComboBox(findItem<OptionInt>("WhiteSpace2FileMergeDefault"), page);
     gbox->addWidget(pWhiteSpace2FileMergeDefault, line, 1);
-    addOptionItem(pWhiteSpace2FileMergeDefault);
+    addOptionWidget(pWhiteSpace2FileMergeDefault);
     pWhiteSpace2FileMergeDefault->insertItem(0, i18n("Manual Choice"));
     pWhiteSpace2FileMergeDefault->insertItem(1, i18n("A"));
     pWhiteSpace2FileMergeDefault->insertItem(2, i18n("B"));
@@ -988,9 +848,9 @@ void OptionDialog::setupMergePage()
 
     label = new QLabel(i18n("White space 3-file merge default:"), page);
     gbox->addWidget(label, line, 0);
-    OptionComboBox* pWhiteSpace3FileMergeDefault = new OptionComboBox(0, "WhiteSpace3FileMergeDefault", &m_options->m_whiteSpace3FileMergeDefault, page);
+    OptionComboBox* pWhiteSpace3FileMergeDefault = new OptionComboBox(findItem<OptionInt>("WhiteSpace3FileMergeDefault"), page);
     gbox->addWidget(pWhiteSpace3FileMergeDefault, line, 1);
-    addOptionItem(pWhiteSpace3FileMergeDefault);
+    addOptionWidget(pWhiteSpace3FileMergeDefault);
     pWhiteSpace3FileMergeDefault->insertItem(0, i18n("Manual Choice"));
     pWhiteSpace3FileMergeDefault->insertItem(1, i18n("A"));
     pWhiteSpace3FileMergeDefault->insertItem(2, i18n("B"));
@@ -1010,14 +870,14 @@ void OptionDialog::setupMergePage()
 
         label = new QLabel(i18n("Auto merge regular expression:"), page);
         gbox->addWidget(label, line, 0);
-        m_pAutoMergeRegExpLineEdit = new OptionLineEdit(".*\\$(Version|Header|Date|Author).*\\$.*", "AutoMergeRegExp", &m_options->m_autoMergeRegExp, page);
+        m_pAutoMergeRegExpLineEdit = new OptionLineEdit(findItem<OptionStringHistory>("AutoMergeRegExp"), page);
         gbox->addWidget(m_pAutoMergeRegExpLineEdit, line, 1);
-        addOptionItem(m_pAutoMergeRegExpLineEdit);
+        addOptionWidget(m_pAutoMergeRegExpLineEdit);
         label->setToolTip(s_autoMergeRegExpToolTip);
         ++line;
 
-        OptionCheckBox* pAutoMergeRegExp = new OptionCheckBox(i18n("Run regular expression auto merge on merge start"), false, "RunRegExpAutoMergeOnMergeStart", &m_options->m_bRunRegExpAutoMergeOnMergeStart, page);
-        addOptionItem(pAutoMergeRegExp);
+        OptionCheckBox* pAutoMergeRegExp = new OptionCheckBox(i18n("Run regular expression auto merge on merge start"), findItem<OptionBool>("RunRegExpAutoMergeOnMergeStart"), page);
+        addOptionWidget(pAutoMergeRegExp);
         gbox->addWidget(pAutoMergeRegExp, line, 0, 1, 2);
         pAutoMergeRegExp->setToolTip(i18n("Run the merge for auto merge regular expressions\n"
                                           "immediately when a merge starts.\n"));
@@ -1034,31 +894,23 @@ void OptionDialog::setupMergePage()
 
         label = new QLabel(i18n("History start regular expression:"), page);
         gbox->addWidget(label, line, 0);
-        m_pHistoryStartRegExpLineEdit = new OptionLineEdit(".*\\$Log.*\\$.*", "HistoryStartRegExp", &m_options->m_historyStartRegExp, page);
+        m_pHistoryStartRegExpLineEdit = new OptionLineEdit(findItem<OptionStringHistory>("HistoryStartRegExp"), page);
         gbox->addWidget(m_pHistoryStartRegExpLineEdit, line, 1);
-        addOptionItem(m_pHistoryStartRegExpLineEdit);
+        addOptionWidget(m_pHistoryStartRegExpLineEdit);
         label->setToolTip(s_historyStartRegExpToolTip);
         ++line;
 
         label = new QLabel(i18n("History entry start regular expression:"), page);
         gbox->addWidget(label, line, 0);
-        // Example line:  "** \main\rolle_fsp_dev_008\1   17 Aug 2001 10:45:44   rolle"
-        QString historyEntryStartDefault =
-            "\\s*\\\\main\\\\(\\S+)\\s+"                         // Start with  "\main\"
-            "([0-9]+) "                                          // day
-            "(Jan|Feb|Mar|Apr|May|Jun|Jul|Aug|Sep|Oct|Nov|Dec) " //month
-            "([0-9][0-9][0-9][0-9]) "                            // year
-            "([0-9][0-9]:[0-9][0-9]:[0-9][0-9])\\s+(.*)";        // time, name
-
-        m_pHistoryEntryStartRegExpLineEdit = new OptionLineEdit(historyEntryStartDefault, "HistoryEntryStartRegExp", &m_options->m_historyEntryStartRegExp, page);
+        m_pHistoryEntryStartRegExpLineEdit = new OptionLineEdit(findItem<OptionStringHistory>("HistoryEntryStartRegExp"), page);
         gbox->addWidget(m_pHistoryEntryStartRegExpLineEdit, line, 1);
-        addOptionItem(m_pHistoryEntryStartRegExpLineEdit);
+        addOptionWidget(m_pHistoryEntryStartRegExpLineEdit);
         label->setToolTip(s_historyEntryStartRegExpToolTip);
         ++line;
 
-        m_pHistoryMergeSorting = new OptionCheckBox(i18n("History merge sorting"), false, "HistoryMergeSorting", &m_options->m_bHistoryMergeSorting, page);
+        m_pHistoryMergeSorting = new OptionCheckBox(i18n("History merge sorting"), findItem<OptionBool>("HistoryMergeSorting"), page);
         gbox->addWidget(m_pHistoryMergeSorting, line, 0, 1, 2);
-        addOptionItem(m_pHistoryMergeSorting);
+        addOptionWidget(m_pHistoryMergeSorting);
         m_pHistoryMergeSorting->setToolTip(i18n("Sort version control history by a key."));
         ++line;
         //QString branch = newHistoryEntry.cap(1);
@@ -1067,29 +919,28 @@ void OptionDialog::setupMergePage()
         //int year   = newHistoryEntry.cap(4).toInt();
         //QString time = newHistoryEntry.cap(5);
         //QString name = newHistoryEntry.cap(6);
-        QString defaultSortKeyOrder = "4,3,2,5,1,6"; //QDate(year,month,day).toString(Qt::ISODate) +" "+ time + " " + branch + " " + name;
 
         label = new QLabel(i18n("History entry start sort key order:"), page);
         gbox->addWidget(label, line, 0);
-        m_pHistorySortKeyOrderLineEdit = new OptionLineEdit(defaultSortKeyOrder, "HistoryEntryStartSortKeyOrder", &m_options->m_historyEntryStartSortKeyOrder, page);
+        m_pHistorySortKeyOrderLineEdit = new OptionLineEdit(findItem<OptionStringHistory>("HistoryEntryStartSortKeyOrder"), page);
         gbox->addWidget(m_pHistorySortKeyOrderLineEdit, line, 1);
-        addOptionItem(m_pHistorySortKeyOrderLineEdit);
+        addOptionWidget(m_pHistorySortKeyOrderLineEdit);
         label->setToolTip(s_historyEntryStartSortKeyOrderToolTip);
         m_pHistorySortKeyOrderLineEdit->setEnabled(false);
         chk_connect_a(m_pHistoryMergeSorting, &OptionCheckBox::toggled, m_pHistorySortKeyOrderLineEdit, &OptionLineEdit::setEnabled);
         ++line;
 
-        m_pHistoryAutoMerge = new OptionCheckBox(i18n("Merge version control history on merge start"), false, "RunHistoryAutoMergeOnMergeStart", &m_options->m_bRunHistoryAutoMergeOnMergeStart, page);
-        addOptionItem(m_pHistoryAutoMerge);
+        m_pHistoryAutoMerge = new OptionCheckBox(i18n("Merge version control history on merge start"), findItem<OptionBool>("RunHistoryAutoMergeOnMergeStart"), page);
+        addOptionWidget(m_pHistoryAutoMerge);
         gbox->addWidget(m_pHistoryAutoMerge, line, 0, 1, 2);
         m_pHistoryAutoMerge->setToolTip(i18n("Run version control history automerge on merge start."));
         ++line;
 
-        OptionIntEdit* pMaxNofHistoryEntries = new OptionIntEdit(-1, "MaxNofHistoryEntries", &m_options->m_maxNofHistoryEntries, -1, 1000, page);
+        OptionIntEdit* pMaxNofHistoryEntries = new OptionIntEdit(findItem<OptionInt>("MaxNofHistoryEntries"), -1, 1000, page);
         label = new QLabel(i18n("Max number of history entries:"), page);
         gbox->addWidget(label, line, 0);
         gbox->addWidget(pMaxNofHistoryEntries, line, 1);
-        addOptionItem(pMaxNofHistoryEntries);
+        addOptionWidget(pMaxNofHistoryEntries);
         pMaxNofHistoryEntries->setToolTip(i18n("Cut off after specified number. Use -1 for infinite number of entries."));
         ++line;
     }
@@ -1101,18 +952,17 @@ void OptionDialog::setupMergePage()
 
     label = new QLabel(i18n("Irrelevant merge command:"), page);
     gbox->addWidget(label, line, 0);
-    OptionLineEdit* pLE = new OptionLineEdit("", "IrrelevantMergeCmd", &m_options->m_IrrelevantMergeCmd, page);
+    OptionLineEdit* pLE = new OptionLineEdit(findItem<OptionStringHistory>("IrrelevantMergeCmd"), page);
     gbox->addWidget(pLE, line, 1);
-    addOptionItem(pLE);
+    addOptionWidget(pLE);
     label->setToolTip(i18n("If specified this script is run after automerge\n"
                            "when no other relevant changes were detected.\n"
                            "Called with the parameters: filename1 filename2 filename3"));
     ++line;
 
-    OptionCheckBox* pAutoSaveAndQuit = new OptionCheckBox(i18n("Auto save and quit on merge without conflicts"), false,
-                                                          "AutoSaveAndQuitOnMergeWithoutConflicts", &m_options->m_bAutoSaveAndQuitOnMergeWithoutConflicts, page);
+    OptionCheckBox* pAutoSaveAndQuit = new OptionCheckBox(i18n("Auto save and quit on merge without conflicts"), findItem<OptionBool>("AutoSaveAndQuitOnMergeWithoutConflicts"), page);
     gbox->addWidget(pAutoSaveAndQuit, line, 0, 1, 2);
-    addOptionItem(pAutoSaveAndQuit);
+    addOptionWidget(pAutoSaveAndQuit);
     pAutoSaveAndQuit->setToolTip(i18n("If KDiff3 was started for a file-merge from the command line and all\n"
                                       "conflicts are solvable without user interaction then automatically save and quit.\n"
                                       "(Similar to command line option \"--auto\".)"));
@@ -1145,16 +995,16 @@ void OptionDialog::setupDirectoryMergePage()
     topLayout->addLayout(gbox);
     int line = 0;
 
-    OptionCheckBox* pRecursiveDirs = new OptionCheckBox(i18n("Recursive folders"), true, "RecursiveDirs", &m_options->m_bDmRecursiveDirs, page);
+    OptionCheckBox* pRecursiveDirs = new OptionCheckBox(i18n("Recursive folders"), findItem<OptionBool>("RecursiveDirs"), page);
     gbox->addWidget(pRecursiveDirs, line, 0, 1, 2);
-    addOptionItem(pRecursiveDirs);
+    addOptionWidget(pRecursiveDirs);
     pRecursiveDirs->setToolTip(i18n("Whether to analyze subfolders or not."));
     ++line;
     QLabel* label = new QLabel(i18n("File pattern(s):"), page);
     gbox->addWidget(label, line, 0);
-    OptionLineEdit* pFilePattern = new OptionLineEdit("*", "FilePattern", &m_options->m_DmFilePattern, page);
+    OptionLineEdit* pFilePattern = new OptionLineEdit(findItem<OptionStringHistory>("FilePattern"), page);
     gbox->addWidget(pFilePattern, line, 1);
-    addOptionItem(pFilePattern);
+    addOptionWidget(pFilePattern);
     label->setToolTip(i18n(
         "Pattern(s) of files to be analyzed. \n"
         "Wildcards: '*' and '?'\n"
@@ -1163,9 +1013,9 @@ void OptionDialog::setupDirectoryMergePage()
 
     label = new QLabel(i18n("File-anti-pattern(s):"), page);
     gbox->addWidget(label, line, 0);
-    OptionLineEdit* pFileAntiPattern = new OptionLineEdit("*.orig;*.o;*.obj;*.rej;*.bak", "FileAntiPattern", &m_options->m_DmFileAntiPattern, page);
+    OptionLineEdit* pFileAntiPattern = new OptionLineEdit(findItem<OptionStringHistory>("FileAntiPattern"), page);
     gbox->addWidget(pFileAntiPattern, line, 1);
-    addOptionItem(pFileAntiPattern);
+    addOptionWidget(pFileAntiPattern);
     label->setToolTip(i18n(
         "Pattern(s) of files to be excluded from analysis. \n"
         "Wildcards: '*' and '?'\n"
@@ -1174,69 +1024,64 @@ void OptionDialog::setupDirectoryMergePage()
 
     label = new QLabel(i18n("Folder-anti-pattern(s):"), page);
     gbox->addWidget(label, line, 0);
-    OptionLineEdit* pDirAntiPattern = new OptionLineEdit("CVS;.deps;.svn;.hg;.git", "DirAntiPattern", &m_options->m_DmDirAntiPattern, page);
+    OptionLineEdit* pDirAntiPattern = new OptionLineEdit(findItem<OptionStringHistory>("DirAntiPattern"), page);
     gbox->addWidget(pDirAntiPattern, line, 1);
-    addOptionItem(pDirAntiPattern);
+    addOptionWidget(pDirAntiPattern);
     label->setToolTip(i18n(
         "Pattern(s) of folders to be excluded from analysis. \n"
         "Wildcards: '*' and '?'\n"
         "Several Patterns can be specified by using the separator: ';'"));
     ++line;
 
-    OptionCheckBox* pUseCvsIgnore = new OptionCheckBox(i18n("Use .cvsignore"), false, "UseCvsIgnore", &m_options->m_bDmUseCvsIgnore, page);
+    OptionCheckBox* pUseCvsIgnore = new OptionCheckBox(i18n("Use .cvsignore"), findItem<OptionBool>("UseCvsIgnore"), page);
     gbox->addWidget(pUseCvsIgnore, line, 0, 1, 2);
-    addOptionItem(pUseCvsIgnore);
+    addOptionWidget(pUseCvsIgnore);
     pUseCvsIgnore->setToolTip(i18n(
         "Extends the antipattern to anything that would be ignored by CVS.\n"
         "Via local \".cvsignore\" files this can be folder-specific."));
     ++line;
 
-    OptionCheckBox* pFindHidden = new OptionCheckBox(i18n("Find hidden files and folders"), true, "FindHidden", &m_options->m_bDmFindHidden, page);
+    OptionCheckBox* pFindHidden = new OptionCheckBox(i18n("Find hidden files and folders"), findItem<OptionBool>("FindHidden"), page);
     gbox->addWidget(pFindHidden, line, 0, 1, 2);
-    addOptionItem(pFindHidden);
+    addOptionWidget(pFindHidden);
     pFindHidden->setToolTip(i18n("Finds hidden files and folders."));
     ++line;
 
-    OptionCheckBox* pFollowFileLinks = new OptionCheckBox(i18n("Follow file links"), false, "FollowFileLinks", &m_options->m_bDmFollowFileLinks, page);
+    OptionCheckBox* pFollowFileLinks = new OptionCheckBox(i18n("Follow file links"), findItem<OptionBool>("FollowFileLinks"), page);
     gbox->addWidget(pFollowFileLinks, line, 0, 1, 2);
-    addOptionItem(pFollowFileLinks);
+    addOptionWidget(pFollowFileLinks);
     pFollowFileLinks->setToolTip(i18n(
         "On: Compare the file the link points to.\n"
         "Off: Compare the links."));
     ++line;
 
-    OptionCheckBox* pFollowDirLinks = new OptionCheckBox(i18n("Follow folder links"), false, "FollowDirLinks", &m_options->m_bDmFollowDirLinks, page);
+    OptionCheckBox* pFollowDirLinks = new OptionCheckBox(i18n("Follow folder links"), findItem<OptionBool>("FollowDirLinks"), page);
     gbox->addWidget(pFollowDirLinks, line, 0, 1, 2);
-    addOptionItem(pFollowDirLinks);
+    addOptionWidget(pFollowDirLinks);
     pFollowDirLinks->setToolTip(i18n(
         "On: Compare the folder the link points to.\n"
         "Off: Compare the links."));
     ++line;
 
-#if defined(Q_OS_WIN)
-    bool bCaseSensitiveFilenameComparison = false;
-#else
-    bool bCaseSensitiveFilenameComparison = true;
-#endif
-    OptionCheckBox* pCaseSensitiveFileNames = new OptionCheckBox(i18n("Case sensitive filename comparison"), bCaseSensitiveFilenameComparison, "CaseSensitiveFilenameComparison", &m_options->m_bDmCaseSensitiveFilenameComparison, page);
+    OptionCheckBox* pCaseSensitiveFileNames = new OptionCheckBox(i18n("Case sensitive filename comparison"), findItem<OptionBool>("CaseSensitiveFilenameComparison"), page);
     gbox->addWidget(pCaseSensitiveFileNames, line, 0, 1, 2);
-    addOptionItem(pCaseSensitiveFileNames);
+    addOptionWidget(pCaseSensitiveFileNames);
     pCaseSensitiveFileNames->setToolTip(i18n(
         "The folder comparison will compare files or folders when their names match.\n"
         "Set this option if the case of the names must match. (Default for Windows is off, otherwise on.)"));
     ++line;
 
-    OptionCheckBox* pUnfoldSubdirs = new OptionCheckBox(i18n("Unfold all subfolders on load"), false, "UnfoldSubdirs", &m_options->m_bDmUnfoldSubdirs, page);
+    OptionCheckBox* pUnfoldSubdirs = new OptionCheckBox(i18n("Unfold all subfolders on load"), findItem<OptionBool>("UnfoldSubdirs"), page);
     gbox->addWidget(pUnfoldSubdirs, line, 0, 1, 2);
-    addOptionItem(pUnfoldSubdirs);
+    addOptionWidget(pUnfoldSubdirs);
     pUnfoldSubdirs->setToolTip(i18n(
         "On: Unfold all subfolders when starting a folder diff.\n"
         "Off: Leave subfolders folded."));
     ++line;
 
-    OptionCheckBox* pSkipDirStatus = new OptionCheckBox(i18n("Skip folder status report"), false, "SkipDirStatus", &m_options->m_bDmSkipDirStatus, page);
+    OptionCheckBox* pSkipDirStatus = new OptionCheckBox(i18n("Skip folder status report"), findItem<OptionBool>("SkipDirStatus"), page);
     gbox->addWidget(pSkipDirStatus, line, 0, 1, 2);
-    addOptionItem(pSkipDirStatus);
+    addOptionWidget(pSkipDirStatus);
     pSkipDirStatus->setToolTip(i18n(
         "On: Do not show the Folder Comparison Status.\n"
         "Off: Show the status dialog on start."));
@@ -1247,42 +1092,74 @@ void OptionDialog::setupDirectoryMergePage()
 
     QVBoxLayout* pBGLayout = new QVBoxLayout(pBG);
 
-    OptionRadioButton* pBinaryComparison = new OptionRadioButton(i18n("Binary comparison"), true, "BinaryComparison", &m_options->m_bDmBinaryComparison, pBG);
-    addOptionItem(pBinaryComparison);
+    OptionRadioButton* pBinaryComparison = new OptionRadioButton(i18n("Binary comparison"), findItem<OptionBool>("BinaryComparison"), pBG);
+    addOptionWidget(pBinaryComparison);
     pBinaryComparison->setToolTip(i18n("Binary comparison of each file. (Default)"));
     pBGLayout->addWidget(pBinaryComparison);
 
-    OptionRadioButton* pFullAnalysis = new OptionRadioButton(i18n("Full analysis"), false, "FullAnalysis", &m_options->m_bDmFullAnalysis, pBG);
-    addOptionItem(pFullAnalysis);
+    OptionRadioButton* pFullAnalysis = new OptionRadioButton(i18n("Full analysis"), findItem<OptionBool>("FullAnalysis"), pBG);
+    addOptionWidget(pFullAnalysis);
     pFullAnalysis->setToolTip(i18n("Do a full analysis and show statistics information in extra columns.\n"
                                    "(Slower than a binary comparison, much slower for binary files.)"));
     pBGLayout->addWidget(pFullAnalysis);
 
-    OptionRadioButton* pTrustDate = new OptionRadioButton(i18n("Trust the size and modification date (unsafe)"), false, "TrustDate", &m_options->m_bDmTrustDate, pBG);
-    addOptionItem(pTrustDate);
+    OptionRadioButton* pTrustDate = new OptionRadioButton(i18n("Trust the size and modification date (unsafe)"), findItem<OptionBool>("TrustDate"), pBG);
+    addOptionWidget(pTrustDate);
     pTrustDate->setToolTip(i18n("Assume that files are equal if the modification date and file length are equal.\n"
                                 "Files with equal contents but different modification dates will appear as different.\n"
                                 "Useful for big folders or slow networks."));
     pBGLayout->addWidget(pTrustDate);
 
-    OptionRadioButton* pTrustDateFallbackToBinary = new OptionRadioButton(i18n("Trust the size and date, but use binary comparison if date does not match (unsafe)"), false, "TrustDateFallbackToBinary", &m_options->m_bDmTrustDateFallbackToBinary, pBG);
-    addOptionItem(pTrustDateFallbackToBinary);
+    OptionRadioButton* pTrustDateFallbackToBinary = new OptionRadioButton(i18n("Trust the size and date, but use binary comparison if date does not match (unsafe)"), findItem<OptionBool>("TrustDateFallbackToBinary"), pBG);
+    addOptionWidget(pTrustDateFallbackToBinary);
     pTrustDateFallbackToBinary->setToolTip(i18n("Assume that files are equal if the modification date and file length are equal.\n"
                                                 "If the dates are not equal but the sizes are, use binary comparison.\n"
                                                 "Useful for big folders or slow networks."));
     pBGLayout->addWidget(pTrustDateFallbackToBinary);
 
-    OptionRadioButton* pTrustSize = new OptionRadioButton(i18n("Trust the size (unsafe)"), false, "TrustSize", &m_options->m_bDmTrustSize, pBG);
-    addOptionItem(pTrustSize);
+    OptionRadioButton* pTrustSize = new OptionRadioButton(i18n("Trust the size (unsafe)"), findItem<OptionBool>("TrustSize"), pBG);
+    addOptionWidget(pTrustSize);
     pTrustSize->setToolTip(i18n("Assume that files are equal if their file lengths are equal.\n"
                                 "Useful for big folders or slow networks when the date is modified during download."));
     pBGLayout->addWidget(pTrustSize);
 
     ++line;
 
+    OptionCheckBox* pUseHashCache = new OptionCheckBox(i18n("Cache file content hashes"), findItem<OptionBool>("UseHashCache"), page);
+    addOptionWidget(pUseHashCache);
+    gbox->addWidget(pUseHashCache, line, 0, 1, 2);
+    pUseHashCache->setToolTip(i18n(
+        "Remember a hash of the content of local files that were compared byte by byte.\n"
+        "Files whose size, modification date and inode did not change since then are\n"
+        "known to differ without reading them, if their hashes differ.\n"
+        "Only used by the binary comparison."));
+    ++line;
+
+    OptionCheckBox* pTrustHashCache = new OptionCheckBox(i18n("Trust equal cached hashes"), findItem<OptionBool>("TrustHashCache"), page);
+    addOptionWidget(pTrustHashCache);
+    gbox->addWidget(pTrustHashCache, line, 0, 1, 2);
+    pTrustHashCache->setToolTip(i18n(
+        "On: Files with equal cached hashes are equal without reading them.\n"
+        "Off: Files with equal cached hashes are still compared byte by byte."));
+    chk_connect_a(pUseHashCache, &OptionCheckBox::toggled, pTrustHashCache, &OptionCheckBox::setEnabled);
+    pTrustHashCache->setEnabled(false);
+    ++line;
+
+    OptionCheckBox* pHashDifferingFiles = new OptionCheckBox(i18n("Hash differing files too"), findItem<OptionBool>("HashDifferingFiles"), page);
+    addOptionWidget(pHashDifferingFiles);
+    gbox->addWidget(pHashDifferingFiles, line, 0, 1, 2);
+    pHashDifferingFiles->setToolTip(i18n(
+        "On: Differing files are read to the end for their hashes,\n"
+        "so next time they are known to differ without reading them.\n"
+        "Off: Only the hashes of equal files are cached, differing files\n"
+        "are read only up to the first difference."));
+    chk_connect_a(pUseHashCache, &OptionCheckBox::toggled, pHashDifferingFiles, &OptionCheckBox::setEnabled);
+    pHashDifferingFiles->setEnabled(false);
+    ++line;
+
     // Some two Dir-options: Affects only the default actions.
-    OptionCheckBox* pSyncMode = new OptionCheckBox(i18n("Synchronize folders"), false, "SyncMode", &m_options->m_bDmSyncMode, page);
-    addOptionItem(pSyncMode);
+    OptionCheckBox* pSyncMode = new OptionCheckBox(i18n("Synchronize folders"), findItem<OptionBool>("SyncMode"), page);
+    addOptionWidget(pSyncMode);
     gbox->addWidget(pSyncMode, line, 0, 1, 2);
     pSyncMode->setToolTip(i18n(
         "Offers to store files in both folders so that\n"
@@ -1291,8 +1168,8 @@ void OptionDialog::setupDirectoryMergePage()
     ++line;
 
     // Allow white-space only differences to be considered equal
-    OptionCheckBox* pWhiteSpaceDiffsEqual = new OptionCheckBox(i18n("White space differences considered equal"), true, "WhiteSpaceEqual", &m_options->m_bDmWhiteSpaceEqual, page);
-    addOptionItem(pWhiteSpaceDiffsEqual);
+    OptionCheckBox* pWhiteSpaceDiffsEqual = new OptionCheckBox(i18n("White space differences considered equal"), findItem<OptionBool>("WhiteSpaceEqual"), page);
+    addOptionWidget(pWhiteSpaceDiffsEqual);
     gbox->addWidget(pWhiteSpaceDiffsEqual, line, 0, 1, 2);
     pWhiteSpaceDiffsEqual->setToolTip(i18n(
         "If files differ only by white space consider them equal.\n"
@@ -1301,8 +1178,8 @@ void OptionDialog::setupDirectoryMergePage()
     pWhiteSpaceDiffsEqual->setEnabled(false);
     ++line;
 
-    OptionCheckBox* pCopyNewer = new OptionCheckBox(i18n("Copy newer instead of merging (unsafe)"), false, "CopyNewer", &m_options->m_bDmCopyNewer, page);
-    addOptionItem(pCopyNewer);
+    OptionCheckBox* pCopyNewer = new OptionCheckBox(i18n("Copy newer instead of merging (unsafe)"), findItem<OptionBool>("CopyNewer"), page);
+    addOptionWidget(pCopyNewer);
     gbox->addWidget(pCopyNewer, line, 0, 1, 2);
     pCopyNewer->setToolTip(i18n(
         "Do not look inside, just take the newer file.\n"
@@ -1310,14 +1187,35 @@ void OptionDialog::setupDirectoryMergePage()
         "Only effective when comparing two folders."));
     ++line;
 
-    OptionCheckBox* pCreateBakFiles = new OptionCheckBox(i18n("Backup files (.orig)"), true, "CreateBakFiles", &m_options->m_bDmCreateBakFiles, page);
+    OptionCheckBox* pCreateBakFiles = new OptionCheckBox(i18n("Backup files (.orig)"), findItem<OptionBool>("CreateBakFiles"), page);
     gbox->addWidget(pCreateBakFiles, line, 0, 1, 2);
-    addOptionItem(pCreateBakFiles);
+    addOptionWidget(pCreateBakFiles);
     pCreateBakFiles->setToolTip(i18n(
         "If a file would be saved over an old file, then the old file\n"
         "will be renamed with a '.orig' extension instead of being deleted."));
     ++line;
 
+    label = new QLabel(i18n("Parallel file operations:"), page);
+    gbox->addWidget(label, line, 0);
+    OptionIntEdit* pMaxNofParallelOperations = new OptionIntEdit(findItem<OptionInt>("MaxNofParallelDmOperations"), 1, 64, page);
+    gbox->addWidget(pMaxNofParallelOperations, line, 1);
+    addOptionWidget(pMaxNofParallelOperations);
+    label->setToolTip(i18n(
+        "How many copy and delete operations on local folders may run at the same time\n"
+        "during a folder merge, 1 runs them one after the other.\n"
+        "The items of a folder are always processed in order. Range: 1-64"));
+    ++line;
+
+    label = new QLabel(i18n("Parallel remote listings:"), page);
+    gbox->addWidget(label, line, 0);
+    OptionIntEdit* pMaxNofParallelRemoteListings = new OptionIntEdit(findItem<OptionInt>("MaxNofParallelRemoteListings"), 1, 32, page);
+    gbox->addWidget(pMaxNofParallelRemoteListings, line, 1);
+    addOptionWidget(pMaxNofParallelRemoteListings);
+    label->setToolTip(i18n(
+        "How many subfolders of a remote folder may be listed at the same time,\n"
+        "1 lists them one after the other. Range: 1-32"));
+    ++line;
+
     topLayout->addStretch(10);
 }
 void OptionDialog::setupRegionalPage()
@@ -1347,8 +1245,8 @@ void OptionDialog::setupRegionalPage()
 
     QLabel* label;
 
-    m_pSameEncoding = new OptionCheckBox(i18n("Use the same encoding for everything:"), true, "SameEncoding", &m_options->m_bSameEncoding, page);
-    addOptionItem(m_pSameEncoding);
+    m_pSameEncoding = new OptionCheckBox(i18n("Use the same encoding for everything:"), findItem<OptionBool>("SameEncoding"), page);
+    addOptionWidget(m_pSameEncoding);
     gbox->addWidget(m_pSameEncoding, line, 0, 1, 2);
     m_pSameEncoding->setToolTip(i18n(
         "Enable this allows to change all encodings by changing the first only.\n"
@@ -1361,49 +1259,49 @@ void OptionDialog::setupRegionalPage()
 
     label = new QLabel(i18n("File Encoding for A:"), page);
     gbox->addWidget(label, line, 0);
-    m_pEncodingAComboBox = new OptionEncodingComboBox("EncodingForA", &m_options->m_pEncodingA, page);
-    addOptionItem(m_pEncodingAComboBox);
+    m_pEncodingAComboBox = new OptionEncodingComboBox(findItem<OptionCodecPointer>("EncodingForA"), page);
+    addOptionWidget(m_pEncodingAComboBox);
     gbox->addWidget(m_pEncodingAComboBox, line, 1);
 
     QString autoDetectToolTip = i18n(
         "If enabled then Unicode (UTF-16 or UTF-8) encoding will be detected.\n"
         "If the file is not Unicode then the selected encoding will be used as fallback.\n"
         "(Unicode detection depends on the first bytes of a file.)");
-    m_pAutoDetectUnicodeA = new OptionCheckBox(i18n("Auto Detect Unicode"), true, "AutoDetectUnicodeA", &m_options->m_bAutoDetectUnicodeA, page);
+    m_pAutoDetectUnicodeA = new OptionCheckBox(i18n("Auto Detect Unicode"), findItem<OptionBool>("AutoDetectUnicodeA"), page);
     gbox->addWidget(m_pAutoDetectUnicodeA, line, 2);
-    addOptionItem(m_pAutoDetectUnicodeA);
+    addOptionWidget(m_pAutoDetectUnicodeA);
     m_pAutoDetectUnicodeA->setToolTip(autoDetectToolTip);
     ++line;
 
     label = new QLabel(i18n("File Encoding for B:"), page);
     gbox->addWidget(label, line, 0);
-    m_pEncodingBComboBox = new OptionEncodingComboBox("EncodingForB", &m_options->m_pEncodingB, page);
-    addOptionItem(m_pEncodingBComboBox);
+    m_pEncodingBComboBox = new OptionEncodingComboBox(findItem<OptionCodecPointer>("EncodingForB"), page);
+    addOptionWidget(m_pEncodingBComboBox);
     gbox->addWidget(m_pEncodingBComboBox, line, 1);
-    m_pAutoDetectUnicodeB = new OptionCheckBox(i18n("Auto Detect Unicode"), true, "AutoDetectUnicodeB", &m_options->m_bAutoDetectUnicodeB, page);
-    addOptionItem(m_pAutoDetectUnicodeB);
+    m_pAutoDetectUnicodeB = new OptionCheckBox(i18n("Auto Detect Unicode"), findItem<OptionBool>("AutoDetectUnicodeB"), page);
+    addOptionWidget(m_pAutoDetectUnicodeB);
     gbox->addWidget(m_pAutoDetectUnicodeB, line, 2);
     m_pAutoDetectUnicodeB->setToolTip(autoDetectToolTip);
     ++line;
 
     label = new QLabel(i18n("File Encoding for C:"), page);
     gbox->addWidget(label, line, 0);
-    m_pEncodingCComboBox = new OptionEncodingComboBox("EncodingForC", &m_options->m_pEncodingC, page);
-    addOptionItem(m_pEncodingCComboBox);
+    m_pEncodingCComboBox = new OptionEncodingComboBox(findItem<OptionCodecPointer>("EncodingForC"), page);
+    addOptionWidget(m_pEncodingCComboBox);
     gbox->addWidget(m_pEncodingCComboBox, line, 1);
-    m_pAutoDetectUnicodeC = new OptionCheckBox(i18n("Auto Detect Unicode"), true, "AutoDetectUnicodeC", &m_options->m_bAutoDetectUnicodeC, page);
-    addOptionItem(m_pAutoDetectUnicodeC);
+    m_pAutoDetectUnicodeC = new OptionCheckBox(i18n("Auto Detect Unicode"), findItem<OptionBool>("AutoDetectUnicodeC"), page);
+    addOptionWidget(m_pAutoDetectUnicodeC);
     gbox->addWidget(m_pAutoDetectUnicodeC, line, 2);
     m_pAutoDetectUnicodeC->setToolTip(autoDetectToolTip);
     ++line;
 
     label = new QLabel(i18n("File Encoding for Merge Output and Saving:"), page);
     gbox->addWidget(label, line, 0);
-    m_pEncodingOutComboBox = new OptionEncodingComboBox("EncodingForOutput", &m_options->m_pEncodingOut, page);
-    addOptionItem(m_pEncodingOutComboBox);
+    m_pEncodingOutComboBox = new OptionEncodingComboBox(findItem<OptionCodecPointer>("EncodingForOutput"), page);
+    addOptionWidget(m_pEncodingOutComboBox);
     gbox->addWidget(m_pEncodingOutComboBox, line, 1);
-    m_pAutoSelectOutEncoding = new OptionCheckBox(i18n("Auto Select"), true, "AutoSelectOutEncoding", &m_options->m_bAutoSelectOutEncoding, page);
-    addOptionItem(m_pAutoSelectOutEncoding);
+    m_pAutoSelectOutEncoding = new OptionCheckBox(i18n("Auto Select"), findItem<OptionBool>("AutoSelectOutEncoding"), page);
+    addOptionWidget(m_pAutoSelectOutEncoding);
     gbox->addWidget(m_pAutoSelectOutEncoding, line, 2);
     m_pAutoSelectOutEncoding->setToolTip(i18n(
         "If enabled then the encoding from the input files is used.\n"
@@ -1411,8 +1309,8 @@ void OptionDialog::setupRegionalPage()
     ++line;
     label = new QLabel(i18n("File Encoding for Preprocessor Files:"), page);
     gbox->addWidget(label, line, 0);
-    m_pEncodingPPComboBox = new OptionEncodingComboBox("EncodingForPP", &m_options->m_pEncodingPP, page);
-    addOptionItem(m_pEncodingPPComboBox);
+    m_pEncodingPPComboBox = new OptionEncodingComboBox(findItem<OptionCodecPointer>("EncodingForPP"), page);
+    addOptionWidget(m_pEncodingPPComboBox);
     gbox->addWidget(m_pEncodingPPComboBox, line, 1);
     ++line;
 
@@ -1421,8 +1319,8 @@ void OptionDialog::setupRegionalPage()
     chk_connect_a(m_pAutoDetectUnicodeA, &OptionCheckBox::toggled, this, &OptionDialog::slotEncodingChanged);
     chk_connect_a(m_pAutoSelectOutEncoding, &OptionCheckBox::toggled, this, &OptionDialog::slotEncodingChanged);
 
-    OptionCheckBox* pRightToLeftLanguage = new OptionCheckBox(i18n("Right To Left Language"), false, "RightToLeftLanguage", &m_options->m_bRightToLeftLanguage, page);
-    addOptionItem(pRightToLeftLanguage);
+    OptionCheckBox* pRightToLeftLanguage = new OptionCheckBox(i18n("Right To Left Language"), findItem<OptionBool>("RightToLeftLanguage"), page);
+    addOptionWidget(pRightToLeftLanguage);
     gbox->addWidget(pRightToLeftLanguage, line, 0, 1, 2);
     pRightToLeftLanguage->setToolTip(i18n(
         "Some languages are read from right to left.\n"
@@ -1459,18 +1357,18 @@ void OptionDialog::setupIntegrationPage()
     QLabel* label;
     label = new QLabel(i18n("Command line options to ignore:"), page);
     gbox->addWidget(label, line, 0);
-    OptionLineEdit* pIgnorableCmdLineOptions = new OptionLineEdit("-u;-query;-html;-abort", "IgnorableCmdLineOptions", &m_options->m_ignorableCmdLineOptions, page);
+    OptionLineEdit* pIgnorableCmdLineOptions = new OptionLineEdit(findItem<OptionStringHistory>("IgnorableCmdLineOptions"), page);
     gbox->addWidget(pIgnorableCmdLineOptions, line, 1, 1, 2);
-    addOptionItem(pIgnorableCmdLineOptions);
+    addOptionWidget(pIgnorableCmdLineOptions);
     label->setToolTip(i18n(
         "List of command line options that should be ignored when KDiff3 is used by other tools.\n"
         "Several values can be specified if separated via ';'\n"
         "This will suppress the \"Unknown option\" error."));
     ++line;
 
-    OptionCheckBox* pEscapeKeyQuits = new OptionCheckBox(i18n("Quit also via Escape key"), false, "EscapeKeyQuits", &m_options->m_bEscapeKeyQuits, page);
+    OptionCheckBox* pEscapeKeyQuits = new OptionCheckBox(i18n("Quit also via Escape key"), findItem<OptionBool>("EscapeKeyQuits"), page);
     gbox->addWidget(pEscapeKeyQuits, line, 0, 1, 2);
-    addOptionItem(pEscapeKeyQuits);
+    addOptionWidget(pEscapeKeyQuits);
     pEscapeKeyQuits->setToolTip(i18n(
         "Fast method to exit.\n"
         "For those who are used to using the Escape key."));
@@ -1522,7 +1420,10 @@ void OptionDialog::slotOk()
 /** Copy the values from the widgets to the public variables.*/
 void OptionDialog::slotApply()
 {
-    m_options->apply();
+    for(OptionWidget* pWidget : m_optionWidgets)
+    {
+        pWidget->apply();
+    }
 
     Q_EMIT applyDone();
 }
@@ -1540,43 +1441,24 @@ void OptionDialog::slotDefault()
 
 void OptionDialog::resetToDefaults()
 {
-    m_options->resetToDefaults();
+    for(OptionWidget* pWidget : m_optionWidgets)
+    {
+        pWidget->setToDefault();
+    }
     slotEncodingChanged();
 }
 
 /** Initialise the widgets using the values in the public varibles. */
 void OptionDialog::setState()
 {
-    m_options->setToCurrent();
+    for(OptionWidget* pWidget : m_optionWidgets)
+    {
+        pWidget->setToCurrent();
+    }
 
     slotEncodingChanged();
 }
 
-void OptionDialog::saveOptions(KSharedConfigPtr config)
-{
-    // No i18n()-Translations here!
-    m_options->saveOptions(config);
-}
-
-void OptionDialog::readOptions(KSharedConfigPtr config)
-{
-    // No i18n()-Translations here!
-    m_options->readOptions(config);
-
-    setState();
-}
-
-const QString OptionDialog::parseOptions(const QStringList& optionList)
-{
-
-    return m_options->parseOptions(optionList);
-}
-
-QString OptionDialog::calcOptionHelp()
-{
-    return m_options->calcOptionHelp();
-}
-
 void OptionDialog::slotHistoryMergeRegExpTester()
 {
     QPointer<RegExpTester> dlg=QPointer<RegExpTester>(new RegExpTester(this, s_autoMergeRegExpToolTip, s_historyStartRegExpToolTip,
@@ -16,13 +16,14 @@
 #include <QGroupBox>
 
 #include <KPageDialog>
-#include <KSharedConfig>
+
+#include <list>
 
 
 class QLabel;
 class QPlainTextEdit;
 
-class OptionItemBase;
+class OptionWidget;
 class OptionCheckBox;
 class OptionEncodingComboBox;
 class OptionLineEdit;
@@ -33,20 +34,12 @@ class OptionDialog : public KPageDialog
 
 public:
 
-    explicit OptionDialog( bool bShowDirMergeSettings, QWidget *parent = nullptr );
+    // Shows the settings of pOptions, they must be read before.
+    OptionDialog(bool bShowDirMergeSettings, const QSharedPointer<Options>& pOptions, QWidget* parent = nullptr);
     ~OptionDialog() override;
-    const QString parseOptions( const QStringList& optionList );
-    QString calcOptionHelp();
-
-    void saveOptions(KSharedConfigPtr config);
-    void readOptions(KSharedConfigPtr config);
 
     void setState(); // Must be called before calling exec();
 
-    void addOptionItem(OptionItemBase*);
-
-    QSharedPointer<Options> getOptions() { return m_options; }
-
     static const QString s_historyEntryStartRegExpToolTip;
     static const QString s_historyEntryStartSortKeyOrderToolTip;
     static const QString s_autoMergeRegExpToolTip;
@@ -72,11 +65,16 @@ private:
     void setupDirectoryMergePage();
     void setupRegionalPage();
     void setupIntegrationPage();
-    void setupOtherOptions();
+
+    void addOptionWidget(OptionWidget* pWidget);
+    // The setting saved as saveName, it must exist.
+    template <class T>
+    T* findItem(const char* saveName) const;
 
     void resetToDefaults();
 
-    QSharedPointer<Options> m_options=QSharedPointer<Options>::create();
+    QSharedPointer<Options> m_options;
+    std::list<OptionWidget*> m_optionWidgets; // Owned by their pages
     //QDialogButtonBox *mButtonBox;
     OptionCheckBox* m_pSameEncoding;
     OptionEncodingComboBox* m_pEncodingAComboBox;
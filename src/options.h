@@ -30,16 +30,25 @@ enum e_LineEndStyle
    eLineEndStyleConflict   // User must resolve manually
 };
 
+enum e_DiffAlgorithm
+{
+   eDiffAlgorithmGnuDiff=0,
+   eDiffAlgorithmHistogram
+};
+
 class Options
 {
 public:
+    /*
+        Adds all settings with their defaults. The option dialog only shows them, so they can be read
+        before it is made.
+    */
     void init();
-
-    void apply();
-
-    void resetToDefaults();
-
-    void setToCurrent();
+    /*
+        Adds only the settings that loading, comparing and merging files needs. For merging without
+        the GUI.
+    */
+    void initWithoutGui();
 
     void saveOptions(const KSharedConfigPtr config);
     void readOptions(const KSharedConfigPtr config);
@@ -48,6 +57,8 @@ public:
     QString calcOptionHelp();
 
     void addOptionItem(OptionItemBase* inItem);
+    // Returns nullptr if no setting is saved as saveName.
+    OptionItemBase* findItem(const QString& saveName) const;
 
     const QSize& getGeometry() const { return m_geometry; }
     void setGeometry(const QSize& size) { m_geometry = size; }
@@ -121,6 +132,8 @@ public:
 
     bool m_bPreserveCarriageReturn = false;
     bool m_bTryHard = true;
+    e_DiffAlgorithm m_diffAlgorithm = eDiffAlgorithmGnuDiff;
+    int m_diffTimeLimit = 0; // Seconds per comparison, 0 means no limit.
     bool m_bShowWhiteSpaceCharacters = true;
     bool m_bShowWhiteSpace = true;
     bool m_bShowLineNumbers = false;
@@ -135,6 +148,7 @@ public:
     bool m_bIgnoreComments = false;
     QString m_PreProcessorCmd;
     QString m_LineMatchingPreProcessorCmd;
+    bool m_bCachePreProcessorOutput = false;
     bool m_bRunRegExpAutoMergeOnMergeStart = false;
     QString m_autoMergeRegExp = ".*\\$(Version|Header|Date|Author).*\\$.*";
     bool m_bRunHistoryAutoMergeOnMergeStart = false;
@@ -169,14 +183,20 @@ public:
     bool m_bDmTrustDate = false;
     bool m_bDmTrustDateFallbackToBinary = false;
     bool m_bDmTrustSize = false;
+    bool m_bDmUseHashCache = false;
+    bool m_bDmTrustHashCache = false;
+    bool m_bDmHashDifferingFiles = false;
     bool m_bDmCopyNewer = false;
     //bool m_bDmShowOnlyDeltas;
     bool m_bDmShowIdenticalFiles = true;
+    bool m_bDmWatchFolders = false;
     bool m_bDmUseCvsIgnore = false;
     bool m_bDmWhiteSpaceEqual = true;
     bool m_bDmCaseSensitiveFilenameComparison;
     bool m_bDmUnfoldSubdirs = false;
     bool m_bDmSkipDirStatus = false;
+    int m_maxNofParallelDmOperations = 4; // 1 runs the copies and deletes one after the other.
+    int m_maxNofParallelRemoteListings = 4; // KIO list jobs at the same time for remote folders.
     QString m_DmFilePattern = "*";
     QString m_DmFileAntiPattern = "*.orig;*.o;*.obj;*.rej;*.bak";
     QString m_DmDirAntiPattern = "CVS;.deps;.svn;.hg;.git";
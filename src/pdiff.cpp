@@ -10,10 +10,14 @@
 #include "DirectoryInfo.h"
 #include "directorymergewindow.h"
 #include "fileaccess.h"
+#include "FullAnalysis.h"
 #include "Logging.h"
 #include "kdiff3.h"
+#include "kdiff3_shell.h"
+#include "MemoryUsage.h"
 #include "optiondialog.h"
 #include "progress.h"
+#include "Tracing.h"
 #include "Utils.h"
 
 #include "mergeresultwindow.h"
@@ -35,11 +39,16 @@
 #include <QMimeData>
 #include <QPointer>
 #include <QProcess>
+#include <QRunnable>
 #include <QScrollBar>
+#include <QSemaphore>
 #include <QSplitter>
 #include <QStatusBar>
 #include <QStringList>
 #include <QTextCodec>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QTimer>
 #include <QUrl>
 
 #include <KLocalizedString>
@@ -56,10 +65,116 @@ void addWidget(L* layout, W* widget)
     layout->addWidget(widget);
 }
 
-void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, bool bUseCurrentEncoding)
+class ReadAndPreprocessRunnable : public QRunnable
 {
+  private:
+    QSharedPointer<SourceData> m_pSourceData;
+    QTextCodec* m_pEncoding;
+    bool m_bAutoDetectUnicode;
+    QStringList& m_errors;
+    QSemaphore& m_finished;
+
+  public:
+    ReadAndPreprocessRunnable(const QSharedPointer<SourceData>& pSourceData, QTextCodec* pEncoding, bool bAutoDetectUnicode,
+                              QStringList& errors, QSemaphore& finished)
+        : m_pSourceData(pSourceData), m_pEncoding(pEncoding), m_bAutoDetectUnicode(bAutoDetectUnicode), m_errors(errors), m_finished(finished)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        m_errors = m_pSourceData->readAndPreprocess(m_pEncoding, m_bAutoDetectUnicode);
+        m_finished.release();
+    }
+};
+
+/*
+    Compares two inputs. When the line data from before a reload is given only the lines that changed are
+    compared again, see DiffList::rerunDiff(). Without a reload pOldManualDiffHelpList gives the alignments
+    oldDiffList was computed with, only the ranges next to changed alignments are compared again.
+    A non-empty alignment is a unified diff given on the command line, it replaces the comparison if it fits.
+    The line hashes must already be computed if several comparisons run at the same time.
+*/
+static void runDiff(ManualDiffHelpList& manualDiffHelpList, const QSharedPointer<Options>& pOptions,
+                    const QSharedPointer<SourceData>& sd1, const QSharedPointer<SourceData>& sd2, DiffList& diffList, e_SrcSelector winIdx1, e_SrcSelector winIdx2,
+                    const DiffList& oldDiffList, const QVector<LineData>& oldLines1, const QVector<LineData>& oldLines2,
+                    const ManualDiffHelpList* pOldManualDiffHelpList, const QByteArray& alignment)
+{
+    // Inputs that share their data are equal, see SourceData::shareDataOf(). Manual alignments may still move lines.
+    if(sd1->sharesDataWith(sd2) && manualDiffHelpList.empty())
+    {
+        diffList.clear();
+        diffList.setDegraded(false);
+        diffList.push_back(Diff(sd1->getSizeLines(), 0, 0));
+        return;
+    }
+
+    if(!alignment.isEmpty() && manualDiffHelpList.empty())
+    {
+        QString errorReason;
+        if(diffList.readUnifiedDiff(alignment, sd1->getSizeLines(), sd2->getSizeLines(), errorReason))
+            return;
+        qCWarning(kdiffMain) << "Comparing instead of the given alignment:" << errorReason;
+    }
+
+    const QVector<size_t>* pHashes1 = sd1->getLineHashesForDiff(pOptions->m_bIgnoreNumbers);
+    const QVector<size_t>* pHashes2 = sd2->getLineHashesForDiff(pOptions->m_bIgnoreNumbers);
+    const QVector<LineData>* pLines1 = sd1->getNormalizedLineDataForDiff(pOptions->m_bIgnoreNumbers);
+    const QVector<LineData>* pLines2 = sd2->getNormalizedLineDataForDiff(pOptions->m_bIgnoreNumbers);
+
+    if(oldLines1.isEmpty() || oldLines2.isEmpty())
+        manualDiffHelpList.runDiff(pLines1, sd1->getSizeLines(), pLines2, sd2->getSizeLines(), diffList, winIdx1, winIdx2,
+                                   pOptions, pHashes1, pHashes2, pOldManualDiffHelpList, pOldManualDiffHelpList != nullptr ? &oldDiffList : nullptr);
+    else
+        diffList.rerunDiff(oldDiffList, &oldLines1, &oldLines2, pLines1, sd1->getSizeLines(), pLines2, sd2->getSizeLines(),
+                           pOptions, pHashes1, pHashes2);
+}
+
+class RunDiffRunnable : public QRunnable
+{
+  private:
+    ManualDiffHelpList& m_manualDiffHelpList;
+    QSharedPointer<Options> m_pOptions;
+    QSharedPointer<SourceData> m_sd1;
+    QSharedPointer<SourceData> m_sd2;
+    DiffList& m_diffList;
+    e_SrcSelector m_winIdx1;
+    e_SrcSelector m_winIdx2;
+    const DiffList& m_oldDiffList;
+    const QVector<LineData>& m_oldLines1;
+    const QVector<LineData>& m_oldLines2;
+    const ManualDiffHelpList* m_pOldManualDiffHelpList;
+    const QByteArray& m_alignment;
+    QSemaphore& m_finished;
+
+  public:
+    RunDiffRunnable(ManualDiffHelpList& manualDiffHelpList, const QSharedPointer<Options>& pOptions,
+                    const QSharedPointer<SourceData>& sd1, const QSharedPointer<SourceData>& sd2, DiffList& diffList, e_SrcSelector winIdx1, e_SrcSelector winIdx2,
+                    const DiffList& oldDiffList, const QVector<LineData>& oldLines1, const QVector<LineData>& oldLines2,
+                    const ManualDiffHelpList* pOldManualDiffHelpList, const QByteArray& alignment, QSemaphore& finished)
+        : m_manualDiffHelpList(manualDiffHelpList), m_pOptions(pOptions), m_sd1(sd1), m_sd2(sd2), m_diffList(diffList), m_winIdx1(winIdx1), m_winIdx2(winIdx2),
+          m_oldDiffList(oldDiffList), m_oldLines1(oldLines1), m_oldLines2(oldLines2), m_pOldManualDiffHelpList(pOldManualDiffHelpList), m_alignment(alignment), m_finished(finished)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        runDiff(m_manualDiffHelpList, m_pOptions, m_sd1, m_sd2, m_diffList, m_winIdx1, m_winIdx2, m_oldDiffList, m_oldLines1, m_oldLines2, m_pOldManualDiffHelpList, m_alignment);
+        m_finished.release();
+    }
+};
+
+void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, bool bUseCurrentEncoding, bool bIncrementalReload)
+{
+    // The word wrap reads the data replaced here, it is started again at the end.
+    stopBackgroundWordWrap();
+
+    TraceSpan span("mainInit");
     ProgressProxy pp;
     QStringList errors;
+    QStringList errorsA, errorsB, errorsC;
     // When doing a full analysis in the directory-comparison, then the statistics-results
     // will be stored in the given TotalDiffStatus. Otherwise it will be 0.
     bool bGUI = pTotalDiffStatus == nullptr;
@@ -105,8 +220,30 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, boo
     m_diff3LineList.clear();
     m_diff3LineVector.clear();
 
+    // Line data and diffs of the last comparison, for an incremental reload.
+    LineDataSnapshot oldLinesA, oldLinesB, oldLinesC;
+    DiffList oldDiffList12, oldDiffList13, oldDiffList23;
+    // Alignments the diff lists were computed with, when they are compared again without a reload.
+    const ManualDiffHelpList* pOldManualDiffHelpList = nullptr;
     if(bLoadFiles)
     {
+        // Diff lists that are not computed again below must not outlive the data they were computed for.
+        oldDiffList12.swap(m_diffList12);
+        oldDiffList13.swap(m_diffList13);
+        oldDiffList23.swap(m_diffList23);
+
+        if(bIncrementalReload && m_manualDiffHelpList.empty() && m_lineDiffOptions == LineDiffOptions::of(*m_pOptions))
+        {
+            // The lines runDiff() compared, see there.
+            const bool bIgnoreNumbers = m_pOptions->m_bIgnoreNumbers;
+            if(m_sd1->getNormalizedLineDataForDiff(bIgnoreNumbers) != nullptr)
+                oldLinesA = LineDataSnapshot(*m_sd1->getNormalizedLineDataForDiff(bIgnoreNumbers));
+            if(m_sd2->getNormalizedLineDataForDiff(bIgnoreNumbers) != nullptr)
+                oldLinesB = LineDataSnapshot(*m_sd2->getNormalizedLineDataForDiff(bIgnoreNumbers));
+            if(m_sd3->getNormalizedLineDataForDiff(bIgnoreNumbers) != nullptr)
+                oldLinesC = LineDataSnapshot(*m_sd3->getNormalizedLineDataForDiff(bIgnoreNumbers));
+        }
+
         m_manualDiffHelpList.clear();
 
         if(m_sd3->isEmpty())
@@ -114,37 +251,103 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, boo
         else
             pp.setMaxNofSteps(9); // Read 3 files, 3 comparisons, 3 finediffs
 
-        // First get all input data.
-        pp.setInformation(i18n("Loading A"));
+        // First get all input data. The files don't depend on each other so they are read in parallel.
+        TraceSpan loadSpan("loadFiles");
+        pp.setInformation(i18n("Loading files"));
         qCInfo(kdiffMain) << i18n("Loading A: %1", m_sd1->getFilename());
+        qCInfo(kdiffMain) << i18n("Loading B: %1", m_sd2->getFilename());
+        if(!m_sd3->isEmpty())
+            qCInfo(kdiffMain) << i18n("Loading C: %1", m_sd3->getFilename());
+
+        const QSharedPointer<SourceData> sources[] = {m_sd1, m_sd2, m_sd3};
+        QTextCodec* const optionEncodings[] = {m_pOptions->m_pEncodingA, m_pOptions->m_pEncodingB, m_pOptions->m_pEncodingC};
+        const bool optionAutoDetect[] = {m_pOptions->m_bAutoDetectUnicodeA, m_pOptions->m_bAutoDetectUnicodeB, m_pOptions->m_bAutoDetectUnicodeC};
+        QStringList* const sourceErrors[] = {&errorsA, &errorsB, &errorsC};
+        const int nofFiles = m_sd3->isEmpty() ? 2 : 3;
+
+        // Remote files are all read at the same time, see RemoteFetch. KIO only works on the GUI thread.
+        RemoteFetch remoteFetch;
+        int sourceOfFetch[3];
+        for(int i = 0; i < nofFiles; ++i)
+        {
+            if(sources[i]->isRemote())
+                sourceOfFetch[remoteFetch.start(sources[i]->getFileAccess())] = i;
+        }
 
-        if(bUseCurrentEncoding)
-            errors = m_sd1->readAndPreprocess(m_sd1->getEncoding(), false);
-        else
-            errors = m_sd1->readAndPreprocess(m_pOptions->m_pEncodingA, m_pOptions->m_bAutoDetectUnicodeA);
+        QTextCodec* encodings[3];
+        bool autoDetect[3];
+        // An input with the same bytes and options as an earlier one is not read again, see shareDataOf().
+        int sameAs[3] = {-1, -1, -1};
+        int nofLoads = 0;
+        for(int i = 0; i < nofFiles; ++i)
+        {
+            encodings[i] = bUseCurrentEncoding ? sources[i]->getEncoding() : optionEncodings[i];
+            autoDetect[i] = !bUseCurrentEncoding && optionAutoDetect[i];
+            for(int j = 0; j < i && sameAs[i] < 0; ++j)
+            {
+                if(sameAs[j] < 0 && encodings[j] == encodings[i] && autoDetect[j] == autoDetect[i] && sources[i]->hasEqualFileAs(sources[j]))
+                    sameAs[i] = j;
+            }
+            if(sameAs[i] < 0)
+                ++nofLoads;
+        }
 
-        if(!errors.isEmpty())
+        QSemaphore loadedFiles;
+        for(int i = 0; i < nofFiles; ++i)
         {
-            KMessageBox::errorList(m_pOptionDialog, i18n("Errors occurred during pre-processing of file A."), errors);
+            if(!sources[i]->isRemote() && sameAs[i] < 0)
+                QThreadPool::globalInstance()->start(new ReadAndPreprocessRunnable(sources[i], encodings[i], autoDetect[i], *sourceErrors[i], loadedFiles));
+        }
+        // A remote file is decoded as soon as it arrived, while the others still transfer.
+        for(int fetch = remoteFetch.waitForNext(); fetch >= 0; fetch = remoteFetch.waitForNext())
+        {
+            const int i = sourceOfFetch[fetch];
+            sources[i]->setFetchedData(remoteFetch.takeData(fetch), remoteFetch.errorString(fetch));
+            QThreadPool::globalInstance()->start(new ReadAndPreprocessRunnable(sources[i], encodings[i], autoDetect[i], *sourceErrors[i], loadedFiles));
         }
 
-        pp.step();
+        for(int i = 0; i < nofLoads; ++i)
+        {
+            // wasCancelled() keeps processing events while the files are loading.
+            while(!loadedFiles.tryAcquire(1, 100))
+                pp.wasCancelled();
+            pp.step();
+        }
+        for(int i = 0; i < nofFiles; ++i)
+        {
+            if(sameAs[i] >= 0)
+            {
+                sources[i]->shareDataOf(sources[sameAs[i]]);
+                *sourceErrors[i] = *sourceErrors[sameAs[i]];
+                pp.step();
+            }
+        }
+        loadSpan.setItemCount(nofFiles);
 
-        pp.setInformation(i18n("Loading B"));
-        qCInfo(kdiffMain) << i18n("Loading B: %1", m_sd2->getFilename());
+        m_sd1->disableFailedPreProcessors();
+        m_sd2->disableFailedPreProcessors();
+        m_sd3->disableFailedPreProcessors();
 
-        if(bUseCurrentEncoding)
-            errors = m_sd2->readAndPreprocess(m_sd2->getEncoding(), false);
-        else
-            errors = m_sd2->readAndPreprocess(m_pOptions->m_pEncodingB, m_pOptions->m_bAutoDetectUnicodeB);
+        if(!errorsA.isEmpty())
+        {
+            KMessageBox::errorList(this, i18n("Errors occurred during pre-processing of file A."), errorsA);
+        }
 
-        if(!errors.isEmpty())
-            KMessageBox::errorList(m_pOptionDialog, i18n("Errors occurred during pre-processing of file B."), errors);
+        if(!errorsB.isEmpty())
+            KMessageBox::errorList(this, i18n("Errors occurred during pre-processing of file B."), errorsB);
 
-        pp.step();
+        errors = errorsB;
     }
     else
     {
+        if(m_lineDiffOptions == LineDiffOptions::of(*m_pOptions))
+        {
+            oldDiffList12.swap(m_diffList12);
+            oldDiffList13.swap(m_diffList13);
+            oldDiffList23.swap(m_diffList23);
+            pOldManualDiffHelpList = &m_diffManualDiffHelpList;
+        }
+
         if(m_sd3->isEmpty())
             pp.setMaxNofSteps(2); // 1 comparison, 1 finediff
         else
@@ -153,148 +356,95 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, boo
 
     if(pTotalDiffStatus)
         pTotalDiffStatus->reset();
+    m_binaryDiffList12.clear();
     if(errors.isEmpty())
     {
         // Run the diff.
         if(m_sd3->isEmpty())
         {
             pTotalDiffStatus->setBinaryEqualAB(m_sd1->isBinaryEqualWith(m_sd2));
+            // Binary data gets no line diff, only the differing byte ranges.
+            if((!m_sd1->isText() || !m_sd2->isText()) && !pTotalDiffStatus->isBinaryEqualAB())
+            {
+                qCInfo(kdiffMain) << "Binary diff: A <-> B";
+                m_binaryDiffList12 = m_sd1->binaryDiffWith(m_sd2);
+            }
 
             if(m_sd1->isText() && m_sd2->isText())
             {
                 pp.setInformation(i18n("Diff: A <-> B"));
                 qCInfo(kdiffMain) << i18n("Diff: A <-> B");
-                m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->getSizeLines(), m_sd2->getLineDataForDiff(), m_sd2->getSizeLines(), m_diffList12, e_SrcSelector::A, e_SrcSelector::B,
-                                             m_pOptionDialog->getOptions());
-
-                pp.step();
-
-                pp.setInformation(i18n("Linediff: A <-> B"));
-                qCInfo(kdiffMain) << i18n("Linediff: A <-> B");
-                m_diff3LineList.calcDiff3LineListUsingAB(&m_diffList12);
-                pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay()));
-                if(m_sd1->getSizeBytes() == 0) pTotalDiffStatus->setTextEqualAB(false);
-
-                pp.step();
-            }
-            else
-            {
-                pp.step();
-                pp.step();
+                runDiff(m_manualDiffHelpList, m_pOptions, m_sd1, m_sd2, m_diffList12, e_SrcSelector::A, e_SrcSelector::B, oldDiffList12, oldLinesA.lines(), oldLinesB.lines(), pOldManualDiffHelpList, m_alignments[0]);
             }
+            pp.step();
         }
         else
         {
             if(bLoadFiles)
             {
-                pp.setInformation(i18n("Loading C"));
-                qCInfo(kdiffMain) << i18n("Loading C: %1", m_sd2->getFilename());
-
-                if(bUseCurrentEncoding)
-                    errors = m_sd3->readAndPreprocess(m_sd3->getEncoding(), false);
-                else
-                    errors = m_sd3->readAndPreprocess(m_pOptions->m_pEncodingC, m_pOptions->m_bAutoDetectUnicodeC);
-
+                errors = errorsC;
                 if(!errors.isEmpty())
-                    KMessageBox::errorList(m_pOptionDialog, i18n("Errors occurred during pre-processing of file C."), errors);
-
-                pp.step();
+                    KMessageBox::errorList(this, i18n("Errors occurred during pre-processing of file C."), errors);
             }
 
             pTotalDiffStatus->setBinaryEqualAB(m_sd1->isBinaryEqualWith(m_sd2));
             pTotalDiffStatus->setBinaryEqualAC(m_sd1->isBinaryEqualWith(m_sd3));
             pTotalDiffStatus->setBinaryEqualBC(m_sd3->isBinaryEqualWith(m_sd2));
 
-            pp.setInformation(i18n("Diff: A <-> B"));
-            qCInfo(kdiffMain) << i18n("Diff: A <-> B");
+            // The three comparisons don't depend on each other, so they run in parallel.
+            pp.setInformation(i18n("Diff: A <-> B, A <-> C, B <-> C"));
+            qCInfo(kdiffMain) << i18n("Diff: A <-> B, A <-> C, B <-> C");
+
+            // Each input is used by two comparisons, so compute the line hashes before they start.
+            m_sd1->getLineHashesForDiff(m_pOptions->m_bIgnoreNumbers);
+            m_sd2->getLineHashesForDiff(m_pOptions->m_bIgnoreNumbers);
+            m_sd3->getLineHashesForDiff(m_pOptions->m_bIgnoreNumbers);
 
+            QSemaphore finishedDiffs;
+            int nofDiffs = 0;
             if(m_sd1->isText() && m_sd2->isText())
             {
-                m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->getSizeLines(), m_sd2->getLineDataForDiff(), m_sd2->getSizeLines(), m_diffList12, e_SrcSelector::A, e_SrcSelector::B,
-                                             m_pOptionDialog->getOptions());
-
-                m_diff3LineList.calcDiff3LineListUsingAB(&m_diffList12);
+                QThreadPool::globalInstance()->start(new RunDiffRunnable(m_manualDiffHelpList, m_pOptions, m_sd1, m_sd2, m_diffList12, e_SrcSelector::A, e_SrcSelector::B,
+                                                                         oldDiffList12, oldLinesA.lines(), oldLinesB.lines(), pOldManualDiffHelpList, m_alignments[0], finishedDiffs));
+                ++nofDiffs;
             }
-            pp.step();
-
-            pp.setInformation(i18n("Diff: A <-> C"));
-            qCInfo(kdiffMain) << i18n("Diff: A <-> C");
-
             if(m_sd1->isText() && m_sd3->isText())
             {
-                m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->getSizeLines(), m_sd3->getLineDataForDiff(), m_sd3->getSizeLines(), m_diffList13, e_SrcSelector::A, e_SrcSelector::C,
-                                             m_pOptionDialog->getOptions());
-
-                m_diff3LineList.calcDiff3LineListUsingAC(&m_diffList13);
-                m_diff3LineList.correctManualDiffAlignment(&m_manualDiffHelpList);
-                m_diff3LineList.calcDiff3LineListTrim(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), &m_manualDiffHelpList);
+                QThreadPool::globalInstance()->start(new RunDiffRunnable(m_manualDiffHelpList, m_pOptions, m_sd1, m_sd3, m_diffList13, e_SrcSelector::A, e_SrcSelector::C,
+                                                                         oldDiffList13, oldLinesA.lines(), oldLinesC.lines(), pOldManualDiffHelpList, m_alignments[1], finishedDiffs));
+                ++nofDiffs;
             }
-            pp.step();
-
-            pp.setInformation(i18n("Diff: B <-> C"));
-            qCInfo(kdiffMain) << i18n("Diff: B <-> C");
-
             if(m_sd2->isText() && m_sd3->isText())
             {
-                m_manualDiffHelpList.runDiff(m_sd2->getLineDataForDiff(), m_sd2->getSizeLines(), m_sd3->getLineDataForDiff(), m_sd3->getSizeLines(), m_diffList23, e_SrcSelector::B, e_SrcSelector::C,
-                                             m_pOptionDialog->getOptions());
-                if(m_pOptions->m_bDiff3AlignBC)
+                QThreadPool::globalInstance()->start(new RunDiffRunnable(m_manualDiffHelpList, m_pOptions, m_sd2, m_sd3, m_diffList23, e_SrcSelector::B, e_SrcSelector::C,
+                                                                         oldDiffList23, oldLinesB.lines(), oldLinesC.lines(), pOldManualDiffHelpList, m_alignments[2], finishedDiffs));
+                ++nofDiffs;
+            }
+
+            for(int i = 0; i < 3; ++i)
+            {
+                // wasCancelled() keeps processing events while the comparisons run.
+                if(i < nofDiffs)
                 {
-                    m_diff3LineList.calcDiff3LineListUsingBC(&m_diffList23);
-                    m_diff3LineList.correctManualDiffAlignment(&m_manualDiffHelpList);
-                    m_diff3LineList.calcDiff3LineListTrim(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), &m_manualDiffHelpList);
+                    while(!finishedDiffs.tryAcquire(1, 100))
+                        pp.wasCancelled();
                 }
+                pp.step();
             }
-            pp.step();
-
-            m_diff3LineList.debugLineCheck(m_sd1->getSizeLines(), e_SrcSelector::A);
-            m_diff3LineList.debugLineCheck(m_sd2->getSizeLines(), e_SrcSelector::B);
-            m_diff3LineList.debugLineCheck(m_sd3->getSizeLines(), e_SrcSelector::C);
-
-            pp.setInformation(i18n("Linediff: A <-> B"));
-            qCInfo(kdiffMain) << i18n("Linediff: A <-> B");
-            if(m_sd1->hasData() && m_sd2->hasData() && m_sd1->isText() && m_sd2->isText())
-                pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay()));
-            pp.step();
-
-            pp.setInformation(i18n("Linediff: B <-> C"));
-            qCInfo(kdiffMain) << i18n("Linediff: B <-> C");
-            if(m_sd2->hasData() && m_sd3->hasData() && m_sd2->isText() && m_sd3->isText())
-                pTotalDiffStatus->setTextEqualBC(m_diff3LineList.fineDiff(e_SrcSelector::B, m_sd2->getLineDataForDisplay(), m_sd3->getLineDataForDisplay()));
-            pp.step();
-
-            pp.setInformation(i18n("Linediff: A <-> C"));
-            qCInfo(kdiffMain) << i18n("Linediff: A <-> C");
-            if(m_sd1->hasData() && m_sd3->hasData() && m_sd1->isText() && m_sd3->isText())
-                pTotalDiffStatus->setTextEqualAC(m_diff3LineList.fineDiff(e_SrcSelector::C, m_sd3->getLineDataForDisplay(), m_sd1->getLineDataForDisplay()));
-            m_diff3LineList.debugLineCheck(m_sd2->getSizeLines(), e_SrcSelector::B);
-            m_diff3LineList.debugLineCheck(m_sd3->getSizeLines(), e_SrcSelector::C);
+        }
+        FullAnalysis::calcDiff3LineList(m_pOptions, m_sd1, m_sd2, m_sd3, m_diffList12, m_diffList13, m_diffList23, m_manualDiffHelpList, m_diff3LineList,
+                                        *pTotalDiffStatus, &pp);
 
-            pp.setInformation(i18n("Linediff: A <-> B"));
-            if(m_sd1->hasData() && m_sd2->hasData() && m_sd1->isText() && m_sd2->isText())
-                pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay()));
-            pp.step();
+        // The alignments from the command line are for the files as they were at the start.
+        for(QByteArray& alignment: m_alignments)
+            alignment.clear();
 
-            pp.setInformation(i18n("Linediff: B <-> C"));
-            if(m_sd3->hasData() && m_sd2->hasData() && m_sd3->isText() && m_sd2->isText())
-                pTotalDiffStatus->setTextEqualBC(m_diff3LineList.fineDiff(e_SrcSelector::B, m_sd2->getLineDataForDisplay(), m_sd3->getLineDataForDisplay()));
-            pp.step();
+        pTotalDiffStatus->setDiffDegraded(m_diffList12.isDegraded() || m_diffList13.isDegraded() || m_diffList23.isDegraded());
+        if(pTotalDiffStatus->isDiffDegraded())
+            qCInfo(kdiffMain) << "The diff time limit was reached";
 
-            pp.setInformation(i18n("Linediff: A <-> C"));
-            if(m_sd1->hasData() && m_sd3->hasData() && m_sd1->isText() && m_sd3->isText())
-                pTotalDiffStatus->setTextEqualAC(m_diff3LineList.fineDiff(e_SrcSelector::C, m_sd3->getLineDataForDisplay(), m_sd1->getLineDataForDisplay()));
-            pp.step();
-            if(m_sd1->getSizeBytes() == 0)
-            {
-                pTotalDiffStatus->setTextEqualAB(false);
-                pTotalDiffStatus->setTextEqualAC(false);
-            }
-            if(m_sd2->getSizeBytes() == 0)
-            {
-                pTotalDiffStatus->setTextEqualAB(false);
-                pTotalDiffStatus->setTextEqualBC(false);
-            }
-        }
+        m_lineDiffOptions = LineDiffOptions::of(*m_pOptions);
+        m_diffManualDiffHelpList = m_manualDiffHelpList;
     }
     else
     {
@@ -307,10 +457,10 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, boo
                                m_sd1->getLineDataForDiff(), m_sd1->getSizeLines(),
                                m_sd2->getLineDataForDiff(), m_sd2->getSizeLines(),
                                m_sd3->getLineDataForDiff(), m_sd3->getSizeLines());
-        Diff3Line::m_pDiffBufferInfo = m_diffBufferInfo;
 
         m_diff3LineList.calcWhiteDiff3Lines(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff());
         m_diff3LineList.calcDiff3LineVector(m_diff3LineVector);
+        m_diff3LineList.startBackgroundFineDiff();
     }
 
     // Calc needed lines for display
@@ -354,15 +504,15 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, boo
     {
         const ManualDiffHelpList* pMDHL = &m_manualDiffHelpList;
         m_pDiffTextWindow1->init(m_sd1->getAliasName(), m_sd1->getEncoding(), m_sd1->getLineEndStyle(),
-                                 m_sd1->getLineDataForDisplay(), m_sd1->getSizeLines(), &m_diff3LineVector, pMDHL);
+                                 m_sd1->getLineDataForDisplay(), m_sd1->getSizeLines(), &m_diff3LineVector, pMDHL, m_bTripleDiff);
         m_pDiffTextWindowFrame1->init();
 
         m_pDiffTextWindow2->init(m_sd2->getAliasName(), m_sd2->getEncoding(), m_sd2->getLineEndStyle(),
-                                 m_sd2->getLineDataForDisplay(), m_sd2->getSizeLines(), &m_diff3LineVector, pMDHL);
+                                 m_sd2->getLineDataForDisplay(), m_sd2->getSizeLines(), &m_diff3LineVector, pMDHL, m_bTripleDiff);
         m_pDiffTextWindowFrame2->init();
 
         m_pDiffTextWindow3->init(m_sd3->getAliasName(), m_sd3->getEncoding(), m_sd3->getLineEndStyle(),
-                                 m_sd3->getLineDataForDisplay(), m_sd3->getSizeLines(), &m_diff3LineVector, pMDHL);
+                                 m_sd3->getLineDataForDisplay(), m_sd3->getSizeLines(), &m_diff3LineVector, pMDHL, m_bTripleDiff);
         m_pDiffTextWindowFrame3->init();
 
         m_pDiffTextWindowFrame3->setVisible(m_bTripleDiff);
@@ -375,7 +525,10 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, boo
         m_sd2->getLineDataForDisplay(), m_sd2->getSizeLines(),
         m_bTripleDiff ? m_sd3->getLineDataForDisplay() : nullptr, m_sd3->getSizeLines(),
         &m_diff3LineList,
-        pTotalDiffStatus);
+        m_diffBufferInfo,
+        pTotalDiffStatus,
+        m_bAutoSolve);
+    m_bAutoSolve = true;
     m_pMergeResultWindowTitle->setFileName(m_outputFilename.isEmpty() ? QString("unnamed.txt") : m_outputFilename);
 
     if(!bGUI)
@@ -387,7 +540,7 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, boo
     }
     else
     {
-        m_pOverview->init(&m_diff3LineList);
+        m_pOverview->init(&m_diff3LineList, m_bTripleDiff);
         DiffTextWindow::mVScrollBar->setValue(0);
         m_pHScrollBar->setValue(0);
         MergeResultWindow::mVScrollBar->setValue(0);
@@ -409,6 +562,37 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, bool bLoadFiles, boo
     }
 }
 
+void KDiff3App::reportMemoryUsage()
+{
+    // No i18n()-Translations here, this is for finding what takes the memory.
+    MemoryUsage usage;
+    usage.add(QStringLiteral("Input A"), m_sd1->memoryUsage());
+    usage.add(QStringLiteral("Input B"), m_sd2->memoryUsage());
+    usage.add(QStringLiteral("Input C"), m_sd3->memoryUsage());
+    usage.add(QStringLiteral("Diff lists"), m_diffList12.memoryUsage() + m_diffList13.memoryUsage() + m_diffList23.memoryUsage());
+    usage.add(QStringLiteral("Diff3 lines and fine diffs"), m_diff3LineList.memoryUsage());
+    usage.add(QStringLiteral("Diff3 line vector"), MemoryUsage::ofVector<Diff3Line*>(m_diff3LineVector));
+
+    const DiffTextWindow* const diffTextWindows[] = {m_pDiffTextWindow1, m_pDiffTextWindow2, m_pDiffTextWindow3};
+    qint64 wrapLines = 0;
+    for(const DiffTextWindow* pDiffTextWindow: diffTextWindows)
+    {
+        if(pDiffTextWindow != nullptr)
+            wrapLines += pDiffTextWindow->memoryUsage();
+    }
+    usage.add(QStringLiteral("Word wrap lines"), wrapLines);
+
+    if(m_pMergeResultWindow != nullptr)
+        usage.add(QStringLiteral("Merge lines"), m_pMergeResultWindow->memoryUsage());
+    if(m_dirinfo != nullptr)
+        usage.add(QStringLiteral("Folder listings"), m_dirinfo->memoryUsage());
+
+    if(m_bPrintStats)
+        QTextStream(stderr) << usage.toString();
+    else
+        qCDebug(kdiffMain).noquote() << usage.toString();
+}
+
 void KDiff3App::setLockPainting(bool bLock)
 {
     if(m_pDiffTextWindow1) m_pDiffTextWindow1->setPaintingAllowed(!bLock);
@@ -578,7 +762,7 @@ void KDiff3App::initView()
     m_pDiffWindowSplitter->setOrientation(m_pOptions->m_bHorizDiffWindowSplitting ? Qt::Horizontal : Qt::Vertical);
     pDiffHLayout->addWidget(m_pDiffWindowSplitter);
 
-    m_pOverview = new Overview(m_pOptionDialog->getOptions());
+    m_pOverview = new Overview(m_pOptions);
     m_pOverview->setObjectName("Overview");
     pDiffHLayout->addWidget(m_pOverview);
 
@@ -593,11 +777,11 @@ void KDiff3App::initView()
     connect(this, &KDiff3App::showWhiteSpaceToggled, m_pOverview, &Overview::slotRedraw);
     connect(this, &KDiff3App::changeOverViewMode, m_pOverview, &Overview::setOverviewMode);
 
-    m_pDiffTextWindowFrame1 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptionDialog->getOptions(), e_SrcSelector::A, m_sd1);
+    m_pDiffTextWindowFrame1 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptions, e_SrcSelector::A, m_sd1);
     m_pDiffWindowSplitter->addWidget(m_pDiffTextWindowFrame1);
-    m_pDiffTextWindowFrame2 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptionDialog->getOptions(), e_SrcSelector::B, m_sd2);
+    m_pDiffTextWindowFrame2 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptions, e_SrcSelector::B, m_sd2);
     m_pDiffWindowSplitter->addWidget(m_pDiffTextWindowFrame2);
-    m_pDiffTextWindowFrame3 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptionDialog->getOptions(), e_SrcSelector::C, m_sd3);
+    m_pDiffTextWindowFrame3 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptions, e_SrcSelector::C, m_sd3);
     m_pDiffWindowSplitter->addWidget(m_pDiffTextWindowFrame3);
     m_pDiffTextWindow1 = m_pDiffTextWindowFrame1->getDiffTextWindow();
     m_pDiffTextWindow2 = m_pDiffTextWindowFrame2->getDiffTextWindow();
@@ -617,10 +801,10 @@ void KDiff3App::initView()
     QVBoxLayout* pMergeVLayout = new QVBoxLayout();
     pMergeHLayout->addLayout(pMergeVLayout, 1);
 
-    m_pMergeResultWindowTitle = new WindowTitleWidget(m_pOptionDialog->getOptions());
+    m_pMergeResultWindowTitle = new WindowTitleWidget(m_pOptions);
     pMergeVLayout->addWidget(m_pMergeResultWindowTitle);
 
-    m_pMergeResultWindow = new MergeResultWindow(m_pMergeWindowFrame, m_pOptionDialog->getOptions(), statusBar());
+    m_pMergeResultWindow = new MergeResultWindow(m_pMergeWindowFrame, m_pOptions, statusBar());
     pMergeVLayout->addWidget(m_pMergeResultWindow, 1);
 
     MergeResultWindow::mVScrollBar = new QScrollBar(Qt::Vertical, m_pMergeWindowFrame);
@@ -732,6 +916,7 @@ void KDiff3App::slotFinishMainInit()
 
     slotUpdateAvailabilities();
     setUpdatesEnabled(true);
+    reportMemoryUsage();
 
     bool bVisibleMergeResultWindow = !m_outputFilename.isEmpty();
     TotalDiffStatus* pTotalDiffStatus = &m_totalDiffStatus;
@@ -766,6 +951,10 @@ void KDiff3App::slotFinishMainInit()
                     totalInfo += i18n("Files %1 and %2 have equal text, but are not binary equal. \n", i18n("B"), i18n("C"));
             }
 
+            if(!m_binaryDiffList12.isEmpty())
+                totalInfo += i18n("Files %1 and %2 differ in %3 byte ranges, the first difference is at offset %4 of %1.\n",
+                                  i18n("A"), i18n("B"), m_binaryDiffList12.size(), m_binaryDiffList12.front().offset1);
+
             if(!totalInfo.isEmpty())
                 KMessageBox::information(this, totalInfo);
         }
@@ -897,7 +1086,7 @@ void KDiff3App::slotFileOpen()
                      QDir::toNativeSeparators(m_bDirCompare ? m_dirinfo->dirB().prettyAbsPath() : m_sd2->isFromBuffer() ? QString("") : m_sd2->getAliasName()),
                      QDir::toNativeSeparators(m_bDirCompare ? m_dirinfo->dirC().prettyAbsPath() : m_sd3->isFromBuffer() ? QString("") : m_sd3->getAliasName()),
                      m_bDirCompare ? !m_dirinfo->destDir().prettyAbsPath().isEmpty() : !m_outputFilename.isEmpty(),
-                     QDir::toNativeSeparators(m_bDefaultFilename ? QString("") : m_outputFilename), m_pOptionDialog->getOptions()));
+                     QDir::toNativeSeparators(m_bDefaultFilename ? QString("") : m_outputFilename), m_pOptions));
 
         int status = d->exec();
         if(status == QDialog::Accepted)
@@ -1104,7 +1293,7 @@ void KDiff3App::slotEditPaste()
 
             if(!error.isEmpty())
             {
-                KMessageBox::error(m_pOptionDialog, error);
+                KMessageBox::error(this, error);
             }
 
             if(do_init)
@@ -1283,8 +1472,15 @@ void KDiff3App::slotJoinDiffs()
 
 void KDiff3App::slotConfigure()
 {
+    if(m_pOptionDialog == nullptr)
+    {
+        TraceSpan span("createOptionDialog");
+        m_pOptionDialog = new OptionDialog(m_pKDiff3Shell != nullptr, m_pOptions, this);
+        chk_connect_a(m_pOptionDialog, &OptionDialog::applyDone, this, &KDiff3App::slotRefresh);
+        m_pOptionDialog->setMinimumHeight(m_pOptionDialog->minimumHeight() + 40);
+    }
+
     m_pOptionDialog->setState();
-    m_pOptionDialog->setMinimumHeight(m_pOptionDialog->minimumHeight() + 40);
     m_pOptionDialog->exec();
     slotRefresh();
 }
@@ -1296,6 +1492,9 @@ void KDiff3App::slotConfigureKeys()
 
 void KDiff3App::slotRefresh()
 {
+    // The fonts may change, the word wrap running in the background uses them.
+    const bool bWordWrapStopped = stopBackgroundWordWrap();
+
     QApplication::setFont(m_pOptions->m_appFont);
 
     Q_EMIT doRefresh();
@@ -1308,6 +1507,9 @@ void KDiff3App::slotRefresh()
     {
         m_pDiffWindowSplitter->setOrientation(m_pOptions->m_bHorizDiffWindowSplitting ? Qt::Horizontal : Qt::Vertical);
     }
+
+    if(bWordWrapStopped)
+        postRecalcWordWrap();
 }
 
 void KDiff3App::slotSelectionStart()
@@ -1404,6 +1606,13 @@ void KDiff3App::postRecalcWordWrap()
         m_firstD3LIdx = -1;
         Q_EMIT sigRecalcWordWrap();
     }
+    else if(m_bWordWrapInBackground)
+    {
+        // The stale word wrap is dropped, no need to wait for it to give up.
+        stopBackgroundWordWrap();
+        m_bRecalcWordWrapPosted = true;
+        Q_EMIT sigRecalcWordWrap();
+    }
     else
     {
         g_pProgressDialog->cancel(ProgressDialog::eResize);
@@ -1418,6 +1627,10 @@ void KDiff3App::slotRecalcWordWrap()
 // visibleTextWidthForPrinting is >=0 only for printing, otherwise the really visible width is used
 void KDiff3App::recalcWordWrap(int visibleTextWidthForPrinting)
 {
+    stopBackgroundWordWrap();
+    // The windows add the runnables of a new generation.
+    DiffTextWindow::stopRunnables();
+
     m_bRecalcWordWrapPosted = true;
     mainWindowEnable(false);
 
@@ -1438,24 +1651,26 @@ void KDiff3App::recalcWordWrap(int visibleTextWidthForPrinting)
 
     g_pProgressDialog->clearCancelState(); // clear cancelled state if previously set
 
+    const bool bPrinting = visibleTextWidthForPrinting >= 0;
     if(!m_diff3LineList.empty())
     {
         if(m_pOptions->wordWrapOn())
         {
             m_diff3LineList.recalcWordWrap(true);
 
-            // Let every window calc how many lines will be needed.
+            // Let every window calc how many lines will be needed. The visible ones are done at once unless printing.
+            const int firstD3LIdx = bPrinting ? -1 : m_firstD3LIdx;
             if(m_pDiffTextWindow1)
             {
-                m_pDiffTextWindow1->recalcWordWrap(true, 0, visibleTextWidthForPrinting);
+                m_pDiffTextWindow1->recalcWordWrap(true, 0, visibleTextWidthForPrinting, firstD3LIdx);
             }
             if(m_pDiffTextWindow2)
             {
-                m_pDiffTextWindow2->recalcWordWrap(true, 0, visibleTextWidthForPrinting);
+                m_pDiffTextWindow2->recalcWordWrap(true, 0, visibleTextWidthForPrinting, firstD3LIdx);
             }
             if(m_pDiffTextWindow3)
             {
-                m_pDiffTextWindow3->recalcWordWrap(true, 0, visibleTextWidthForPrinting);
+                m_pDiffTextWindow3->recalcWordWrap(true, 0, visibleTextWidthForPrinting, firstD3LIdx);
             }
         }
         else
@@ -1477,6 +1692,20 @@ void KDiff3App::recalcWordWrap(int visibleTextWidthForPrinting)
                                                   ? i18n("Word wrap (Cancel disables word wrap)")
                                                   : i18n("Calculating max width for horizontal scrollbar"),
                                               false);
+
+            // Show the wrapped visible lines while the rest is wrapped, slotWordWrapProgress() refines it.
+            if(m_pOptions->wordWrapOn() && !bPrinting && !g_pProgressDialog->wasCancelled())
+            {
+                m_bWordWrapInBackground = true;
+                updateWordWrap(true);
+                mainWindowEnable(true);
+
+                if(m_bFinishMainInit)
+                {
+                    m_bFinishMainInit = false;
+                    slotFinishMainInit();
+                }
+            }
         }
     }
     else
@@ -1490,6 +1719,23 @@ void KDiff3App::slotFinishRecalcWordWrap(int visibleTextWidthForPrinting)
 {
     g_pProgressDialog->pop();
 
+    // Keep the line the user scrolled to while wrapping in the background.
+    if(m_bWordWrapInBackground)
+    {
+        m_bWordWrapInBackground = false;
+        if(m_pDiffTextWindow1)
+            m_firstD3LIdx = m_pDiffTextWindow1->convertLineToDiff3LineIdx(m_pDiffTextWindow1->getFirstLine());
+        if(!g_pProgressDialog->wasCancelled())
+        {
+            if(m_pDiffTextWindow1)
+                m_pDiffTextWindow1->convertSelectionToD3LCoords();
+            if(m_pDiffTextWindow2)
+                m_pDiffTextWindow2->convertSelectionToD3LCoords();
+            if(m_pDiffTextWindow3)
+                m_pDiffTextWindow3->convertSelectionToD3LCoords();
+        }
+    }
+
     if(m_pOptions->wordWrapOn() && g_pProgressDialog->wasCancelled())
     {
         if(g_pProgressDialog->cancelReason() == ProgressDialog::eUserAbort)
@@ -1564,6 +1810,83 @@ void KDiff3App::slotFinishRecalcWordWrap(int visibleTextWidthForPrinting)
         m_pEventLoopForPrinting->quit();
 }
 
+void KDiff3App::slotWordWrapProgress()
+{
+    // Chunks finish quickly one after the other, take them together.
+    static const int wordWrapUpdateDelay = 200;
+
+    if(m_bWordWrapInBackground && !m_bWordWrapUpdatePosted)
+    {
+        m_bWordWrapUpdatePosted = true;
+        QTimer::singleShot(wordWrapUpdateDelay, this, &KDiff3App::slotUpdateWordWrap);
+    }
+}
+
+void KDiff3App::slotUpdateWordWrap()
+{
+    m_bWordWrapUpdatePosted = false;
+    if(m_bWordWrapInBackground)
+        updateWordWrap(false);
+}
+
+/*
+    Makes the wrap lines from what is wrapped so far, lines not wrapped yet take one line each.
+    The first visible line stays where it is.
+*/
+void KDiff3App::updateWordWrap(bool bSelectionInD3LCoords)
+{
+    if(!bSelectionInD3LCoords)
+    {
+        if(m_pDiffTextWindow1)
+        {
+            m_firstD3LIdx = m_pDiffTextWindow1->convertLineToDiff3LineIdx(m_pDiffTextWindow1->getFirstLine());
+            m_pDiffTextWindow1->convertSelectionToD3LCoords();
+        }
+        if(m_pDiffTextWindow2)
+            m_pDiffTextWindow2->convertSelectionToD3LCoords();
+        if(m_pDiffTextWindow3)
+            m_pDiffTextWindow3->convertSelectionToD3LCoords();
+    }
+
+    LineCount sumOfLines = m_diff3LineList.recalcWordWrap(false);
+    if(m_pDiffTextWindow1)
+        m_pDiffTextWindow1->recalcWordWrap(true, sumOfLines, -1);
+    if(m_pDiffTextWindow2)
+        m_pDiffTextWindow2->recalcWordWrap(true, sumOfLines, -1);
+    if(m_pDiffTextWindow3)
+        m_pDiffTextWindow3->recalcWordWrap(true, sumOfLines, -1);
+    m_neededLines = sumOfLines;
+
+    if(m_pOverview)
+        m_pOverview->slotRedraw();
+    if(DiffTextWindow::mVScrollBar)
+    {
+        DiffTextWindow::mVScrollBar->setRange(0, std::max(0, m_neededLines + 1 - m_DTWHeight));
+        if(m_pDiffTextWindow1)
+            DiffTextWindow::mVScrollBar->setValue(m_pDiffTextWindow1->convertDiff3LineIdxToLine(m_firstD3LIdx));
+    }
+}
+
+/*
+    Cancels the word wrap running in the background and waits for it. Returns true if there was
+    one, the caller has to start the word wrap again once it changed what the wrap depends on.
+*/
+bool KDiff3App::stopBackgroundWordWrap()
+{
+    if(!m_bWordWrapInBackground)
+        return false;
+
+    DiffTextWindow::stopRunnables();
+    g_pProgressDialog->pop();
+    g_pProgressDialog->setStayHidden(false);
+
+    if(m_pDiffTextWindow1)
+        m_firstD3LIdx = m_pDiffTextWindow1->convertLineToDiff3LineIdx(m_pDiffTextWindow1->getFirstLine());
+    m_bWordWrapInBackground = false;
+    m_bRecalcWordWrapPosted = false;
+    return true;
+}
+
 void KDiff3App::slotShowWhiteSpaceToggled()
 {
     m_pOptions->m_bShowWhiteSpaceCharacters = showWhiteSpaceCharacters->isChecked();
@@ -1585,9 +1908,10 @@ void KDiff3App::slotShowLineNumbersToggled()
 /// Return true for success, else false
 bool KDiff3App::improveFilenames(bool bCreateNewInstance)
 {
-    FileAccess f1(m_sd1->getFilename());
-    FileAccess f2(m_sd2->getFilename());
-    FileAccess f3(m_sd3->getFilename());
+    // Stream inputs are no files, FileAccess would take a git: input for a URL.
+    FileAccess f1(m_sd1->isStreamInput() ? QString() : m_sd1->getFilename());
+    FileAccess f2(m_sd2->isStreamInput() ? QString() : m_sd2->getFilename());
+    FileAccess f3(m_sd3->isStreamInput() ? QString() : m_sd3->getFilename());
     FileAccess f4(m_outputFilename);
 
     if(f1.isFile() && f1.exists())
@@ -1666,7 +1990,7 @@ void KDiff3App::slotReload()
 {
     if(!shouldContinue()) return;
 
-    mainInit();
+    mainInit(nullptr, true, false, true);
 }
 
 bool KDiff3App::canContinue()
@@ -1807,6 +2131,15 @@ void KDiff3App::slotEditFindNext()
     bool bDirDown = true;
     bool bCaseSensitive = m_pFindDialog->m_pCaseSensitive->isChecked();
 
+    QVector<DiffTextWindow*> searchedWindows;
+    if(m_pFindDialog->m_pSearchInA->isChecked())
+        searchedWindows.push_back(m_pDiffTextWindow1);
+    if(m_pFindDialog->m_pSearchInB->isChecked())
+        searchedWindows.push_back(m_pDiffTextWindow2);
+    if(m_pFindDialog->m_pSearchInC->isChecked())
+        searchedWindows.push_back(m_pDiffTextWindow3);
+    DiffTextWindow::prepareFind(searchedWindows, s, bCaseSensitive);
+
     LineRef d3vLine = m_pFindDialog->currentLine;
     int posInLine = m_pFindDialog->currentPos;
     LineRef l = 0;
@@ -1903,15 +2236,15 @@ void KDiff3App::slotMergeCurrentFile()
 
         if(m_outputFilename.isEmpty())
         {
-            if(!m_sd3->isEmpty() && !m_sd3->isFromBuffer())
+            if(!m_sd3->isEmpty() && !m_sd3->isFromBuffer() && !m_sd3->isStreamInput())
             {
                 m_outputFilename = m_sd3->getFilename();
             }
-            else if(!m_sd2->isEmpty() && !m_sd2->isFromBuffer())
+            else if(!m_sd2->isEmpty() && !m_sd2->isFromBuffer() && !m_sd2->isStreamInput())
             {
                 m_outputFilename = m_sd2->getFilename();
             }
-            else if(!m_sd1->isEmpty() && !m_sd1->isFromBuffer())
+            else if(!m_sd1->isEmpty() && !m_sd1->isFromBuffer() && !m_sd1->isStreamInput())
             {
                 m_outputFilename = m_sd1->getFilename();
             }
@@ -2137,7 +2470,7 @@ void KDiff3App::slotUpdateAvailabilities()
     editCut->setEnabled(allowCut());
     if(m_pMergeResultWindow != nullptr)
     {
-        m_pMergeResultWindow->slotUpdateAvailabilities();
+        m_pMergeResultWindow->slotUpdateAvailabilities(m_bTripleDiff);
     }
 
     mMergeHistory->setEnabled(bMergeEditorVisible);
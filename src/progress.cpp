@@ -82,17 +82,32 @@ ProgressDialog::ProgressDialog(QWidget* pParent, QStatusBar* pStatusBar)
         m_pStatusAbortButton = nullptr;
     }
 
+    m_refreshTimer = 0;
     m_progressDelayTimer = 0;
     m_delayedHideTimer = 0;
     m_delayedHideStatusBarWidgetTimer = 0;
     resize(400, 100);
     m_t1.start();
     m_t2.start();
-    m_bWasCancelled = false;
+    m_bWasCancelled = 0;
+    m_nofLevels = 0;
     m_eCancelReason = eUserAbort;
     m_pJob = nullptr;
 }
 
+int ProgressDialog::ProgressLevelData::value()
+{
+    return int(1000.0 * (getAtomic(m_current) * (m_dRangeMax - m_dRangeMin) / getAtomic(m_maxNofSteps) + m_dRangeMin));
+}
+
+ProgressDialog::ProgressLevelData* ProgressDialog::currentLevel()
+{
+    const int level = m_nofLevels.loadAcquire();
+    if(level == 0 || level > maxNofLevels)
+        return nullptr;
+    return &m_progressStack[level - 1];
+}
+
 void ProgressDialog::setStayHidden(bool bStayHidden)
 {
     if(m_bStayHidden != bStayHidden)
@@ -119,31 +134,42 @@ void ProgressDialog::setStayHidden(bool bStayHidden)
 
 void ProgressDialog::push()
 {
-    ProgressLevelData pld;
-    if(!m_progressStack.empty())
+    const int level = getAtomic(m_nofLevels);
+    if(level == 0)
     {
-        pld.m_dRangeMax = m_progressStack.back().m_dSubRangeMax;
-        pld.m_dRangeMin = m_progressStack.back().m_dSubRangeMin;
-    }
-    else
-    {
-        m_bWasCancelled = false;
+        m_bWasCancelled.storeRelease(0);
         m_t1.restart();
         m_t2.restart();
         if(!m_bStayHidden)
             show();
+        m_refreshTimer = startTimer(refreshInterval);
     }
 
-    m_progressStack.push_back(pld);
+    if(level < maxNofLevels)
+    {
+        // Workers still see the old level until it's counted.
+        ProgressLevelData& pld = m_progressStack[level];
+        pld.m_current = 0;
+        pld.m_maxNofSteps = 1;
+        pld.m_dRangeMin = level > 0 ? m_progressStack[level - 1].m_dSubRangeMin : 0;
+        pld.m_dRangeMax = level > 0 ? m_progressStack[level - 1].m_dSubRangeMax : 1;
+        pld.m_dSubRangeMin = 0;
+        pld.m_dSubRangeMax = 1;
+    }
+    m_nofLevels.storeRelease(level + 1);
 }
 
 void ProgressDialog::pop(bool bRedrawUpdate)
 {
-    if(!m_progressStack.empty())
+    const int level = getAtomic(m_nofLevels);
+    if(level > 0)
     {
-        m_progressStack.pop_back();
-        if(m_progressStack.empty())
+        m_nofLevels.storeRelease(level - 1);
+        if(level == 1)
         {
+            if(m_refreshTimer)
+                killTimer(m_refreshTimer);
+            m_refreshTimer = 0;
             hide();
         }
         else
@@ -153,31 +179,17 @@ void ProgressDialog::pop(bool bRedrawUpdate)
 
 void ProgressDialog::setInformation(const QString& info, int current, bool bRedrawUpdate)
 {
-    if(m_progressStack.empty())
-        return;
-    ProgressLevelData& pld = m_progressStack.back();
-    pld.m_current = current;
-    int level = m_progressStack.size();
-    if(level == 1)
-    {
-        m_pInformation->setText(info);
-        m_pSubInformation->setText("");
-        if(m_pStatusBar != nullptr && m_bStayHidden)
-            m_pStatusBar->showMessage(info);
-    }
-    else if(level == 2)
-    {
-        m_pSubInformation->setText(info);
-    }
-    recalc(bRedrawUpdate);
+    ProgressLevelData* pLevel = currentLevel();
+    if(pLevel != nullptr)
+        pLevel->m_current = current;
+    setInformation(info, bRedrawUpdate);
 }
 
 void ProgressDialog::setInformation(const QString& info, bool bRedrawUpdate)
 {
-    if(m_progressStack.empty())
+    const int level = getAtomic(m_nofLevels);
+    if(level == 0)
         return;
-    //ProgressLevelData& pld = m_progressStack.back();
-    int level = m_progressStack.size();
     if(level == 1)
     {
         m_pInformation->setText(info);
@@ -194,46 +206,47 @@ void ProgressDialog::setInformation(const QString& info, bool bRedrawUpdate)
 
 void ProgressDialog::setMaxNofSteps(const qint64 maxNofSteps)
 {
-    if(m_progressStack.empty() || maxNofSteps == 0)
+    ProgressLevelData* pLevel = currentLevel();
+    if(pLevel == nullptr || maxNofSteps == 0)
         return;
-    ProgressLevelData& pld = m_progressStack.back();
-    pld.m_maxNofSteps = maxNofSteps;
-    pld.m_current = 0;
+    pLevel->m_maxNofSteps = maxNofSteps;
+    pLevel->m_current = 0;
 }
 
 void ProgressDialog::addNofSteps(const qint64 nofSteps)
 {
-    if(m_progressStack.empty())
+    ProgressLevelData* pLevel = currentLevel();
+    if(pLevel == nullptr)
         return;
-    ProgressLevelData& pld = m_progressStack.back();
-    pld.m_maxNofSteps.fetchAndAddRelaxed(nofSteps);
+    pLevel->m_maxNofSteps.fetchAndAddRelaxed(nofSteps);
 }
 
-void ProgressDialog::step(bool bRedrawUpdate)
+void ProgressDialog::step()
 {
-    if(m_progressStack.empty())
+    ProgressLevelData* pLevel = currentLevel();
+    if(pLevel == nullptr)
         return;
-    ProgressLevelData& pld = m_progressStack.back();
-    pld.m_current.fetchAndAddRelaxed(1);
-    recalc(bRedrawUpdate);
+    pLevel->m_current.fetchAndAddRelaxed(1);
+    // Called for each line or chunk, so only now and then more than counting is done.
+    if(isGuiThread() && m_t1.elapsed() >= refreshInterval)
+        recalc(false);
 }
 
 void ProgressDialog::setCurrent(qint64 subCurrent, bool bRedrawUpdate)
 {
-    if(m_progressStack.empty())
+    ProgressLevelData* pLevel = currentLevel();
+    if(pLevel == nullptr)
         return;
-    ProgressLevelData& pld = m_progressStack.back();
-    pld.m_current = subCurrent;
+    pLevel->m_current = subCurrent;
     recalc(bRedrawUpdate);
 }
 
 void ProgressDialog::clear()
 {
-    if(m_progressStack.isEmpty())
+    ProgressLevelData* pLevel = currentLevel();
+    if(pLevel == nullptr)
         return;
-
-    ProgressLevelData& pld = m_progressStack.back();
-    setCurrent(pld.m_maxNofSteps);
+    setCurrent(getAtomic(pLevel->m_maxNofSteps));
 }
 
 // The progressbar goes from 0 to 1 usually.
@@ -242,21 +255,21 @@ void ProgressDialog::clear()
 // Requirement: 0 < dMin < dMax < 1
 void ProgressDialog::setRangeTransformation(double dMin, double dMax)
 {
-    if(m_progressStack.empty())
+    ProgressLevelData* pLevel = currentLevel();
+    if(pLevel == nullptr)
         return;
-    ProgressLevelData& pld = m_progressStack.back();
-    pld.m_dRangeMin = dMin;
-    pld.m_dRangeMax = dMax;
-    pld.m_current = 0;
+    pLevel->m_dRangeMin = dMin;
+    pLevel->m_dRangeMax = dMax;
+    pLevel->m_current = 0;
 }
 
 void ProgressDialog::setSubRangeTransformation(double dMin, double dMax)
 {
-    if(m_progressStack.empty())
+    ProgressLevelData* pLevel = currentLevel();
+    if(pLevel == nullptr)
         return;
-    ProgressLevelData& pld = m_progressStack.back();
-    pld.m_dSubRangeMin = dMin;
-    pld.m_dSubRangeMax = dMax;
+    pLevel->m_dSubRangeMin = dMin;
+    pLevel->m_dSubRangeMax = dMax;
 }
 
 void ProgressDialog::enterEventLoop(KJob* pJob, const QString& jobInfo)
@@ -298,52 +311,49 @@ void ProgressDialog::exitEventLoop()
 
 void ProgressDialog::recalc(bool bUpdate)
 {
-    if(!m_bWasCancelled)
+    // The refresh timer shows what the workers report.
+    if(isCancelled() || !isGuiThread())
+        return;
+
+    const int level = getAtomic(m_nofLevels);
+    if((bUpdate && level == 1) || m_t1.elapsed() >= refreshInterval)
     {
-        if(QThread::currentThread() == m_pGuiThread)
-        {
-            if(m_progressDelayTimer)
-                killTimer(m_progressDelayTimer);
-            m_progressDelayTimer = 0;
-            if(!m_bStayHidden)
-                m_progressDelayTimer = startTimer(3000); /* 3 s delay */
-
-            int level = m_progressStack.size();
-            if((bUpdate && level == 1) || m_t1.elapsed() > 200)
-            {
-                if(m_progressStack.empty())
-                {
-                    m_pProgressBar->setValue(0);
-                    m_pSubProgressBar->setValue(0);
-                }
-                else
-                {
-                    QList<ProgressLevelData>::iterator i = m_progressStack.begin();
-                    int value = int(1000.0 * (getAtomic(i->m_current) * (i->m_dRangeMax - i->m_dRangeMin) / getAtomic(i->m_maxNofSteps) + i->m_dRangeMin));
-                    m_pProgressBar->setValue(value);
-                    if(m_bStayHidden && m_pStatusProgressBar)
-                        m_pStatusProgressBar->setValue(value);
-
-                    ++i;
-                    if(i != m_progressStack.end())
-                        m_pSubProgressBar->setValue(int(1000.0 * (getAtomic(i->m_current) * (i->m_dRangeMax - i->m_dRangeMin) / getAtomic(i->m_maxNofSteps) + i->m_dRangeMin)));
-                    else
-                        m_pSubProgressBar->setValue(int(1000.0 * m_progressStack.front().m_dSubRangeMin));
-                }
+        if(m_progressDelayTimer)
+            killTimer(m_progressDelayTimer);
+        m_progressDelayTimer = 0;
+        if(!m_bStayHidden)
+            m_progressDelayTimer = startTimer(3000); /* 3 s delay */
 
-                if(!m_bStayHidden && !isVisible())
-                    show();
-                qApp->processEvents();
-                m_t1.restart();
-            }
-        }
-        else
-        {
-            QMetaObject::invokeMethod(this, "recalc", Qt::QueuedConnection, Q_ARG(bool, bUpdate));
-        }
+        updateProgressBars();
+
+        if(!m_bStayHidden && !isVisible())
+            show();
+        qApp->processEvents();
+        m_t1.restart();
     }
 }
 
+void ProgressDialog::updateProgressBars()
+{
+    const int level = getAtomic(m_nofLevels);
+    if(level == 0)
+    {
+        m_pProgressBar->setValue(0);
+        m_pSubProgressBar->setValue(0);
+        return;
+    }
+
+    const int value = m_progressStack[0].value();
+    m_pProgressBar->setValue(value);
+    if(m_bStayHidden && m_pStatusProgressBar)
+        m_pStatusProgressBar->setValue(value);
+
+    if(level > 1)
+        m_pSubProgressBar->setValue(m_progressStack[1].value());
+    else
+        m_pSubProgressBar->setValue(int(1000.0 * m_progressStack[0].m_dSubRangeMin));
+}
+
 void ProgressDialog::show()
 {
     if(m_progressDelayTimer)
@@ -418,30 +428,33 @@ void ProgressDialog::slotAbort()
     reject();
 }
 
+bool ProgressDialog::isGuiThread() const
+{
+    return QThread::currentThread() == m_pGuiThread;
+}
+
 bool ProgressDialog::wasCancelled()
 {
-    if(QThread::currentThread() == m_pGuiThread)
+    if(isGuiThread() && m_t2.elapsed() > refreshInterval)
     {
-        if(m_t2.elapsed() > 100)
-        {
-            qApp->processEvents();
-            m_t2.restart();
-        }
+        qApp->processEvents();
+        m_t2.restart();
     }
-    return m_bWasCancelled;
+    return isCancelled();
 }
 
 void ProgressDialog::clearCancelState()
 {
-    m_bWasCancelled = false;
+    m_bWasCancelled.storeRelease(0);
 }
 
 void ProgressDialog::cancel(e_CancelReason eCancelReason)
 {
-    if(!m_bWasCancelled)
+    if(!isCancelled())
     {
-        m_bWasCancelled = true;
+        // The reason is set before workers can see the cancel.
         m_eCancelReason = eCancelReason;
+        m_bWasCancelled.storeRelease(1);
         if(m_eventLoop != nullptr)
             m_eventLoop->exit(1);
     }
@@ -454,7 +467,12 @@ ProgressDialog::e_CancelReason ProgressDialog::cancelReason()
 
 void ProgressDialog::timerEvent(QTimerEvent* te)
 {
-    if(te->timerId() == m_progressDelayTimer)
+    if(te->timerId() == m_refreshTimer)
+    {
+        if(!isCancelled())
+            updateProgressBars();
+    }
+    else if(te->timerId() == m_progressDelayTimer)
     {
         if(!isVisible() && !m_bStayHidden)
         {
@@ -478,12 +496,15 @@ void ProgressDialog::timerEvent(QTimerEvent* te)
 
 ProgressProxy::ProgressProxy()
 {
-    g_pProgressDialog->push();
+    m_bDetached = !g_pProgressDialog->isGuiThread();
+    if(!m_bDetached)
+        g_pProgressDialog->push();
 }
 
 ProgressProxy::~ProgressProxy()
 {
-    g_pProgressDialog->pop(false);
+    if(!m_bDetached)
+        g_pProgressDialog->pop(false);
 }
 
 void ProgressProxy::enterEventLoop(KJob* pJob, const QString& jobInfo)
@@ -503,51 +524,71 @@ QDialog* ProgressProxy::getDialog()
 
 void ProgressProxy::setInformation(const QString& info, bool bRedrawUpdate)
 {
+    if(m_bDetached)
+        return;
     g_pProgressDialog->setInformation(info, bRedrawUpdate);
 }
 
 void ProgressProxy::setInformation(const QString& info, int current, bool bRedrawUpdate)
 {
+    if(m_bDetached)
+        return;
     g_pProgressDialog->setInformation(info, current, bRedrawUpdate);
 }
 
 void ProgressProxy::setCurrent(qint64 current, bool bRedrawUpdate)
 {
+    if(m_bDetached)
+        return;
     g_pProgressDialog->setCurrent(current, bRedrawUpdate);
 }
 
-void ProgressProxy::step(bool bRedrawUpdate)
+void ProgressProxy::step()
 {
-    g_pProgressDialog->step(bRedrawUpdate);
+    if(m_bDetached)
+        return;
+    g_pProgressDialog->step();
 }
 
 void ProgressProxy::clear()
 {
+    if(m_bDetached)
+        return;
     g_pProgressDialog->clear();
 }
 
 void ProgressProxy::setMaxNofSteps(const qint64 maxNofSteps)
 {
+    if(m_bDetached)
+        return;
     g_pProgressDialog->setMaxNofSteps(maxNofSteps);
 }
 
 void ProgressProxy::addNofSteps(const qint64 nofSteps)
 {
+    if(m_bDetached)
+        return;
     g_pProgressDialog->addNofSteps(nofSteps);
 }
 
 bool ProgressProxy::wasCancelled()
 {
+    if(m_bDetached)
+        return g_pProgressDialog->isCancelled();
     return g_pProgressDialog->wasCancelled();
 }
 
 void ProgressProxy::setRangeTransformation(double dMin, double dMax)
 {
+    if(m_bDetached)
+        return;
     g_pProgressDialog->setRangeTransformation(dMin, dMax);
 }
 
 void ProgressProxy::setSubRangeTransformation(double dMin, double dMax)
 {
+    if(m_bDetached)
+        return;
     g_pProgressDialog->setSubRangeTransformation(dMin, dMax);
 }
 
@@ -555,3 +596,15 @@ void ProgressProxy::recalc()
 {
     g_pProgressDialog->recalc(true);
 }
+
+HiddenProgressDialog::HiddenProgressDialog()
+{
+    g_pProgressDialog = new ProgressDialog(nullptr, nullptr);
+    g_pProgressDialog->setStayHidden(true);
+}
+
+HiddenProgressDialog::~HiddenProgressDialog()
+{
+    delete g_pProgressDialog;
+    g_pProgressDialog = nullptr;
+}
@@ -10,10 +10,10 @@
 #ifndef PROGRESS_H
 #define PROGRESS_H
 
+#include <QAtomicInteger>
 #include <QDialog>
 #include <QPointer>
 #include <QElapsedTimer>
-#include <QList>
 
 class KJob;
 class QEventLoop;
@@ -21,6 +21,12 @@ class QLabel;
 class QProgressBar;
 class QStatusBar;
 
+/*
+    The counters of the progress levels are atomic and stay in place, so step(), setCurrent() and
+    isCancelled() are cheap and may be called from any thread. Only the GUI thread pushes and pops
+    levels and changes the texts. The bars are redrawn at most every refreshInterval ms, by the GUI
+    thread when it reports itself and by a timer for the reports of the workers.
+*/
 class ProgressDialog : public QDialog
 {
    Q_OBJECT
@@ -31,7 +37,7 @@ public:
    void setInformation( const QString& info, bool bRedrawUpdate=true );
    void setInformation( const QString& info, int current, bool bRedrawUpdate=true );
    void setCurrent( qint64 current, bool bRedrawUpdate=true  );
-   void step( bool bRedrawUpdate=true );
+   void step();
    void clear();
    void setMaxNofSteps(const qint64 dMaxNofSteps);
    void addNofSteps(const qint64 nofSteps );
@@ -48,7 +54,11 @@ public:
    void exitEventLoop();
    void enterEventLoop( KJob* pJob, const QString& jobInfo );
 
+   // Also processes the events now and then when called on the GUI thread.
    bool wasCancelled();
+   // Only reads the cancel state, for loops on worker threads and while painting.
+   bool isCancelled() const { return m_bWasCancelled.load() != 0; }
+   bool isGuiThread() const;
    enum e_CancelReason{eUserAbort,eResize};
    void cancel(e_CancelReason);
    e_CancelReason cancelReason();
@@ -62,6 +72,9 @@ public:
 public Q_SLOTS:
    void recalc(bool bUpdate);
 private:
+   static const int refreshInterval = 100; // ms
+   // Only the first two levels are shown, deeper ones aren't kept.
+   static const int maxNofLevels = 8;
 
    struct ProgressLevelData
    {
@@ -70,15 +83,24 @@ private:
          m_current=0; m_maxNofSteps=1; m_dRangeMin=0; m_dRangeMax=1;
          m_dSubRangeMin = 0; m_dSubRangeMax = 1;
       }
+      int value();
+
       QAtomicInteger<qint64> m_current;
       QAtomicInteger<qint64> m_maxNofSteps;     // when step() is used.
+      // The ranges are only used on the GUI thread.
       double m_dRangeMax;
       double m_dRangeMin;
       double m_dSubRangeMax;
       double m_dSubRangeMin;
    };
-   QList<ProgressLevelData> m_progressStack;
+   ProgressLevelData m_progressStack[maxNofLevels];
+   QAtomicInt m_nofLevels;
 
+   // nullptr if no level is pushed or it's too deep to be kept.
+   ProgressLevelData* currentLevel();
+   void updateProgressBars();
+
+   int m_refreshTimer;
    int m_progressDelayTimer;
    int m_delayedHideTimer;
    int m_delayedHideStatusBarWidgetTimer;
@@ -92,7 +114,7 @@ private:
    QPushButton* m_pAbortButton;
    QElapsedTimer m_t1;
    QElapsedTimer m_t2;
-   bool m_bWasCancelled;
+   QAtomicInt m_bWasCancelled; // The cancellation token of all levels
    e_CancelReason m_eCancelReason;
    KJob* m_pJob = nullptr;
    QString m_currentJobInfo;  // Needed if the job doesn't stop after a reasonable time.
@@ -110,6 +132,8 @@ private Q_SLOTS:
 };
 
 // When using the ProgressProxy you need not take care of the push and pop, except when explicit.
+// A ProgressProxy created outside the GUI thread only forwards isCancelled(), whoever started the
+// worker is responsible for reporting its progress.
 class ProgressProxy: public QObject
 {
    Q_OBJECT
@@ -120,7 +144,7 @@ public:
    void setInformation( const QString& info, bool bRedrawUpdate=true );
    void setInformation( const QString& info, int current, bool bRedrawUpdate=true );
    void setCurrent( qint64 current, bool bRedrawUpdate=true  );
-   void step( bool bRedrawUpdate=true );
+   void step();
    void clear();
    void setMaxNofSteps( const qint64 maxNofSteps );
    void addNofSteps( const qint64 nofSteps );
@@ -133,9 +157,23 @@ public:
    static QDialog *getDialog();
    static void recalc();
 private:
+   bool m_bDetached;
 };
 
 extern ProgressDialog* g_pProgressDialog;
 
+/*
+   The progress dialog of the modes without GUI and of the autotests, as long as it exists. It is
+   needed before any file operations via FileAccess happen and stays hidden.
+*/
+class HiddenProgressDialog
+{
+public:
+   HiddenProgressDialog();
+   ~HiddenProgressDialog();
+private:
+   Q_DISABLE_COPY(HiddenProgressDialog)
+};
+
 #endif
 
@@ -9,6 +9,7 @@
 #include "diff.h"
 #include "options.h"
 #include "kdiff3.h"
+#include "RegExpCache.h"
 
 #include <QCheckBox>
 #include <QComboBox>
@@ -565,8 +566,8 @@ QString RegExpTester::historySortKeyOrder()
 
 void RegExpTester::slotRecalc()
 {
-    QRegExp autoMergeRegExp(m_pAutoMergeRegExpEdit->text());
-    if(autoMergeRegExp.exactMatch(m_pAutoMergeExampleEdit->text()))
+    const QRegularExpression autoMergeRegExp = RegExpCache::compileExactMatch(m_pAutoMergeRegExpEdit->text());
+    if(autoMergeRegExp.match(m_pAutoMergeExampleEdit->text()).hasMatch())
     {
         m_pAutoMergeMatchResult->setText(i18n("Match success."));
     }
@@ -575,8 +576,8 @@ void RegExpTester::slotRecalc()
         m_pAutoMergeMatchResult->setText(i18n("Match failed."));
     }
 
-    QRegExp historyStartRegExp(m_pHistoryStartRegExpEdit->text());
-    if(historyStartRegExp.exactMatch(m_pHistoryStartExampleEdit->text()))
+    const QRegularExpression historyStartRegExp = RegExpCache::compileExactMatch(m_pHistoryStartRegExpEdit->text());
+    if(historyStartRegExp.match(m_pHistoryStartExampleEdit->text()).hasMatch())
     {
         m_pHistoryStartMatchResult->setText(i18n("Match success."));
     }
@@ -593,13 +594,14 @@ void RegExpTester::slotRecalc()
         m_pHistorySortKeyResult->setText("");
         return;
     }
-    QRegExp historyEntryStartRegExp(m_pHistoryEntryStartRegExpEdit->text());
+    const QRegularExpression historyEntryStartRegExp = RegExpCache::compileExactMatch(m_pHistoryEntryStartRegExpEdit->text());
     QString s = m_pHistoryEntryStartExampleEdit->text();
 
-    if(historyEntryStartRegExp.exactMatch(s))
+    const QRegularExpressionMatch historyEntryStartMatch = historyEntryStartRegExp.match(s);
+    if(historyEntryStartMatch.hasMatch())
     {
         m_pHistoryEntryStartMatchResult->setText(i18n("Match success."));
-        QString key = calcHistorySortKey(m_pHistorySortKeyOrderEdit->text(), historyEntryStartRegExp, parenthesesGroups);
+        QString key = calcHistorySortKey(m_pHistorySortKeyOrderEdit->text(), historyEntryStartMatch, parenthesesGroups);
         m_pHistorySortKeyResult->setText(key);
     }
     else
@@ -5,9 +5,11 @@
 */
 
 #include <iostream>
+#include <random>
 #include <stdio.h>
 
 #include <QDirIterator>
+#include <QTemporaryDir>
 #include <QTextCodec>
 #include <QTextStream>
 
@@ -249,57 +251,20 @@ bool dataIsConsistent(int line1, QString &line1Text, int line2, QString &line2Te
    return consistent;
 }
 
-bool runTest(QString file1, QString file2, QString file3, QString expectedResultFile, QString actualResultFile, int maxLength)
+void checkAlignment(const Diff3LineList &actualDiff3LineList,
+                    const SourceData &m_sd1,
+                    const SourceData &m_sd2,
+                    const SourceData &m_sd3,
+                    bool &sequenceError,
+                    bool &consistencyError)
 {
-   m_pOptions = QSharedPointer<Options>::create();
-   Diff3LineList actualDiff3LineList, expectedDiff3LineList;
-   QTextCodec *p_codec = QTextCodec::codecForName("UTF-8");
    QTextStream out(stdout);
-
-   m_pOptions->m_bIgnoreCase = false;
-   m_pOptions->m_bPreserveCarriageReturn = false;
-   m_pOptions->m_bDiff3AlignBC = true;
-
-   SourceData m_sd1, m_sd2, m_sd3;
-
-   QString msgprefix = "Running test with ";
-   QString filepattern = QString(file1).replace("_base.", "_*.");
-   QString msgsuffix = QString("...%1").arg("", maxLength - filepattern.length());
-   out << msgprefix << filepattern << msgsuffix;
-   if(verbose)
-   {
-      out << endl;
-   }
-   out.flush();
-
-   m_sd1.setOptions(m_pOptions);
-   m_sd1.setFilename(file1);
-   m_sd1.readAndPreprocess(p_codec, false);
-
-   m_sd2.setOptions(m_pOptions);
-   m_sd2.setFilename(file2);
-   m_sd2.readAndPreprocess(p_codec, false);
-
-   m_sd3.setOptions(m_pOptions);
-   m_sd3.setFilename(file3);
-   m_sd3.readAndPreprocess(p_codec, false);
-
-   determineFileAlignment(m_sd1, m_sd2, m_sd3, actualDiff3LineList);
-
-   loadExpectedAlignmentFile(expectedResultFile, expectedDiff3LineList);
-
-   Diff3LineList::iterator p_actual = actualDiff3LineList.begin();
-   Diff3LineList::iterator p_expected = expectedDiff3LineList.begin();
-   bool equal = true;
-   bool sequenceError = false;
-   bool consistencyError = false;
-
-   equal = (actualDiff3LineList.size() == expectedDiff3LineList.size());
+   Diff3LineList::const_iterator p_actual;
 
    int latestLineA = -1;
    int latestLineB = -1;
    int latestLineC = -1;
-   while(equal && (p_actual != actualDiff3LineList.end()))
+   for(p_actual = actualDiff3LineList.begin(); p_actual != actualDiff3LineList.end(); ++p_actual)
    {
       /* Check if all line numbers are in sequence */
       if(p_actual->getLineA().isValid())
@@ -356,7 +321,60 @@ bool runTest(QString file1, QString file2, QString file3, QString expectedResult
          if(verbose) out << "inconsistency: line " << p_actual->getLineA() << " of A vs line " << p_actual->getLineC() << " of C" << endl;
          consistencyError = true;
       }
+   }
+}
+
+bool runTest(QString file1, QString file2, QString file3, QString expectedResultFile, QString actualResultFile, int maxLength)
+{
+   m_pOptions = QSharedPointer<Options>::create();
+   Diff3LineList actualDiff3LineList, expectedDiff3LineList;
+   QTextCodec *p_codec = QTextCodec::codecForName("UTF-8");
+   QTextStream out(stdout);
+
+   m_pOptions->m_bIgnoreCase = false;
+   m_pOptions->m_bPreserveCarriageReturn = false;
+   m_pOptions->m_bDiff3AlignBC = true;
+
+   SourceData m_sd1, m_sd2, m_sd3;
+
+   QString msgprefix = "Running test with ";
+   QString filepattern = QString(file1).replace("_base.", "_*.");
+   QString msgsuffix = QString("...%1").arg("", maxLength - filepattern.length());
+   out << msgprefix << filepattern << msgsuffix;
+   if(verbose)
+   {
+      out << endl;
+   }
+   out.flush();
+
+   m_sd1.setOptions(m_pOptions);
+   m_sd1.setFilename(file1);
+   m_sd1.readAndPreprocess(p_codec, false);
+
+   m_sd2.setOptions(m_pOptions);
+   m_sd2.setFilename(file2);
+   m_sd2.readAndPreprocess(p_codec, false);
+
+   m_sd3.setOptions(m_pOptions);
+   m_sd3.setFilename(file3);
+   m_sd3.readAndPreprocess(p_codec, false);
+
+   determineFileAlignment(m_sd1, m_sd2, m_sd3, actualDiff3LineList);
+
+   loadExpectedAlignmentFile(expectedResultFile, expectedDiff3LineList);
+
+   Diff3LineList::iterator p_actual = actualDiff3LineList.begin();
+   Diff3LineList::iterator p_expected = expectedDiff3LineList.begin();
+   bool equal = true;
+   bool sequenceError = false;
+   bool consistencyError = false;
 
+   checkAlignment(actualDiff3LineList, m_sd1, m_sd2, m_sd3, sequenceError, consistencyError);
+
+   equal = (actualDiff3LineList.size() == expectedDiff3LineList.size());
+
+   while(equal && (p_actual != actualDiff3LineList.end()))
+   {
       /* Check if the actual output of the algorithm is equal to the expected output */
       equal = (p_actual->getLineA() == p_expected->getLineA()) &&
               (p_actual->getLineB() == p_expected->getLineB()) &&
@@ -405,6 +423,133 @@ bool runTest(QString file1, QString file2, QString file3, QString expectedResult
 }
 
 
+
+QString randomContribution(std::mt19937 &random, const QStringList &baseLines, const QStringList &lines)
+{
+   QString text;
+   for(const QString &baseLine : baseLines)
+   {
+      switch(random() % 6)
+      {
+         case 0:
+            break;
+         case 1:
+            text += lines.at(random() % lines.size()) + QLatin1Char('\n');
+            break;
+         case 2:
+            text += baseLine + QLatin1Char('\n') + lines.at(random() % lines.size()) + QLatin1Char('\n');
+            break;
+         default:
+            text += baseLine + QLatin1Char('\n');
+            break;
+      }
+   }
+   return text;
+}
+
+void writeTestDataFile(const QString &fileName, const QString &text)
+{
+   QFile file(fileName);
+   if(file.open(QIODevice::WriteOnly))
+   {
+      file.write(text.toUtf8());
+      file.close();
+   }
+}
+
+/* Random inputs made from a few distinct lines, so that B and C share many
+ * lines that A doesn't have and calcDiff3LineListUsingBC has to move them.
+ * Without an expected alignment only the sequence, the completeness and the
+ * equality booleans can be checked. A failing input is kept in
+ * testdata/random with an empty expected result, to be filled in and added
+ * as a case.
+ */
+bool runRandomTests(int count)
+{
+   QTextStream out(stdout);
+   QTextCodec *p_codec = QTextCodec::codecForName("UTF-8");
+   QTemporaryDir tempDir;
+   QStringList lines;
+   lines << "aaa" << "bbb" << "ccc" << "ddd" << "eee" << "fff";
+   std::mt19937 random(1);
+   int nofFailures = 0;
+
+   m_pOptions = QSharedPointer<Options>::create();
+   m_pOptions->m_bIgnoreCase = false;
+   m_pOptions->m_bPreserveCarriageReturn = false;
+   m_pOptions->m_bDiff3AlignBC = true;
+
+   out << "Running " << count << " tests with random input..." << endl;
+
+   for(int i = 0; i < count; ++i)
+   {
+      int nofLines = 1 + random() % 30;
+      int nofDistinctLines = 2 + random() % (lines.size() - 1);
+      QStringList baseLines;
+      QString base;
+      for(int j = 0; j < nofLines; ++j)
+      {
+         baseLines << lines.at(random() % nofDistinctLines);
+         base += baseLines.last() + QLatin1Char('\n');
+      }
+
+      QString contrib1 = randomContribution(random, baseLines, lines);
+      QString contrib2 = (random() % 3 == 0) ? randomContribution(random, contrib1.split(QLatin1Char('\n'), QString::SkipEmptyParts), lines)
+                                             : randomContribution(random, baseLines, lines);
+
+      SourceData m_sd1, m_sd2, m_sd3;
+      QString texts[3] = {base, contrib1, contrib2};
+      SourceData *sourceData[3] = {&m_sd1, &m_sd2, &m_sd3};
+      for(int j = 0; j < 3; ++j)
+      {
+         QString fileName = tempDir.path() + QString("/input%1.txt").arg(j);
+         writeTestDataFile(fileName, texts[j]);
+         sourceData[j]->setOptions(m_pOptions);
+         sourceData[j]->setFilename(fileName);
+         sourceData[j]->readAndPreprocess(p_codec, false);
+      }
+
+      Diff3LineList actualDiff3LineList;
+      determineFileAlignment(m_sd1, m_sd2, m_sd3, actualDiff3LineList);
+
+      bool sequenceError = false;
+      bool consistencyError = false;
+      checkAlignment(actualDiff3LineList, m_sd1, m_sd2, m_sd3, sequenceError, consistencyError);
+
+      /* Every line of every input is on exactly one line of the diff view */
+      int nofLinesA = 0, nofLinesB = 0, nofLinesC = 0;
+      Diff3LineList::const_iterator p_d3l;
+      for(p_d3l = actualDiff3LineList.begin(); p_d3l != actualDiff3LineList.end(); ++p_d3l)
+      {
+         if(p_d3l->getLineA().isValid()) ++nofLinesA;
+         if(p_d3l->getLineB().isValid()) ++nofLinesB;
+         if(p_d3l->getLineC().isValid()) ++nofLinesC;
+      }
+      bool complete = nofLinesA == m_sd1.getSizeLines() && nofLinesB == m_sd2.getSizeLines() && nofLinesC == m_sd3.getSizeLines();
+
+      if(sequenceError || consistencyError || !complete)
+      {
+         QString prefix = QString("testdata/random/random_%1").arg(i);
+         QDir().mkpath("testdata/random");
+         writeTestDataFile(prefix + "_base.txt", base);
+         writeTestDataFile(prefix + "_contrib1.txt", contrib1);
+         writeTestDataFile(prefix + "_contrib2.txt", contrib2);
+         writeTestDataFile(prefix + "_expected_result.txt", QString());
+         writeActualAlignmentFile(prefix + "_actual_result.txt", actualDiff3LineList);
+
+         out << "Random test " << i << " NOK, input written to " << prefix << "_*.txt:" << endl;
+         out << "----------------------------------------------------------------------------------------------" << endl;
+         printDiff3List(actualDiff3LineList, m_sd1, m_sd2, m_sd3, true);
+         out << "----------------------------------------------------------------------------------------------" << endl;
+         ++nofFailures;
+      }
+   }
+
+   out << (nofFailures == 0 ? QString("Random tests OK") : QString("%1 random tests NOK").arg(nofFailures)) << endl;
+
+   return nofFailures == 0;
+}
+
 QStringList gettestdatafiles(QString testdir)
 {
    QStringList baseFilePaths;
@@ -489,6 +634,8 @@ int main(int argc, char *argv[])
       }
    }
 
+   allOk = runRandomTests(1000) && allOk;
+
    out << (allOk ? "All OK" : "Not all OK") << endl;
 
    return allOk ? 0 : -1;
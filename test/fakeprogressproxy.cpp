@@ -52,10 +52,8 @@ void ProgressProxy::setCurrent( qint64 current, bool bRedrawUpdate )
   Q_UNUSED(bRedrawUpdate);
 }
 
-void ProgressProxy::step( bool bRedrawUpdate )
+void ProgressProxy::step()
 {
-  /* Suppress warning about unused parameters */
-  Q_UNUSED(bRedrawUpdate);
 }
 
 void ProgressProxy::setMaxNofSteps( qint64 dMaxNofSteps )